@@ -421,6 +421,7 @@ static void cp_destroy(struct oo_cplane_handle* cp)
     vfree(fwd_table->rows);
     fwd_table->rows = NULL;
     fwd_table->prefix = NULL;
+    fwd_table->journal = NULL;
     vfree(fwd_table->rw_rows);
     fwd_table->rw_rows = NULL;
   }
@@ -1025,6 +1026,8 @@ cp_mmap_fwd(struct oo_cplane_handle* cp, struct vm_area_struct* vma,
     fwd_table->mask = cp->mib->dim->fwd_mask;
     fwd_table->prefix = cp_fwd_prefix_within_blob(fwd_table->rows,
                                                   cp->mib->dim);
+    fwd_table->journal = cp_fwd_journal_within_blob(fwd_table->rows,
+                                                    cp->mib->dim);
   }
 
   return 0;
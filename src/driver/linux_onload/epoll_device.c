@@ -783,6 +783,7 @@ struct oo_epoll_poll_table {
   wait_queue_head_t* w[2];
   struct task_struct* task;
   struct file* filp;
+  int exclusive;
   int rc;
 };
 
@@ -798,7 +799,10 @@ static void oo_epoll1_block_on_callback(struct file* filp,
     i = 1;
 
   ept->w[i] = w;
-  add_wait_queue(w, &ept->wq[i]);
+  if( i == 0 && ept->exclusive )
+    add_wait_queue_exclusive(w, &ept->wq[i]);
+  else
+    add_wait_queue(w, &ept->wq[i]);
 }
 
 static inline int oo_epoll1_wake_home_callback(wait_queue_entry_t* wait,
@@ -822,15 +826,33 @@ static inline int oo_epoll1_wake_other_callback(wait_queue_entry_t* wait,
   return wake_up_process(ept->task);
 }
 
-/* this is essentially sys_poll([home_filp,other_filp], timeout_ms) */
+/* Wakes one thread waiting exclusively on the home stack's ready list,
+ * along with any non-exclusive waiters.
+ */
+static void oo_epoll1_wake_one(struct oo_epoll1_private* priv)
+{
+  tcp_helper_resource_t* thr = priv->home_stack;
+
+  if( thr != NULL )
+    ci_waitable_wakeup_one(&thr->ready_list_waitqs[priv->ready_list]);
+}
+
+/* this is essentially sys_poll([home_filp,other_filp], timeout_ms)
+ *
+ * With [exclusive], a wakeup from the home stack's ready list wakes only
+ * one exclusive waiter.  The ready list's wakeup request is consumed by
+ * each wakeup, so a woken waiter renews it for those still waiting.
+ */
 static int oo_epoll1_block_on(struct file* home_filp,
                               struct file* other_filp,
-                              ci_uint64 timeout_us)
+                              ci_uint64 timeout_us, int exclusive)
 {
+  struct oo_epoll_private *priv = home_filp->private_data;
   struct oo_epoll_poll_table ept;
   int rc, ret = 0;
 
   ept.rc = 0;
+  ept.exclusive = exclusive;
   ept.filp = home_filp;
   ept.task = current;
   ept.w[0] = ept.w[1] = NULL;
@@ -871,8 +893,16 @@ static int oo_epoll1_block_on(struct file* home_filp,
     }
   }
 
-  if( ept.w[0] != NULL )
+  if( ept.w[0] != NULL ) {
     remove_wait_queue(ept.w[0], &ept.wq[0]);
+    if( exclusive && priv->p.p1.home_stack != NULL &&
+        ept.w[0] == &priv->p.p1.home_stack->
+                      ready_list_waitqs[priv->p.p1.ready_list].wq &&
+        waitqueue_active(ept.w[0]) )
+      ci_atomic32_or(&priv->p.p1.home_stack->netif.state->
+                       ready_list_flags[priv->p.p1.ready_list],
+                     CI_NI_READY_LIST_FLAG_WAKE);
+  }
   if( ept.w[1] != NULL )
     remove_wait_queue(ept.w[1], &ept.wq[1]);
 
@@ -911,6 +941,7 @@ static int oo_epoll1_spin_on(struct file* home_filp,
     return 0;
 
   ept.rc = 0;
+  ept.exclusive = 0;
   ept.filp = home_filp;
   ept.task = current;
   end = ktime_to_ns(ktime_add_us(ktime_get(), timeout_us));
@@ -1164,7 +1195,8 @@ static long oo_epoll_fop_unlocked_ioctl(struct file* filp,
     priv->p.p1.flags = 0;
 
     if( cmd == OO_EPOLL1_IOC_BLOCK_ON )
-      rc = oo_epoll1_block_on(filp, other_filp, local_arg.timeout_us);
+      rc = oo_epoll1_block_on(filp, other_filp, local_arg.timeout_us,
+                              local_arg.flags & OO_EPOLL1_EXCLUSIVE);
     else
       rc = oo_epoll1_spin_on(filp, other_filp, local_arg.timeout_us,
                                                local_arg.sleep_iter_us);
@@ -1240,6 +1272,13 @@ static long oo_epoll_fop_unlocked_ioctl(struct file* filp,
     rc = oo_epoll1_setup_shared(&priv->p.p1);
     break;
 
+  case OO_EPOLL1_IOC_WAKE_ONE:
+    if( priv->type != OO_EPOLL_TYPE_1 )
+      return -EINVAL;
+    oo_epoll1_wake_one(&priv->p.p1);
+    rc = 0;
+    break;
+
   default:
     /* If libc is used on our sockets, sometimes it may call TCGETS ioctl to
      * determine whether the file is a tty.
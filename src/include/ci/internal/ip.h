@@ -402,6 +402,13 @@ typedef struct {
   ci_int32      sack_blocks;
   ci_uint32     ack,seq;         /* ACK and SEQ values in host endian */
   ci_uint32     hash;            /* hash for l/r addr/port */
+
+  /* Further in-order segments coalesced with [pkt] by the poll loop and
+   * chained via frag_next, or NULL.  The fast path enqueues them and sets
+   * [*gro_next] to OO_PP_NULL; otherwise the caller handles them singly.
+   */
+  oo_pkt_p*     gro_next;
+  ci_uint32     gro_end_seq;     /* end sequence # of the last of these */
 } ciip_tcp_rx_pkt;
 
 
@@ -440,6 +447,54 @@ typedef struct {
 #endif
 
 
+/**********************************************************************
+ * Latency histograms (EF_LATENCY_HIST)
+ */
+
+/* Returns the per-socket histograms for [sock_id], or NULL if that socket
+ * has none.  Caller must check that ni->lat_hists is not NULL.
+ */
+ci_inline ci_sock_lat_hists*
+ci_netif_sock_lat_hists(ci_netif* ni, oo_sp sock_id)
+{
+  if( OO_SP_IS_NULL(sock_id) ||
+      OO_SP_TO_INT(sock_id) >= NI_OPTS(ni).lat_hist_socks )
+    return NULL;
+  return &ni->lat_hists->sock[OO_SP_TO_INT(sock_id)];
+}
+
+/* Record the time from the RX event for a packet stamped with [rx_frc]
+ * being handled to its payload being consumed by the application.
+ */
+ci_inline void ci_netif_lat_rx_recv(ci_netif* ni, oo_sp sock_id,
+                                    ci_uint64 rx_frc)
+{
+  if(CI_UNLIKELY( ni->lat_hists != NULL )) {
+    ci_sock_lat_hists* sh;
+    ci_uint64 now;
+    ci_frc64(&now);
+    if( rx_frc == 0 || now < rx_frc )
+      return;
+    ci_lat_hist_add(&ni->lat_hists->rx_recv, now - rx_frc);
+    if( (sh = ci_netif_sock_lat_hists(ni, sock_id)) != NULL )
+      ci_lat_hist_add(&sh->rx_recv, now - rx_frc);
+  }
+}
+
+ci_inline void ci_netif_lat_hists_reset(ci_netif* ni)
+{
+  memset(ni->lat_hists, 0, sizeof(ci_netif_lat_hists) +
+         sizeof(ci_sock_lat_hists) * NI_OPTS(ni).lat_hist_socks);
+}
+
+#ifndef __KERNEL__
+extern ci_uint64 ci_lat_hist_percentile(const ci_lat_hist* h,
+                                        unsigned permille) CI_HF;
+extern ci_uint64 ci_netif_lat_cycles_to_ns(ci_netif* ni,
+                                           ci_uint64 cycles) CI_HF;
+#endif
+
+
 extern void ci_netif_config_opts_rangecheck(ci_netif_config_opts* opts) CI_HF;
 extern void ci_netif_config_opts_getenv(ci_netif_config_opts* opts) CI_HF;
 extern void ci_netif_config_opts_defaults(ci_netif_config_opts* opts) CI_HF;
@@ -470,6 +525,13 @@ extern int  ci_netif_poll_intf_future(ci_netif*, int intf_i, ci_uint64 now_frc)
 #endif
 extern int  ci_netif_poll_n(ci_netif*, int max_evs) CI_HF;
 #define     ci_netif_poll(ni)  ci_netif_poll_n((ni), 0x7fffffff)
+/* Prefetch pass made by the poll loop, when EF_POLL_PREFETCH is set, ahead
+ * of each chunk of up to CI_NETIF_POLL_PREFETCH_BATCH events.  The chunk is
+ * bounded so that we don't issue more prefetches than the CPU can have
+ * misses outstanding. */
+#define CI_NETIF_POLL_PREFETCH_BATCH  16
+extern void ci_netif_poll_evq_prefetch(ci_netif* ni, const ef_event* ev,
+                                       int n_evs) CI_HF;
 #ifdef __KERNEL__
 /* in-kernel backend for ci_netif_evq_poll_k */
 extern int  ci_netif_evq_poll(ci_netif*, int intf);
@@ -497,6 +559,11 @@ ci_inline void ci_netif_send(ci_netif* ni, ci_ip_pkt_fmt* pkt)
   pkt->flags |= CI_PKT_FLAG_TX_PENDING;
   __ci_netif_send(ni, pkt);
 }
+/* Between these calls, ci_netif_send() posts descriptors without ringing
+ * the doorbell, which is rung once per interface by ci_netif_tx_batch_end().
+ */
+extern void ci_netif_tx_batch_start(ci_netif* ni) CI_HF;
+extern void ci_netif_tx_batch_end(ci_netif* ni) CI_HF;
 extern void ci_netif_rx_post(ci_netif* netif, int nic_index) CI_HF;
 #ifdef __KERNEL__
 extern int  ci_netif_set_rxq_limit(ci_netif*) CI_HF;
@@ -637,7 +704,20 @@ CI_DEBUG(extern void ci_netif_verify_freepkts(ci_netif *, const char *, int);)
 # define PKT_DBG_ARGS(p)                OO_PKT_FMT(p), (p)->flags
 
 
-extern int ci_netif_pktset_best(ci_netif* ni) CI_HF;
+extern int ci_netif_pktset_best(ci_netif* ni, int numa_node) CI_HF;
+/* Like ci_netif_pktset_best(), but prefers sets on [numa_node].  When the
+ * local sets have fewer than [min_free] free buffers, sets on other nodes
+ * are used instead, and a new set is allocated on [numa_node] only once
+ * that has happened CI_CFG_PKT_NUMA_GROW_SHORT times in a row, or when no
+ * set anywhere has [min_free] free buffers.  The stack no longer grows
+ * for a node once a new set failed to land on it.  [numa_node] of -1
+ * means any node. */
+extern int ci_netif_pktset_best_local(ci_netif* ni, int numa_node,
+                                      int min_free) CI_HF;
+#ifndef __KERNEL__
+/* Reads the CPU to NUMA node map used to pick transmit packet sets. */
+extern void ci_netif_cpu_numa_map_init(void) CI_HF;
+#endif
 extern void ci_netif_pkt_free(ci_netif* ni, ci_ip_pkt_fmt* pkt
                               CI_KERNEL_ARG(int* p_netif_is_locked)) CI_HF;
 
@@ -984,6 +1064,12 @@ extern int ci_udp_recvmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg,
                            CI_KERNEL_ARG(ci_addr_spc_t addr_spc)) CI_HF;
 #endif
 
+#if CI_CFG_SENDMMSG && ! defined(__KERNEL__)
+struct mmsghdr;
+extern int ci_udp_sendmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg,
+                           unsigned vlen, int flags) CI_HF;
+#endif
+
 #ifndef __KERNEL__
 struct onload_zc_mmsg;
 extern int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, 
@@ -997,6 +1083,15 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args);
 extern int ci_udp_recvmsg_kernel(int fd, ci_netif* ni, ci_udp_state* us,
                                  struct msghdr* msg, int flags);
 
+/* Receive regions: see onload_zc_rx_region_register() */
+extern int ci_tcp_rx_region_register(ci_netif* ni, ci_tcp_state* ts,
+                                     void* base, size_t len);
+extern int ci_tcp_rx_region_get(ci_netif* ni, ci_tcp_state* ts,
+                                size_t* offset);
+extern int ci_tcp_rx_region_release(ci_netif* ni, ci_tcp_state* ts,
+                                    size_t len);
+extern void ci_tcp_rx_region_deliver(ci_netif* ni, ci_tcp_state* ts);
+
 extern enum onload_delegated_send_rc
 ci_tcp_ds_fill_headers(ci_netif* ni, ci_tcp_state* ts, unsigned flags,
                        void* headers, int* headers_len_inout,
@@ -1019,7 +1114,7 @@ extern void ci_udp_all_fds_gone(ci_netif* netif, oo_sp, int do_free);
 extern void ci_udp_state_free(ci_netif*, ci_udp_state*) CI_HF;
 extern int ci_udp_csum_correct(ci_ip_pkt_fmt* pkt, ci_udp_hdr* udp) CI_HF;
 
-extern void ci_udp_sendmsg_send_async_q(ci_netif*, ci_udp_state*) CI_HF;
+extern void ci_netif_udp_tx_stage_drain(ci_netif*) CI_HF;
 extern void ci_udp_perform_deferred_socket_work(ci_netif*, ci_udp_state*)CI_HF;
 extern int ci_udp_try_to_free_pkts(ci_netif*, ci_udp_state*,
                                     int desperation) CI_HF;
@@ -1064,6 +1159,27 @@ extern int ci_pipe_list_to_iovec(ci_netif* ni, struct oo_pipe* p,
                                  int* iov_num,
                                  struct ci_pipe_pkt_list* pkts,
                                  int len);
+extern int ci_pipe_write_flags(ci_netif*, struct oo_pipe*, const struct iovec*,
+                               size_t iovlen, int flags) CI_HF;
+
+#ifndef __KERNEL__
+/* splice() and tee() between Onload pipes and TCP sockets */
+extern int ci_pipe_tee(ci_netif* ni, struct oo_pipe* pipe_src,
+                       struct oo_pipe* pipe_dest, int len, int flags) CI_HF;
+extern int ci_pipe_splice_from_tcp(ci_netif* ni, struct oo_pipe* p,
+                                   ci_tcp_state* ts, int len) CI_HF;
+extern int ci_pipe_splice_to_tcp(ci_netif* ni, struct oo_pipe* p,
+                                 ci_tcp_state* ts, int len, int flags) CI_HF;
+extern int ci_tcp_splice_recv(ci_netif* ni, ci_tcp_state* ts, int len,
+                              int max_pkts,
+                              struct ci_pipe_pkt_list* pkts) CI_HF;
+extern int ci_tcp_splice_send_space(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern int ci_tcp_splice_pkt_ok(ci_netif* ni, ci_tcp_state* ts,
+                                ci_ip_pkt_fmt* pkt, ci_uint8* payload,
+                                int len) CI_HF;
+extern int ci_tcp_splice_send(ci_netif* ni, ci_tcp_state* ts,
+                              struct ci_pipe_pkt_list* pkts, int flags) CI_HF;
+#endif
 #endif
 
 
@@ -1625,7 +1741,12 @@ extern const char* ci_tcp_congstate_str(unsigned state) CI_HF;
 
 extern void ci_tcp_handle_rx(ci_netif*, struct ci_netif_poll_state*,
                              ci_ip_pkt_fmt*, ci_tcp_hdr*, int ip_paylen) CI_HF;
+extern void ci_tcp_handle_rx_gro(ci_netif*, struct ci_netif_poll_state*,
+                                 ci_ip_pkt_fmt*, ci_tcp_hdr*, int ip_paylen,
+                                 ci_uint32 end_seq) CI_HF;
 extern void ci_tcp_rx_deliver2(ci_tcp_state*,ci_netif*,ciip_tcp_rx_pkt*) CI_HF;
+extern void ci_tcp_rx_sack_process(ci_netif*, ci_tcp_state*,
+                                   ciip_tcp_rx_pkt*) CI_HF;
 
 extern void ci_tcp_tx_change_mss(ci_netif*, ci_tcp_state*) CI_HF;
 extern void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
@@ -1638,15 +1759,33 @@ extern int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
 extern int ci_tcp_unsacked_segments_in_flight(ci_netif*, ci_tcp_state*) CI_HF;
 extern int ci_tcp_retrans_one(ci_tcp_state* ts, ci_netif* netif,
                               ci_ip_pkt_fmt* pkt) CI_HF;
+#define CI_TCP_RETRANS_RACK 2  /* [before_sacked_only] for RACK */
 extern int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
                           int before_sacked_only, int* seq_used) CI_HF;
 extern void ci_tcp_retrans_recover(ci_netif* ni, ci_tcp_state* ts,
                                    int force_retrans_first) CI_HF;
 extern int /*bool*/
 ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern int /*bool*/
+ci_tcp_rack_detect_loss(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 
 extern void ci_tcp_recovered(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 
+/* Congestion control (tcp_cong.c) */
+extern const char* ci_tcp_cong_alg_name(unsigned alg) CI_HF;
+extern int ci_tcp_cong_alg_from_name(const char* name, int len) CI_HF;
+extern void ci_tcp_cong_init(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_set_alg(ci_netif* ni, ci_tcp_state* ts,
+                                unsigned alg) CI_HF;
+extern void ci_tcp_cong_avoid(ci_netif* ni, ci_tcp_state* ts,
+                              unsigned acked, int rtt) CI_HF;
+extern unsigned ci_tcp_cong_ssthresh(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_rto(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_recovered(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern ci_uint32 ci_tcp_cong_pacing_rate(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                             oo_dump_log_fn_t logger, void* log_arg) CI_HF;
+
 extern void ci_tcp_clear_sacks(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_retrans_init_ptrs(ci_netif* ni, ci_tcp_state* ts,
                                      unsigned* recover_seq_out) CI_HF;
@@ -1670,6 +1809,13 @@ extern int ci_tcp_tx_split(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_queue* qu,
 extern void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* netif) CI_HF;
 extern void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
                             unsigned right_edge, ci_uint32* p_stop_cntr) CI_HF;
+
+/* TCP pacing (tcp_tx.c) */
+extern int ci_tcp_pacing_alloc(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_pacing_free(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern int ci_tcp_pacing_set_max_rate(ci_netif* ni, ci_tcp_state* ts,
+                                      ci_uint64 rate) CI_HF;
+extern void ci_tcp_pacing_poll(ci_netif* ni) CI_HF;
 extern void ci_tcp_send_rst_with_flags(ci_netif*, ci_tcp_state*,
                                        ci_uint8 extra_flags) CI_HF;
 extern void ci_tcp_send_rst(ci_netif* netif, ci_tcp_state* ts) CI_HF;
@@ -1766,6 +1912,11 @@ ci_netif_filter_hash(ci_netif* ni, ci_addr_t laddr, unsigned lport,
                      ci_addr_t raddr, unsigned rport,
                      unsigned protocol) CI_HF;
 
+extern void
+ci_netif_filter_prefetch(ci_netif* ni, unsigned laddr, unsigned lport,
+                         unsigned raddr, unsigned rport,
+                         unsigned protocol) CI_HF;
+
 extern int
 ci_netif_filter_insert(ci_netif* netif, oo_sp sock_id, int af_space,
                        const ci_addr_t laddr, unsigned lport,
@@ -2785,6 +2936,73 @@ ci_inline int ci_netif_need_poll_maybe_spinning(ci_netif* ni, ci_uint64 frc_now,
     return ci_netif_need_poll_frc(ni, frc_now);
 }
 
+
+/* Adaptive spinning (EF_SPIN_ADAPTIVE).
+ *
+ * Returns the number of cycles a caller should spin waiting for data on an
+ * endpoint with adaptive state [sa], given a static limit of [max_spin].
+ * With no history we spin for the full limit.  If waits are typically
+ * longer than the limit then spinning rarely pays off, so we don't spin at
+ * all; otherwise we allow twice the typical wait, rounded up so that waits
+ * shorter than the EWMA's unit still get a budget.
+ *
+ * [ni], if not NULL, is the stack whose stats show the budget.
+ */
+ci_inline ci_uint64 oo_spin_adapt_budget(ci_netif* ni,
+                                         const struct oo_spin_adapt* sa,
+                                         ci_uint64 max_spin)
+{
+  ci_uint64 gap = (ci_uint64) sa->gap_ewma << OO_SPIN_ADAPT_SHIFT;
+  ci_uint64 budget;
+
+  if( sa->hits == 0 && sa->misses == 0 )
+    budget = max_spin;
+  else if( gap >= max_spin )
+    budget = 0;
+  else
+    budget = CI_MIN((gap + (1u << OO_SPIN_ADAPT_SHIFT)) * 2, max_spin);
+  CITP_STATS_NETIF(
+    if( ni != NULL )
+      ni->state->stats.spin_adapt_budget_us =
+        CI_MIN(budget * 1000 / IPTIMER_STATE(ni)->khz,
+               (ci_uint64) 0xffffffffu);
+  );
+  return budget;
+}
+
+
+/* Records that a caller which started waiting at [start_frc] has now got
+ * data, either while spinning ([hit]) or after blocking.  Updates are not
+ * atomic: concurrent waiters may lose a sample, which is harmless.  The
+ * same goes for the stats of [ni], if not NULL.
+ */
+ci_inline void oo_spin_adapt_record(ci_netif* ni, struct oo_spin_adapt* sa,
+                                    ci_uint64 start_frc, int hit)
+{
+  ci_uint64 wait = (ci_frc64_get() - start_frc) >> OO_SPIN_ADAPT_SHIFT;
+  ci_uint32 sample = CI_MIN(wait, (ci_uint64) 0xffffffffu);
+
+  if( sa->hits == 0 && sa->misses == 0 )
+    sa->gap_ewma = sample;
+  else
+    sa->gap_ewma += (sample >> 3) - (sa->gap_ewma >> 3);
+  if( sa->hits == 0xffff || sa->misses == 0xffff ) {
+    sa->hits >>= 1;
+    sa->misses >>= 1;
+  }
+  if( hit ) {
+    ++sa->hits;
+    if( ni != NULL )
+      CITP_STATS_NETIF_INC(ni, spin_adapt_hits);
+  }
+  else {
+    ++sa->misses;
+    if( ni != NULL )
+      CITP_STATS_NETIF_INC(ni, spin_adapt_misses);
+  }
+}
+
+
 ci_inline int ci_netif_should_allocate_tcp_shared_local_ports(ci_netif* ni)
 {
   return
@@ -3641,6 +3859,13 @@ ci_inline void ci_tcp_delack_soon(ci_netif* netif, ci_tcp_state* ts)
 
 #if CI_CFG_TAIL_DROP_PROBE
 
+/* RACK-TLP (RFC 8985).  RACK learns which segments were delivered from
+ * SACK, and relies on the TLP timer to detect loss at the tail. */
+ci_inline int ci_tcp_rack_enabled(const ci_netif* ni, const ci_tcp_state* ts)
+{
+  return NI_OPTS(ni).tcp_rack && (ts->tcpflags & CI_TCPT_FLAG_SACK);
+}
+
 ci_inline int ci_tcp_taildrop_probe_enabled(const ci_netif* ni,
                                             const ci_tcp_state* ts)
 {
@@ -3695,6 +3920,11 @@ ci_inline unsigned ci_tcp_taildrop_timeout(const ci_netif* netif,
 
 #else
 
+ci_inline int ci_tcp_rack_enabled(const ci_netif* ni, const ci_tcp_state* ts)
+{
+  return 0;
+}
+
 ci_inline int ci_tcp_taildrop_probe_enabled(const ci_netif* ni,
                                             const ci_tcp_state* ts)
 {
@@ -4061,6 +4291,47 @@ ci_inline ci_uint32 ci_tcp_base_dupack_thresh(ci_tcp_state *ts) {
   return CI_CFG_TCP_DUPACK_THRESH_BASE;
 }
 
+/* RACK reordering window (RFC 8985 section 6.2 step 4).  We don't track
+ * min_RTT, so srtt stands in for it.  Until reordering has been seen the
+ * window closes once the dupack threshold is reached, so RACK never waits
+ * longer than the classic algorithm would.
+ *
+ * tx_time and srtt are in ticks of roughly a millisecond, so on a LAN srtt
+ * is usually zero and srtt/4 is zero below 4 ticks.  An open window is
+ * therefore at least CI_TCP_RACK_REO_WND_MIN ticks: a segment sent late in
+ * one tick and SACKed early in the next has really only waited a fraction
+ * of a tick, so two are needed to be sure that a whole one has passed.
+ */
+#define CI_TCP_RACK_REO_WND_MIN  2
+
+ci_inline ci_iptime_t ci_tcp_rack_reo_wnd(ci_tcp_state* ts)
+{
+  ci_iptime_t srtt = tcp_srtt(ts);
+  if( ! (ts->tcpflags & CI_TCPT_FLAG_RACK_REORDER) &&
+      (ts->congstate == CI_TCP_CONG_FAST_RECOV ||
+       ts->dup_acks >= ci_tcp_base_dupack_thresh(ts)) )
+    return 0;
+  return CI_MAX(CI_MIN(ts->rack_reo_mult * (srtt >> 2), srtt),
+                CI_TCP_RACK_REO_WND_MIN);
+}
+
+/* Returns how many ticks remain before RACK deems [pkt] lost, or zero if
+ * it is lost already (RFC 8985 section 6.2 step 5, with srtt in place of
+ * RACK.rtt).  Returns -1 if [pkt] was sent after the most recently
+ * delivered segment, in which case only a later delivery can show it lost.
+ */
+ci_inline ci_int32 ci_tcp_rack_wait(ci_netif* ni, ci_tcp_state* ts,
+                                    const ci_ip_pkt_fmt* pkt,
+                                    ci_iptime_t reo_wnd)
+{
+  ci_int32 wait;
+  if( TIME_GT(pkt->pf.tcp_tx.tx_time, ts->rack_xmit_ts) )
+    return -1;
+  wait = pkt->pf.tcp_tx.tx_time + tcp_srtt(ts) + reo_wnd -
+         ci_tcp_time_now(ni);
+  return CI_MAX(wait, 0);
+}
+
 /* congestion control functions */
 
 /* set the initial congestion window as in rfc3390/rfc2581/rfc2001 */ 
@@ -4100,6 +4371,7 @@ ci_inline void ci_tcp_set_initialcwnd(ci_netif* ni, ci_tcp_state* ts) {
    * processed the options, so this is OK. */
   ci_assert_le(ts->snd_wscl, CI_TCP_WSCL_MAX);
   ts->ssthresh = 65535 << ts->snd_wscl;
+  ci_tcp_cong_init(ni, ts);
 }
 
 /*! ?? \TODO should we use fackets to make things more exact ? */ 
@@ -4293,11 +4565,82 @@ ci_inline int  ci_sock_is_locked(ci_netif* ni, citp_waitable* w)
 
 /* Use this if you don't own the [get] lock. */
 #define ci_tcp_acceptq_n(tls)			\
-  ((tls)->acceptq_n_in - (tls)->acceptq_n_out)
+  ((tls)->acceptq_n_in - (tls)->acceptq_n_out - (tls)->acceptq_ring_deq)
+
+#define ci_tcp_acceptq_ring_not_empty(tls)                              \
+  ((tls)->acceptq_ring_deq != (tls)->acceptq_ring_enq)
 
 /* Use this if you do own the [get] lock. */
 #define ci_tcp_acceptq_not_empty(tls)                                   \
-  (((tls)->acceptq_put >= 0) | OO_SP_NOT_NULL((tls)->acceptq_get))
+  (((tls)->acceptq_put >= 0) | OO_SP_NOT_NULL((tls)->acceptq_get) |    \
+   ci_tcp_acceptq_ring_not_empty(tls))
+
+
+ci_inline void ci_tcp_acceptq_ring_init(ci_tcp_socket_listen* tls)
+{
+  int i;
+  tls->acceptq_ring_enq = tls->acceptq_ring_deq = 0;
+  for( i = 0; i < CI_CFG_TCP_ACCEPT_RING_SIZE; ++i ) {
+    tls->acceptq_ring[i].seq = i;
+    tls->acceptq_ring[i].sp = OO_SP_NULL;
+  }
+  for( i = 0; i < CI_CFG_TCP_ACCEPT_SHARDS; ++i )
+    tls->accept_shard_n[i] = 0;
+}
+
+
+/* Publish [w] to the accept ring.  Only the holder of the stack lock adds
+ * to the ring, so there is a single producer.  Returns false if the ring
+ * is full.
+ *
+ * [acceptq_n_in] is bumped before the slot is published: a consumer may
+ * advance [acceptq_ring_deq] as soon as it sees the slot, and
+ * ci_tcp_acceptq_n() must never go negative.
+ */
+ci_inline int ci_tcp_acceptq_ring_put(ci_netif* ni,
+                                      ci_tcp_socket_listen* tls,
+                                      citp_waitable* w) {
+  ci_uint32 pos = tls->acceptq_ring_enq;
+  unsigned i = pos & (CI_CFG_TCP_ACCEPT_RING_SIZE - 1);
+  ci_assert(ci_netif_is_locked(ni));
+  if( OO_ACCESS_ONCE(tls->acceptq_ring[i].seq) != pos )
+    return 0;
+  tls->acceptq_ring[i].sp = W_SP(w);
+  ci_atomic32_inc(&tls->acceptq_n_in);
+  ci_wmb();
+  tls->acceptq_ring[i].seq = pos + 1;
+  tls->acceptq_ring_enq = pos + 1;
+  return 1;
+}
+
+
+/* Claim a connection from the accept ring.  Needs no lock, and may race
+ * with other consumers.  Returns NULL if the ring is empty.
+ */
+ci_inline citp_waitable* ci_tcp_acceptq_ring_get(ci_netif* ni,
+                                                 ci_tcp_socket_listen* tls) {
+  ci_uint32 pos, seq;
+  unsigned i;
+  oo_sp sp;
+  while( 1 ) {
+    pos = OO_ACCESS_ONCE(tls->acceptq_ring_deq);
+    i = pos & (CI_CFG_TCP_ACCEPT_RING_SIZE - 1);
+    seq = OO_ACCESS_ONCE(tls->acceptq_ring[i].seq);
+    if( (ci_int32) (seq - (pos + 1)) < 0 )
+      return NULL;
+    if( seq == pos + 1 ) {
+      /* The producer wrote [sp] before [seq]. */
+      ci_rmb();
+      sp = tls->acceptq_ring[i].sp;
+      if( ! ci_cas32u_fail(&tls->acceptq_ring_deq, pos, pos + 1) )
+        break;
+    }
+  }
+  /* Hand the slot back to the producer for the next lap. */
+  ci_mb();
+  tls->acceptq_ring[i].seq = pos + CI_CFG_TCP_ACCEPT_RING_SIZE;
+  return SP_TO_WAITABLE(ni, sp);
+}
 
 
 ci_inline void ci_tcp_acceptq_put(ci_netif* ni,
@@ -4305,11 +4648,35 @@ ci_inline void ci_tcp_acceptq_put(ci_netif* ni,
 				  citp_waitable* w) {
   ci_assert(OO_SP_IS_NULL(w->wt_next));
   ci_assert(ci_netif_is_locked(ni));
+  if( NI_OPTS(ni).tcp_accept_ring ) {
+    if( ci_tcp_acceptq_ring_put(ni, tls, w) )
+      return;
+    CITP_STATS_NETIF_INC(ni, tcp_accept_ring_full);
+  }
+  /* Count it before it becomes visible to ci_tcp_acceptq_get(). */
+  ci_atomic32_inc(&tls->acceptq_n_in);
+  do
+    w->wt_next = OO_SP_FROM_INT(ni, tls->acceptq_put);
+  while( ci_cas32_fail(&tls->acceptq_put,
+                       OO_SP_TO_INT(w->wt_next), W_ID(w)) );
+}
+
+
+/* Requeue a connection that was claimed from the accept ring but could
+ * not be accepted.  It goes to the tail of the [put] list, so counts as
+ * having been put again.  Must hold the sock lock.
+ */
+ci_inline void ci_tcp_acceptq_ring_put_back(ci_netif* ni,
+                                            ci_tcp_socket_listen* tls,
+                                            citp_waitable* w) {
+  ci_assert(ci_sock_is_locked(ni, &tls->s.b));
+  ci_assert(w->sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ);
+  ci_assert(OO_SP_IS_NULL(w->wt_next));
+  ci_atomic32_inc(&tls->acceptq_n_in);
   do
     w->wt_next = OO_SP_FROM_INT(ni, tls->acceptq_put);
   while( ci_cas32_fail(&tls->acceptq_put,
                        OO_SP_TO_INT(w->wt_next), W_ID(w)) );
-  ++tls->acceptq_n_in;
 }
 
 
@@ -4351,14 +4718,24 @@ ci_inline void ci_tcp_acceptq_get_swizzle(ci_netif* ni,
 }
 
 
-/* Only call this if ci_tcp_acceptq_not_empty() is true. */
+/* Only call this if ci_tcp_acceptq_not_empty() is true.  Returns NULL if
+ * that was true only because of the accept ring, and lock-free accepts
+ * have since emptied it.
+ */
 ci_inline citp_waitable* ci_tcp_acceptq_get(ci_netif* ni,
 					   ci_tcp_socket_listen* tls) {
   citp_waitable* w;
   ci_assert(ci_sock_is_locked(ni, &tls->s.b) ||
             (tls->s.b.sb_aflags & CI_SB_AFLAG_ORPHAN));
+  if( ci_tcp_acceptq_ring_not_empty(tls) &&
+      (w = ci_tcp_acceptq_ring_get(ni, tls)) != NULL )
+    return w;
+  if( OO_SP_IS_NULL(tls->acceptq_get) ) {
+    if( tls->acceptq_put < 0 )
+      return NULL;
+    ci_tcp_acceptq_get_swizzle(ni, tls);
+  }
   ++tls->acceptq_n_out;
-  if( OO_SP_IS_NULL(tls->acceptq_get) )  ci_tcp_acceptq_get_swizzle(ni, tls);
   ci_assert(OO_SP_NOT_NULL(tls->acceptq_get));
   w = SP_TO_WAITABLE(ni, tls->acceptq_get);
   tls->acceptq_get = w->wt_next;
@@ -4368,7 +4745,8 @@ ci_inline citp_waitable* ci_tcp_acceptq_get(ci_netif* ni,
 
 
 #ifndef __ci_driver__
-/* Only call this if ci_tcp_acceptq_not_empty() is true. */
+/* Only call this if the [put] or [get] list is not empty.  Connections in
+ * the accept ring are not seen. */
 ci_inline ci_tcp_state* ci_tcp_acceptq_peek(ci_netif* ni,
 					    ci_tcp_socket_listen* tls) {
   ci_assert(ci_sock_is_locked(ni, &tls->s.b));
@@ -4400,6 +4778,9 @@ static inline const char* ci_tcp_aux_type2str(int type)
     case CI_TCP_AUX_TYPE_SYNRECV: return "syn-recv state";
     case CI_TCP_AUX_TYPE_BUCKET:  return "syn-recv bucket";
     case CI_TCP_AUX_TYPE_EPOLL: return "epoll3 state";
+    case CI_TCP_AUX_TYPE_PMTUS: return "pmtu state";
+    case CI_TCP_AUX_TYPE_RX_REGION: return "rx region";
+    case CI_TCP_AUX_TYPE_PACING: return "pacing state";
     default: return "unknown";
   }
 }
@@ -4434,6 +4815,18 @@ ci_inline ci_pmtu_state_t* ci_ni_aux_p2pmtus(ci_netif* ni, oo_p oop)
   ci_assert_equal(aux->type, CI_TCP_AUX_TYPE_PMTUS);
   return &aux->u.pmtus;
 }
+ci_inline ci_tcp_rx_region* ci_ni_aux_p2rx_region(ci_netif* ni, oo_p oop)
+{
+  ci_ni_aux_mem* aux = ci_ni_aux_p2aux(ni, oop);
+  ci_assert_equal(aux->type, CI_TCP_AUX_TYPE_RX_REGION);
+  return &aux->u.rx_region;
+}
+ci_inline ci_tcp_pacing_state* ci_ni_aux_p2pacing(ci_netif* ni, oo_p oop)
+{
+  ci_ni_aux_mem* aux = ci_ni_aux_p2aux(ni, oop);
+  ci_assert_equal(aux->type, CI_TCP_AUX_TYPE_PACING);
+  return &aux->u.pacing;
+}
 
 ci_inline oo_p ci_ni_aux2p(ci_netif* ni, ci_ni_aux_mem* aux)
 {
@@ -4464,6 +4857,10 @@ ci_inline void ci_sb_epoll_free(ci_netif* ni, ci_sb_epoll_state* epoll) {
 ci_inline void ci_pmtu_state_free(ci_netif* ni, ci_pmtu_state_t* pmtus) {
   ci_ni_aux_free(ni, CI_CONTAINER(ci_ni_aux_mem, u.pmtus, pmtus));
 }
+ci_inline void ci_tcp_rx_region_free(ci_netif* ni, ci_tcp_state* ts) {
+  ci_ni_aux_free(ni, ci_ni_aux_p2aux(ni, ts->rx_region));
+  ts->rx_region = OO_PP_NULL;
+}
 
 extern void ci_ni_aux_more_bufs(ci_netif* ni);
 ci_inline int/*bool*/ ci_ni_aux_can_alloc(ci_netif* ni, int type)
@@ -4939,6 +5336,9 @@ ci_inline void ci_tcp_recvmsg_args_init(ci_tcp_recvmsg_args* a,
   a->ts = ts;
   a->msg = msg;
   a->flags = flags;
+#ifndef __KERNEL__
+  a->spin_adapt = NULL;
+#endif
 }
 
 
@@ -4954,15 +5354,35 @@ ci_inline ci_uint16 oo_tcpdump_queue_len(ci_netif* ni)
   return ni->state->dump_write_i - ni->state->dump_read_i;
 }
 
+/** Bytes of packet data in the capture ring for a given
+ * EF_TCPDUMP_RING_SIZE. */
+ci_inline ci_uint32 oo_tcpdump_ring_data_size(ci_uint32 opt_size)
+{
+  return opt_size == 0 ? 0 : 1u << ci_log2_ge(opt_size, 16);
+}
+
+/** Is onload_tcpdump reading packets from the capture ring? */
+ci_inline int oo_tcpdump_ring_active(ci_netif* ni)
+{
+  return ni->dump_ring != NULL && ni->dump_ring->active;
+}
+
+/* Is there room to dump a packet?  Space in the capture ring is checked
+ * when the packet is copied. */
+ci_inline int oo_tcpdump_has_space(ci_netif* ni)
+{
+  if( oo_tcpdump_ring_active(ni) ||
+      oo_tcpdump_queue_len(ni) < CI_CFG_DUMPQUEUE_LEN - 1 )
+    return 1;
+  CITP_STATS_NETIF_INC(ni, tcpdump_missed);
+  return 0;
+}
+
 /* Should we dump this packet? */
 ci_inline int oo_tcpdump_check(ci_netif *ni, ci_ip_pkt_fmt *pkt, int intf_i)
 {
-  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_ALL ) {
-    if( oo_tcpdump_queue_len(ni) < CI_CFG_DUMPQUEUE_LEN - 1 )
-      return 1;
-    else
-      CITP_STATS_NETIF_INC(ni, tcpdump_missed);
-  }
+  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_ALL )
+    return oo_tcpdump_has_space(ni);
   return 0;
 }
 
@@ -4970,18 +5390,21 @@ ci_inline int oo_tcpdump_check(ci_netif *ni, ci_ip_pkt_fmt *pkt, int intf_i)
 ci_inline int oo_tcpdump_check_no_match(ci_netif *ni, ci_ip_pkt_fmt *pkt,
                                         int intf_i)
 {
-  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_NO_MATCH ) {
-    if( oo_tcpdump_queue_len(ni) < CI_CFG_DUMPQUEUE_LEN - 1 )
-      return 1;
-    else
-      CITP_STATS_NETIF_INC(ni, tcpdump_missed);
-  }
+  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_NO_MATCH )
+    return oo_tcpdump_has_space(ni);
   return 0;
 }
 
 /* Release all the packets up to dump_read_i */
 extern void oo_tcpdump_free_pkts(ci_netif* ni, ci_uint16 i);
 
+/* Run the filter installed by onload_tcpdump; non-zero if the packet
+ * should be dumped. */
+extern int oo_tcpdump_filter(ci_netif* ni, ci_ip_pkt_fmt* pkt);
+
+/* Copy the packet to the capture ring. */
+extern void oo_tcpdump_ring_put(ci_netif* ni, ci_ip_pkt_fmt* pkt);
+
 /* Dump this packet */
 ci_inline void oo_tcpdump_dump_pkt(ci_netif *ni, ci_ip_pkt_fmt *pkt)
 {
@@ -4991,6 +5414,14 @@ ci_inline void oo_tcpdump_dump_pkt(ci_netif *ni, ci_ip_pkt_fmt *pkt)
   if(CI_UNLIKELY( pkt->flags & CI_PKT_FLAG_MSG_WARM ))
     return;
 
+  if( ni->state->dump_filter_len != 0 && ! oo_tcpdump_filter(ni, pkt) )
+    return;
+
+  if( oo_tcpdump_ring_active(ni) ) {
+    oo_tcpdump_ring_put(ni, pkt);
+    return;
+  }
+
   if( dq[write_i % CI_CFG_DUMPQUEUE_LEN] != OO_PP_NULL )
     oo_tcpdump_free_pkts(ni, write_i);
 
@@ -30,6 +30,65 @@
 
 
 
+/**********************************************************************
+************************* Latency histograms **************************
+**********************************************************************/
+
+ci_inline unsigned ci_lat_hist_bucket(ci_uint64 v)
+{
+  unsigned m;
+  if( v < CI_LAT_HIST_SUB_N )
+    return (unsigned) v;
+  m = 63 - __builtin_clzll(v);
+  if(CI_UNLIKELY( m > CI_LAT_HIST_MAX_BIT ))
+    return CI_LAT_HIST_N_BUCKETS - 1;
+  return ((m - CI_LAT_HIST_SUB_BITS + 1) << CI_LAT_HIST_SUB_BITS) |
+         ((unsigned) (v >> (m - CI_LAT_HIST_SUB_BITS)) &
+          (CI_LAT_HIST_SUB_N - 1));
+}
+
+/* Smallest value that lands in bucket [i]. */
+ci_inline ci_uint64 ci_lat_hist_bucket_lo(unsigned i)
+{
+  unsigned m;
+  if( i < CI_LAT_HIST_SUB_N )
+    return i;
+  m = (i >> CI_LAT_HIST_SUB_BITS) + CI_LAT_HIST_SUB_BITS - 1;
+  return (ci_uint64) (CI_LAT_HIST_SUB_N | (i & (CI_LAT_HIST_SUB_N - 1)))
+         << (m - CI_LAT_HIST_SUB_BITS);
+}
+
+ci_inline void ci_lat_hist_add(ci_lat_hist* h, ci_uint64 v)
+{
+  ++h->n;
+  h->sum += v;
+  if( v > h->max )
+    h->max = v;
+  ++h->bucket[ci_lat_hist_bucket(v)];
+}
+
+ci_inline void ci_netif_lat_lock_taken(ci_netif* ni)
+{
+  if(CI_UNLIKELY( ni->lat_hists != NULL ))
+    ci_frc64(&ni->lat_hists->lock_frc);
+}
+
+ci_inline void ci_netif_lat_lock_dropped(ci_netif* ni)
+{
+  if(CI_UNLIKELY( ni->lat_hists != NULL )) {
+    ci_uint64 now, taken = ni->lat_hists->lock_frc;
+    /* The lock can be taken by paths that do not stamp it, such as the
+     * kernel's lock-or-set-flags.  Those holds are not recorded. */
+    if( taken == 0 )
+      return;
+    ni->lat_hists->lock_frc = 0;
+    ci_frc64(&now);
+    if( now >= taken )
+      ci_lat_hist_add(&ni->lat_hists->lock_hold, now - taken);
+  }
+}
+
+
 /**********************************************************************
 ****************************** Netif lock *****************************
 **********************************************************************/
@@ -46,12 +105,27 @@ extern void ci_netif_unlock(ci_netif*) CI_HF;
  * called at userlevel, this is the only possible outcome.  In the kernel,
  * they return -EINTR if interrupted by a signal.
  */
-#define ci_netif_lock(ni)        ef_eplock_lock(ni)
+ci_inline int __ci_netif_lock(ci_netif* ni) OO_MUST_CHECK_RET_IN_KERNEL;
+ci_inline int __ci_netif_lock(ci_netif* ni) {
+  int rc = ef_eplock_lock(ni);
+  if( rc == 0 )
+    ci_netif_lat_lock_taken(ni);
+  return rc;
+}
+
+ci_inline int __ci_netif_trylock(ci_netif* ni) {
+  if( ! ef_eplock_trylock(&ni->state->lock) )
+    return 0;
+  ci_netif_lat_lock_taken(ni);
+  return 1;
+}
+
+#define ci_netif_lock(ni)        __ci_netif_lock(ni)
 #ifdef __KERNEL__
 #define ci_netif_lock_maybe_wedged(ni) ef_eplock_lock_maybe_wedged(ni)
 #endif
-#define ci_netif_lock_id(ni,id)  ef_eplock_lock(ni)
-#define ci_netif_trylock(ni)     ef_eplock_trylock(&(ni)->state->lock)
+#define ci_netif_lock_id(ni,id)  __ci_netif_lock(ni)
+#define ci_netif_trylock(ni)     __ci_netif_trylock(ni)
 
 #define ci_netif_lock_fdi(epi)   ci_netif_lock_id((epi)->sock.netif,    \
                                                   SC_SP((epi)->sock.s))
@@ -222,6 +222,7 @@ typedef union {
     oo_pkt_p          block_end;     /* end of the current (un)sacked block */
     oo_sp             sock_id;       /* The socket this pkt is tx'd on:
                                       * used in oo_deferred_arp_failed() */
+    ci_iptime_t       tx_time;       /* When last (re)transmitted */
 #if CI_CFG_TIMESTAMPING
     struct oo_timespec first_tx_hw_stamp; /* Timestamp of the first transmit */
 #endif
@@ -526,7 +527,11 @@ typedef struct {
 
 typedef struct {
   CI_ULCONST unsigned              table_size_mask;
-  ci_netif_filter_table_entry_fast table[1];
+  /* Next bucket to be examined by the incremental compaction pass. */
+  ci_uint32                        compact_cursor;
+  /* Lookups scan a cache-line sized bucket of entries at a time, so the
+   * table must start on a cache line. */
+  ci_netif_filter_table_entry_fast table[1] CI_ALIGN(CI_CACHE_LINE_SIZE);
 } ci_netif_filter_table;
 
 
@@ -733,6 +738,14 @@ typedef struct {
 # define CI_IP_TIMER_DEBUG_HOOK         0x9  /* Hook for timer debugging */
 # define CI_IP_TIMER_NETIF_STATS        0xa  /* netif statistics timer   */
 # define CI_IP_TIMER_TCP_CORK           0xb  /* TCP_CORK timer           */
+# define CI_IP_TIMER_TCP_COALESCED      0xc  /* TCP per-socket timer     */
+# define CI_IP_TIMER_TCP_PACING         0xd  /* TCP pacing scheduler     */
+  ci_uint16                   flags;
+  /* Timer is not put on the wheel itself; it is run by its socket's
+   * coalesced timer [ci_tcp_state::timers_tid] instead. */
+# define CI_IP_TIMER_FLAG_COALESCED     0x1
+  /* Coalesced timer is armed.  (Timers on the wheel use their link.) */
+# define CI_IP_TIMER_FLAG_PENDING       0x2
 } ci_ip_timer;
 
 
@@ -759,6 +772,7 @@ typedef struct {
   /* Fixme: compress these into ci_uint16 for each */
   oo_pkt_p              free;   /**< List of free packet buffers */
   ci_int32              n_free; /**< Number of buffers in free list */
+  CI_ULCONST ci_int32   numa_node; /**< NUMA node of the memory, or -1 */
 #if defined(CI_CFG_PKTS_AS_HUGE_PAGES)
   CI_ULCONST ci_int32   shm_id; /**< shared memory id for huge page  */
 #endif
@@ -921,6 +935,8 @@ typedef struct {
   CI_ULCONST ci_uint8   vi_nic_flags;
   CI_ULCONST ci_uint8   vi_channel;
   CI_ULCONST char       pci_dev[20];
+  /* NUMA node the NIC is attached to, or -1 if unknown. */
+  CI_ULCONST ci_int32   numa_node;
   /* Transmit overflow queue.  Packets here are ready to send. */
   oo_pktq               dmaq;
   /* Counts bytes of packet payload into and out of the TX descriptor ring. */
@@ -958,6 +974,107 @@ typedef struct {
 } ci_netif_state_nic_t;
 
 
+/* A queue of UDP datagrams waiting to be sent by the holder of the stack
+ * lock.  Any number of threads may push onto it without the lock, and the
+ * lock holder takes the whole queue at once.  Each queue has a cache line
+ * to itself so that threads using different queues don't contend.
+ */
+typedef struct {
+  /* Datagrams in reverse order.  Link field is [pkt->netif.tx.dmaq_next]. */
+  ci_int32  head CI_ALIGN(CI_CACHE_LINE_SIZE);
+} ci_udp_tx_stage;
+
+
+/* Log-linear (HDR-style) latency histogram.  Values are in frc cycles and
+ * are converted to nanoseconds only when reported.  Values below
+ * 2^CI_LAT_HIST_SUB_BITS get a bucket each; above that every power of two
+ * is split into 2^CI_LAT_HIST_SUB_BITS linear sub-buckets, so relative
+ * error is bounded by 1/2^CI_LAT_HIST_SUB_BITS.  Values of
+ * 2^(CI_LAT_HIST_MAX_BIT + 1) cycles or more land in the top octave.
+ *
+ * Updates are not atomic: concurrent recorders may occasionally lose a
+ * sample, which is acceptable for statistics of this kind.
+ */
+#define CI_LAT_HIST_SUB_BITS   3
+#define CI_LAT_HIST_SUB_N      (1u << CI_LAT_HIST_SUB_BITS)
+#define CI_LAT_HIST_MAX_BIT    35
+#define CI_LAT_HIST_N_BUCKETS                                           \
+  ((CI_LAT_HIST_MAX_BIT - CI_LAT_HIST_SUB_BITS + 2) * CI_LAT_HIST_SUB_N)
+
+typedef struct {
+  ci_uint64             n;        /* number of samples */
+  ci_uint64             sum;      /* sum of samples (cycles) */
+  ci_uint64             max;      /* largest sample (cycles) */
+  ci_uint32             bucket[CI_LAT_HIST_N_BUCKETS];
+} ci_lat_hist;
+
+/* Per-socket latency histograms, indexed by socket id. */
+typedef struct {
+  ci_lat_hist           rx_recv;  /* RX event to delivery by recv() */
+  ci_lat_hist           tx_wire;  /* TX doorbell to TX completion */
+} ci_sock_lat_hists;
+
+/* Latency histograms of a stack, enabled with EF_LATENCY_HIST.  Followed
+ * in shared memory by EF_LATENCY_HIST_SOCKETS instances of
+ * ci_sock_lat_hists.
+ */
+typedef struct {
+  ci_uint64             lock_frc; /* when the stack lock was last taken */
+  ci_lat_hist           rx_recv;
+  ci_lat_hist           tx_wire;
+  ci_lat_hist           lock_hold;
+  ci_sock_lat_hists     sock[0];
+} ci_netif_lat_hists;
+
+
+#if CI_CFG_TCPDUMP
+/* Classic BPF instruction, with the same layout as struct sock_filter and
+ * struct bpf_insn from libpcap.  The filter is run by the stack on every
+ * packet that is a candidate for onload_tcpdump.
+ */
+typedef struct {
+  ci_uint16             code;
+  ci_uint8              jt;
+  ci_uint8              jf;
+  ci_uint32             k;
+} oo_dump_bpf_insn;
+
+/* Header of a packet copied to the tcpdump capture ring.  The captured
+ * bytes follow immediately, and each record is padded to 8 bytes.  The
+ * first 8 bytes are all that is valid in a pad record, which tells the
+ * reader to continue from the start of the ring.
+ */
+typedef struct {
+  ci_uint32             rec_len;  /* header + data + padding */
+  ci_uint16             caplen;   /* bytes of packet data captured */
+  ci_uint8              intf_i;
+  ci_uint8              flags;
+#define OO_DUMP_REC_F_PAD  0x1
+#define OO_DUMP_REC_F_TX   0x2
+  ci_uint32             len;      /* length of the packet on the wire */
+  ci_uint16             vlan;
+  ci_uint16             reserved;
+  ci_uint64             tstamp_frc;
+  struct oo_timespec    hw_stamp;
+} oo_dump_rec;
+
+/* Capture ring used by onload_tcpdump in place of dump_queue, enabled with
+ * EF_TCPDUMP_RING_SIZE.  The stack copies packets into the ring under the
+ * stack lock, so the reader never holds references to packet buffers.
+ * Offsets are free-running; [size] is a power of two.
+ */
+typedef struct {
+  CI_ULCONST ci_uint32  size;     /* bytes in data[] */
+  ci_uint32             snaplen;  /* set by the reader */
+  volatile ci_uint32    active;   /* reader is attached */
+  ci_uint32             reserved;
+  volatile ci_uint64    write_off CI_ALIGN(CI_CACHE_LINE_SIZE);
+  volatile ci_uint64    read_off  CI_ALIGN(CI_CACHE_LINE_SIZE);
+  char                  data[0]   CI_ALIGN(CI_CACHE_LINE_SIZE);
+} oo_dump_ring;
+#endif
+
+
 struct ci_netif_state_s {
 
   ci_netif_state_nic_t  nic[CI_CFG_MAX_INTERFACES];
@@ -1092,6 +1209,11 @@ struct ci_netif_state_s {
   */
   ci_uint64             nonb_pkt_pool CI_ALIGN(8);
 
+  /* UDP datagrams sent while the stack lock was contended, staged until
+  ** the lock holder can send them.  See ci_netif_udp_tx_stage_drain().
+  */
+  ci_udp_tx_stage       udp_tx_stage[CI_CFG_UDP_TX_STAGE_N];
+
   ci_netif_ipid_cb_t    ipid;
 
   /* Offset to the DMAQ descriptors Falcon only. */
@@ -1105,7 +1227,11 @@ struct ci_netif_state_s {
 #endif
   CI_ULCONST ci_uint32  seq_table_ofs;   /**< offset of seq no table */
   CI_ULCONST ci_uint32  deferred_pkts_ofs; /**< offset of deferred pkts array */
-  CI_ULCONST ci_uint32  buf_ofs;         /**< offset of packet metadata */
+  CI_ULCONST ci_uint32  lat_hists_ofs;   /**< offset of latency histograms */
+#if CI_CFG_TCPDUMP
+  CI_ULCONST ci_uint32  dump_ring_ofs;   /**< offset of tcpdump capture ring */
+#endif
+  CI_ULCONST ci_uint32  buf_ofs;        /**< offset of packet metadata */
 
   ci_ip_timer_state     iptimer_state CI_ALIGN(8);
 
@@ -1118,6 +1244,19 @@ struct ci_netif_state_s {
   /* List of sockets that may have reapable buffers. */
   ci_ni_dllist_t        reap_list;
 
+  /* TCP pacing scheduler.  A socket whose next segment is held back by
+   * its pacing rate waits in the slot covering its release time; each
+   * slot spans 2^CI_TCP_PACING_SLOT_SHIFT microsecond ticks.  Slots are
+   * run from ci_netif_poll(), and [pacing_tid] makes sure they are run
+   * within a timer tick when nobody is polling.  See tcp_tx.c.
+   */
+#define CI_TCP_PACING_SLOT_SHIFT 3
+#define CI_TCP_PACING_SLOTS      128
+  ci_ni_dllist_t        pacing_slots[CI_TCP_PACING_SLOTS];
+  ci_uint32             pacing_cursor;  /**< next slot to run */
+  ci_uint32             pacing_n;       /**< sockets in [pacing_slots] */
+  ci_ip_timer           pacing_tid CI_ALIGN(8);
+
   /* RFC 5961: limit the number of challenge ACKs */
   ci_uint32     challenge_ack_num;
   ci_iptime_t   challenge_ack_time;
@@ -1157,7 +1296,9 @@ struct ci_netif_state_s {
 #define CI_TCP_AUX_TYPE_BUCKET  1
 #define CI_TCP_AUX_TYPE_EPOLL   2
 #define CI_TCP_AUX_TYPE_PMTUS   3
-#define CI_TCP_AUX_TYPE_NUM     4
+#define CI_TCP_AUX_TYPE_RX_REGION 4
+#define CI_TCP_AUX_TYPE_PACING  5
+#define CI_TCP_AUX_TYPE_NUM     6
   oo_p                  free_aux_mem;    /**< Free list of synrecv bufs. */
   ci_uint32             n_free_aux_bufs; /**< Number of free aux bufs */
   ci_uint32             n_aux_bufs[CI_TCP_AUX_TYPE_NUM];
@@ -1237,6 +1378,11 @@ struct ci_netif_state_s {
   ci_uint8              dump_intf[OO_INTF_I_NUM];
   volatile ci_uint16    dump_read_i;
   volatile ci_uint16    dump_write_i;
+  /* Filter installed by onload_tcpdump; no filter if dump_filter_len is 0. */
+  ci_uint16             dump_filter_len;
+  ci_uint16             dump_filter_flags;
+#define OO_DUMP_FILTER_F_STRIP_VLAN 0x1  /* filter sees untagged frames */
+  oo_dump_bpf_insn      dump_filter[CI_CFG_DUMP_FILTER_LEN];
 #endif
 
   ef_vi_stats           vi_stats CI_ALIGN(8);
@@ -1247,6 +1393,10 @@ struct ci_netif_state_s {
   CI_ULCONST ci_int32   creation_numa_node;
   CI_ULCONST ci_int32   load_numa_node;
   CI_ULCONST ci_uint32  packet_alloc_numa_nodes;
+  ci_uint32             pkt_numa_no_grow; /**< nodes on which a new pkt set
+                                           * landed elsewhere */
+  ci_uint8              pkt_numa_short[32]; /**< times in a row each node's
+                                             * pkt sets were short */
   CI_ULCONST ci_uint32  sock_alloc_numa_nodes;
   CI_ULCONST ci_uint32  interrupt_numa_nodes;
 
@@ -1284,6 +1434,12 @@ struct ci_netif_state_s {
   /* Timer period. */
   ci_uint64             kernel_packets_cycles          CI_ALIGN(8);
 
+  /* How far we have read the control plane's fwd-table change journal, when
+   * we last looked at it (0 for never), and how often we look. */
+  ci_uint64             cp_journal_frc                 CI_ALIGN(8);
+  ci_uint64             cp_journal_cycles              CI_ALIGN(8);
+  ci_uint32             cp_journal_pos;
+
 #if CI_CFG_PROC_DELAY
   /* Feature to measure delays between receiving packets at NIC and
    * processing them in onload.
@@ -1542,6 +1698,33 @@ typedef struct {
   ci_uint8              plateau_id;     /* index in plateau table */
 } ci_pmtu_state_t;
 
+/* Application memory registered against a TCP socket with
+ * onload_zc_rx_region_register().  In-order payload is copied into it as
+ * a byte ring.  [base] is only valid in the address space of [pid], so no
+ * other process (or the kernel) touches the ring.
+ */
+typedef struct {
+  ci_user_ptr_t         base;
+  ci_uint32             size;           /* power of 2 */
+  ci_uint32             added;          /* bytes written, by the stack */
+  ci_uint32             consumed;       /* bytes released, by the app */
+  ci_int32              pid;
+} ci_tcp_rx_region;
+
+/* Pacing state of a TCP socket, allocated when the socket first needs it
+ * (SO_MAX_PACING_RATE or EF_TCP_PACING).  While the socket is waiting in
+ * the stack's pacing scheduler, the aux buffer's link is in one of
+ * [ci_netif_state::pacing_slots].  Times are in the microsecond ticks of
+ * [ci_ip_timer_state::ci_ip_time_frc2us].
+ */
+typedef struct {
+  oo_sp                 sock_id;
+  ci_uint32             max_rate;       /* SO_MAX_PACING_RATE, bytes/s */
+  ci_uint32             rate;           /* rate in use; 0 if unpaced */
+  ci_uint32             next_us;        /* release time of next segment */
+  ci_uint8              held;           /* next segment was held back */
+} ci_tcp_pacing_state;
+
 /*! Possible return codes between cicp_user_retrieve and cicp_user_defer
     if these codes have their least significant bit set it may be worth
     re-trying the operation
@@ -2017,11 +2200,10 @@ struct  ci_udp_state_s {
   /*! Value of stamp before SO_TIMESTAMP enabled */
   ci_uint64 stamp_pre_sots CI_ALIGN(8); 
 
-  /* Linked list of UDP datagrams.  Datagrams to be sent are queued here
-   * (in reverse order) when the netif lock is contended in sendmsg().
-   * Manipulated atomically.  Link field is [pkt->netif.tx.dmaq_next].
+  /* Number of bytes in datagrams that have been staged for sending on the
+   * stack's [udp_tx_stage] queues because the netif lock was contended in
+   * sendmsg().
    */
-  ci_int32  tx_async_q;
   oo_atomic_t tx_async_q_level;
   /* Number of bytes "inflight".  i.e. Sent to interface (including
    * overflow queue) and not yet had TX event.
@@ -2230,6 +2412,8 @@ typedef struct {
     ci_tcp_listen_bucket bucket;
     ci_sb_epoll_state    epoll;
     ci_pmtu_state_t      pmtus;
+    ci_tcp_rx_region     rx_region;
+    ci_tcp_pacing_state  pacing;
   } u;
 
   /* This is not a real member.  It just brings the sizeof(ci_ni_aux_mem)
@@ -2252,7 +2436,8 @@ typedef struct {
   ci_uint16            user_mss;            /* user-provided maximum MSS */
   ci_uint8             tcp_defer_accept;    /* TCP_DEFER_ACCEPT sockopt  */
 #define OO_TCP_DEFER_ACCEPT_OFF 0xff
-
+  ci_uint8             cong_alg;            /* TCP_CONGESTION sockopt:
+                                             * EF_TCP_CONG_ALGO_*        */
 } ci_tcp_socket_cmn;
 
 
@@ -2266,6 +2451,7 @@ struct oo_tcp_socket_stats {
 #if CI_CFG_BURST_CONTROL
   ci_uint32  tx_stop_burst;   /* TX stopped by burst control       */
 #endif
+  ci_uint32  tx_stop_pacing;  /* TX stopped by pacing              */
   ci_uint32  tx_nomac_defer;  /* Deferred send waiting for ARP     */
   ci_uint32  tx_defer;        /* Deferred send to avoid lock contention */
   ci_uint32  tx_msg_warm_abort;/* Number of MSG_WARM aborted early */
@@ -2329,6 +2515,9 @@ struct ci_tcp_state_s {
    * EF_TCP_SERVER_LOOPBACK=2 mode */
 #define CI_TCPT_FLAG_LOOP_FAKE          0x20000
 
+  /* RACK has seen a segment delivered out of transmit order */
+#define CI_TCPT_FLAG_RACK_REORDER       0x40000
+
   /* Timer is running (rto timer is used) */
 #define CI_TCPT_FLAG_TAIL_DROP_TIMING   0x80000
   /* Probe sent */
@@ -2346,6 +2535,9 @@ struct ci_tcp_state_s {
    * because packet allocation failed.  Must send FIN, really. */
 #define CI_TCPT_FLAG_FIN_PENDING        0x800000
 
+  /* RACK has held off fast recovery that the dupack threshold called for */
+#define CI_TCPT_FLAG_RACK_DEFERRED      0x1000000
+
   /* flags advertised on SYN */
 # define CI_TCPT_SYN_FLAGS \
         (CI_TCPT_FLAG_WSCL | CI_TCPT_FLAG_TSO | CI_TCPT_FLAG_SACK)
@@ -2355,6 +2547,12 @@ struct ci_tcp_state_s {
   /* Path MTU data: timer, value, etc */
   oo_p pmtus;
 
+  /* Registered receive region, if any (ci_tcp_rx_region) */
+  oo_p rx_region;
+
+  /* Pacing state, if any (ci_tcp_pacing_state) */
+  oo_p pacing;
+
   /* SO_SNDBUF measured in packet buffers. */
   ci_int32            so_sndbuf_pkts;
 
@@ -2453,6 +2651,9 @@ struct ci_tcp_state_s {
 
   ci_uint8             incoming_tcp_hdr_len; /* expected TCP header length */
 
+  ci_uint8             rack_reo_mult;    /* RACK reo_wnd, in srtt/4 units  */
+  ci_uint8             rack_reo_persist; /* recoveries until reo_mult reset */
+
   ci_uint32            congrecover; /* snd_nxt when loss detected         */
   oo_pkt_p             retrans_ptr; /* next packet to retransmit          */
   ci_uint32            retrans_seq; /* seq of next packet to retransmit   */
@@ -2466,6 +2667,43 @@ struct ci_tcp_state_s {
   ci_uint32            faststart_acks; /* Bytes to ack before leaving faststart */
 #endif
 
+  /* Private state of the congestion control algorithm selected by
+   * [c.cong_alg].  Only the member for that algorithm is valid; it is
+   * (re)initialised by ci_tcp_cong_init().
+   */
+  union {
+    struct {
+      ci_uint32        w_max;       /* cwnd before the last reduction     */
+      ci_uint32        origin;      /* cwnd the cubic curve plateaus at   */
+      ci_uint32        w_est;       /* Reno-friendly window estimate      */
+      ci_uint32        epoch_ms;    /* start of this epoch; 0 if none     */
+      ci_uint32        k_ms;        /* time from epoch start to [origin]  */
+    } cubic;
+    struct {
+      ci_uint32        max_bw;      /* bottleneck bw estimate, bytes/ms   */
+      ci_uint32        full_bw;     /* max_bw when the pipe last grew     */
+      ci_uint32        min_rtt_us;  /* min RTT seen in the filter window  */
+      ci_iptime_t      min_rtt_stamp; /* when min_rtt_us was taken       */
+      ci_uint32        round_seq;   /* round ends when this is ACKed      */
+      ci_uint32        round_una;   /* snd_una at start of the round      */
+      ci_uint32        round_us;    /* time at start of the round         */
+      ci_uint32        prior_cwnd;  /* cwnd on entering loss recovery     */
+      ci_uint32        mode_us;     /* start of gain cycle/PROBE_RTT      */
+      ci_uint16        max_bw_age;  /* rounds since [max_bw] was sampled  */
+      ci_uint8         mode;        /* CI_TCP_BBR_MODE_*                  */
+# define CI_TCP_BBR_MODE_STARTUP    0
+# define CI_TCP_BBR_MODE_DRAIN      1
+# define CI_TCP_BBR_MODE_PROBE_BW   2
+# define CI_TCP_BBR_MODE_PROBE_RTT  3
+      ci_uint8         cycle_idx;   /* index into PROBE_BW gain cycle     */
+      ci_uint8         full_bw_cnt; /* rounds without significant growth  */
+    } bbr;
+  } cong;
+
+  /* RACK (RFC 8985): [tx_time] of the most recently sent segment that is
+   * known to have been delivered. */
+  ci_iptime_t          rack_xmit_ts;
+
 #if CI_CFG_TAIL_DROP_PROBE
   /* This is set to snd_nxt value when a Tail Loss Probe is sent.
    * Valid iff CI_TCPT_FLAG_TAIL_DROP_MARKED flag is set. */
@@ -2518,10 +2756,6 @@ struct ci_tcp_state_s {
   /* timestamp option fields see RFC1323 */
   ci_uint32            tsrecent;    /* TS.Recent RFC1323                  */
   ci_uint32            tslastack;   /* Last.ACK.sent RFC1323              */ 
-#ifndef NDEBUG
-  ci_uint32            tslastseq;   /* Sequence no of packet that updated tsrecent
-                                       Just being used for debugging - purge at will */
-#endif
   ci_iptime_t          tspaws;      /* last active timestamp for tsrecent */
 #define CI_TCP_TSO_WORD (CI_BSWAPC_BE32((CI_TCP_OPT_NOP       << 24u)  | \
                                         (CI_TCP_OPT_NOP       << 16u)  | \
@@ -2559,6 +2793,10 @@ struct ci_tcp_state_s {
   ci_ip_timer          stats_tid;   /* Statistics report timer            */
 #endif
   ci_ip_timer          cork_tid;    /* TCP timer for TCP_CORK/MSG_MORE   */
+  /* When EF_TCP_TIMER_COALESCE is enabled, the only one of this socket's
+   * timers to be on the wheel.  It is due no later than the earliest of
+   * the pending timers above that are flagged CI_IP_TIMER_FLAG_COALESCED. */
+  ci_ip_timer          timers_tid;
 
 
 #if CI_CFG_TCP_SOCK_STATS
@@ -2640,6 +2878,24 @@ struct ci_tcp_socket_listen_s {
   oo_sp                acceptq_get;
   ci_uint32            acceptq_n_out;
 
+  /* Lock-free accept ring (EF_TCP_ACCEPT_RING).  Promoted connections are
+  ** published here while there is room, and any number of threads may
+  ** claim them without the sock lock.  A slot is ready to fill at enqueue
+  ** position p when its seq is p, and ready to claim at dequeue position p
+  ** when its seq is p + 1.  Connections that do not fit go to the [put]
+  ** list above.  [acceptq_ring_deq] counts every connection taken from the
+  ** ring, so it is part of ci_tcp_acceptq_n().
+  */
+  ci_uint32            acceptq_ring_enq;
+  ci_uint32            acceptq_ring_deq;
+  struct {
+    ci_uint32          seq;
+    oo_sp              sp;
+  } acceptq_ring[CI_CFG_TCP_ACCEPT_RING_SIZE];
+
+  /* Connections accepted at user-level, counted per accepting thread. */
+  ci_uint32            accept_shard_n[CI_CFG_TCP_ACCEPT_SHARDS];
+
   /* For each listening socket we have a list of SYNRECV buffs, one for each
    * SYN we've received for which there hasn't yet been an ACK.  i.e. on
    * receipt of SYN we make a synrecv buf, then send the SYNACK.  The on
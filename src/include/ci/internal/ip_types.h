@@ -150,6 +150,14 @@ struct ci_netif_s {
   ci_tcp_prev_seq_t*   seq_table;
 
   struct oo_deferred_pkt* deferred_pkts;
+  /* NULL unless EF_LATENCY_HIST is enabled */
+  ci_netif_lat_hists*  lat_hists;
+#if CI_CFG_TCPDUMP
+  /* NULL unless EF_TCPDUMP_RING_SIZE is set.  The size is kept here rather
+   * than trusted from the ring header, which the reader can write. */
+  oo_dump_ring*        dump_ring;
+  ci_uint32            dump_ring_size;
+#endif
 
 #ifdef __ci_driver__
   unsigned             pkt_sets_n;
@@ -240,6 +248,14 @@ struct ci_netif_s {
   struct oof_cb_sw_filter_op *swf_update_first, *swf_update_last;
 #endif
 
+  /* While CI_NETIF_TX_BATCH_ACTIVE is set, transmit descriptors are posted
+   * without ringing the doorbell, and bit (1 << intf_i) is set for each
+   * interface that has descriptors waiting to be pushed.  See
+   * ci_netif_tx_batch_start().  Protected by the netif lock.
+   */
+  unsigned      tx_batch;
+#define CI_NETIF_TX_BATCH_ACTIVE  0x80000000u
+
   /* Used from ci_netif_poll_evq() only.  Moved here to avoid stack
    * overflow. */
   ef_request_id tx_events[EF_VI_TRANSMIT_BATCH];
@@ -261,6 +277,23 @@ struct ci_netif_s {
 };
 
 
+/* State for adaptive spinning (EF_SPIN_ADAPTIVE).  Tracks how long
+ * blocking callers have waited for data so that the spin budget can be
+ * trimmed for endpoints that only see traffic occasionally.  It is kept by
+ * each process for its own file descriptors, rather than in the stack, so
+ * that it costs nothing in the endpoint buffers.
+ */
+struct oo_spin_adapt {
+  ci_uint32             gap_ewma;  /* EWMA of wait, in 1024-cycle units */
+  /* Waits satisfied while spinning, and waits that went on to block.  Both
+   * are halved when either saturates, so their ratio tracks recent
+   * behaviour. */
+  ci_uint16             hits;
+  ci_uint16             misses;
+};
+#define OO_SPIN_ADAPT_SHIFT  10
+
+
 /*!
 ** citp_socket
 **
@@ -271,7 +304,9 @@ struct ci_netif_s {
 struct citp_socket_s {
   ci_netif*            netif;
   ci_sock_cmn*         s;
-
+#ifndef __KERNEL__
+  struct oo_spin_adapt spin_adapt;
+#endif
 };
 
 
@@ -293,6 +328,10 @@ typedef struct ci_tcp_recvmsg_args {
   ci_tcp_state*  ts;
   ci_msghdr*     msg;
   int            flags;
+#ifndef __KERNEL__
+  /* Adaptive spin state of the caller's file descriptor, or NULL. */
+  struct oo_spin_adapt* spin_adapt;
+#endif
 } ci_tcp_recvmsg_args;
 
 /* Arguments to ci_udp_sendmsg and ci_udp_recvmsg */
@@ -314,6 +353,15 @@ struct ci_netif_poll_state {
   oo_pkt_p  tx_pkt_free_list;
   oo_pkt_p* tx_pkt_free_list_insert;
   int       tx_pkt_free_list_n;
+
+  /* Receive coalescing (EF_TCP_RX_GRO): in-order TCP segments of a single
+   * connection, chained from [rx_gro_head] via frag_next, which have not
+   * yet been passed to the TCP layer.
+   */
+  ci_ip_pkt_fmt* rx_gro_head;
+  ci_ip_pkt_fmt* rx_gro_tail;
+  ci_uint32      rx_gro_end_seq;  /* sequence number following the train */
+  int            rx_gro_n;        /* number of segments in the train */
 };
 
 
@@ -93,12 +93,20 @@ CI_DEBUG(extern void ci_ip_timer_state_assert_valid(ci_netif*,
 ci_inline int ci_ip_timer_is_link_valid(ci_netif* ni, ci_ip_timer* ts)
 { return ci_ni_dllist_is_valid(ni, &ts->link); }
 
+/*! Clear a pending timer that is run by its owner's coalesced timer. */
+extern void __ci_ip_timer_clear_coalesced(ci_netif*, ci_ip_timer* ts) CI_HF;
+
 /*! Clear a timer (whether or not its pending).
 **  \param netif  A pointer to the netif for this timer
 **  \param ts     A pointer to the timer structure
 */
 ci_inline void ci_ip_timer_clear(ci_netif* netif, ci_ip_timer* ts)
 {
+  if( ts->flags & CI_IP_TIMER_FLAG_COALESCED ) {
+    if( ts->flags & CI_IP_TIMER_FLAG_PENDING )
+      __ci_ip_timer_clear_coalesced(netif, ts);
+    return;
+  }
   ci_ni_dllist_remove_safe(netif, &ts->link);
   ci_timer_busy_maybe_unset(netif, ts->time);
 }
@@ -108,7 +116,11 @@ ci_inline void ci_ip_timer_clear(ci_netif* netif, ci_ip_timer* ts)
 **  \return       0 if not pending, 1 if pending
 */
 ci_inline int ci_ip_timer_pending(ci_netif* netif, ci_ip_timer* ts)
-{ return ! ci_ni_dllist_is_self_linked(netif, &ts->link); }
+{
+  if( ts->flags & CI_IP_TIMER_FLAG_COALESCED )
+    return (ts->flags & CI_IP_TIMER_FLAG_PENDING) != 0;
+  return ! ci_ni_dllist_is_self_linked(netif, &ts->link);
+}
 
 /*! Set a non-pending ip timer
 **  \param netif  A pointer to the netif for this timer
@@ -130,8 +142,10 @@ ci_inline void ci_ip_timer_set(ci_netif* ni, ci_ip_timer* ts, ci_iptime_t t)
 */
 ci_inline void ci_ip_timer_modify(ci_netif* ni, ci_ip_timer* ts, ci_iptime_t t)
 {
-  ci_ni_dllist_remove(ni, &ts->link);
-  ci_timer_busy_maybe_unset(ni, ts->time);
+  if( ~ts->flags & CI_IP_TIMER_FLAG_COALESCED ) {
+    ci_ni_dllist_remove(ni, &ts->link);
+    ci_timer_busy_maybe_unset(ni, ts->time);
+  }
   __ci_ip_timer_set(ni, ts, t);
 }
 
@@ -142,6 +156,7 @@ ci_inline void ci_ip_timer_init(ci_netif* netif, ci_ip_timer* t,
   ci_assert_equal(CI_NETIF_PTR(netif, t_sp), (char*) &t->link);
   ci_ni_dllist_link_init(netif, &t->link, t_sp, name);
   ci_ni_dllist_self_link(netif, &t->link);
+  t->flags = 0;
 }
 
 
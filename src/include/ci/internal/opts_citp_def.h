@@ -156,6 +156,18 @@ CI_CFG_OPT("EF_EPOLL_MT_SAFE", ul_epoll_mt_safe, ci_uint32,
 "EF_UL_EPOLL=2 and EF_EPOLL_CTL_FAST=1.",
            1, , 0, 0, 1, yesno)
 
+CI_CFG_OPT("EF_EPOLL_MT", ul_epoll_mt, ci_uint32,
+"Optimise EF_UL_EPOLL=3 for many threads waiting on the same epoll set.  "
+"Sockets that become ready are dealt round-robin to the threads currently "
+"in epoll_wait() on the set, and a socket that is reported stays with the "
+"thread that reported it while it remains ready, so that level-triggered "
+"sockets are not reported to several threads at once.  Threads that block "
+"are woken one at a time, as with the kernel's EPOLLEXCLUSIVE, rather than "
+"all together.  Counts of wakeups and of the events they returned are kept "
+"in the home stack's statistics.\n"
+"This option has no effect if EF_EPOLL_MT_SAFE=1.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_WODA_SINGLE_INTERFACE", woda_single_if, ci_uint32,
 "This option alters the behaviour of onload_ordered_epoll_wait().  This "
 "function would normally ensure correct ordering across multiple interfaces. "
@@ -492,6 +504,17 @@ CI_CFG_OPT("EF_SPIN_USEC", ul_spin_usec, ci_uint32,
 OO_SPIN_BLURB,
            , , 0, MIN, MAX, time:usec)
 
+CI_CFG_OPT("EF_SPIN_ADAPTIVE", ul_spin_adaptive, ci_uint32,
+"Adapt the time spent spinning to the traffic seen by each socket and "
+"epoll set.  Onload keeps a moving average of how long blocking calls have "
+"waited for data, and spins for at most twice that average (capped by "
+"EF_SPIN_USEC).  Sockets and epoll sets that typically wait longer than "
+"EF_SPIN_USEC do not spin at all and block straight away, which avoids "
+"burning CPU on endpoints that see only occasional traffic.  Each process "
+"keeps this history for its own file descriptors.  This option is disabled "
+"by default.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_SLEEP_SPIN_USEC", sleep_spin_usec, ci_uint32, 
 "Sets the duration in microseconds of sleep after each spin iteration. "
 "Currently applies to EPOLL3 epoll_wait only. "
@@ -404,6 +404,17 @@ CI_CFG_OPT("EF_TAIL_DROP_PROBE", tail_drop_probe, ci_uint32,
 "The value from /proc/sys/net/ipv4/tcp_early_retrans is used to derive "
 "the default.",
            , , 1, 0, 1, yesno)
+
+CI_CFG_OPT("EF_TCP_RACK", tcp_rack, ci_uint32,
+"Whether to use RACK-TLP (RFC 8985) time-based loss detection for TCP.  "
+"A segment is treated as lost once a segment sent sufficiently later has "
+"been delivered, rather than after a fixed number of duplicate ACKs, so "
+"reordering of up to a quarter of the RTT does not cause a spurious fast "
+"retransmit.  The reordering window widens when D-SACKs show that "
+"retransmits were unnecessary.  Losses at the tail of a burst are found "
+"by the tail loss probe (EF_TAIL_DROP_PROBE) when that is enabled, and "
+"otherwise by the retransmit timeout.  Requires SACK.",
+           , , 0, 0, 1, yesno)
 #endif
 
 CI_CFG_OPT("EF_TCP_RST_DELAYED_CONN", rst_delayed_conn, ci_uint32,
@@ -614,6 +625,19 @@ CI_CFG_OPT("EF_COMPOUND_PAGES_MODE", compound_pages, ci_uint32,
 "  2 - do not use compound pages at all.\n",
           2, , 0, 0, 2, oneof:always;small;never)
 
+CI_CFG_OPT("EF_PKT_NUMA_LOCAL", pkt_numa_local, ci_uint32,
+"Control of whether packet buffers are kept local to the NUMA node that "
+"uses them:\n"
+"  0 - no, allocate from any packet set;\n"
+"  1 - refill each interface's receive ring from packet sets on the NIC's "
+"node, and take transmit buffers from sets on the sending thread's node "
+"(default).\n"
+"When the local sets run out, sets on other nodes are used while they have "
+"buffers to spare.  If the local shortage persists, a new set is allocated "
+"on that node while the stack is below EF_MAX_PACKETS.  See the "
+"pkt_set_numa_remote counter.",
+          1, , 1, 0, 1, yesno)
+
 #if CI_CFG_PIO
 CI_CFG_OPT("EF_PIO", pio, ci_uint32,
 "Control of whether Programmed I/O is used instead of DMA for small packets:\n"
@@ -869,6 +893,15 @@ CI_CFG_OPT("EF_DYNAMIC_ACK_THRESH", dynack_thresh, ci_uint16,
            , , 16, 0, 65535, count)
 #endif
 
+CI_CFG_OPT("EF_TCP_TIMER_COALESCE", tcp_timer_coalesce, ci_uint32,
+"When enabled, each TCP socket puts a single timer on the stack's timer "
+"wheel, due at the earliest of its retransmit, delayed-ACK, zero-window "
+"probe, keepalive and cork deadlines, rather than one timer for each.  "
+"Cancelling one of those timers is then cheap and does not touch the wheel, "
+"and the wheel holds fewer timers, which reduces the cost of moving timers "
+"between wheels in stacks with very many connections.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_CHALLENGE_ACK_LIMIT", challenge_ack_limit,
            ci_uint32,
 "Limit the number of \"challenge ACK packets\" sent as part of TCP blind "
@@ -968,6 +1001,27 @@ CI_CFG_OPT("EF_EVS_PER_POLL", evs_per_poll, ci_uint32,
 "increase the working set size (which harms cache efficiency).",
            , , 64, 0, 0x7fffffff, level)
 
+CI_CFG_OPT("EF_POLL_PREFETCH", poll_prefetch, ci_uint32,
+"When polling finds a batch of events, make a first pass over each chunk of "
+"them to prefetch the received packets' metadata and headers and the "
+"filter-table entries that their lookups will need, before handling them.  "
+"This can help when packet buffers are cold and are not consumed in address "
+"order, but costs time when they are already cached or the CPU's own "
+"prefetcher is keeping up, so it is disabled by default.  Measure with the "
+"application before enabling it.",
+           , , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_TCP_RX_GRO", tcp_rx_gro, ci_uint32,
+"Enables coalescing of received TCP segments.  When non-zero, consecutive "
+"in-order IPv4 segments of the same connection that arrive in a single poll "
+"of the event queue are chained together and passed to the TCP layer as a "
+"single unit, so that the connection lookup, ACK and window processing and "
+"socket wakeup are done once per train rather than once per segment.  The "
+"value gives the maximum number of segments in a train.  This benefits "
+"bulk receivers, but adds a little latency to the first segment in each "
+"poll, so it is disabled by default.",
+           , , 0, 0, 0x7fffffff, count)
+
 #if CI_CFG_PORT_STRIPING
 CI_CFG_OPT("EF_STRIPE_NETMASK", stripe_netmask_be32, ci_uint32,
 "Port striping is only negotiated with hosts whose IP address is on the same "
@@ -985,6 +1039,10 @@ CI_CFG_OPT("EF_SPIN_USEC", spin_usec, ci_uint32,
            "" /* documented in opts_citp_def.h */,
            ,  poll_cycles, 0, MIN, MAX, time:usec)
 
+CI_CFG_OPT("EF_SPIN_ADAPTIVE", spin_adaptive, ci_uint32,
+           "" /* documented in opts_citp_def.h */,
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_BUZZ_USEC", buzz_usec, ci_uint32,
 "Sets the timeout in microseconds for lock buzzing options.  Set to zero to "
 "disable lock buzzing (spinning).  Will buzz forever if set to -1.  Also set "
@@ -1111,6 +1169,36 @@ CI_CFG_OPT("EF_DEFER_ARP_TIMEOUT", defer_arp_timeout, ci_uint16,
 "(via ARP protocol for IPv4 or Neighbor Discovery for IPv6).",
           , , 60, 1, 600, time:sec)
 
+CI_CFG_OPT("EF_LATENCY_HIST", lat_hist, ci_uint32,
+"Whether to keep latency histograms for the stack in shared memory.  Three "
+"log-linear histograms are kept: the time from a packet's RX event being "
+"handled to its payload being consumed by a receive call, the time from a "
+"packet being handed to the NIC to its TX completion being handled, and the "
+"time the stack lock is held for.  The histograms can be read with "
+"\"onload_stackdump lat_hist\" and with the lat_hist output of "
+"onload_remote_monitor.\n"
+"Recording a sample costs a few tens of cycles.",
+           , , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_LATENCY_HIST_SOCKETS", lat_hist_socks, ci_uint32,
+"When EF_LATENCY_HIST is enabled, also keep RX and TX latency histograms for "
+"each of the first N sockets in the stack (by socket id).  Each socket needs "
+"a little over 2KiB of shared memory.",
+           , , 0, 0, 1024, count)
+
+#if CI_CFG_TCPDUMP
+CI_CFG_OPT("EF_TCPDUMP_RING_SIZE", tcpdump_ring_size, ci_uint32,
+"Size in bytes of a capture ring in shared memory used by onload_tcpdump.  "
+"When set, the stack copies each packet that passes the onload_tcpdump "
+"filter into the ring as it is sent or received, and onload_tcpdump reads "
+"the copies instead of holding references to the stack's packet buffers.  "
+"This lets a busy stack be captured without starving it of buffers.  The "
+"value is rounded up to a power of two of at least 64KiB.  When 0, the "
+"stack passes references to its packet buffers to onload_tcpdump through a "
+"short queue.",
+           , , 0, 0, 1<<26, bincount)
+#endif
+
 
 CI_CFG_OPT("EF_TCP_SNDBUF_ESTABLISHED_DEFAULT", tcp_sndbuf_est_def, ci_uint32,
 "Overrides the OS default SO_SNDBUF value for TCP sockets in the ESTABLISHED "
@@ -1250,6 +1338,25 @@ CI_CFG_OPT("EF_TCP_MIN_CWND", min_cwnd, ci_int32,
 "WARNING: Modifying this option may violate the TCP protocol.",
            ,  , 0, 0, SMAX, count)
 
+#define EF_TCP_CONG_ALGO_RENO  0
+#define EF_TCP_CONG_ALGO_CUBIC 1
+#define EF_TCP_CONG_ALGO_BBR   2
+#define EF_TCP_CONG_ALGO_NUM   3
+CI_CFG_OPT("EF_TCP_CONG_ALGO", tcp_cong_alg, ci_uint32,
+"Selects the default congestion control algorithm for TCP sockets.  "
+"Individual sockets may override this with the TCP_CONGESTION socket "
+"option, using the same names.\n"
+"  reno  - NewReno with Appropriate Byte Counting (RFC5681, RFC6582, "
+"RFC3465).\n"
+"  cubic - CUBIC (RFC8312).  The congestion window grows as a cubic "
+"function of the time since the last loss, which recovers the window "
+"much more quickly than reno on paths with a large RTT.\n"
+"  bbr   - BBR version 1.  The congestion window is derived from estimates "
+"of the bottleneck bandwidth and the minimum RTT of the path, rather than "
+"from loss.",
+           2, , EF_TCP_CONG_ALGO_RENO, 0, EF_TCP_CONG_ALGO_NUM - 1,
+           oneof:reno;cubic;bbr)
+
 #if CI_CFG_TCP_FASTSTART
 CI_CFG_OPT("EF_TCP_FASTSTART_INIT", tcp_faststart_init, ci_uint32,
 "The FASTSTART feature prevents Onload from delaying ACKs during times when "
@@ -1334,6 +1441,30 @@ CI_CFG_OPT("EF_BURST_CONTROL_LIMIT", burst_control_limit, ci_uint32,
            , , CI_CFG_TCP_BURST_CONTROL_LIMIT, MIN, MAX, count)
 #endif
 
+CI_CFG_OPT("EF_TCP_ACCEPT_RING", tcp_accept_ring, ci_uint32,
+"Whether to publish established connections to a lock-free ring on each "
+"listening socket.  When enabled, threads calling accept() take connections "
+"from the ring without locking the listening socket, which reduces "
+"contention when several threads accept from the same socket at a high "
+"rate.  Connections that arrive when the ring is full are queued on the "
+"ordinary accept queue, so connections may be accepted in a slightly "
+"different order from that in which they were established.",
+           , , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_TCP_PACING", tcp_pacing, ci_uint32,
+"Whether to pace TCP transmits.  When enabled, each connection spreads the "
+"segments it sends over the round-trip time rather than sending everything "
+"the congestion window allows in one burst.  The rate is twice cwnd/srtt in "
+"slow start and 1.2 times cwnd/srtt otherwise, or the model's pacing rate "
+"with BBR.  This avoids line-rate microbursts overflowing shallow switch "
+"buffers when sending to many receivers at once.\n"
+"Connections whose smoothed RTT is below one timer tick are not paced "
+"automatically.  A limit set with the SO_MAX_PACING_RATE socket option is "
+"honoured whatever the value of this option.\n"
+"Segments held back are released when the stack is next polled after their "
+"release time, or by the stack's timer within about a millisecond.",
+           , , 0, 0, 1, yesno)
+
 #if CI_CFG_CONG_AVOID_NOTIFIED
 CI_CFG_OPT("EF_CONG_NOTIFY_THRESH", cong_notify_thresh, ci_uint32,
 /* FIXME: need to introduce concept of burst control. */
@@ -1647,6 +1778,13 @@ CI_CFG_OPT("EF_KERNEL_PACKETS_TIMER_USEC", kernel_packets_timer_usec,
 "received by Onload but should be forwarded to the kernel.",
            , , 500, MIN, MAX, count)
 
+CI_CFG_OPT("EF_IPCACHE_REFRESH_USEC", ipcache_refresh_usec, ci_uint32,
+"Controls how often the stack looks at the control plane's journal of "
+"changed routes and neighbours.  The cached headers of the sockets that use "
+"a changed route are refreshed then, rather than on their next send.  "
+"0 disables this, leaving all revalidation to the send path.",
+           , , 1000, MIN, MAX, count)
+
 CI_CFG_OPT("EF_TCP_ISN_MODE", tcp_isn_mode, ci_uint16,
 "Selects behaviour with which Onload interacts with peers when reusing four tuples:\n"
 " * clocked - Linux compatible behaviour (default)\n"
@@ -68,6 +68,20 @@ OO_STAT("Number of network events handled by periodic timer.  Indicates your "
 OO_STAT("Number of times periodic timer could not get the stack lock.  "
         "Not severe.",
         ci_uint32, periodic_lock_contends, count)
+OO_STAT("Number of timers moved down a timer wheel when the wheel above "
+        "turned to their bucket.  This is the main cost of running the timer "
+        "wheels in stacks with very many sockets.",
+        ci_uint32, timer_cascade_moves, count)
+OO_STAT("Largest number of timers moved down the timer wheels in a single "
+        "tick.  Large values indicate poll-time spikes; see also "
+        "EF_TCP_TIMER_COALESCE.",
+        ci_uint32, timer_cascade_max, val)
+OO_STAT("Number of timers moved down the timer wheels in small batches "
+        "ahead of the wheel turning, to spread the cost of cascading.",
+        ci_uint32, timer_precascade_moves, count)
+OO_STAT("Number of times a TCP socket's coalesced timer fired when none of "
+        "its timers was due, because they had been cancelled or postponed.",
+        ci_uint32, timer_coalesced_idle, count)
 OO_STAT("Number of interrupts.  Expected if interrupt driven; otherwise "
         "suggests timeout of one kind or another.",
         ci_uint32, interrupts, count)
@@ -137,6 +151,15 @@ OO_STAT("Times a thread has blocked on a single socket.",
         ci_uint32, sock_sleeps, count)
 OO_STAT("Times a thread has enabled interrupts before blocking on a socket.",
         ci_uint32, sock_sleep_primes, count)
+OO_STAT("Times a wait with EF_SPIN_ADAPTIVE got data while spinning.",
+        ci_uint32, spin_adapt_hits, count)
+OO_STAT("Times a wait with EF_SPIN_ADAPTIVE went on to block before it got "
+        "data.  If this is large compared with spin_adapt_hits, data mostly "
+        "arrives after the spin budget is spent.",
+        ci_uint32, spin_adapt_misses, count)
+OO_STAT("Spin budget, in microseconds, most recently given to a wait by "
+        "EF_SPIN_ADAPTIVE.  Zero means that waits were not spinning at all.",
+        ci_uint32, spin_adapt_budget_us, val)
 OO_STAT("Times Onload has woken threads waiting on a socket for receive.",
         ci_uint32, sock_wakes_rx, count)
 OO_STAT("Times Onload has woken threads waiting on a socket for transmit.",
@@ -227,6 +250,20 @@ OO_STAT("Number of times TCP sendmsg() failed to find an acceleratable route.",
         ci_uint32, tcp_send_fail_noroute, count)
 OO_STAT("Number of times UDP sendmsg() contended the stack lock.",
         ci_uint32, udp_send_ni_lock_contends, count)
+OO_STAT("Number of UDP datagrams staged for sending by the stack lock holder "
+        "because UDP sendmsg() contended the stack lock.",
+        ci_uint32, udp_tx_stage_pkts, count)
+OO_STAT("Number of times the stack lock holder sent datagrams from the UDP "
+        "staging queues.",
+        ci_uint32, udp_tx_stage_drains, count)
+OO_STAT("Maximum number of datagrams found on a single UDP staging queue.",
+        ci_uint32, udp_tx_stage_depth_max, val)
+OO_STAT("Maximum number of datagrams sent in a single drain of the UDP "
+        "staging queues.",
+        ci_uint32, udp_tx_stage_batch_max, val)
+OO_STAT("Number of UDP datagrams sent by sendmmsg() without dropping the "
+        "stack lock between datagrams.",
+        ci_uint32, udp_sendmmsg_batched, count)
 OO_STAT("Number of times getsockopt() contended the stack lock.",
         ci_uint32, getsockopt_ni_lock_contends, count)
 OO_STAT("Number of times setsockopt() contended the stack lock.",
@@ -287,6 +324,9 @@ OO_STAT("Number of entries in software-filter hash table.",
         ci_uint32, table_n_entries, val)
 OO_STAT("Number of slots occupied in software-filter hash table.",
         ci_uint32, table_n_slots, val)
+OO_STAT("Number of filter table entries moved closer to their preferred "
+        "location by the incremental compaction pass.",
+        ci_uint32, table_compact_moves, count)
 #if CI_CFG_IPV6
 OO_STAT("Max hops in the IPv6 software-filter hash table lookup.",
         ci_uint32, ipv6_table_max_hops, val)
@@ -310,7 +350,28 @@ OO_STAT("Number of tail-drop probes that were probably unnecessary.",
         ci_uint32, tail_drop_probe_unnecessary, count)
 OO_STAT("Number of tail-drop probes that probably recovered loss.",
         ci_uint32, tail_drop_probe_success, count)
+OO_STAT("Number of times RACK held off a fast retransmit that the dupack "
+        "threshold called for.",
+        ci_uint32, tcp_rack_deferred, count)
+OO_STAT("Number of held-off fast retransmits that turned out to be "
+        "unnecessary because the segment arrived out of order.",
+        ci_uint32, tcp_rack_spurious_avoided, count)
+OO_STAT("Number of times RACK entered fast recovery before the dupack "
+        "threshold was reached.",
+        ci_uint32, tcp_rack_early_recovery, count)
+OO_STAT("Number of times the RACK reordering timer detected loss.",
+        ci_uint32, tcp_rack_reo_timeouts, count)
+OO_STAT("Number of times a D-SACK widened the RACK reordering window.",
+        ci_uint32, tcp_rack_reo_wnd_grow, count)
 #endif
+OO_STAT("Number of segments from paced TCP connections that were sent "
+        "without waiting.",
+        ci_uint32, tcp_pacing_immediate, count)
+OO_STAT("Number of times a paced TCP connection had to wait for the pacing "
+        "scheduler before sending its next segment.",
+        ci_uint32, tcp_pacing_delayed, count)
+OO_STAT("Number of times the pacing scheduler released a connection.",
+        ci_uint32, tcp_pacing_releases, count)
 OO_STAT("Number of times a connection has been reset while in accept queue; "
         "not yet a fully-connected socket.",
         ci_uint32, rst_recv_acceptq, count)
@@ -444,6 +505,13 @@ OO_STAT("Number of times accept() was accelerated.",
         ci_uint32, ul_accepts, count)
 OO_STAT("Number of times accept() returned EAGAIN.",
         ci_uint32, accept_eagain, count)
+OO_STAT("Number of times accept() took a connection from the lock-free "
+        "accept ring (EF_TCP_ACCEPT_RING) without locking the listening "
+        "socket.",
+        ci_uint32, tcp_accept_ring, count)
+OO_STAT("Number of established connections queued on the locked accept "
+        "queue because the listening socket's accept ring was full.",
+        ci_uint32, tcp_accept_ring_full, count)
 OO_STAT("Number of failed aux-buffer allocations.",
         ci_uint32, aux_alloc_fails, count)
 OO_STAT("Number of failed bucket-aux-buffer allocations.",
@@ -498,6 +566,12 @@ OO_STAT("Number of deferred packets which were dropped because the OS failed "
 OO_STAT("Number of deferred packets which were dropped because of "
         "EF_DEFER_ARP_TIMEOUT timeout.",
         ci_uint32, tx_defer_pkt_drop_timeout, count)
+OO_STAT("Number of socket route caches refreshed from the control plane's "
+        "change journal, i.e. revalidations taken off the send path.",
+        ci_uint32, ipcache_journal_refresh, count)
+OO_STAT("Number of times the stack fell too far behind the control plane's "
+        "change journal and left revalidation to the send path.",
+        ci_uint32, ipcache_journal_lost, count)
 OO_STAT("Number of dropped packets because of EF_DEFER_ARP_MAX limitation.",
         ci_uint32, tx_defer_pkt_drop_limited, count)
 OO_STAT("Number of EF_EVENT_TYPE_TX_ERROR events.  A transmit failed.",
@@ -529,6 +603,17 @@ OO_STAT("Number of RX packets detected from the future.",
         ci_uint32, rx_future, count)
 OO_STAT("Number of RX packets detected from the future which did not complete.",
         ci_uint32, rx_future_rollback, count)
+OO_STAT("Number of trains of coalesced TCP segments passed to the TCP layer "
+        "(EF_TCP_RX_GRO).  The mean number of segments per train is "
+        "(rx_gro_trains + rx_gro_merged_segs) / rx_gro_trains.",
+        ci_uint32, rx_gro_trains, count)
+OO_STAT("Number of received TCP segments coalesced behind the first segment "
+        "of a train.",
+        ci_uint32, rx_gro_merged_segs, count)
+OO_STAT("Number of coalesced TCP segments that had to be handled one at a "
+        "time because the first segment of their train did not take the "
+        "fast path.",
+        ci_uint32, rx_gro_fallback_segs, count)
 OO_STAT("Number of times we've tried to free packet-buffers by reaping.  "
         "Indicates that we are very close to a memory_pressure situation.",
         ci_uint32, reap_rx_limited, count)
@@ -572,6 +657,12 @@ OO_STAT("Number of attempts to allocate packet buffer set which have failed "
         "unlikely for this to increment multiple times.  To resolve this, "
         "make huge pages available, or look into EF_PACKET_BUFFER_MODE.",
         ci_uint32, bufset_alloc_nospace, count)
+OO_STAT("Number of times a receive ring refill or a transmit allocation "
+        "wanted a packet set on its own NUMA node, found none with free "
+        "buffers, and used a set on another node, either while the "
+        "shortage was brief or because it could not allocate a set on its "
+        "own node.  See EF_PKT_NUMA_LOCAL.",
+        ci_uint32, pkt_set_numa_remote, count)
 OO_STAT("Something has requested a larger MSS than we can support in a "
         "single packet buffer; so we've reduced it.  The maximum mss has "
         "multiple possibilities depending on card version.  "
@@ -742,6 +833,24 @@ OO_STAT("Number of times when TCP SO_RCVBUF value was found to be abused "
         "by too small incoming segments even after taking measures "
         "against it",
         ci_uint32, tcp_rcvbuf_abused_badly, count)
+OO_STAT("Number of times TCP data was copied into a registered receive "
+        "region.",
+        ci_uint32, tcp_rx_region_fills, count)
+OO_STAT("Number of times TCP data could not be copied into a registered "
+        "receive region because the application had not released space.",
+        ci_uint32, tcp_rx_region_full, count)
+OO_STAT("Number of TCP receive buffers spliced into a pipe without "
+        "copying.",
+        ci_uint32, tcp_splice_rx_pkts, count)
+OO_STAT("Number of pipe buffers spliced onto a TCP send queue without "
+        "copying.",
+        ci_uint32, tcp_splice_tx_pkts, count)
+OO_STAT("Number of pipe buffers whose payload had to be moved within the "
+        "buffer to make room for the TCP headers when spliced to a socket.",
+        ci_uint32, tcp_splice_moves, count)
+OO_STAT("Number of splice() calls between a pipe and a TCP socket that "
+        "copied data because no buffers could be moved.",
+        ci_uint32, tcp_splice_copies, count)
 OO_STAT("Number of times when TCP listening socket failed to retransmit "
         "SYNACK because it failed to allocate more packet buffers "
         "(probably postponing packet buffers allocation).",
@@ -771,6 +880,18 @@ OO_STAT("Number of times a socket could be added to a epoll set with "
         "You probably want to increase EF_MAX_ENDPOINTS if this count "
         "is non-zero.",
         ci_uint32, epoll_sb_state_alloc_failed, count)
+OO_STAT("Number of times a thread blocked in epoll_wait() on a set with this "
+        "home stack was woken by the stack.",
+        ci_uint32, epoll_wakeups, count)
+OO_STAT("Number of events returned by epoll_wait() calls woken by this stack.  "
+        "With epoll_wakeups this gives the number of wakeups per event.",
+        ci_uint32, epoll_wakeup_events, count)
+OO_STAT("Number of times a thread woken by this stack found no events in its "
+        "epoll set.",
+        ci_uint32, epoll_wakeups_empty, count)
+OO_STAT("Number of sockets taken back from an idle thread's ready-list "
+        "shard (EF_EPOLL_MT).",
+        ci_uint32, epoll_shard_reclaims, count)
 OO_STAT("Number of times that fd allocation failed for a socket in this stack.",
         ci_uint32, sock_attach_fd_alloc_fail, count)
 OO_STAT("Number of times that a socket has used a MAC filter.",
@@ -82,6 +82,16 @@
  */
 #define CI_CFG_UDP_SEND_UNLOCK_OPT      1
 
+/* Number of queues on which UDP datagrams are staged when the stack lock
+ * is contended.  Each sending thread uses one of them. */
+#define CI_CFG_UDP_TX_STAGE_N           4
+
+/* Number of slots in each listening socket's lock-free accept ring
+ * (EF_TCP_ACCEPT_RING), and number of shards over which accepts are
+ * counted per thread.  Both must be powers of two. */
+#define CI_CFG_TCP_ACCEPT_RING_SIZE     32
+#define CI_CFG_TCP_ACCEPT_SHARDS        4
+
 /* Debug aids.  Off by default, as some add lots of overhead. */
 #ifndef CI_CFG_RANDOM_DROP
 #define CI_CFG_RANDOM_DROP		0
@@ -598,6 +608,8 @@
 #if CI_CFG_TCPDUMP
 /* Dump queue length, should be 2^x, x <= 16 */
 #define CI_CFG_DUMPQUEUE_LEN 128
+/* Maximum number of classic BPF instructions in a tcpdump filter */
+#define CI_CFG_DUMP_FILTER_LEN 256
 #endif /* CI_CFG_TCPDUMP */
 
 
@@ -637,6 +649,10 @@
  * are a few long-living TCP connections which use 1-10 packets from each
  * set. */
 #define CI_CFG_PKT_SET_HIGH_WATER (PKTS_PER_SET - PKTS_PER_SET / 32)
+/* Number of times in a row that the packet sets on a NUMA node must be
+ * found short, while sets on other nodes have buffers to spare, before a
+ * new set is allocated on that node.  See EF_PKT_NUMA_LOCAL. */
+#define CI_CFG_PKT_NUMA_GROW_SHORT 8
 
 #if CI_CFG_PKTS_AS_HUGE_PAGES
 /* Maximum number of packet sets; each packet set is 2Mib (huge page)
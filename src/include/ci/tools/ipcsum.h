@@ -87,6 +87,10 @@ extern unsigned ci_udp_csum_precompute(const struct ci_ip4_hdr_s* ip,
 extern unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
 				   int bytes) CI_HF;
 
+  /*! As ci_ip_csum_partial(), but always using the scalar code. */
+extern unsigned ci_ip_csum_partial_c(unsigned sum, const volatile void* in_buf,
+				     int bytes) CI_HF;
+
 
   /*! Reduce the checksum to 17 bits.  This is useful if you want to add in
   ** 16 bits at a time using ordinary 32 bit arithmetic (ie. no carry).
@@ -229,6 +233,55 @@ ci_ip_csum_copy_aligned_c(void* dest, const void* src, int n, unsigned sum)
 
 
 
+/****************************************************************************
+ * Vector implementations, chosen at runtime according to the CPU
+ ***************************************************************************/
+#if ! defined(__KERNEL__) && (defined(__x86_64__) || defined(__aarch64__))
+# define CI_HAVE_IP_CSUM_SIMD  1
+#else
+# define CI_HAVE_IP_CSUM_SIMD  0
+#endif
+
+#if CI_HAVE_IP_CSUM_SIMD
+
+struct ci_ip_csum_ops {
+  const char* name;
+  /* What ci_cpu_has_feature() must report for this to be usable, or NULL. */
+  char* feature;
+  /* Same contract as ci_ip_csum_partial(). */
+  unsigned (*partial)(unsigned sum, const volatile void* buf, int bytes);
+  /* Same contract as ci_ip_csum_copy_aligned_c(). */
+  unsigned (*copy)(void* dest, const void* src, int n, unsigned sum);
+};
+
+  /*! The implementation in use.  This is selected on first use, according
+  ** to the features reported by ci_cpu_has_feature().
+  */
+extern const struct ci_ip_csum_ops* ci_ip_csum_ops CI_HF;
+
+  /*! All of the implementations built in, best first, ending with the
+  ** scalar one and then NULL.
+  */
+extern const struct ci_ip_csum_ops* const ci_ip_csum_ops_all[] CI_HF;
+
+/* Below this many bytes the scalar code is at least as fast. */
+#define CI_IP_CSUM_SIMD_MIN  128
+
+ci_inline unsigned
+ci_ip_csum_copy_fast(void* dest, const void* src, int n, unsigned sum)
+{
+  if( n >= CI_IP_CSUM_SIMD_MIN )
+    return ci_ip_csum_ops->copy(dest, src, n, sum);
+  return ci_ip_csum_copy_aligned_c(dest, src, n, sum);
+}
+
+#else
+
+#define ci_ip_csum_copy_fast ci_ip_csum_copy_aligned_c
+
+#endif
+
+
 /****************************************************************************
  * Safe versions of functions that test dest alignment
  ***************************************************************************/
@@ -537,6 +537,15 @@ struct cp_tables_dim {
   /* Number of k8s service endpoints (front and back end) */
   ci_int32 svc_ep_max;
 
+  /* Longest-prefix-match tables.  lpm_tbl24_size is either 0, when the
+   * server does not publish them, or CP_LPM_TBL24_SIZE.  lpm_tbl8_max is
+   * in groups of CP_LPM_TBL8_SIZE entries; lpm_neigh_max must be 2^n. */
+  ci_int32 lpm_nh_max;
+  ci_int32 lpm_tbl24_size;
+  ci_int32 lpm_tbl8_max;
+  ci_int32 lpm6_node_max;
+  ci_int32 lpm_neigh_max;
+
   /* Number of fwd cache rows, must be 2^n */
   ci_uint8 fwd_ln2;
   ci_uint32 fwd_mask; /* 2^fwd_ln2 - 1 */
@@ -588,6 +597,19 @@ typedef union ci_ipx_pfx {
 } ci_ipx_pfx_t;
 
 /* Structure to hold the fwd table and related fields */
+/* Journal of changes to a fwd table.  The server appends the id of each row
+ * whose version it changes.  Clients remember how far they have read, and so
+ * can find which of their cached routes have gone stale without looking at
+ * every one.  A client which falls CP_FWD_JOURNAL_SIZE entries behind has
+ * lost track, and must assume that anything may have changed. */
+#define CP_FWD_JOURNAL_SIZE 1024
+
+struct cp_fwd_journal {
+  /* Number of entries ever written. */
+  ci_uint32 head;
+  cicp_mac_rowid_t ids[CP_FWD_JOURNAL_SIZE];
+};
+
 struct cp_fwd_table {
   /* bitmask for indexes into rows, rw_rows */
   cicp_mac_rowid_t mask; /* 2^fwd_ln2 - 1 */
@@ -595,6 +617,8 @@ struct cp_fwd_table {
   struct cp_fwd_row* rows;
   /* bitmap (set) of prefix values in table rows, see CP_FWD_PREFIX_*. */
   ci_ipx_pfx_t *prefix;
+  /* Read-only journal of changed rows. */
+  struct cp_fwd_journal* journal;
   /* Read-write fwd data, array size fwd_max */
   struct cp_fwd_rw_row* rw_rows;
 };
@@ -662,6 +686,91 @@ struct cp_svc_ep_array {
   struct cp_svc_endpoint eps[CP_SVC_BACKENDS_PER_ARRAY];
 };
 
+
+/*
+ *** Longest-prefix-match tables ***
+ */
+
+/* The server may publish a read-only snapshot of the main routing table and
+ * of the neighbour table, so that clients can resolve a fwd-cache miss
+ * without a round trip to the server.  IPv4 routes are held in a DIR-24-8
+ * table, IPv6 routes in a path-compressed binary trie.  Routes resolve to
+ * next-hop rows, which are shared between all the prefixes that use them.
+ *
+ * The tables are too big to double-buffer, so each half has its own
+ * seqlock in struct cp_lpm_hdr: odd while the server is updating, and zero
+ * until the server has published anything.  The server publishes routes
+ * only while the policy-routing rules are the default ones; otherwise it
+ * leaves route_version at zero and clients go the usual way. */
+
+struct cp_lpm_hdr {
+  cp_version_t route_version;
+  cp_version_t neigh_version;
+
+  /* Allocation state; used by the server only. */
+  ci_uint32 nh_used;
+  ci_uint32 tbl8_used;
+  ci_uint32 lpm6_used;
+};
+
+struct cp_lpm_nh {
+  ci_addr_sh_t src;
+  ci_addr_sh_t gateway;
+  /* Route MTU; 0 means the MTU of the interface. */
+  ci_mtu_t mtu;
+  ci_ifid_t ifindex;
+  ci_uint32 flags;
+/* The route is via [gateway]; otherwise it is on-link and the destination
+ * itself is the next hop. */
+#define CP_LPM_NH_FLAG_GATEWAY 0x1
+/* The prefix exists (so it shadows shorter ones) but must be resolved by
+ * the server: local, multipath, blackhole and similar routes. */
+#define CP_LPM_NH_FLAG_SLOW    0x2
+};
+
+#define CP_LPM_NH_NONE  0xffffffffu
+
+/* DIR-24-8 entry.  If EXT is set, the index is a tbl8 group; otherwise, if
+ * VALID is set, it is a next-hop row.  The depth is the length of the
+ * prefix the entry came from, and is needed to insert prefixes in any
+ * order. */
+typedef ci_uint32 cp_lpm_ent_t;
+#define CP_LPM_ENT_EXT          0x80000000u
+#define CP_LPM_ENT_VALID        0x40000000u
+#define CP_LPM_ENT_DEPTH_SHIFT  24
+#define CP_LPM_ENT_DEPTH_MASK   0x3f000000u
+#define CP_LPM_ENT_IDX_MASK     0x00ffffffu
+
+#define CP_LPM_TBL24_SIZE       (1 << 24)
+#define CP_LPM_TBL8_SIZE        256
+
+struct cp_lpm_tbl8 {
+  cp_lpm_ent_t ent[CP_LPM_TBL8_SIZE];
+};
+
+/* IPv6 trie node.  Node 0 is the root, /0, so 0 is free to mean "no
+ * child". */
+struct cp_lpm6_node {
+  ci_addr_sh_t pfx;
+  ci_uint32 child[2];
+  ci_uint32 nh;  /* CP_LPM_NH_NONE if no route ends here */
+  cicp_prefixlen_t len;
+};
+
+/* Neighbour entries live in an open-addressed hash table probed in the same
+ * way as the fwd table. */
+struct cp_lpm_neigh {
+  ci_addr_sh_t addr;
+  ci_ifid_t ifindex;
+  ci_mac_addr_t mac;
+  ci_uint8 state;
+#define CP_LPM_NEIGH_FREE     0
+#define CP_LPM_NEIGH_VALID    1
+/* Known but not usable: incomplete, failed or stale. */
+#define CP_LPM_NEIGH_INVALID  2
+#define CP_LPM_NEIGH_DELETED  3
+};
+
 #define CP_STRING_LEN 256
 
 typedef struct cp_string { char value[CP_STRING_LEN]; } cp_string_t;
@@ -727,6 +836,14 @@ struct cp_mibs {
   /* Table of k8s service backends organised by service.
    * Logically an array of arrays, each of length CP_SVC_BACKENDS_PER_ARRAY. */
   struct cp_svc_ep_array* svc_arrays;
+
+  /* Longest-prefix-match tables; single-buffered, see struct cp_lpm_hdr. */
+  struct cp_lpm_hdr* lpm;
+  struct cp_lpm_nh* lpm_nh;
+  cp_lpm_ent_t* lpm_tbl24;
+  struct cp_lpm_tbl8* lpm_tbl8;
+  struct cp_lpm6_node* lpm6;
+  struct cp_lpm_neigh* lpm_neigh;
 };
 
 
@@ -744,8 +861,9 @@ static inline size_t cp_calc_fwd_size(const struct cp_tables_dim* m)
 
 static inline size_t cp_calc_fwd_blob_size(const struct cp_tables_dim* m)
 {
-  /* blob starts with fwd table, then fwd_prefix */
-  return cp_calc_fwd_size(m) + sizeof(ci_ipx_pfx_t) * CP_FWD_PREFIX_NUM;
+  /* blob starts with fwd table, then fwd_prefix, then the journal */
+  return cp_calc_fwd_size(m) + sizeof(ci_ipx_pfx_t) * CP_FWD_PREFIX_NUM +
+         sizeof(struct cp_fwd_journal);
 }
 
 static inline size_t cp_calc_fwd_rw_size(const struct cp_tables_dim* m)
@@ -766,6 +884,58 @@ cp_fwd_prefix_within_blob(void* fwd_blob, const struct cp_tables_dim* dim)
 {
   return (ci_ipx_pfx_t*) ((char*) fwd_blob + cp_calc_fwd_size(dim));
 }
+static inline struct cp_fwd_journal*
+cp_fwd_journal_within_blob(void* fwd_blob, const struct cp_tables_dim* dim)
+{
+  return (struct cp_fwd_journal*)
+    (cp_fwd_prefix_within_blob(fwd_blob, dim) + CP_FWD_PREFIX_NUM);
+}
+
+/* Used by the server, through cp_fwd_row_update() and
+ * cp_fwd_row_version_bump().  The barrier after updating the head orders it
+ * before the next entry overwrites an old one: a reader who sees the new
+ * entry is bound to see that the head has moved on past the old one. */
+static inline void
+cp_fwd_journal_append(struct cp_fwd_journal* journal, cicp_mac_rowid_t id)
+{
+  journal->ids[journal->head % CP_FWD_JOURNAL_SIZE] = id;
+  ci_wmb();
+  journal->head++;
+  ci_wmb();
+}
+
+/* Used by clients.  Sets a bit in [filter], of [filter_bits] bits, for each
+ * row changed since [*pos], and moves [*pos] on to the head.  Returns false
+ * if entries the client needed have been overwritten, in which case the
+ * filter is incomplete and anything may have changed. */
+static inline int/*bool*/
+cp_fwd_journal_read(const struct cp_fwd_journal* journal, ci_uint32* pos,
+                    ci_uint64* filter, unsigned filter_bits)
+{
+  ci_uint32 head = OO_ACCESS_ONCE(journal->head);
+  ci_uint32 i;
+
+  ci_rmb();
+  if( head - *pos < CP_FWD_JOURNAL_SIZE ) {
+    for( i = *pos; i != head; ++i ) {
+      unsigned bit = journal->ids[i % CP_FWD_JOURNAL_SIZE] % filter_bits;
+      filter[bit / 64] |= 1ull << (bit % 64);
+    }
+    ci_rmb();
+  }
+  i = *pos;
+  *pos = OO_ACCESS_ONCE(journal->head);
+  /* The server may have lapped us while we were reading. */
+  return *pos - i < CP_FWD_JOURNAL_SIZE;
+}
+
+static inline int/*bool*/
+cp_fwd_journal_filter_test(const ci_uint64* filter, unsigned filter_bits,
+                           cicp_mac_rowid_t id)
+{
+  unsigned bit = id % filter_bits;
+  return (filter[bit / 64] >> (bit % 64)) & 1;
+}
 
 
 static inline struct cp_fwd_row*
@@ -839,6 +1009,35 @@ extern off_t cp_find_public_mib_end(const struct cp_tables_dim* dim);
 /* Set up fwd table and associated fields from the mmaped memory. */
 void cp_init_mibs_fwd_blob(void* romem, struct cp_mibs* mibs);
 
+/* Longest-prefix-match lookups.  The caller is responsible for checking the
+ * relevant version in mib->lpm before and after. */
+static inline int /*bool*/ cp_lpm_published(struct cp_mibs* mib)
+{
+  return mib->dim->lpm_tbl24_size != 0;
+}
+
+extern ci_uint32
+cp_lpm_route_lookup(struct cp_mibs* mib, const ci_addr_sh_t* dst);
+extern struct cp_lpm_neigh*
+cp_lpm_neigh_lookup(struct cp_mibs* mib, ci_ifid_t ifindex,
+                    const ci_addr_sh_t* addr);
+
+/* Server side of the above.  Routes are published as a whole: begin()
+ * empties the tables, and commit() makes the new set visible.  Neighbours
+ * are updated one at a time. */
+extern void cp_lpm_route_begin(struct cp_mibs* mib);
+extern int cp_lpm_route_add(struct cp_mibs* mib, const ci_addr_sh_t* dst,
+                            cicp_prefixlen_t pfx, const struct cp_lpm_nh* nh);
+extern void cp_lpm_route_commit(struct cp_mibs* mib);
+extern int cp_lpm_neigh_update(struct cp_mibs* mib, ci_ifid_t ifindex,
+                               const ci_addr_sh_t* addr,
+                               const ci_mac_addr_t mac, ci_uint8 state);
+/* The same, from the server's netlink messages. */
+struct nlmsghdr;
+extern int cp_lpm_nl_route(struct cp_mibs* mib, const struct nlmsghdr* nlh,
+                           ci_uint32 table);
+extern int cp_lpm_nl_neigh(struct cp_mibs* mib, const struct nlmsghdr* nlh);
+
 /* The caller is responsible for version check before and after this
  * function is called. */
 static inline cicp_rowid_t
@@ -936,6 +1135,16 @@ cp_fwd_find_row(struct cp_fwd_table* fwd_table, struct cp_fwd_key* key)
   return __cp_fwd_find_row(fwd_table, key, key, 0);
 }
 
+/* Used by the server for every change to the version of a fwd row, so
+ * that the change goes into the journal.  cp_fwd_row_update() publishes new
+ * data; cp_fwd_row_version_bump() changes the version alone, as for
+ * CICP_FWD_FLAG_STALE. */
+extern void
+cp_fwd_row_update(struct cp_fwd_table* fwd_table, cicp_mac_rowid_t id,
+                  const struct cp_fwd_data* data);
+extern void
+cp_fwd_row_version_bump(struct cp_fwd_table* fwd_table, cicp_mac_rowid_t id);
+
 extern cicp_mac_rowid_t
 __cp_fwd_find_match(struct cp_fwd_table* fwd_table, struct cp_fwd_key* key,
                     ci_uint32 weight,
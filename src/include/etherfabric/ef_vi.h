@@ -1128,6 +1128,27 @@ ef_vi_inline int ef_vi_receive_capacity(const ef_vi* vi)
 extern int ef_vi_receive_post(ef_vi* vi, ef_addr addr, ef_request_id dma_id);
 
 
+/*! \brief Initialize a batch of RX descriptors and submit them to the NIC
+**
+** \param vi      The virtual interface for which to post RX descriptors.
+** \param addrs   DMA addresses of the packet buffers, as obtained from
+**                ef_memreg_dma_addr().
+** \param dma_ids DMA ids to associate with the descriptors.
+** \param n       Number of entries in addrs and dma_ids.
+**
+** \return The number of descriptors initialized, which is less than n if
+**         the descriptor ring fills up.
+**
+** Initialize an RX descriptor for each packet buffer, then submit them all
+** with a single call to ef_vi_receive_push().  This is equivalent to
+** calling ef_vi_receive_init() for each buffer followed by
+** ef_vi_receive_push(), and has the same restriction on the number of
+** descriptors submitted to Solarflare 7000-series NICs.
+*/
+extern int ef_vi_receive_post_batch(ef_vi* vi, const ef_addr* addrs,
+                                    const ef_request_id* dma_ids, int n);
+
+
 /*! \brief _Deprecated:_ use ef_vi_receive_get_timestamp_with_sync_flags()
 ** instead.
 **
@@ -1477,6 +1498,28 @@ extern int ef_vi_transmit_init(ef_vi* vi, ef_addr addr, int bytes,
   (vi)->ops.transmitv((vi), (iov), (iov_len), (dma_id))
 
 
+/*! \brief Transmit a batch of packets, each from a single packet buffer
+**
+** \param vi      The virtual interface for which to initialize TX
+**                descriptors.
+** \param addrs   DMA addresses of the packet buffers, as obtained from
+**                ef_memreg_dma_addr().
+** \param lens    Lengths of the packets.
+** \param dma_ids DMA ids to associate with the descriptors.
+** \param n       Number of packets.
+**
+** \return The number of packets queued, which is less than n if the
+**         descriptor ring fills up.
+**
+** Initialize a TX descriptor for each packet, then submit them all to the
+** NIC with a single call to ef_vi_transmit_push().  This rings the
+** doorbell once for the whole batch.
+*/
+extern int ef_vi_transmit_batch(ef_vi* vi, const ef_addr* addrs,
+                                const int* lens,
+                                const ef_request_id* dma_ids, int n);
+
+
 /*! \brief Transmit a packet already resident in Programmed I/O
 **
 ** \param vi     The virtual interface from which to transmit.
@@ -2067,6 +2110,70 @@ extern int ef_eventq_has_many_events(const ef_vi* evq, int n_events);
   (evq)->ops.eventq_poll((evq), (evs), (evs_len))
 
 
+/*! \brief Maximum number of RX completions returned by
+**         ef_eventq_poll_batch(). */
+#define EF_VI_EVENT_BATCH_RX  64
+
+/*! \brief Maximum number of TX completions returned by
+**         ef_eventq_poll_batch(). */
+#define EF_VI_EVENT_BATCH_TX  (2 * EF_VI_TRANSMIT_BATCH)
+
+/*! \brief Flag for ef_event_batch::rx_flags: the packet was discarded,
+**         and the reason is in ef_event_batch::rx_discard. */
+#define EF_EVENT_BATCH_FLAG_DISCARD  0x80
+
+/*! \brief Flag for ef_event_batch::flags: the next event must be
+**         retrieved with ef_eventq_poll(). */
+#define EF_EVENT_BATCH_NEED_POLL  0x1
+
+/*! \brief Completions retrieved by ef_eventq_poll_batch(), as arrays */
+typedef struct {
+  /** Number of RX completions */
+  int            n_rx;
+  /** Number of TX completions */
+  int            n_tx;
+  /** EF_EVENT_BATCH_NEED_POLL or 0 */
+  unsigned       flags;
+  /** DMA ids of received packets */
+  ef_request_id  rx_rq_id[EF_VI_EVENT_BATCH_RX];
+  /** Bytes received, including any prefix.  0 in RX event merge mode,
+  ** where the length must be read with ef_vi_receive_get_bytes(). */
+  uint16_t       rx_len[EF_VI_EVENT_BATCH_RX];
+  /** EF_EVENT_FLAG_SOP, EF_EVENT_FLAG_MULTICAST and
+  ** EF_EVENT_BATCH_FLAG_DISCARD */
+  uint8_t        rx_flags[EF_VI_EVENT_BATCH_RX];
+  /** EF_EVENT_RX_DISCARD_* for discarded packets */
+  uint8_t        rx_discard[EF_VI_EVENT_BATCH_RX];
+  /** DMA ids of completed transmits */
+  ef_request_id  tx_rq_id[EF_VI_EVENT_BATCH_TX];
+} ef_event_batch;
+
+
+/*! \brief Poll an event queue, returning completions as arrays
+**
+** \param evq   The event queue to poll.
+** \param batch Updated on return with the completions retrieved.
+**
+** \return The number of events consumed from the event queue.
+**
+** Poll an event queue for RX and TX completions of the virtual interface
+** that owns it.  Completions are returned already unbundled, as arrays of
+** DMA ids, lengths and flags, which avoids handling an ef_event and
+** calling ef_vi_receive_unbundle() or ef_vi_transmit_unbundle() per
+** packet.  On x86-64 the RX events of a normal-mode virtual interface are
+** decoded two at a time with SIMD instructions.
+**
+** Only the common cases are handled: packets that fit in one buffer, and
+** TX completions without timestamps or TX alternatives.  When the next
+** event is anything else (for example a jumbo, an event for another
+** virtual interface sharing the event queue, or an overflow), this
+** function stops, sets EF_EVENT_BATCH_NEED_POLL in batch->flags, and
+** leaves the event for ef_eventq_poll().  It always does so for
+** packed-stream virtual interfaces and for NICs other than EF10.
+*/
+extern int ef_eventq_poll_batch(ef_vi* evq, ef_event_batch* batch);
+
+
 /*! \brief Returns the capacity of an event queue
 **
 ** \param vi The event queue to query.
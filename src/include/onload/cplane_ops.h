@@ -148,6 +148,10 @@ extern int oo_deferred_send(ci_netif *ni);
 void oo_deferred_free(ci_netif *ni);
 #endif
 
+/* Refresh the route caches of the sockets whose fwd rows the control plane
+ * has changed since the last call. */
+extern void cicp_ipcache_journal_refresh(ci_netif* ni);
+
 
 extern int
 cicp_user_build_fwd_key(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
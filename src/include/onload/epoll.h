@@ -77,6 +77,7 @@ struct oo_epoll1_block_on_arg {
 #define OO_EPOLL1_EVENT_ON_OTHER 2 /* OUT */
 #define OO_EPOLL1_HAS_SIGMASK    4 /* IN */
 #define OO_EPOLL1_EVENT_ON_EVQ   8 /* OUT */
+#define OO_EPOLL1_EXCLUSIVE     16 /* IN: wait on the home stack exclusively */
 };
 
 struct oo_epoll1_shared {
@@ -131,6 +132,9 @@ enum {
   OO_EPOLL1_OP_INIT,
 #define OO_EPOLL1_IOC_INIT \
   _IO(OO_EPOLL_IOC_BASE, OO_EPOLL1_OP_INIT)
+  OO_EPOLL1_OP_WAKE_ONE,
+#define OO_EPOLL1_IOC_WAKE_ONE \
+  _IO(OO_EPOLL_IOC_BASE, OO_EPOLL1_OP_WAKE_ONE)
 };
 
 #endif /* CI_CFG_USERSPACE_EPOLL */
@@ -303,6 +303,45 @@ extern int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags);
 
 
 
+/******************************************************************************
+ * Receive regions
+ ******************************************************************************/
+
+/* onload_zc_rx_region_register() registers [len] bytes of application
+ * memory at [base] against the TCP socket [fd].  [len] must be a power of
+ * two of at least one page.  Onload copies in-order payload for the
+ * connection into the region as a ring, once, on the poll path, so it is
+ * delivered as contiguous byte ranges without the application handling
+ * packet buffers or calling recv().  Passing base=NULL unregisters the
+ * region; any data not yet released is lost.
+ *
+ * onload_zc_rx_region_get() returns the number of contiguous bytes
+ * available at base + *offset.  It never blocks: if nothing is available
+ * it polls the stack, then returns -EAGAIN.  It returns 0 at end of
+ * stream, or -errno if the connection failed.  Bytes remain in the region
+ * until passed back with onload_zc_rx_region_release(), which must be
+ * called in order.  Space is reused only once released, and Onload stops
+ * copying into the region (leaving the TCP window to close) while it is
+ * full.
+ *
+ * Data in the region is not reported by poll(), select() or epoll, and is
+ * not returned by recv(), so these should not be mixed with a region on
+ * the same socket.  The region is only filled by the process that
+ * registered it; data received while another process polls the stack is
+ * picked up by the next call to onload_zc_rx_region_get().
+ *
+ * These functions return -EOPNOTSUPP for sockets other than TCP, and
+ * -ESOCKTNOSUPPORT for sockets not accelerated by Onload.
+ */
+
+extern int onload_zc_rx_region_register(int fd, void* base, size_t len);
+
+extern int onload_zc_rx_region_get(int fd, size_t* offset);
+
+extern int onload_zc_rx_region_release(int fd, size_t len);
+
+
+
 /******************************************************************************
  * Receive filtering 
  ******************************************************************************/
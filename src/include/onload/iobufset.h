@@ -100,6 +100,13 @@ ci_inline int oo_iobufset_get_shmid(struct oo_buffer_pages *pages)
 }
 #endif
 
+/*! NUMA node the pages ended up on.  Huge pages come from the SHM
+ * segment, so they need not be on the node that was asked for. */
+ci_inline int oo_iobufset_numa_node(struct oo_buffer_pages *pages)
+{
+  return page_to_nid(pages->pages[0]);
+}
+
 /*! Find memory address in buffer offset. */
 ci_inline void *oo_iobufset_ptr(struct oo_buffer_pages *pages, int offset)
 {
@@ -152,6 +159,7 @@ ci_inline void o_iobufset_resource_ref(struct oo_iobufset *iobrs)
  * Allocate oo_buffer_pagess.
  *
  * \param order      page order to allocate
+ * \param numa_node  node to allocate on, or -1 for the current node
  * \param flags      see OO_IOBUFSET_FLAG_*, in/out
  * \param pages_out  pointer to return the allocated pages
  *
@@ -162,7 +170,7 @@ ci_inline void o_iobufset_resource_ref(struct oo_iobufset *iobrs)
  * EFHW_NIC_PAGE_SIZE != PAGE_SIZE, as on PPC.
  */
 extern int
-oo_iobufset_pages_alloc(int nic_order, int *flags,
+oo_iobufset_pages_alloc(int nic_order, int numa_node, int *flags,
                         struct oo_buffer_pages **pages_out);
 extern void oo_iobufset_pages_release(struct oo_buffer_pages *);
 
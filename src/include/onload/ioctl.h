@@ -95,7 +95,7 @@ enum {
   OO_OP_TCP_PKT_WAIT,
 #define OO_IOC_TCP_PKT_WAIT         OO_IOC_W(TCP_PKT_WAIT, ci_int32)
   OO_OP_TCP_MORE_BUFS,
-#define OO_IOC_TCP_MORE_BUFS        OO_IOC_NONE(TCP_MORE_BUFS)
+#define OO_IOC_TCP_MORE_BUFS        OO_IOC_W(TCP_MORE_BUFS, ci_int32)
   OO_OP_TCP_MORE_SOCKS,
 #define OO_IOC_TCP_MORE_SOCKS       OO_IOC_NONE(TCP_MORE_SOCKS)
 
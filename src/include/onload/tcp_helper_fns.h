@@ -242,7 +242,8 @@ struct file *sock_alloc_file(struct socket *sock, int flags, void *unused);
 #endif
 
 
-extern int efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs);
+extern int efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs,
+                                     int numa_node);
 
 extern int efab_tcp_helper_more_socks(tcp_helper_resource_t* trs);
 
@@ -437,7 +438,9 @@ efab_tcp_helper_ready_list_wakeup(tcp_helper_resource_t* trs,
 {
   ci_atomic32_and(&trs->netif.state->ready_list_flags[ready_list],
                   ~CI_NI_READY_LIST_FLAG_WAKE);
-  ci_waitable_wakeup_all(&trs->ready_list_waitqs[ready_list]);
+  /* Wakes every waiter, except that only one of those waiting exclusively
+   * (OO_EPOLL1_EXCLUSIVE) is woken. */
+  ci_waitable_wakeup_one(&trs->ready_list_waitqs[ready_list]);
 
 }
 
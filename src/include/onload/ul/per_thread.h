@@ -45,6 +45,9 @@ struct oo_per_thread {
   ci_uint64                  select_nonblock_fast_frc;
   struct oo_timesync         timesync;
   unsigned                   spinstate; 
+  unsigned                   udp_tx_stage;  /* 1 + UDP staging queue index */
+  unsigned                   epoll_shard;   /* 1 + EF_EPOLL_MT shard index */
+  unsigned                   accept_shard;  /* 1 + accept counter shard */
   int                        in_vfork_child;
   void*                      vfork_scratch[OO_VFORK_SCRATCH_SIZE];
 };
@@ -17,8 +17,9 @@
 extern int ci_tcp_helper_more_socks(struct ci_netif_s*) CI_HF;
 
                                
-/*! Comment? */
-extern int ci_tcp_helper_more_bufs(struct ci_netif_s* ni) CI_HF;
+/*! Allocate a packet set on [numa_node], or on the current node if -1. */
+extern int ci_tcp_helper_more_bufs(struct ci_netif_s* ni,
+                                   int numa_node) CI_HF;
 
 /* Allocate fd for a stack; attach the stack from [from_fd] to thie new fd;
  * specialise it as a netif-fd. */
@@ -175,6 +175,40 @@ get_cpuid(int op, int *eax, int *ebx, int *ecx, int *edx)
                         : "a" (op));
 }
 
+ci_inline void
+get_cpuid_count(int op, int count, int *eax, int *ebx, int *ecx, int *edx)
+{
+  __asm__ __volatile__ ("cpuid\n\t"
+                        : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                        : "a" (op), "c" (count));
+}
+
+/* Returns the state components the OS saves and restores (XCR0), or 0 if
+ * XGETBV is not enabled. */
+static ci_uint64 get_xcr0(void)
+{
+  int eax, ebx, ecx, edx;
+  ci_uint32 lo, hi;
+
+  get_cpuid(1, &eax, &ebx, &ecx, &edx);
+  if( ! (ecx & 0x08000000) )  /* OSXSAVE */
+    return 0;
+  __asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+  return ((ci_uint64) hi << 32) | lo;
+}
+
+/* Leaf 7 = structured extended feature flags */
+static int get_cpuid7_ebx(void)
+{
+  int eax, ebx, ecx, edx;
+
+  get_cpuid(0, &eax, &ebx, &ecx, &edx);
+  if( eax < 7 )
+    return 0;
+  get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+  return ebx;
+}
+
 #else
 
 /*****************************************************************************
@@ -202,6 +236,27 @@ int ci_cpu_has_feature(char* feature)
     return ecx & 0x00000002;
 #endif
 
+#if defined(__x86_64__)
+  /* The AVX features also need the OS to save the YMM (and for AVX-512
+   * the opmask and ZMM) state. */
+  if( ! strcmp(feature, "avx2") ) {
+    if( (get_xcr0() & 0x6) != 0x6 )
+      return 0;
+    return get_cpuid7_ebx() & 0x00000020;
+  }
+  if( ! strcmp(feature, "avx512f") ) {
+    if( (get_xcr0() & 0xe6) != 0xe6 )
+      return 0;
+    return get_cpuid7_ebx() & 0x00010000;
+  }
+#endif
+
+#if defined(__aarch64__)
+  /* Advanced SIMD is mandatory on AArch64. */
+  if( ! strcmp(feature, "neon") )
+    return 1;
+#endif
+
   /* Not supported on platforms that don't implement the CPUID instruction */
   return 0;
 }
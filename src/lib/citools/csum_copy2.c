@@ -34,6 +34,11 @@ unsigned ci_ip_csum_copy2(void* dest, const void* src, int n, unsigned sum)
   ci_assert(n >= 0);
   ci_assert(CI_OFFSET(n, 2) == 0);
 
+#if CI_HAVE_IP_CSUM_SIMD
+  if( n >= CI_IP_CSUM_SIMD_MIN )
+    return ci_ip_csum_ops->copy(dest, src, n, sum);
+#endif
+
   es4 = s4 + (n >> 2);
 
   while( s4 != es4 ) {
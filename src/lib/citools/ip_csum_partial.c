@@ -17,8 +17,8 @@
 #include <ci/net/ipv4.h>
 
 
-unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
-			    int bytes)
+unsigned ci_ip_csum_partial_c(unsigned sum, const volatile void* in_buf,
+			      int bytes)
 {
   const ci_uint16* buf = (const ci_uint16*) in_buf;
 
@@ -38,4 +38,15 @@ unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
   return sum;
 }
 
+
+unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
+			    int bytes)
+{
+#if CI_HAVE_IP_CSUM_SIMD
+  if( bytes >= CI_IP_CSUM_SIMD_MIN )
+    return ci_ip_csum_ops->partial(sum, in_buf, bytes);
+#endif
+  return ci_ip_csum_partial_c(sum, in_buf, bytes);
+}
+
 /*! \cidoxg_end */
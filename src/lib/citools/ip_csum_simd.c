@@ -0,0 +1,291 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+**  \brief  Vector implementations of Internet checksum and checksum-copy.
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_citools */
+
+#include "citools_internal.h"
+#include <ci/tools/cpu_features.h>
+
+#if CI_HAVE_IP_CSUM_SIMD
+
+/* The kernels all sum the buffer as little-endian 32-bit words into 64-bit
+ * lanes, which cannot overflow for any buffer we would checksum.  That is
+ * congruent modulo 0xffff with summing 16-bit words, which is all that
+ * matters once the checksum is folded.  Whatever is left over after the
+ * last full vector is handed to the scalar code, which keeps the handling
+ * of odd bytes in one place.
+ */
+
+
+/* Fold to 16 bits with end-around carry.  The result is zero only if [x]
+ * is, so a non-zero partial sum never turns into the other zero. */
+ci_inline unsigned ci_ip_csum_fold64_16(ci_uint64 x)
+{
+  x = (x & 0xffffffffu) + (x >> 32);
+  x = (x & 0xffffffffu) + (x >> 32);
+  x = (x & 0xffff) + (x >> 16);
+  x = (x & 0xffff) + (x >> 16);
+  return (unsigned) ((x & 0xffff) + (x >> 16));
+}
+
+
+ci_inline ci_uint32 ci_ip_csum_fold64_32(ci_uint64 x)
+{
+  x = (x & 0xffffffffu) + (x >> 32);
+  return (ci_uint32) ((x & 0xffffffffu) + (x >> 32));
+}
+
+
+static unsigned
+ci_ip_csum_copy_c_fn(void* dest, const void* src, int n, unsigned sum)
+{
+  return ci_ip_csum_copy_aligned_c(dest, src, n, sum);
+}
+
+
+static const struct ci_ip_csum_ops ci_ip_csum_ops_c = {
+  .name    = "scalar",
+  .feature = NULL,
+  .partial = ci_ip_csum_partial_c,
+  .copy    = ci_ip_csum_copy_c_fn,
+};
+
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static ci_uint64 ci_ip_csum_avx2_reduce(__m256i acc)
+{
+  __m128i s = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                            _mm256_extracti128_si256(acc, 1));
+  return (ci_uint64) _mm_cvtsi128_si64(s) + (ci_uint64) _mm_extract_epi64(s, 1);
+}
+
+
+__attribute__((target("avx2")))
+static unsigned
+ci_ip_csum_partial_avx2(unsigned sum, const volatile void* in_buf, int bytes)
+{
+  const char* p = (const char*) in_buf;
+  __m256i zero = _mm256_setzero_si256();
+  __m256i acc0 = zero, acc1 = zero;
+
+  while( bytes >= 32 ) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) p);
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v, zero));
+    p += 32;
+    bytes -= 32;
+  }
+  sum = ci_ip_csum_fold64_16(ci_ip_csum_avx2_reduce(
+                               _mm256_add_epi64(acc0, acc1)) + sum);
+  return ci_ip_csum_partial_c(sum, p, bytes);
+}
+
+
+__attribute__((target("avx2")))
+static unsigned
+ci_ip_csum_copy_avx2(void* dest, const void* src, int n, unsigned sum)
+{
+  char* d = (char*) dest;
+  const char* s = (const char*) src;
+  __m256i zero = _mm256_setzero_si256();
+  __m256i acc0 = zero, acc1 = zero;
+
+  while( n >= 32 ) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) s);
+    _mm256_storeu_si256((__m256i*) d, v);
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v, zero));
+    s += 32;
+    d += 32;
+    n -= 32;
+  }
+  ci_add_carry32(sum, ci_ip_csum_fold64_32(ci_ip_csum_avx2_reduce(
+                                             _mm256_add_epi64(acc0, acc1))));
+  return ci_ip_csum_copy_aligned_c(d, s, n, sum);
+}
+
+
+static const struct ci_ip_csum_ops ci_ip_csum_ops_avx2 = {
+  .name    = "avx2",
+  .feature = "avx2",
+  .partial = ci_ip_csum_partial_avx2,
+  .copy    = ci_ip_csum_copy_avx2,
+};
+
+
+__attribute__((target("avx512f")))
+static unsigned
+ci_ip_csum_partial_avx512(unsigned sum, const volatile void* in_buf,
+                          int bytes)
+{
+  const char* p = (const char*) in_buf;
+  __m512i zero = _mm512_setzero_si512();
+  __m512i acc0 = zero, acc1 = zero;
+
+  while( bytes >= 64 ) {
+    __m512i v = _mm512_loadu_si512((const void*) p);
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(v, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(v, zero));
+    p += 64;
+    bytes -= 64;
+  }
+  sum = ci_ip_csum_fold64_16(
+          (ci_uint64) _mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1))
+          + sum);
+  return ci_ip_csum_partial_c(sum, p, bytes);
+}
+
+
+__attribute__((target("avx512f")))
+static unsigned
+ci_ip_csum_copy_avx512(void* dest, const void* src, int n, unsigned sum)
+{
+  char* d = (char*) dest;
+  const char* s = (const char*) src;
+  __m512i zero = _mm512_setzero_si512();
+  __m512i acc0 = zero, acc1 = zero;
+
+  while( n >= 64 ) {
+    __m512i v = _mm512_loadu_si512((const void*) s);
+    _mm512_storeu_si512((void*) d, v);
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(v, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(v, zero));
+    s += 64;
+    d += 64;
+    n -= 64;
+  }
+  ci_add_carry32(sum, ci_ip_csum_fold64_32((ci_uint64)
+                   _mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1))));
+  return ci_ip_csum_copy_aligned_c(d, s, n, sum);
+}
+
+
+static const struct ci_ip_csum_ops ci_ip_csum_ops_avx512 = {
+  .name    = "avx512",
+  .feature = "avx512f",
+  .partial = ci_ip_csum_partial_avx512,
+  .copy    = ci_ip_csum_copy_avx512,
+};
+
+#elif defined(__aarch64__)
+
+#include <arm_neon.h>
+
+static unsigned
+ci_ip_csum_partial_neon(unsigned sum, const volatile void* in_buf, int bytes)
+{
+  const ci_uint8* p = (const ci_uint8*) in_buf;
+  uint64x2_t acc0 = vdupq_n_u64(0), acc1 = vdupq_n_u64(0);
+
+  while( bytes >= 32 ) {
+    acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(p)));
+    acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(vld1q_u8(p + 16)));
+    p += 32;
+    bytes -= 32;
+  }
+  acc0 = vaddq_u64(acc0, acc1);
+  sum = ci_ip_csum_fold64_16(vgetq_lane_u64(acc0, 0) +
+                             vgetq_lane_u64(acc0, 1) + sum);
+  return ci_ip_csum_partial_c(sum, p, bytes);
+}
+
+
+static unsigned
+ci_ip_csum_copy_neon(void* dest, const void* src, int n, unsigned sum)
+{
+  ci_uint8* d = (ci_uint8*) dest;
+  const ci_uint8* s = (const ci_uint8*) src;
+  uint64x2_t acc0 = vdupq_n_u64(0), acc1 = vdupq_n_u64(0);
+
+  while( n >= 32 ) {
+    uint8x16_t v0 = vld1q_u8(s);
+    uint8x16_t v1 = vld1q_u8(s + 16);
+    vst1q_u8(d, v0);
+    vst1q_u8(d + 16, v1);
+    acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(v0));
+    acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(v1));
+    s += 32;
+    d += 32;
+    n -= 32;
+  }
+  acc0 = vaddq_u64(acc0, acc1);
+  ci_add_carry32(sum, ci_ip_csum_fold64_32(vgetq_lane_u64(acc0, 0) +
+                                           vgetq_lane_u64(acc0, 1)));
+  return ci_ip_csum_copy_aligned_c(d, s, n, sum);
+}
+
+
+static const struct ci_ip_csum_ops ci_ip_csum_ops_neon = {
+  .name    = "neon",
+  .feature = "neon",
+  .partial = ci_ip_csum_partial_neon,
+  .copy    = ci_ip_csum_copy_neon,
+};
+
+#endif
+
+
+const struct ci_ip_csum_ops* const ci_ip_csum_ops_all[] = {
+#if defined(__x86_64__)
+  &ci_ip_csum_ops_avx512,
+  &ci_ip_csum_ops_avx2,
+#elif defined(__aarch64__)
+  &ci_ip_csum_ops_neon,
+#endif
+  &ci_ip_csum_ops_c,
+  NULL
+};
+
+
+static const struct ci_ip_csum_ops* ci_ip_csum_select(void)
+{
+  const struct ci_ip_csum_ops* const* ops = ci_ip_csum_ops_all;
+
+  while( (*ops)->feature != NULL && ! ci_cpu_has_feature((*ops)->feature) )
+    ++ops;
+
+  /* Racing callers all pick the same implementation. */
+  ci_ip_csum_ops = *ops;
+  return *ops;
+}
+
+
+/* The initial implementation selects the real one on first use. */
+
+static unsigned
+ci_ip_csum_partial_probe(unsigned sum, const volatile void* in_buf, int bytes)
+{
+  return ci_ip_csum_select()->partial(sum, in_buf, bytes);
+}
+
+
+static unsigned
+ci_ip_csum_copy_probe(void* dest, const void* src, int n, unsigned sum)
+{
+  return ci_ip_csum_select()->copy(dest, src, n, sum);
+}
+
+
+static const struct ci_ip_csum_ops ci_ip_csum_ops_probe = {
+  .name    = "probe",
+  .partial = ci_ip_csum_partial_probe,
+  .copy    = ci_ip_csum_copy_probe,
+};
+
+
+const struct ci_ip_csum_ops* ci_ip_csum_ops = &ci_ip_csum_ops_probe;
+
+#endif  /* CI_HAVE_IP_CSUM_SIMD */
+
+/*! \cidoxg_end */
@@ -47,7 +47,7 @@ ifeq ($(DRIVER),1)
 LIB_SRCS	+= drv_log_fn.c memleak_debug.c
 LIB_SRCS	+= drv_thread.c
 else
-LIB_SRCS	+= cithread.c get_cpu_khz.c log_fn.c log_file.c
+LIB_SRCS	+= cithread.c get_cpu_khz.c log_fn.c log_file.c ip_csum_simd.c
 
 ifneq ($(WINDOWS),1)
 LIB_SRCS	+= glibc_version.c
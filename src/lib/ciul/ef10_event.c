@@ -13,6 +13,9 @@
 #include <ci/efhw/mc_driver_pcol.h>
 #include <ci/driver/efab/hardware/ef10_evq.h>
 #include <etherfabric/packedstream.h>
+#if defined(__x86_64__) && !defined(__KERNEL__)
+# include <emmintrin.h>
+#endif
 
 
 typedef ci_qword_t ef_vi_event;
@@ -962,6 +965,221 @@ int ef10_ef_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
 }
 
 
+/* Batched poll: ef_eventq_poll_batch() hands out completions already
+ * unbundled, as arrays.  It only decodes the common RX and TX events of
+ * the VI that owns the event queue, and stops at anything else so that
+ * ef_eventq_poll() can deal with it.
+ */
+
+ef_vi_inline void ef10_batch_rx_one(ef_vi* vi, ef_event_batch* batch,
+                                    ef_request_id rq_id, unsigned len,
+                                    uint64_t ev_u64)
+{
+  int i = batch->n_rx++;
+  uint64_t error_bits = ev_u64 & vi->rx_discard_mask;
+
+  batch->rx_rq_id[i] = rq_id;
+  batch->rx_len[i] = len;
+  batch->rx_flags[i] = EF_EVENT_FLAG_SOP;
+  if( ((ev_u64 >> ESF_DZ_RX_MAC_CLASS_LBN) & 1) == ESE_DZ_MAC_CLASS_MCAST )
+    batch->rx_flags[i] |= EF_EVENT_FLAG_MULTICAST;
+  if(unlikely( error_bits != 0 )) {
+    batch->rx_flags[i] |= EF_EVENT_BATCH_FLAG_DISCARD;
+    batch->rx_discard[i] = discard_type(error_bits);
+  }
+}
+
+
+/* Returns true if the event was consumed into the batch. */
+ef_vi_inline int ef10_batch_rx_event(ef_vi* evq, const ef_vi_event* ev,
+                                     ef_event_batch* batch)
+{
+  unsigned q_label = QWORD_GET_U(ESF_DZ_RX_QLABEL, *ev);
+  const unsigned short_di_mask = (1u << ESF_DZ_RX_DSC_PTR_LBITS_WIDTH) - 1u;
+  unsigned short_di, n_descs, i;
+  ef_vi_rxq* q = &evq->vi_rxq;
+  ef_vi_rxq_state* qs = &evq->ep_state->rxq;
+
+  if( q_label >= EF_VI_MAX_QS || evq->vi_qs[q_label] != evq ||
+      qs->in_jumbo || QWORD_GET_U(ESF_DZ_RX_CONT, *ev) )
+    return 0;
+  short_di = QWORD_GET_U(ESF_DZ_RX_DSC_PTR_LBITS, *ev);
+
+  if( evq->vi_is_normal ) {
+    unsigned di = qs->removed & q->mask;
+    if( ((short_di - qs->removed) & short_di_mask) != 1 )
+      return 0;
+    ef10_batch_rx_one(evq, batch, q->ids[di],
+                      QWORD_GET_U(ESF_DZ_RX_BYTES, *ev), ev->u64[0]);
+    q->ids[di] = EF_REQUEST_ID_MASK;
+    ++(qs->removed);
+    return 1;
+  }
+
+  /* RX event merge mode.  The lengths are only in the packet prefixes. */
+  n_descs = (short_di - qs->last_desc_i) & short_di_mask;
+  if( n_descs == 0 || batch->n_rx + n_descs > EF_VI_EVENT_BATCH_RX )
+    return 0;
+  qs->last_desc_i = short_di;
+  for( i = 0; i < n_descs; ++i ) {
+    unsigned di = qs->removed & q->mask;
+    ++(qs->removed);
+    if( q->ids[di] != EF_REQUEST_ID_MASK ) {
+      ef10_batch_rx_one(evq, batch, q->ids[di], 0, ev->u64[0]);
+      q->ids[di] = EF_REQUEST_ID_MASK;
+    }
+  }
+  EF_VI_ASSERT( qs->added - qs->removed <= q->mask );
+  return 1;
+}
+
+
+/* Returns true if the event was consumed into the batch. */
+ef_vi_inline int ef10_batch_tx_event(ef_vi* evq, const ef_vi_event* ev,
+                                     ef_event_batch* batch)
+{
+  unsigned q_label = QWORD_GET_U(ESF_DZ_TX_QLABEL, *ev);
+  ef_vi_txq* q = &evq->vi_txq;
+  ef_vi_txq_state* qs = &evq->ep_state->txq;
+  unsigned i, stop;
+
+  if( (evq->vi_flags & (EF_VI_TX_TIMESTAMPS | EF_VI_TX_ALT)) ||
+      q_label >= EF_VI_MAX_QS || evq->vi_qs[q_label] != evq ||
+      batch->n_tx + EF_VI_TRANSMIT_BATCH > EF_VI_EVENT_BATCH_TX )
+    return 0;
+
+  stop = (QWORD_GET_U(ESF_DZ_TX_DESCR_INDX, *ev) + 1) & q->mask;
+  EF_VI_BUG_ON(((stop - qs->removed) & q->mask) > qs->added - qs->removed);
+  for( i = qs->removed & q->mask; i != stop; i = ++qs->removed & q->mask )
+    if( q->ids[i] != EF_REQUEST_ID_MASK ) {
+      batch->tx_rq_id[batch->n_tx++] = q->ids[i];
+      q->ids[i] = EF_REQUEST_ID_MASK;
+    }
+  return 1;
+}
+
+
+#if defined(__x86_64__) && !defined(__KERNEL__)
+/* Decode the next two events together if both are plain single-buffer RX
+ * completions for a normal-mode [evq], with consecutive descriptors and no
+ * errors.  Returns the number of events consumed: 0 or 2.
+ */
+ef_vi_inline int ef10_batch_rx_pair(ef_vi* evq, ef_event_batch* batch)
+{
+  const uint64_t field_mask =
+    ((uint64_t) ((1u << ESF_DZ_EV_CODE_WIDTH) - 1) << ESF_DZ_EV_CODE_LBN) |
+    ((uint64_t) ((1u << ESF_DZ_RX_DSC_PTR_LBITS_WIDTH) - 1)
+     << ESF_DZ_RX_DSC_PTR_LBITS_LBN) |
+    ((uint64_t) ((1u << ESF_DZ_RX_QLABEL_WIDTH) - 1) << ESF_DZ_RX_QLABEL_LBN) |
+    (1ull << ESF_DZ_RX_CONT_LBN);
+  ef_vi_rxq* q = &evq->vi_rxq;
+  ef_vi_rxq_state* qs = &evq->ep_state->rxq;
+  uint64_t expect, ev0, ev1;
+  unsigned di;
+  __m128i evs, mask;
+
+  /* Both events must be contiguous in the ring. */
+  if( EF_VI_EVENT_OFFSET(evq, 0) + sizeof(ef_vi_event) > evq->evq_mask )
+    return 0;
+  evs = _mm_loadu_si128((const __m128i*) EF_VI_EVENT_PTR(evq, 0));
+  /* Neither half of either event may still be the null value. */
+  if( _mm_movemask_epi8(_mm_cmpeq_epi32(evs, _mm_set1_epi32(-1))) != 0 )
+    return 0;
+
+  /* A VI that owns its event queue has queue label 0. */
+  expect = (uint64_t) ESE_DZ_EV_CODE_RX_EV << ESF_DZ_EV_CODE_LBN;
+  mask = _mm_set1_epi64x(field_mask | evq->rx_discard_mask);
+  if( _mm_movemask_epi8(_mm_cmpeq_epi32(
+        _mm_and_si128(evs, mask),
+        _mm_set_epi64x(
+          expect | ((uint64_t) ((qs->removed + 2) & 0xf)
+                    << ESF_DZ_RX_DSC_PTR_LBITS_LBN),
+          expect | ((uint64_t) ((qs->removed + 1) & 0xf)
+                    << ESF_DZ_RX_DSC_PTR_LBITS_LBN)))) != 0xffff )
+    return 0;
+
+  ev0 = _mm_cvtsi128_si64(evs);
+  ev1 = _mm_cvtsi128_si64(_mm_unpackhi_epi64(evs, evs));
+  di = qs->removed & q->mask;
+  ef10_batch_rx_one(evq, batch, q->ids[di],
+                    ev0 & ((1u << ESF_DZ_RX_BYTES_WIDTH) - 1), ev0);
+  q->ids[di] = EF_REQUEST_ID_MASK;
+  di = (qs->removed + 1) & q->mask;
+  ef10_batch_rx_one(evq, batch, q->ids[di],
+                    ev1 & ((1u << ESF_DZ_RX_BYTES_WIDTH) - 1), ev1);
+  q->ids[di] = EF_REQUEST_ID_MASK;
+  qs->removed += 2;
+
+  CI_SET_QWORD(*EF_VI_EVENT_PTR(evq, evq->ep_state->evq.evq_clear_stride));
+  evq->ep_state->evq.evq_ptr += sizeof(ef_vi_event);
+  CI_SET_QWORD(*EF_VI_EVENT_PTR(evq, evq->ep_state->evq.evq_clear_stride));
+  evq->ep_state->evq.evq_ptr += sizeof(ef_vi_event);
+  return 2;
+}
+#endif
+
+
+int ef_eventq_poll_batch(ef_vi* evq, ef_event_batch* batch)
+{
+  ef_vi_event ev;
+  int n_ev = 0;
+#if defined(__x86_64__) && !defined(__KERNEL__)
+  int pairs = evq->vi_is_normal && evq->vi_rxq.mask &&
+    evq->vi_qs[0] == evq;
+#endif
+
+  batch->n_rx = 0;
+  batch->n_tx = 0;
+  batch->flags = 0;
+
+  if( evq->ops.eventq_poll != ef10_ef_eventq_poll ||
+      evq->vi_is_packed_stream ||
+      EF_VI_IS_EVENT(EF_VI_EVENT_PTR(evq,
+                                     evq->ep_state->evq.evq_clear_stride - 1)) )
+    goto need_poll;
+
+  while( batch->n_rx < EF_VI_EVENT_BATCH_RX ) {
+#if defined(__x86_64__) && !defined(__KERNEL__)
+    if( pairs && batch->n_rx + 2 <= EF_VI_EVENT_BATCH_RX &&
+        ! evq->ep_state->rxq.in_jumbo ) {
+      int n = ef10_batch_rx_pair(evq, batch);
+      if( n ) {
+        n_ev += n;
+        continue;
+      }
+    }
+#endif
+    ev = *EF_VI_EVENT_PTR(evq, 0);
+    if( ! EF_VI_IS_EVENT(&ev) ) {
+      /* Let ef_eventq_poll() deal with a gap in the ring. */
+      if( EF_VI_IS_EVENT(EF_VI_EVENT_PTR(evq, 1)) )
+        goto need_poll;
+      break;
+    }
+    switch( CI_QWORD_FIELD(ev, ESF_DZ_EV_CODE) ) {
+    case ESE_DZ_EV_CODE_RX_EV:
+      if( ! ef10_batch_rx_event(evq, &ev, batch) )
+        goto need_poll;
+      break;
+    case ESE_DZ_EV_CODE_TX_EV:
+      if( ! ef10_batch_tx_event(evq, &ev, batch) )
+        goto need_poll;
+      break;
+    default:
+      goto need_poll;
+    }
+    CI_SET_QWORD(*EF_VI_EVENT_PTR(evq, evq->ep_state->evq.evq_clear_stride));
+    evq->ep_state->evq.evq_ptr += sizeof(ef_vi_event);
+    ++n_ev;
+  }
+  return n_ev;
+
+ need_poll:
+  batch->flags |= EF_EVENT_BATCH_NEED_POLL;
+  return n_ev;
+}
+
+
 void ef10_ef_eventq_prime(ef_vi* vi)
 {
   unsigned ring_i = (ef_eventq_current(vi) & vi->evq_mask) / 8;
@@ -256,6 +256,9 @@ int ef_pd_alloc_by_name(ef_pd* pd, ef_driver_handle pd_dh,
   const char* s;
   char* end;
 
+  if( ef_vi_sw_config() != NULL )
+    return ef_vi_sw_pd_alloc(pd, cluster_or_intf_name, flags);
+
   if( (s = getenv("EF_VI_PD_FLAGS")) != NULL ) {
     if( strstr(s, "vf") != NULL )
       flags |= EF_PD_VF;
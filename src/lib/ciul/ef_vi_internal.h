@@ -244,4 +244,22 @@ ef_pd_capabilities_get(ef_driver_handle handle, ef_pd* pd,
 
 extern unsigned ef_vi_evq_clear_stride(void);
 
+/* Software VI backend (sw_vi.c).  Selected for the whole process by
+ * setting EF_VI_SW, in which case the driver is not used at all.
+ */
+struct ef_memreg;
+struct timeval;
+extern const char* ef_vi_sw_config(void);
+extern int ef_vi_sw_alloc(ef_vi* vi, int evq_capacity, int rxq_capacity,
+                          int txq_capacity, ef_vi* evq,
+                          enum ef_vi_flags vi_flags);
+extern int ef_vi_sw_free(ef_vi* vi);
+extern void ef_vi_sw_get_mac(ef_vi* vi, void* mac_out);
+extern int ef_vi_sw_memreg_alloc(struct ef_memreg* mr, void* p_mem,
+                                 size_t len_bytes);
+extern int ef_vi_sw_pd_alloc(ef_pd* pd, const char* intf_name,
+                             enum ef_pd_flags flags);
+extern int ef_vi_sw_eventq_wait(ef_vi* evq, unsigned current_ptr,
+                                const struct timeval* timeout);
+
 #endif  /* __CI_EF_VI_INTERNAL_H__ */
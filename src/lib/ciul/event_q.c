@@ -31,6 +31,9 @@ int ef_eventq_wait(ef_vi* evq, ef_driver_handle fd,
   */
   ci_resource_op_t  op;
 
+  if( ef_vi_sw_config() != NULL )
+    return ef_vi_sw_eventq_wait(evq, current_ptr, timeout);
+
   op.op = CI_RSOP_EVENTQ_WAIT;
   op.id = efch_make_resource_id(evq->vi_resource_id);
   if( timeout ){
@@ -52,6 +52,9 @@ int ef_memreg_alloc(ef_memreg* mr, ef_driver_handle mr_dh,
   if( ((uintptr_t) p_mem & (EFHW_NIC_PAGE_SIZE - 1)) != 0 )
     return -EINVAL;
 
+  if( ef_vi_sw_config() != NULL )
+    return ef_vi_sw_memreg_alloc(mr, p_mem, len_bytes);
+
   /* Note: At time of writing the driver rounds the registered region to
    * whole system pages.  It then writes a DMA address for each 4K page
    * within the system-aligned region.  This means that on PPC (where
@@ -45,7 +45,8 @@ LIB_SRCS	+=		\
 		vi_prime.c	\
 		vi_discard.c	\
 		capabilities.c	\
-		ctpio.c
+		ctpio.c		\
+		sw_vi.c
 
 # librt is needed on old glibc, e.g. on RHEL 6
 MMAKE_DIR_LINKFLAGS	:= $(MMAKE_DIR_LINKFLAGS) -lrt
@@ -22,7 +22,13 @@
 int ef_driver_open(ef_driver_handle* pfd)
 {
   int rc;
-  rc = open("/dev/sfc_char", O_RDWR);
+  /* The software backend has no driver, but callers still expect a
+   * descriptor they can close() and poll().
+   */
+  if( ef_vi_sw_config() != NULL )
+    rc = open("/dev/null", O_RDWR);
+  else
+    rc = open("/dev/sfc_char", O_RDWR);
   if( rc >= 0 ) {
     *pfd = rc;
     return 0;
@@ -27,6 +27,11 @@ static int __ef_pd_alloc(ef_pd* pd, ef_driver_handle pd_dh,
   const char* s;
   int rc;
 
+  if( ef_vi_sw_config() != NULL ) {
+    char name[IF_NAMESIZE];
+    return ef_vi_sw_pd_alloc(pd, if_indextoname(ifindex, name), flags);
+  }
+
   if( (s = getenv("EF_VI_PD_FLAGS")) != NULL ) {
     if( ! strcmp(s, "vf") )
       flags = EF_PD_VF;
@@ -112,7 +117,10 @@ int ef_pd_alloc_with_vport(ef_pd* pd, ef_driver_handle pd_dh,
 			   const char* intf_name,
 			   enum ef_pd_flags flags, int vlan_id)
 {
-  int ifindex = if_nametoindex(intf_name);
+  int ifindex;
+  if( ef_vi_sw_config() != NULL )
+    return ef_vi_sw_pd_alloc(pd, intf_name, flags);
+  ifindex = if_nametoindex(intf_name);
   if( ifindex == 0 )
     return -errno;
   return __ef_pd_alloc(pd, pd_dh, ifindex, flags | EF_PD_VPORT, vlan_id);
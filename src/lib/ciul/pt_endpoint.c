@@ -598,6 +598,10 @@ int ef_vi_alloc_from_pd(ef_vi* vi, ef_driver_handle vi_dh,
   int index_in_vi_set = 0;
   int vi_clustered = 0;
 
+  if( ef_vi_sw_config() != NULL )
+    return ef_vi_sw_alloc(vi, evq_capacity, rxq_capacity, txq_capacity,
+                          evq_opt, flags);
+
   if( pd->pd_flags & EF_PD_PHYS_MODE )
     flags |= EF_VI_TX_PHYS_ADDR | EF_VI_RX_PHYS_ADDR;
   else
@@ -623,6 +627,8 @@ int ef_vi_alloc_from_set(ef_vi* vi, ef_driver_handle vi_dh,
 			 ef_vi* evq_opt, ef_driver_handle evq_dh,
 			 enum ef_vi_flags flags)
 {
+  if( ef_vi_sw_config() != NULL )
+    return -EOPNOTSUPP;
   if( vi_set->vis_pd->pd_flags & EF_PD_PHYS_MODE )
     flags |= EF_VI_TX_PHYS_ADDR | EF_VI_RX_PHYS_ADDR;
   else
@@ -639,6 +645,9 @@ int ef_vi_free(ef_vi* ep, ef_driver_handle fd)
 {
   int rc;
 
+  if( ef_vi_sw_config() != NULL )
+    return ef_vi_sw_free(ep);
+
   if( ep->vi_ctpio_mmap_ptr != NULL ) {
     rc = ci_resource_munmap(fd, ep->vi_ctpio_mmap_ptr, CTPIO_MMAP_LEN);
     if( rc < 0 ) {
@@ -681,6 +690,9 @@ unsigned ef_vi_mtu(ef_vi* vi, ef_driver_handle fd)
   ci_resource_op_t op;
   int rc;
 
+  if( ef_vi_sw_config() != NULL )
+    return 1500;
+
   op.op = CI_RSOP_VI_GET_MTU;
   op.id = efch_make_resource_id(vi->vi_resource_id);
   rc = ci_resource_op(fd, &op);
@@ -695,6 +707,11 @@ int ef_vi_get_mac(ef_vi* vi, ef_driver_handle dh, void* mac_out)
   ci_resource_op_t op;
   int rc;
 
+  if( ef_vi_sw_config() != NULL ) {
+    ef_vi_sw_get_mac(vi, mac_out);
+    return 0;
+  }
+
   op.op = CI_RSOP_VI_GET_MAC;
   op.id = efch_make_resource_id(vi->vi_resource_id);
   rc = ci_resource_op(dh, &op);
@@ -13,6 +13,20 @@ int ef_vi_receive_post(ef_vi* vi, ef_addr addr, ef_request_id dma_id)
 }
 
 
+int ef_vi_receive_post_batch(ef_vi* vi, const ef_addr* addrs,
+                             const ef_request_id* dma_ids, int n)
+{
+  int i;
+
+  for( i = 0; i < n; ++i )
+    if( ef_vi_receive_init(vi, addrs[i], dma_ids[i]) != 0 )
+      break;
+  if( i > 0 )
+    ef_vi_receive_push(vi);
+  return i;
+}
+
+
 int ef_vi_receive_unbundle(ef_vi* vi, const ef_event* ev,
                            ef_request_id* ids)
 {
@@ -21,6 +21,22 @@ int ef_vi_transmit_init(ef_vi* vi, ef_addr base, int len, ef_request_id dma_id)
 }
 
 
+int ef_vi_transmit_batch(ef_vi* vi, const ef_addr* addrs, const int* lens,
+                         const ef_request_id* dma_ids, int n)
+{
+  int i;
+
+  for( i = 0; i < n; ++i )
+    if( ef_vi_transmit_init(vi, addrs[i], lens[i], dma_ids[i]) != 0 )
+      break;
+  if( i > 0 ) {
+    wmb();
+    ef_vi_transmit_push(vi);
+  }
+  return i;
+}
+
+
 void ef_vi_transmit_init_undo(ef_vi* vi)
 {
   ef_vi_txq* q = &vi->vi_txq;
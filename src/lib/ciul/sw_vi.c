@@ -0,0 +1,974 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+**  \brief  Software emulation of an ef10 VI.
+**   \date
+**    \cop  (c) Solarflare Communications Inc.
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/* When EF_VI_SW is set in the environment, ef_vi resources are not
+ * allocated from the driver.  Instead each VI gets heap-allocated rings
+ * and a software "adapter" that consumes ef10 descriptors and writes ef10
+ * events, so that the normal descriptor and event parsing code runs
+ * unmodified.
+ *
+ * Frames travel over a "wire", which is either:
+ *
+ *   EF_VI_SW=<name>[:<port>]  A shared memory segment connecting two VIs
+ *                             (possibly in different processes).  Each end
+ *                             claims port 0 or 1.
+ *
+ *   EF_VI_SW=if:<ifname>      An AF_PACKET socket bound to a Linux
+ *                             interface, such as a TAP or veth device.
+ *
+ * The adapter runs synchronously: transmit happens in ef_vi_transmit_push()
+ * and receive happens at the start of ef_eventq_poll().  RX and TX
+ * timestamps are taken from CLOCK_REALTIME, and time sync events are
+ * generated as needed to keep the event queue synchronised.
+ *
+ * EF_VI_SW is read once, at first use, so all VIs in a process share one
+ * wire name.  This backend serves ef_vi applications only.  Onload stacks
+ * get their VIs from the kernel, which has no software counterpart, so the
+ * stack's poll and transmit paths do not run over it.
+ */
+
+/*! \cidoxg_lib_ef */
+#define _GNU_SOURCE
+#include <etherfabric/vi.h>
+#include <etherfabric/pd.h>
+#include <etherfabric/memreg.h>
+#include "ef_vi_internal.h"
+#include "logging.h"
+#include <ci/efhw/mc_driver_pcol.h>
+#include <ci/driver/efab/hardware/ef10_evq.h>
+#include <stdio.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+
+#define EF_VI_SW_FRAME_MAX       2048
+#define EF_VI_SW_WIRE_SLOTS      512
+#define EF_VI_SW_RXQ_DEFAULT     512
+#define EF_VI_SW_TXQ_DEFAULT     512
+/* The event queue is resynchronised at least this often when timestamping
+ * is enabled.  ef10 timestamp reconstruction tolerates up to ~0.45s.
+ */
+#define EF_VI_SW_SYNC_NS         (200 * 1000 * 1000)
+/* Room left in each event queue for time sync events. */
+#define EF_VI_SW_EVQ_SLACK       64
+#define EF_VI_SW_RX_PREFIX_LEN   ES_DZ_RX_PREFIX_SIZE
+#define EF_VI_SW_NO_TIMESTAMP    0xffffffffu
+
+
+typedef ci_qword_t ef_vi_event;
+
+
+struct ef_vi_sw_slot {
+  uint32_t len;
+  uint32_t pad;
+  uint64_t ts_ns;
+  uint8_t  data[EF_VI_SW_FRAME_MAX];
+};
+
+
+/* Single-producer single-consumer ring carrying frames in one direction. */
+struct ef_vi_sw_ring {
+  volatile uint32_t    prod;
+  volatile uint32_t    drops;
+  char                 pad1[EF_VI_DMA_ALIGN - 8];
+  volatile uint32_t    cons;
+  char                 pad2[EF_VI_DMA_ALIGN - 4];
+  struct ef_vi_sw_slot slots[EF_VI_SW_WIRE_SLOTS];
+};
+
+
+/* ring[i] carries frames transmitted by port i. */
+struct ef_vi_sw_wire {
+  struct ef_vi_sw_ring ring[2];
+};
+
+
+/* Per-VI adapter state.  Lives at the start of vi->vi_mem_mmap_ptr, ahead
+ * of the rings.
+ */
+struct ef_vi_sw {
+  ef_vi*                evq;
+  unsigned              q_label;
+  struct ef_vi_sw_wire* wire;
+  int                   wire_fd;
+  int                   port;
+  int                   pkt_fd;
+  unsigned              rx_posted;
+  unsigned              rx_filled;
+  unsigned              evq_wptr;
+  /* Events that the queues using this event queue can have outstanding
+   * between them.  The ring is grown when a VI joins and takes this past
+   * its capacity.
+   */
+  unsigned              evq_need;
+  void*                 evq_ring;
+  /* This VI's contribution to its event queue's evq_need. */
+  unsigned              q_need;
+  uint64_t              last_sync_ns;
+  uint8_t               mac[6];
+  uint8_t               frame[EF_VI_SW_FRAME_MAX];
+};
+
+
+#define EF_VI_SW(vi)  ((struct ef_vi_sw*) (vi)->vi_mem_mmap_ptr)
+
+
+/* EF_VI_SW selects the backend for the whole process, and is checked by
+ * every driver entry point, so it is read only once.  Racing first callers
+ * read the same value.
+ */
+const char* ef_vi_sw_config(void)
+{
+  static const char* cfg;
+  static int cfg_read;
+
+  if( ! __atomic_load_n(&cfg_read, __ATOMIC_ACQUIRE) ) {
+    cfg = getenv("EF_VI_SW");
+    __atomic_store_n(&cfg_read, 1, __ATOMIC_RELEASE);
+  }
+  return cfg;
+}
+
+
+static uint64_t ef_vi_sw_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/**********************************************************************
+ * Event generation.
+ */
+
+static void ef_vi_sw_put_event(ef_vi* evq, const ef_vi_event* ev)
+{
+  struct ef_vi_sw* sw = EF_VI_SW(evq);
+  ef_vi_event* p = (ef_vi_event*) (evq->evq_base +
+                                   (sw->evq_wptr & evq->evq_mask));
+  /* Packet data and earlier events must be visible before the event. */
+  wmb();
+  p->u64[0] = ev->u64[0];
+  sw->evq_wptr += sizeof(ef_vi_event);
+}
+
+
+static void ef_vi_sw_sync_event(ef_vi* evq, uint64_t now_ns)
+{
+  uint32_t sec = now_ns / 1000000000;
+  uint32_t qns = (now_ns % 1000000000) * 4;
+  ef_vi_event ev;
+
+  CI_POPULATE_QWORD_6(ev,
+                      ESF_DZ_EV_CODE, ESE_DZ_EV_CODE_MCDI_EV,
+                      MCDI_EVENT_CODE, MCDI_EVENT_CODE_PTP_TIME,
+                      MCDI_EVENT_PTP_TIME_MAJOR, sec,
+                      MCDI_EVENT_PTP_TIME_MINOR_26_21, qns >> 26,
+                      MCDI_EVENT_PTP_TIME_NIC_CLOCK_VALID, 1,
+                      MCDI_EVENT_PTP_TIME_HOST_NIC_IN_SYNC, 1);
+  ef_vi_sw_put_event(evq, &ev);
+  EF_VI_SW(evq)->last_sync_ns = now_ns;
+}
+
+
+static void ef_vi_sw_maybe_sync(ef_vi* evq, uint64_t now_ns)
+{
+  if( (evq->vi_flags & (EF_VI_RX_TIMESTAMPS | EF_VI_TX_TIMESTAMPS)) &&
+      now_ns - EF_VI_SW(evq)->last_sync_ns >= EF_VI_SW_SYNC_NS )
+    ef_vi_sw_sync_event(evq, now_ns);
+}
+
+
+/**********************************************************************
+ * Transmit.
+ */
+
+static void ef_vi_sw_wire_put(struct ef_vi_sw* sw, const uint8_t* frame,
+                              unsigned len, uint64_t ts_ns)
+{
+  struct ef_vi_sw_ring* ring;
+  struct ef_vi_sw_slot* slot;
+  uint32_t prod;
+
+  if( sw->pkt_fd >= 0 ) {
+    if( send(sw->pkt_fd, frame, len, MSG_DONTWAIT) < 0 )
+      LOGVV(ef_log("%s: send failed errno=%d", __FUNCTION__, errno));
+    return;
+  }
+
+  ring = &sw->wire->ring[sw->port];
+  prod = ring->prod;
+  if( prod - ring->cons >= EF_VI_SW_WIRE_SLOTS ) {
+    /* Peer isn't keeping up: the frame is lost on the wire. */
+    ++ring->drops;
+    return;
+  }
+  slot = &ring->slots[prod % EF_VI_SW_WIRE_SLOTS];
+  memcpy(slot->data, frame, len);
+  slot->len = len;
+  slot->ts_ns = ts_ns;
+  wmb();
+  ring->prod = prod + 1;
+}
+
+
+static void ef_vi_sw_tx_complete(ef_vi* vi, unsigned last_di, uint64_t ts_ns)
+{
+  struct ef_vi_sw* sw = EF_VI_SW(vi);
+  ef_vi* evq = sw->evq;
+  ef_vi_event ev;
+
+  CI_POPULATE_QWORD_4(ev,
+                      ESF_DZ_EV_CODE, ESE_DZ_EV_CODE_TX_EV,
+                      ESF_DZ_TX_QLABEL, sw->q_label,
+                      ESF_DZ_TX_DESCR_INDX, last_di,
+                      ESF_EZ_TX_SOFT1, TX_TIMESTAMP_EVENT_TX_EV_COMPLETION);
+  ef_vi_sw_put_event(evq, &ev);
+
+  if( evq->vi_flags & EF_VI_TX_TIMESTAMPS ) {
+    uint32_t sec = ts_ns / 1000000000;
+    uint32_t qns = (ts_ns % 1000000000) * 4;
+    CI_POPULATE_QWORD_5(ev,
+                        ESF_DZ_EV_CODE, ESE_DZ_EV_CODE_TX_EV,
+                        ESF_DZ_TX_QLABEL, sw->q_label,
+                        ESF_DZ_TX_DESCR_INDX, qns & 0xffff,
+                        ESF_DZ_TX_SOFT2, qns >> 16,
+                        ESF_EZ_TX_SOFT1, TX_TIMESTAMP_EVENT_TX_EV_TSTAMP_LO);
+    ef_vi_sw_put_event(evq, &ev);
+    CI_POPULATE_QWORD_5(ev,
+                        ESF_DZ_EV_CODE, ESE_DZ_EV_CODE_TX_EV,
+                        ESF_DZ_TX_QLABEL, sw->q_label,
+                        ESF_DZ_TX_DESCR_INDX, sec & 0xffff,
+                        ESF_DZ_TX_SOFT2, sec >> 16,
+                        ESF_EZ_TX_SOFT1, TX_TIMESTAMP_EVENT_TX_EV_TSTAMP_HI);
+    ef_vi_sw_put_event(evq, &ev);
+  }
+}
+
+
+static void ef_vi_sw_transmit_push(ef_vi* vi)
+{
+  struct ef_vi_sw* sw = EF_VI_SW(vi);
+  ef_vi_txq* q = &vi->vi_txq;
+  ef_vi_txq_state* qs = &vi->ep_state->txq;
+  const ci_qword_t* dp;
+  unsigned di, len, frame_len = 0;
+  uint64_t now_ns;
+
+  EF_VI_BUG_ON(qs->previous == qs->added);
+  now_ns = ef_vi_sw_now_ns();
+  ef_vi_sw_maybe_sync(sw->evq, now_ns);
+
+  while( qs->previous != qs->added ) {
+    di = qs->previous++ & q->mask;
+    dp = (const ci_qword_t*) q->descriptors + di;
+    /* Option descriptors carry no payload. */
+    if( QWORD_GET_U(ESF_DZ_TX_KER_TYPE, *dp) )
+      continue;
+    len = QWORD_GET_U(ESF_DZ_TX_KER_BYTE_CNT, *dp);
+    if( frame_len + len <= EF_VI_SW_FRAME_MAX )
+      memcpy(sw->frame + frame_len,
+             (const void*) (uintptr_t)
+               CI_QWORD_FIELD64(*dp, ESF_DZ_TX_KER_BUF_ADDR), len);
+    frame_len += len;
+    if( QWORD_GET_U(ESF_DZ_TX_KER_CONT, *dp) )
+      continue;
+
+    if( frame_len <= EF_VI_SW_FRAME_MAX )
+      ef_vi_sw_wire_put(sw, sw->frame, frame_len, now_ns);
+    else
+      LOGVV(ef_log("%s: dropped %u byte frame", __FUNCTION__, frame_len));
+    ef_vi_sw_tx_complete(vi, di, now_ns);
+    frame_len = 0;
+  }
+}
+
+
+static int ef_vi_sw_transmit(ef_vi* vi, ef_addr base, int len,
+                             ef_request_id dma_id)
+{
+  ef_iovec iov = { base, len };
+  int rc = vi->ops.transmitv_init(vi, &iov, 1, dma_id);
+  if( rc == 0 )
+    ef_vi_sw_transmit_push(vi);
+  return rc;
+}
+
+
+static int ef_vi_sw_transmitv(ef_vi* vi, const ef_iovec* iov, int iov_len,
+                              ef_request_id dma_id)
+{
+  int rc = vi->ops.transmitv_init(vi, iov, iov_len, dma_id);
+  if( rc == 0 )
+    ef_vi_sw_transmit_push(vi);
+  return rc;
+}
+
+
+static int ef_vi_sw_transmit_pio(ef_vi* vi, int offset, int len,
+                                 ef_request_id dma_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int ef_vi_sw_transmit_copy_pio(ef_vi* vi, int pio_offset,
+                                      const void* src_buf, int len,
+                                      ef_request_id dma_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static void ef_vi_sw_transmit_pio_warm(ef_vi* vi)
+{
+}
+
+
+static void ef_vi_sw_transmit_copy_pio_warm(ef_vi* vi, int pio_offset,
+                                            const void* src_buf, int len)
+{
+}
+
+
+/* CTPIO never succeeds, so the fallback descriptor is always sent. */
+static void ef_vi_sw_transmitv_ctpio(ef_vi* vi, size_t frame_len,
+                                     const struct iovec* iov, int iovcnt,
+                                     unsigned threshold)
+{
+}
+
+
+static void ef_vi_sw_transmitv_ctpio_copy(ef_vi* vi, size_t frame_len,
+                                          const struct iovec* iov,
+                                          int iovcnt, unsigned threshold,
+                                          void* fallback)
+{
+  int i;
+  for( i = 0; i < iovcnt; ++i ) {
+    memcpy(fallback, iov[i].iov_base, iov[i].iov_len);
+    fallback = (char*) fallback + iov[i].iov_len;
+  }
+}
+
+
+static int ef_vi_sw_transmit_alt_op(ef_vi* vi, unsigned alt_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int ef_vi_sw_transmit_alt_select_default(ef_vi* vi)
+{
+  return -EOPNOTSUPP;
+}
+
+
+/**********************************************************************
+ * Receive.
+ */
+
+static void ef_vi_sw_receive_push(ef_vi* vi)
+{
+  /* Unlike hardware there is no need to post in batches of 8. */
+  wmb();
+  EF_VI_SW(vi)->rx_posted = vi->ep_state->rxq.added;
+  vi->ep_state->rxq.posted = vi->ep_state->rxq.added;
+}
+
+
+/* Deliver a frame into posted RX descriptors, writing one event per
+ * descriptor used.  Returns false if there are not enough descriptors, in
+ * which case nothing is consumed.
+ */
+static int ef_vi_sw_deliver(ef_vi* vi, const uint8_t* frame, unsigned len,
+                            uint64_t ts_ns, int has_ts)
+{
+  struct ef_vi_sw* sw = EF_VI_SW(vi);
+  ef_vi_rxq* q = &vi->vi_rxq;
+  unsigned buf_len = vi->rx_buffer_len;
+  unsigned prefix = vi->rx_prefix_len;
+  unsigned n_descs, off, chunk, di;
+  const ci_qword_t* dp;
+  ef_vi_event ev;
+  uint8_t* buf;
+  int mcast = frame[0] & 1;
+
+  if( len == 0 )
+    return 1;
+  n_descs = (len + prefix + buf_len - 1) / buf_len;
+  if( sw->rx_posted - sw->rx_filled < n_descs )
+    return 0;
+
+  for( off = 0; off < len; off += chunk ) {
+    di = sw->rx_filled++ & q->mask;
+    dp = (const ci_qword_t*) q->descriptors + di;
+    buf = (uint8_t*) (uintptr_t)
+      CI_QWORD_FIELD64(*dp, ESF_DZ_RX_KER_BUF_ADDR);
+    chunk = len - off;
+    if( off == 0 ) {
+      if( prefix ) {
+        uint32_t ts = EF_VI_SW_NO_TIMESTAMP;
+        uint16_t pkt_len = cpu_to_le16(len);
+        if( has_ts )
+          ts = cpu_to_le32((ts_ns % 1000000000) * 4);
+        memset(buf, 0, prefix);
+        memcpy(buf + ES_DZ_RX_PREFIX_PKTLEN_OFST, &pkt_len, sizeof(pkt_len));
+        memcpy(buf + ES_DZ_RX_PREFIX_TSTAMP_OFST, &ts, sizeof(ts));
+      }
+      if( chunk > buf_len - prefix )
+        chunk = buf_len - prefix;
+      memcpy(buf + prefix, frame, chunk);
+    }
+    else {
+      if( chunk > buf_len )
+        chunk = buf_len;
+      memcpy(buf, frame + off, chunk);
+    }
+    CI_POPULATE_QWORD_6(ev,
+                        ESF_DZ_EV_CODE, ESE_DZ_EV_CODE_RX_EV,
+                        ESF_DZ_RX_QLABEL, sw->q_label,
+                        ESF_DZ_RX_DSC_PTR_LBITS, sw->rx_filled & 0xf,
+                        ESF_DZ_RX_BYTES, chunk + (off == 0 ? prefix : 0),
+                        ESF_DZ_RX_CONT, off + chunk < len,
+                        ESF_DZ_RX_MAC_CLASS,
+                        mcast ? ESE_DZ_MAC_CLASS_MCAST :
+                                ESE_DZ_MAC_CLASS_UCAST);
+    ef_vi_sw_put_event(sw->evq, &ev);
+  }
+  return 1;
+}
+
+
+static void ef_vi_sw_rx_poll(ef_vi* vi)
+{
+  struct ef_vi_sw* sw = EF_VI_SW(vi);
+  int has_ts = !!(vi->vi_flags & EF_VI_RX_TIMESTAMPS);
+
+  if( sw->pkt_fd >= 0 ) {
+    struct sockaddr_ll sll;
+    socklen_t sll_len;
+    ssize_t rc;
+    while( sw->rx_posted != sw->rx_filled ) {
+      sll_len = sizeof(sll);
+      rc = recvfrom(sw->pkt_fd, sw->frame, sizeof(sw->frame), MSG_DONTWAIT,
+                    (struct sockaddr*) &sll, &sll_len);
+      if( rc <= 0 )
+        break;
+      if( sll.sll_pkttype == PACKET_OUTGOING )
+        continue;
+      /* Frames too big for the posted buffers are dropped, as on a NIC. */
+      ef_vi_sw_deliver(vi, sw->frame, rc, ef_vi_sw_now_ns(), has_ts);
+    }
+  }
+  else {
+    struct ef_vi_sw_ring* ring = &sw->wire->ring[!sw->port];
+    struct ef_vi_sw_slot* slot;
+    uint32_t cons = ring->cons;
+    while( cons != ring->prod ) {
+      smp_rmb();
+      slot = &ring->slots[cons % EF_VI_SW_WIRE_SLOTS];
+      if( ! ef_vi_sw_deliver(vi, slot->data, slot->len, slot->ts_ns, has_ts) )
+        break;
+      /* Reads of the slot must complete before we hand it back. */
+      smp_rmb();
+      ring->cons = ++cons;
+    }
+  }
+}
+
+
+static int ef_vi_sw_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
+{
+  int i;
+
+  ef_vi_sw_maybe_sync(evq, ef_vi_sw_now_ns());
+  for( i = 0; i < evq->vi_qs_n; ++i )
+    if( evq->vi_qs[i]->vi_rxq.mask )
+      ef_vi_sw_rx_poll(evq->vi_qs[i]);
+  return ef10_ef_eventq_poll(evq, evs, evs_len);
+}
+
+
+static void ef_vi_sw_eventq_prime(ef_vi* vi)
+{
+}
+
+
+static void ef_vi_sw_eventq_timer_op(ef_vi* vi, unsigned v)
+{
+}
+
+
+static void ef_vi_sw_eventq_timer_clear(ef_vi* vi)
+{
+}
+
+
+static void ef_vi_sw_initialise_ops(ef_vi* vi)
+{
+  /* Keep the ef10 descriptor builders (transmitv_init, receive_init) and
+   * event parser; replace everything that touches hardware.
+   */
+  vi->ops.transmit               = ef_vi_sw_transmit;
+  vi->ops.transmitv              = ef_vi_sw_transmitv;
+  vi->ops.transmit_push          = ef_vi_sw_transmit_push;
+  vi->ops.transmit_pio           = ef_vi_sw_transmit_pio;
+  vi->ops.transmit_copy_pio      = ef_vi_sw_transmit_copy_pio;
+  vi->ops.transmit_pio_warm      = ef_vi_sw_transmit_pio_warm;
+  vi->ops.transmit_copy_pio_warm = ef_vi_sw_transmit_copy_pio_warm;
+  vi->ops.transmitv_ctpio        = ef_vi_sw_transmitv_ctpio;
+  vi->ops.transmitv_ctpio_copy   = ef_vi_sw_transmitv_ctpio_copy;
+  vi->ops.transmit_alt_select    = ef_vi_sw_transmit_alt_op;
+  vi->ops.transmit_alt_select_default = ef_vi_sw_transmit_alt_select_default;
+  vi->ops.transmit_alt_stop      = ef_vi_sw_transmit_alt_op;
+  vi->ops.transmit_alt_go        = ef_vi_sw_transmit_alt_op;
+  vi->ops.transmit_alt_discard   = ef_vi_sw_transmit_alt_op;
+  vi->ops.receive_push           = ef_vi_sw_receive_push;
+  vi->ops.eventq_poll            = ef_vi_sw_eventq_poll;
+  vi->ops.eventq_prime           = ef_vi_sw_eventq_prime;
+  vi->ops.eventq_timer_prime     = ef_vi_sw_eventq_timer_op;
+  vi->ops.eventq_timer_run       = ef_vi_sw_eventq_timer_op;
+  vi->ops.eventq_timer_clear     = ef_vi_sw_eventq_timer_clear;
+  vi->ops.eventq_timer_zero      = ef_vi_sw_eventq_timer_clear;
+}
+
+
+/**********************************************************************
+ * Wire attachment.
+ */
+
+static int ef_vi_sw_lock_port(int fd, int port)
+{
+  struct flock fl;
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = port;
+  fl.l_len = 1;
+#ifdef F_OFD_SETLK
+  /* Open file description locks, so that two VIs in one process can take
+   * the two ports. */
+  return fcntl(fd, F_OFD_SETLK, &fl);
+#else
+  return fcntl(fd, F_SETLK, &fl);
+#endif
+}
+
+
+static int ef_vi_sw_attach_shm(struct ef_vi_sw* sw, const char* cfg)
+{
+  char name[NAME_MAX];
+  const char* colon = strchr(cfg, ':');
+  int len = colon ? colon - cfg : (int) strlen(cfg);
+  struct stat st;
+  void* p;
+  int rc;
+
+  if( len == 0 || len > NAME_MAX - 16 )
+    return -EINVAL;
+  snprintf(name, sizeof(name), "/ef_vi_sw.%.*s", len, cfg);
+  sw->wire_fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+  if( sw->wire_fd < 0 )
+    return -errno;
+  if( fstat(sw->wire_fd, &st) < 0 ) {
+    rc = -errno;
+    goto fail;
+  }
+  if( st.st_size == 0 &&
+      ftruncate(sw->wire_fd, sizeof(struct ef_vi_sw_wire)) < 0 ) {
+    rc = -errno;
+    goto fail;
+  }
+  else if( st.st_size != 0 && st.st_size != sizeof(struct ef_vi_sw_wire) ) {
+    ef_log("%s: ERROR: %s has unexpected size %ld", __FUNCTION__, name,
+           (long) st.st_size);
+    rc = -EINVAL;
+    goto fail;
+  }
+
+  /* Each end holds a lock on its port, so that an unqualified name pairs
+   * up two processes and a crashed process does not leak its port.
+   */
+  if( colon != NULL ) {
+    sw->port = atoi(colon + 1);
+    if( sw->port != 0 && sw->port != 1 ) {
+      rc = -EINVAL;
+      goto fail;
+    }
+    if( ef_vi_sw_lock_port(sw->wire_fd, sw->port) < 0 ) {
+      rc = -EBUSY;
+      goto fail;
+    }
+  }
+  else if( ef_vi_sw_lock_port(sw->wire_fd, 0) == 0 ) {
+    sw->port = 0;
+  }
+  else if( ef_vi_sw_lock_port(sw->wire_fd, 1) == 0 ) {
+    sw->port = 1;
+  }
+  else {
+    rc = -EBUSY;
+    goto fail;
+  }
+
+  p = mmap(NULL, sizeof(struct ef_vi_sw_wire), PROT_READ | PROT_WRITE,
+           MAP_SHARED, sw->wire_fd, 0);
+  if( p == MAP_FAILED ) {
+    rc = -errno;
+    goto fail;
+  }
+  sw->wire = p;
+  /* Anything left on our receive ring is from a previous user. */
+  sw->wire->ring[!sw->port].cons = sw->wire->ring[!sw->port].prod;
+  sw->mac[0] = 0x02;
+  sw->mac[5] = sw->port + 1;
+  return 0;
+
+ fail:
+  close(sw->wire_fd);
+  sw->wire_fd = -1;
+  return rc;
+}
+
+
+static int ef_vi_sw_attach_if(struct ef_vi_sw* sw, const char* ifname)
+{
+  struct sockaddr_ll sll;
+  struct ifreq ifr;
+  int rc;
+
+  sw->pkt_fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if( sw->pkt_fd < 0 )
+    return -errno;
+  memset(&sll, 0, sizeof(sll));
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons(ETH_P_ALL);
+  sll.sll_ifindex = if_nametoindex(ifname);
+  if( sll.sll_ifindex == 0 ||
+      bind(sw->pkt_fd, (struct sockaddr*) &sll, sizeof(sll)) < 0 ) {
+    rc = -errno;
+    close(sw->pkt_fd);
+    sw->pkt_fd = -1;
+    return rc;
+  }
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name) - 1);
+  if( ioctl(sw->pkt_fd, SIOCGIFHWADDR, &ifr) == 0 )
+    memcpy(sw->mac, ifr.ifr_hwaddr.sa_data, sizeof(sw->mac));
+  return 0;
+}
+
+
+/**********************************************************************
+ * Resource management.
+ */
+
+static int ef_vi_sw_round_up_pow2(int n)
+{
+  int v = 1;
+  while( v < n )
+    v <<= 1;
+  return v;
+}
+
+
+/* One event per RX descriptor and up to three per TX descriptor. */
+static unsigned ef_vi_sw_evq_need(int rxq_capacity, int txq_capacity,
+                                  enum ef_vi_flags evq_flags)
+{
+  return rxq_capacity +
+    txq_capacity * ((evq_flags & EF_VI_TX_TIMESTAMPS) ? 3 : 1);
+}
+
+
+/* Makes room in [evq] for [need] outstanding events, moving any that have
+ * not yet been polled into the new ring at the same offsets.
+ */
+static int ef_vi_sw_evq_reserve(ef_vi* evq, unsigned need)
+{
+  struct ef_vi_sw* sw = EF_VI_SW(evq);
+  unsigned old_mask = evq->evq_mask;
+  unsigned capacity = (old_mask + 1) / sizeof(ef_vi_event);
+  unsigned ptr;
+  size_t bytes;
+  void* ring;
+
+  /* ef10_ef_eventq_poll() sees an overflow once the writer is within the
+   * clear stride of the reader. */
+  sw->evq_need += need;
+  if( sw->evq_need + ef_vi_evq_clear_stride() < capacity )
+    return 0;
+
+  capacity = ef_vi_sw_round_up_pow2(sw->evq_need +
+                                    ef_vi_evq_clear_stride() + 1);
+  bytes = CI_ROUND_UP(capacity * sizeof(ef_vi_event), CI_PAGE_SIZE);
+  if( posix_memalign(&ring, CI_PAGE_SIZE, bytes) != 0 ) {
+    sw->evq_need -= need;
+    return -ENOMEM;
+  }
+  memset(ring, 0xff, bytes);
+  for( ptr = evq->ep_state->evq.evq_ptr; ptr != sw->evq_wptr;
+       ptr += sizeof(ef_vi_event) )
+    memcpy((char*) ring + (ptr & (capacity * sizeof(ef_vi_event) - 1)),
+           evq->evq_base + (ptr & old_mask), sizeof(ef_vi_event));
+  free(sw->evq_ring);
+  sw->evq_ring = ring;
+  evq->inited &= ~EF_VI_INITED_EVQ;
+  ef_vi_init_evq(evq, capacity, ring);
+  LOGV(ef_log("%s: event queue grown to %u entries", __FUNCTION__,
+              capacity));
+  return 0;
+}
+
+
+int ef_vi_sw_alloc(ef_vi* vi, int evq_capacity, int rxq_capacity,
+                   int txq_capacity, ef_vi* evq, enum ef_vi_flags vi_flags)
+{
+  const char* cfg = ef_vi_sw_config();
+  struct ef_vi_sw* sw;
+  ef_vi_state* state;
+  ef_request_id* ids;
+  size_t sw_bytes, evq_bytes, rxq_bytes, txq_bytes, bytes;
+  void* evq_ring = NULL;
+  char* mem;
+  const char* s;
+  int rc;
+
+  if( vi_flags & (EF_VI_RX_PACKED_STREAM | EF_VI_RX_EVENT_MERGE |
+                  EF_VI_TX_ALT) )
+    return -EOPNOTSUPP;
+  if( evq != NULL && evq->vi_qs_n == EF_VI_MAX_QS )
+    return -EBUSY;
+
+  if( txq_capacity < 0 && (s = getenv("EF_VI_TXQ_SIZE")) )
+    txq_capacity = atoi(s);
+  if( rxq_capacity < 0 && (s = getenv("EF_VI_RXQ_SIZE")) )
+    rxq_capacity = atoi(s);
+  if( txq_capacity < 0 )
+    txq_capacity = EF_VI_SW_TXQ_DEFAULT;
+  if( rxq_capacity < 0 )
+    rxq_capacity = EF_VI_SW_RXQ_DEFAULT;
+  rxq_capacity = rxq_capacity ? ef_vi_sw_round_up_pow2(rxq_capacity) : 0;
+  txq_capacity = txq_capacity ? ef_vi_sw_round_up_pow2(txq_capacity) : 0;
+  if( evq != NULL ) {
+    evq_capacity = 0;
+  }
+  else {
+    if( evq_capacity < 0 && (s = getenv("EF_VI_EVQ_SIZE")) )
+      evq_capacity = atoi(s);
+    /* Room for this VI's own queues plus slack for time sync events and
+     * the clear stride.  VIs that share the event queue add to this when
+     * they join.
+     */
+    if( evq_capacity < 0 )
+      evq_capacity = ef_vi_sw_evq_need(rxq_capacity, txq_capacity,
+                                       vi_flags) + EF_VI_SW_EVQ_SLACK;
+    evq_capacity = ef_vi_sw_round_up_pow2(evq_capacity +
+                                          ef_vi_evq_clear_stride());
+    if( evq_capacity < 512 )
+      evq_capacity = 512;
+  }
+
+  /* The event ring is allocated on its own so that it can grow. */
+  sw_bytes = CI_ROUND_UP(sizeof(struct ef_vi_sw), CI_PAGE_SIZE);
+  evq_bytes = CI_ROUND_UP(evq_capacity * sizeof(ci_qword_t), CI_PAGE_SIZE);
+  rxq_bytes = CI_ROUND_UP(rxq_capacity * sizeof(ci_qword_t), CI_PAGE_SIZE);
+  txq_bytes = CI_ROUND_UP(txq_capacity * sizeof(ci_qword_t), CI_PAGE_SIZE);
+  bytes = sw_bytes + rxq_bytes + txq_bytes;
+  if( posix_memalign((void**) &mem, CI_PAGE_SIZE, bytes) != 0 )
+    return -ENOMEM;
+  memset(mem, 0, bytes);
+  if( evq_capacity &&
+      posix_memalign(&evq_ring, CI_PAGE_SIZE, evq_bytes) != 0 ) {
+    evq_ring = NULL;
+    rc = -ENOMEM;
+    goto fail1;
+  }
+  state = malloc(ef_vi_calc_state_bytes(rxq_capacity, txq_capacity));
+  if( state == NULL ) {
+    rc = -ENOMEM;
+    goto fail1;
+  }
+
+  sw = (struct ef_vi_sw*) mem;
+  sw->wire_fd = -1;
+  sw->pkt_fd = -1;
+  if( ! strncmp(cfg, "if:", 3) )
+    rc = ef_vi_sw_attach_if(sw, cfg + 3);
+  else
+    rc = ef_vi_sw_attach_shm(sw, cfg);
+  if( rc < 0 ) {
+    ef_log("%s: ERROR: failed to attach to EF_VI_SW=%s (rc=%d)",
+           __FUNCTION__, cfg, rc);
+    goto fail2;
+  }
+
+  /* The adapter reads buffers through their virtual addresses, which
+   * ef_memreg_alloc() hands out as DMA addresses in this mode.
+   */
+  vi_flags |= EF_VI_TX_PHYS_ADDR | EF_VI_RX_PHYS_ADDR;
+  ef_vi_init(vi, EF_VI_ARCH_EF10, 'A', 0, vi_flags, 0, state);
+  ef_vi_sw_initialise_ops(vi);
+  ef_vi_init_out_flags(vi, EF_VI_OUT_CLOCK_SYNC_STATUS);
+  vi->vi_mem_mmap_ptr = mem;
+  vi->vi_mem_mmap_bytes = bytes;
+  mem += sw_bytes;
+  if( evq_capacity ) {
+    ef_vi_init_evq(vi, evq_capacity, evq_ring);
+    memset(evq_ring, 0xff, evq_bytes);
+    sw->evq_ring = evq_ring;
+    sw->evq_need = EF_VI_SW_EVQ_SLACK;
+  }
+  ids = (void*) (state + 1);
+  if( rxq_capacity ) {
+    ef_vi_init_rxq(vi, rxq_capacity, mem, ids, EF_VI_SW_RX_PREFIX_LEN);
+    ids += rxq_capacity;
+  }
+  mem += rxq_bytes;
+  if( txq_capacity )
+    ef_vi_init_txq(vi, txq_capacity, mem, ids);
+  if( vi_flags & (EF_VI_RX_TIMESTAMPS | EF_VI_TX_TIMESTAMPS) ) {
+    ef_vi_set_ts_format(vi, TS_FORMAT_SECONDS_QTR_NANOSECONDS);
+    if( rxq_capacity )
+      ef_vi_init_rx_timestamping(vi, -2);
+    if( txq_capacity )
+      ef_vi_init_tx_timestamping(vi, 0);
+  }
+  vi->vi_ps_buf_size = 1024 * 1024;
+  vi->vi_i = sw->port;
+  ef_vi_init_state(vi);
+
+  sw->evq = evq ? evq : vi;
+  /* TX timestamp events are written if the event queue asks for them. */
+  sw->q_need = ef_vi_sw_evq_need(rxq_capacity, txq_capacity,
+                                 sw->evq->vi_flags);
+  rc = ef_vi_sw_evq_reserve(sw->evq, sw->q_need);
+  if( rc < 0 )
+    goto fail3;
+  sw->q_label = ef_vi_add_queue(sw->evq, vi);
+  if( evq_capacity )
+    ef_vi_sw_maybe_sync(vi, ef_vi_sw_now_ns());
+  return sw->q_label;
+
+ fail3:
+  if( sw->wire != NULL )
+    munmap(sw->wire, sizeof(struct ef_vi_sw_wire));
+  if( sw->wire_fd >= 0 )
+    close(sw->wire_fd);
+  if( sw->pkt_fd >= 0 )
+    close(sw->pkt_fd);
+ fail2:
+  free(state);
+ fail1:
+  free(evq_ring);
+  free(mem);
+  return rc;
+}
+
+
+int ef_vi_sw_free(ef_vi* vi)
+{
+  struct ef_vi_sw* sw = EF_VI_SW(vi);
+
+  if( sw->evq != vi )
+    EF_VI_SW(sw->evq)->evq_need -= sw->q_need;
+  if( sw->wire != NULL ) {
+    if( sw->wire->ring[sw->port].drops )
+      LOGV(ef_log("%s: %u frames dropped on the wire", __FUNCTION__,
+                  sw->wire->ring[sw->port].drops));
+    munmap(sw->wire, sizeof(struct ef_vi_sw_wire));
+  }
+  if( sw->wire_fd >= 0 )
+    close(sw->wire_fd);
+  if( sw->pkt_fd >= 0 )
+    close(sw->pkt_fd);
+  free(sw->evq_ring);
+  free(vi->vi_mem_mmap_ptr);
+  free(vi->ep_state);
+  free(vi->vi_stats);
+  EF_VI_DEBUG(memset(vi, 0, sizeof(*vi)));
+  return 0;
+}
+
+
+void ef_vi_sw_get_mac(ef_vi* vi, void* mac_out)
+{
+  memcpy(mac_out, EF_VI_SW(vi)->mac, 6);
+}
+
+
+int ef_vi_sw_memreg_alloc(ef_memreg* mr, void* p_mem, size_t len_bytes)
+{
+  size_t i, n_nic_pages;
+
+  if( ((uintptr_t) p_mem & (EF_VI_NIC_PAGE_SIZE - 1)) != 0 )
+    return -EINVAL;
+  n_nic_pages = (len_bytes + EF_VI_NIC_PAGE_SIZE - 1) >> EF_VI_NIC_PAGE_SHIFT;
+  mr->mr_dma_addrs_base = malloc(n_nic_pages * sizeof(mr->mr_dma_addrs[0]));
+  if( mr->mr_dma_addrs_base == NULL )
+    return -ENOMEM;
+  for( i = 0; i < n_nic_pages; ++i )
+    mr->mr_dma_addrs_base[i] =
+      (uintptr_t) p_mem + (i << EF_VI_NIC_PAGE_SHIFT);
+  mr->mr_dma_addrs = mr->mr_dma_addrs_base;
+  return 0;
+}
+
+
+int ef_vi_sw_pd_alloc(ef_pd* pd, const char* intf_name,
+                      enum ef_pd_flags flags)
+{
+  memset(pd, 0, sizeof(*pd));
+  pd->pd_flags = flags | EF_PD_PHYS_MODE;
+  pd->pd_intf_name = strdup(intf_name != NULL ? intf_name : "ef_vi_sw");
+  if( pd->pd_intf_name == NULL )
+    return -ENOMEM;
+  pd->pd_cluster_sock = -1;
+  return 0;
+}
+
+
+int ef_vi_sw_eventq_wait(ef_vi* evq, unsigned current_ptr,
+                         const struct timeval* timeout)
+{
+  /* There is no interrupt to wait for, so spin polling the adapter until
+   * an event arrives or the timeout expires.
+   */
+  uint64_t deadline = 0;
+
+  if( timeout != NULL && (timeout->tv_sec || timeout->tv_usec) )
+    deadline = ef_vi_sw_now_ns() + timeout->tv_sec * 1000000000ULL +
+               timeout->tv_usec * 1000ULL;
+  while( 1 ) {
+    int i;
+    for( i = 0; i < evq->vi_qs_n; ++i )
+      if( evq->vi_qs[i]->vi_rxq.mask )
+        ef_vi_sw_rx_poll(evq->vi_qs[i]);
+    if( EF_VI_SW(evq)->evq_wptr != current_ptr )
+      return 0;
+    if( deadline && ef_vi_sw_now_ns() >= deadline )
+      return -ETIMEDOUT;
+  }
+}
+
+/*! \cidoxg_end */
@@ -18,6 +18,11 @@
 int ef_vi_prime(ef_vi* vi, ef_driver_handle dh, unsigned current_ptr)
 {
   ci_resource_prime_op_t  op;
+  /* The software backend's handle is always readable, so callers that
+   * block in poll() fall back to polling the event queue.
+   */
+  if( ef_vi_sw_config() != NULL )
+    return 0;
   op.crp_id = efch_make_resource_id(vi->vi_resource_id);
   op.crp_current_ptr = current_ptr;
   return ci_resource_prime(dh, &op);
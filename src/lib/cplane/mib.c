@@ -59,6 +59,10 @@ struct cp_mib_region {
   MIB_MEMBER_REGION(type, mbr, \
                     CI_MEMBER_OFFSET(struct cp_tables_dim, dim_mbr), \
                     MIBRG_TABLE | MIBRG_DOUBLE_BUFFERED)
+#define SB_TABLE(type, mbr, dim_mbr) \
+  MIB_MEMBER_REGION(type, mbr, \
+                    CI_MEMBER_OFFSET(struct cp_tables_dim, dim_mbr), \
+                    MIBRG_TABLE)
 
 #define END_PUBLIC_REGION()  { .flags = MIBRG_PUBLIC_END, }
 
@@ -90,9 +94,17 @@ static const struct cp_mib_region cp_mib_regions[] = {
   DB_TABLE(cicp_llap_row_t, llap, llap_max),
   DB_TABLE(cicp_ipif_row_t, ipif, ipif_max),
   DB_TABLE(cicp_ip6if_row_t, ip6if, ip6if_max),
+
+  SB_MEMBER(struct cp_lpm_hdr, lpm),
+  SB_TABLE(struct cp_lpm_nh, lpm_nh, lpm_nh_max),
+  SB_TABLE(cp_lpm_ent_t, lpm_tbl24, lpm_tbl24_size),
+  SB_TABLE(struct cp_lpm_tbl8, lpm_tbl8, lpm_tbl8_max),
+  SB_TABLE(struct cp_lpm6_node, lpm6, lpm6_node_max),
+  SB_TABLE(struct cp_lpm_neigh, lpm_neigh, lpm_neigh_max),
 };
 
 #undef END_PUBLIC_REGION
+#undef SB_TABLE
 #undef DB_TABLE
 #undef DB_MEMBER
 #undef SB_MEMBER
@@ -196,9 +208,12 @@ void cp_init_mibs_fwd_blob(void* romem, struct cp_mibs* mibs)
 {
   struct cp_fwd_row* fwd_table = cp_fwd_table_within_blob(romem);
   ci_ipx_pfx_t* fwd_prefix = cp_fwd_prefix_within_blob(romem, mibs->dim);
+  struct cp_fwd_journal* journal = cp_fwd_journal_within_blob(romem,
+                                                              mibs->dim);
 
   mibs[0].fwd_table.rows = mibs[1].fwd_table.rows = fwd_table;
   mibs[0].fwd_table.prefix = mibs[1].fwd_table.prefix = fwd_prefix;
+  mibs[0].fwd_table.journal = mibs[1].fwd_table.journal = journal;
 }
 #endif
 
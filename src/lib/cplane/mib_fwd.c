@@ -108,3 +108,33 @@ __cp_fwd_find_match(struct cp_fwd_table* fwd_table, struct cp_fwd_key* key,
 
   return CICP_ROWID_BAD;
 }
+
+
+void
+cp_fwd_row_version_bump(struct cp_fwd_table* fwd_table, cicp_mac_rowid_t id)
+{
+  struct cp_fwd_row* fwd = cp_get_fwd_by_id(fwd_table, id);
+
+  /* Whatever was written to the row must be visible before the version
+   * that tells clients to look at it. */
+  ci_wmb();
+  fwd->version++;
+  cp_fwd_journal_append(fwd_table->journal, id);
+}
+
+
+void
+cp_fwd_row_update(struct cp_fwd_table* fwd_table, cicp_mac_rowid_t id,
+                  const struct cp_fwd_data* data)
+{
+  struct cp_fwd_row* fwd = cp_get_fwd_by_id(fwd_table, id);
+  cp_version_t ver = fwd->version;
+
+  /* Fill in the snapshot that clients are not reading, move them over to
+   * it, and then bring the other one into line.  A client that read the
+   * old snapshot sees the version change and reads again. */
+  fwd->data[(ver + 1) & 1] = *data;
+  cp_fwd_row_version_bump(fwd_table, id);
+  ci_wmb();
+  fwd->data[ver & 1] = *data;
+}
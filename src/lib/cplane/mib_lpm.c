@@ -0,0 +1,576 @@
+/* SPDX-License-Identifier: GPL-2.0 OR Solarflare-Binary */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Longest-prefix-match route and neighbour tables.
+ * The lookups are used by clients, at UL and in the kernel.  Everything
+ * else is for the server, which alone writes to these tables.
+ * The lookups may race with the server: whatever they read must not take
+ * them out of bounds, and the caller throws the result away if the version
+ * has changed.
+ */
+
+#include <ci/tools.h>
+
+#define CI_CFG_IPV6 1
+#include <onload/hash.h>
+#include <cplane/hash.h>
+#include <cplane/mib.h>
+
+#ifndef __KERNEL__
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+#endif
+
+
+static inline int cp_lpm_ent_depth(cp_lpm_ent_t ent)
+{
+  return (ent & CP_LPM_ENT_DEPTH_MASK) >> CP_LPM_ENT_DEPTH_SHIFT;
+}
+
+static inline ci_uint32 cp_lpm4_mask(cicp_prefixlen_t pfx)
+{
+  return pfx == 0 ? 0 : ~0u << (32 - pfx);
+}
+
+/* Bit [i] of an IPv6 address, counting from the most significant one. */
+static inline int cp_lpm6_bit(const ci_addr_sh_t* a, int i)
+{
+  return (a->ip6[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+/* Number of leading bits that [a] and [b] have in common, up to [max]. */
+static int
+cp_lpm6_common(const ci_addr_sh_t* a, const ci_addr_sh_t* b, int max)
+{
+  int i;
+
+  for( i = 0; i < 2; ++i ) {
+    ci_uint64 x = CI_BSWAP_BE64(a->u64[i] ^ b->u64[i]);
+    if( x != 0 )
+      return CI_MIN(i * 64 + __builtin_clzll(x), max);
+  }
+  return max;
+}
+
+static inline int cp_lpm_neigh_match(const struct cp_lpm_neigh* neigh,
+                                     ci_ifid_t ifindex,
+                                     const ci_addr_sh_t* addr)
+{
+  return neigh->ifindex == ifindex &&
+         neigh->addr.u64[0] == addr->u64[0] &&
+         neigh->addr.u64[1] == addr->u64[1];
+}
+
+static inline void
+cp_lpm_neigh_hash(struct cp_mibs* mib, ci_ifid_t ifindex,
+                  const ci_addr_sh_t* addr,
+                  cicp_mac_rowid_t* hash1, cicp_mac_rowid_t* hash2)
+{
+  cp_calc_hash(mib->dim->lpm_neigh_max - 1, &addr_sh_any, addr, ifindex,
+               0, 0, hash1, hash2);
+}
+
+
+static ci_uint32 cp_lpm4_lookup(struct cp_mibs* mib, ci_ip_addr_t ip_be)
+{
+  ci_uint32 ip = CI_BSWAP_BE32(ip_be);
+  cp_lpm_ent_t ent = mib->lpm_tbl24[ip >> 8];
+
+  if( ent & CP_LPM_ENT_EXT ) {
+    ci_uint32 group = ent & CP_LPM_ENT_IDX_MASK;
+    if( group >= mib->dim->lpm_tbl8_max )
+      return CP_LPM_NH_NONE;
+    ent = mib->lpm_tbl8[group].ent[ip & (CP_LPM_TBL8_SIZE - 1)];
+  }
+  if( ~ent & CP_LPM_ENT_VALID )
+    return CP_LPM_NH_NONE;
+  return ent & CP_LPM_ENT_IDX_MASK;
+}
+
+
+static ci_uint32 cp_lpm6_lookup(struct cp_mibs* mib, const ci_addr_sh_t* dst)
+{
+  ci_uint32 max = mib->dim->lpm6_node_max;
+  const struct cp_lpm6_node* node;
+  ci_uint32 nh = CP_LPM_NH_NONE;
+  ci_uint32 id;
+
+  if( max == 0 )
+    return CP_LPM_NH_NONE;
+
+  /* The root matches anything.  Below it, every node is longer than its
+   * parent, which bounds the walk even if the server is changing the trie
+   * under our feet. */
+  node = &mib->lpm6[0];
+  while( 1 ) {
+    const struct cp_lpm6_node* child;
+
+    if( node->nh != CP_LPM_NH_NONE )
+      nh = node->nh;
+    if( node->len >= 128 )
+      break;
+    id = node->child[cp_lpm6_bit(dst, node->len)];
+    if( id == 0 || id >= max )
+      break;
+    child = &mib->lpm6[id];
+    if( child->len <= node->len || child->len > 128 ||
+        cp_lpm6_common(dst, &child->pfx, child->len) != child->len )
+      break;
+    node = child;
+  }
+  return nh;
+}
+
+
+/* Returns the next-hop row for [dst], or CP_LPM_NH_NONE. */
+ci_uint32 cp_lpm_route_lookup(struct cp_mibs* mib, const ci_addr_sh_t* dst)
+{
+  ci_uint32 nh;
+
+  if( CI_IS_ADDR_SH_IP6(*dst) )
+    nh = cp_lpm6_lookup(mib, dst);
+  else
+    nh = cp_lpm4_lookup(mib, dst->ip4);
+
+  if( nh != CP_LPM_NH_NONE && nh >= mib->dim->lpm_nh_max )
+    return CP_LPM_NH_NONE;
+  return nh;
+}
+
+
+struct cp_lpm_neigh*
+cp_lpm_neigh_lookup(struct cp_mibs* mib, ci_ifid_t ifindex,
+                    const ci_addr_sh_t* addr)
+{
+  cicp_mac_rowid_t mask = mib->dim->lpm_neigh_max - 1;
+  cicp_mac_rowid_t hash, hash2;
+  int iter = 0;
+
+  if( mib->dim->lpm_neigh_max == 0 )
+    return NULL;
+
+  cp_lpm_neigh_hash(mib, ifindex, addr, &hash, &hash2);
+  do {
+    struct cp_lpm_neigh* neigh = &mib->lpm_neigh[hash];
+    if( neigh->state == CP_LPM_NEIGH_FREE )
+      return NULL;
+    if( neigh->state != CP_LPM_NEIGH_DELETED &&
+        cp_lpm_neigh_match(neigh, ifindex, addr) )
+      return neigh;
+    hash = (hash + hash2) & mask;
+  } while( ++iter < (mask >> 2) );
+
+  return NULL;
+}
+
+
+#ifndef __KERNEL__
+
+static void cp_lpm_write_start(cp_version_t* version)
+{
+  if( ~*version & 1 )
+    ++*version;
+  ci_wmb();
+}
+
+static void cp_lpm_write_stop(cp_version_t* version)
+{
+  ci_wmb();
+  /* Zero means "never published". */
+  if( ++*version == 0 )
+    *version = 2;
+}
+
+
+void cp_lpm_route_begin(struct cp_mibs* mib)
+{
+  struct cp_lpm_hdr* hdr = mib->lpm;
+
+  ci_assert(cp_lpm_published(mib));
+
+  cp_lpm_write_start(&hdr->route_version);
+
+  memset(mib->lpm_tbl24, 0, sizeof(cp_lpm_ent_t) * CP_LPM_TBL24_SIZE);
+  hdr->nh_used = 0;
+  hdr->tbl8_used = 0;
+  hdr->lpm6_used = 0;
+  if( mib->dim->lpm6_node_max > 0 ) {
+    memset(&mib->lpm6[0], 0, sizeof(mib->lpm6[0]));
+    mib->lpm6[0].nh = CP_LPM_NH_NONE;
+    hdr->lpm6_used = 1;
+  }
+}
+
+
+void cp_lpm_route_commit(struct cp_mibs* mib)
+{
+  ci_assert(mib->lpm->route_version & 1);
+  cp_lpm_write_stop(&mib->lpm->route_version);
+}
+
+
+/* Finds the next-hop row equal to [nh], or adds one.  There are few next
+ * hops even in big routing tables, so a linear search is good enough. */
+static ci_uint32 cp_lpm_nh_get(struct cp_mibs* mib, const struct cp_lpm_nh* nh)
+{
+  struct cp_lpm_hdr* hdr = mib->lpm;
+  ci_uint32 id;
+
+  for( id = 0; id < hdr->nh_used; ++id )
+    if( memcmp(&mib->lpm_nh[id], nh, sizeof(*nh)) == 0 )
+      return id;
+
+  if( id >= mib->dim->lpm_nh_max || id > CP_LPM_ENT_IDX_MASK )
+    return CP_LPM_NH_NONE;
+  mib->lpm_nh[id] = *nh;
+  hdr->nh_used++;
+  return id;
+}
+
+
+/* Overwrites those of [n] entries that come from prefixes no longer than
+ * the one [val] is for.  Entries pointing to tbl8 groups are descended
+ * into. */
+static void
+cp_lpm4_fill(struct cp_mibs* mib, cp_lpm_ent_t* ent, ci_uint32 n,
+             cp_lpm_ent_t val)
+{
+  int depth = cp_lpm_ent_depth(val);
+  ci_uint32 i;
+
+  for( i = 0; i < n; ++i ) {
+    if( ent[i] & CP_LPM_ENT_EXT )
+      cp_lpm4_fill(mib, mib->lpm_tbl8[ent[i] & CP_LPM_ENT_IDX_MASK].ent,
+                   CP_LPM_TBL8_SIZE, val);
+    else if( cp_lpm_ent_depth(ent[i]) <= depth )
+      ent[i] = val;
+  }
+}
+
+
+static int
+cp_lpm4_add(struct cp_mibs* mib, ci_uint32 ip, cicp_prefixlen_t pfx,
+            ci_uint32 nh)
+{
+  cp_lpm_ent_t val = CP_LPM_ENT_VALID | nh |
+                     ((cp_lpm_ent_t) pfx << CP_LPM_ENT_DEPTH_SHIFT);
+  cp_lpm_ent_t* ent24;
+  ci_uint32 group;
+
+  ip &= cp_lpm4_mask(pfx);
+  if( pfx <= 24 ) {
+    cp_lpm4_fill(mib, &mib->lpm_tbl24[ip >> 8], 1u << (24 - pfx), val);
+    return 0;
+  }
+
+  ent24 = &mib->lpm_tbl24[ip >> 8];
+  if( ~*ent24 & CP_LPM_ENT_EXT ) {
+    /* The new group inherits whatever covered the whole /24 so far. */
+    struct cp_lpm_hdr* hdr = mib->lpm;
+    int i;
+
+    group = hdr->tbl8_used;
+    if( group >= mib->dim->lpm_tbl8_max || group > CP_LPM_ENT_IDX_MASK )
+      return -ENOSPC;
+    for( i = 0; i < CP_LPM_TBL8_SIZE; ++i )
+      mib->lpm_tbl8[group].ent[i] = *ent24;
+    *ent24 = CP_LPM_ENT_EXT | group;
+    hdr->tbl8_used++;
+  }
+  group = *ent24 & CP_LPM_ENT_IDX_MASK;
+  cp_lpm4_fill(mib, &mib->lpm_tbl8[group].ent[ip & (CP_LPM_TBL8_SIZE - 1)],
+               1u << (32 - pfx), val);
+  return 0;
+}
+
+
+static ci_uint32
+cp_lpm6_node_alloc(struct cp_mibs* mib, const ci_addr_sh_t* addr,
+                   cicp_prefixlen_t len, ci_uint32 nh)
+{
+  ci_uint32 id = mib->lpm->lpm6_used++;
+  struct cp_lpm6_node* node = &mib->lpm6[id];
+
+  ci_assert_lt(id, mib->dim->lpm6_node_max);
+  node->pfx = *addr;
+  cp_addr_apply_pfx(&node->pfx, len);
+  node->len = len;
+  node->child[0] = node->child[1] = 0;
+  node->nh = nh;
+  return id;
+}
+
+
+static int
+cp_lpm6_add(struct cp_mibs* mib, const ci_addr_sh_t* addr,
+            cicp_prefixlen_t pfx, ci_uint32 nh)
+{
+  struct cp_lpm6_node* node;
+  ci_uint32 id = 0;
+
+  if( mib->lpm->lpm6_used == 0 )
+    return -ENOSPC;
+
+  while( 1 ) {
+    struct cp_lpm6_node* child;
+    ci_uint32 child_id, new_id;
+    int bit, common;
+
+    node = &mib->lpm6[id];
+    if( node->len == pfx ) {
+      node->nh = nh;
+      return 0;
+    }
+
+    /* The node is shorter than the prefix, or we would not be here. */
+    bit = cp_lpm6_bit(addr, node->len);
+    child_id = node->child[bit];
+    if( child_id == 0 ) {
+      if( mib->lpm->lpm6_used >= mib->dim->lpm6_node_max )
+        return -ENOSPC;
+      node->child[bit] = cp_lpm6_node_alloc(mib, addr, pfx, nh);
+      return 0;
+    }
+
+    child = &mib->lpm6[child_id];
+    common = cp_lpm6_common(addr, &child->pfx, CI_MIN(pfx, child->len));
+    if( common == child->len ) {
+      id = child_id;
+      continue;
+    }
+
+    /* The prefix diverges from the child, or ends, before the child does.
+     * Either way the child moves down under a new node of length
+     * [common], which needs a sibling leaf unless the prefix ends there. */
+    if( mib->lpm->lpm6_used + (common == pfx ? 1 : 2) >
+        mib->dim->lpm6_node_max )
+      return -ENOSPC;
+    new_id = cp_lpm6_node_alloc(mib, addr, common,
+                                common == pfx ? nh : CP_LPM_NH_NONE);
+    mib->lpm6[new_id].child[cp_lpm6_bit(&child->pfx, common)] = child_id;
+    if( common != pfx )
+      mib->lpm6[new_id].child[cp_lpm6_bit(addr, common)] =
+        cp_lpm6_node_alloc(mib, addr, pfx, nh);
+    node->child[bit] = new_id;
+    return 0;
+  }
+}
+
+
+/* Adds a route between cp_lpm_route_begin() and cp_lpm_route_commit().
+ * Routes may be added in any order; re-adding a prefix replaces it. */
+int cp_lpm_route_add(struct cp_mibs* mib, const ci_addr_sh_t* dst,
+                     cicp_prefixlen_t pfx, const struct cp_lpm_nh* nh)
+{
+  ci_uint32 nh_id;
+
+  ci_assert(mib->lpm->route_version & 1);
+
+  nh_id = cp_lpm_nh_get(mib, nh);
+  if( nh_id == CP_LPM_NH_NONE )
+    return -ENOSPC;
+
+  if( CI_IS_ADDR_SH_IP6(*dst) ) {
+    ci_assert_le(pfx, 128);
+    return cp_lpm6_add(mib, dst, pfx, nh_id);
+  }
+  ci_assert_le(pfx, 32);
+  return cp_lpm4_add(mib, CI_BSWAP_BE32(dst->ip4), pfx, nh_id);
+}
+
+
+/* Adds, changes or, with CP_LPM_NEIGH_DELETED, removes a neighbour. */
+int cp_lpm_neigh_update(struct cp_mibs* mib, ci_ifid_t ifindex,
+                        const ci_addr_sh_t* addr, const ci_mac_addr_t mac,
+                        ci_uint8 state)
+{
+  cicp_mac_rowid_t mask = mib->dim->lpm_neigh_max - 1;
+  cicp_mac_rowid_t hash, hash2;
+  struct cp_lpm_neigh* found = NULL;
+  struct cp_lpm_neigh* slot = NULL;
+  int iter = 0;
+
+  if( mib->dim->lpm_neigh_max == 0 )
+    return -ENOSPC;
+
+  cp_lpm_neigh_hash(mib, ifindex, addr, &hash, &hash2);
+  do {
+    struct cp_lpm_neigh* neigh = &mib->lpm_neigh[hash];
+    if( neigh->state == CP_LPM_NEIGH_FREE ) {
+      if( slot == NULL )
+        slot = neigh;
+      break;
+    }
+    if( neigh->state == CP_LPM_NEIGH_DELETED ) {
+      if( slot == NULL )
+        slot = neigh;
+    }
+    else if( cp_lpm_neigh_match(neigh, ifindex, addr) ) {
+      found = neigh;
+      break;
+    }
+    hash = (hash + hash2) & mask;
+  } while( ++iter < (mask >> 2) );
+
+  if( state == CP_LPM_NEIGH_DELETED || state == CP_LPM_NEIGH_FREE ) {
+    if( found != NULL ) {
+      cp_lpm_write_start(&mib->lpm->neigh_version);
+      found->state = CP_LPM_NEIGH_DELETED;
+      cp_lpm_write_stop(&mib->lpm->neigh_version);
+    }
+    return 0;
+  }
+
+  if( found == NULL ) {
+    if( slot == NULL )
+      return -ENOSPC;
+    found = slot;
+  }
+
+  cp_lpm_write_start(&mib->lpm->neigh_version);
+  found->addr = *addr;
+  found->ifindex = ifindex;
+  memcpy(found->mac, mac, sizeof(found->mac));
+  found->state = state;
+  cp_lpm_write_stop(&mib->lpm->neigh_version);
+  return 0;
+}
+
+
+static int cp_lpm_nl_addr(int family, const struct rtattr* rta,
+                          ci_addr_sh_t* addr)
+{
+  if( family == AF_INET && RTA_PAYLOAD(rta) == 4 )
+    *addr = CI_ADDR_SH_FROM_IP4(*(ci_ip_addr_t*) RTA_DATA(rta));
+  else if( family == AF_INET6 && RTA_PAYLOAD(rta) == 16 )
+    *addr = CI_ADDR_SH_FROM_IP6(RTA_DATA(rta));
+  else
+    return -EINVAL;
+  return 0;
+}
+
+
+/* Adds the route in an RTM_NEWROUTE message if it is from [table].  The
+ * server passes its route dumps through here between cp_lpm_route_begin()
+ * and cp_lpm_route_commit(): first the main table, then the local one, so
+ * that local and broadcast addresses win over main-table routes for the
+ * same prefix.  Anything but a plain unicast route via one interface is
+ * added as a slow one. */
+int cp_lpm_nl_route(struct cp_mibs* mib, const struct nlmsghdr* nlh,
+                    ci_uint32 table)
+{
+  const struct rtmsg* rtm = NLMSG_DATA(nlh);
+  int len = RTM_PAYLOAD(nlh);
+  ci_uint32 rt_table = rtm->rtm_table;
+  const struct rtattr* rta;
+  struct cp_lpm_nh nh;
+  ci_addr_sh_t dst;
+
+  if( nlh->nlmsg_type != RTM_NEWROUTE || len < 0 )
+    return -EINVAL;
+  if( rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6 )
+    return 0;
+  /* IPv6 dumps may include cached routes. */
+  if( rtm->rtm_flags & RTM_F_CLONED )
+    return 0;
+
+  /* Fields not set below must compare equal in cp_lpm_nh_get(). */
+  memset(&nh, 0, sizeof(nh));
+  if( rtm->rtm_family == AF_INET ) {
+    dst = nh.src = nh.gateway = ip4_addr_sh_any;
+  }
+  else {
+    dst = nh.src = nh.gateway = addr_sh_any;
+  }
+  nh.ifindex = CI_IFID_BAD;
+
+  for( rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len) ) {
+    switch( rta->rta_type ) {
+    case RTA_TABLE:
+      rt_table = *(ci_uint32*) RTA_DATA(rta);
+      break;
+    case RTA_DST:
+      if( cp_lpm_nl_addr(rtm->rtm_family, rta, &dst) < 0 )
+        return -EINVAL;
+      break;
+    case RTA_GATEWAY:
+      if( cp_lpm_nl_addr(rtm->rtm_family, rta, &nh.gateway) < 0 )
+        return -EINVAL;
+      nh.flags |= CP_LPM_NH_FLAG_GATEWAY;
+      break;
+    case RTA_PREFSRC:
+      if( cp_lpm_nl_addr(rtm->rtm_family, rta, &nh.src) < 0 )
+        return -EINVAL;
+      break;
+    case RTA_OIF:
+      nh.ifindex = *(ci_uint32*) RTA_DATA(rta);
+      break;
+    case RTA_METRICS:
+    {
+      const struct rtattr* m = RTA_DATA(rta);
+      int mlen = RTA_PAYLOAD(rta);
+      for( ; RTA_OK(m, mlen); m = RTA_NEXT(m, mlen) )
+        if( m->rta_type == RTAX_MTU )
+          nh.mtu = *(ci_uint32*) RTA_DATA(m);
+      break;
+    }
+    case RTA_MULTIPATH:
+      nh.flags |= CP_LPM_NH_FLAG_SLOW;
+      break;
+    }
+  }
+
+  if( rt_table != table )
+    return 0;
+  if( rtm->rtm_type != RTN_UNICAST || nh.ifindex == CI_IFID_BAD )
+    nh.flags |= CP_LPM_NH_FLAG_SLOW;
+  return cp_lpm_route_add(mib, &dst, rtm->rtm_dst_len, &nh);
+}
+
+
+/* Applies an RTM_NEWNEIGH or RTM_DELNEIGH message.  Only reachable and
+ * permanent neighbours are valid: the fwd cache deals with the rest. */
+int cp_lpm_nl_neigh(struct cp_mibs* mib, const struct nlmsghdr* nlh)
+{
+  const struct ndmsg* ndm = NLMSG_DATA(nlh);
+  int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ndm));
+  const struct rtattr* rta;
+  ci_mac_addr_t mac = {};
+  ci_addr_sh_t addr;
+  int have_dst = 0, have_mac = 0;
+  ci_uint8 state;
+
+  if( (nlh->nlmsg_type != RTM_NEWNEIGH && nlh->nlmsg_type != RTM_DELNEIGH) ||
+      len < 0 )
+    return -EINVAL;
+  if( ndm->ndm_family != AF_INET && ndm->ndm_family != AF_INET6 )
+    return 0;
+
+  for( rta = (const struct rtattr*) (ndm + 1); RTA_OK(rta, len);
+       rta = RTA_NEXT(rta, len) ) {
+    switch( rta->rta_type ) {
+    case NDA_DST:
+      if( cp_lpm_nl_addr(ndm->ndm_family, rta, &addr) < 0 )
+        return -EINVAL;
+      have_dst = 1;
+      break;
+    case NDA_LLADDR:
+      if( RTA_PAYLOAD(rta) == sizeof(mac) ) {
+        memcpy(mac, RTA_DATA(rta), sizeof(mac));
+        have_mac = 1;
+      }
+      break;
+    }
+  }
+  if( ! have_dst )
+    return -EINVAL;
+
+  if( nlh->nlmsg_type == RTM_DELNEIGH )
+    state = CP_LPM_NEIGH_DELETED;
+  else if( have_mac && ndm->ndm_state & (NUD_REACHABLE | NUD_PERMANENT) )
+    state = CP_LPM_NEIGH_VALID;
+  else
+    state = CP_LPM_NEIGH_INVALID;
+  return cp_lpm_neigh_update(mib, ndm->ndm_ifindex, &addr, mac, state);
+}
+
+#endif
@@ -3,7 +3,7 @@
 TARGET		:= $(CPLANE_LIB)
 MMAKE_TYPE	:= LIB
 
-LIB_SRCS	:= mib.c mib_fwd.c services.c onload.c version.c
+LIB_SRCS	:= mib.c mib_fwd.c mib_lpm.c services.c onload.c version.c
 LIB_OBJS	:= $(LIB_SRCS:%.c=$(MMAKE_OBJ_PREFIX)%.o)
 
 ALL		:= $(TARGET)
@@ -184,6 +184,69 @@ static int oo_cp_multipath_hash(struct cp_fwd_key* key, int max)
   return ((p >> 16) & 0x7fff) % max;
 }
 
+/* Resolve [key] from the longest-prefix-match tables if the server publishes
+ * them.  Only complete answers are given: anything which needs the server
+ * (policy routing, an unresolved neighbour, local and multipath routes) is
+ * left to the fwd cache. */
+static int
+oo_cp_lpm_resolve(struct oo_cplane_handle* cp, struct cp_fwd_key* key,
+                  struct cp_fwd_data* data)
+{
+  struct cp_mibs* mib = &cp->mib[0];
+  struct cp_lpm_hdr* lpm = mib->lpm;
+  struct cp_lpm_neigh* neigh;
+  struct cp_lpm_nh nh;
+  cp_version_t ver;
+  ci_uint32 nh_id;
+
+  if( ! cp_lpm_published(mib) ||
+      key->ifindex != CI_IFID_BAD || key->iif_ifindex != CI_IFID_BAD ||
+      key->flag & CP_FWD_KEY_TRANSPARENT )
+    return -ENOENT;
+  if( CI_IS_ADDR_SH_IP6(key->dst) ? key->dst.ip6[0] == 0xff :
+                                    CI_IP_IS_MULTICAST(key->dst.ip4) )
+    return -ENOENT;
+
+  do {
+    ver = OO_ACCESS_ONCE(lpm->route_version);
+    if( ver == 0 || (ver & 1) )
+      return -ENOENT;
+    ci_rmb();
+    nh_id = cp_lpm_route_lookup(mib, &key->dst);
+    if( nh_id == CP_LPM_NH_NONE )
+      return -ENOENT;
+    nh = mib->lpm_nh[nh_id];
+    ci_rmb();
+  } while( ver != OO_ACCESS_ONCE(lpm->route_version) );
+
+  if( nh.flags & CP_LPM_NH_FLAG_SLOW || nh.ifindex == CI_IFID_LOOP )
+    return -ENOENT;
+
+  memset(data, 0, sizeof(*data));
+  data->base.src = nh.src;
+  data->base.next_hop = nh.flags & CP_LPM_NH_FLAG_GATEWAY ? nh.gateway :
+                                                            key->dst;
+  data->base.mtu = nh.mtu;
+  data->base.ifindex = nh.ifindex;
+
+  do {
+    ver = OO_ACCESS_ONCE(lpm->neigh_version);
+    if( ver & 1 )
+      return -ENOENT;
+    ci_rmb();
+    neigh = cp_lpm_neigh_lookup(mib, nh.ifindex, &data->base.next_hop);
+    if( neigh == NULL || neigh->state != CP_LPM_NEIGH_VALID )
+      return -ENOENT;
+    memcpy(data->dst_mac, neigh->mac, sizeof(data->dst_mac));
+    ci_rmb();
+  } while( ver != OO_ACCESS_ONCE(lpm->neigh_version) );
+  data->flags = CICP_FWD_DATA_FLAG_ARP_VALID;
+
+  return oo_cp_find_llap(cp, nh.ifindex,
+                         nh.mtu == 0 ? &data->base.mtu : NULL,
+                         &data->hwports, NULL, &data->src_mac, &data->encap);
+}
+
 int __oo_cp_route_resolve(struct oo_cplane_handle* cp,
                           cicp_verinfo_t* verinfo,
                           struct cp_fwd_key* key,
@@ -206,6 +269,17 @@ int __oo_cp_route_resolve(struct oo_cplane_handle* cp,
       ! cp_fwd_find_row_found_perfect_match(fwd_table, id, key) ) {
     if( ! ask_server )
       return -ENOENT;
+    if( oo_cp_lpm_resolve(cp, key, data) == 0 ) {
+      /* Get the route into the fwd cache for next time, but do not wait
+       * for it.  Until it is there, verinfo stays invalid and the callers
+       * come back here. */
+      struct cp_fwd_key async_key = *key;
+      async_key.flag &= ~CP_FWD_KEY_REQ_WAIT;
+      oo_op_route_resolve(cp, &async_key CI_KERNEL_ARG(fwd_table_id));
+      verinfo->id = CICP_MAC_ROWID_BAD;
+      verinfo->version = 0;
+      return 0;
+    }
     oo_op_route_resolve(cp, key CI_KERNEL_ARG(fwd_table_id));
     ask_server = CI_FALSE;
     first_pass = 1;
@@ -70,7 +70,9 @@ static int efab_file_move_supported_tcp(ci_netif *ni, ci_tcp_state *ts,
       ci_ip_timer_pending(ni, &ts->rto_tid) ||
       ci_ip_timer_pending(ni, &ts->zwin_tid) ||
       ci_ip_timer_pending(ni, &ts->cork_tid) ||
-      OO_PP_NOT_NULL(ts->pmtus) ) {
+      OO_PP_NOT_NULL(ts->pmtus) ||
+      OO_PP_NOT_NULL(ts->rx_region) ||
+      OO_PP_NOT_NULL(ts->pacing) ) {
     if( do_assert ) {
       ci_assert(ci_ip_queue_is_empty(&ts->send));
       ci_assert_equal(ts->send_prequeue, OO_PP_ID_NULL);
@@ -80,6 +82,8 @@ static int efab_file_move_supported_tcp(ci_netif *ni, ci_tcp_state *ts,
       ci_assert(! ci_ip_timer_pending(ni, &ts->zwin_tid));
       ci_assert(! ci_ip_timer_pending(ni, &ts->cork_tid));
       ci_assert(OO_PP_IS_NULL(ts->pmtus));
+      ci_assert(OO_PP_IS_NULL(ts->rx_region));
+      ci_assert(OO_PP_IS_NULL(ts->pacing));
     }
     return false;
   }
@@ -126,13 +130,13 @@ static int efab_file_move_supported_udp(ci_netif *ni, ci_udp_state *us,
   if( ci_udp_recv_q_not_empty(&us->recv_q) ||
       us->zc_kernel_datagram != OO_PP_ID_NULL ||
       us->zc_kernel_datagram_count != 0 ||
-      us->tx_count != 0 || us->tx_async_q != CI_ILL_END ) {
+      us->tx_count != 0 || oo_atomic_read(&us->tx_async_q_level) != 0 ) {
     if( do_assert ) {
       ci_assert(! ci_udp_recv_q_not_empty(&us->recv_q));
       ci_assert_equal(us->zc_kernel_datagram, OO_PP_ID_NULL);
       ci_assert_equal(us->zc_kernel_datagram_count, 0);
       ci_assert_equal(us->tx_count, 0);
-      ci_assert_equal(us->tx_async_q, CI_ILL_END);
+      ci_assert_equal(oo_atomic_read(&us->tx_async_q_level), 0);
     }
     return false;
   }
@@ -343,6 +347,7 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
     mid_ts->zwin_tid = new_ts->zwin_tid;
     mid_ts->kalive_tid = new_ts->kalive_tid;
     mid_ts->cork_tid = new_ts->cork_tid;
+    mid_ts->timers_tid = new_ts->timers_tid;
 #if CI_CFG_TCP_SOCK_STATS
     mid_ts->stats_tid = new_ts->stats_tid;
 #endif
@@ -473,6 +478,7 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
     /* Stop timers */
     ci_ip_timer_clear(&old_thr->netif, &old_ts->kalive_tid);
     ci_ip_timer_clear(&old_thr->netif, &old_ts->delack_tid);
+    ci_ip_timer_clear(&old_thr->netif, &old_ts->timers_tid);
 
     /* Recv queue have already been copied */
     ci_tcp_rx_queue_drop(&old_thr->netif, old_ts, &old_ts->recv1);
@@ -1081,11 +1081,15 @@ efab_tcp_helper_pkt_wait_rsop(ci_private_t* priv, void *lock_flags)
   return efab_tcp_helper_pkt_wait(priv->thr, (int *)lock_flags);
 }
 static int
-efab_tcp_helper_more_bufs_rsop(ci_private_t* priv, void *unused)
+efab_tcp_helper_more_bufs_rsop(ci_private_t* priv, void *arg)
 {
+  int numa_node = *(ci_int32*) arg;
   if (priv->thr == NULL)
     return -EINVAL;
-  return efab_tcp_helper_more_bufs(priv->thr);
+  if( numa_node >= 0 &&
+      (numa_node >= nr_node_ids || ! node_online(numa_node)) )
+    numa_node = -1;
+  return efab_tcp_helper_more_bufs(priv->thr, numa_node);
 }
 static int
 efab_tcp_helper_more_socks_rsop(ci_private_t* priv, void *unused)
@@ -1609,6 +1609,7 @@ static int allocate_vis(tcp_helper_resource_t* trs,
 #endif
     dev = efrm_vi_get_pci_dev(trs_nic->thn_vi_rs);
     strncpy(nsn->pci_dev, pci_name(dev), sizeof(nsn->pci_dev));
+    nsn->numa_node = dev_to_node(&dev->dev);
     pci_dev_put(dev);
     nsn->pci_dev[sizeof(nsn->pci_dev) - 1] = '\0';
     nsn->vi_instance =
@@ -1959,6 +1960,8 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   int i, sz, rc, no_table_entries, no_active_wild_pools;
   int no_active_wild_table_entries;
   int no_seq_table_entries;
+  ci_uint32 lat_hists_size = 0;
+  ci_uint32 dump_ring_size = 0;
   unsigned vi_state_bytes;
 #if CI_CFG_PIO
   unsigned pio_bufs_ofs = 0;
@@ -1995,6 +1998,15 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
     no_seq_table_entries = 0;
   }
 
+  if( NI_OPTS(ni).lat_hist )
+    lat_hists_size = sizeof(ci_netif_lat_hists) +
+                     sizeof(ci_sock_lat_hists) * NI_OPTS(ni).lat_hist_socks;
+#if CI_CFG_TCPDUMP
+  if( NI_OPTS(ni).tcpdump_ring_size )
+    dump_ring_size = sizeof(oo_dump_ring) +
+                  oo_tcpdump_ring_data_size(NI_OPTS(ni).tcpdump_ring_size);
+#endif
+
   /* pkt_sets_n should be zeroed before possible NIC reset */
   if( NI_OPTS(ni).max_packets > max_packets_per_stack ) {
     OO_DEBUG_ERR(ci_log("WARNING: EF_MAX_PACKETS reduced from %d to %d due to "
@@ -2064,6 +2076,12 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   sz += sizeof(ci_tcp_prev_seq_t) * no_seq_table_entries;
   sz = CI_ROUND_UP(sz, __alignof__(struct oo_deferred_pkt));
   sz += sizeof(struct oo_deferred_pkt) * NI_OPTS(ni).defer_arp_pkts;
+  sz = CI_ROUND_UP(sz, __alignof__(ci_netif_lat_hists));
+  sz += lat_hists_size;
+#if CI_CFG_TCPDUMP
+  sz = CI_ROUND_UP(sz, __alignof__(oo_dump_ring));
+  sz += dump_ring_size;
+#endif
   sz = CI_ROUND_UP(sz, __alignof__(ci_netif_filter_table));
   sz += filter_table_size;
   sz = CI_ROUND_UP(sz, __alignof__(ci_netif_filter_table_entry_ext));
@@ -2157,8 +2175,19 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   ns->deferred_pkts_ofs = CI_ROUND_UP(ns->deferred_pkts_ofs,
                                       __alignof__(struct oo_deferred_pkt));
 
-  ns->table_ofs = ns->deferred_pkts_ofs +
+  ns->lat_hists_ofs = ns->deferred_pkts_ofs +
                   sizeof(struct oo_deferred_pkt) * NI_OPTS(ni).defer_arp_pkts;
+  ns->lat_hists_ofs = CI_ROUND_UP(ns->lat_hists_ofs,
+                                  __alignof__(ci_netif_lat_hists));
+
+#if CI_CFG_TCPDUMP
+  ns->dump_ring_ofs = ns->lat_hists_ofs + lat_hists_size;
+  ns->dump_ring_ofs = CI_ROUND_UP(ns->dump_ring_ofs,
+                                  __alignof__(oo_dump_ring));
+  ns->table_ofs = ns->dump_ring_ofs + dump_ring_size;
+#else
+  ns->table_ofs = ns->lat_hists_ofs + lat_hists_size;
+#endif
   ns->table_ofs = CI_ROUND_UP(ns->table_ofs,
                               __alignof__(ci_netif_filter_table));
 
@@ -2178,6 +2207,14 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   ni->active_wild_table = (void*) ((char*) ns + ns->active_wild_ofs);
   ni->seq_table = (void*) ((char*) ns + ns->seq_table_ofs);
   ni->deferred_pkts = (void*) ((char*) ns + ns->deferred_pkts_ofs);
+  ni->lat_hists = lat_hists_size == 0 ? NULL :
+                  (void*) ((char*) ns + ns->lat_hists_ofs);
+#if CI_CFG_TCPDUMP
+  ni->dump_ring = dump_ring_size == 0 ? NULL :
+                  (void*) ((char*) ns + ns->dump_ring_ofs);
+  ni->dump_ring_size = dump_ring_size == 0 ? 0 :
+                  oo_tcpdump_ring_data_size(NI_OPTS(ni).tcpdump_ring_size);
+#endif
   ni->filter_table = (void*) ((char*) ns + ns->table_ofs);
   ni->filter_table_ext = (void*) ((char*) ns + ns->table_ext_ofs);
 
@@ -2197,6 +2234,8 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   ns->max_aux_bufs[CI_TCP_AUX_TYPE_BUCKET] = ni->opts.max_ep_bufs;
   ns->max_aux_bufs[CI_TCP_AUX_TYPE_EPOLL] = ni->opts.max_ep_bufs;
   ns->max_aux_bufs[CI_TCP_AUX_TYPE_PMTUS] = ni->opts.max_ep_bufs;
+  ns->max_aux_bufs[CI_TCP_AUX_TYPE_RX_REGION] = ni->opts.max_ep_bufs;
+  ns->max_aux_bufs[CI_TCP_AUX_TYPE_PACING] = ni->opts.max_ep_bufs;
 
   /* The shared netif-state buffer and EP buffers are part of the mem mmap */
   trs->mem_mmap_bytes += ns->netif_mmap_bytes;
@@ -3804,6 +3843,7 @@ int tcp_helper_rm_alloc(ci_resource_onload_alloc_t* alloc,
   ni->kuid = ci_getuid();
   ni->keuid = ci_geteuid();
   ni->error_flags = 0;
+  ni->tx_batch = 0;
   ci_netif_state_init(&rs->netif, oo_timesync_cpu_khz, alloc->in_name);
   OO_STACK_FOR_EACH_INTF_I(&rs->netif, intf_i) {
     nic = efrm_client_get_nic(rs->nic[intf_i].thn_oo_nic->efrm_client);
@@ -4109,6 +4149,7 @@ thr_reset_stack_tx_cb_state_init(struct thr_reset_stack_tx_cb_state* cb_state,
   cb_state->thr = thr;
   cb_state->ps.tx_pkt_free_list_insert = &cb_state->ps.tx_pkt_free_list;
   cb_state->ps.tx_pkt_free_list_n = 0;
+  cb_state->ps.rx_gro_head = NULL;
 }
 
 static void thr_reset_stack_tx_cb(ef_request_id id, void* arg)
@@ -5579,7 +5620,7 @@ efab_tcp_helper_no_more_bufs(tcp_helper_resource_t* trs)
 
 
 static int 
-efab_tcp_helper_iobufset_alloc(tcp_helper_resource_t* trs,
+efab_tcp_helper_iobufset_alloc(tcp_helper_resource_t* trs, int numa_node,
                                struct oo_iobufset** all_out,
                                struct oo_buffer_pages** pages_out,
                                uint64_t* hw_addrs)
@@ -5623,7 +5664,7 @@ efab_tcp_helper_iobufset_alloc(tcp_helper_resource_t* trs,
 #endif
   }
 #endif
-  rc = oo_iobufset_pages_alloc(HW_PAGES_PER_SET_S, &flags, &pages);
+  rc = oo_iobufset_pages_alloc(HW_PAGES_PER_SET_S, numa_node, &flags, &pages);
   if( rc != 0 )
     return rc;
 #if CI_CFG_PKTS_AS_HUGE_PAGES
@@ -5672,7 +5713,7 @@ efab_tcp_helper_iobufset_alloc(tcp_helper_resource_t* trs,
 
 
 int
-efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
+efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs, int numa_node)
 {
   struct oo_iobufset* iobrs[CI_CFG_MAX_INTERFACES];
   struct oo_buffer_pages* pages;
@@ -5705,7 +5746,7 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
     return -ENOMEM;
   }
 
-  rc = efab_tcp_helper_iobufset_alloc(trs, iobrs, &pages, hw_addrs);
+  rc = efab_tcp_helper_iobufset_alloc(trs, numa_node, iobrs, &pages, hw_addrs);
   if(CI_UNLIKELY( rc < 0 )) {
     /* With highly fragmented memory, iobufset_alloc may fail in
      * atomic context but succeed later in non-atomic context.
@@ -5782,6 +5823,7 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
 
   ni->packets->set[bufset_id].free = OO_PP_NULL;
   ni->packets->set[bufset_id].n_free = PKTS_PER_SET;
+  ni->packets->set[bufset_id].numa_node = oo_iobufset_numa_node(pages);
 #ifdef OO_DO_HUGE_PAGES
   ni->packets->set[bufset_id].shm_id = oo_iobufset_get_shmid(pages);
 #else
@@ -5816,7 +5858,9 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
   }
   ci_free(hw_addrs);
 
-  trs->netif.state->packet_alloc_numa_nodes |= 1 << numa_node_id();
+  if( ni->packets->set[bufset_id].numa_node >= 0 )
+    trs->netif.state->packet_alloc_numa_nodes |=
+      1 << ni->packets->set[bufset_id].numa_node;
   CHECK_FREEPKTS(ni);
   return 0;
 }
@@ -7051,7 +7095,7 @@ efab_tcp_helper_netif_lock_callback(eplock_helper_t* epl, ci_uint64 lock_val,
       }
       OO_DEBUG_TCPH(ci_log("%s: [%u] NEED_PKT_SET now",
                            __FUNCTION__, thr->id));
-      efab_tcp_helper_more_bufs(thr);
+      efab_tcp_helper_more_bufs(thr, -1);
       flags_set &=~ CI_EPLOCK_NETIF_NEED_PKT_SET;
     }
 
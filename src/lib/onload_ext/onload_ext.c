@@ -115,6 +115,26 @@ int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 
 /**************************************************************************/
 
+__attribute__((weak))
+int onload_zc_rx_region_register(int fd, void* base, size_t len)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_zc_rx_region_get(int fd, size_t* offset)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_zc_rx_region_release(int fd, size_t len)
+{
+  return -ENOSYS;
+}
+
+/**************************************************************************/
+
 __attribute__((weak))
 int onload_set_recv_filter(int fd, onload_zc_recv_filter_callback filter,
                            void* cb_arg, int flags)
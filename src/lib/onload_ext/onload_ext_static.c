@@ -154,6 +154,15 @@ wrap(int, onload_zc_recv, (int fd, struct onload_zc_recv_args* args),
 wrap(int, onload_zc_send, (struct onload_zc_mmsg* msgs, int mlen, int flags),
      (msgs, mlen, flags), -ENOSYS)
 
+wrap(int, onload_zc_rx_region_register, (int fd, void* base, size_t len),
+     (fd, base, len), -ENOSYS)
+
+wrap(int, onload_zc_rx_region_get, (int fd, size_t* offset),
+     (fd, offset), -ENOSYS)
+
+wrap(int, onload_zc_rx_region_release, (int fd, size_t len),
+     (fd, len), -ENOSYS)
+
 wrap(int, onload_set_recv_filter, (int fd, onload_zc_recv_filter_callback filter,
                                    void* cb_arg, int flags),
      (fd, filter, cb_arg, flags), -ENOSYS)
@@ -1764,6 +1764,14 @@ int ci_setsockopt_os_fail_ignore(ci_netif* ni, ci_sock_cmn* s, int err,
              optname == ONLOAD_SO_TIMESTAMPING ) &&
            optlen >= sizeof(int) )
     return 1;
+#endif
+#ifdef TCP_CONGESTION
+  /* The kernel may not have the algorithm loaded, but Onload implements
+   * it itself. */
+  else if( (s->b.state & CI_TCP_STATE_TCP) && level == IPPROTO_TCP &&
+           optname == TCP_CONGESTION && err == ENOENT &&
+           ci_tcp_cong_alg_from_name(optval, optlen) >= 0 )
+    return 1;
 #endif
   return 0;
 }
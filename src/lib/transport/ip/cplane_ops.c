@@ -639,3 +639,84 @@ void oo_deferred_free(ci_netif *ni)
                   ni->state->stats.tx_defer_pkt_drop_failed + n);
 }
 #endif
+
+
+/* Size of the filter of changed fwd rows, in bits. */
+#define CICP_JOURNAL_FILTER_BITS 1024
+
+void cicp_ipcache_journal_refresh(ci_netif* ni)
+{
+  struct cp_fwd_table* fwd_table = oo_cp_get_fwd_table(ni->cplane,
+                                                       ci_ni_fwd_table_id(ni));
+  struct cp_fwd_journal* journal = fwd_table->journal;
+  ci_netif_state* ns = ni->state;
+  ci_uint64 filter[CICP_JOURNAL_FILTER_BITS / 64] = { 0 };
+  int first = ns->cp_journal_frc == 0;
+  unsigned id;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  ns->cp_journal_frc = IPTIMER_STATE(ni)->frc;
+  if( journal == NULL )
+    return;
+  if( OO_ACCESS_ONCE(journal->head) == ns->cp_journal_pos )
+    return;
+  if( first ) {
+    ns->cp_journal_pos = OO_ACCESS_ONCE(journal->head);
+    return;
+  }
+
+  /* Collect the changed rows into a bitmap.  Sockets whose rows are not in
+   * it are skipped without looking at the fwd table at all. */
+  if( ! cp_fwd_journal_read(journal, &ns->cp_journal_pos, filter,
+                            CICP_JOURNAL_FILTER_BITS) ) {
+    /* Entries we needed have been overwritten.  Stale routes will be
+     * found by the send path, as they always were. */
+    CITP_STATS_NETIF_INC(ni, ipcache_journal_lost);
+    return;
+  }
+
+  for( id = 0; id < ns->n_ep_bufs; ++id ) {
+    citp_waitable_obj* wo = ID_TO_WAITABLE_OBJ(ni, id);
+    ci_sock_cmn* s = &wo->sock;
+    ci_ip_cached_hdrs* ipcache = &s->pkt;
+    cicp_mac_rowid_t row;
+    int prev_mtu;
+
+    if( (wo->waitable.state & (CI_TCP_STATE_SYNCHRONISED |
+                               CI_TCP_STATE_TXQ_ACTIVE)) !=
+        (CI_TCP_STATE_SYNCHRONISED | CI_TCP_STATE_TXQ_ACTIVE) &&
+        wo->waitable.state != CI_TCP_STATE_UDP )
+      continue;
+    if( ipcache->status != retrrc_success &&
+        ipcache->status != retrrc_nomac )
+      continue;
+    if( ipcache->flags & CI_IP_CACHE_IS_LOCALROUTE ||
+        CI_IPX_ADDR_IS_ANY(ipcache_raddr(ipcache)) )
+      continue;
+    row = ipcache->fwd_ver.id;
+    if( ! CICP_MAC_ROWID_IS_VALID(row) ||
+        ! cp_fwd_journal_filter_test(filter, CICP_JOURNAL_FILTER_BITS, row) ||
+        oo_cp_ipcache_is_valid(ni, ipcache) )
+      continue;
+
+    prev_mtu = ipcache->mtu;
+    cicp_user_retrieve(ni, ipcache, &s->cp);
+    if( ipcache->status == retrrc_success ) {
+      /* Do what the send path would have done on finding the change. */
+      if( wo->waitable.state == CI_TCP_STATE_UDP ) {
+#if CI_CFG_UDP
+        if( wo->udp.udpflags & CI_UDPF_LAST_SEND_NOMAC ) {
+          oo_deferred_send(ni);
+          wo->udp.udpflags &=~ CI_UDPF_LAST_SEND_NOMAC;
+        }
+#endif
+      }
+      else if( ipcache->mtu != prev_mtu ) {
+        ci_tcp_tx_change_mss(ni, &wo->tcp);
+      }
+    }
+    if( oo_cp_ipcache_is_valid(ni, ipcache) )
+      CITP_STATS_NETIF_INC(ni, ipcache_journal_refresh);
+  }
+}
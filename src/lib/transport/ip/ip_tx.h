@@ -127,6 +127,9 @@ __ci_ip_send_tcp(ci_netif* ni, ci_ip_pkt_fmt* pkt, ci_tcp_state* ts)
     ci_ip_local_send(ni, pkt, S_SP(ts), ts->local_peer);
     return;
   }
+  /* Lets TX completion attribute send-to-wire latency to the socket. */
+  if(CI_UNLIKELY( ni->lat_hists != NULL ))
+    pkt->pf.tcp_tx.sock_id = S_SP(ts);
   if(CI_LIKELY( ts->s.pkt.status == retrrc_success &&
                 oo_cp_ipcache_is_valid(ni, &ts->s.pkt) )) {
     ci_ip_set_mac_and_port(ni, &ts->s.pkt, pkt);
@@ -151,6 +151,67 @@ void ci_ip_timer_state_init(ci_netif* netif, unsigned cpu_khz)
 #endif /* __KERNEL */
 
 
+/*
+** Per-socket timer coalescing.
+**
+** A TCP socket has several timers, which are set and cleared far more
+** often than they fire.  With EF_TCP_TIMER_COALESCE, those timers are
+** flagged CI_IP_TIMER_FLAG_COALESCED and are not put on the wheel: setting
+** one just records its deadline and makes sure that the socket's single
+** coalesced timer [timers_tid] is due no later than that.  Clearing one
+** only touches the wheel when it was the last pending timer of the socket.
+** When the coalesced timer fires it runs whichever of the socket's timers
+** are due, and re-arms itself for the earliest remaining one.
+*/
+
+#define CI_TCP_COALESCED_TIMERS(ts)                                     \
+  { &(ts)->rto_tid, &(ts)->delack_tid, &(ts)->zwin_tid,                 \
+    &(ts)->kalive_tid, &(ts)->cork_tid }
+#define CI_TCP_N_COALESCED_TIMERS  5
+
+
+/* Returns the earliest pending coalesced timer of [ts], or NULL. */
+static ci_ip_timer* ci_ip_timer_coalesced_next(ci_tcp_state* ts)
+{
+  ci_ip_timer* timers[CI_TCP_N_COALESCED_TIMERS] = CI_TCP_COALESCED_TIMERS(ts);
+  ci_ip_timer* next = NULL;
+  int i;
+
+  for( i = 0; i < CI_TCP_N_COALESCED_TIMERS; ++i )
+    if( (timers[i]->flags & CI_IP_TIMER_FLAG_PENDING) &&
+        (next == NULL || TIME_LT(timers[i]->time, next->time)) )
+      next = timers[i];
+  return next;
+}
+
+
+static void ci_ip_timer_set_coalesced(ci_netif* netif, ci_ip_timer* ts,
+                                      ci_iptime_t t)
+{
+  ci_ip_timer* ct = &SP_TO_TCP(netif, ts->param1)->timers_tid;
+
+  ci_assert_flags(ts->flags, CI_IP_TIMER_FLAG_COALESCED);
+  ts->flags |= CI_IP_TIMER_FLAG_PENDING;
+  if( ! ci_ip_timer_pending(netif, ct) )
+    __ci_ip_timer_set(netif, ct, t);
+  else if( TIME_LT(t, ct->time) )
+    ci_ip_timer_modify(netif, ct, t);
+}
+
+
+void __ci_ip_timer_clear_coalesced(ci_netif* netif, ci_ip_timer* ts)
+{
+  ci_tcp_state* owner = SP_TO_TCP(netif, ts->param1);
+
+  ci_assert_flags(ts->flags, CI_IP_TIMER_FLAG_COALESCED);
+  ts->flags &=~ CI_IP_TIMER_FLAG_PENDING;
+  /* Otherwise leave the coalesced timer alone: if it fires before the
+   * socket's next deadline it will just re-arm itself. */
+  if( ci_ip_timer_coalesced_next(owner) == NULL )
+    ci_ip_timer_clear(netif, &owner->timers_tid);
+}
+
+
 /* insert a non-pending timer into the scheduler */
 void __ci_ip_timer_set(ci_netif *netif, ci_ip_timer *ts, ci_iptime_t t)
 {
@@ -162,6 +223,11 @@ void __ci_ip_timer_set(ci_netif *netif, ci_ip_timer *ts, ci_iptime_t t)
   /* this is absolute time */
   ts->time = t;
 
+  if( ts->flags & CI_IP_TIMER_FLAG_COALESCED ) {
+    ci_ip_timer_set_coalesced(netif, ts, t);
+    return;
+  }
+
   if( TIME_LT(t, IPTIMER_STATE(netif)->closest_timer) )
     IPTIMER_STATE(netif)->closest_timer = t;
 
@@ -187,6 +253,16 @@ void __ci_ip_timer_set(ci_netif *netif, ci_ip_timer *ts, ci_iptime_t t)
     w = 3;
   }
 
+  /* A timer due in the next turn of wheel [w] can go straight into the
+   * wheel below if its bucket there has already been passed in the current
+   * turn, as nothing else will use that bucket until the next turn.  This
+   * saves cascading the timer later. */
+  if( w >= 2 &&
+      (t >> (CI_IPTIME_BUCKETBITS * w)) ==
+      (stime >> (CI_IPTIME_BUCKETBITS * w)) + 1 &&
+      IPTIMER_BUCKETNO(w - 1, t) <= IPTIMER_BUCKETNO(w - 1, stime) )
+    --w;
+
   bucket = IPTIMER_BUCKET(netif, w, t);
 
   LOG_ITV(log("%s: delta=0x%x (t=0x%x-s=0x%x), w=0x%x, b=0x%x", 
@@ -216,7 +292,7 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
   ci_ip_timer* ts;
   ci_ni_dllist_t* bucket;
   oo_p curid, buckid;
-  int changed = 0;
+  int n = 0;
 
   ci_assert(wheelno > 0 && wheelno < CI_IPTIME_WHEELS);
   /* check time is on the boundary expected by the wheel number passed in */
@@ -263,7 +339,7 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
 
     /* insert ts into wheel below */
     bucket = IPTIMER_BUCKET(netif, wheelno-1, ts->time);
-    changed = 1;
+    ++n;
 
     /* append onto the correct bucket 
     **
@@ -277,9 +353,51 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
     if( wheelno == 1 )
       __ci_timer_busy_set(netif, ts->time);
   }
-  return changed;
+  return n;
+}
+
+
+/* Maximum number of timers to move per tick in ci_ip_timer_precascade(). */
+#define CI_IP_TIMER_PRECASCADE_BUDGET  CI_IPTIME_BUCKETS
+
+/* Move up to [budget] timers from the next bucket of the given wheel into
+** the wheel below, ahead of the time when that bucket would be cascaded.
+** This spreads over many ticks work that would otherwise all be done in
+** the single tick when the wheel turns.
+**
+** Only called when [stime] is in the last bucket of the wheel below, so
+** every bucket there has already been passed in the current turn, and can
+** hold timers for the next.
+*/
+static int ci_ip_timer_precascade(ci_netif* netif, int wheelno,
+                                  ci_iptime_t stime, int budget)
+{
+  ci_ni_dllist_t* bucket;
+  ci_ni_dllist_link* link;
+  ci_ip_timer* ts;
+  int n = 0;
+
+  ci_assert(wheelno > 1 && wheelno < CI_IPTIME_WHEELS);
+  ci_assert_equal(IPTIMER_BUCKETNO(wheelno - 1, stime), CI_IPTIME_BUCKETMASK);
+
+  bucket = IPTIMER_BUCKET(netif, wheelno,
+                          stime + (1u << (CI_IPTIME_BUCKETBITS * wheelno)));
+  while( n < budget && (link = ci_ni_dllist_try_pop(netif, bucket)) ) {
+    ts = LINK2TIMER(link);
+    ci_assert_equal(IPTIMER_BUCKETNO(wheelno, ts->time),
+                    IPTIMER_BUCKETNO(wheelno, stime + 
+                                (1u << (CI_IPTIME_BUCKETBITS * wheelno))));
+    ci_ni_dllist_push_tail(netif,
+                           IPTIMER_BUCKET(netif, wheelno - 1, ts->time),
+                           &ts->link);
+    ++n;
+  }
+  return n;
 }
 
+static void ci_ip_timer_docallback_coalesced(ci_netif* netif,
+                                             ci_tcp_state* ts);
+
 /* unpick the ci_ip_timer structure to actually do the callback */ 
 static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
 {
@@ -309,12 +427,19 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
   case CI_IP_TIMER_TCP_CORK:
     ci_tcp_timeout_cork(netif, SP_TO_TCP(netif, ts->param1));
     break;
+  case CI_IP_TIMER_TCP_COALESCED:
+    CHECK_TS(netif, SP_TO_TCP(netif, ts->param1));
+    ci_ip_timer_docallback_coalesced(netif, SP_TO_TCP(netif, ts->param1));
+    break;
   case CI_IP_TIMER_NETIF_TIMEOUT:
     ci_netif_timeout_state(netif);
     break;
   case CI_IP_TIMER_PMTU_DISCOVER:
     ci_pmtu_timeout_pmtu(netif, SP_TO_TCP(netif, ts->param1));
     break;
+  case CI_IP_TIMER_TCP_PACING:
+    ci_tcp_pacing_poll(netif);
+    break;
 #if CI_CFG_TCP_SOCK_STATS
   case CI_IP_TIMER_TCP_STATS:
 	ci_tcp_stats_action(netif, SP_TO_TCP(netif, ts->param1), 
@@ -340,6 +465,41 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
   }  
 }
 
+/* Run those timers of [ts] that are due, and re-arm its coalesced timer
+** for the earliest that remains.
+*/
+static void ci_ip_timer_docallback_coalesced(ci_netif* netif,
+                                             ci_tcp_state* ts)
+{
+  ci_iptime_t now = IPTIMER_STATE(netif)->sched_ticks;
+  ci_ip_timer* next;
+  int fired = 0;
+
+  ci_assert(! ci_ip_timer_pending(netif, &ts->timers_tid));
+
+  /* Callbacks may set or clear any of the socket's timers, so look again
+   * after each. */
+  while( (next = ci_ip_timer_coalesced_next(ts)) != NULL &&
+         TIME_LE(next->time, now) ) {
+    next->flags &=~ CI_IP_TIMER_FLAG_PENDING;
+    ci_ip_timer_docallback(netif, next);
+    ++fired;
+  }
+
+  if( fired == 0 )
+    CITP_STATS_NETIF_INC(netif, timer_coalesced_idle);
+
+  /* Callbacks that set a timer will have armed [timers_tid] already, but
+   * possibly for a timer that has since been cleared. */
+  if( next == NULL )
+    ci_ip_timer_clear(netif, &ts->timers_tid);
+  else if( ! ci_ip_timer_pending(netif, &ts->timers_tid) )
+    __ci_ip_timer_set(netif, &ts->timers_tid, next->time);
+  else if( ts->timers_tid.time != next->time )
+    ci_ip_timer_modify(netif, &ts->timers_tid, next->time);
+}
+
+
 /* run any pending timers */
 void ci_ip_timer_poll(ci_netif *netif) {
   ci_ip_timer_state* ipts = IPTIMER_STATE(netif); 
@@ -348,6 +508,7 @@ void ci_ip_timer_poll(ci_netif *netif) {
   ci_iptime_t rtime;
   ci_ni_dllist_link* link;
   int changed = 0;
+  int n;
 
   /* The caller is expected to ensure that the current time is sufficiently
   ** up-to-date.
@@ -369,15 +530,32 @@ void ci_ip_timer_poll(ci_netif *netif) {
 
     /* cascade through wheels if reached end of current wheel */
     if(IPTIMER_BUCKETNO(0, *stime) == 0) {
+      n = 0;
       if(IPTIMER_BUCKETNO(1, *stime) == 0) {
 	if(IPTIMER_BUCKETNO(2, *stime) == 0) {
-	  ci_ip_timer_cascadewheel(netif, 3, *stime);
+	  n += ci_ip_timer_cascadewheel(netif, 3, *stime);
 	}
-	ci_ip_timer_cascadewheel(netif, 2, *stime);
+	n += ci_ip_timer_cascadewheel(netif, 2, *stime);
       }
       changed = ci_ip_timer_cascadewheel(netif, 1, *stime);
+      n += changed;
+      CITP_STATS_NETIF_ADD(netif, timer_cascade_moves, n);
+      CITP_STATS_NETIF(
+        if( (ci_uint32) n > netif->state->stats.timer_cascade_max )
+          netif->state->stats.timer_cascade_max = n;
+      );
     }
 
+    /* Approaching a turn of wheel 2 or 3: start moving its timers down. */
+    n = 0;
+    if( IPTIMER_BUCKETNO(1, *stime) == CI_IPTIME_BUCKETMASK )
+      n += ci_ip_timer_precascade(netif, 2, *stime,
+                                  CI_IP_TIMER_PRECASCADE_BUDGET);
+    if( IPTIMER_BUCKETNO(2, *stime) == CI_IPTIME_BUCKETMASK )
+      n += ci_ip_timer_precascade(netif, 3, *stime,
+                                  CI_IP_TIMER_PRECASCADE_BUDGET);
+    CITP_STATS_NETIF_ADD(netif, timer_precascade_moves, n);
+
 
     /* Bug 1828: We need to be creaful here ... because:
         - ci_ip_timer_docallback can set/clear timers
@@ -519,6 +697,15 @@ void ci_ip_timer_state_assert_valid(ci_netif* ni, const char* file, int line)
         a1 = TIME_GT(ts->time, stime);
         /* must be within time range of bucket */
         a2 = TIME_LT(ts->time, max_time) && TIME_GE(ts->time, min_time);
+        /* ...or, in buckets of wheels 1 and 2 that have already been
+         * passed, the same bucket in the next turn of the wheel */
+        if( ! a2 && w > 0 && w < CI_IPTIME_WHEELS - 1 &&
+            TIME_LE(min_time, stime) ) {
+          ci_iptime_t turn = 1u << (bit_shift + CI_IPTIME_BUCKETBITS);
+          a2 = TIME_LT(ts->time, max_time + turn) &&
+               TIME_GE(ts->time, min_time + turn);
+          a3 = 1;
+        }
 
         /* if any of the checks fail then print out timer details */
         if (!a1 || !a2 || !a3) {
@@ -550,8 +737,10 @@ static const char* ci_ip_timer_dump(const ci_ip_timer* ts)
     MAKECASE(CI_IP_TIMER_TCP_KALIVE,   "kalive")
     MAKECASE(CI_IP_TIMER_TCP_LISTEN,   "listen")
     MAKECASE(CI_IP_TIMER_TCP_CORK,     "cork")
+    MAKECASE(CI_IP_TIMER_TCP_COALESCED, "coalesced")
     MAKECASE(CI_IP_TIMER_NETIF_TIMEOUT, "netif")
     MAKECASE(CI_IP_TIMER_PMTU_DISCOVER, "pmtu")
+    MAKECASE(CI_IP_TIMER_TCP_PACING,    "pacing")
 #if CI_CFG_SUPPORT_STATS_COLLECTION
     MAKECASE(CI_IP_TIMER_TCP_STATS,     "tcp-stats")
     MAKECASE(CI_IP_TIMER_NETIF_STATS,   "ni-stats")
@@ -574,7 +763,7 @@ void ci_ip_timer_state_dump(ci_netif* ni)
   ci_ip_timer* ts;
   ci_ni_dllist_t* bucket;
   ci_ni_dllist_link* l;
-  ci_iptime_t stime, wheel_base, max_time, min_time;
+  ci_iptime_t stime, wheel_base, max_time, min_time, next_turn;
   int w, b, bit_shift;
 
   /* shifting a 32 bit integer left or right 32 bits has undefined results 
@@ -603,9 +792,13 @@ void ci_ip_timer_state_dump(ci_netif* ni)
       max_time = min_time   + (1 << bit_shift);
 
       bucket = &ipts->warray[w*CI_IPTIME_BUCKETS + b];
+      /* wheels 1 and 2 only: see ci_ip_timer_precascade() */
+      next_turn = 1u << ((bit_shift + CI_IPTIME_BUCKETBITS) % 32);
 
-      /* check buckets that should be empty are! */
-      if ( TIME_LE(min_time, stime) && !ci_ni_dllist_is_empty(ni, bucket) )
+      /* check buckets that should be empty are!  (Passed buckets in
+       * wheels 1 and 2 can hold timers for the next turn.) */
+      if ( TIME_LE(min_time, stime) && !ci_ni_dllist_is_empty(ni, bucket) &&
+           (w == 0 || w == CI_IPTIME_WHEELS - 1) )
         ci_log("w:%d, b:%d, [0x%x->0x%x] - bucket should be empty",  
                 w, b, min_time, max_time);
 
@@ -621,7 +814,11 @@ void ci_ip_timer_state_dump(ci_netif* ni)
                ts->time, ci_ip_timer_dump(ts), w, b, min_time, max_time);
         if ( TIME_LE(ts->time, stime) )
           ci_log("    ERROR: timer before current time");
-        if ( !(TIME_LT(ts->time, max_time) && TIME_GE(ts->time, min_time)) )
+        if ( !(TIME_LT(ts->time, max_time) && TIME_GE(ts->time, min_time)) &&
+             !(w > 0 && w < CI_IPTIME_WHEELS - 1 &&
+               TIME_LE(min_time, stime) &&
+               TIME_LT(ts->time, max_time + next_turn) &&
+               TIME_GE(ts->time, min_time + next_turn)) )
           ci_log("    ERROR: timer in wrong bucket");
       }
     }
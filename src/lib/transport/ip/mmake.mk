@@ -34,7 +34,9 @@ LIB_SRCS	:=		\
 		tcp_recv.c	\
 		ipid.c		\
 		netif_debug.c	\
+		netif_tcpdump.c	\
 		tcp_debug.c	\
+		tcp_cong.c	\
 		csum_copy_iovec_setlen.c \
 		cplane_ops.c	\
 		netif_init.c	\
@@ -693,6 +693,14 @@ static int __ci_netif_rx_post(ci_netif* ni, ef_vi* vi, int intf_i,
 #define low_thresh(ni)       ((ni)->state->rxq_limit / 2)
 
 
+/* The node whose packet sets should feed this interface's receive ring,
+ * or -1 if any will do. */
+ci_inline int ci_netif_rx_numa_node(ci_netif* ni, int intf_i)
+{
+  return NI_OPTS(ni).pkt_numa_local ? ni->state->nic[intf_i].numa_node : -1;
+}
+
+
 void ci_netif_rx_post(ci_netif* netif, int intf_i)
 {
   /* TODO: When under packet buffer pressure, post fewer on the receive
@@ -707,6 +715,7 @@ void ci_netif_rx_post(ci_netif* netif, int intf_i)
   ci_ip_pkt_fmt* pkt;
   int max_n_to_post, rx_allowed, n_to_post;
   int bufset_id = NI_PKT_SET(netif);
+  int numa_node = ci_netif_rx_numa_node(netif, intf_i);
   int ask_for_more_packets = 0;
 
   ci_assert(ci_netif_is_locked(netif));
@@ -720,8 +729,10 @@ void ci_netif_rx_post(ci_netif* netif, int intf_i)
 
   ci_assert_ge(max_n_to_post, CI_CFG_RX_DESC_BATCH);
   /* We could have enough packets in all sets together, but we need them
-   * in one set. */
-  if( netif->packets->set[bufset_id].n_free < CI_CFG_RX_DESC_BATCH )
+   * in one set.  It had better be on the NIC's node, too. */
+  if( netif->packets->set[bufset_id].n_free < CI_CFG_RX_DESC_BATCH ||
+      (numa_node >= 0 &&
+       netif->packets->set[bufset_id].numa_node != numa_node) )
     goto find_new_bufset;
 
  good_bufset:
@@ -732,7 +743,11 @@ void ci_netif_rx_post(ci_netif* netif, int intf_i)
     ci_assert_ge(max_n_to_post, 0);
 
     if( max_n_to_post < CI_CFG_RX_DESC_BATCH ) {
-      if( bufset_id != netif->packets->id ) {
+      /* Leave the current set alone if we only moved off it to find
+       * buffers local to the NIC. */
+      if( bufset_id != netif->packets->id &&
+          netif->packets->set[netif->packets->id].n_free <
+          CI_CFG_RX_DESC_BATCH ) {
         ci_netif_pkt_set_change(netif, bufset_id,
                                 ask_for_more_packets);
       }
@@ -741,7 +756,8 @@ void ci_netif_rx_post(ci_netif* netif, int intf_i)
     }
 
  find_new_bufset:
-    bufset_id = ci_netif_pktset_best(netif);
+    bufset_id = ci_netif_pktset_best_local(netif, numa_node,
+                                           CI_CFG_RX_DESC_BATCH);
     if( bufset_id == -1 ||
         netif->packets->set[bufset_id].n_free < CI_CFG_RX_DESC_BATCH )
       goto not_enough_pkts;
@@ -810,7 +826,7 @@ void ci_netif_rx_post(ci_netif* netif, int intf_i)
 
   /* Still not enough -- allocate more memory if possible. */
   if( netif->packets->sets_n < netif->packets->sets_max &&
-      ci_tcp_helper_more_bufs(netif) == 0 ) {
+      ci_tcp_helper_more_bufs(netif, numa_node) == 0 ) {
     bufset_id = netif->packets->sets_n - 1;
     ci_assert_equal(netif->packets->set[bufset_id].n_free,
                     1 << CI_CFG_PKTS_PER_SET_S);
@@ -822,7 +838,7 @@ void ci_netif_rx_post(ci_netif* netif, int intf_i)
     CITP_STATS_NETIF_INC(netif, reap_buf_limited);
     ci_netif_try_to_reap(netif, max_n_to_post);
     max_n_to_post = CI_MIN(max_n_to_post, netif->packets->n_free);
-    bufset_id = ci_netif_pktset_best(netif);
+    bufset_id = ci_netif_pktset_best(netif, -1);
     if( bufset_id != -1 &&
         netif->packets->set[bufset_id].n_free >= CI_CFG_RX_DESC_BATCH )
       goto good_bufset;
@@ -1147,6 +1163,7 @@ void ci_netif_unlock(ci_netif* ni)
   ci_assert_nflags(ni->state->flags, CI_NETIF_FLAG_PKT_ACCOUNT_PENDING);
 
   ci_assert_equal(ni->state->in_poll, 0);
+  ci_netif_lat_lock_dropped(ni);
   if(CI_LIKELY( ni->state->lock.lock == CI_EPLOCK_LOCKED &&
                 ci_cas64u_succeed(&ni->state->lock.lock,
                                   CI_EPLOCK_LOCKED, CI_EPLOCK_UNLOCKED) ))
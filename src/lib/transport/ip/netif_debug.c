@@ -294,6 +294,31 @@ void ci_netif_print_sockets(ci_netif* ni)
 }
 
 
+static void ci_netif_dump_pkt_numa(ci_netif* ni, oo_dump_log_fn_t logger,
+                                   void* log_arg)
+{
+  oo_pktbuf_set* set = ni->packets->set;
+  int i, j, n_sets, n_free;
+
+  for( i = 0; i < ni->packets->sets_n; i++ ) {
+    /* Report each node once, at its first set. */
+    for( j = 0; j < i; j++ )
+      if( set[j].numa_node == set[i].numa_node )
+        break;
+    if( j < i )
+      continue;
+    for( n_sets = 0, n_free = 0; j < ni->packets->sets_n; j++ )
+      if( set[j].numa_node == set[i].numa_node ) {
+        ++n_sets;
+        n_free += set[j].n_free;
+      }
+    logger(log_arg, "  pkt_numa[%d]: sets=%d alloc=%d used=%d free=%d",
+           set[i].numa_node, n_sets, n_sets * PKTS_PER_SET,
+           n_sets * PKTS_PER_SET - n_free, n_free);
+  }
+}
+
+
 static void ci_netif_dump_pkt_summary(ci_netif* ni, oo_dump_log_fn_t logger,
                                       void* log_arg)
 {
@@ -305,9 +330,11 @@ static void ci_netif_dump_pkt_summary(ci_netif* ni, oo_dump_log_fn_t logger,
          ni->packets->sets_n);
 
   for( i = 0; i < ni->packets->sets_n; i++ ) {
-    logger(log_arg, "  pkt_set[%d]: free=%d%s", i, ni->packets->set[i].n_free,
+    logger(log_arg, "  pkt_set[%d]: free=%d numa_node=%d%s", i,
+           ni->packets->set[i].n_free, ni->packets->set[i].numa_node,
            i == ni->packets->id ? " current" : "");
   }
+  ci_netif_dump_pkt_numa(ni, logger, log_arg);
 
   rx_ring = 0;
   tx_ring = 0;
@@ -587,9 +614,10 @@ void ci_netif_dump_extra_to_logger(ci_netif* ni, oo_dump_log_fn_t logger,
   logger(log_arg, "  deferred count %d/%d", ns->defer_work_count, NI_OPTS(ni).defer_work_limit);
   logger(log_arg, "  numa nodes: creation=%d load=%d",
          ns->creation_numa_node, ns->load_numa_node);
-  logger(log_arg, "  numa node masks: packet alloc=%x sock alloc=%x interrupt=%x",
+  logger(log_arg, "  numa node masks: packet alloc=%x sock alloc=%x interrupt=%x "
+         "pkt no grow=%x",
          ns->packet_alloc_numa_nodes, ns->sock_alloc_numa_nodes,
-         ns->interrupt_numa_nodes);
+         ns->interrupt_numa_nodes, ns->pkt_numa_no_grow);
 }
 
 void ci_netif_config_opts_dump(ci_netif_config_opts* opts,
@@ -719,9 +747,9 @@ static void ci_netif_dump_vi(ci_netif* ni, int intf_i, oo_dump_log_fn_t logger,
     return;
   }
 
-  logger(log_arg, "%s: stack=%d intf=%d dev=%s hw=%d%c%d", __FUNCTION__,
-         NI_ID(ni), intf_i, nic->pci_dev, (int) nic->vi_arch,
-         nic->vi_variant, (int) nic->vi_revision);
+  logger(log_arg, "%s: stack=%d intf=%d dev=%s hw=%d%c%d numa_node=%d",
+         __FUNCTION__, NI_ID(ni), intf_i, nic->pci_dev, (int) nic->vi_arch,
+         nic->vi_variant, (int) nic->vi_revision, nic->numa_node);
   logger(log_arg, "  vi=%d pd_owner=%d channel=%d tcpdump=%s vi_flags=%x oo_vi_flags=%x",
          ef_vi_instance(vi), nic->pd_owner, (int) nic->vi_channel,
          ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_ALL ? "all" :
@@ -968,6 +996,14 @@ void ci_netif_dump_to_logger(ci_netif* ni, oo_dump_log_fn_t logger,
       logger(log_arg, "  tcpdump: %d/%d packets in queue (wr=%u rd=%u)",
              (int)(ci_uint16) (dwi - dri), CI_CFG_DUMPQUEUE_LEN, dwi, dri);
   }
+  if( oo_tcpdump_ring_active(ni) )
+    logger(log_arg, "  tcpdump: ring %llu/%u bytes used snaplen=%u filter=%u",
+           (unsigned long long) (ni->dump_ring->write_off -
+                                 ni->dump_ring->read_off),
+           ni->dump_ring_size, ni->dump_ring->snaplen,
+           ni->state->dump_filter_len);
+  else if( ni->state->dump_filter_len != 0 )
+    logger(log_arg, "  tcpdump: filter=%u", ni->state->dump_filter_len);
 
 #if CI_CFG_FD_CACHING
   logger(log_arg, "  active cache: hit=%d avail=%d cache=%s pending=%s",
@@ -1009,6 +1045,34 @@ void ci_netif_dump_vi_stats_to_logger(ci_netif* ni, oo_dump_log_fn_t logger,
 #endif
 
 
+#ifndef __KERNEL__
+/* Returns an upper bound on the value at or below which [permille]/1000 of
+ * the samples in [h] lie, in cycles.
+ */
+ci_uint64 ci_lat_hist_percentile(const ci_lat_hist* h, unsigned permille)
+{
+  ci_uint64 target, seen = 0;
+  unsigned i;
+
+  if( h->n == 0 )
+    return 0;
+  target = CI_MAX((h->n * permille + 999) / 1000, 1);
+  for( i = 0; i < CI_LAT_HIST_N_BUCKETS - 1; ++i ) {
+    seen += h->bucket[i];
+    if( seen >= target )
+      return CI_MIN(ci_lat_hist_bucket_lo(i + 1) - 1, h->max);
+  }
+  return h->max;
+}
+
+
+ci_uint64 ci_netif_lat_cycles_to_ns(ci_netif* ni, ci_uint64 cycles)
+{
+  return cycles * 1000000 / IPTIMER_STATE(ni)->khz;
+}
+#endif
+
+
 int ci_netif_bad_hwport(ci_netif* ni, ci_hwport_id_t hwport)
 {
   /* Called by ci_hwport_to_intf_i() when it detects a bad [hwport]. */
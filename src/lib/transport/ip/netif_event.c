@@ -331,6 +331,82 @@ static void get_rx_timestamp(ci_netif* netif, ci_ip_pkt_fmt* pkt)
 }
 
 
+/* Receive coalescing (EF_TCP_RX_GRO).  Consecutive in-order segments of a
+ * single TCP connection are chained together via frag_next and handed to
+ * ci_tcp_handle_rx_gro() as one unit when the train ends: that is when a
+ * segment arrives that cannot be appended, or at the end of each batch of
+ * events.  Only plain ACK segments carrying payload and without IP options
+ * are coalesced, and their TCP headers must match apart from the sequence
+ * number, so that the TCP fast path only needs to look at the first.
+ */
+static void handle_rx_gro_flush(ci_netif* ni, struct ci_netif_poll_state* ps)
+{
+  ci_ip_pkt_fmt* pkt = ps->rx_gro_head;
+  ci_ip4_hdr* ip = oo_ip_hdr(pkt);
+  ci_tcp_hdr* tcp = (ci_tcp_hdr*) (ip + 1);
+  int ip_paylen = CI_BSWAP_BE16(ip->ip_tot_len_be16) - sizeof(*ip);
+
+  ps->rx_gro_head = NULL;
+  if( ps->rx_gro_n == 1 ) {
+    ci_tcp_handle_rx(ni, ps, pkt, tcp, ip_paylen);
+  }
+  else {
+    CITP_STATS_NETIF_INC(ni, rx_gro_trains);
+    CITP_STATS_NETIF_ADD(ni, rx_gro_merged_segs, ps->rx_gro_n - 1);
+    ci_tcp_handle_rx_gro(ni, ps, pkt, tcp, ip_paylen, ps->rx_gro_end_seq);
+  }
+}
+
+
+/* Returns true if [pkt] has been taken into the current train. */
+static int handle_rx_gro(ci_netif* ni, struct ci_netif_poll_state* ps,
+                         ci_ip_pkt_fmt* pkt, ci_ip4_hdr* ip,
+                         ci_tcp_hdr* tcp, int ip_paylen)
+{
+  ci_ip_pkt_fmt* head = ps->rx_gro_head;
+  int paylen = ip_paylen - CI_TCP_HDR_LEN(tcp);
+  int candidate = CI_IP4_IHL(ip) == sizeof(*ip) &&
+                  OO_PP_IS_NULL(pkt->frag_next) &&
+                  (tcp->tcp_flags & ~CI_TCP_FLAG_PSH) == CI_TCP_FLAG_ACK &&
+                  paylen > 0;
+
+  if( head != NULL ) {
+    ci_ip4_hdr* head_ip = oo_ip_hdr(head);
+    ci_tcp_hdr* head_tcp = (ci_tcp_hdr*) (head_ip + 1);
+
+    if( candidate &&
+        ps->rx_gro_n < NI_OPTS(ni).tcp_rx_gro &&
+        CI_BSWAP_BE32(tcp->tcp_seq_be32) == ps->rx_gro_end_seq &&
+        ip->ip_saddr_be32 == head_ip->ip_saddr_be32 &&
+        ip->ip_daddr_be32 == head_ip->ip_daddr_be32 &&
+        tcp->tcp_source_be16 == head_tcp->tcp_source_be16 &&
+        tcp->tcp_dest_be16 == head_tcp->tcp_dest_be16 &&
+        tcp->tcp_ack_be32 == head_tcp->tcp_ack_be32 &&
+        tcp->tcp_window_be16 == head_tcp->tcp_window_be16 &&
+        tcp->tcp_hdr_len_sl4 == head_tcp->tcp_hdr_len_sl4 &&
+        pkt->vlan == head->vlan &&
+        memcmp(CI_TCP_HDR_OPTS(tcp), CI_TCP_HDR_OPTS(head_tcp),
+               CI_TCP_HDR_OPT_LEN(tcp)) == 0 ) {
+      ps->rx_gro_tail->frag_next = OO_PKT_P(pkt);
+      ps->rx_gro_tail = pkt;
+      ps->rx_gro_end_seq += paylen;
+      ++ps->rx_gro_n;
+      if( tcp->tcp_flags & CI_TCP_FLAG_PSH )
+        handle_rx_gro_flush(ni, ps);
+      return 1;
+    }
+    handle_rx_gro_flush(ni, ps);
+  }
+
+  if( ! candidate || (tcp->tcp_flags & CI_TCP_FLAG_PSH) )
+    return 0;
+  ps->rx_gro_head = ps->rx_gro_tail = pkt;
+  ps->rx_gro_end_seq = CI_BSWAP_BE32(tcp->tcp_seq_be32) + paylen;
+  ps->rx_gro_n = 1;
+  return 1;
+}
+
+
 static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
                           ci_ip_pkt_fmt* pkt)
 {
@@ -407,7 +483,10 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
 
       /* Demux to appropriate protocol. */
       if( ip->ip_protocol == IPPROTO_TCP ) {
-        ci_tcp_handle_rx(netif, ps, pkt, (ci_tcp_hdr*) payload, ip_paylen);
+        if( ! NI_OPTS(netif).tcp_rx_gro ||
+            ! handle_rx_gro(netif, ps, pkt, ip, (ci_tcp_hdr*) payload,
+                            ip_paylen) )
+          ci_tcp_handle_rx(netif, ps, pkt, (ci_tcp_hdr*) payload, ip_paylen);
         CI_IPV4_STATS_INC_IN_DELIVERS( netif );
         return;
       }
@@ -423,6 +502,10 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
                      (int) ip->ip_protocol));
     }
     else {
+      /* Keep any train of coalesced segments ahead of this one. */
+      if( ps->rx_gro_head != NULL )
+        handle_rx_gro_flush(netif, ps);
+
       /*! \todo IP slow path.  Don't want to deal with this yet.
        * 
        * It is probably bad idea to print all IP fragments, but we should
@@ -1226,6 +1309,44 @@ static void ci_netif_tx_pkt_complete_udp(ci_netif* netif,
 #endif
 
 
+/* Record the time from [pkt] being handed to the NIC to its TX completion
+ * being handled.  Completion of a batch of sends is handled after the last
+ * of them goes out, so this is an upper bound on each packet's
+ * send-to-wire time.
+ */
+static void ci_netif_lat_tx_complete(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  ci_sock_lat_hists* sh;
+  oo_sp sock_id;
+  ci_uint64 now;
+
+  ci_frc64(&now);
+  if( pkt->tstamp_frc == 0 || now < pkt->tstamp_frc )
+    return;
+  ci_lat_hist_add(&ni->lat_hists->tx_wire, now - pkt->tstamp_frc);
+
+#if CI_CFG_UDP
+  if( pkt->flags & CI_PKT_FLAG_UDP )
+    sock_id = pkt->pf.udp.tx_sock_id;
+  else
+#endif
+  {
+    /* Only TCP data segments are sure to have had [sock_id] set on their
+     * way out.  ACKs, RSTs and non-TCP packets may carry a stale one.
+     */
+    int af = oo_pkt_af(pkt);
+    ci_tcp_hdr* tcp = TX_PKT_IPX_TCP(af, pkt);
+    if( TX_PKT_PROTOCOL(af, pkt) != IPPROTO_TCP ||
+        ipx_hdr_tot_len(af, TX_PKT_IPX_HDR(af, pkt)) ==
+          CI_IPX_HDR_SIZE(af) + CI_TCP_HDR_LEN(tcp) )
+      return;
+    sock_id = pkt->pf.tcp_tx.sock_id;
+  }
+  if( (sh = ci_netif_sock_lat_hists(ni, sock_id)) != NULL )
+    ci_lat_hist_add(&sh->tx_wire, now - pkt->tstamp_frc);
+}
+
+
 ci_inline void __ci_netif_tx_pkt_complete(ci_netif* ni,
                                           struct ci_netif_poll_state* ps,
                                           ci_ip_pkt_fmt* pkt, ef_event* ev)
@@ -1292,6 +1413,9 @@ ci_inline void __ci_netif_tx_pkt_complete(ci_netif* ni,
   }
 #endif
 
+  if(CI_UNLIKELY( ni->lat_hists != NULL && ev != NULL ))
+    ci_netif_lat_tx_complete(ni, pkt);
+
   pkt->flags &=~ CI_PKT_FLAG_TX_PENDING;
 #if CI_CFG_UDP
   if( pkt->flags & CI_PKT_FLAG_UDP )
@@ -1422,6 +1546,60 @@ ci_inline void __handle_rx_pkt(ci_netif* ni, struct ci_netif_poll_state* ps,
 }
 
 
+ci_inline ci_ip_pkt_fmt* ci_netif_rx_ev_pkt(ci_netif* ni, const ef_event* ev)
+{
+  oo_pkt_p pp;
+  OO_PP_INIT(ni, pp, EF_EVENT_RX_RQ_ID(*ev));
+  return PKT(ni, pp);
+}
+
+
+/* First pass over a batch of events.  Start fetching the metadata and
+ * headers of each received packet, and then the filter-table entry that
+ * its lookup will need, so that these misses overlap instead of each being
+ * taken in turn as the events are handled.
+ */
+void ci_netif_poll_evq_prefetch(ci_netif* ni, const ef_event* ev, int n_evs)
+{
+  ci_ip_pkt_fmt* pkt;
+  struct oo_eth_hdr* eth;
+  ci_uint16* p_ether_type;
+  ci_ip4_hdr* ip;
+  ci_uint16* ports;
+  int i;
+
+  for( i = 0; i < n_evs; ++i )
+    if( EF_EVENT_TYPE(ev[i]) == EF_EVENT_TYPE_RX ) {
+      pkt = ci_netif_rx_ev_pkt(ni, &ev[i]);
+      ci_prefetch(pkt);
+      ci_prefetch(&pkt->pkt_start_off);
+      ci_prefetch(pkt->dma_start);
+      ci_prefetch(pkt->dma_start + CI_CACHE_LINE_SIZE);
+    }
+
+  for( i = 0; i < n_evs; ++i ) {
+    if( EF_EVENT_TYPE(ev[i]) != EF_EVENT_TYPE_RX ||
+        (ev[i].rx.flags & (EF_EVENT_FLAG_SOP | EF_EVENT_FLAG_CONT))
+                                                     != EF_EVENT_FLAG_SOP )
+      continue;
+    pkt = ci_netif_rx_ev_pkt(ni, &ev[i]);
+    eth = oo_ether_hdr(pkt);
+    p_ether_type = &eth->ether_type;
+    if( *p_ether_type == CI_ETHERTYPE_8021Q )
+      p_ether_type += ETH_VLAN_HLEN / sizeof(*p_ether_type);
+    if( *p_ether_type != CI_ETHERTYPE_IP )
+      continue;
+    ip = (ci_ip4_hdr*) (p_ether_type + 1);
+    if( CI_IP4_IHL(ip) != sizeof(*ip) ||
+        (ip->ip_protocol != IPPROTO_TCP && ip->ip_protocol != IPPROTO_UDP) )
+      continue;
+    ports = (ci_uint16*) (ip + 1);
+    ci_netif_filter_prefetch(ni, ip->ip_daddr_be32, ports[1],
+                             ip->ip_saddr_be32, ports[0], ip->ip_protocol);
+  }
+}
+
+
 static int ci_netif_poll_evq(ci_netif* ni, struct ci_netif_poll_state* ps,
                              int intf_i, int n_evs)
 {
@@ -1470,6 +1648,16 @@ static int ci_netif_poll_evq(ci_netif* ni, struct ci_netif_poll_state* ps,
 have_events:
     s.rx_pkt = NULL;
     for( i = 0; i < n_evs; ++i ) {
+      /* When we have a batch, prefetch ahead of handling it
+       * (EF_POLL_PREFETCH).  A lone event is handled directly to keep
+       * latency down.
+       */
+      if( NI_OPTS(ni).poll_prefetch &&
+          (i % CI_NETIF_POLL_PREFETCH_BATCH) == 0 && n_evs > 1 )
+        ci_netif_poll_evq_prefetch(ni, &ev[i],
+                                   CI_MIN(n_evs - i,
+                                          CI_NETIF_POLL_PREFETCH_BATCH));
+
       /* Look for RX events first to minimise latency. */
       if( EF_EVENT_TYPE(ev[i]) == EF_EVENT_TYPE_RX ) {
         CITP_STATS_NETIF_INC(ni, rx_evs);
@@ -1579,6 +1767,8 @@ have_events:
 
       else if( EF_EVENT_TYPE(ev[i]) == EF_EVENT_TYPE_OFLOW ) {
         LOG_E(CI_RLLOG(1, LPF "***** EVENT QUEUE OVERFLOW *****"));
+        if( ps->rx_gro_head != NULL )
+          handle_rx_gro_flush(ni, ps);
         return 0;
       }
 
@@ -1603,6 +1793,8 @@ have_events:
 #endif
 
     __handle_rx_pkt(ni, ps, intf_i, &s.rx_pkt);
+    if( ps->rx_gro_head != NULL )
+      handle_rx_gro_flush(ni, ps);
 
     total_evs += n_evs;
   } while( total_evs < NI_OPTS(ni).evs_per_poll );
@@ -1657,6 +1849,7 @@ static int ci_netif_poll_intf(ci_netif* ni, int intf_i, int max_evs)
   ci_assert(ci_netif_is_locked(ni));
   ps.tx_pkt_free_list_insert = &ps.tx_pkt_free_list;
   ps.tx_pkt_free_list_n = 0;
+  ps.rx_gro_head = NULL;
 
   do {
     rc = ci_netif_poll_evq(ni, &ps, intf_i, 0);
@@ -1723,6 +1916,7 @@ int ci_netif_poll_intf_future(ci_netif* ni, int intf_i, ci_uint64 start_frc)
 
   ps.tx_pkt_free_list_insert = &ps.tx_pkt_free_list;
   ps.tx_pkt_free_list_n = 0;
+  ps.rx_gro_head = NULL;
 
   /* We expect the completion event within a microsecond or so. The timeout
    * of 100us is to avoid wedging the stack in the case of hardware
@@ -1913,8 +2107,15 @@ int ci_netif_poll_n(ci_netif* netif, int max_evs)
 
   /* Timer code can't use in-poll wakeup, since endpoints are out of
    * post-poll list.  So, poll timers after --in_poll. */
+  if( netif->state->pacing_n )
+    ci_tcp_pacing_poll(netif);
   ci_ip_timer_poll(netif);
 
+  if( netif->state->cp_journal_cycles != 0 &&
+      IPTIMER_STATE(netif)->frc - netif->state->cp_journal_frc >=
+      netif->state->cp_journal_cycles )
+    cicp_ipcache_journal_refresh(netif);
+
   /* Timers MUST NOT send via loopback. */
   ci_assert(OO_PP_IS_NULL(netif->state->looppkts));
 
@@ -88,6 +88,8 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   /* Pool of packet buffers for transmit. */
   assert_zero(nis->n_async_pkts);
   nis->nonb_pkt_pool = CI_ILL_END;
+  for( i = 0; i < CI_CFG_UDP_TX_STAGE_N; ++i )
+    nis->udp_tx_stage[i].head = CI_ILL_END;
 
   /* Deferred packets */
   ci_ni_dllist_init(ni, &nis->deferred_list,
@@ -101,6 +103,9 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
     ci_ni_dllist_put(ni, &nis->deferred_list_free, &ni->deferred_pkts[i].link);
   }
 
+  if( ni->lat_hists != NULL )
+    ci_netif_lat_hists_reset(ni);
+
   ci_netif_filter_init(ni, ci_log2_le(ci_netif_filter_table_size(ni)));
 #if CI_CFG_IPV6
   ci_ip6_netif_filter_init(ni->ip6_filter_table,
@@ -120,6 +125,17 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   nis->timeout_tid.param1 = OO_SP_NULL;
   nis->timeout_tid.fn = CI_IP_TIMER_NETIF_TIMEOUT;
 
+  for( i = 0; i < CI_TCP_PACING_SLOTS; ++i )
+    ci_ni_dllist_init(ni, &nis->pacing_slots[i],
+                      oo_ptr_to_statep(ni, &nis->pacing_slots[i]), "pace");
+  nis->pacing_cursor = 0;
+  nis->pacing_n = 0;
+  ci_ip_timer_init(ni, &nis->pacing_tid,
+                   oo_ptr_to_statep(ni, &nis->pacing_tid),
+                   "pace");
+  nis->pacing_tid.param1 = OO_SP_NULL;
+  nis->pacing_tid.fn = CI_IP_TIMER_TCP_PACING;
+
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   ci_ip_timer_init(ni, &nis->stats_tid,
                    oo_ptr_to_statep(ni, &nis->stats_tid),
@@ -166,6 +182,10 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   nis->kernel_packets_cycles =
             __oo_usec_to_cycles64(cpu_khz,
                                   NI_OPTS(ni).kernel_packets_timer_usec);
+  nis->cp_journal_cycles =
+            __oo_usec_to_cycles64(cpu_khz, NI_OPTS(ni).ipcache_refresh_usec);
+  nis->cp_journal_frc = 0;
+  nis->cp_journal_pos = 0;
 
   ci_ip_timer_state_init(ni, cpu_khz);
   nis->last_spin_poll_frc = IPTIMER_STATE(ni)->frc;
@@ -180,6 +200,15 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   nis->dump_read_i = 0;
   nis->dump_write_i = 0;
   memset(nis->dump_intf, 0, sizeof(nis->dump_intf));
+  nis->dump_filter_len = 0;
+  nis->dump_filter_flags = 0;
+  if( ni->dump_ring != NULL ) {
+    ni->dump_ring->size = ni->dump_ring_size;
+    ni->dump_ring->snaplen = 0;
+    ni->dump_ring->active = 0;
+    ni->dump_ring->write_off = 0;
+    ni->dump_ring->read_off = 0;
+  }
 #endif
 
   nis->uuid = ci_current_from_kuid_munged(ni->kuid);
@@ -225,6 +254,8 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
 
   nis->active_wild_n = 0;
   nis->packet_alloc_numa_nodes = 0;
+  nis->pkt_numa_no_grow = 0;
+  memset(nis->pkt_numa_short, 0, sizeof(nis->pkt_numa_short));
   nis->sock_alloc_numa_nodes = 0;
   nis->interrupt_numa_nodes = 0;
   nis->creation_numa_node = numa_node_id();
@@ -792,6 +823,9 @@ parse_enum(ci_netif_config_opts* opts,
            const char* name, const char* const* options,
            const char* default_val);
 
+/* Indexed by EF_TCP_CONG_ALGO_*. */
+static const char* const tcp_cong_alg_opts[] = { "reno", "cubic", "bbr", 0 };
+
 
 void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 {
@@ -825,6 +859,9 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
       opts->int_driven = 0;
   }
 
+  if( (s = getenv("EF_SPIN_ADAPTIVE")) )
+    opts->spin_adaptive = atoi(s);
+
   if( (s = getenv("EF_INT_DRIVEN")) )
     opts->int_driven = atoi(s);
   if( (s = getenv("EF_POLL_IN_KERNEL")) )
@@ -895,6 +932,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 #endif
   if( (s = getenv("EF_EVS_PER_POLL")) )
     opts->evs_per_poll = atoi(s);
+  if( (s = getenv("EF_POLL_PREFETCH")) )
+    opts->poll_prefetch = atoi(s);
+  if( (s = getenv("EF_TCP_RX_GRO")) )
+    opts->tcp_rx_gro = atoi(s);
   if( (s = getenv("EF_TCP_TCONST_MSL")) )
     opts->msl_seconds = atoi(s);
   if( (s = getenv("EF_TCP_FIN_TIMEOUT")) )
@@ -944,6 +985,14 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->defer_arp_pkts = atoi(s);
   if ( (s = getenv("EF_DEFER_ARP_TIMEOUT")) )
     opts->defer_arp_timeout = atoi(s);
+  if ( (s = getenv("EF_LATENCY_HIST")) )
+    opts->lat_hist = atoi(s);
+  if ( (s = getenv("EF_LATENCY_HIST_SOCKETS")) )
+    opts->lat_hist_socks = atoi(s);
+#if CI_CFG_TCPDUMP
+  if ( (s = getenv("EF_TCPDUMP_RING_SIZE")) )
+    opts->tcpdump_ring_size = atoi(s);
+#endif
   if ( (s = getenv("EF_SHARE_WITH")) )
     opts->share_with = atoi(s);
 #if CI_CFG_PKTS_AS_HUGE_PAGES
@@ -960,6 +1009,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 #endif
   if ( (s = getenv("EF_COMPOUND_PAGES_MODE")) )
     opts->compound_pages = atoi(s);
+  if ( (s = getenv("EF_PKT_NUMA_LOCAL")) )
+    opts->pkt_numa_local = atoi(s);
   if ( (s = getenv("EF_RXQ_SIZE")) )
     opts->rxq_size = atoi(s);
   if ( (s = getenv("EF_RXQ_LIMIT")) )
@@ -1000,6 +1051,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
    */
   opts->dynack_thresh = CI_MAX(opts->dynack_thresh, opts->delack_thresh);
 #endif
+  if( (s = getenv("EF_TCP_TIMER_COALESCE")) )
+    opts->tcp_timer_coalesce = atoi(s);
 
   if ( (s = getenv("EF_CHALLENGE_ACK_LIMIT")) )
     opts->challenge_ack_limit = atoi(s);
@@ -1191,6 +1244,9 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->loss_min_cwnd = atoi(s);
   if ( (s = getenv("EF_TCP_MIN_CWND")) )
     opts->min_cwnd = atoi(s);
+
+  opts->tcp_cong_alg = parse_enum(opts, "EF_TCP_CONG_ALGO", tcp_cong_alg_opts,
+                                  "reno");
 #if CI_CFG_TCP_FASTSTART
   if ( (s = getenv("EF_TCP_FASTSTART_INIT")) )
     opts->tcp_faststart_init = atoi(s);
@@ -1222,6 +1278,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   if ( (s = getenv("EF_BURST_CONTROL_LIMIT")))
     opts->burst_control_limit = atoi(s);
 #endif
+  if( (s = getenv("EF_TCP_ACCEPT_RING")) )
+    opts->tcp_accept_ring = atoi(s);
+  if( (s = getenv("EF_TCP_PACING")) )
+    opts->tcp_pacing = atoi(s);
 #if CI_CFG_RATE_PACING
   if ( (s = getenv("EF_TX_MIN_IPG_CNTL")) )
     opts->tx_min_ipg_cntl = atoi(s);
@@ -1233,6 +1293,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 #if CI_CFG_TAIL_DROP_PROBE
   if ( (s = getenv("EF_TAIL_DROP_PROBE")))
     opts->tail_drop_probe = atoi(s);
+  if ( (s = getenv("EF_TCP_RACK")))
+    opts->tcp_rack = atoi(s);
 #endif
 #if CI_CFG_CONG_AVOID_SCALE_BACK
   if ( (s = getenv("EF_CONG_AVOID_SCALE_BACK")))
@@ -1341,6 +1403,9 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   if( (s = getenv("EF_KERNEL_PACKETS_TIMER_USEC")) )
     opts->kernel_packets_timer_usec = atoi(s);
 
+  if( (s = getenv("EF_IPCACHE_REFRESH_USEC")) )
+    opts->ipcache_refresh_usec = atoi(s);
+
   static const char* const tcp_isn_opts[] = { "clocked", "clocked+cache", 0 };
   opts->tcp_isn_mode =
     parse_enum(opts, "EF_TCP_ISN_MODE", tcp_isn_opts, "clocked+cache");
@@ -1734,6 +1799,14 @@ static void netif_tcp_helper_build2(ci_netif* ni)
   ni->deferred_pkts =
     (struct oo_deferred_pkt*) ((char*) ni->state +
                                ni->state->deferred_pkts_ofs);
+  ni->lat_hists = ! NI_OPTS(ni).lat_hist ? NULL :
+    (ci_netif_lat_hists*) ((char*) ni->state + ni->state->lat_hists_ofs);
+#if CI_CFG_TCPDUMP
+  ni->dump_ring = ! NI_OPTS(ni).tcpdump_ring_size ? NULL :
+    (oo_dump_ring*) ((char*) ni->state + ni->state->dump_ring_ofs);
+  ni->dump_ring_size =
+    oo_tcpdump_ring_data_size(NI_OPTS(ni).tcpdump_ring_size);
+#endif
   ni->filter_table =
     (ci_netif_filter_table*) ((char*) ni->state + ni->state->table_ofs);
   ni->filter_table_ext =
@@ -2706,7 +2779,9 @@ static int ci_netif_init(ci_netif* ni, ef_driver_handle fd)
   CI_MAGIC_SET(ni, NETIF_MAGIC);
   ni->flags = 0;
   ni->error_flags = 0;
+  ni->tx_batch = 0;
   ni->cplane_init_net = NULL;
+  ci_netif_cpu_numa_map_init();
 
   ni->cplane = malloc(sizeof(struct oo_cplane_handle));
   if( ni->cplane == NULL )
@@ -2889,7 +2964,7 @@ int ci_netif_init_fill_rx_rings(ci_netif* ni)
   oo_pkt_p pkt_list;
   int lim, rc, n_reserved, n_requested, n_accounted;
 
-  rc = ci_tcp_helper_more_bufs(ni);
+  rc = ci_tcp_helper_more_bufs(ni, -1);
   if( ni->packets->n_free == 0 ) {
     LOG_E(ci_log("%s: [%d] ERROR: failed to allocate initial packet set: %d",
                  __func__, NI_ID(ni), rc));
@@ -10,11 +10,15 @@
 \**************************************************************************/
 
 /*! \cidoxg_lib_transport_ip */
+#define _GNU_SOURCE  /* for sched_getcpu */
 #include "ip_internal.h"
 
 #if !defined(__KERNEL__)
 #include <onload/mmap.h>
 #include <sys/shm.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
 
 pthread_mutex_t citp_pkt_map_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -83,14 +87,59 @@ ci_ip_pkt_fmt* __ci_netif_pkt(ci_netif* ni, unsigned id)
   return pkt;
 }
 
+
+/* NUMA node of each CPU, read from sysfs once per process.  With it the
+ * node of the calling thread needs only sched_getcpu(), which the vDSO
+ * answers without entering the kernel.
+ */
+static ci_int16* cpu_numa_node;
+static int cpu_numa_node_n;
+static pthread_once_t cpu_numa_node_once = PTHREAD_ONCE_INIT;
+
+static void ci_netif_cpu_numa_map_build(void)
+{
+  long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+  struct dirent* de;
+  char path[64];
+  DIR* dir;
+  int cpu;
+
+  if( n_cpus <= 0 ||
+      (cpu_numa_node = malloc(n_cpus * sizeof(*cpu_numa_node))) == NULL )
+    return;
+  for( cpu = 0; cpu < n_cpus; ++cpu ) {
+    /* A kernel without NUMA has no nodeN link: everything is node 0. */
+    cpu_numa_node[cpu] = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    if( (dir = opendir(path)) == NULL )
+      continue;
+    while( (de = readdir(dir)) != NULL )
+      if( strncmp(de->d_name, "node", 4) == 0 &&
+          de->d_name[4] >= '0' && de->d_name[4] <= '9' ) {
+        cpu_numa_node[cpu] = atoi(de->d_name + 4);
+        break;
+      }
+    closedir(dir);
+  }
+  cpu_numa_node_n = n_cpus;
+}
+
+
+void ci_netif_cpu_numa_map_init(void)
+{
+  pthread_once(&cpu_numa_node_once, ci_netif_cpu_numa_map_build);
+}
+
 #endif
 
 
-int ci_netif_pktset_best(ci_netif* ni)
+int ci_netif_pktset_best(ci_netif* ni, int numa_node)
 {
   int i, ret = -1, n_free = 0;
   
   for( i = 0; i < ni->packets->sets_n; i ++ ) {
+    if( numa_node >= 0 && ni->packets->set[i].numa_node != numa_node )
+      continue;
     if( ni->packets->set[i].n_free > n_free ) {
       n_free = ni->packets->set[i].n_free;
       ret = i;
@@ -106,6 +155,77 @@ int ci_netif_pktset_best(ci_netif* ni)
 }
 
 
+int ci_netif_pktset_best_local(ci_netif* ni, int numa_node, int min_free)
+{
+  int bufset_id;
+
+  if( numa_node < 0 )
+    return ci_netif_pktset_best(ni, -1);
+
+  bufset_id = ci_netif_pktset_best(ni, numa_node);
+  if( bufset_id >= 0 && ni->packets->set[bufset_id].n_free >= min_free ) {
+    if( numa_node < 32 )
+      ni->state->pkt_numa_short[numa_node] = 0;
+    return bufset_id;
+  }
+
+  /* A whole new set is a lot to add for a shortage that the sets on other
+   * nodes can ride out, so use those while they have buffers to spare.
+   * Only a shortage that is still there CI_CFG_PKT_NUMA_GROW_SHORT times
+   * in a row is worth growing for.
+   */
+  bufset_id = ci_netif_pktset_best(ni, -1);
+  if( bufset_id >= 0 && ni->packets->set[bufset_id].n_free >= min_free &&
+      numa_node < 32 &&
+      ++ni->state->pkt_numa_short[numa_node] < CI_CFG_PKT_NUMA_GROW_SHORT ) {
+    CITP_STATS_NETIF_INC(ni, pkt_set_numa_remote);
+    return bufset_id;
+  }
+  if( numa_node < 32 )
+    ni->state->pkt_numa_short[numa_node] = 0;
+
+  /* Rather grow the pool on this node than DMA across the interconnect.
+   * The kernel may have to place the set elsewhere, for instance when it
+   * comes from a huge page or the node is short of memory.  The set is
+   * then just one more for the stack to use, and we stop growing for this
+   * node: trying again would most likely land elsewhere too, and would
+   * grow the stack all the way to EF_MAX_PACKETS.
+   */
+  if( ni->packets->sets_n < ni->packets->sets_max &&
+      (numa_node >= 32 ||
+       ! (ni->state->pkt_numa_no_grow & (1u << numa_node))) &&
+      ci_tcp_helper_more_bufs(ni, numa_node) == 0 ) {
+    CHECK_FREEPKTS(ni);
+    bufset_id = ni->packets->sets_n - 1;
+    if( ni->packets->set[bufset_id].numa_node == numa_node )
+      return bufset_id;
+    if( numa_node < 32 )
+      ni->state->pkt_numa_no_grow |= 1u << numa_node;
+  }
+
+  bufset_id = ci_netif_pktset_best(ni, -1);
+  if( bufset_id >= 0 && ni->packets->set[bufset_id].numa_node != numa_node )
+    CITP_STATS_NETIF_INC(ni, pkt_set_numa_remote);
+  return bufset_id;
+}
+
+
+/* The node whose packet sets the calling thread should transmit from, or
+ * -1 if it should not care. */
+static int ci_netif_pkt_tx_numa_node(ci_netif* ni)
+{
+#ifdef __KERNEL__
+  return NI_OPTS(ni).pkt_numa_local ? numa_node_id() : -1;
+#else
+  int cpu;
+  if( ! NI_OPTS(ni).pkt_numa_local ||
+      (cpu = sched_getcpu()) < 0 || cpu >= cpu_numa_node_n )
+    return -1;
+  return cpu_numa_node[cpu];
+#endif
+}
+
+
 ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif* ni, int flags)
 {
   /* This is the slow path of ci_netif_pkt_alloc() and
@@ -135,7 +255,8 @@ ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif* ni, int flags)
   ci_assert_equal(ni->packets->set[NI_PKT_SET(ni)].n_free, 0);
   ci_assert(OO_PP_IS_NULL(ni->packets->set[NI_PKT_SET(ni)].free));
  again:
-  bufset_id = ci_netif_pktset_best(ni);
+  bufset_id = ci_netif_pktset_best_local(ni, ci_netif_pkt_tx_numa_node(ni),
+                                         1);
   if( bufset_id != -1 ) {
     ci_netif_pkt_set_change(ni, bufset_id,
                             ci_netif_pkt_set_is_underfilled(ni, bufset_id));
@@ -144,7 +265,7 @@ ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif* ni, int flags)
 
   while( ni->packets->sets_n < ni->packets->sets_max ) {
     int old_n_freepkts = ni->packets->n_free;
-    int rc = ci_tcp_helper_more_bufs(ni);
+    int rc = ci_tcp_helper_more_bufs(ni, -1);
     if( rc != 0 )
       break;
     CHECK_FREEPKTS(ni);
@@ -29,18 +29,48 @@
  * sends us down the fast lookup path, to be handled with as little fuss as
  * possible.  To this end, the two bits representing the state are packed into
  * the most significant bits of the __id_and_state field, and the value for
- * state C. is chosen to be zero to make promotion of the remaining 30 bits to
- * a 32-bit socket index a no-op. */
-#define FILTER_TABLE_ID_BITS    30
+ * state C. is chosen to be zero.
+ *
+ * Between the state and the socket index is an 8-bit tag taken from hash2 of
+ * the entry's tuple.  This lets a whole bucket (see below) be searched by
+ * comparing just the __id_and_state fields, without touching the sockets or
+ * the extra state of entries that belong to other tuples. */
+#define FILTER_TABLE_ID_BITS    22
 #define FILTER_TABLE_ID_MASK    ((1u << FILTER_TABLE_ID_BITS) - 1)
-#define FILTER_TABLE_STATE_MASK (~FILTER_TABLE_ID_MASK)
+#define FILTER_TABLE_TAG_SHIFT  FILTER_TABLE_ID_BITS
+#define FILTER_TABLE_TAG_MASK   (0xffu << FILTER_TABLE_TAG_SHIFT)
+#define FILTER_TABLE_STATE_SHIFT 30
+#define FILTER_TABLE_STATE_MASK (3u << FILTER_TABLE_STATE_SHIFT)
 enum {
   OCCUPIED_PREFERRED = 0,
-  OCCUPIED_REHASHED  = (1u << FILTER_TABLE_ID_BITS),
-  EMPTY              = (2u << FILTER_TABLE_ID_BITS),
-  TOMBSTONE          = (3u << FILTER_TABLE_ID_BITS),
+  OCCUPIED_REHASHED  = (1u << FILTER_TABLE_STATE_SHIFT),
+  EMPTY              = (2u << FILTER_TABLE_STATE_SHIFT),
+  TOMBSTONE          = (3u << FILTER_TABLE_STATE_SHIFT),
 };
 
+/* The table is divided into buckets of FILTER_TABLE_BUCKET_SLOTS entries,
+ * each of which fills a cache line.  A tuple's home bucket is the one
+ * containing slot hash1, and it may be stored in any slot of that bucket.
+ * Only when the whole bucket is occupied do we move on to another bucket,
+ * stepping hash2 buckets at a time.  The [route_count] in the extra state of
+ * the first slot of each bucket counts the entries that have passed over
+ * the bucket in this way.  A bucket with a non-zero route_count therefore
+ * never has an EMPTY slot, and so a search can stop at the first bucket that
+ * has one. */
+#define FILTER_TABLE_BUCKET_SLOTS  8
+#define FILTER_TABLE_BUCKET_MASK   (FILTER_TABLE_BUCKET_SLOTS - 1)
+
+/* Number of buckets examined by each step of the incremental compaction
+ * pass.  See ci_ip4_netif_filter_compact(). */
+#define FILTER_TABLE_COMPACT_BUCKETS  4
+
+#if defined(__x86_64__) && ! defined(__KERNEL__)
+# define FILTER_TABLE_SSE2  1
+# include <emmintrin.h>
+#else
+# define FILTER_TABLE_SSE2  0
+#endif
+
 ci_inline ci_uint32 STATE(ci_netif_filter_table_entry_fast* entry)
 {
   return entry->__id_and_state & FILTER_TABLE_STATE_MASK;
@@ -62,14 +92,112 @@ ci_inline ci_uint32 ID(ci_netif_filter_table_entry_fast* entry)
 ci_inline void
 set_entry_state(ci_netif_filter_table_entry_fast* entry, ci_uint32 state)
 {
-  entry->__id_and_state = __ID(entry) | state;
+  entry->__id_and_state = (entry->__id_and_state & ~FILTER_TABLE_STATE_MASK) |
+                          state;
 }
 
 ci_inline void
-set_entry_id(ci_netif_filter_table_entry_fast* entry, ci_uint32 id)
+set_entry(ci_netif_filter_table_entry_fast* entry, ci_uint32 state,
+          ci_uint32 tag, ci_uint32 id)
+{
+  CI_BUILD_ASSERT(CI_CFG_NETIF_MAX_ENDPOINTS_MAX <= FILTER_TABLE_ID_MASK + 1);
+  ci_assert_nflags(id, ~FILTER_TABLE_ID_MASK);
+  entry->__id_and_state = state | tag | id;
+}
+
+ci_inline ci_uint32 filter_tag(unsigned hash2)
+{
+  unsigned t = hash2 ^ (hash2 >> 16);
+  t ^= t >> 8;
+  return (t & 0xff) << FILTER_TABLE_TAG_SHIFT;
+}
+
+ci_inline unsigned bucket_of(unsigned tbl_i)
+{
+  return tbl_i & ~FILTER_TABLE_BUCKET_MASK;
+}
+
+ci_inline unsigned
+next_bucket(ci_netif_filter_table* tbl, unsigned bucket, unsigned hash2)
 {
-  ci_assert_nflags(id, FILTER_TABLE_STATE_MASK);
-  entry->__id_and_state = STATE(entry) | id;
+  /* hash2 is odd, so this visits every bucket before returning to the
+   * first. */
+  return (bucket + hash2 * FILTER_TABLE_BUCKET_SLOTS) & tbl->table_size_mask;
+}
+
+ci_inline ci_int32* bucket_route_count(ci_netif* ni, unsigned bucket)
+{
+  return &ni->filter_table_ext[bucket].route_count;
+}
+
+/* Search the bucket starting at [bucket].  Returns a bitmask of its slots
+ * that are occupied by entries carrying [tag], and sets [*empty] to a
+ * bitmask of its slots that are EMPTY. */
+ci_inline unsigned
+bucket_scan(ci_netif_filter_table* tbl, unsigned bucket, ci_uint32 tag,
+            unsigned* empty)
+{
+  ci_netif_filter_table_entry_fast* b = &tbl->table[bucket];
+#if FILTER_TABLE_SSE2
+  /* Each 16-byte load holds two entries.  Gather the __id_and_state fields
+   * of four entries into each of [lo] and [hi] and compare them all at
+   * once. */
+  const __m128i* p = (const __m128i*) b;
+  __m128i lo = _mm_castps_si128(
+                 _mm_shuffle_ps(_mm_castsi128_ps(_mm_load_si128(p + 0)),
+                                _mm_castsi128_ps(_mm_load_si128(p + 1)),
+                                _MM_SHUFFLE(2, 0, 2, 0)));
+  __m128i hi = _mm_castps_si128(
+                 _mm_shuffle_ps(_mm_castsi128_ps(_mm_load_si128(p + 2)),
+                                _mm_castsi128_ps(_mm_load_si128(p + 3)),
+                                _MM_SHUFFLE(2, 0, 2, 0)));
+  /* Occupied states have the top bit clear. */
+  __m128i key_mask = _mm_set1_epi32(EMPTY | FILTER_TABLE_TAG_MASK);
+  __m128i key = _mm_set1_epi32(tag);
+  __m128i state_mask = _mm_set1_epi32(FILTER_TABLE_STATE_MASK);
+  __m128i empty_state = _mm_set1_epi32(EMPTY);
+
+  CI_BUILD_ASSERT(sizeof(*b) * FILTER_TABLE_BUCKET_SLOTS == 4 * sizeof(*p));
+  CI_BUILD_ASSERT(CI_MEMBER_OFFSET(ci_netif_filter_table_entry_fast,
+                                   __id_and_state) == 0);
+  *empty =
+    _mm_movemask_ps(_mm_castsi128_ps(
+      _mm_cmpeq_epi32(_mm_and_si128(lo, state_mask), empty_state))) |
+    _mm_movemask_ps(_mm_castsi128_ps(
+      _mm_cmpeq_epi32(_mm_and_si128(hi, state_mask), empty_state))) << 4;
+  return
+    _mm_movemask_ps(_mm_castsi128_ps(
+      _mm_cmpeq_epi32(_mm_and_si128(lo, key_mask), key))) |
+    _mm_movemask_ps(_mm_castsi128_ps(
+      _mm_cmpeq_epi32(_mm_and_si128(hi, key_mask), key))) << 4;
+#else
+  unsigned match = 0, i;
+  *empty = 0;
+  for( i = 0; i < FILTER_TABLE_BUCKET_SLOTS; ++i ) {
+    ci_uint32 w = b[i].__id_and_state;
+    match |= ((w & (EMPTY | FILTER_TABLE_TAG_MASK)) == tag) << i;
+    *empty |= ((w & FILTER_TABLE_STATE_MASK) == EMPTY) << i;
+  }
+  return match;
+#endif
+}
+
+/* Returns a bitmask of the slots in the bucket that are not occupied. */
+ci_inline unsigned bucket_free(ci_netif_filter_table* tbl, unsigned bucket)
+{
+  unsigned free = 0, i;
+  for( i = 0; i < FILTER_TABLE_BUCKET_SLOTS; ++i )
+    if( ! OCCUPIED(&tbl->table[bucket + i]) )
+      free |= 1u << i;
+  return free;
+}
+
+/* Pops the index of the lowest set bit in [*mask]. */
+ci_inline unsigned bucket_mask_pop(unsigned* mask)
+{
+  unsigned i = ci_ffs64(*mask) - 1;
+  *mask &= *mask - 1;
+  return i;
 }
 
 #define CI_NETIF_FILTER_ID_TO_SOCK_ID(ni, filter_id)            \
@@ -86,7 +214,7 @@ static int
 ci_ip4_netif_filter_lookup(ci_netif* netif, unsigned laddr, unsigned lport,
                            unsigned raddr, unsigned rport, unsigned protocol)
 {
-  unsigned hash1, hash2 = 0;
+  unsigned hash1, hash2, tag, bucket, match, empty;
   ci_netif_filter_table* tbl;
   unsigned first;
 
@@ -97,39 +225,38 @@ ci_ip4_netif_filter_lookup(ci_netif* netif, unsigned laddr, unsigned lport,
   tbl = netif->filter_table;
   hash1 = __onload_hash1(tbl->table_size_mask, laddr, lport,
                        raddr, rport, protocol);
-  first = hash1;
+  hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
+  tag = filter_tag(hash2);
+  first = bucket = bucket_of(hash1);
 
   LOG_NV(log("tbl_lookup: %s %s:%u->%s:%u hash=%u:%u at=%u",
 	     CI_IP_PROTOCOL_STR(protocol),
 	     ip_addr_str(laddr), (unsigned) CI_BSWAP_BE16(lport),
 	     ip_addr_str(raddr), (unsigned) CI_BSWAP_BE16(rport),
-	     first, __onload_hash2(laddr, lport, raddr, rport, protocol),
-	     hash1));
+	     hash1, hash2, first));
 
   while( 1 ) {
-    ci_netif_filter_table_entry_fast* entry = &tbl->table[hash1];
+    match = bucket_scan(tbl, bucket, tag, &empty);
+    while( match ) {
+      unsigned tbl_i = bucket + bucket_mask_pop(&match);
+      ci_netif_filter_table_entry_fast* entry = &tbl->table[tbl_i];
 
-    /* This function is not used on fast paths, so we don't try to avoid
-     * touching the extra state. */
-    ci_netif_filter_table_entry_ext* entry_ext;
-    entry_ext = &netif->filter_table_ext[hash1];
+      /* This function is not used on fast paths, so we don't try to avoid
+       * touching the extra state. */
+      ci_netif_filter_table_entry_ext* entry_ext;
+      entry_ext = &netif->filter_table_ext[tbl_i];
 
-    if( CI_LIKELY(OCCUPIED(entry)) ) {
       ci_sock_cmn* s = ID_TO_SOCK(netif, ID(entry));
       if( ((laddr    - entry->laddr      ) |
 	   (lport    - entry_ext->lport  ) |
 	   (raddr    - sock_raddr_be32(s)) |
 	   (rport    - sock_rport_be16(s)) |
 	   (protocol - sock_protocol(s)  )) == 0 )
-      	return hash1;
+      	return tbl_i;
     }
-    if( STATE(entry) == EMPTY )  break;
-    /* We defer calculating hash2 until it's needed, just to make the fast
-     * case that little bit faster. */
-    if( hash1 == first )
-      hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
-    hash1 = (hash1 + hash2) & tbl->table_size_mask;
-    if( hash1 == first ) {
+    if( empty )  break;
+    bucket = next_bucket(tbl, bucket, hash2);
+    if( bucket == first ) {
       LOG_E(ci_log(FN_FMT "ERROR: LOOP %s:%u->%s:%u hash=%u:%u",
                    FN_PRI_ARGS(netif), ip_addr_str(laddr), lport,
 		   ip_addr_str(raddr), rport, hash1, hash2));
@@ -188,6 +315,21 @@ ci_netif_filter_hash(ci_netif* ni, ci_addr_t laddr, unsigned lport,
 }
 
 
+/* Start fetching the filter-table entry that a lookup of this IPv4 tuple
+ * will examine first.  Used by the poll loop so that the misses for a batch
+ * of received packets overlap.
+ */
+void
+ci_netif_filter_prefetch(ci_netif* ni, unsigned laddr, unsigned lport,
+                         unsigned raddr, unsigned rport, unsigned protocol)
+{
+  ci_netif_filter_table* tbl = ni->filter_table;
+  unsigned hash1 = __onload_hash1(tbl->table_size_mask, laddr, lport,
+                                  raddr, rport, protocol);
+  ci_prefetch(&tbl->table[hash1]);
+}
+
+
 ci_inline int /*bool*/
 handle_entry(ci_netif* ni, ci_netif_filter_table_entry_fast* entry,
              ci_netif_filter_table_entry_ext* entry_ext,
@@ -239,7 +381,7 @@ ci_netif_filter_for_each_match(ci_netif* ni,
                                void* callback_arg, ci_uint32* hash_out)
 {
   ci_netif_filter_table* tbl = NULL;
-  unsigned hash1, hash2 = 0;
+  unsigned hash1, hash2, tag, bucket, match, empty;
   unsigned first, table_size_mask;
   ci_netif_filter_table_entry_fast* entry;
 
@@ -250,20 +392,18 @@ ci_netif_filter_for_each_match(ci_netif* ni,
     *hash_out = __onload_hash3(laddr, lport, raddr, rport, protocol);
   hash1 = __onload_hash1(table_size_mask, laddr, lport, raddr, rport,
                          protocol);
-  first = hash1;
 
   LOG_NV(log("%s: %s %s:%u->%s:%u hash=%u:%u at=%u",
              __FUNCTION__, CI_IP_PROTOCOL_STR(protocol),
 	     ip_addr_str(laddr), (unsigned) CI_BSWAP_BE16(lport),
 	     ip_addr_str(raddr), (unsigned) CI_BSWAP_BE16(rport),
-	     first, __onload_hash2(laddr, lport, raddr, rport, protocol),
+	     hash1, __onload_hash2(laddr, lport, raddr, rport, protocol),
 	     hash1));
 
   /* The loop a little way below iterates over the hash table looking for
-   * matches.  The test of the first entry in our walk through the table is
-   * pulled out of the loop, however, as that first entry (i.e., the entry at
-   * the location for hash1 of the lookup-query) has some useful properties
-   * that we can exploit.
+   * matches.  The test of the entry at the location for hash1 of the
+   * lookup-query is pulled out of the loop, however, as that entry has some
+   * useful properties that we can exploit.
    *     If we find that this entry is at its preferred location, then we know
    * that the value of hash1 of our inputs that we have just calculated is also
    * equal to __onload_hash1() for the tuple stored in this entry.  But our
@@ -286,33 +426,34 @@ ci_netif_filter_for_each_match(ci_netif* ni,
                      callback_arg, 0 /*check_lport*/) )
       return 1;
   }
-  /* If the state of that first entry was OCCUPIED_REHASHED, it's a guaranteed
-   * non-match for this lookup, because this location is the preferred bucket
-   * for the query.  So we enter the loop at the point at which we've decided
-   * that the entry is a non-match. */
+
+  /* Now search the rest of the home bucket, and any buckets that entries
+   * have overflowed into, comparing tags to pick out the candidates.  If
+   * the entry at hash1 was OCCUPIED_REHASHED, it's a guaranteed non-match
+   * for this lookup, because this location is the preferred slot for the
+   * query, so it is skipped along with the entry we have just tested. */
+  hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
+  tag = filter_tag(hash2);
+  first = bucket = bucket_of(hash1);
+  match = bucket_scan(tbl, bucket, tag, &empty) & ~(1u << (hash1 - bucket));
   while( 1 ) {
-    ci_netif_filter_table_entry_ext* entry_ext;
-    if( STATE(entry) == EMPTY )
+    while( match ) {
+      unsigned tbl_i = bucket + bucket_mask_pop(&match);
+      if( handle_entry(ni, &tbl->table[tbl_i], &ni->filter_table_ext[tbl_i],
+                       laddr, lport, raddr, rport, protocol, intf_i, vlan,
+                       callback, callback_arg, 1 /*check_lport*/) )
+        return 1;
+    }
+    if( empty )
       break;
-    /* We defer calculating hash2 until it's needed, just to make the fast
-    ** case that little bit faster. */
-    if( hash1 == first )
-      hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
-    hash1 = (hash1 + hash2) & table_size_mask;
-    if( hash1 == first ) {
+    bucket = next_bucket(tbl, bucket, hash2);
+    if( bucket == first ) {
       LOG_NV(ci_log(FN_FMT "ITERATE FULL %s:%u->%s:%u hash=%u:%u",
                     FN_PRI_ARGS(ni), ip_addr_str(laddr), CI_BSWAP_BE16(lport),
                     ip_addr_str(raddr), CI_BSWAP_BE16(rport), hash1, hash2));
       break;
     }
-    entry = &tbl->table[hash1];
-    entry_ext = &ni->filter_table_ext[hash1];
-    if( OCCUPIED(entry) ) {
-      if( handle_entry(ni, entry, entry_ext, laddr, lport, raddr, rport,
-                       protocol, intf_i, vlan, callback, callback_arg,
-                       1 /*check_lport*/) )
-        return 1;
-    }
+    match = bucket_scan(tbl, bucket, tag, &empty);
   }
   return 0;
 }
@@ -328,7 +469,7 @@ ci_ip4_netif_filter_insert(ci_netif_filter_table* tbl,
 {
   ci_netif_filter_table_entry_fast* entry;
   ci_netif_filter_table_entry_ext* entry_ext;
-  unsigned hash1, hash2;
+  unsigned hash1, hash2, bucket, free, tbl_i;
 #if !defined(NDEBUG) || CI_CFG_STATS_NETIF
   unsigned hops = 1;
 #endif
@@ -337,28 +478,39 @@ ci_ip4_netif_filter_insert(ci_netif_filter_table* tbl,
   hash1 = __onload_hash1(tbl->table_size_mask, laddr, lport,
                          raddr, rport, protocol);
   hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
-  first = hash1;
+  first = bucket = bucket_of(hash1);
 
-  /* Find a free slot. */
+  /* Find a free slot, preferring the one at hash1. */
   while( 1 ) {
-    entry = &tbl->table[hash1];
-    entry_ext = &netif->filter_table_ext[hash1];
-    if( ! OCCUPIED(entry) )  break;
+    free = bucket_free(tbl, bucket);
+    if( bucket == first && (free & (1u << (hash1 - bucket))) ) {
+      tbl_i = hash1;
+      break;
+    }
+    if( free ) {
+      tbl_i = bucket + bucket_mask_pop(&free);
+      break;
+    }
 
-    ++entry_ext->route_count;
+    ++*bucket_route_count(netif, bucket);
 #if !defined(NDEBUG) || CI_CFG_STATS_NETIF
     ++hops;
 #endif
 
+#ifndef NDEBUG
     /* A socket can only have multiple entries in the filter table if each
      * entry has a different [laddr].
      */
-    ci_assert(
-      !((ID(entry) == OO_SP_TO_INT(tcp_id)) && (laddr == entry->laddr)) );
+    for( tbl_i = bucket; tbl_i < bucket + FILTER_TABLE_BUCKET_SLOTS; ++tbl_i ) {
+      entry = &tbl->table[tbl_i];
+      ci_assert(
+        !((ID(entry) == OO_SP_TO_INT(tcp_id)) && (laddr == entry->laddr)) );
+    }
+#endif
 
-    hash1 = (hash1 + hash2) & tbl->table_size_mask;
+    bucket = next_bucket(tbl, bucket, hash2);
 
-    if( hash1 == first ) {
+    if( bucket == first ) {
       ci_sock_cmn *s = SP_TO_SOCK_CMN(netif, tcp_id);
       if( ! (s->s_flags & CI_SOCK_FLAG_SW_FILTER_FULL) ) {
         LOG_E(ci_log(FN_FMT "%d FULL %s %s:%u->%s:%u hops=%u",
@@ -370,10 +522,18 @@ ci_ip4_netif_filter_insert(ci_netif_filter_table* tbl,
         s->s_flags |= CI_SOCK_FLAG_SW_FILTER_FULL;
       }
 
+      /* Undo the route counts we've added on the way round. */
+      do {
+        --*bucket_route_count(netif, bucket);
+        bucket = next_bucket(tbl, bucket, hash2);
+      } while( bucket != first );
+
       CITP_STATS_NETIF_INC(netif, sw_filter_insert_table_full);
       return -ENOBUFS;
     }
   }
+  entry = &tbl->table[tbl_i];
+  entry_ext = &netif->filter_table_ext[tbl_i];
 
   /* Now insert the new entry. */
   LOG_TC(ci_log(FN_FMT "%d INSERT %s %s:%u->%s:%u hash=%u:%u at=%u "
@@ -381,7 +541,7 @@ ci_ip4_netif_filter_insert(ci_netif_filter_table* tbl,
                 CI_IP_PROTOCOL_STR(protocol),
     ip_addr_str(laddr), (unsigned) CI_BSWAP_BE16(lport),
     ip_addr_str(raddr), (unsigned) CI_BSWAP_BE16(rport),
-    first, hash2, hash1, STATE(entry), __ID(entry), hops));
+    hash1, hash2, tbl_i, STATE(entry), __ID(entry), hops));
 
 #if CI_CFG_STATS_NETIF
   if( hops > netif->state->stats.table_max_hops )
@@ -397,49 +557,140 @@ ci_ip4_netif_filter_insert(ci_netif_filter_table* tbl,
   ++netif->state->stats.table_n_entries;
 #endif
 
-  set_entry_state(entry,
-                  hash1 == first ? OCCUPIED_PREFERRED : OCCUPIED_REHASHED);
-  set_entry_id(entry, OO_SP_TO_INT(tcp_id));
+  set_entry(entry, tbl_i == hash1 ? OCCUPIED_PREFERRED : OCCUPIED_REHASHED,
+            filter_tag(hash2), OO_SP_TO_INT(tcp_id));
   entry->laddr = laddr;
   entry_ext->lport = lport;
   return 0;
 }
 
 
+/* Decrement the route count of a bucket that an entry no longer passes
+ * over.  Once nothing passes over the bucket its tombstones are no longer
+ * needed, so they are made EMPTY so that searches can stop here again. */
+static void
+bucket_route_count_dec(ci_netif_filter_table* tbl, ci_netif* ni,
+                       unsigned bucket)
+{
+  ci_int32* route_count = bucket_route_count(ni, bucket);
+  unsigned i;
+
+  ci_assert_gt(*route_count, 0);
+  if( --*route_count != 0 )
+    return;
+  for( i = bucket; i < bucket + FILTER_TABLE_BUCKET_SLOTS; ++i )
+    if( STATE(&tbl->table[i]) == TOMBSTONE ) {
+      CITP_STATS_NETIF(--ni->state->stats.table_n_slots);
+      set_entry_state(&tbl->table[i], EMPTY);
+    }
+}
+
+
+/* Vacate the slot [tbl_i], leaving a tombstone if anything passes over its
+ * bucket. */
+static void
+filter_slot_vacate(ci_netif_filter_table* tbl, ci_netif* ni, unsigned tbl_i)
+{
+  if( *bucket_route_count(ni, bucket_of(tbl_i)) == 0 ) {
+    CITP_STATS_NETIF(--ni->state->stats.table_n_slots);
+    set_entry_state(&tbl->table[tbl_i], EMPTY);
+  }
+  else {
+    set_entry_state(&tbl->table[tbl_i], TOMBSTONE);
+  }
+}
+
+
+/* One step of the incremental compaction pass.  Tombstones can only be
+ * reclaimed once nothing passes over their bucket, so entries that have
+ * overflowed their home bucket keep them alive.  Each step examines the
+ * next few buckets and moves any such entries back to the earliest free
+ * slot on their own probe sequence, which in turn releases the route
+ * counts that they held on the buckets in between. */
+static void
+ci_ip4_netif_filter_compact(ci_netif_filter_table* tbl, ci_netif* ni)
+{
+  ci_netif_filter_table_entry_fast* entry;
+  ci_netif_filter_table_entry_ext* entry_ext;
+  unsigned bucket, slot, home, b, free, tbl_i, hash1, hash2;
+  unsigned laddr, lport, raddr, rport, protocol;
+  ci_sock_cmn* s;
+  int n;
+
+  for( n = 0; n < FILTER_TABLE_COMPACT_BUCKETS; ++n ) {
+    bucket = tbl->compact_cursor & tbl->table_size_mask;
+    tbl->compact_cursor = (bucket + FILTER_TABLE_BUCKET_SLOTS) &
+                          tbl->table_size_mask;
+
+    for( slot = bucket; slot < bucket + FILTER_TABLE_BUCKET_SLOTS; ++slot ) {
+      entry = &tbl->table[slot];
+      if( STATE(entry) != OCCUPIED_REHASHED )
+        continue;
+      entry_ext = &ni->filter_table_ext[slot];
+      s = ID_TO_SOCK(ni, ID(entry));
+      laddr = entry->laddr;
+      lport = entry_ext->lport;
+      raddr = sock_raddr_be32(s);
+      rport = sock_rport_be16(s);
+      protocol = sock_protocol(s);
+      hash1 = __onload_hash1(tbl->table_size_mask, laddr, lport,
+                             raddr, rport, protocol);
+      hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
+      home = bucket_of(hash1);
+
+      /* Walk the entry's probe sequence up to its current bucket, looking
+       * for a better slot. */
+      tbl_i = slot;
+      for( b = home; ; b = next_bucket(tbl, b, hash2) ) {
+        free = bucket_free(tbl, b);
+        if( b == home && (free & (1u << (hash1 - b))) )
+          tbl_i = hash1;
+        else if( b != bucket && free )
+          tbl_i = b + bucket_mask_pop(&free);
+        if( tbl_i != slot || b == bucket )
+          break;
+      }
+      if( tbl_i == slot )
+        continue;
+
+      LOG_TC(ci_log(FN_FMT "%d COMPACT %u->%u", FN_PRI_ARGS(ni),
+                    ID(entry), slot, tbl_i));
+      CITP_STATS_NETIF_INC(ni, table_compact_moves);
+      if( STATE(&tbl->table[tbl_i]) == EMPTY )
+        CITP_STATS_NETIF(++ni->state->stats.table_n_slots);
+      tbl->table[tbl_i].laddr = laddr;
+      ni->filter_table_ext[tbl_i].lport = lport;
+      set_entry(&tbl->table[tbl_i],
+                tbl_i == hash1 ? OCCUPIED_PREFERRED : OCCUPIED_REHASHED,
+                filter_tag(hash2), ID(entry));
+      for( ; b != bucket; b = next_bucket(tbl, b, hash2) )
+        bucket_route_count_dec(tbl, ni, b);
+      filter_slot_vacate(tbl, ni, slot);
+    }
+  }
+}
+
+
 static void
 __ci_ip4_netif_filter_remove(ci_netif_filter_table* tbl, ci_netif* ni,
                              unsigned hash1, unsigned hash2,
                              int hops, unsigned last_tbl_i)
 {
-  ci_netif_filter_table_entry_fast* entry;
-  ci_netif_filter_table_entry_ext* entry_ext;
-  unsigned tbl_i;
+  unsigned bucket;
   int i;
 
-  tbl_i = hash1;
+  bucket = bucket_of(hash1);
   for( i = 0; i < hops; ++i ) {
-    entry = &tbl->table[tbl_i];
-    entry_ext = &ni->filter_table_ext[tbl_i];
-    ci_assert(STATE(entry) != EMPTY);
-    ci_assert(entry_ext->route_count > 0);
-    if( --entry_ext->route_count == 0 && STATE(entry) == TOMBSTONE ) {
-      CITP_STATS_NETIF(--ni->state->stats.table_n_slots);
-      set_entry_state(entry, EMPTY);
-    }
-    tbl_i = (tbl_i + hash2) & tbl->table_size_mask;
+    ci_assert(STATE(&tbl->table[bucket]) != EMPTY);
+    bucket_route_count_dec(tbl, ni, bucket);
+    bucket = next_bucket(tbl, bucket, hash2);
   }
-  ci_assert(tbl_i == last_tbl_i);
+  ci_assert(bucket == bucket_of(last_tbl_i));
 
   CITP_STATS_NETIF(--ni->state->stats.table_n_entries);
-  entry = &tbl->table[tbl_i];
-  entry_ext = &ni->filter_table_ext[tbl_i];
-  if( entry_ext->route_count == 0 ) {
-    CITP_STATS_NETIF(--ni->state->stats.table_n_slots);
-    set_entry_state(entry, EMPTY);
-  }
-  else {
-    set_entry_state(entry, TOMBSTONE);
-  }
+  filter_slot_vacate(tbl, ni, last_tbl_i);
+  if( STATE(&tbl->table[last_tbl_i]) == TOMBSTONE )
+    ci_ip4_netif_filter_compact(tbl, ni);
 }
 
 
@@ -451,7 +702,7 @@ ci_ip4_netif_filter_remove(ci_netif_filter_table* tbl,
                            unsigned protocol)
 {
   ci_netif_filter_table_entry_fast* entry;
-  unsigned hash1, hash2, tbl_i;
+  unsigned hash1, hash2, bucket, tbl_i, match, empty;
   int hops = 0;
   unsigned first;
 
@@ -467,7 +718,7 @@ ci_ip4_netif_filter_remove(ci_netif_filter_table* tbl,
   hash1 = __onload_hash1(tbl->table_size_mask, laddr, lport,
                          raddr, rport, protocol);
   hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
-  first = hash1;
+  first = bucket = bucket_of(hash1);
 
   LOG_TC(ci_log("%s: [%d:%d] REMOVE %s %s:%u->%s:%u hash=%u:%u",
                 __FUNCTION__, NI_ID(netif), OO_SP_FMT(sock_p),
@@ -476,22 +727,25 @@ ci_ip4_netif_filter_remove(ci_netif_filter_table* tbl,
     ip_addr_str(raddr), (unsigned) CI_BSWAP_BE16(rport),
     hash1, hash2));
 
-  tbl_i = hash1;
   while( 1 ) {
-    entry = &tbl->table[tbl_i];
-    if( OCCUPIED(entry) && ID(entry) == OO_SP_TO_INT(sock_p) ) {
-      if( laddr == entry->laddr )
-        break;
+    match = bucket_scan(tbl, bucket, filter_tag(hash2), &empty);
+    while( match ) {
+      tbl_i = bucket + bucket_mask_pop(&match);
+      entry = &tbl->table[tbl_i];
+      if( ID(entry) == OO_SP_TO_INT(sock_p) && laddr == entry->laddr ) {
+        __ci_ip4_netif_filter_remove(tbl, netif, hash1, hash2, hops, tbl_i);
+        return;
+      }
     }
-    else if( STATE(entry) == EMPTY ) {
+    if( empty ) {
       /* We allow multiple removes of the same filter -- helps avoid some
        * complexity in the filter module.
        */
       return;
     }
-    tbl_i = (tbl_i + hash2) & tbl->table_size_mask;
+    bucket = next_bucket(tbl, bucket, hash2);
     ++hops;
-    if( tbl_i == first ) {
+    if( bucket == first ) {
       LOG_E(ci_log(FN_FMT "ERROR: LOOP [%d] %s %s:%u->%s:%u",
                    FN_PRI_ARGS(netif), OO_SP_FMT(sock_p),
                    CI_IP_PROTOCOL_STR(protocol),
@@ -500,8 +754,6 @@ ci_ip4_netif_filter_remove(ci_netif_filter_table* tbl,
       return;
     }
   }
-
-  __ci_ip4_netif_filter_remove(tbl, netif, hash1, hash2, hops, tbl_i);
 }
 
 int
@@ -598,9 +850,10 @@ void ci_netif_filter_init(ci_netif* ni, int size_lg2)
   ci_assert_le(size_lg2, 32);
 
   ni->filter_table->table_size_mask = size - 1;
+  ni->filter_table->compact_cursor = 0;
 
   for( i = 0; i < size; ++i ) {
-    set_entry_state(&ni->filter_table->table[i], EMPTY);
+    ni->filter_table->table[i].__id_and_state = EMPTY;
     ni->filter_table_ext[i].route_count = 0;
     ni->filter_table_ext[i].lport = 0;
     ni->filter_table->table[i].laddr = 0;
@@ -705,8 +958,8 @@ void ci_netif_filter_dump(ci_netif* ni)
       unsigned hash2 = __onload_hash2(laddr, lport, raddr, rport, protocol);
       log("%010d state=%u id=%-10d rt_ct=%d %s "CI_IP_PRINTF_FORMAT":%d "
           CI_IP_PRINTF_FORMAT":%d %010d:%010d",
-          i, STATE(entry) >> FILTER_TABLE_ID_BITS, ID(entry),
-          entry_ext->route_count, CI_IP_PROTOCOL_STR(protocol),
+          i, STATE(entry) >> FILTER_TABLE_STATE_SHIFT, ID(entry),
+          *bucket_route_count(ni, bucket_of(i)), CI_IP_PROTOCOL_STR(protocol),
           CI_IP_PRINTF_ARGS(&laddr), CI_BSWAP_BE16(lport),
 	  CI_IP_PRINTF_ARGS(&raddr), CI_BSWAP_BE16(rport), hash1, hash2);
     }
@@ -0,0 +1,352 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/**************************************************************************\
+** <L5_PRIVATE L5_SOURCE>
+** Description: Packet filtering and the capture ring for onload_tcpdump.
+** </L5_PRIVATE>
+\**************************************************************************/
+
+/*! \cidoxg_lib_transport_ip */
+#include "ip_internal.h"
+#include <linux/filter.h>
+
+#if CI_CFG_TCPDUMP
+
+/* The packet as seen by the filter: the frame from the Ethernet header,
+ * with the 802.1Q tag hidden if the reader asked for untagged frames.
+ */
+struct oo_dump_view {
+  ci_netif*             ni;
+  ci_ip_pkt_fmt*        pkt;
+  const ci_uint8*       seg;      /* data in the first buffer */
+  ci_uint32             seg_len;
+  ci_uint32             len;      /* length of the frame seen by the filter */
+  int                   strip_vlan;
+};
+
+
+static void oo_dump_view_init(struct oo_dump_view* v, ci_netif* ni,
+                              ci_ip_pkt_fmt* pkt)
+{
+  v->ni = ni;
+  v->pkt = pkt;
+  v->seg = (const ci_uint8*) oo_ether_hdr(pkt);
+  v->len = pkt->pay_len;
+  v->seg_len = pkt->n_buffers > 1 ? CI_MIN(pkt->buf_len, pkt->pay_len) :
+                                    pkt->pay_len;
+  v->strip_vlan = 0;
+  if( (ni->state->dump_filter_flags & OO_DUMP_FILTER_F_STRIP_VLAN) &&
+      v->seg_len >= ETH_HLEN + ETH_VLAN_HLEN &&
+      *(const ci_uint16*) (v->seg + 2 * ETH_ALEN) == CI_ETHERTYPE_8021Q ) {
+    v->strip_vlan = 1;
+    v->len -= ETH_VLAN_HLEN;
+  }
+}
+
+
+/* Byte [off] of the real frame, which must be within pay_len. */
+static ci_uint8 oo_dump_view_byte(const struct oo_dump_view* v, ci_uint32 off)
+{
+  ci_ip_pkt_fmt* frag = v->pkt;
+  int i;
+
+  if(CI_LIKELY( off < v->seg_len ))
+    return v->seg[off];
+
+  off -= v->seg_len;
+  for( i = 1; i < v->pkt->n_buffers; ++i ) {
+    if( OO_PP_IS_NULL(frag->frag_next) )
+      break;
+    frag = PKT_CHK(v->ni, frag->frag_next);
+    if( off < (ci_uint32) frag->buf_len )
+      return ((const ci_uint8*) frag->dma_start)[off];
+    off -= frag->buf_len;
+  }
+  return 0;
+}
+
+
+/* Load [size] bytes in network order from offset [k] of the frame as seen
+ * by the filter.  Returns 0 if the load is out of bounds, in which case
+ * the packet is rejected as it would be by the kernel.
+ */
+static int oo_dump_load(const struct oo_dump_view* v, ci_uint32 k, int size,
+                        ci_uint32* val_out)
+{
+  ci_uint32 val = 0;
+  int i;
+
+  if( k >= v->len || size > v->len - k )
+    return 0;
+
+  for( i = 0; i < size; ++i ) {
+    ci_uint32 off = k + i;
+    if( v->strip_vlan && off >= 2 * ETH_ALEN )
+      off += ETH_VLAN_HLEN;
+    val = (val << 8) | oo_dump_view_byte(v, off);
+  }
+  *val_out = val;
+  return 1;
+}
+
+
+/* Classic BPF interpreter.  The program lives in shared memory and so
+ * cannot be trusted: each instruction is copied before it is decoded,
+ * jumps are forward only and bounds-checked, and anything unexpected
+ * rejects the packet.  eBPF programs are not supported.
+ */
+int oo_tcpdump_filter(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  const volatile oo_dump_bpf_insn* prog = ni->state->dump_filter;
+  unsigned len = ni->state->dump_filter_len;
+  struct oo_dump_view v;
+  ci_uint32 mem[BPF_MEMWORDS];
+  ci_uint32 A = 0, X = 0, tmp;
+  oo_dump_bpf_insn insn;
+  unsigned pc;
+
+  if( len > CI_CFG_DUMP_FILTER_LEN )
+    return 0;
+  oo_dump_view_init(&v, ni, pkt);
+  memset(mem, 0, sizeof(mem));
+
+  for( pc = 0; pc < len; ++pc ) {
+    insn = prog[pc];
+    switch( insn.code ) {
+    case BPF_RET | BPF_K:
+      return insn.k != 0;
+    case BPF_RET | BPF_A:
+      return A != 0;
+
+    case BPF_LD | BPF_W | BPF_ABS:
+      if( ! oo_dump_load(&v, insn.k, 4, &A) )
+        return 0;
+      break;
+    case BPF_LD | BPF_H | BPF_ABS:
+      if( ! oo_dump_load(&v, insn.k, 2, &A) )
+        return 0;
+      break;
+    case BPF_LD | BPF_B | BPF_ABS:
+      if( ! oo_dump_load(&v, insn.k, 1, &A) )
+        return 0;
+      break;
+    case BPF_LD | BPF_W | BPF_IND:
+      if( ! oo_dump_load(&v, X + insn.k, 4, &A) )
+        return 0;
+      break;
+    case BPF_LD | BPF_H | BPF_IND:
+      if( ! oo_dump_load(&v, X + insn.k, 2, &A) )
+        return 0;
+      break;
+    case BPF_LD | BPF_B | BPF_IND:
+      if( ! oo_dump_load(&v, X + insn.k, 1, &A) )
+        return 0;
+      break;
+    case BPF_LDX | BPF_B | BPF_MSH:
+      if( ! oo_dump_load(&v, insn.k, 1, &tmp) )
+        return 0;
+      X = (tmp & 0xf) << 2;
+      break;
+    case BPF_LD | BPF_W | BPF_LEN:
+      A = v.len;
+      break;
+    case BPF_LDX | BPF_W | BPF_LEN:
+      X = v.len;
+      break;
+    case BPF_LD | BPF_IMM:
+      A = insn.k;
+      break;
+    case BPF_LDX | BPF_IMM:
+      X = insn.k;
+      break;
+    case BPF_LD | BPF_MEM:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      A = mem[insn.k];
+      break;
+    case BPF_LDX | BPF_MEM:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      X = mem[insn.k];
+      break;
+    case BPF_ST:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      mem[insn.k] = A;
+      break;
+    case BPF_STX:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      mem[insn.k] = X;
+      break;
+
+    case BPF_ALU | BPF_ADD | BPF_K:  A += insn.k;  break;
+    case BPF_ALU | BPF_ADD | BPF_X:  A += X;       break;
+    case BPF_ALU | BPF_SUB | BPF_K:  A -= insn.k;  break;
+    case BPF_ALU | BPF_SUB | BPF_X:  A -= X;       break;
+    case BPF_ALU | BPF_MUL | BPF_K:  A *= insn.k;  break;
+    case BPF_ALU | BPF_MUL | BPF_X:  A *= X;       break;
+    case BPF_ALU | BPF_AND | BPF_K:  A &= insn.k;  break;
+    case BPF_ALU | BPF_AND | BPF_X:  A &= X;       break;
+    case BPF_ALU | BPF_OR | BPF_K:   A |= insn.k;  break;
+    case BPF_ALU | BPF_OR | BPF_X:   A |= X;       break;
+    case BPF_ALU | BPF_XOR | BPF_K:  A ^= insn.k;  break;
+    case BPF_ALU | BPF_XOR | BPF_X:  A ^= X;       break;
+    case BPF_ALU | BPF_NEG:          A = -A;       break;
+    case BPF_ALU | BPF_LSH | BPF_K:
+    case BPF_ALU | BPF_LSH | BPF_X:
+      tmp = BPF_SRC(insn.code) == BPF_K ? insn.k : X;
+      A = tmp < 32 ? A << tmp : 0;
+      break;
+    case BPF_ALU | BPF_RSH | BPF_K:
+    case BPF_ALU | BPF_RSH | BPF_X:
+      tmp = BPF_SRC(insn.code) == BPF_K ? insn.k : X;
+      A = tmp < 32 ? A >> tmp : 0;
+      break;
+    case BPF_ALU | BPF_DIV | BPF_K:
+    case BPF_ALU | BPF_DIV | BPF_X:
+      tmp = BPF_SRC(insn.code) == BPF_K ? insn.k : X;
+      if( tmp == 0 )
+        return 0;
+      A /= tmp;
+      break;
+    case BPF_ALU | BPF_MOD | BPF_K:
+    case BPF_ALU | BPF_MOD | BPF_X:
+      tmp = BPF_SRC(insn.code) == BPF_K ? insn.k : X;
+      if( tmp == 0 )
+        return 0;
+      A %= tmp;
+      break;
+
+    case BPF_JMP | BPF_JA:
+      if( insn.k >= len - pc - 1 )
+        return 0;
+      pc += insn.k;
+      break;
+    case BPF_JMP | BPF_JEQ | BPF_K:
+      pc += A == insn.k ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JEQ | BPF_X:
+      pc += A == X ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JGT | BPF_K:
+      pc += A > insn.k ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JGT | BPF_X:
+      pc += A > X ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JGE | BPF_K:
+      pc += A >= insn.k ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JGE | BPF_X:
+      pc += A >= X ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JSET | BPF_K:
+      pc += A & insn.k ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JSET | BPF_X:
+      pc += A & X ? insn.jt : insn.jf;
+      break;
+
+    case BPF_MISC | BPF_TAX:
+      X = A;
+      break;
+    case BPF_MISC | BPF_TXA:
+      A = X;
+      break;
+
+    default:
+      return 0;
+    }
+  }
+
+  /* Fell off the end of the program. */
+  return 0;
+}
+
+
+/* Copy the first [caplen] bytes of the frame to [dst]. */
+static void oo_tcpdump_copy(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                            ci_uint8* dst, ci_uint32 caplen)
+{
+  ci_ip_pkt_fmt* frag = pkt;
+  ci_uint32 n;
+  int i;
+
+  n = pkt->n_buffers > 1 ? CI_MIN(pkt->buf_len, pkt->pay_len) : pkt->pay_len;
+  n = CI_MIN(n, caplen);
+  memcpy(dst, oo_ether_hdr(pkt), n);
+  dst += n;
+  caplen -= n;
+
+  for( i = 1; i < pkt->n_buffers && caplen > 0; ++i ) {
+    if( OO_PP_IS_NULL(frag->frag_next) )
+      break;
+    frag = PKT_CHK(ni, frag->frag_next);
+    n = CI_MIN((ci_uint32) frag->buf_len, caplen);
+    memcpy(dst, frag->dma_start, n);
+    dst += n;
+    caplen -= n;
+  }
+
+  /* A truncated chain leaves the rest of the record undefined; zero it
+   * rather than expose stale ring contents. */
+  if( caplen > 0 )
+    memset(dst, 0, caplen);
+}
+
+
+void oo_tcpdump_ring_put(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  oo_dump_ring* ring = ni->dump_ring;
+  ci_uint32 size = ni->dump_ring_size;
+  ci_uint64 write_off = ring->write_off;
+  ci_uint32 pos = (ci_uint32) write_off & (size - 1) & ~7u;
+  ci_uint32 caplen, rec_len, pad = 0;
+  oo_dump_rec* rec;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(CI_IS_POW2(size));
+
+  /* Keep any one record to half the ring so that it always fits once the
+   * reader has caught up. */
+  caplen = CI_MIN((ci_uint32) pkt->pay_len, ring->snaplen);
+  caplen = CI_MIN(caplen, size / 2 - sizeof(*rec));
+  rec_len = CI_ROUND_UP(sizeof(*rec) + caplen, 8);
+
+  if( pos + rec_len > size )
+    pad = size - pos;
+  if( write_off - ring->read_off + pad + rec_len > size ) {
+    CITP_STATS_NETIF_INC(ni, tcpdump_missed);
+    return;
+  }
+
+  if( pad != 0 ) {
+    rec = (oo_dump_rec*) (ring->data + pos);
+    rec->rec_len = pad;
+    rec->caplen = 0;
+    rec->intf_i = 0;
+    rec->flags = OO_DUMP_REC_F_PAD;
+    pos = 0;
+  }
+
+  rec = (oo_dump_rec*) (ring->data + pos);
+  rec->rec_len = rec_len;
+  rec->caplen = caplen;
+  rec->intf_i = pkt->intf_i;
+  rec->flags = (pkt->flags & CI_PKT_FLAG_RX) ? 0 : OO_DUMP_REC_F_TX;
+  rec->len = pkt->pay_len;
+  rec->vlan = pkt->vlan;
+  rec->reserved = 0;
+  rec->tstamp_frc = pkt->tstamp_frc;
+  rec->hw_stamp = pkt->hw_stamp;
+  oo_tcpdump_copy(ni, pkt, (ci_uint8*) (rec + 1), caplen);
+
+  /* Record must be visible before the reader sees the new offset. */
+  ci_wmb();
+  ring->write_off = write_off + pad + rec_len;
+}
+
+#endif /* CI_CFG_TCPDUMP */
+
+/*! \cidoxg_end */
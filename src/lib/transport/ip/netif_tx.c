@@ -127,6 +127,31 @@ void ci_netif_dmaq_shove2(ci_netif* ni, int intf_i, int is_fresh)
 }
 
 
+void ci_netif_tx_batch_start(ci_netif* ni)
+{
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_equal(ni->tx_batch, 0);
+  ni->tx_batch = CI_NETIF_TX_BATCH_ACTIVE;
+}
+
+
+void ci_netif_tx_batch_end(ci_netif* ni)
+{
+  unsigned intfs = ni->tx_batch & ~CI_NETIF_TX_BATCH_ACTIVE;
+  int intf_i;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_flags(ni->tx_batch, CI_NETIF_TX_BATCH_ACTIVE);
+  ni->tx_batch = 0;
+
+  OO_STACK_FOR_EACH_INTF_I(ni, intf_i)
+    if( intfs & (1u << intf_i) ) {
+      ef_vi_transmit_push(&ni->nic_hw[intf_i].vi);
+      CITP_STATS_NETIF_INC(ni, tx_dma_doorbells);
+    }
+}
+
+
 void __ci_netif_send(ci_netif* netif, ci_ip_pkt_fmt* pkt)
 {
   int intf_i, rc;
@@ -169,7 +194,18 @@ void __ci_netif_send(ci_netif* netif, ci_ip_pkt_fmt* pkt)
   /* Check that the VI we're given matches the pkt's intf_i */
   ci_assert_equal(vi, &netif->nic_hw[pkt->intf_i].vi);
 
-  if( oo_pktq_is_empty(dmaq) ) {
+  if( netif->tx_batch && oo_pktq_is_empty(dmaq) ) {
+    /* Leave the doorbell for ci_netif_tx_batch_end().  PIO and CTPIO
+     * don't help when we're sending a batch, so just DMA. */
+    ci_netif_pkt_to_iovec(netif, pkt, iov,
+                          sizeof(iov) / sizeof(iov[0]));
+    if( ef_vi_transmitv_init(vi, iov, pkt->n_buffers, OO_PKT_ID(pkt)) >= 0 ) {
+      ci_netif_ctpio_desist(netif, intf_i);
+      netif->tx_batch |= 1u << intf_i;
+      goto done;
+    }
+  }
+  else if( oo_pktq_is_empty(dmaq) ) {
 #if CI_CFG_USE_PIO
     /* pio_thresh is set to zero if PIO disabled on this stack, so don't
      * need to check NI_OPTS().pio here
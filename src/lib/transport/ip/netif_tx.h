@@ -163,6 +163,8 @@ ci_inline void ci_netif_dmaq_and_vi_for_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
   do {                                                                  \
     ++(ni)->state->nic[(pkt)->intf_i].tx_dmaq_insert_seq;               \
     (ni)->state->nic[(pkt)->intf_i].tx_bytes_added+=TX_PKT_LEN(pkt);    \
+    if(CI_UNLIKELY( (ni)->lat_hists != NULL ))                          \
+      ci_frc64(&((pkt)->tstamp_frc));                                   \
     if( oo_tcpdump_check(ni, pkt, (pkt)->intf_i) ) {                    \
       ci_frc64(&((pkt)->tstamp_frc));                                   \
       oo_tcpdump_dump_pkt(ni, pkt);                                     \
@@ -1739,12 +1739,190 @@ int ci_pipe_zc_move(ci_netif* ni, struct oo_pipe* pipe_src,
                               oo_pipe_zc_move_cb, &ctx);
 }
 
+
+struct oo_pipe_tee_ctx {
+  ci_netif* ni;
+  struct oo_pipe* pipe_dest;
+  int flags;
+  int bytes_copied;
+};
+
+
+/* Copies the readable data to the destination pipe.  Returns 0 on success
+ * so that the source pipe is left untouched.
+ */
+static int oo_pipe_tee_cb(void* c, struct iovec* iov, int iov_num, int flags)
+{
+  struct oo_pipe_tee_ctx* ctx = c;
+  int rc = ci_pipe_write_flags(ctx->ni, ctx->pipe_dest, iov, iov_num,
+                               ctx->flags);
+  if( rc < 0 )
+    return rc;
+  ctx->bytes_copied = rc;
+  return 0;
+}
+
+
+/* Duplicates up to [len] bytes from the head of [pipe_src] into
+ * [pipe_dest] without consuming them, as tee() does.  Both pipes must be
+ * in the same stack.  The data is copied: buffers cannot be shared between
+ * two pipe lists.
+ *
+ * Supported flags: MSG_DONTWAIT
+ */
+int ci_pipe_tee(ci_netif* ni, struct oo_pipe* pipe_src,
+                struct oo_pipe* pipe_dest, int len, int flags)
+{
+  struct oo_pipe_tee_ctx ctx = {
+    .ni = ni,
+    .pipe_dest = pipe_dest,
+    .flags = flags & MSG_DONTWAIT,
+  };
+  int rc = ci_pipe_zc_read(ni, pipe_src, len, flags & MSG_DONTWAIT,
+                           oo_pipe_tee_cb, &ctx);
+  return rc < 0 ? rc : ctx.bytes_copied;
+}
+
+
+/* Splices up to [len] bytes from the receive queue of [ts] into [p] by
+ * moving whole packet buffers, as many as the pipe has room for.  Returns
+ * the number of bytes moved.  Returns 0 when nothing could be moved this
+ * way, and the caller should then fall back to copying, which also deals
+ * with blocking, end of stream and errors.
+ */
+int ci_pipe_splice_from_tcp(ci_netif* ni, struct oo_pipe* p,
+                            ci_tcp_state* ts, int len)
+{
+  struct ci_pipe_pkt_list pkts = {};
+  int room, rc = 0;
+
+  ci_sock_lock(ni, &ts->s.b);
+  ci_netif_lock(ni);
+
+  if( p->aflags & (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_READER_SHIFT) )
+    goto out;
+
+  oo_pipe_reap_empty_buffers(ni, p, 0, NULL);
+  room = p->bufs_max - p->bufs_num;
+  if( room > 0 )
+    rc = ci_tcp_splice_recv(ni, ts, len, room, &pkts);
+  if( rc > 0 ) {
+    oo_pipe_insert_buffers(ni, p, &pkts);
+    ci_wmb();
+    p->bytes_added += rc;
+    __oo_pipe_wake_peer(ni, p, CI_SB_FLAG_WAKE_RX);
+    CITP_STATS_NETIF_ADD(ni, tcp_splice_rx_pkts, pkts.count);
+  }
+
+ out:
+  ci_netif_unlock(ni);
+  ci_sock_unlock(ni, &ts->s.b);
+  return rc;
+}
+
+
+struct oo_pipe_splice_tcp_ctx {
+  ci_tcp_state* ts;
+  int flags;
+};
+
+
+/* Hands the longest run of whole buffers from the head of the pipe that
+ * the socket can send as-is over to its send queue.  Anything else is left
+ * for the caller to copy.
+ */
+static int
+oo_pipe_splice_to_tcp_cb(void* c, ci_netif* ni, struct oo_pipe* p, int flags,
+                         ci_ip_pkt_fmt* head, int bytes_available, int len,
+                         ci_ip_pkt_fmt** next_pkt_out, int* next_pkt_payload_out,
+                         int* n_pkts_out)
+{
+  struct oo_pipe_splice_tcp_ctx* ctx = c;
+  ci_tcp_state* ts = ctx->ts;
+  struct ci_pipe_pkt_list pkts = {
+    .head = head,
+  };
+  ci_ip_pkt_fmt* pkt = head;
+  ci_uint32 offset = p->read_ptr.offset;
+  int space = ci_tcp_splice_send_space(ni, ts);
+  int bytes = 0;
+  int n;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_equal(OO_PKT_P(head), p->read_ptr.pp);
+
+  *next_pkt_out = head;
+  *next_pkt_payload_out = 0;
+  *n_pkts_out = 0;
+  len = CI_MIN(len, bytes_available);
+
+  while( bytes < len && pkts.count < space ) {
+    n = pkt->pf.pipe.pay_len - offset;
+    if( n > len - bytes ||
+        ! ci_tcp_splice_pkt_ok(ni, ts, pkt, pipe_get_point(ni, p, pkt, offset),
+                               n) )
+      break;
+    pkts.tail = pkt;
+    ++pkts.count;
+    bytes += n;
+    offset = 0;
+    if( bytes < len )
+      pkt = PKT_CHK(ni, oo_pipe_next_buf(p, pkt));
+  }
+  if( pkts.count == 0 )
+    return 0;
+
+  *next_pkt_out = PKT_CHK(ni, oo_pipe_next_buf(p, pkts.tail));
+  *n_pkts_out = pkts.count;
+  head->pf.pipe.base += p->read_ptr.offset;
+  head->pf.pipe.pay_len -= p->read_ptr.offset;
+  return ci_tcp_splice_send(ni, ts, &pkts, ctx->flags);
+}
+
+
+/* Splices up to [len] bytes from [p] to the send queue of [ts] by moving
+ * whole packet buffers.  Only buffers that already have room for the
+ * headers in front of their payload qualify, which in practice means
+ * buffers spliced into the pipe from a TCP socket.  Returns the number of
+ * bytes moved, or 0 if the caller should fall back to copying.
+ *
+ * Supported flags: MSG_DONTWAIT, MSG_MORE
+ */
+int ci_pipe_splice_to_tcp(ci_netif* ni, struct oo_pipe* p, ci_tcp_state* ts,
+                          int len, int flags)
+{
+  struct oo_pipe_splice_tcp_ctx ctx = {
+    .ts = ts,
+    .flags = flags & MSG_MORE,
+  };
+  return oo_pipe_zc_read_bare(ni, p, len, flags & MSG_DONTWAIT,
+                              OO_PIPE_ZC_READ_BARE_FLAG_LOCK_STACK |
+                              OO_PIPE_ZC_READ_BARE_FLAG_REMOVE_BUFFERS,
+                              oo_pipe_splice_to_tcp_cb, &ctx);
+}
+
 #endif
 
 
 int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
                   const struct iovec *iov,
                   size_t iovlen)
+{
+  return ci_pipe_write_flags(ni, p, iov, iovlen,
+                             (p->aflags & (CI_PFD_AFLAG_NONBLOCK <<
+                                           CI_PFD_AFLAG_WRITER_SHIFT)) ?
+                             MSG_DONTWAIT : 0);
+}
+
+
+/* As ci_pipe_write(), but blocking is controlled by the caller rather than
+ * by the O_NONBLOCK state of the write end.
+ *
+ * Supported flags: MSG_DONTWAIT
+ */
+int ci_pipe_write_flags(ci_netif* ni, struct oo_pipe* p,
+                        const struct iovec *iov,
+                        size_t iovlen, int flags)
 {
   int total_bytes = 0, rc;
   int i;
@@ -1761,9 +1939,7 @@ int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
   LOG_PIPE("%s[%u]: ENTER nonblock=%s bufs=%d wr=%d wr_wait=%d rd=%d",
            __FUNCTION__,
            p->b.bufid,
-           (p->aflags &
-            (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT)) ?
-           "true" : "false",
+           (flags & MSG_DONTWAIT) ? "true" : "false",
            p->bufs_num,
            OO_PP_FMT(p->write_ptr.pp),
            OO_PP_FMT(p->write_ptr.pp_wait),
@@ -1858,8 +2034,7 @@ int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
         }
         ci_assert_nequal(pkt, NULL);
         p->write_ptr.pp_wait = pkt->next;
-        if( p->aflags &
-            (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT) ) {
+        if( flags & MSG_DONTWAIT ) {
           /* Since we're non-blocking, [add] is the total count of bytes we've
            * written. */
           if( add > 0 )
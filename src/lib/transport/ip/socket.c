@@ -59,6 +59,12 @@ void ci_sock_cmn_init(ci_netif* ni, ci_sock_cmn* s, int can_poison)
   citp_waitable_reinit(ni, &s->b);
   oo_sock_cplane_init(&s->cp);
 
+  if( ni->lat_hists != NULL ) {
+    ci_sock_lat_hists* sh = ci_netif_sock_lat_hists(ni, SC_SP(s));
+    if( sh != NULL )
+      memset(sh, 0, sizeof(*sh));
+  }
+
 #if CI_CFG_IPV6
   s->tclass = CI_IPV6_DFLT_TCLASS;
 #endif
@@ -650,6 +650,8 @@ void ci_tcp_listen_shutdown_queues(ci_netif* netif, ci_tcp_socket_listen* tls)
     tcp_helper_resource_t *thr = NULL;
 
     w = ci_tcp_acceptq_get(netif, tls);
+    if( w == NULL )
+      break;
 
     if( w->sb_aflags & CI_SB_AFLAG_MOVED_AWAY ) {
       oo_sp sp;
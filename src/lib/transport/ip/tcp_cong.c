@@ -0,0 +1,842 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+** \author
+**  \brief  TCP congestion control algorithms: NewReno, CUBIC and BBR.
+**   \date
+**    \cop  (c) Solarflare Communications Inc.
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_transport_ip */
+
+#include "ip_internal.h"
+
+
+#define LPF "TCP CONG "
+
+
+/* Each algorithm provides a set of hooks which are called with the stack
+ * lock held from the points in the TCP state machine where cwnd and
+ * ssthresh were traditionally updated.  The algorithm is selected per
+ * socket by [ts->c.cong_alg]; the socket state lives in shared memory so
+ * can only hold an index, and this table is the only place that knows
+ * about function pointers.
+ */
+typedef struct {
+  const char* name;
+
+  /* Initialise private state in [ts->cong].  Called once cwnd has been
+   * set to its initial value, and when TCP_CONGESTION changes the
+   * algorithm of a connected socket. */
+  void (*init)(ci_netif* ni, ci_tcp_state* ts);
+
+  /* New data has been ACKed while cwnd is free to grow: congstate is
+   * CI_TCP_CONG_OPEN, or an RTO has reset cwnd to one segment and it is
+   * to slow-start again, or (unless [hold_in_recovery]) the connection is
+   * in fast recovery.  [ts->bytes_acked] has already been advanced by
+   * [acked].  [rtt] is an RTT sample in ticks, or negative if the ACK did
+   * not yield one. */
+  void (*cong_avoid)(ci_netif* ni, ci_tcp_state* ts, unsigned acked,
+                     int rtt);
+
+  /* Non-zero to hold cwnd during fast recovery and COOLING, where
+   * ci_tcp_try_cwndrecover() owns it.  Reno opens cwnd on every ACK of
+   * new data, as the NewReno path always has. */
+  int hold_in_recovery;
+
+  /* Loss has been detected (fast recovery or RTO).  Returns the new value
+   * for ssthresh. */
+  unsigned (*ssthresh)(ci_netif* ni, ci_tcp_state* ts);
+
+  /* The connection has left loss recovery.  May be NULL. */
+  void (*recovered)(ci_netif* ni, ci_tcp_state* ts);
+
+  /* Rate to pace transmits at, in bytes per second, or zero to fall back
+   * to the cwnd/srtt rate.  May be NULL. */
+  ci_uint32 (*pacing_rate)(ci_netif* ni, ci_tcp_state* ts);
+
+  void (*dump)(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+               oo_dump_log_fn_t logger, void* log_arg);
+} ci_tcp_cong_ops;
+
+
+/* Approximate time in microseconds, from the frc cached by the last poll.
+ * This wraps about every 71 minutes, so only differences of these values
+ * taken with unsigned arithmetic are meaningful. */
+ci_inline ci_uint32 ci_tcp_cong_now_us(ci_netif* ni)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return (ci_uint32) (its->frc >> its->ci_ip_time_frc2us);
+}
+
+
+/* As ci_tcp_cong_now_us(), in milliseconds.  Scaled down from the full
+ * 64-bit frc, so this wraps only every 49 days. */
+ci_inline ci_uint32 ci_tcp_cong_now_ms(ci_netif* ni)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return (ci_uint32) ((its->frc >> its->ci_ip_time_frc2us) / 1000u);
+}
+
+
+ci_inline ci_uint32 ci_tcp_cong_ticks2us(ci_netif* ni, ci_iptime_t t)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return t << (its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us);
+}
+
+
+/* Number of the units of ci_tcp_cong_now_us() in a second. */
+ci_inline ci_uint64 ci_tcp_cong_us_per_sec(ci_netif* ni)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return ((ci_uint64) its->khz * 1000u) >> its->ci_ip_time_frc2us;
+}
+
+
+/* Integer cube root, rounded down. */
+static ci_uint32 ci_tcp_cong_cbrt(ci_uint64 x)
+{
+  ci_uint64 y = 0, b;
+  int s;
+
+  for( s = 63; s >= 0; s -= 3 ) {
+    y <<= 1;
+    b = 3 * y * (y + 1) + 1;
+    if( (x >> s) >= b ) {
+      x -= b << s;
+      ++y;
+    }
+  }
+  return (ci_uint32) y;
+}
+
+
+/**********************************************************************
+ * NewReno
+ */
+
+/* Slow-start, as per RFC3465 (ABC). */
+static void ci_tcp_cong_slow_start(ci_netif* ni, ci_tcp_state* ts)
+{
+  unsigned cwnd_inc;
+  LOG_TV(log(LPF "%d OPENCWND: SS eff_mss=%u bytes_acked=%u cwnd=%u",
+             S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked, ts->cwnd));
+#if CI_CFG_CONG_AVOID_SLOW_START_MODE == 2
+  cwnd_inc = CI_MIN(ts->ssthresh - ts->cwnd, ts->bytes_acked);
+  ts->cwnd += cwnd_inc;
+  ts->bytes_acked -= cwnd_inc;
+#else
+  if( CI_CFG_CONG_AVOID_SLOW_START_MODE == 0 && ts->stats.rtos == 0 )
+    /* RFC3465 sec 2.2: May only increase cwnd by more than mss if we've
+    * never had any RTOs on this connection.
+    */
+    cwnd_inc = tcp_eff_mss(ts) * CI_CFG_CONG_AVOID_RFC3465_L_VALUE;
+  else
+    cwnd_inc = tcp_eff_mss(ts);
+  cwnd_inc = CI_MIN(cwnd_inc, ts->bytes_acked);
+  ts->cwnd += cwnd_inc;
+  ts->bytes_acked = 0;
+#endif
+}
+
+
+/* Open the congestion window following the reception of an ack for new
+** data. Implements RFC3465 (ABC)
+*/
+static void ci_tcp_reno_cong_avoid(ci_netif* ni, ci_tcp_state* ts,
+                                   unsigned acked, int rtt)
+{
+  if( ts->cwnd >= ts->ssthresh ) {
+    /* Hack - Increase less aggresively on small round trip times */
+#if CI_CFG_CONG_AVOID_SCALE_BACK
+    unsigned tmp = 0, cwnd_scaled;
+    /* tcp_srtt(ts) would relatively easy exceed 32 for a round trip time
+     * on longer links */
+    if( tcp_srtt(ts) < 32 )
+      tmp = NI_OPTS(ni).cong_avoid_scale_back >> tcp_srtt(ts);
+    cwnd_scaled = CI_MAX(1, tmp) * ts->cwnd;
+#else
+    unsigned cwnd_scaled = ts->cwnd;
+#endif
+    /* Congestion avoidance.  RFC3465 says: increase the congestion window
+    ** by one segment each RTT.  i.e. wait for bytes_acked to be > cwnd
+    ** (which takes one RTT), then reset bytes_acked by subtracting the
+    ** cwnd from it, and add one segment to cwnd.
+    */
+    LOG_TV(log(LPF "%d OPENCWND: CA eff_mss=%u bytes_acked=%u cwnd=%u",
+               S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked, ts->cwnd));
+    if( ts->bytes_acked >= cwnd_scaled ) {
+      ts->bytes_acked -= cwnd_scaled;
+      ts->cwnd += tcp_eff_mss(ts);
+    }
+  }
+  else {
+    ci_tcp_cong_slow_start(ni, ts);
+  }
+}
+
+
+static unsigned ci_tcp_reno_ssthresh(ci_netif* ni, ci_tcp_state* ts)
+{
+  return ci_tcp_losswnd(ts);
+}
+
+
+/**********************************************************************
+ * CUBIC (RFC8312)
+ *
+ * W_cubic(t) = C * (t - K)^3 + W_max, with C = 0.4 segments/s^3 and the
+ * multiplicative decrease factor beta = 0.7.  Times are in (approximate)
+ * milliseconds, windows in bytes.
+ */
+
+#define CI_TCP_CUBIC_BETA          717    /* 0.7 * 1024 */
+/* Reno-friendly additive increase: 3 * (1 - beta) / (1 + beta) * 1024 */
+#define CI_TCP_CUBIC_RENO_ALPHA    542
+/* Bound on |t - K| so that the cube below cannot overflow.  The curve is
+ * far beyond any usable window long before this point. */
+#define CI_TCP_CUBIC_MAX_DELTA_MS  (1u << 19u)
+
+
+static void ci_tcp_cubic_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->cong.cubic.w_max = 0;
+  ts->cong.cubic.origin = 0;
+  ts->cong.cubic.w_est = 0;
+  ts->cong.cubic.epoch_ms = 0;
+  ts->cong.cubic.k_ms = 0;
+}
+
+
+/* Returns the number of bytes that must be ACKed to grow cwnd by one MSS
+ * in congestion avoidance. */
+static ci_uint32 ci_tcp_cubic_update(ci_netif* ni, ci_tcp_state* ts,
+                                     unsigned acked)
+{
+  ci_uint32 mss = tcp_eff_mss(ts);
+  ci_uint32 now_ms = ci_tcp_cong_now_ms(ni);
+  ci_uint32 t, d, target;
+  ci_uint64 offs, cnt;
+
+  if( ts->cong.cubic.epoch_ms == 0 ) {
+    /* Start of a new epoch: first ACK in congestion avoidance since the
+     * last reduction. */
+    ts->cong.cubic.epoch_ms = now_ms | 1u;
+    ts->cong.cubic.w_est = ts->cwnd;
+    if( ts->cwnd < ts->cong.cubic.w_max ) {
+      /* K = cbrt((W_max - cwnd) / C) seconds.  In ms with a window in
+       * bytes: cbrt((W_max - cwnd) / mss * 2.5 * 10^9). */
+      ci_uint64 x = (ci_uint64) (ts->cong.cubic.w_max - ts->cwnd) * 2500u;
+      ts->cong.cubic.k_ms = ci_tcp_cong_cbrt(x / mss * 1000000u);
+      ts->cong.cubic.origin = ts->cong.cubic.w_max;
+    }
+    else {
+      ts->cong.cubic.k_ms = 0;
+      ts->cong.cubic.origin = ts->cwnd;
+    }
+  }
+
+  /* Target the window we expect to have one RTT from now. */
+  t = now_ms - ts->cong.cubic.epoch_ms +
+      ci_tcp_cong_ticks2us(ni, tcp_srtt(ts)) / 1000u;
+  d = t > ts->cong.cubic.k_ms ? t - ts->cong.cubic.k_ms :
+                                ts->cong.cubic.k_ms - t;
+  d = CI_MIN(d, CI_TCP_CUBIC_MAX_DELTA_MS);
+  /* C * d^3 in bytes: 0.4 * mss * d^3 / 10^9 */
+  offs = (ci_uint64) d * d * d / 1000u * 4u * mss / 10000000u;
+  if( t > ts->cong.cubic.k_ms )
+    target = ts->cong.cubic.origin + (ci_uint32) CI_MIN(offs, 0x7fffffffu);
+  else if( offs < ts->cong.cubic.origin )
+    target = ts->cong.cubic.origin - (ci_uint32) offs;
+  else
+    target = 0;
+
+  if( target > ts->cwnd )
+    cnt = (ci_uint64) ts->cwnd * mss / (target - ts->cwnd);
+  else
+    cnt = (ci_uint64) ts->cwnd * 100u;
+
+  /* TCP-friendly region: never grow more slowly than Reno would. */
+  ts->cong.cubic.w_est += (ci_uint64) mss * acked * CI_TCP_CUBIC_RENO_ALPHA /
+                          ((ci_uint64) ts->cong.cubic.w_est << 10u);
+  if( ts->cong.cubic.w_est > ts->cwnd ) {
+    ci_uint64 cnt_est = (ci_uint64) ts->cwnd * mss /
+                        (ts->cong.cubic.w_est - ts->cwnd);
+    cnt = CI_MIN(cnt, cnt_est);
+  }
+
+  /* Grow by at most half an MSS per MSS ACKed. */
+  return (ci_uint32) CI_MIN(CI_MAX(cnt, mss << 1u), 0xffffffffu);
+}
+
+
+static void ci_tcp_cubic_cong_avoid(ci_netif* ni, ci_tcp_state* ts,
+                                    unsigned acked, int rtt)
+{
+  ci_uint32 cnt;
+
+  if( ts->cwnd < ts->ssthresh ) {
+    ci_tcp_cong_slow_start(ni, ts);
+    return;
+  }
+
+  cnt = ci_tcp_cubic_update(ni, ts, acked);
+  LOG_TV(log(LPF "%d OPENCWND: CUBIC bytes_acked=%u cwnd=%u cnt=%u",
+             S_FMT(ts), ts->bytes_acked, ts->cwnd, cnt));
+  if( ts->bytes_acked >= cnt ) {
+    ci_uint32 n = ts->bytes_acked / cnt;
+    ts->bytes_acked -= n * cnt;
+    ts->cwnd += n * tcp_eff_mss(ts);
+  }
+}
+
+
+static unsigned ci_tcp_cubic_ssthresh(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_uint32 mss2 = tcp_eff_mss(ts) << 1u;
+
+  ts->cong.cubic.epoch_ms = 0;
+  /* Fast convergence: if we are losing before reaching the previous
+   * W_max then release bandwidth to newer flows. */
+  if( ts->cwnd < ts->cong.cubic.w_max )
+    ts->cong.cubic.w_max = (ci_uint64) ts->cwnd *
+                           (1024u + CI_TCP_CUBIC_BETA) / 2048u;
+  else
+    ts->cong.cubic.w_max = ts->cwnd;
+
+  return CI_MAX((ci_uint64) ts->cwnd * CI_TCP_CUBIC_BETA / 1024u, mss2);
+}
+
+
+static void ci_tcp_cubic_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                              oo_dump_log_fn_t logger, void* log_arg)
+{
+  logger(log_arg, "%s  cubic: w_max=%u origin=%u w_est=%u k=%ums%s", pf,
+         ts->cong.cubic.w_max, ts->cong.cubic.origin, ts->cong.cubic.w_est,
+         ts->cong.cubic.k_ms, ts->cong.cubic.epoch_ms ? "" : " NO_EPOCH");
+}
+
+
+/**********************************************************************
+ * BBR version 1
+ *
+ * Bandwidth is sampled once per round trip: a round starts at an ACK and
+ * ends when everything that had been sent at that point has been ACKed,
+ * and the sample is the data delivered over the round divided by its
+ * duration.  The minimum RTT comes from the same RTT samples used for the
+ * RTO.  cwnd is set to a gain times the estimated BDP.  Gains are fixed
+ * point with CI_TCP_BBR_UNIT == 1.0.
+ */
+
+#define CI_TCP_BBR_UNIT            256
+#define CI_TCP_BBR_HIGH_GAIN       739   /* 2/ln(2) */
+#define CI_TCP_BBR_DRAIN_GAIN      88    /* 1/high_gain */
+#define CI_TCP_BBR_CWND_GAIN       512
+#define CI_TCP_BBR_FULL_BW_THRESH  320   /* 1.25 */
+#define CI_TCP_BBR_FULL_BW_ROUNDS  3
+#define CI_TCP_BBR_BW_WIN_ROUNDS   10
+#define CI_TCP_BBR_MIN_RTT_WIN_MS  10000
+#define CI_TCP_BBR_PROBE_RTT_US    200000
+#define CI_TCP_BBR_MIN_CWND_SEGS   4
+#define CI_TCP_BBR_CYCLE_LEN       8
+
+static const ci_uint16 ci_tcp_bbr_cycle_gain[CI_TCP_BBR_CYCLE_LEN] = {
+  CI_TCP_BBR_UNIT * 5 / 4, CI_TCP_BBR_UNIT * 3 / 4,
+  CI_TCP_BBR_UNIT, CI_TCP_BBR_UNIT, CI_TCP_BBR_UNIT,
+  CI_TCP_BBR_UNIT, CI_TCP_BBR_UNIT, CI_TCP_BBR_UNIT,
+};
+
+static const char* const ci_tcp_bbr_mode_str[] = {
+  "STARTUP", "DRAIN", "PROBE_BW", "PROBE_RTT"
+};
+
+
+ci_inline int ci_tcp_bbr_full_bw_reached(ci_tcp_state* ts)
+{
+  return ts->cong.bbr.full_bw_cnt >= CI_TCP_BBR_FULL_BW_ROUNDS;
+}
+
+
+static ci_uint32 ci_tcp_bbr_pacing_gain(ci_tcp_state* ts)
+{
+  switch( ts->cong.bbr.mode ) {
+  case CI_TCP_BBR_MODE_STARTUP:
+    return CI_TCP_BBR_HIGH_GAIN;
+  case CI_TCP_BBR_MODE_DRAIN:
+    return CI_TCP_BBR_DRAIN_GAIN;
+  case CI_TCP_BBR_MODE_PROBE_BW:
+    return ci_tcp_bbr_cycle_gain[ts->cong.bbr.cycle_idx];
+  default:
+    return CI_TCP_BBR_UNIT;
+  }
+}
+
+
+/* Estimated BDP scaled by [gain], or zero if we have no model yet. */
+static ci_uint32 ci_tcp_bbr_bdp(ci_tcp_state* ts, ci_uint32 gain)
+{
+  ci_uint64 bdp;
+  if( ts->cong.bbr.max_bw == 0 || ts->cong.bbr.min_rtt_us == 0xffffffffu )
+    return 0;
+  bdp = (ci_uint64) ts->cong.bbr.max_bw * ts->cong.bbr.min_rtt_us / 1000u;
+  bdp = bdp * gain / CI_TCP_BBR_UNIT;
+  return (ci_uint32) CI_MIN(bdp, 0x7fffffffu);
+}
+
+
+static void ci_tcp_bbr_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->cong.bbr.max_bw = 0;
+  ts->cong.bbr.full_bw = 0;
+  ts->cong.bbr.min_rtt_us = 0xffffffffu;
+  ts->cong.bbr.min_rtt_stamp = ci_tcp_time_now(ni);
+  ts->cong.bbr.round_seq = 0;
+  ts->cong.bbr.round_una = 0;
+  ts->cong.bbr.round_us = 0;
+  ts->cong.bbr.prior_cwnd = 0;
+  ts->cong.bbr.mode_us = 0;
+  ts->cong.bbr.max_bw_age = 0;
+  ts->cong.bbr.mode = CI_TCP_BBR_MODE_STARTUP;
+  ts->cong.bbr.cycle_idx = 0;
+  ts->cong.bbr.full_bw_cnt = 0;
+}
+
+
+ci_inline void ci_tcp_bbr_round_start(ci_tcp_state* ts, ci_uint32 una,
+                                      ci_uint32 now_us)
+{
+  ts->cong.bbr.round_seq = tcp_snd_nxt(ts);
+  ts->cong.bbr.round_una = una;
+  /* Nothing in flight means there is nothing to time the round by. */
+  ts->cong.bbr.round_us = SEQ_EQ(tcp_snd_nxt(ts), una) ? 0 : (now_us | 1u);
+}
+
+
+/* Returns true at the end of a round trip, having updated the bandwidth
+ * filter.  [una] is the new left edge: the hooks are called before
+ * snd_una is advanced past the ACKed data. */
+static int ci_tcp_bbr_update_bw(ci_tcp_state* ts, ci_uint32 una,
+                                ci_uint32 now_us)
+{
+  ci_uint32 interval, bw;
+  int app_limited;
+
+  if( ts->cong.bbr.round_us == 0 ) {
+    ci_tcp_bbr_round_start(ts, una, now_us);
+    return 0;
+  }
+  if( SEQ_LT(una, ts->cong.bbr.round_seq) )
+    return 0;
+
+  interval = CI_MAX(now_us - ts->cong.bbr.round_us, 1u);
+  bw = (ci_uint64) SEQ_SUB(una, ts->cong.bbr.round_una) *
+       1000u / interval;
+  /* If the application did not keep the pipe full then the sample only
+   * gives a lower bound, so is only interesting if it is a new max. */
+  app_limited = ci_ip_queue_is_empty(&ts->send);
+
+  ++ts->cong.bbr.max_bw_age;
+  if( bw >= ts->cong.bbr.max_bw ||
+      (! app_limited &&
+       ts->cong.bbr.max_bw_age > CI_TCP_BBR_BW_WIN_ROUNDS) ) {
+    ts->cong.bbr.max_bw = bw;
+    ts->cong.bbr.max_bw_age = 0;
+  }
+
+  /* Leave STARTUP once three rounds have failed to grow the bandwidth by
+   * at least 25%. */
+  if( ! ci_tcp_bbr_full_bw_reached(ts) && ! app_limited ) {
+    if( (ci_uint64) ts->cong.bbr.max_bw * CI_TCP_BBR_UNIT >=
+        (ci_uint64) ts->cong.bbr.full_bw * CI_TCP_BBR_FULL_BW_THRESH ) {
+      ts->cong.bbr.full_bw = ts->cong.bbr.max_bw;
+      ts->cong.bbr.full_bw_cnt = 0;
+    }
+    else {
+      ++ts->cong.bbr.full_bw_cnt;
+    }
+  }
+
+  ci_tcp_bbr_round_start(ts, una, now_us);
+  return 1;
+}
+
+
+static void ci_tcp_bbr_update_min_rtt(ci_netif* ni, ci_tcp_state* ts,
+                                      int rtt, ci_uint32 now_us)
+{
+  ci_iptime_t now = ci_tcp_time_now(ni);
+  int expired = TIME_GT(now, ts->cong.bbr.min_rtt_stamp +
+                        ci_tcp_time_ms2ticks(ni, CI_TCP_BBR_MIN_RTT_WIN_MS));
+
+  if( rtt >= 0 ) {
+    ci_uint32 rtt_us = ci_tcp_cong_ticks2us(ni, CI_MAX(rtt, 1));
+    if( rtt_us <= ts->cong.bbr.min_rtt_us || expired ) {
+      ts->cong.bbr.min_rtt_us = rtt_us;
+      ts->cong.bbr.min_rtt_stamp = now;
+    }
+  }
+
+  if( expired && ts->cong.bbr.mode != CI_TCP_BBR_MODE_PROBE_RTT ) {
+    /* Drain the queue so that we can see the path's real RTT. */
+    LOG_TC(log(LNT_FMT "BBR => PROBE_RTT", LNT_PRI_ARGS(ni, ts)));
+    ts->cong.bbr.mode = CI_TCP_BBR_MODE_PROBE_RTT;
+    ts->cong.bbr.prior_cwnd = CI_MAX(ts->cong.bbr.prior_cwnd, ts->cwnd);
+    ts->cong.bbr.mode_us = 0;
+  }
+}
+
+
+static void ci_tcp_bbr_update_mode(ci_netif* ni, ci_tcp_state* ts,
+                                   ci_uint32 now_us)
+{
+  ci_uint32 bdp = ci_tcp_bbr_bdp(ts, CI_TCP_BBR_UNIT);
+  ci_uint32 inflight = ci_tcp_inflight(ts);
+
+  switch( ts->cong.bbr.mode ) {
+  case CI_TCP_BBR_MODE_STARTUP:
+    if( ! ci_tcp_bbr_full_bw_reached(ts) )
+      break;
+    ts->cong.bbr.mode = CI_TCP_BBR_MODE_DRAIN;
+    /* fall through */
+  case CI_TCP_BBR_MODE_DRAIN:
+    if( inflight > bdp )
+      break;
+    ts->cong.bbr.mode = CI_TCP_BBR_MODE_PROBE_BW;
+    /* Start in one of the cruising phases so that flows sharing a
+     * bottleneck do not probe in lock-step. */
+    ts->cong.bbr.cycle_idx = 2 + (now_us >> 4u) % (CI_TCP_BBR_CYCLE_LEN - 2);
+    ts->cong.bbr.mode_us = now_us;
+    break;
+  case CI_TCP_BBR_MODE_PROBE_BW: {
+    ci_uint32 gain = ci_tcp_bbr_cycle_gain[ts->cong.bbr.cycle_idx];
+    int advance = now_us - ts->cong.bbr.mode_us > ts->cong.bbr.min_rtt_us;
+    /* Probe until inflight reaches the probing level; drain until the
+     * queue created by probing has gone. */
+    if( gain > CI_TCP_BBR_UNIT )
+      advance = advance && inflight >= ci_tcp_bbr_bdp(ts, gain);
+    else if( gain < CI_TCP_BBR_UNIT )
+      advance = advance || inflight <= bdp;
+    if( advance ) {
+      ts->cong.bbr.cycle_idx = (ts->cong.bbr.cycle_idx + 1) %
+                               CI_TCP_BBR_CYCLE_LEN;
+      ts->cong.bbr.mode_us = now_us;
+    }
+    break;
+  }
+  case CI_TCP_BBR_MODE_PROBE_RTT:
+    if( ts->cong.bbr.mode_us == 0 ) {
+      if( inflight <= tcp_eff_mss(ts) * CI_TCP_BBR_MIN_CWND_SEGS )
+        ts->cong.bbr.mode_us = now_us | 1u;
+    }
+    else if( now_us - ts->cong.bbr.mode_us >= CI_TCP_BBR_PROBE_RTT_US ) {
+      ts->cong.bbr.min_rtt_stamp = ci_tcp_time_now(ni);
+      ts->cwnd = CI_MAX(ts->cwnd, ts->cong.bbr.prior_cwnd);
+      ts->cong.bbr.prior_cwnd = 0;
+      if( ci_tcp_bbr_full_bw_reached(ts) ) {
+        ts->cong.bbr.mode = CI_TCP_BBR_MODE_PROBE_BW;
+        ts->cong.bbr.cycle_idx = 2;
+        ts->cong.bbr.mode_us = now_us;
+      }
+      else {
+        ts->cong.bbr.mode = CI_TCP_BBR_MODE_STARTUP;
+      }
+    }
+    break;
+  }
+}
+
+
+static void ci_tcp_bbr_cong_avoid(ci_netif* ni, ci_tcp_state* ts,
+                                  unsigned acked, int rtt)
+{
+  ci_uint32 now_us = ci_tcp_cong_now_us(ni);
+  ci_uint32 min_cwnd = tcp_eff_mss(ts) * CI_TCP_BBR_MIN_CWND_SEGS;
+  ci_uint32 target;
+
+  /* BBR does not use byte counting. */
+  ts->bytes_acked = 0;
+
+  ci_tcp_bbr_update_bw(ts, tcp_snd_una(ts) + acked, now_us);
+  ci_tcp_bbr_update_min_rtt(ni, ts, rtt, now_us);
+  ci_tcp_bbr_update_mode(ni, ts, now_us);
+
+  if( ts->cong.bbr.mode == CI_TCP_BBR_MODE_PROBE_RTT ) {
+    ts->cwnd = CI_MIN(ts->cwnd, min_cwnd);
+    return;
+  }
+
+  target = ci_tcp_bbr_bdp(ts, ts->cong.bbr.mode == CI_TCP_BBR_MODE_PROBE_BW ?
+                              CI_TCP_BBR_CWND_GAIN : CI_TCP_BBR_HIGH_GAIN);
+  if( target != 0 ) {
+    /* Allow for delayed and stretched ACKs. */
+    target += 3 * tcp_eff_mss(ts);
+    target = CI_MAX(target, min_cwnd);
+  }
+
+  if( ci_tcp_bbr_full_bw_reached(ts) )
+    ts->cwnd = CI_MIN(ts->cwnd + acked, target);
+  else if( target == 0 || ts->cwnd < target )
+    ts->cwnd += acked;
+  ts->cwnd = CI_MAX(ts->cwnd, min_cwnd);
+}
+
+
+static unsigned ci_tcp_bbr_ssthresh(ci_netif* ni, ci_tcp_state* ts)
+{
+  /* BBR does not react to loss by reducing its model, but remembers cwnd
+   * so that it can be restored when recovery completes.  During recovery
+   * the window is held at the data in flight (packet conservation). */
+  if( (ts->congstate == CI_TCP_CONG_OPEN ||
+       ts->congstate == CI_TCP_CONG_NOTIFIED) &&
+      ts->cong.bbr.mode != CI_TCP_BBR_MODE_PROBE_RTT )
+    ts->cong.bbr.prior_cwnd = ts->cwnd;
+  else
+    ts->cong.bbr.prior_cwnd = CI_MAX(ts->cong.bbr.prior_cwnd, ts->cwnd);
+  return CI_MAX(ci_tcp_inflight(ts), (unsigned) tcp_eff_mss(ts) << 1u);
+}
+
+
+static void ci_tcp_bbr_recovered(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ts->cong.bbr.mode != CI_TCP_BBR_MODE_PROBE_RTT ) {
+    ts->cwnd = CI_MAX(ts->cwnd, ts->cong.bbr.prior_cwnd);
+    ts->cong.bbr.prior_cwnd = 0;
+  }
+}
+
+
+static ci_uint32 ci_tcp_bbr_pacing_rate(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_uint64 rate = (ci_uint64) ts->cong.bbr.max_bw *
+                   ci_tcp_bbr_pacing_gain(ts) / CI_TCP_BBR_UNIT;
+  rate = rate * ci_tcp_cong_us_per_sec(ni) / 1000u;
+  return (ci_uint32) CI_MIN(rate, 0xffffffffu);
+}
+
+
+static void ci_tcp_bbr_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                            oo_dump_log_fn_t logger, void* log_arg)
+{
+  logger(log_arg, "%s  bbr: %s bw=%uB/ms min_rtt=%uus bdp=%u gain=%u/%u "
+         "cycle=%u full_bw=%u(%u) prior_cwnd=%u", pf,
+         ci_tcp_bbr_mode_str[ts->cong.bbr.mode], ts->cong.bbr.max_bw,
+         ts->cong.bbr.min_rtt_us, ci_tcp_bbr_bdp(ts, CI_TCP_BBR_UNIT),
+         ci_tcp_bbr_pacing_gain(ts), CI_TCP_BBR_UNIT,
+         ts->cong.bbr.cycle_idx, ts->cong.bbr.full_bw,
+         ts->cong.bbr.full_bw_cnt, ts->cong.bbr.prior_cwnd);
+}
+
+
+/**********************************************************************/
+
+static const ci_tcp_cong_ops ci_tcp_cong_ops_table[EF_TCP_CONG_ALGO_NUM] = {
+  [EF_TCP_CONG_ALGO_RENO] = {
+    .name       = "reno",
+    .cong_avoid = ci_tcp_reno_cong_avoid,
+    .ssthresh   = ci_tcp_reno_ssthresh,
+  },
+  [EF_TCP_CONG_ALGO_CUBIC] = {
+    .name       = "cubic",
+    .init       = ci_tcp_cubic_init,
+    .cong_avoid = ci_tcp_cubic_cong_avoid,
+    .hold_in_recovery = 1,
+    .ssthresh   = ci_tcp_cubic_ssthresh,
+    .dump       = ci_tcp_cubic_dump,
+  },
+  [EF_TCP_CONG_ALGO_BBR] = {
+    .name       = "bbr",
+    .init       = ci_tcp_bbr_init,
+    .cong_avoid = ci_tcp_bbr_cong_avoid,
+    .hold_in_recovery = 1,
+    .ssthresh   = ci_tcp_bbr_ssthresh,
+    .recovered  = ci_tcp_bbr_recovered,
+    .pacing_rate = ci_tcp_bbr_pacing_rate,
+    .dump       = ci_tcp_bbr_dump,
+  },
+};
+
+
+ci_inline const ci_tcp_cong_ops* ci_tcp_cong_ops_get(ci_tcp_state* ts)
+{
+  ci_assert_lt(ts->c.cong_alg, EF_TCP_CONG_ALGO_NUM);
+  return &ci_tcp_cong_ops_table[ts->c.cong_alg];
+}
+
+
+const char* ci_tcp_cong_alg_name(unsigned alg)
+{
+  if( alg >= EF_TCP_CONG_ALGO_NUM )
+    return "?";
+  return ci_tcp_cong_ops_table[alg].name;
+}
+
+
+int ci_tcp_cong_alg_from_name(const char* name, int len)
+{
+  int i;
+  /* Be lenient about NUL termination, as Linux is. */
+  for( i = 0; i < EF_TCP_CONG_ALGO_NUM; ++i ) {
+    const char* n = ci_tcp_cong_ops_table[i].name;
+    int n_len = strlen(n);
+    if( len >= n_len && ! strncmp(name, n, n_len) &&
+        (len == n_len || name[n_len] == '\0') )
+      return i;
+  }
+  return -ENOENT;
+}
+
+
+void ci_tcp_cong_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  const ci_tcp_cong_ops* ops = ci_tcp_cong_ops_get(ts);
+  if( ops->init != NULL )
+    ops->init(ni, ts);
+}
+
+
+void ci_tcp_cong_set_alg(ci_netif* ni, ci_tcp_state* ts, unsigned alg)
+{
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_lt(alg, EF_TCP_CONG_ALGO_NUM);
+
+  if( ts->c.cong_alg == alg )
+    return;
+  ts->c.cong_alg = alg;
+  /* Connected sockets carry on from their current window, but the new
+   * algorithm's model starts from scratch. */
+  if( ts->s.b.state & CI_TCP_STATE_TCP_CONN )
+    ci_tcp_cong_init(ni, ts);
+}
+
+
+/* Called for each ACK of new data, before snd_una is advanced.  cwnd is
+ * held while congestion has been notified and, for algorithms that ask,
+ * during fast recovery and COOLING, where ci_tcp_try_cwndrecover() owns it.
+ * After an RTO it grows again from one segment, as RFC5681 requires.
+ */
+void ci_tcp_cong_avoid(ci_netif* ni, ci_tcp_state* ts, unsigned acked,
+                       int rtt)
+{
+  const ci_tcp_cong_ops* ops = ci_tcp_cong_ops_get(ts);
+
+#if CI_CFG_CONG_AVOID_NOTIFIED
+  /* If congestion has been notified (but no loss detected yet)
+     hold cwnd until the notified data has been acked */
+  if( ts->congstate == CI_TCP_CONG_NOTIFIED ) {
+    if( SEQ_LE(tcp_snd_una(ts), ts->congrecover) )
+      ts->congstate = CI_TCP_CONG_OPEN;
+    return;
+  }
+#endif
+  if( ops->hold_in_recovery &&
+      (ts->congstate & (CI_TCP_CONG_FAST_RECOV | CI_TCP_CONG_COOLING)) )
+    return;
+
+  ts->bytes_acked += acked;
+  ops->cong_avoid(ni, ts, acked, rtt);
+
+  LOG_TV(log(LPF "%d OPENCWND: end cwnd=%u", S_FMT(ts), ts->cwnd));
+
+  ci_assert_le(tcp_eff_mss(ts), CI_MAX_ETH_FRAME_LEN);
+  ci_assert_ge(ts->cwnd, tcp_eff_mss(ts));
+  ci_assert_ge(ts->ssthresh, (ci_uint32)(tcp_eff_mss(ts) << 1));
+}
+
+
+unsigned ci_tcp_cong_ssthresh(ci_netif* ni, ci_tcp_state* ts)
+{
+  return ci_tcp_cong_ops_get(ts)->ssthresh(ni, ts);
+}
+
+
+/* The retransmit timer has fired.  Sets ssthresh as RFC5681 section 3.1
+ * asks, and takes cwnd back to one segment so that ci_tcp_cong_avoid()
+ * slow-starts from there.
+ */
+void ci_tcp_cong_rto(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ts->congstate & CI_TCP_CONG_RTO ){
+    /* RTO after a retransmission based on an RTO.
+    **
+    ** Ambiguous what to do here, but 2*SMSS is sensible: See:
+    ** http://www.postel.org/pipermail/end2end-interest/2003-July/003244.html
+    **
+    ** (NB. ctk had 003374.html here, but it doesn't exist!  The one I've
+    ** replaced it with looks right).
+    */
+    ts->ssthresh = tcp_eff_mss(ts) << 1u;
+  }
+  else {
+    /* Set cwnd to 1SMSS and ssthresh to half flightsize.  But careful as
+    ** NewReno fast-recovery will have an inflated flightsize.
+    */
+    if( ts->congstate == CI_TCP_CONG_FAST_RECOV &&
+	!(ts->tcpflags & CI_TCPT_FLAG_SACK) ) {
+      unsigned x = ts->ssthresh >> 1u;
+      unsigned y = tcp_eff_mss(ts) << 1u;
+      ts->ssthresh = CI_MAX(x, y);
+    }
+    else
+      ts->ssthresh = ci_tcp_cong_ssthresh(ni, ts);
+
+    ts->congstate = CI_TCP_CONG_RTO;
+    ts->cwnd_extra = 0;
+    ++ts->stats.rtos;
+  }
+
+  /* Reset congestion window to one segment (RFC2581 p5). */
+  ts->cwnd = CI_MAX(tcp_eff_mss(ts), NI_OPTS(ni).loss_min_cwnd);
+  ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).min_cwnd);
+  ts->bytes_acked = 0;
+}
+
+
+void ci_tcp_cong_recovered(ci_netif* ni, ci_tcp_state* ts)
+{
+  const ci_tcp_cong_ops* ops = ci_tcp_cong_ops_get(ts);
+  if( ops->recovered != NULL )
+    ops->recovered(ni, ts);
+}
+
+
+/* Rate at which to pace [ts], in bytes per second, or zero if it should
+ * not be paced.  Unless the algorithm has a better idea this is cwnd/srtt,
+ * scaled up (as in Linux) so that pacing does not hold back window growth:
+ * by 2 in slow start and by 1.2 otherwise.  srtt is only known to the
+ * nearest timer tick, so connections with a shorter RTT are not paced.
+ */
+ci_uint32 ci_tcp_cong_pacing_rate(ci_netif* ni, ci_tcp_state* ts)
+{
+  const ci_tcp_cong_ops* ops = ci_tcp_cong_ops_get(ts);
+  ci_uint32 srtt_us;
+  ci_uint64 rate;
+
+  if( ops->pacing_rate != NULL && (rate = ops->pacing_rate(ni, ts)) != 0 )
+    return rate;
+
+  srtt_us = ci_tcp_cong_ticks2us(ni, tcp_srtt(ts));
+  if( srtt_us == 0 )
+    return 0;
+  rate = (ci_uint64) ts->cwnd * ci_tcp_cong_us_per_sec(ni) / srtt_us;
+  if( ts->cwnd < ts->ssthresh )
+    rate *= 2;
+  else
+    rate = rate * 6 / 5;
+  return (ci_uint32) CI_MIN(rate, 0xffffffffu);
+}
+
+
+void ci_tcp_cong_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                      oo_dump_log_fn_t logger, void* log_arg)
+{
+  const ci_tcp_cong_ops* ops = ci_tcp_cong_ops_get(ts);
+  if( ops->dump != NULL )
+    ops->dump(ni, ts, pf, logger, log_arg);
+}
+
+/*! \cidoxg_end */
@@ -1619,6 +1619,7 @@ int ci_tcp_listen_init(ci_netif *ni, ci_tcp_socket_listen *tls)
   tls->acceptq_n_in = tls->acceptq_n_out = 0;
   tls->acceptq_put = CI_ILL_END;
   tls->acceptq_get = OO_SP_NULL;
+  ci_tcp_acceptq_ring_init(tls);
   tls->n_listenq = 0;
   tls->n_listenq_new = 0;
 
@@ -2155,6 +2156,9 @@ int ci_tcp_listen(citp_socket* ep, ci_fd_t fd, int backlog)
     }
   } 
 
+  /* A pacing limit set before listen() stays with the OS socket. */
+  if( OO_PP_NOT_NULL(ts->pacing) )
+    ci_tcp_pacing_free(netif, ts);
   ci_tcp_set_slow_state(netif, ts, CI_TCP_LISTEN);
   tls = SOCK_TO_TCP_LISTEN(&ts->s);
 
@@ -412,6 +412,7 @@ void ci_tcp_state_assert_valid(ci_netif* netif, ci_tcp_state* ts,
   chk(delack_tid);
   chk(zwin_tid);
   chk(kalive_tid);
+  chk(timers_tid);
 # undef chk
 
   verify(SEQ_LE(tcp_snd_una(ts), tcp_snd_nxt(ts)));
@@ -677,9 +678,21 @@ void ci_tcp_socket_listen_dump(ci_netif* ni, ci_tcp_socket_listen* tls,
   logger(log_arg, "%s  listenq: max=%d n=%d new=%d buckets=%d", pf, 
          ci_tcp_listenq_max(ni), tls->n_listenq, tls->n_listenq_new,
          tls->n_buckets);
-  logger(log_arg, "%s  acceptq: max=%d n=%d accepted=%d", pf,
-         tls->acceptq_max, ci_tcp_acceptq_n(tls), tls->acceptq_n_out);
-  logger(log_arg, "%s  defer_accept=%d", pf, tls->c.tcp_defer_accept);
+  logger(log_arg, "%s  acceptq: max=%d n=%d accepted=%d ring=%d/%d", pf,
+         tls->acceptq_max, ci_tcp_acceptq_n(tls),
+         tls->acceptq_n_out + tls->acceptq_ring_deq,
+         tls->acceptq_ring_enq - tls->acceptq_ring_deq,
+         CI_CFG_TCP_ACCEPT_RING_SIZE);
+  {
+    char buf[CI_CFG_TCP_ACCEPT_SHARDS * 12];
+    int i, n = 0;
+    for( i = 0; i < CI_CFG_TCP_ACCEPT_SHARDS; ++i )
+      n += ci_snprintf(buf + n, sizeof(buf) - n, " %u",
+                       tls->accept_shard_n[i]);
+    logger(log_arg, "%s  accepts per thread:%s", pf, buf);
+  }
+  logger(log_arg, "%s  defer_accept=%d cc=%s", pf, tls->c.tcp_defer_accept,
+         ci_tcp_cong_alg_name(tls->c.cong_alg));
 #if CI_CFG_FD_CACHING
   logger(log_arg, "%s  sockcache: n=%d sock_n=%d cache=%s pending=%s connected=%s",
          pf, ni->state->passive_cache_avail_stack, tls->cache_avail_sock,
@@ -774,21 +787,28 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
          SEQ_SUB(ts->snd_max, tcp_snd_nxt(ts)));
   if( ts->snd_delegated != 0 )
     logger(log_arg, "%s  snd delegated=%d", pf, ts->snd_delegated);
-  logger(log_arg, "%s  snd: cwnd=%d+%d used=%d ssthresh=%d bytes_acked=%d %s",
-         pf, ts->cwnd, ts->cwnd_extra, tcp_cwnd_used(ts),
-         ts->ssthresh, ts->bytes_acked, congstate_str(ts));
+  logger(log_arg, "%s  snd: cwnd=%d+%d used=%d ssthresh=%d bytes_acked=%d %s "
+         "cc=%s", pf, ts->cwnd, ts->cwnd_extra, tcp_cwnd_used(ts),
+         ts->ssthresh, ts->bytes_acked, congstate_str(ts),
+         ci_tcp_cong_alg_name(ts->c.cong_alg));
+  ci_tcp_cong_dump(ni, ts, pf, logger, log_arg);
   logger(log_arg, "%s  snd: timed_seq %x timed_ts %x",
          pf, ts->timed_seq, ts->timed_ts);
   logger(log_arg, "%s  snd: sndbuf_pkts=%d "OOF_IPCACHE_STATE" "
 	 OOF_IPCACHE_DETAIL,
 	 pf, ts->so_sndbuf_pkts, OOFA_IPCACHE_STATE(ni, &ts->s.pkt),
          OOFA_IPCACHE_DETAIL(&ts->s.pkt));
-  logger(log_arg, "%s  snd: limited rwnd=%d cwnd=%d nagle=%d more=%d app=%d",
-         pf, stats.tx_stop_rwnd, stats.tx_stop_cwnd, stats.tx_stop_nagle,
-         stats.tx_stop_more, stats.tx_stop_app);
+  logger(log_arg, "%s  snd: limited rwnd=%d cwnd=%d nagle=%d more=%d app=%d "
+         "pacing=%d", pf, stats.tx_stop_rwnd, stats.tx_stop_cwnd,
+         stats.tx_stop_nagle, stats.tx_stop_more, stats.tx_stop_app,
+         stats.tx_stop_pacing);
 #if CI_CFG_TAIL_DROP_PROBE
   if( ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_MARKED )
     logger(log_arg, "%s  snd: tail loss probe at %x", pf, ts->taildrop_mark);
+  if( ci_tcp_rack_enabled(ni, ts) )
+    logger(log_arg, "%s  snd: rack xmit_ts=%x reo_wnd=%u mult=%u persist=%u",
+           pf, ts->rack_xmit_ts, ci_tcp_rack_reo_wnd(ts), ts->rack_reo_mult,
+           ts->rack_reo_persist);
 #endif
 
   logger(log_arg, "%s  rcv: nxt-max=%08x-%08x wnd adv=%d cur=%d %s%s", pf,
@@ -850,6 +870,8 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
   fmt_timer(buf, LINE_LEN, n, delack, ts->delack_tid);
   fmt_timer(buf, LINE_LEN, n, zwin, ts->zwin_tid);
   fmt_timer(buf, LINE_LEN, n, kalive, ts->kalive_tid);
+  fmt_timer(buf, LINE_LEN, n, cork, ts->cork_tid);
+  fmt_timer(buf, LINE_LEN, n, coalesced, ts->timers_tid);
   if( OO_PP_NOT_NULL(ts->pmtus) ) {
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(ni, ts->pmtus);
     fmt_timer(buf, LINE_LEN, n, pmtu, pmtus->tid);
@@ -860,6 +882,16 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(ni, ts->pmtus);
     logger(log_arg, "%s  pmtu=%d: ", pf, pmtus->pmtu);
   }
+  if( OO_PP_NOT_NULL(ts->rx_region) ) {
+    ci_tcp_rx_region* rr = ci_ni_aux_p2rx_region(ni, ts->rx_region);
+    logger(log_arg, "%s  rx_region: pid=%d size=%u added=%u consumed=%u",
+           pf, rr->pid, rr->size, rr->added, rr->consumed);
+  }
+  if( OO_PP_NOT_NULL(ts->pacing) ) {
+    ci_tcp_pacing_state* ps = ci_ni_aux_p2pacing(ni, ts->pacing);
+    logger(log_arg, "%s  snd: pacing max_rate=%u rate=%u next_us=%u held=%d",
+           pf, ps->max_rate, ps->rate, ps->next_us, ps->held);
+  }
 }
 
 
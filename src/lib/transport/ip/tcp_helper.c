@@ -27,10 +27,11 @@
 #define VERB(x)
 
 
-int ci_tcp_helper_more_bufs(ci_netif* ni)
+int ci_tcp_helper_more_bufs(ci_netif* ni, int numa_node)
 {
+  ci_int32 node = numa_node;
   return oo_resource_op(ci_netif_get_driver_handle(ni),
-                        OO_IOC_TCP_MORE_BUFS, NULL);
+                        OO_IOC_TCP_MORE_BUFS, &node);
 }
 
 int ci_tcp_helper_more_socks(ci_netif* ni)
@@ -43,8 +43,17 @@ static void ci_tcp_state_setup_timers(ci_netif* ni, ci_tcp_state* ts)
   ci_tcp_setup_timer(stats,    CI_IP_TIMER_TCP_STATS,  "stat");
 #endif
   ci_tcp_setup_timer(cork,     CI_IP_TIMER_TCP_CORK,   "cork");
+  ci_tcp_setup_timer(timers,   CI_IP_TIMER_TCP_COALESCED, "coal");
 
 #undef ci_tcp_setup_timer
+
+  if( NI_OPTS(ni).tcp_timer_coalesce ) {
+    ts->rto_tid.flags = CI_IP_TIMER_FLAG_COALESCED;
+    ts->delack_tid.flags = CI_IP_TIMER_FLAG_COALESCED;
+    ts->zwin_tid.flags = CI_IP_TIMER_FLAG_COALESCED;
+    ts->kalive_tid.flags = CI_IP_TIMER_FLAG_COALESCED;
+    ts->cork_tid.flags = CI_IP_TIMER_FLAG_COALESCED;
+  }
 }
 
 
@@ -106,6 +115,8 @@ static void ci_tcp_state_tcb_init_fixed(ci_netif* netif, ci_tcp_state* ts,
                        CI_IP_DFLT_TTL, CI_IP_DFLT_TOS);
 
   ts->pmtus = OO_PP_NULL;
+  ts->rx_region = OO_PP_NULL;
+  ts->pacing = OO_PP_NULL;
 
   ts->s.laddr = ip4_addr_any;
   TS_IPX_TCP(ts)->tcp_source_be16 = 0;
@@ -159,6 +170,11 @@ void ci_tcp_state_tcb_reinit_minimal(ci_netif* netif, ci_tcp_state* ts)
   ts->sa = 0; /* set to zero to provoke initialisation in ci_tcp_update_rtt */
   ts->sv = NI_CONF(netif).tconst_rto_initial; /* cwndrecover b4 rtt measured */
 
+  /* RACK */
+  ts->rack_xmit_ts = ci_tcp_time_now(netif);
+  ts->rack_reo_mult = 1;
+  ts->rack_reo_persist = 0;
+
   ts->local_peer = OO_SP_NULL;
 }
 
@@ -237,6 +253,8 @@ static void ci_tcp_state_tcb_reinit(ci_netif* netif, ci_tcp_state* ts,
 
   /* TCP_MAXSEG */
   ts->c.user_mss = 0;
+  /* TCP_CONGESTION */
+  ts->c.cong_alg = NI_OPTS(netif).tcp_cong_alg;
   ts->amss = 0;
   ts->eff_mss = 0;
 
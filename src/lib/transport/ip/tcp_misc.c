@@ -189,6 +189,7 @@ void ci_tcp_state_verify_no_timers(ci_netif *ni, ci_tcp_state *ts)
   chk(zwin_tid);
   chk(kalive_tid);
   chk(cork_tid);
+  chk(timers_tid);
 #if CI_CFG_TCP_SOCK_STATS
   chk(stats_tid);
 #endif
@@ -216,6 +217,11 @@ static void __ci_tcp_state_free(ci_netif *ni, ci_tcp_state *ts)
   ci_tcp_tmpl_free_all(ni, ts);
 #endif
 
+  if( OO_PP_NOT_NULL(ts->rx_region) )
+    ci_tcp_rx_region_free(ni, ts);
+  if( OO_PP_NOT_NULL(ts->pacing) )
+    ci_tcp_pacing_free(ni, ts);
+
   /* Remove from any lists we're in. */
   ci_ni_dllist_remove_safe(ni, &ts->s.b.post_poll_link);
   ci_ni_dllist_remove_safe(ni, &ts->s.reap_link);
@@ -367,6 +373,11 @@ void ci_tcp_set_established_state(ci_netif* ni, ci_tcp_state* ts)
   /* dirty hack to abuse this, init for faststart */
   CITP_TCP_FASTSTART(ts->tslastack = tcp_rcv_nxt(ts));
 
+  /* A failure to allocate just leaves the connection unpaced. */
+  if( NI_OPTS(ni).tcp_pacing && OO_PP_IS_NULL(ts->pacing) &&
+      OO_SP_IS_NULL(ts->local_peer) )
+    ci_tcp_pacing_alloc(ni, ts);
+
   if( ci_tcp_can_use_fast_path(ts) )
     ci_tcp_fast_path_enable(ts);
 }
@@ -571,6 +582,7 @@ void ci_tcp_stop_timers(ci_netif* netif, ci_tcp_state* ts)
   ci_ip_timer_clear_ool(netif, &ts->zwin_tid);
   ci_ip_timer_clear_ool(netif, &ts->kalive_tid);
   ci_ip_timer_clear_ool(netif, &ts->cork_tid);
+  ci_ip_timer_clear_ool(netif, &ts->timers_tid);
   if( OO_PP_NOT_NULL(ts->pmtus) ) {
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(netif, ts->pmtus);
     ci_ip_timer_clear_ool(netif, &pmtus->tid);
@@ -1010,9 +1022,14 @@ void ci_tcp_recovered(ci_netif* ni, ci_tcp_state* ts)
 
   /* If we get here, we've recovered. */
 
+  /* RACK keeps a widened reordering window for 16 recoveries. */
+  if( ts->rack_reo_persist != 0 && --ts->rack_reo_persist == 0 )
+    ts->rack_reo_mult = 1;
+
   ts->congstate = CI_TCP_CONG_OPEN;
   ts->cwnd_extra = 0;
   ts->dup_acks = 0;
+  ci_tcp_cong_recovered(ni, ts);
 
   LOG_TL(log(LNT_FMT "RECOVERED "TCP_SND_FMT" cwnd=%d ssthresh=%d rto=%d",
              LNT_PRI_ARGS(ni, ts), TCP_SND_PRI_ARG(ts),
@@ -101,18 +101,12 @@ int ci_tcp_send_wnd_update(ci_netif* ni, ci_tcp_state* ts, int sock_locked)
 }
 
 
-/* This is called after we've pulled a certain amount of data from the
-** receive queue, and sends a window update if appropriate.
+/* Sends a window update if appropriate after data has been pulled from
+** the receive queue.  Caller must hold the stack lock.
 */
-static void ci_tcp_recvmsg_send_wnd_update(ci_netif* ni, ci_tcp_state* ts)
+static void __ci_tcp_recvmsg_send_wnd_update(ci_netif* ni, ci_tcp_state* ts)
 {
-  if( ! ci_netif_trylock(ni) ) {
-    ci_bit_set(&ts->s.s_aflags, CI_SOCK_AFLAG_NEED_ACK_BIT);
-    if( ! ci_netif_lock_or_defer_work(ni, &ts->s.b) )
-      return;
-    ci_bit_clear(&ts->s.s_aflags, CI_SOCK_AFLAG_NEED_ACK_BIT);
-  }
-
+  ci_assert(ci_netif_is_locked(ni));
   CHECK_TS(ni, ts);
 
   LOG_TR(log(LNTS_FMT "ack_trigger=%x c/w rcv_delivered=%x "
@@ -148,7 +142,22 @@ static void ci_tcp_recvmsg_send_wnd_update(ci_netif* ni, ci_tcp_state* ts)
 
  out:
   CHECK_TS(ni, ts);
+}
+
 
+/* This is called after we've pulled a certain amount of data from the
+** receive queue, and sends a window update if appropriate.
+*/
+static void ci_tcp_recvmsg_send_wnd_update(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ! ci_netif_trylock(ni) ) {
+    ci_bit_set(&ts->s.s_aflags, CI_SOCK_AFLAG_NEED_ACK_BIT);
+    if( ! ci_netif_lock_or_defer_work(ni, &ts->s.b) )
+      return;
+    ci_bit_clear(&ts->s.s_aflags, CI_SOCK_AFLAG_NEED_ACK_BIT);
+  }
+
+  __ci_tcp_recvmsg_send_wnd_update(ni, ts);
   ci_netif_unlock(ni);
 }
 
@@ -233,6 +242,7 @@ ci_tcp_recvmsg_get_nopeek(int peek_off, ci_tcp_state *ts, ci_netif *netif,
     ci_tcp_rcvbuf_drs(netif, ts);
   if( oo_offbuf_left(&(*pkt)->buf) == 0 ) {
     /* We've emptied the current packet. */
+    ci_netif_lat_rx_recv(netif, S_SP(ts), (*pkt)->tstamp_frc);
     if( CI_UNLIKELY(SEQ_LE(ts->ack_trigger, ts->rcv_delivered)) )
       ci_tcp_recvmsg_send_wnd_update(netif, ts);
     if( total == max_bytes || OO_PP_IS_NULL((*pkt)->next) )
@@ -426,10 +436,11 @@ ci_tcp_recvmsg_get(struct tcp_recv_info *rinf)
 
 #ifndef __KERNEL__
 /* Returns >0 if socket is readable.  Returns 0 if spin times-out.  Returns
- * -ve error code otherwise.
+ * -ve error code otherwise.  [sa] is the caller's adaptive spin state, or
+ * NULL to spin for the socket's full limit.
  */
 static int ci_tcp_recvmsg_spin(ci_netif* ni, ci_tcp_state* ts,
-                               ci_uint64 start_frc)
+                               struct oo_spin_adapt* sa, ci_uint64 start_frc)
 {
   ci_uint64 now_frc;
   ci_uint64 schedule_frc = start_frc;
@@ -437,6 +448,9 @@ static int ci_tcp_recvmsg_spin(ci_netif* ni, ci_tcp_state* ts,
   ci_uint64 max_spin = ts->s.b.spin_cycles;
   int rc, spin_limit_by_so = 0;
 
+  if( sa != NULL )
+    max_spin = oo_spin_adapt_budget(ni, sa, max_spin);
+
   /* Cache the next expected packet buffer to save work within the loop.
    * We need to update this after polling. If someone else polls, then this
    * pointer might no longer point to the expected packet. This might lead to
@@ -530,6 +544,8 @@ int ci_tcp_recvmsg(const ci_tcp_recvmsg_args* a)
   ci_uint64             start_frc = 0; /* suppress compiler warning */
 #ifndef __KERNEL__
   unsigned              tcp_recv_spin = 0;
+  /* EF_SPIN_ADAPTIVE: 0 off, 1 not waited yet, 2 spun, 3 blocked */
+  int                   spin_adapt = 0;
 #endif
   ci_uint32             timeout = ts->s.so.rcvtimeo_msec;
   struct tcp_recv_info  rinf;
@@ -573,6 +589,8 @@ int ci_tcp_recvmsg(const ci_tcp_recvmsg_args* a)
 #ifndef __KERNEL__
   tcp_recv_spin = 
     oo_per_thread_get()->spinstate & (1 << ONLOAD_SPIN_TCP_RECV);
+  spin_adapt = tcp_recv_spin && NI_OPTS(ni).spin_adaptive &&
+               a->spin_adapt != NULL;
 #endif
   ci_frc64(&start_frc);
 
@@ -665,7 +683,10 @@ int ci_tcp_recvmsg(const ci_tcp_recvmsg_args* a)
   if( tcp_recv_spin ) {
     int rc2;
 
-    if( (rc2 = ci_tcp_recvmsg_spin(ni, ts, start_frc)) ) {
+    if( spin_adapt )
+      spin_adapt = 2;
+    if( (rc2 = ci_tcp_recvmsg_spin(ni, ts, spin_adapt ? a->spin_adapt : NULL,
+                                   start_frc)) ) {
       if( rc2 < 0 ) {
         /* -ERESTARTSYS, -EINTR or -EAGAIN */
         CI_SET_ERROR(rinf.rc, -rc2);
@@ -675,8 +696,12 @@ int ci_tcp_recvmsg(const ci_tcp_recvmsg_args* a)
     }
 
     tcp_recv_spin = 0;
+    if( spin_adapt )
+      spin_adapt = 3;
     if( timeout ) {
-      ci_uint32 spin_ms = NI_OPTS(ni).spin_usec >> 10;
+      ci_uint32 spin_ms = spin_adapt ?
+        (ci_uint32) ((ci_frc64_get() - start_frc) / IPTIMER_STATE(ni)->khz) :
+        NI_OPTS(ni).spin_usec >> 10;
       if( spin_ms < timeout )
         timeout -= spin_ms;
       else {
@@ -878,6 +903,8 @@ int ci_tcp_recvmsg(const ci_tcp_recvmsg_args* a)
 #ifndef __KERNEL__
   ci_tcp_recv_fill_msgname(ts, (struct sockaddr*) a->msg->msg_name,
                            &a->msg->msg_namelen);  /*!\TODO fixme remove cast*/
+  if( spin_adapt >= 2 )
+    oo_spin_adapt_record(ni, a->spin_adapt, start_frc, spin_adapt == 2);
 #endif
  unlock_out:
 
@@ -1395,4 +1422,278 @@ static int ci_tcp_recvmsg_recv2(struct tcp_recv_info *rinf)
 }
 
 
+
+#ifndef __KERNEL__
+/* Copies in-order data from [recv1] into the socket's receive region, as
+ * much as the region has room for.  Urgent data in [recv2] is left for
+ * recvmsg().  Caller must hold the stack lock and the socket lock.
+ */
+static int ci_tcp_rx_region_fill(ci_netif* ni, ci_tcp_state* ts,
+                                 ci_tcp_rx_region* rr)
+{
+  char* base = CI_USER_PTR_GET(rr->base);
+  ci_uint32 space = rr->size - (rr->added - rr->consumed);
+  int max_bytes = tcp_rcv_usr(ts);
+  int n, total = 0;
+  ci_ip_pkt_fmt* pkt;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(ci_sock_is_locked(ni, &ts->s.b));
+
+  if( max_bytes <= 0 || OO_PP_IS_NULL(ts->recv1_extract) )
+    return 0;
+  if( space == 0 ) {
+    CITP_STATS_NETIF_INC(ni, tcp_rx_region_full);
+    return 0;
+  }
+
+  pkt = PKT_CHK_NNL(ni, ts->recv1_extract);
+  if( oo_offbuf_is_empty(&pkt->buf) ) {
+    if( OO_PP_IS_NULL(pkt->next) )
+      return 0;
+    ts->recv1_extract = pkt->next;
+    pkt = PKT_CHK_NNL(ni, ts->recv1_extract);
+  }
+
+  while( space > 0 ) {
+    ci_uint32 off = rr->added & (rr->size - 1);
+    PKT_TCP_RX_BUF_ASSERT_VALID(ni, pkt);
+    n = CI_MIN(oo_offbuf_left(&pkt->buf), space);
+    n = CI_MIN(n, rr->size - off);
+    memcpy(base + off, oo_offbuf_ptr(&pkt->buf), n);
+    oo_offbuf_advance(&pkt->buf, n);
+    rr->added += n;
+    space -= n;
+    total += n;
+    if( oo_offbuf_left(&pkt->buf) == 0 ) {
+      if( total == max_bytes || OO_PP_IS_NULL(pkt->next) )
+        break;
+      ts->recv1_extract = pkt->next;
+      pkt = PKT_CHK_NNL(ni, ts->recv1_extract);
+    }
+  }
+
+  ts->rcv_delivered += total;
+  if( NI_OPTS(ni).tcp_rcvbuf_mode == 1 )
+    ci_tcp_rcvbuf_drs(ni, ts);
+  CITP_STATS_NETIF_INC(ni, tcp_rx_region_fills);
+  return total;
+}
+
+
+/* Called from the poll path when new data has been queued on a socket
+ * with a receive region.  The copy is done here only if we are running in
+ * the process that registered the region and the socket is not busy;
+ * otherwise the data stays on [recv1] until the owner next calls
+ * ci_tcp_rx_region_get().  Window updates are left to the caller.
+ */
+void ci_tcp_rx_region_deliver(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_tcp_rx_region* rr = ci_ni_aux_p2rx_region(ni, ts->rx_region);
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( rr->pid != getpid() || ! ci_sock_trylock(ni, &ts->s.b) )
+    return;
+  ci_tcp_rx_region_fill(ni, ts, rr);
+  ci_sock_unlock(ni, &ts->s.b);
+}
+
+
+int ci_tcp_rx_region_register(ci_netif* ni, ci_tcp_state* ts,
+                              void* base, size_t len)
+{
+  ci_tcp_rx_region* rr;
+  int rc = 0;
+
+  if( base != NULL &&
+      (len < CI_PAGE_SIZE || len > (1u << 30) || ! CI_IS_POW2(len)) )
+    return -EINVAL;
+
+  ci_sock_lock(ni, &ts->s.b);
+  ci_netif_lock(ni);
+
+  if( ts->s.b.state == CI_TCP_LISTEN ) {
+    rc = -EINVAL;
+  }
+  else if( base == NULL ) {
+    if( OO_PP_NOT_NULL(ts->rx_region) )
+      ci_tcp_rx_region_free(ni, ts);
+  }
+  else if( OO_PP_NOT_NULL(ts->rx_region) ) {
+    rc = -EBUSY;
+  }
+  else if( OO_PP_IS_NULL(ts->rx_region =
+                         ci_ni_aux_alloc(ni, CI_TCP_AUX_TYPE_RX_REGION)) ) {
+    rc = -ENOMEM;
+  }
+  else {
+    rr = ci_ni_aux_p2rx_region(ni, ts->rx_region);
+    CI_USER_PTR_SET(rr->base, base);
+    rr->size = len;
+    rr->added = rr->consumed = 0;
+    rr->pid = getpid();
+    /* Anything already received goes into the region too, so that the
+     * region always holds a prefix of the stream. */
+    ci_tcp_rx_region_fill(ni, ts, rr);
+  }
+
+  ci_netif_unlock(ni);
+  ci_sock_unlock(ni, &ts->s.b);
+  return rc;
+}
+
+
+/* Returns the number of contiguous bytes available at [base + *offset],
+ * 0 at end of stream or a negative error code, including -EAGAIN if
+ * nothing has arrived.
+ */
+int ci_tcp_rx_region_get(ci_netif* ni, ci_tcp_state* ts, size_t* offset)
+{
+  ci_tcp_rx_region* rr;
+  ci_uint32 avail, off;
+  int rc;
+
+  ci_sock_lock(ni, &ts->s.b);
+  ci_netif_lock(ni);
+
+  if( OO_PP_IS_NULL(ts->rx_region) ) {
+    rc = -EINVAL;
+    goto out;
+  }
+  rr = ci_ni_aux_p2rx_region(ni, ts->rx_region);
+
+  if( rr->added == rr->consumed ) {
+    /* We hold the socket lock, so the poll will not fill the region
+     * itself.  Pick up its data, and anything left on [recv1] by polls
+     * in other contexts, once it is done. */
+    if( ci_netif_may_poll(ni) && ci_netif_has_event(ni) )
+      ci_netif_poll(ni);
+    if( ci_tcp_rx_region_fill(ni, ts, rr) > 0 )
+      __ci_tcp_recvmsg_send_wnd_update(ni, ts);
+  }
+
+  avail = rr->added - rr->consumed;
+  if( avail != 0 ) {
+    off = rr->consumed & (rr->size - 1);
+    *offset = off;
+    rc = CI_MIN(avail, rr->size - off);
+  }
+  else if( ts->tcpflags & CI_TCPT_FLAG_FIN_RECEIVED ) {
+    rc = 0;
+  }
+  else if( ts->s.so_error ) {
+    rc = -ci_get_so_error(&ts->s);
+  }
+  else if( TCP_RX_ERRNO(ts) ) {
+    rc = -TCP_RX_ERRNO(ts);
+  }
+  else {
+    rc = -EAGAIN;
+  }
+
+ out:
+  ci_netif_unlock(ni);
+  ci_sock_unlock(ni, &ts->s.b);
+  return rc;
+}
+
+
+/* Hands [len] bytes at the head of the region back to the stack, and
+ * refills the space from [recv1].
+ */
+int ci_tcp_rx_region_release(ci_netif* ni, ci_tcp_state* ts, size_t len)
+{
+  ci_tcp_rx_region* rr;
+  int rc = 0;
+
+  ci_sock_lock(ni, &ts->s.b);
+  ci_netif_lock(ni);
+
+  if( OO_PP_IS_NULL(ts->rx_region) ) {
+    rc = -EINVAL;
+  }
+  else {
+    rr = ci_ni_aux_p2rx_region(ni, ts->rx_region);
+    if( len > rr->added - rr->consumed ) {
+      rc = -EINVAL;
+    }
+    else {
+      rr->consumed += len;
+      if( ci_tcp_rx_region_fill(ni, ts, rr) > 0 )
+        __ci_tcp_recvmsg_send_wnd_update(ni, ts);
+    }
+  }
+
+  ci_netif_unlock(ni);
+  ci_sock_unlock(ni, &ts->s.b);
+  return rc;
+}
+
+
+#if CI_CFG_USERSPACE_PIPE
+/* Unlinks whole packets from the head of [recv1] for splicing into a pipe,
+ * up to [len] bytes and [max_pkts] packets.  The packets are converted to
+ * TX buffers with pf.pipe describing the unread payload, and appended to
+ * [pkts].  Stops at the first packet that is shared, indirect, spans more
+ * than one buffer or would exceed [len]; the caller copies the rest.
+ * Caller must hold the stack lock and the socket lock.
+ */
+int ci_tcp_splice_recv(ci_netif* ni, ci_tcp_state* ts, int len, int max_pkts,
+                       struct ci_pipe_pkt_list* pkts)
+{
+  ci_ip_pkt_queue* rxq = &ts->recv1;
+  ci_ip_pkt_fmt* pkt;
+  int n, total = 0;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(ci_sock_is_locked(ni, &ts->s.b));
+
+  if( OO_PP_NOT_NULL(ts->rx_region) || TS_QUEUE_RX(ts) != rxq ||
+      OO_PP_IS_NULL(ts->recv1_extract) )
+    return 0;
+  len = CI_MIN(len, tcp_rcv_usr(ts));
+
+  ci_tcp_rx_reap_rxq_bufs_socklocked(ni, ts);
+
+  while( total < len && pkts->count < max_pkts && OO_PP_NOT_NULL(rxq->head) ) {
+    pkt = PKT_CHK(ni, rxq->head);
+    ci_assert(OO_PP_EQ(rxq->head, ts->recv1_extract));
+    PKT_TCP_RX_BUF_ASSERT_VALID(ni, pkt);
+    n = oo_offbuf_left(&pkt->buf);
+    if( n == 0 || n > len - total || pkt->refcount != 1 ||
+        pkt->n_buffers != 1 || (pkt->flags & CI_PKT_FLAG_RX_INDIRECT) )
+      break;
+
+    ci_tcp_rx_buf_adjust(ni, ts, rxq, -1);
+    ts->recv1_extract = rxq->head = pkt->next;
+    --rxq->num;
+    ci_netif_lat_rx_recv(ni, S_SP(ts), pkt->tstamp_frc);
+
+    pkt = ci_netif_pkt_rx_to_tx(ni, pkt);
+    pkt->rx_flags = 0;
+    pkt->pf.pipe.base = (ci_uint8*) oo_offbuf_ptr(&pkt->buf) - pkt->dma_start;
+    pkt->pf.pipe.pay_len = n;
+    pkt->next = OO_PP_NULL;
+    if( pkts->tail != NULL )
+      pkts->tail->next = OO_PKT_P(pkt);
+    else
+      pkts->head = pkt;
+    pkts->tail = pkt;
+    ++pkts->count;
+    total += n;
+  }
+
+  if( total == 0 )
+    return 0;
+  ts->rcv_delivered += total;
+  if( NI_OPTS(ni).tcp_rcvbuf_mode == 1 )
+    ci_tcp_rcvbuf_drs(ni, ts);
+  if( SEQ_LE(ts->ack_trigger, ts->rcv_delivered) )
+    __ci_tcp_recvmsg_send_wnd_update(ni, ts);
+  return total;
+}
+#endif
+#endif
+
 /*! \cidoxg_end */
@@ -601,9 +601,6 @@ ci_inline void ci_tcp_tso_update(ci_netif* ni, ci_tcp_state* ts,
       ) {
       ts->tsrecent = tsval;
       ts->tspaws = ci_tcp_time_now(ni);
-#ifndef NDEBUG
-      ts->tslastseq = beg_seq; /* temporary debugging */
-#endif
   }
 }
 
@@ -634,93 +631,126 @@ ci_inline unsigned ci_tcp_paws_check(ci_netif* netif, ci_uint32 tsval,
 }
 
 
-/* function to open the congestion window following the
-** reception of an ack for new data. Implements RFC3465 (ABC)
-*/
-ci_inline void ci_tcp_opencwnd(ci_netif *ni, ci_tcp_state* ts)
+static void ci_tcp_reset_cwnd_on_loss(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->ssthresh = ci_tcp_cong_ssthresh(ni, ts);
+  ts->cwnd = ts->ssthresh + ci_tcp_base_dupack_thresh(ts) * tcp_eff_mss(ts);
+  ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).loss_min_cwnd);
+  ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).min_cwnd);
+  ci_assert(ts->cwnd >= tcp_eff_mss(ts));
+}
+
+
+static int /*bool*/ ci_tcp_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
 {
-#if CI_CFG_CONG_AVOID_NOTIFIED
-  /* If congestion has been notified (but no loss detected yet)
-     gradually scale the cwnd back */
-  if( ts->congstate == CI_TCP_CONG_NOTIFIED ){
-    if(SEQ_LE(tcp_snd_una(ts), ts->congrecover))
-      ts->congstate = CI_TCP_CONG_OPEN;
+  if( ci_ip_queue_is_empty(&ts->retrans) ) {
+    LOG_U(log(LNT_FMT "%d DUPACKs, but no data to retransmit!",
+              LNT_PRI_ARGS(ni, ts), ts->dup_acks));
+    return 0;
   }
+
+  ++ts->stats.fast_recovers;
+  ci_tcp_reset_cwnd_on_loss(ni, ts);
+  ts->tcpflags &=~ CI_TCPT_FLAG_RACK_DEFERRED;
+
+  ts->congrecover = tcp_snd_nxt(ts);
+  ci_tcp_retrans_init_ptrs(ni, ts, &ts->congrecover);
+  if(!SEQ_LE(ts->congrecover, tcp_snd_nxt(ts)))
+    LOG_U(log("About to assert on congrecover: %u, %u",
+              ts->congrecover, tcp_snd_nxt(ts)));
+  ci_assert(SEQ_LE(ts->congrecover, tcp_snd_nxt(ts)));
+
+  LOG_TL(log(LNT_FMT "%s => FastRecovery dups=%d "TCP_SND_FMT,
+             LNT_PRI_ARGS(ni, ts), congstate_str(ts), ts->dup_acks,
+             TCP_SND_PRI_ARG(ts));
+         log(LNT_FMT "  "TCP_CONG_FMT,
+             LNT_PRI_ARGS(ni, ts), TCP_CONG_PRI_ARG(ts)));
+
+  ts->congstate = CI_TCP_CONG_FAST_RECOV;
+
+  if( ts->tcpflags & CI_TCPT_FLAG_SACK )
+    ci_tcp_retrans_recover(ni, ts, 1);
   else
-#endif
-  if( ts->cwnd >= ts->ssthresh ) {
-    /* Hack - Increase less aggresively on small round trip times */
-#if CI_CFG_CONG_AVOID_SCALE_BACK
-    unsigned tmp = 0, cwnd_scaled;
-    /* tcp_srtt(ts) would relatively easy exceed 32 for a round trip time
-     * on longer links */
-    if( tcp_srtt(ts) < 32 )
-      tmp = NI_OPTS(ni).cong_avoid_scale_back >> tcp_srtt(ts);
-    cwnd_scaled = CI_MAX(1, tmp) * ts->cwnd;
-#else
-    unsigned cwnd_scaled = ts->cwnd;
-#endif
-    /* Congestion avoidance.  RFC3465 says: increase the congestion window
-    ** by one segment each RTT.  i.e. wait for bytes_acked to be > cwnd
-    ** (which takes one RTT), then reset bytes_acked by subtracting the
-    ** cwnd from it, and add one segment to cwnd.
-    */
-    LOG_TV(log(LPF "%d OPENCWND: CA eff_mss=%u bytes_acked=%u cwnd=%u",
-               S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked, ts->cwnd));
-    if( ts->bytes_acked >= cwnd_scaled ) {
-      ts->bytes_acked -= cwnd_scaled;
-      ts->cwnd += tcp_eff_mss(ts);
-    }
-  }
-  else {
-    /* Slow-start. */
-    unsigned cwnd_inc;
-    LOG_TV(log(LPF "%d OPENCWND: SS eff_mss=%u bytes_acked=%u cwnd=%u",
-               S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked, ts->cwnd));
-#if CI_CFG_CONG_AVOID_SLOW_START_MODE == 2
-    cwnd_inc = CI_MIN(ts->ssthresh - ts->cwnd, ts->bytes_acked);
-    ts->cwnd += cwnd_inc;
-    ts->bytes_acked -= cwnd_inc;
-#else
-    if( CI_CFG_CONG_AVOID_SLOW_START_MODE == 0 && ts->stats.rtos == 0 )
-      /* RFC3465 sec 2.2: May only increase cwnd by more than mss if we've
-      * never had any RTOs on this connection.
-      */
-      cwnd_inc = tcp_eff_mss(ts) * CI_CFG_CONG_AVOID_RFC3465_L_VALUE;
-    else
-      cwnd_inc = tcp_eff_mss(ts);
-    cwnd_inc = CI_MIN(cwnd_inc, ts->bytes_acked);
-    ts->cwnd += cwnd_inc;
-    ts->bytes_acked = 0;
-#endif
-  }
+    ci_tcp_retrans_one(ts, ni, PKT_CHK(ni, ts->retrans.head));
+
+  /* ?? Before or after retransmits?  Not sure. */
+  ci_tcp_clear_rtt_timing(ts);
+  /* Fast recovery => no TLP timer, force RTO */
+  ci_tcp_rto_restart(ni, ts);
 
-  LOG_TV(log(LPF "%d OPENCWND: end cwnd=%u", S_FMT(ts), ts->cwnd));
+  CI_IP_SOCK_STATS_INC_DUPACKFREC( ts );
+  if( ts->tcpflags & CI_TCPT_FLAG_SACK )
+    CI_TCP_EXT_STATS_INC_TCP_SACK_RECOVERY( ni );
+  else
+    CI_TCP_EXT_STATS_INC_TCP_RENO_RECOVERY( ni );
 
-  ci_assert_le(tcp_eff_mss(ts), CI_MAX_ETH_FRAME_LEN);
-  ci_assert_ge(ts->cwnd, tcp_eff_mss(ts));
-  ci_assert_ge(ts->ssthresh, (ci_uint32)(tcp_eff_mss(ts) << 1));
+  return 1;
 }
 
 
-static void ci_tcp_reset_cwnd_on_loss(ci_netif* ni, ci_tcp_state* ts)
+/* RACK loss detection (RFC 8985 section 6.2 step 5).  Segments are sent in
+ * sequence order, so the first hole in the retransmit queue is the oldest
+ * candidate: enter fast recovery if it is lost, and ci_tcp_retrans() will
+ * check the others.  If it is not lost yet, arm the TLP timer to fire when
+ * it will be.  Returns non-zero iff we enter fast recovery.
+ */
+int /*bool*/ ci_tcp_rack_detect_loss(ci_netif* ni, ci_tcp_state* ts)
 {
-  ts->ssthresh = ci_tcp_losswnd(ts);
-  ts->cwnd = ts->ssthresh + ci_tcp_base_dupack_thresh(ts) * tcp_eff_mss(ts);
-  ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).loss_min_cwnd);
-  ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).min_cwnd);
-  ci_assert(ts->cwnd >= tcp_eff_mss(ts));
+  ci_ip_pkt_fmt* pkt;
+  ci_iptime_t t;
+  ci_int32 wait;
+
+  ci_assert(ci_tcp_rack_enabled(ni, ts));
+
+  if( ci_ip_queue_is_empty(&ts->retrans) )
+    return 0;
+  pkt = PKT_CHK(ni, ts->retrans.head);
+  /* Nothing can be lost until something after it has been SACKed. */
+  if( (pkt->flags & CI_PKT_FLAG_RTQ_SACKED) ||
+      OO_PP_IS_NULL(pkt->pf.tcp_tx.block_end) )
+    return 0;
+
+  wait = ci_tcp_rack_wait(ni, ts, pkt, ci_tcp_rack_reo_wnd(ts));
+  if( wait == 0 ) {
+    if( ts->dup_acks < ci_tcp_base_dupack_thresh(ts) )
+      CITP_STATS_NETIF_INC(ni, tcp_rack_early_recovery);
+    return ci_tcp_enter_fast_recovery(ni, ts);
+  }
+  if( wait < 0 )
+    return 0;
+
+  if( ts->dup_acks >= ci_tcp_base_dupack_thresh(ts) &&
+      ! (ts->tcpflags & CI_TCPT_FLAG_RACK_DEFERRED) ) {
+    ts->tcpflags |= CI_TCPT_FLAG_RACK_DEFERRED;
+    CITP_STATS_NETIF_INC(ni, tcp_rack_deferred);
+  }
+
+  /* The reordering timer shares the TLP timer: when it fires we look for
+   * loss before sending a probe, if probes are enabled at all.
+   */
+  t = ci_tcp_time_now(ni) + wait;
+  if( ts->congstate == CI_TCP_CONG_OPEN &&
+      (! ci_ip_timer_pending(ni, &ts->rto_tid) ||
+       TIME_LT(t, ts->rto_tid.time)) ) {
+    ts->tcpflags |= CI_TCPT_FLAG_TAIL_DROP_TIMING;
+    ci_ip_timer_modify(ni, &ts->rto_tid, t);
+  }
+  return 0;
 }
 
 
-/* Enters fast recovery if we've received enough dupacks.  Returns non-zero
- * iff we enter fast recovery. */
+/* Enters fast recovery if we've received enough dupacks, or if RACK is
+ * enabled and says a segment is lost.  Returns non-zero iff we enter fast
+ * recovery. */
 int /*bool*/ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
 {
   ci_uint32 dup_thresh = ci_tcp_base_dupack_thresh(ts);
   ci_ip_pkt_fmt *pkt;
 
-  if( ts->dup_acks == 0 ) {
+  if( ci_tcp_rack_enabled(ni, ts) ) {
+    return ci_tcp_rack_detect_loss(ni, ts);
+  }
+  else if( ts->dup_acks == 0 ) {
     return 0;
   }
   else if( ts->dup_acks >= dup_thresh ) {
@@ -764,47 +794,7 @@ int /*bool*/ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
     return 0;
   }
 
-  if( ci_ip_queue_is_empty(&ts->retrans) ) {
-    LOG_U(log(LNT_FMT "%d DUPACKs, but no data to retransmit!",
-              LNT_PRI_ARGS(ni, ts), ts->dup_acks));
-    return 0;
-  }
-
-  ++ts->stats.fast_recovers;
-  ci_tcp_reset_cwnd_on_loss(ni, ts);
-
-  ts->congrecover = tcp_snd_nxt(ts);
-  ci_tcp_retrans_init_ptrs(ni, ts, &ts->congrecover);
-  if(!SEQ_LE(ts->congrecover, tcp_snd_nxt(ts)))
-    LOG_U(log("About to assert on congrecover: %u, %u",
-              ts->congrecover, tcp_snd_nxt(ts)));
-  ci_assert(SEQ_LE(ts->congrecover, tcp_snd_nxt(ts)));
-
-  LOG_TL(log(LNT_FMT "%s => FastRecovery dups=%d "TCP_SND_FMT,
-             LNT_PRI_ARGS(ni, ts), congstate_str(ts), ts->dup_acks,
-             TCP_SND_PRI_ARG(ts));
-         log(LNT_FMT "  "TCP_CONG_FMT,
-             LNT_PRI_ARGS(ni, ts), TCP_CONG_PRI_ARG(ts)));
-
-  ts->congstate = CI_TCP_CONG_FAST_RECOV;
-
-  if( ts->tcpflags & CI_TCPT_FLAG_SACK )
-    ci_tcp_retrans_recover(ni, ts, 1);
-  else
-    ci_tcp_retrans_one(ts, ni, PKT_CHK(ni, ts->retrans.head));
-
-  /* ?? Before or after retransmits?  Not sure. */
-  ci_tcp_clear_rtt_timing(ts);
-  /* Fast recovery => no TLP timer, force RTO */
-  ci_tcp_rto_restart(ni, ts);
-
-  CI_IP_SOCK_STATS_INC_DUPACKFREC( ts );
-  if( ts->tcpflags & CI_TCPT_FLAG_SACK )
-    CI_TCP_EXT_STATS_INC_TCP_SACK_RECOVERY( ni );
-  else
-    CI_TCP_EXT_STATS_INC_TCP_RENO_RECOVERY( ni );
-
-  return 1;
+  return ci_tcp_enter_fast_recovery(ni, ts);
 }
 
 
@@ -964,11 +954,41 @@ static void ci_tcp_try_cwndrecover(ci_tcp_state* ts, ci_netif* netif,
 }
 
 
+/* RACK: note that [pkt] has been delivered (RFC 8985 section 6.2 steps 1
+ * and 2).  Called before [pkt] is marked as SACKed or freed.
+ */
+static void ci_tcp_rack_update(ci_netif* ni, ci_tcp_state* ts,
+                               const ci_ip_pkt_fmt* pkt,
+                               const ciip_tcp_rx_pkt* rxp)
+{
+  if( pkt->flags & CI_PKT_FLAG_RTQ_RETRANS ) {
+    /* We can't tell which transmission was delivered unless the timestamp
+     * echo shows it was the retransmission. */
+    if( ! (ts->tcpflags & rxp->flags & CI_TCPT_FLAG_TSO) ||
+        TIME_LT(rxp->timestamp_echo, pkt->pf.tcp_tx.tx_time) )
+      return;
+  }
+  else if( OO_PP_NOT_NULL(pkt->pf.tcp_tx.block_end) ) {
+    /* A later segment was SACKed first, and we didn't retransmit this one:
+     * the network reordered them. */
+    ts->tcpflags |= CI_TCPT_FLAG_RACK_REORDER;
+    if( ts->tcpflags & CI_TCPT_FLAG_RACK_DEFERRED ) {
+      ts->tcpflags &=~ CI_TCPT_FLAG_RACK_DEFERRED;
+      CITP_STATS_NETIF_INC(ni, tcp_rack_spurious_avoided);
+    }
+  }
+
+  if( TIME_GT(pkt->pf.tcp_tx.tx_time, ts->rack_xmit_ts) )
+    ts->rack_xmit_ts = pkt->pf.tcp_tx.tx_time;
+}
+
+
 /* Marks packets in the retransmit queue as having been SACKed.  Returns non-
  * zero if and only if the block allowed us to mark an entire packet, not
  * previously SACKed, as having now been SACKed. */
 static int /*bool*/
-ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
+ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts,
+                             const ciip_tcp_rx_pkt* rxp, unsigned start,
                              unsigned end)
 {
   ci_ip_pkt_queue* rtq = &ts->retrans;
@@ -980,6 +1000,7 @@ ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
   ci_ip_pkt_fmt* end_pkt;
   ci_ip_pkt_fmt* pkt;
   oo_pkt_p next_pp;
+  int rack;
 
   /* ?? TODO:
   **
@@ -1135,13 +1156,15 @@ ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
     pkt = start_block;
   else
     pkt = start_pkt;
-  while( pkt != end_pkt ) {
+  rack = ci_tcp_rack_enabled(ni, ts);
+  while( 1 ) {
+    if( rack && ! (pkt->flags & CI_PKT_FLAG_RTQ_SACKED) )
+      ci_tcp_rack_update(ni, ts, pkt, rxp);
     pkt->pf.tcp_tx.block_end = next_pp;
     pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+    if( pkt == end_pkt )  break;
     pkt = PKT_CHK(ni, pkt->next);
   }
-  pkt->pf.tcp_tx.block_end = next_pp;
-  pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
 
   /* We took early exits from this function when this SACK block was contained
    * within an earlier one, so we know that we have recorded new SACK
@@ -1190,6 +1213,18 @@ ci_inline int ci_tcp_rx_dsack_check(ci_netif* ni, ci_tcp_state* ts,
     CITP_STATS_NETIF(++ni->state->stats.tail_drop_probe_unnecessary);
     ts->tcpflags &=~ CI_TCPT_FLAG_TAIL_DROP_MARKED;
   }
+  else if( rc && ci_tcp_rack_enabled(ni, ts) ) {
+    /* A retransmit was spurious, so the segment was probably reordered
+     * rather than lost.  Widen the reordering window, and keep it wide
+     * for the next 16 recoveries (RFC 8985 section 6.2 step 4).
+     */
+    ts->tcpflags |= CI_TCPT_FLAG_RACK_REORDER;
+    if( ts->rack_reo_mult < 4 ) {
+      ++ts->rack_reo_mult;
+      CITP_STATS_NETIF_INC(ni, tcp_rack_reo_wnd_grow);
+    }
+    ts->rack_reo_persist = 16;
+  }
 #endif
   return rc;
 }
@@ -1201,8 +1236,8 @@ ci_inline int ci_tcp_rx_dsack_check(ci_netif* ni, ci_tcp_state* ts,
  * CI_TCP_SACKED flag only if something is really SACKed. For DSACK
  * CI_TCP_DSACK flag is used.
  */
-static void ci_tcp_rx_sack_process(ci_netif* netif, ci_tcp_state* ts,
-				   ciip_tcp_rx_pkt* rxp)
+void ci_tcp_rx_sack_process(ci_netif* netif, ci_tcp_state* ts,
+			    ciip_tcp_rx_pkt* rxp)
 {
   int i;
   unsigned start;
@@ -1254,7 +1289,7 @@ static void ci_tcp_rx_sack_process(ci_netif* netif, ci_tcp_state* ts,
     */
     if( ! (/*1*/SEQ_LE(start, rxp->ack) | /*2*/SEQ_LT(tcp_snd_nxt(ts), end) |
            /*3*/SEQ_LE(end, start)) ) {
-      if( ci_tcp_rx_sack_process_block(netif, ts, start, end) )
+      if( ci_tcp_rx_sack_process_block(netif, ts, rxp, start, end) )
         sacked = 1;
     }
     else {
@@ -1281,6 +1316,7 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
 {
   struct ci_netif_poll_state* ps = rxp->poll_state;
   ci_ip_pkt_queue* rtq = &ts->retrans;
+  int rack = ci_tcp_rack_enabled(netif, ts);
 
   ci_assert(ci_ip_queue_is_valid(netif, rtq));
   ts->retransmits=0;
@@ -1316,6 +1352,9 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
                CI_TCP_HDR_FLAGS_PRI_ARG(PKT_IPX_TCP_HDR(af, p)),
                rxp->ack, rtq->num));
 
+    if( rack && ! (p->flags & CI_PKT_FLAG_RTQ_SACKED) )
+      ci_tcp_rack_update(netif, ts, p, rxp);
+
     ci_ip_queue_dequeue(netif, rtq, p);
 
     ci_assert(p->refcount > 0);
@@ -1449,6 +1488,7 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
   if( SEQ_LT(tcp_snd_una(ts), rxp->ack) ) {
     /* New data acknowledged: do congestion control and rtt measurement. */
     unsigned acked = SEQ_SUB(rxp->ack, tcp_snd_una(ts));
+    int rtt = -1;
 
     /* If something new was acked, we should restart
      * zero window probes counter. */
@@ -1459,8 +1499,8 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
      * Following Linux implementation do not update RTT if segment does not
      * contain TSO. */
     if( ts->tcpflags & rxp->flags & CI_TCPT_FLAG_TSO ) {
-      ci_tcp_update_rtt(netif, ts,
-                        ci_tcp_time_now(netif) - rxp->timestamp_echo);
+      rtt = ci_tcp_time_now(netif) - rxp->timestamp_echo;
+      ci_tcp_update_rtt(netif, ts, rtt);
     }
     else if( SEQ_LE(tcp_snd_una(ts), ts->timed_seq) &&
              SEQ_LT(ts->timed_seq, rxp->ack) &&
@@ -1472,12 +1512,12 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
       **   (iii) timed_seq is being acked...
       **   (iv)  not congested
       */
-      ci_tcp_update_rtt(netif, ts, ci_tcp_time_now(netif) - ts->timed_ts);
+      rtt = ci_tcp_time_now(netif) - ts->timed_ts;
+      ci_tcp_update_rtt(netif, ts, rtt);
     }
 
     /* Open the congestion window. */
-    ts->bytes_acked += acked;
-    ci_tcp_opencwnd(netif, ts);
+    ci_tcp_cong_avoid(netif, ts, acked, rtt);
 
     /* New acknowledgement clears any dup_acks. */
     ts->dup_acks = 0;
@@ -1488,6 +1528,9 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
     if( ts->congstate != CI_TCP_CONG_OPEN && ts->congstate != CI_TCP_CONG_NOTIFIED)
       /* Congested: try to recover. */
       ci_tcp_try_cwndrecover(ts, netif, pkt);
+    else if( ci_tcp_rack_enabled(netif, ts) )
+      /* Unlike dupacks, time-based loss detection applies to every ACK. */
+      ci_tcp_rack_detect_loss(netif, ts);
 
     if( NI_OPTS(netif).tcp_sndbuf_mode == 2 &&
 	ci_tcp_should_expand_sndbuf(netif, ts) )
@@ -3058,9 +3101,6 @@ static int handle_syn_sent_opts(ci_netif* netif, ci_tcp_state* ts,
       ts->incoming_tcp_hdr_len += 12;
       optlen = 12;
 
-#ifndef NDEBUG
-      ts->tslastseq = rxp->seq;
-#endif
       ts->tsrecent = rxp->timestamp;
       ts->tspaws = ci_tcp_time_now(netif);
     }
@@ -3537,22 +3577,9 @@ static void explain_why_seq_unacceptable(ci_netif* netif, ci_tcp_state* ts,
 
   if( ts->tcpflags & rxp->flags & CI_TCPT_FLAG_TSO ) {
     if( ci_tcp_paws_check(netif, rxp->timestamp,
-                          ts->tspaws, ts->tsrecent) ) {
-      /* Possible PAWS failure, try and work out if it's interesting.  If
-       * this is in sequence, zero length, and the same seqno as the one
-       * that updated tsrecent, it could have been undetectably reordered.
-       */
-      if( SEQ_EQ(rxp->seq, ts->tslastack)
-          && SEQ_EQ(ts->tslastack, ts->tslastseq)
-          && SEQ_EQ(rxp->seq, pkt->pf.tcp_rx.end_seq) )
-        log("\tPAWS reordered tsval=0x%x tsrecent=0x%x "
-            "tslastack=0x%x tslastseq=0x%x", rxp->timestamp,
-            ts->tsrecent, ts->tslastack, ts->tslastseq);
-      else
-        log("\tPAWS FAILED tsval=0x%x tsrecent=0x%x "
-            "tslastack=0x%x tslastseq=0x%x", rxp->timestamp,
-            ts->tsrecent, ts->tslastack, ts->tslastseq);
-    }
+                          ts->tspaws, ts->tsrecent) )
+      log("\tPAWS FAILED tsval=0x%x tsrecent=0x%x tslastack=0x%x",
+          rxp->timestamp, ts->tsrecent, ts->tslastack);
   }
   else if( ts->tcpflags & CI_TCPT_FLAG_TSO )
     log("\tTSO missing");
@@ -4299,6 +4326,50 @@ static void handle_no_match(ci_netif* ni, ciip_tcp_rx_pkt* rxp)
 }
 
 
+/* Fast path for the segments coalesced behind [rxp->pkt] by the poll loop.
+ * The poll loop has checked that they are contiguous and that their
+ * headers match the first segment's apart from the sequence number, so
+ * they are in order and need no further ACK or window processing.
+ */
+static void ci_tcp_rx_enqueue_gro(ci_netif* ni, ci_tcp_state* ts,
+                                  ciip_tcp_rx_pkt* rxp)
+{
+  oo_pkt_p pp = *rxp->gro_next;
+  ci_uint32 window = rxp->pkt->pf.tcp_rx.window;
+  ci_ip_pkt_fmt* pkt;
+  ci_ip4_hdr* ip;
+  char* payload;
+  int paylen;
+
+  *rxp->gro_next = OO_PP_NULL;
+  do {
+    pkt = PKT_CHK(ni, pp);
+    pp = pkt->frag_next;
+    pkt->frag_next = OO_PP_NULL;
+
+    ip = oo_ip_hdr(pkt);
+    ci_assert_equal(CI_IP4_IHL(ip), sizeof(*ip));
+    ci_assert_equal(CI_BSWAP_BE32(((ci_tcp_hdr*) (ip + 1))->tcp_seq_be32),
+                    tcp_rcv_nxt(ts));
+    payload = (char*) (ip + 1) + ts->incoming_tcp_hdr_len;
+    paylen = CI_BSWAP_BE16(ip->ip_tot_len_be16) - sizeof(*ip) -
+             ts->incoming_tcp_hdr_len;
+    ci_assert_gt(paylen, 0);
+
+    pkt->pf.tcp_rx.pay_len = paylen;
+    pkt->pf.tcp_rx.end_seq = tcp_rcv_nxt(ts) + paylen;
+    pkt->pf.tcp_rx.window = window;
+    oo_offbuf_init(&pkt->buf, payload, paylen);
+
+    CI_TCP_STATS_INC_IN_SEGS(ni);
+    CI_IP_SOCK_STATS_ADD_RXBYTE(ts, paylen);
+    ++ts->stats.rx_pkts;
+    TCP_NEED_ACK(ts);
+    ci_tcp_rx_enqueue_packet(ni, ts, pkt);
+  } while( OO_PP_NOT_NULL(pp) );
+}
+
+
 int ci_tcp_rx_deliver_to_conn(ci_sock_cmn* s, void* opaque_arg)
 {
   ciip_tcp_rx_pkt* rxp = opaque_arg;
@@ -4395,6 +4466,10 @@ int ci_tcp_rx_deliver_to_conn(ci_sock_cmn* s, void* opaque_arg)
               /* we're suffering from memory pressure */
               (ni->state->mem_pressure & OO_MEM_PRESSURE_CRITICAL));
 
+  /* Segments coalesced behind this one must fit in the window too. */
+  if( rxp->gro_next != NULL )
+    not_fast |= SEQ_LT(tcp_rcv_wnd_right_edge_sent(ts), rxp->gro_end_seq);
+
   /* All DSACKs should be cleared when ACK is sent;
    * dsack_block may be != CI_ILL_UNUSED only when duplicate packet is
    * processed now.
@@ -4432,7 +4507,9 @@ int ci_tcp_rx_deliver_to_conn(ci_sock_cmn* s, void* opaque_arg)
         goto paws_fail_on_fast_path;
 #endif
       ci_tcp_tso_update(ni, ts, rxp->seq,
-                        pkt->pf.tcp_rx.end_seq, rxp->timestamp);
+                        rxp->gro_next != NULL ?
+                          rxp->gro_end_seq : pkt->pf.tcp_rx.end_seq,
+                        rxp->timestamp);
       /* When we change fast path to include segments that ack new data,
        * we'll need to enable this:
        */
@@ -4458,6 +4535,8 @@ int ci_tcp_rx_deliver_to_conn(ci_sock_cmn* s, void* opaque_arg)
     oo_offbuf_init(&pkt->buf, (char*) tcp + ts->incoming_tcp_hdr_len,
                    pkt->pf.tcp_rx.pay_len);
     ci_tcp_rx_enqueue_packet(ni, ts, pkt);
+    if( rxp->gro_next != NULL )
+      ci_tcp_rx_enqueue_gro(ni, ts, rxp);
 
     rxp->pkt = NULL;
 
@@ -4511,8 +4590,11 @@ static int ci_tcp_rx_deliver_to_listen(ci_sock_cmn* s, void* opaque_arg)
 }
 
 
-void ci_tcp_handle_rx(ci_netif* netif, struct ci_netif_poll_state* ps,
-                      ci_ip_pkt_fmt* pkt, ci_tcp_hdr* tcp, int ip_paylen)
+ci_inline void __ci_tcp_handle_rx(ci_netif* netif,
+                                  struct ci_netif_poll_state* ps,
+                                  ci_ip_pkt_fmt* pkt, ci_tcp_hdr* tcp,
+                                  int ip_paylen, oo_pkt_p* gro_next,
+                                  ci_uint32 gro_end_seq)
 {
   ci_ip4_hdr* ip4 = oo_ip_hdr(pkt);
   ciip_tcp_rx_pkt rxp;
@@ -4540,6 +4622,8 @@ void ci_tcp_handle_rx(ci_netif* netif, struct ci_netif_poll_state* ps,
   rxp.poll_state = ps;
   rxp.pkt = pkt;
   rxp.tcp = tcp;
+  rxp.gro_next = gro_next;
+  rxp.gro_end_seq = gro_end_seq;
   ci_assert_gt(pkt->pay_len, ip_paylen);
   pkt->pf.tcp_rx.pay_len = ip_paylen;
 
@@ -4689,4 +4773,42 @@ void ci_tcp_handle_rx(ci_netif* netif, struct ci_netif_poll_state* ps,
   ci_netif_pkt_release_rx_1ref(netif, pkt);
 }
 
+
+void ci_tcp_handle_rx(ci_netif* netif, struct ci_netif_poll_state* ps,
+                      ci_ip_pkt_fmt* pkt, ci_tcp_hdr* tcp, int ip_paylen)
+{
+  __ci_tcp_handle_rx(netif, ps, pkt, tcp, ip_paylen, NULL, 0);
+}
+
+
+/* Handle a train of in-order IPv4 segments of one connection that were
+ * coalesced by the poll loop (EF_TCP_RX_GRO).  [pkt] is the first segment
+ * and the others are chained from it via frag_next; [end_seq] follows the
+ * last of them.  If the first segment takes the fast path then the whole
+ * train is enqueued there, otherwise the rest are handled one at a time.
+ */
+void ci_tcp_handle_rx_gro(ci_netif* netif, struct ci_netif_poll_state* ps,
+                          ci_ip_pkt_fmt* pkt, ci_tcp_hdr* tcp, int ip_paylen,
+                          ci_uint32 end_seq)
+{
+  oo_pkt_p next = pkt->frag_next;
+  ci_ip4_hdr* ip;
+
+  ci_assert_equal(oo_pkt_af(pkt), AF_INET);
+  ci_assert(OO_PP_NOT_NULL(next));
+
+  pkt->frag_next = OO_PP_NULL;
+  __ci_tcp_handle_rx(netif, ps, pkt, tcp, ip_paylen, &next, end_seq);
+
+  while( OO_PP_NOT_NULL(next) ) {
+    pkt = PKT_CHK(netif, next);
+    next = pkt->frag_next;
+    pkt->frag_next = OO_PP_NULL;
+    CITP_STATS_NETIF_INC(netif, rx_gro_fallback_segs);
+    ip = oo_ip_hdr(pkt);
+    ci_tcp_handle_rx(netif, ps, pkt, (ci_tcp_hdr*) (ip + 1),
+                     CI_BSWAP_BE16(ip->ip_tot_len_be16) - sizeof(*ip));
+  }
+}
+
 /*! \cidoxg_end */
@@ -54,6 +54,13 @@ ci_inline void ci_tcp_rx_post_poll(ci_netif* ni, ci_tcp_state* ts)
   if( ci_tcp_sendq_not_empty(ts) )
     ci_tcp_tx_advance(ts, ni);
 
+#ifndef __KERNEL__
+  /* Do this before deciding whether to ACK, so that the ACK carries the
+   * window opened up by emptying the receive queue. */
+  if( OO_PP_NOT_NULL(ts->rx_region) && tcp_rcv_usr(ts) != 0 )
+    ci_tcp_rx_region_deliver(ni, ts);
+#endif
+
 #if CI_CFG_TCP_FASTSTART
   if( ci_tcp_time_now(ni) - ts->t_prev_recv_payload > NI_CONF(ni).tconst_idle ) {
     if( ts->tcpflags & CI_TCPT_FLAG_NO_QUICKACK )
@@ -156,6 +163,7 @@ ci_inline void ci_tcp_handle_rx_pre_future(ci_netif* netif, ci_ip_pkt_fmt* pkt,
     return;
 
   future->rxp.ni = netif;
+  future->rxp.gro_next = NULL;
   future->rxp.pkt = pkt;
   future->rxp.tcp = tcp;
   pkt->pf.tcp_rx.pay_len = ip_paylen;
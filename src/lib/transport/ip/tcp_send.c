@@ -955,11 +955,10 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
     ci_tcp_calc_rcv_wnd(ts, "tmpl_update");
     tcp->tcp_window_be16 = TS_IPX_TCP(ts)->tcp_window_be16;
 
-    /* Update TCP timestamp */
-    if( ts->tcpflags & CI_TCPT_FLAG_TSO ) {
-      unsigned now = ci_tcp_time_now(ni);
-      ci_tcp_tx_opt_tso(&tcp_opts, now, ts->tsrecent);
-    }
+    /* Update TCP timestamp and RACK send time */
+    pkt->pf.tcp_tx.tx_time = ci_tcp_time_now(ni);
+    if( ts->tcpflags & CI_TCPT_FLAG_TSO )
+      ci_tcp_tx_opt_tso(&tcp_opts, pkt->pf.tcp_tx.tx_time, ts->tsrecent);
 
     ci_netif_pkt_hold(ni, pkt);
     __ci_netif_dmaq_insert_prep_pkt(ni, pkt);
@@ -2534,6 +2533,111 @@ int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, struct onload_zc_mmsg* msg,
 }
 
 
+#if CI_CFG_USERSPACE_PIPE
+/* Returns the number of pipe buffers that ci_tcp_splice_send() may queue
+ * on [ts] now, or 0 if the caller should fall back to copying (which also
+ * takes care of blocking and reporting errors).  Caller must hold the
+ * stack lock.
+ */
+int ci_tcp_splice_send_space(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( ! (ts->s.b.state & CI_TCP_STATE_SYNCHRONISED) || ts->s.tx_errno ||
+      OO_SP_NOT_NULL(ts->local_peer) )
+    return 0;
+  return CI_MAX(ci_tcp_tx_send_space(ni, ts), 0);
+}
+
+
+/* Returns true if pipe buffer [pkt], holding [len] bytes at [payload], can
+ * be sent as a segment without copying.  The payload has to fit in one
+ * segment and leave room in front of it for the headers of [ts].
+ */
+int ci_tcp_splice_pkt_ok(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt,
+                         ci_uint8* payload, int len)
+{
+  return pkt->refcount == 1 && pkt->n_buffers == 1 &&
+         len > 0 && len <= tcp_eff_mss(ts) &&
+         payload - (pkt->dma_start + ETH_HLEN) >= ts->outgoing_hdrs_len;
+}
+
+
+/* Queues pipe buffers [pkts] on the send queue of [ts], each as one
+ * segment.  The buffers must have passed ci_tcp_splice_pkt_ok(), and there
+ * must be at least [pkts->count] of ci_tcp_splice_send_space().  The
+ * payload is moved down to sit right after the headers if the buffer was
+ * laid out for different headers (e.g. it was received with a VLAN tag).
+ * Supported flags: MSG_MORE.  Caller must hold the stack lock.
+ */
+int ci_tcp_splice_send(ci_netif* ni, ci_tcp_state* ts,
+                       struct ci_pipe_pkt_list* pkts, int flags)
+{
+  int af = ipcache_af(&ts->s.pkt);
+  unsigned eff_mss = tcp_eff_mss(ts);
+  ci_ip_pkt_fmt* fill_list = NULL;
+  ci_ip_pkt_fmt* pkt = pkts->head;
+  ci_ip_pkt_fmt* next;
+  ci_uint8* payload;
+  int i, len, bytes = 0;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_gt(pkts->count, 0);
+  ci_assert_le(pkts->count, ci_tcp_splice_send_space(ni, ts));
+
+  /* ci_tcp_sendmsg_enqueue() expects the buffers to be accounted as
+   * in flight from the app. */
+  ni->state->n_async_pkts += pkts->count;
+
+  for( i = 0; i < pkts->count; ++i, pkt = next ) {
+    next = i + 1 < pkts->count ? PKT_CHK(ni, pkt->next) : NULL;
+    payload = pkt->dma_start + pkt->pf.pipe.base;
+    len = pkt->pf.pipe.pay_len;
+    ci_assert(ci_tcp_splice_pkt_ok(ni, ts, pkt, payload, len));
+
+    oo_tx_pkt_layout_init(pkt);
+    pkt->flags &= CI_PKT_FLAG_NONB_POOL;
+#if CI_CFG_IPV6
+    if( af == AF_INET6 )
+      pkt->flags |= CI_PKT_FLAG_IS_IP6;
+#endif
+    if( payload != (ci_uint8*) oo_tx_l3_hdr(pkt) + ts->outgoing_hdrs_len ) {
+      memmove((ci_uint8*) oo_tx_l3_hdr(pkt) + ts->outgoing_hdrs_len,
+              payload, len);
+      CITP_STATS_NETIF_INC(ni, tcp_splice_moves);
+    }
+
+    __ci_tcp_tx_pkt_init(pkt, ts->outgoing_hdrs_len, eff_mss);
+    pkt->n_buffers = 1;
+    pkt->buf_len += len;
+    pkt->pay_len += len;
+    oo_offbuf_advance(&pkt->buf, len);
+    pkt->pf.tcp_tx.end_seq = len;
+
+    CI_USER_PTR_SET(pkt->pf.tcp_tx.next, fill_list);
+    fill_list = pkt;
+    bytes += len;
+  }
+
+  if( (flags & MSG_MORE) || (ts->s.s_aflags & CI_SOCK_AFLAG_CORK) ) {
+    fill_list->flags |= CI_PKT_FLAG_TX_MORE;
+    fill_list->flags &=~ CI_PKT_FLAG_TX_PSH_ON_ACK;
+  }
+
+  ts->send_in += ci_tcp_sendmsg_enqueue(ni, ts, fill_list, bytes, &ts->send);
+
+  if( fill_list->flags & CI_PKT_FLAG_TX_MORE )
+    TX_PKT_IPX_TCP(af, fill_list)->tcp_flags = CI_TCP_FLAG_ACK;
+  else
+    TX_PKT_IPX_TCP(af, fill_list)->tcp_flags = CI_TCP_FLAG_PSH|CI_TCP_FLAG_ACK;
+  ci_tcp_tx_advance_nagle(ni, ts);
+
+  CITP_STATS_NETIF_ADD(ni, tcp_splice_tx_pkts, pkts->count);
+  return bytes;
+}
+#endif
+
+
 static int ci_tcp_ds_get_arp(ci_netif* ni, ci_tcp_state* ts)
 {
   int i;
@@ -2768,6 +2872,15 @@ ci_tcp_ds_done(ci_netif* ni, ci_tcp_state* ts,
       if( sinf.set_errno ) CI_SET_ERROR(sinf.rc, sinf.rc);
       return sinf.rc;
     }
+    /* The application has already sent these itself; stamp them with a
+     * send time for RACK before they join the retransmit queue. */
+    {
+      ci_iptime_t now = ci_tcp_time_now(ni);
+      ci_ip_pkt_fmt* pkt;
+      for( pkt = sinf.fill_list; pkt != NULL;
+           pkt = (ci_ip_pkt_fmt*) CI_USER_PTR_GET(pkt->pf.tcp_tx.next) )
+        pkt->pf.tcp_tx.tx_time = now;
+    }
     /* add to retrans q */
     ci_tcp_sendmsg_enqueue(ni, ts, sinf.fill_list, sinf.fill_list_bytes,
                            &ts->retrans);
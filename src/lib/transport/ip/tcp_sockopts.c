@@ -217,6 +217,22 @@ int ci_get_sol_tcp(ci_netif* netif, ci_sock_cmn* s, int optname, void *optval,
         u = ci_tcp_is_in_faststart(SOCK_TO_TCP(s));
       goto u_out;
     }
+#ifdef TCP_CONGESTION
+  case TCP_CONGESTION:
+    {
+      /* Like Linux, copy out the name padded with NULs to the size of the
+       * name field in the kernel (TCP_CA_NAME_MAX). */
+      char name[16];
+      int len = CI_MIN(*optlen, (socklen_t) sizeof(name));
+      if( len < 0 )
+        RET_WITH_ERRNO(EINVAL);
+      memset(name, 0, sizeof(name));
+      strncpy(name, ci_tcp_cong_alg_name(c->cong_alg), sizeof(name) - 1);
+      memcpy(optval, name, len);
+      *optlen = len;
+      return 0;
+    }
+#endif
   default:
 #ifndef __KERNEL__
     LOG_TC( log(LPF "getsockopt: unimplemented or bad option: %i", 
@@ -263,6 +279,23 @@ int ci_tcp_getsockopt(citp_socket* ep, ci_fd_t fd, int level,
       ci_tcp_state* ts = SOCK_TO_TCP(s);
       ci_tcp_set_sndbuf_from_sndbuf_pkts(netif, ts);
     }
+#ifdef SO_MAX_PACING_RATE
+    if( optname == SO_MAX_PACING_RATE && s->b.state != CI_TCP_LISTEN ) {
+      ci_tcp_state* ts = SOCK_TO_TCP(s);
+      ci_uint64 rate = ~0ull;
+      if( OO_PP_NOT_NULL(ts->pacing) &&
+          ci_ni_aux_p2pacing(netif, ts->pacing)->max_rate != 0xffffffffu )
+        rate = ci_ni_aux_p2pacing(netif, ts->pacing)->max_rate;
+      if( *optlen >= sizeof(ci_uint64) )
+        return ci_getsockopt_final(optval, optlen, SOL_SOCKET,
+                                   &rate, sizeof(rate));
+      else {
+        unsigned u = CI_MIN(rate, 0xffffffffu);
+        return ci_getsockopt_final(optval, optlen, SOL_SOCKET,
+                                   &u, sizeof(u));
+      }
+    }
+#endif
 
     /* Common SOL_SOCKET handler */
     return ci_get_sol_socket(netif, s, optname, optval, optlen);
@@ -339,6 +372,29 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
       }
       break;
 
+#ifdef SO_MAX_PACING_RATE
+    case SO_MAX_PACING_RATE:
+    {
+      /* Bytes per second; ~0 removes the limit.  Listening sockets keep
+       * it on the OS socket only: it is not inherited by accepted
+       * connections.
+       */
+      ci_uint64 rate;
+      if( (rc = opt_not_ok(optval, optlen, ci_uint32)) )
+        goto fail_inval;
+      if( optlen >= sizeof(ci_uint64) )
+        rate = *(ci_uint64*) optval;
+      else
+        rate = *(ci_uint32*) optval;
+      if( s->b.state == CI_TCP_LISTEN )
+        break;
+      rc = ci_tcp_pacing_set_max_rate(netif, SOCK_TO_TCP(s), rate);
+      if( rc != 0 )
+        RET_WITH_ERRNO(-rc);
+      break;
+    }
+#endif
+
     default:
       {
         /* Common socket level options */
@@ -355,6 +411,28 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
     return ci_set_sol_ip6(netif, s, optname, optval, optlen);
   }
   else if( level == IPPROTO_TCP ) {
+#ifdef TCP_CONGESTION
+    /* The only string-valued option at this level. */
+    if( optname == TCP_CONGESTION ) {
+      int alg;
+      if( optlen == 0 ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      alg = ci_tcp_cong_alg_from_name(optval, optlen);
+      if( alg < 0 ) {
+        LOG_TC(log("%s: "NSS_FMT" TCP_CONGESTION: unknown algorithm %.*s",
+                   __FUNCTION__, NSS_PRI_ARGS(netif,s),
+                   (int) CI_MIN(optlen, 16), (const char*) optval));
+        RET_WITH_ERRNO(-alg);
+      }
+      if( s->b.state == CI_TCP_LISTEN )
+        c->cong_alg = alg;
+      else
+        ci_tcp_cong_set_alg(netif, SOCK_TO_TCP(s), alg);
+      return 0;
+    }
+#endif
     /* These are ints values */
     if( (rc = opt_not_ok(optval, optlen, int)) )
       goto fail_inval;
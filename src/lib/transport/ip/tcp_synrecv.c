@@ -898,6 +898,7 @@ int ci_tcp_listenq_try_promote(ci_netif* netif, ci_tcp_socket_listen* tls,
 
     ts->smss = tsr->tcpopts.smss;
     ts->c.user_mss = tls->c.user_mss;
+    ts->c.cong_alg = tls->c.cong_alg;
     if (ts->c.user_mss && ts->c.user_mss < ts->smss)
       ts->smss = ts->c.user_mss;
 #if CI_CFG_LIMIT_SMSS
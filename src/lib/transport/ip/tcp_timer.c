@@ -542,41 +542,8 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
     return;
   }
 
-  if( ts->congstate & CI_TCP_CONG_RTO ){
-    /* RTO after a retransmission based on an RTO.
-    **
-    ** Ambiguous what to do here, but 2*SMSS is sensible: See:
-    ** http://www.postel.org/pipermail/end2end-interest/2003-July/003244.html
-    **
-    ** (NB. ctk had 003374.html here, but it doesn't exist!  The one I've
-    ** replaced it with looks right).
-    */
-    ts->ssthresh = tcp_eff_mss(ts) << 1u;
-  }
-  else {
-    /* Set cwnd to 1SMSS and ssthresh to half flightsize.  But careful as
-    ** NewReno fast-recovery will have an inflated flightsize.
-    */
-    if( ts->congstate == CI_TCP_CONG_FAST_RECOV &&
-	!(ts->tcpflags & CI_TCPT_FLAG_SACK) ) {
-      unsigned x = ts->ssthresh >> 1u;
-      unsigned y = tcp_eff_mss(ts) << 1u;
-      ts->ssthresh = CI_MAX(x, y);
-    }
-    else
-      ts->ssthresh = ci_tcp_losswnd(ts);
-
-    ts->congstate = CI_TCP_CONG_RTO;
-    ts->cwnd_extra = 0;
-    ++ts->stats.rtos;
-  }
-
   ts->congrecover = tcp_snd_nxt(ts);
-
-  /* Reset congestion window to one segment (RFC2581 p5). */
-  ts->cwnd = CI_MAX(tcp_eff_mss(ts), NI_OPTS(netif).loss_min_cwnd);
-  ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(netif).min_cwnd);
-  ts->bytes_acked = 0;
+  ci_tcp_cong_rto(netif, ts);
 
   /* Backoff RTO timer and restart. */
   ts->rto <<= 1u;
@@ -613,7 +580,7 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
 static void ci_tcp_timeout_taildrop(ci_netif* netif, ci_tcp_state* ts)
 {
 #if CI_CFG_TAIL_DROP_PROBE
-  ci_assert(NI_OPTS(netif).tail_drop_probe);
+  ci_assert(NI_OPTS(netif).tail_drop_probe || NI_OPTS(netif).tcp_rack);
   ci_assert(ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_TIMING);
 
   LOG_TL(log(FNTS_FMT "now=%x srtt=%u+%u "TCP_SND_FMT,
@@ -639,6 +606,17 @@ static void ci_tcp_timeout_taildrop(ci_netif* netif, ci_tcp_state* ts)
   ts->tcpflags &=~ CI_TCPT_FLAG_TAIL_DROP_TIMING;
   ci_tcp_rto_set(netif, ts);
 
+  /* This is also RACK's reordering timer, so go into recovery if the
+   * first hole has now been outstanding for long enough.
+   */
+  if( ci_tcp_rack_enabled(netif, ts) && ci_tcp_rack_detect_loss(netif, ts) ) {
+    CITP_STATS_NETIF_INC(netif, tcp_rack_reo_timeouts);
+    return;
+  }
+  /* With EF_TAIL_DROP_PROBE=0 this was only the reordering timer. */
+  if( ! NI_OPTS(netif).tail_drop_probe )
+    return;
+
   /* If we have new data to send, and window, send that. */
   if( ts->send.num > 0 ) {
     const ci_ip_pkt_fmt* pkt = PKT_CHK(netif, ts->send.head);
@@ -50,6 +50,8 @@ ci_inline void ci_ip_tcp_list_to_dmaq(ci_netif* ni, ci_tcp_state* ts,
       pkt->flags |= CI_PKT_FLAG_TX_TIMESTAMPED;
 #endif
     ci_ip_set_mac_and_port(ni, &ts->s.pkt, pkt);
+    if(CI_UNLIKELY( ni->lat_hists != NULL ))
+      pkt->pf.tcp_tx.sock_id = S_SP(ts);
     ci_netif_pkt_hold(ni, pkt);
     if(CI_UNLIKELY( ts->tcpflags & CI_TCPT_FLAG_MSG_WARM ))
       pkt->flags |= CI_PKT_FLAG_MSG_WARM;
@@ -136,6 +138,8 @@ static void ci_ip_tcp_list_to_dmaq_striping(ci_netif* ni, ci_tcp_state* ts,
       pkt->flags |= CI_PKT_FLAG_TX_TIMESTAMPED;
 #endif
     ci_ip_set_mac_and_port(ni, &ts->s.pkt, pkt);
+    if(CI_UNLIKELY( ni->lat_hists != NULL ))
+      pkt->pf.tcp_tx.sock_id = S_SP(ts);
     pp = pkt->next;
     ci_netif_pkt_hold(ni, pkt);
     if(CI_UNLIKELY( ts->tcpflags & CI_TCPT_FLAG_MSG_WARM ))
@@ -273,6 +277,8 @@ fast:
       (void)af;
 #endif
 
+      if(CI_UNLIKELY( ni->lat_hists != NULL ))
+        pkt->pf.tcp_tx.sock_id = S_SP(ts);
       ci_ip_send_tcp_slow(ni, ts, pkt);
       if( pkt == tail_pkt )
         break;
@@ -878,6 +884,7 @@ int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
     rc = 0;
   }
   else {
+    pkt->pf.tcp_tx.sock_id = OO_SP_NULL;
     rc = ci_ip_send_pkt_send(netif, &tls->s.cp, pkt, ipcache);
     ci_netif_pkt_release(netif, pkt);
   }
@@ -1022,7 +1029,9 @@ int ci_tcp_unsacked_segments_in_flight(ci_netif* ni, ci_tcp_state* ts)
 **
 ** We also stop retransmitting if we reach [ts->congrecover].  If
 ** [before_sacked_only] is true, then after the first we only continue
-** retransmitting packets that are before a SACK block.
+** retransmitting packets that are before a SACK block.  If it is
+** CI_TCP_RETRANS_RACK we also stop at the first packet that RACK does not
+** yet consider lost.
 **
 ** Returns true if we should now exit recovery (reached congrecover or end
 ** of retransmit queue).  False otherwise.
@@ -1036,6 +1045,7 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
   ci_ip_pkt_fmt* pkt;
   int at_start_of_block = 0;
   int seq_space, is_fin;
+  ci_iptime_t reo_wnd = 0;
 
   /* Mustn't call this when there's nothing to send. */
   ci_assert(OO_PP_NOT_NULL(ts->retrans_ptr));
@@ -1044,6 +1054,8 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
   pkt = PKT_CHK(ni, ts->retrans_ptr);
   LOG_TV(log(LPF "rtq: %d -> %d ->...-> %d, %d packets", OO_PKT_FMT(pkt),
             OO_PKT_FMT(pkt), OO_PP_FMT(ts->retrans.tail), ts->retrans.num));
+  if( before_sacked_only == CI_TCP_RETRANS_RACK )
+    reo_wnd = ci_tcp_rack_reo_wnd(ts);
 
   while( 1 ) {
     /* Skip SACKed packets. */
@@ -1081,6 +1093,13 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
     /* Stop if we've reached the recovery sequence number. */
     if( SEQ_LE(ts->congrecover, pkt->pf.tcp_tx.start_seq) )  return 1;
 
+    /* Leave segments that may only have been reordered; a later ACK or
+    ** the RTO will get back to them.
+    */
+    if( before_sacked_only == CI_TCP_RETRANS_RACK &&
+        ci_tcp_rack_wait(ni, ts, pkt, reo_wnd) != 0 )
+      return 0;
+
 #if CI_CFG_BURST_CONTROL
     if(ts->burst_window && ci_tcp_burst_exhausted(ni, ts)){
       LOG_TV(log(LNT_FMT "tx limited by burst avoidance",
@@ -1153,7 +1172,7 @@ void ci_tcp_retrans_recover(ci_netif* ni, ci_tcp_state* ts,
     ts->cwnd_extra = SEQ_SUB(fack, tcp_snd_una(ts)) - retrans_data;
     ts->cwnd_extra = CI_MAX(ts->cwnd_extra, 0);
     cwnd_avail = ts->cwnd + ts->cwnd_extra - ci_tcp_inflight(ts);
-    before_sacked_only = 1;
+    before_sacked_only = ci_tcp_rack_enabled(ni, ts) ? CI_TCP_RETRANS_RACK : 1;
     if( force_retrans_first ) {
       /* Make [cwnd_avail] sufficiently large if necessary to ensure we can
       ** retransmit at least one packet.  This is used when entering fast
@@ -1211,6 +1230,218 @@ void ci_tcp_retrans_recover(ci_netif* ni, ci_tcp_state* ts,
 }
 
 
+/**********************************************************************
+ * Pacing.
+ *
+ * A paced socket may send its next segment once [next_us] has come; each
+ * segment sent moves [next_us] on by the time the segment takes at the
+ * pacing rate.  A socket whose next segment is not yet due waits in the
+ * stack's pacing scheduler: a ring of slots, each a list of the sockets
+ * due in a short span of time.  ci_tcp_pacing_poll() runs the slots that
+ * have come due and calls ci_tcp_tx_advance() on their sockets again.
+ *
+ * A socket more than a ring's worth of slots away from its release time
+ * is put in the furthest slot, and is simply rescheduled when that comes
+ * round.  The furthest slot is one short of the ring so that a socket
+ * rescheduled while its slot is being run never goes back into it.
+ */
+
+ci_inline ci_uint32 ci_tcp_pacing_now(ci_netif* ni)
+{
+  ci_uint64 frc;
+  ci_frc64(&frc);
+  return (ci_uint32) (frc >> IPTIMER_STATE(ni)->ci_ip_time_frc2us);
+}
+
+
+int ci_tcp_pacing_alloc(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_tcp_pacing_state* ps;
+  ci_ni_aux_mem* aux;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(OO_PP_IS_NULL(ts->pacing));
+
+  ts->pacing = ci_ni_aux_alloc(ni, CI_TCP_AUX_TYPE_PACING);
+  if( OO_PP_IS_NULL(ts->pacing) )
+    return -ENOMEM;
+  aux = ci_ni_aux_p2aux(ni, ts->pacing);
+  ci_ni_dllist_self_link(ni, &aux->link);
+  ps = &aux->u.pacing;
+  ps->sock_id = S_SP(ts);
+  ps->max_rate = 0xffffffffu;
+  ps->rate = 0;
+  ps->next_us = ci_tcp_pacing_now(ni);
+  ps->held = 0;
+  return 0;
+}
+
+
+void ci_tcp_pacing_free(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_ni_aux_mem* aux = ci_ni_aux_p2aux(ni, ts->pacing);
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( ! ci_ni_dllist_is_self_linked(ni, &aux->link) ) {
+    ci_ni_dllist_remove(ni, &aux->link);
+    --ni->state->pacing_n;
+  }
+  ci_ni_aux_free(ni, aux);
+  ts->pacing = OO_PP_NULL;
+}
+
+
+/* SO_MAX_PACING_RATE.  Rates of 2^32-1 bytes per second and above mean
+ * no limit.
+ */
+int ci_tcp_pacing_set_max_rate(ci_netif* ni, ci_tcp_state* ts,
+                               ci_uint64 rate)
+{
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( OO_PP_IS_NULL(ts->pacing) ) {
+    if( rate >= 0xffffffffu )
+      return 0;
+    if( ci_tcp_pacing_alloc(ni, ts) != 0 )
+      return -ENOMEM;
+  }
+  ci_ni_aux_p2pacing(ni, ts->pacing)->max_rate = CI_MIN(rate, 0xffffffffu);
+  return 0;
+}
+
+
+static void ci_tcp_pacing_schedule(ci_netif* ni, ci_tcp_pacing_state* ps)
+{
+  ci_netif_state* ns = ni->state;
+  ci_ni_dllist_link* link = &CI_CONTAINER(ci_ni_aux_mem, u.pacing, ps)->link;
+  ci_uint32 slot = ps->next_us >> CI_TCP_PACING_SLOT_SHIFT;
+
+  if( ! ci_ni_dllist_is_self_linked(ni, link) )
+    return;
+
+  if( ns->pacing_n == 0 )
+    ns->pacing_cursor = ci_tcp_pacing_now(ni) >> CI_TCP_PACING_SLOT_SHIFT;
+  if( (ci_int32) (slot - ns->pacing_cursor) < 0 )
+    slot = ns->pacing_cursor;
+  else if( slot - ns->pacing_cursor > CI_TCP_PACING_SLOTS - 2 )
+    slot = ns->pacing_cursor + CI_TCP_PACING_SLOTS - 2;
+
+  ci_ni_dllist_put(ni, &ns->pacing_slots[slot % CI_TCP_PACING_SLOTS], link);
+  ++ns->pacing_n;
+  ps->held = 1;
+
+  if( ! ci_ip_timer_pending(ni, &ns->pacing_tid) )
+    ci_ip_timer_set(ni, &ns->pacing_tid, ci_ip_time_now(ni) + 1);
+}
+
+
+/* Returns the rate in bytes per second at which ci_tcp_tx_advance_to()
+ * should pace the socket, or 0 if it is not to be paced.
+ */
+static ci_uint32 ci_tcp_pacing_rate(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_tcp_pacing_state* ps = ci_ni_aux_p2pacing(ni, ts->pacing);
+  ci_uint32 rate;
+
+  if( ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE )
+    return 0;
+
+  rate = NI_OPTS(ni).tcp_pacing ? ci_tcp_cong_pacing_rate(ni, ts) : 0;
+  if( rate == 0 || rate > ps->max_rate )
+    rate = ps->max_rate;
+  if( rate == 0xffffffffu )
+    rate = 0;
+  ps->rate = rate;
+  return rate;
+}
+
+
+/* Called from ci_tcp_tx_advance_to() for each segment of a paced socket
+ * once the segment has passed every other send check.  [*next_us] is the
+ * release time of the segment, which is advanced past it if it can go now.
+ * Returns true if the segment must wait, in which case the socket has been
+ * scheduled.  The socket's budget is charged only by ci_tcp_pacing_sent(),
+ * when the segments have really been sent.
+ */
+static int ci_tcp_pacing_hold(ci_netif* ni, ci_tcp_state* ts,
+                              ci_ip_pkt_fmt* pkt, ci_uint32 rate,
+                              ci_uint32* next_us)
+{
+  ci_tcp_pacing_state* ps = ci_ni_aux_p2pacing(ni, ts->pacing);
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint32 now = ci_tcp_pacing_now(ni);
+  ci_uint64 delay;
+
+  if( (ci_int32) (*next_us - now) > 0 ) {
+    ps->next_us = *next_us;
+    ci_tcp_pacing_schedule(ni, ps);
+    return 1;
+  }
+
+  /* Time not used while idle is not saved up for a burst later. */
+  if( (ci_int32) (now - *next_us) > 0 )
+    *next_us = now;
+  delay = (ci_uint64) TX_PKT_LEN(pkt) *
+          (((ci_uint64) its->khz * 1000u) >> its->ci_ip_time_frc2us) / rate;
+  *next_us += (ci_uint32) CI_MAX(delay, 1);
+  return 0;
+}
+
+
+/* Charge [n] segments just sent to the socket's pacing budget. */
+static void ci_tcp_pacing_sent(ci_netif* ni, ci_tcp_state* ts,
+                               ci_uint32 next_us, int n)
+{
+  ci_tcp_pacing_state* ps = ci_ni_aux_p2pacing(ni, ts->pacing);
+
+  ps->next_us = next_us;
+  if( ps->held ) {
+    ps->held = 0;
+    CITP_STATS_NETIF_INC(ni, tcp_pacing_delayed);
+    --n;
+  }
+  CITP_STATS_NETIF_ADD(ni, tcp_pacing_immediate, n);
+}
+
+
+/* Run the pacing scheduler's slots up to the current time. */
+void ci_tcp_pacing_poll(ci_netif* ni)
+{
+  ci_netif_state* ns = ni->state;
+  ci_uint32 now_slot = ci_tcp_pacing_now(ni) >> CI_TCP_PACING_SLOT_SHIFT;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  /* Everything is overdue if we have fallen a whole ring behind. */
+  if( (ci_int32) (now_slot - ns->pacing_cursor) >= CI_TCP_PACING_SLOTS )
+    ns->pacing_cursor = now_slot - CI_TCP_PACING_SLOTS + 1;
+
+  while( ns->pacing_n != 0 &&
+         (ci_int32) (now_slot - ns->pacing_cursor) >= 0 ) {
+    ci_ni_dllist_t* list =
+      &ns->pacing_slots[ns->pacing_cursor % CI_TCP_PACING_SLOTS];
+    ++ns->pacing_cursor;
+
+    while( ci_ni_dllist_not_empty(ni, list) ) {
+      ci_ni_dllist_link* link = ci_ni_dllist_pop(ni, list);
+      ci_tcp_pacing_state* ps =
+        &CI_CONTAINER(ci_ni_aux_mem, link, link)->u.pacing;
+      ci_tcp_state* ts = SP_TO_TCP(ni, ps->sock_id);
+
+      ci_ni_dllist_self_link(ni, link);
+      --ns->pacing_n;
+      CITP_STATS_NETIF_INC(ni, tcp_pacing_releases);
+      if( ci_ip_queue_not_empty(&ts->send) )
+        ci_tcp_tx_advance(ts, ni);
+    }
+  }
+
+  if( ns->pacing_n != 0 && ! ci_ip_timer_pending(ni, &ns->pacing_tid) )
+    ci_ip_timer_set(ni, &ns->pacing_tid, ci_ip_time_now(ni) + 1);
+}
+
+
 /* Called to handle packets with MSG_MORE.  Return true if packet should
  * not be transmitted yet.
  */
@@ -1337,6 +1568,11 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
   oo_pkt_p id = sendq->head;
   int sent_num = 0;
   int af = ipcache_af(&ts->s.pkt);
+  ci_uint32 pace_rate = 0, pace_next_us = 0;
+
+  if( OO_PP_NOT_NULL(ts->pacing) &&
+      (pace_rate = ci_tcp_pacing_rate(ni, ts)) != 0 )
+    pace_next_us = ci_ni_aux_p2pacing(ni, ts->pacing)->next_us;
 
   while( 1 ) {
     ci_ip_pkt_fmt* pkt = PKT_CHK(ni, id);
@@ -1371,6 +1607,11 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
         ++ts->stats.tx_stop_more;
         break;
       }
+    if( pace_rate != 0 &&
+        ci_tcp_pacing_hold(ni, ts, pkt, pace_rate, &pace_next_us) ) {
+      ++ts->stats.tx_stop_pacing;
+      break;
+    }
 
 #if CI_CFG_CONG_AVOID_NOTIFIED
     /* Is there local congestion, suggesting we should back off a bit? */
@@ -1486,6 +1727,8 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
          * in unroll_msg_warm called from tcp_sendmsg().
          */
         return;
+      if( pace_rate != 0 )
+        ci_tcp_pacing_sent(ni, ts, pace_next_us, sent_num);
     }
 
     if(CI_UNLIKELY( ts->s.b.state == CI_TCP_CLOSED )) {
@@ -1781,6 +2024,7 @@ ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
     /* ?? TODO: should we respect here SO_BINDTODEVICE? */
     ci_ip_cached_hdrs ipcache;
     ci_ip_cache_init(&ipcache, af);
+    pkt->pf.tcp_tx.sock_id = OO_SP_NULL;
     ci_ip_send_pkt_lookup(netif, NULL, pkt, &ipcache);
     ci_ip_send_pkt_send(netif, sock_cp, pkt, &ipcache);
   }
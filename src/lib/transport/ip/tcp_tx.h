@@ -31,6 +31,10 @@ ci_inline void ci_tcp_tx_finish(ci_netif* netif, ci_tcp_state* ts,
   ci_tcp_hdr* tcp = TX_PKT_IPX_TCP(ipcache_af(&ts->s.pkt), pkt);
   ci_uint8* opt = CI_TCP_HDR_OPTS(tcp);
   int seq = pkt->pf.tcp_tx.start_seq;
+  unsigned now = ci_tcp_time_now(netif);
+
+  /* Send time, for RACK loss detection */
+  pkt->pf.tcp_tx.tx_time = now;
 
   /* Decrement the faststart counter by the number of bytes acked */
   ci_tcp_reduce_faststart(ts, SEQ_SUB(tcp_rcv_nxt(ts),ts->tslastack));
@@ -38,7 +42,6 @@ ci_inline void ci_tcp_tx_finish(ci_netif* netif, ci_tcp_state* ts,
   /* put in the TSO & SACK options if needed */
   ts->tslastack = tcp_rcv_nxt(ts); /* also used for faststart */
   if( ts->tcpflags & CI_TCPT_FLAG_TSO ) {
-    unsigned now =  ci_tcp_time_now(netif);
     ci_tcp_tx_opt_tso(&opt, now, ts->tsrecent);
   } else {
     /* do snarf for RTT timing if not using timestamps */
@@ -82,7 +82,6 @@ static void ci_udp_state_init(ci_netif* netif, ci_udp_state* us)
   ci_udp_recv_q_init(&us->recv_q);
   us->zc_kernel_datagram = OO_PP_NULL;
   us->zc_kernel_datagram_count = 0;
-  us->tx_async_q = CI_ILL_END;
   oo_atomic_set(&us->tx_async_q_level, 0);
   us->tx_count = 0;
   us->udpflags = CI_UDPF_MCAST_LOOP;
@@ -163,6 +162,7 @@ ci_fd_t ci_udp_ep_ctor(citp_socket* ep, ci_netif* netif, int domain, int type)
 
   ep->s = &us->s;
   ep->netif = netif;
+  memset(&ep->spin_adapt, 0, sizeof(ep->spin_adapt));
   CHECK_UEP(ep);
   ci_netif_unlock(netif);
   return fd;
@@ -43,7 +43,7 @@ void ci_udp_perform_deferred_socket_work(ci_netif* ni, ci_udp_state* us)
 {
   ci_assert(us->s.b.state == CI_TCP_STATE_UDP);
 
-  ci_udp_sendmsg_send_async_q(ni, us);
+  ci_netif_udp_tx_stage_drain(ni);
 }
 
 /*! \cidoxg_end */
@@ -388,6 +388,7 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
 # endif
 #endif
 
+      ci_netif_lat_rx_recv(ni, S_SP(us), pkt->tstamp_frc);
       ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
     }
     us->udpflags |= CI_UDPF_LAST_RECV_ON;
@@ -678,10 +679,54 @@ struct recvmsg_spinstate {
   uint32_t poison;
   const volatile uint32_t* future;
   citp_signal_info* si;
+  /* EF_SPIN_ADAPTIVE: 0 off or recorded, 1 spinning, 2 blocked */
+  int adapt;
 #endif
 };
 
 
+#ifndef __KERNEL__
+/* Called when data is found after spinning or blocking, to feed the wait
+ * time into the caller's adaptive spin state.
+ */
+ci_inline void
+ci_udp_recvmsg_spin_adapt_record(ci_udp_iomsg_args* a,
+                                 struct recvmsg_spinstate* spin_state)
+{
+  if( spin_state->adapt ) {
+    oo_spin_adapt_record(a->ni, &a->ep->spin_adapt, spin_state->start_frc,
+                         spin_state->adapt == 1);
+    spin_state->adapt = 0;
+  }
+}
+
+
+/* Picks the spin limit for a receive that is about to block. */
+ci_inline void
+ci_udp_recvmsg_spin_init(ci_udp_iomsg_args* a,
+                         struct recvmsg_spinstate* spin_state)
+{
+  ci_netif* ni = a->ni;
+  ci_udp_state* us = a->us;
+
+  spin_state->max_spin = us->s.b.spin_cycles;
+  if( NI_OPTS(ni).spin_adaptive ) {
+    spin_state->max_spin = oo_spin_adapt_budget(ni, &a->ep->spin_adapt,
+                                                spin_state->max_spin);
+    spin_state->adapt = 1;
+  }
+  if( us->s.so.rcvtimeo_msec ) {
+    ci_uint64 max_so_spin = (ci_uint64)us->s.so.rcvtimeo_msec *
+        IPTIMER_STATE(ni)->khz;
+    if( max_so_spin <= spin_state->max_spin ) {
+      spin_state->max_spin = max_so_spin;
+      spin_state->spin_limit_by_so = 1;
+    }
+  }
+}
+#endif
+
+
 static int 
 ci_udp_recvmsg_block(ci_udp_iomsg_args* a, ci_netif* ni, ci_udp_state* us,
                      int timeout)
@@ -816,8 +861,16 @@ ci_udp_recvmsg_socklocked_spin(ci_netif* ni, ci_udp_state* us,
       return -EAGAIN;
     }
 
+#ifndef __KERNEL__
+    if( spin_state->adapt )
+      spin_state->adapt = 2;
+#endif
     if( spin_state->timeout ) {
       ci_uint32 spin_ms = NI_OPTS(ni).spin_usec >> 10;
+#ifndef __KERNEL__
+      if( NI_OPTS(ni).spin_adaptive )
+        spin_ms = (now_frc - spin_state->start_frc) / IPTIMER_STATE(ni)->khz;
+#endif
       if( spin_ms < spin_state->timeout )
         spin_state->timeout -= spin_ms;
       else {
@@ -945,15 +998,7 @@ ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
       spin_state.poison = CI_PKT_RX_POISON;
       spin_state.future = NULL;
       spin_state.schedule_frc = spin_state.start_frc;
-      spin_state.max_spin = us->s.b.spin_cycles;
-      if( us->s.so.rcvtimeo_msec ) {
-        ci_uint64 max_so_spin = (ci_uint64)us->s.so.rcvtimeo_msec *
-            IPTIMER_STATE(ni)->khz;
-        if( max_so_spin <= spin_state.max_spin ) {
-          spin_state.max_spin = max_so_spin;
-          spin_state.spin_limit_by_so = 1;
-        }
-      }
+      ci_udp_recvmsg_spin_init(rinf->a, &spin_state);
     }
   }
 
@@ -982,6 +1027,10 @@ ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
   CI_SET_ERROR(rc, -rc);
 
  out:
+#ifndef __KERNEL__
+  if( rc >= 0 )
+    ci_udp_recvmsg_spin_adapt_record(rinf->a, &spin_state);
+#endif
   ni->state->is_spinner = 0;
   return rc;
 
@@ -1305,6 +1354,7 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
     ci_ip_pkt_fmt* pkt;
   not_empty:
     cb_flags = 0;
+    ci_udp_recvmsg_spin_adapt_record(a, &spin_state);
 
     while( (pkt = ci_udp_recv_q_get(ni, &us->recv_q)) != NULL ) {
       /* Reinitialise our own state within [args] each time around the loop, as
@@ -1350,6 +1400,7 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
         pkt->rx_flags &=~ CI_PKT_RX_FLAG_UDP_KEEP;
       }
 
+      ci_netif_lat_rx_recv(ni, S_SP(us), pkt->tstamp_frc);
       ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
 
       done_callback = 1;
@@ -1469,18 +1520,9 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
   
     if( spin_state.do_spin ) {
       spin_state.si = citp_signal_get_specific_inited();
-      spin_state.max_spin = us->s.b.spin_cycles;
       spin_state.poison = CI_PKT_RX_POISON;
       spin_state.future = NULL;
-
-      if( us->s.so.rcvtimeo_msec ) {
-        ci_uint64 max_so_spin = (ci_uint64)us->s.so.rcvtimeo_msec *
-            IPTIMER_STATE(ni)->khz;
-        if( max_so_spin <= spin_state.max_spin ) {
-          spin_state.max_spin = max_so_spin;
-          spin_state.spin_limit_by_so = 1;
-        }
-      }
+      ci_udp_recvmsg_spin_init(a, &spin_state);
     }
   }
 
@@ -13,6 +13,7 @@
   
 /*! \cidoxg_lib_transport_ip */
   
+#define _GNU_SOURCE  /* for sendmmsg */
 #include "ip_internal.h"
 #include "udp_internal.h"
 #include "ip_tx.h"
@@ -20,6 +21,9 @@
 #include <onload/osfile.h>
 #include <onload/pkt_filler.h>
 #include <onload/sleep.h>
+#ifndef __KERNEL__
+#include <onload/ul/per_thread.h>
+#endif
 
 #ifdef ONLOAD_OFE
 #include "ofe/onload.h"
@@ -75,6 +79,9 @@ struct udp_send_info {
   int                   stack_locked;
   ci_uint32             timeout;
   int                   old_ipcache_updated;
+  /* Stack lock is held across a batch of sends by ci_udp_sendmmsg(), and
+   * must not be dropped. */
+  int                   batch;
 };
 
 
@@ -388,7 +395,7 @@ static int ci_udp_sendmsg_os(ci_netif* ni, ci_udp_state* us,
 #else
 
 ci_inline int ci_udp_sendmsg_os(ci_netif* ni, ci_udp_state* us,
-                             const struct msghdr* msg, int flags,
+                             const ci_msghdr* msg, int flags,
                              int user_buffers, int atomic)
 {
   int rc;
@@ -880,60 +887,123 @@ static int ci_udp_tx_datagram_level(ci_netif* ni, ci_ip_pkt_fmt* pkt,
 }
 
 
-void ci_udp_sendmsg_send_async_q(ci_netif* ni, ci_udp_state* us)
+/* Returns the UDP staging queue that the calling thread should use.
+ * Threads are spread over the queues so that concurrent senders rarely
+ * touch the same queue.
+ */
+static ci_udp_tx_stage* ci_udp_tx_stage_for_thread(ci_netif* ni)
+{
+#ifndef __KERNEL__
+  /* This only spreads threads over the queues, so racing updates of
+   * [next_stage] are harmless. */
+  static unsigned next_stage;
+  struct oo_per_thread* pt = __oo_per_thread_get();
+  if(CI_UNLIKELY( pt->udp_tx_stage == 0 ))
+    pt->udp_tx_stage = next_stage++ % CI_CFG_UDP_TX_STAGE_N + 1;
+  return &ni->state->udp_tx_stage[pt->udp_tx_stage - 1];
+#else
+  return &ni->state->udp_tx_stage[current->pid % CI_CFG_UDP_TX_STAGE_N];
+#endif
+}
+
+
+/* Sends the datagrams on all of the UDP staging queues.  The caller holds
+ * the stack lock, which makes it the queues' only consumer.  The datagrams
+ * are sent as a single batch so that the doorbell is rung once per
+ * interface rather than once per datagram.
+ */
+void ci_netif_udp_tx_stage_drain(ci_netif* ni)
 {
-  oo_pkt_p pp, send_list;
+  oo_pkt_p send_list[CI_CFG_UDP_TX_STAGE_N];
+  oo_pkt_p pp, next;
   ci_ip_pkt_fmt* pkt;
-  int flags, level = 0;
-
-  /* Grab the contents of [tx_async_q]. */
-  do {
-    OO_PP_INIT(ni, pp, us->tx_async_q);
-    if( OO_PP_IS_NULL(pp) )  return;
-  } while( ci_cas32_fail(&us->tx_async_q, OO_PP_ID(pp), OO_PP_ID_NULL) );
-
-  /* Reverse the list. */
-  send_list = OO_PP_NULL;
-  do {
-    pkt = PKT_CHK(ni, pp);
-    level += ci_udp_tx_datagram_level(ni, pkt, CI_TRUE);
-    pp = pkt->netif.tx.dmaq_next;
-    pkt->netif.tx.dmaq_next = send_list;
-    send_list = OO_PKT_P(pkt);
+  ci_udp_state* us;
+  int i, n, n_total = 0, flags;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  for( i = 0; i < CI_CFG_UDP_TX_STAGE_N; ++i ) {
+    ci_udp_tx_stage* stage = &ni->state->udp_tx_stage[i];
+
+    /* Grab the contents of the queue. */
+    send_list[i] = OO_PP_NULL;
+    do {
+      OO_PP_INIT(ni, pp, stage->head);
+      if( OO_PP_IS_NULL(pp) )  break;
+    } while( ci_cas32_fail(&stage->head, OO_PP_ID(pp), OO_PP_ID_NULL) );
+
+    /* Reverse the list. */
+    n = 0;
+    while( OO_PP_NOT_NULL(pp) ) {
+      pkt = PKT_CHK(ni, pp);
+      next = pkt->netif.tx.dmaq_next;
+      pkt->netif.tx.dmaq_next = send_list[i];
+      send_list[i] = pp;
+      pp = next;
+      ++n;
+    }
+    n_total += n;
+#if CI_CFG_STATS_NETIF
+    if( n > ni->state->stats.udp_tx_stage_depth_max )
+      ni->state->stats.udp_tx_stage_depth_max = n;
+#endif
   }
-  while( OO_PP_NOT_NULL(pp) );
 
-  oo_atomic_add(&us->tx_async_q_level, -level);
+  if( n_total == 0 )
+    return;
+  CITP_STATS_NETIF_INC(ni, udp_tx_stage_drains);
+#if CI_CFG_STATS_NETIF
+  if( n_total > ni->state->stats.udp_tx_stage_batch_max )
+    ni->state->stats.udp_tx_stage_batch_max = n_total;
+#endif
+
+  if( n_total > 1 )
+    ci_netif_tx_batch_start(ni);
 
   /* Send each datagram. */
-  while( 1 ) {
-    pp = pkt->netif.tx.dmaq_next;
-    if( pkt->flags & CI_PKT_FLAG_MSG_CONFIRM )
-      flags = MSG_CONFIRM;
-    else
-      flags = 0;
-    ++us->stats.n_tx_lock_defer;
-    ci_udp_sendmsg_send(ni, us, pkt, flags, NULL);
-    ci_netif_pkt_release(ni, pkt);
-    if( OO_PP_IS_NULL(pp) )  break;
-    pkt = PKT_CHK(ni, pp);
-  }
+  for( i = 0; i < CI_CFG_UDP_TX_STAGE_N; ++i )
+    for( pp = send_list[i]; OO_PP_NOT_NULL(pp); pp = next ) {
+      pkt = PKT_CHK(ni, pp);
+      next = pkt->netif.tx.dmaq_next;
+      us = SP_TO_UDP(ni, pkt->pf.udp.tx_sock_id);
+      oo_atomic_add(&us->tx_async_q_level,
+                    -ci_udp_tx_datagram_level(ni, pkt, CI_TRUE));
+      if( pkt->flags & CI_PKT_FLAG_MSG_CONFIRM )
+        flags = MSG_CONFIRM;
+      else
+        flags = 0;
+      /* The socket may have been closed since the datagram was staged. */
+      if( us->s.b.state == CI_TCP_STATE_UDP ) {
+        ++us->stats.n_tx_lock_defer;
+        ci_udp_sendmsg_send(ni, us, pkt, flags, NULL);
+      }
+      ci_netif_pkt_release(ni, pkt);
+    }
+
+  if( n_total > 1 )
+    ci_netif_tx_batch_end(ni);
 }
 
 static void ci_udp_sendmsg_async_q_enqueue(ci_netif* ni, ci_udp_state* us,
                                            ci_ip_pkt_fmt* pkt, int flags)
 {
+  ci_udp_tx_stage* stage = ci_udp_tx_stage_for_thread(ni);
+
   if( flags & MSG_CONFIRM )
     /* Only setting this for first IP fragment -- that should be fine. */
     pkt->flags |= CI_PKT_FLAG_MSG_CONFIRM;
+  pkt->pf.udp.tx_sock_id = S_SP(us);
 
   oo_atomic_add(&us->tx_async_q_level, 
                 ci_udp_tx_datagram_level(ni, pkt, CI_FALSE));
   do
-    OO_PP_INIT(ni, pkt->netif.tx.dmaq_next, us->tx_async_q);
-  while( ci_cas32_fail(&us->tx_async_q,
+    OO_PP_INIT(ni, pkt->netif.tx.dmaq_next, stage->head);
+  while( ci_cas32_fail(&stage->head,
                        OO_PP_ID(pkt->netif.tx.dmaq_next), OO_PKT_ID(pkt)) );
+  CITP_STATS_NETIF_INC(ni, udp_tx_stage_pkts);
 
+  /* Whoever holds the lock drains every staging queue when it performs
+   * the deferred work for this socket. */
   if( ci_netif_lock_or_defer_work(ni, &us->s.b) )
     ci_netif_unlock(ni);
 }
@@ -1188,6 +1258,9 @@ int ci_udp_sendmsg_fill(ci_netif* ni, ci_udp_state* us,
 
   ci_assert(pmtu > 0);
 
+  /* Blocking would drop the lock, so a batch leaves it to the caller. */
+  can_block &= ! sinf->batch;
+
   frag_off = 0;
   bytes_left = bytes_to_send;
 
@@ -1444,8 +1517,10 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
     if( si_trylock_and_inc(ni, sinf, us->stats.n_tx_lock_snd) ) {
       ci_udp_sendmsg_send(ni, us, pf.pkt, flags, sinf);
       ci_netif_pkt_release(ni, pf.pkt);
-      ci_netif_unlock(ni);
-      sinf->stack_locked = 0;
+      if( ! sinf->batch ) {
+        ci_netif_unlock(ni);
+        sinf->stack_locked = 0;
+      }
     }
     else {
       ci_udp_sendmsg_async_q_enqueue(ni, us, pf.pkt, flags);
@@ -1509,6 +1584,7 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
   sinf.used_ipcache = 0;
   sinf.old_ipcache_updated = 0;
   sinf.timeout = us->s.so.sndtimeo_msec;
+  sinf.batch = 0;
 
 #if defined(__linux__) && !defined(__KERNEL__)
   /* TODO: should be done for sun too? */
@@ -1732,4 +1808,146 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
     RET_WITH_ERRNO(-rc);
 }
 
+
+#if CI_CFG_SENDMMSG && ! defined(__KERNEL__)
+/* Prepares [sinf] to send [msg] as part of a batch in ci_udp_sendmmsg().
+ * Returns false if the datagram needs anything that might drop the stack
+ * lock, such as a control plane lookup, fragmentation or waiting for send
+ * queue space, in which case it must go through ci_udp_sendmsg().
+ */
+static int ci_udp_sendmmsg_may_batch(ci_netif* ni, ci_udp_state* us,
+                                     const ci_msghdr* msg, int flags,
+                                     struct udp_send_info* sinf)
+{
+  ci_ip_cached_hdrs* ipcache;
+  unsigned long bytes_to_send = 0;
+  int i, af = ipcache_af(&us->s.pkt);
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( (flags & (MSG_MORE | MSG_OOB)) || CMSG_FIRSTHDR(msg) != NULL ||
+      (us->s.so_error | us->s.tx_errno) ||
+      (msg->msg_iov == NULL && msg->msg_iovlen != 0) )
+    return 0;
+
+  if( msg->msg_namelen == 0 ) {
+    if( ! (us->s.s_flags & CI_SOCK_FLAG_CONNECTED) )
+      return 0;
+    ipcache = &us->s.pkt;
+    ci_ipcache_set_daddr(&sinf->ipcache, addr_any);
+  }
+  else {
+    /* Only the destination in [us->ephemeral_pkt] can be sent to without
+     * a control plane lookup. */
+    ipcache = &us->ephemeral_pkt;
+    if( msg->msg_name == NULL || af != AF_INET ||
+        CI_SIN(msg->msg_name)->sin_family != AF_INET ||
+        ! msg_namelen_ok(AF_INET, msg->msg_namelen) ||
+        (CI_CFG_FAKE_IPV6 && us->s.domain != AF_INET) ||
+        udp_lport_be16(us) == 0 ||
+        ci_get_port(CI_SA(msg->msg_name)) != ipcache->dport_be16 ||
+        ! CI_IPX_ADDR_EQ(ci_get_addr(CI_SA(msg->msg_name)),
+                         ipcache_raddr(ipcache)) )
+      return 0;
+    ci_ipcache_set_daddr(&sinf->ipcache, ipcache_raddr(ipcache));
+    sinf->ipcache.dport_be16 = ipcache->dport_be16;
+  }
+  if( ipcache->status != retrrc_success ||
+      ! oo_cp_ipcache_is_valid(ni, ipcache) )
+    return 0;
+
+  for( i = 0; i < msg->msg_iovlen; ++i )
+    bytes_to_send += CI_IOVEC_LEN(&msg->msg_iov[i]);
+  if( bytes_to_send > ipcache->mtu - CI_IPX_HDR_SIZE(af) -
+                      sizeof(ci_udp_hdr) ||
+      ! UDP_HAS_SENDQ_SPACE(us, bytes_to_send) )
+    return 0;
+
+  if( ipcache == &us->ephemeral_pkt )
+    ++us->stats.n_tx_cp_match;
+  sinf->rc = 0;
+  sinf->stack_locked = 1;
+  sinf->used_ipcache = 0;
+  sinf->old_ipcache_updated = 0;
+  sinf->timeout = us->s.so.sndtimeo_msec;
+  sinf->batch = 1;
+  sinf->ipcache.mtu = ipcache->mtu;
+#if CI_CFG_IPV6
+  sinf->ipcache.ether_type = us->s.pkt.ether_type;
+#endif
+  return 1;
+}
+
+
+/* Sends a vector of datagrams.  Runs of datagrams that can take the fast
+ * path are sent with the stack lock held throughout, and their
+ * descriptors are pushed to the NIC together at the end of the run.  Any
+ * other datagram goes through ci_udp_sendmsg() on its own.
+ *
+ * As with sendmmsg(), returns the number of datagrams sent, or fails if
+ * the first datagram could not be sent.
+ */
+int ci_udp_sendmmsg(ci_udp_iomsg_args* a, struct mmsghdr* mmsg,
+                    unsigned vlen, int flags)
+{
+  ci_netif* ni = a->ni;
+  ci_udp_state* us = a->us;
+  struct udp_send_info sinf;
+  int locked = 0, rc = 0;
+  unsigned i;
+
+  for( i = 0; i < vlen; ++i ) {
+    const ci_msghdr* msg = &mmsg[i].msg_hdr;
+
+    if( ! locked ) {
+      ci_netif_lock(ni);
+      ci_netif_tx_batch_start(ni);
+      locked = 1;
+    }
+
+    if( ci_udp_sendmmsg_may_batch(ni, us, msg, flags, &sinf) ) {
+      ci_udp_sendmsg_onload(ni, us, msg, flags, &sinf);
+      ci_assert(sinf.stack_locked);
+      if( sinf.rc >= 0 ) {
+        mmsg[i].msg_len = sinf.rc;
+        CITP_STATS_NETIF_INC(ni, udp_sendmmsg_batched);
+        continue;
+      }
+      if( sinf.rc != -ENOBUFS ) {
+        rc = sinf.rc;
+        break;
+      }
+      /* Out of packet buffers.  ci_udp_sendmsg() will wait for some if the
+       * socket is blocking. */
+    }
+
+    ci_netif_tx_batch_end(ni);
+    ci_netif_unlock(ni);
+    locked = 0;
+
+    if( msg->msg_iov == NULL && msg->msg_iovlen != 0 ) {
+      rc = -EFAULT;
+      break;
+    }
+    rc = ci_udp_sendmsg(a, msg, flags);
+    if( rc < 0 ) {
+      rc = -errno;
+      break;
+    }
+    mmsg[i].msg_len = rc;
+  }
+
+  if( locked ) {
+    ci_netif_tx_batch_end(ni);
+    ci_netif_unlock(ni);
+  }
+
+  if( i > 0 )
+    return i;
+  if( rc < 0 )
+    RET_WITH_ERRNO(-rc);
+  return 0;
+}
+#endif
+
 /*! \cidoxg_end */
@@ -208,6 +208,108 @@ citp_epoll_set_home_stack(struct citp_epoll_fd* ep, ci_netif* ni)
   }
 }
 
+/* Is [list] the ready list of one of [ep]'s shards? */
+ci_inline int citp_epoll_is_shard_list(struct citp_epoll_fd* ep,
+                                       ci_dllist* list)
+{
+  return list >= &ep->shards[0].ready &&
+         list <= &ep->shards[CITP_EPOLL_SHARDS - 1].ready;
+}
+
+
+/* Gives the members of a shard back to the set.  Returns the number of
+ * members moved.  Caller must lock ep.
+ */
+static int citp_epoll_shard_release(struct citp_epoll_fd* ep,
+                                    struct citp_epoll_shard* shard)
+{
+  struct citp_epoll_member* eitem;
+  int n = 0;
+
+  while( ci_dllist_not_empty(&shard->ready) ) {
+    eitem = EITEM_FROM_DLLINK(ci_dllist_pop(&shard->ready));
+    eitem->item_list = &ep->oo_stack_sockets;
+    ci_dllist_push(&ep->oo_stack_sockets, &eitem->dllink);
+    ++n;
+  }
+  ep->shards_held &=~ (1ull << (shard - ep->shards));
+  return n;
+}
+
+
+/* Called on entry to epoll_wait() when the set uses shards.  Returns the
+ * calling thread's shard, and takes back the members of shards whose
+ * owners have been away for longer than CITP_EPOLL_SHARD_IDLE_MS.  Caller
+ * must lock ep.
+ */
+static struct citp_epoll_shard*
+citp_epoll_shard_enter(struct citp_epoll_fd* ep, ci_uint64 now_frc)
+{
+  /* This only spreads threads over the shards, so racing updates of
+   * [next_shard] are harmless. */
+  static unsigned next_shard;
+  struct oo_per_thread* pt = __oo_per_thread_get();
+  ci_uint64 idle_frc = (ci_uint64) citp.cpu_khz * CITP_EPOLL_SHARD_IDLE_MS;
+  ci_uint64 stale;
+  int i, n;
+
+  CI_BUILD_ASSERT(CITP_EPOLL_SHARDS <= 64);
+
+  if(CI_UNLIKELY( pt->epoll_shard == 0 ))
+    pt->epoll_shard = next_shard++ % CITP_EPOLL_SHARDS + 1;
+  i = pt->epoll_shard - 1;
+  ep->shards_polling |= 1ull << i;
+
+  stale = ep->shards_held & ~ep->shards_polling;
+  while( stale != 0 ) {
+    i = ci_ffs64(stale) - 1;
+    stale &=~ (1ull << i);
+    if( now_frc - ep->shards[i].last_frc > idle_frc ) {
+      n = citp_epoll_shard_release(ep, &ep->shards[i]);
+      if( n != 0 && ep->home_stack != NULL )
+        CITP_STATS_NETIF_ADD(ep->home_stack, epoll_shard_reclaims, n);
+    }
+  }
+
+  return &ep->shards[pt->epoll_shard - 1];
+}
+
+
+/* Called when a thread leaves epoll_wait(), or blocks in it.  A thread
+ * that blocks gives its members back to the set, as nothing would wake it
+ * for them.  Caller must lock ep.
+ */
+static void citp_epoll_shard_leave(struct citp_epoll_fd* ep,
+                                   struct citp_epoll_shard* shard,
+                                   int blocking)
+{
+  ep->shards_polling &=~ (1ull << (shard - ep->shards));
+  ci_frc64(&shard->last_frc);
+  if( blocking && ci_dllist_not_empty(&shard->ready) )
+    citp_epoll_shard_release(ep, shard);
+}
+
+
+/* Puts a home member that is on its stack's ready list on the list to be
+ * polled.  A member that a shard already owns stays with it; others are
+ * dealt round-robin to the shards of the threads polling the set.  Caller
+ * must lock ep.
+ */
+static void citp_epoll_shard_deal(struct citp_epoll_fd* ep,
+                                  struct citp_epoll_member* eitem)
+{
+  if( ! citp_epoll_is_shard_list(ep, eitem->item_list) &&
+      ep->shards_polling != 0 ) {
+    ci_uint64 later = ep->shards_polling & (~0ull << ep->shard_deal);
+    int i = ci_ffs64(later != 0 ? later : ep->shards_polling) - 1;
+    ep->shard_deal = (i + 1) % CITP_EPOLL_SHARDS;
+    ep->shards_held |= 1ull << i;
+    eitem->item_list = &ep->shards[i].ready;
+  }
+  ci_dllist_push_tail(eitem->item_list, &eitem->dllink);
+}
+
+
 static int citp_epoll_sb_state_alloc(citp_socket* sock)
 {
   oo_p sp;
@@ -465,6 +567,9 @@ static void citp_epoll_dtor(citp_fdinfo* fdi, int fdt_locked)
   ep->closing = 1;
 
   if( ep->home_stack ) {
+    int i;
+    for( i = 0; i < CITP_EPOLL_SHARDS; ++i )
+      citp_epoll_shard_release(ep, &ep->shards[i]);
     /* Cleaning up the dead sockets must be done first, to ensure that they're
      * removed from the other lists before we process them.
      */
@@ -582,6 +687,7 @@ int citp_epoll_create(int size, int flags)
   int            fd;
   int            shared_fd;
   int            rc;
+  int            i;
 
   if( (epi = CI_ALLOC_OBJ(citp_epoll_fdi)) == NULL )
     goto fail0;
@@ -645,6 +751,16 @@ int citp_epoll_create(int size, int flags)
   ep->avoid_spin_once = 0;
   ep->closing = 0;
   ep->phase = 0;
+  memset(&ep->spin_adapt, 0, sizeof(ep->spin_adapt));
+  ep->mt = CITP_OPTS.ul_epoll_mt && ep->not_mt_safe;
+  ep->shards_polling = 0;
+  ep->shards_held = 0;
+  ep->shard_deal = 0;
+  ep->n_blocked = 0;
+  for( i = 0; i < CITP_EPOLL_SHARDS; ++i ) {
+    ci_dllist_init(&ep->shards[i].ready);
+    ep->shards[i].last_frc = 0;
+  }
   citp_fdtable_insert(fdi, fd, 0);
   Log_POLL(ci_log("%s: fd=%d driver_fd=%d epfd=%d", __FUNCTION__,
                   fd, ep->epfd_os, (int) ep->shared->epfd));
@@ -693,6 +809,19 @@ ci_inline int epoll_event_eq(const struct epoll_event*__restrict__ a,
 }
 
 
+/* The event to give the kernel's copy of the set for a member.  The kernel
+ * refuses EPOLL_CTL_MOD of a member added with EPOLLEXCLUSIVE, and we
+ * re-sync members with EPOLL_CTL_MOD, so the flag is kept to ourselves.
+ */
+ci_inline struct epoll_event
+citp_epoll_kernel_event(const struct epoll_event* ev)
+{
+  struct epoll_event kev = *ev;
+  kev.events &=~ EPOLLEXCLUSIVE;
+  return kev;
+}
+
+
 /* Return true if kernel has up-to-date state for this eitem. */
 ci_inline int citp_eitem_is_synced(const struct citp_epoll_member* eitem)
 {
@@ -1001,7 +1130,14 @@ static int citp_epoll_ctl_onload_mod(struct citp_epoll_member* eitem,
                                      citp_fdinfo* fd_fdi)
 {
   int rc = 0;
-  if(CI_LIKELY( eitem != NULL )) {
+  if(CI_UNLIKELY( eitem != NULL &&
+                  (eitem->epoll_data.events & EPOLLEXCLUSIVE) )) {
+    /* The kernel does not allow members added with EPOLLEXCLUSIVE to be
+     * modified. */
+    errno = EINVAL;
+    rc = -1;
+  }
+  else if(CI_LIKELY( eitem != NULL )) {
     eitem->epoll_data = *event;
     eitem->epoll_data.events |= EPOLLERR | EPOLLHUP;
     citp_eitem_reset_epollet(eitem, fd_fdi);
@@ -1143,7 +1279,13 @@ static int citp_epoll_ctl_onload2(struct citp_epoll_fd* ep, int op,
       errno = saved_errno;
       eitem->flags |= CITP_EITEM_FLAG_OS_SYNC;
     }
-    rc = ci_sys_epoll_ctl(epoll_fd, sync_op, fd_fdi->fd, event);
+    if( event != NULL ) {
+      struct epoll_event kev = citp_epoll_kernel_event(event);
+      rc = ci_sys_epoll_ctl(epoll_fd, sync_op, fd_fdi->fd, &kev);
+    }
+    else {
+      rc = ci_sys_epoll_ctl(epoll_fd, sync_op, fd_fdi->fd, event);
+    }
     if( rc < 0 )
       Log_E(ci_log("%s("EPOLL_CTL_FMT"): ERROR: sys_epoll_ctl(%s) failed (%d)",
                    __FUNCTION__,
@@ -1260,6 +1402,17 @@ static int citp_epoll_ctl_onload(citp_fdinfo* fdi, int op,
     return -1;
   }
 
+  /* As for the kernel: EPOLLEXCLUSIVE can only be given to EPOLL_CTL_ADD,
+   * and only with the events below.
+   */
+  if( op != EPOLL_CTL_DEL && (event->events & EPOLLEXCLUSIVE) &&
+      (op == EPOLL_CTL_MOD ||
+       (event->events & ~(EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP |
+                          EPOLLWAKEUP | EPOLLET | EPOLLEXCLUSIVE))) ) {
+    errno = EINVAL;
+    return -1;
+  }
+
   if( ep->not_mt_safe ) {
     if( CITP_OPTS.ul_epoll_ctl_handoff ) {
       /* We need the lock, but epoll_wait() holds it while spinning.  We
@@ -1344,6 +1497,7 @@ int citp_epoll_ctl(citp_fdinfo* fdi, int op, int fd, struct epoll_event *event)
 static void citp_ul_epoll_ctl_sync_fd(int epfd, struct citp_epoll_fd* ep,
                                       struct citp_epoll_member* eitem)
 {
+  struct epoll_event kev;
   int rc, op;
 
   if( eitem->epfd_event.events == EP_NOT_REGISTERED ) {
@@ -1372,7 +1526,8 @@ static void citp_ul_epoll_ctl_sync_fd(int epfd, struct citp_epoll_fd* ep,
      * So, we should restore errno. */
     errno = saved_errno;
   }
-  rc = ci_sys_epoll_ctl(epfd, op, eitem->fd, &eitem->epoll_data);
+  kev = citp_epoll_kernel_event(&eitem->epoll_data);
+  rc = ci_sys_epoll_ctl(epfd, op, eitem->fd, &kev);
   if( rc < 0 )
     Log_E(ci_log("%s: ERROR: sys_epoll_ctl("EPOLL_CTL_FMT") failed (%d,%d)",
                  __FUNCTION__,
@@ -1530,10 +1685,13 @@ static void citp_epoll_get_ready_list(struct oo_ul_epoll_state*
      * number of sockets.
      */
     eitem->flags &=~ CITP_EITEM_FLAG_POLL_END;
-    ci_dllist_push_tail(&eps->ep->oo_stack_sockets,
-                        &((struct citp_epoll_member*)eitem)->dllink);
+    if( eps->shard != NULL )
+      citp_epoll_shard_deal(eps->ep, eitem);
+    else
+      ci_dllist_push_tail(&eps->ep->oo_stack_sockets,
+                          &((struct citp_epoll_member*)eitem)->dllink);
   }
-  if( eitem ) {
+  if( eitem && eps->shard == NULL ) {
     /* mark that when we remove this item from ready list we shall poll
      * other as well as os fds */
     eitem->flags |= CITP_EITEM_FLAG_POLL_END;
@@ -1542,40 +1700,59 @@ static void citp_epoll_get_ready_list(struct oo_ul_epoll_state*
 }
 
 
-static void citp_epoll_poll_home_socks(struct oo_ul_epoll_state*
-                                       __restrict__ eps)
+/* Polls the home members on [list].  Returns true if the end of the list
+ * was reached.  Caller must hold the fdtable lock if it is not MT-safe.
+ */
+static int citp_epoll_poll_home_list(struct oo_ul_epoll_state*
+                                     __restrict__ eps, ci_dllist* list)
 {
   struct citp_epoll_member* eitem;
   ci_dllink *next, *last;
   int stored_event;
 
-  if( ci_dllist_not_empty(&eps->ep->oo_stack_sockets) ) {
-    if( citp_fdtable_not_mt_safe() )
-      CITP_FDTABLE_LOCK_RD();
+  if( ci_dllist_is_empty(list) )
+    return 1;
+  if( eps->events == eps->events_top )
+    return 0;
 
-    last = ci_dllist_last(&eps->ep->oo_stack_sockets);
-    next = ci_dllist_start(&eps->ep->oo_stack_sockets);
+  last = ci_dllist_last(list);
+  next = ci_dllist_start(list);
 
-    do {
-      eitem = CI_CONTAINER(struct citp_epoll_member, dllink, next);
-      if( eitem->flags & CITP_EITEM_FLAG_POLL_END )
-        eps->phase |= EPOLL_PHASE_DONE_ACCELERATED;
-      next = next->next;
-      stored_event = citp_ul_epoll_one(eps, eitem);
-      if( !stored_event ) {
-        ci_dllist_remove(&eitem->dllink);
-        ci_dllist_push(&eps->ep->oo_stack_not_ready_sockets, &eitem->dllink);
-      }
-    } while( eps->events < eps->events_top && &eitem->dllink != last );
+  do {
+    eitem = CI_CONTAINER(struct citp_epoll_member, dllink, next);
+    if( eitem->flags & CITP_EITEM_FLAG_POLL_END )
+      eps->phase |= EPOLL_PHASE_DONE_ACCELERATED;
+    next = next->next;
+    stored_event = citp_ul_epoll_one(eps, eitem);
+    if( !stored_event ) {
+      ci_dllist_remove(&eitem->dllink);
+      eitem->item_list = &eps->ep->oo_stack_sockets;
+      ci_dllist_push(&eps->ep->oo_stack_not_ready_sockets, &eitem->dllink);
+    }
+  } while( eps->events < eps->events_top && &eitem->dllink != last );
 
-    if( &eitem->dllink == last )
-      eps->phase = EPOLL_PHASE_DONE_ACCELERATED;
+  return &eitem->dllink == last;
+}
 
-    if( citp_fdtable_not_mt_safe() )
-      CITP_FDTABLE_UNLOCK_RD();
-  }
-  else
+
+static void citp_epoll_poll_home_socks(struct oo_ul_epoll_state*
+                                       __restrict__ eps)
+{
+  int done;
+
+  if( citp_fdtable_not_mt_safe() )
+    CITP_FDTABLE_LOCK_RD();
+
+  /* Members this thread owns come first. */
+  done = eps->shard == NULL ||
+         citp_epoll_poll_home_list(eps, &eps->shard->ready);
+  if( done )
+    done = citp_epoll_poll_home_list(eps, &eps->ep->oo_stack_sockets);
+  if( done )
     eps->phase = EPOLL_PHASE_DONE_ACCELERATED;
+
+  if( citp_fdtable_not_mt_safe() )
+    CITP_FDTABLE_UNLOCK_RD();
   FDTABLE_ASSERT_VALID();
 }
 
@@ -1731,13 +1908,16 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
 {
   struct citp_epoll_fd* ep = fdi_to_epoll(fdi);
   struct oo_ul_epoll_state eps;
-  ci_uint64 poll_start_frc;
+  ci_uint64 poll_start_frc, wait_start_frc;
+  ci_uint64 spin_cycles = citp.spin_cycles;
   int rc = 0, rc_os = 0;
 #if CI_LIBC_HAS_epoll_pwait
   sigset_t sigsaved;
   int pwait_was_spinning = 0;
 #endif
   int have_spin = 0;
+  int spin_adapt;
+  int wake_other = 0;
 
   ci_assert_ge(timeout_hr, 0);
   ci_assert_le(timeout_hr, OO_EPOLL_MAX_TIMEOUT_HR);
@@ -1767,7 +1947,7 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
   if( ((CITP_OPTS.ul_epoll == 1 || ! ep->not_mt_safe) &&
        ci_dllist_is_empty(&ep->oo_stack_sockets) &&
        ci_dllist_is_empty(&ep->oo_stack_not_ready_sockets) &&
-       ci_dllist_is_empty(&ep->oo_sockets)) ||
+       ci_dllist_is_empty(&ep->oo_sockets) && ep->shards_held == 0) ||
       maxevents <= 0 || events == NULL ) {
     /* No accelerated fds or invalid parameters). */
     int timeout_ms = timeout_hr_to_ms(timeout_hr);
@@ -1814,6 +1994,14 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
     eps.ul_epoll_spin |=
       oo_per_thread_get()->spinstate & (1 << ONLOAD_SPIN_SO_BUSY_POLL);
   }
+  eps.shard = NULL;
+  if( ep->mt && ep->home_stack != NULL )
+    eps.shard = citp_epoll_shard_enter(ep, poll_start_frc);
+  wait_start_frc = poll_start_frc;
+  spin_adapt = eps.ul_epoll_spin && CITP_OPTS.ul_spin_adaptive;
+  if( spin_adapt )
+    spin_cycles = oo_spin_adapt_budget(ep->home_stack, &ep->spin_adapt,
+                                       spin_cycles);
 
   if(CI_UNLIKELY( eps.phase )) {
     /* In last epoll_wait we have not managed to obtain all the
@@ -1924,6 +2112,9 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
     if( rc == maxevents )
       ep->phase = eps.phase;
 
+    if( have_spin && spin_adapt )
+      oo_spin_adapt_record(ep->home_stack, &ep->spin_adapt, wait_start_frc, 1);
+
     /* If we've been spinning for some time before getting events, then any
      * events are probably past the limit being used for ordering.  Tell caller
      * that it would be worth polling again.
@@ -1945,11 +2136,14 @@ no_events:
                          ordering ?  ordering->ordering_info : NULL, maxevents);
   if( rc != 0 || timeout_hr == 0 ) {
     Log_POLL(ci_log("%s(%d): %d kernel events", __FUNCTION__, fdi->fd, rc));
+    if( rc > 0 && have_spin && spin_adapt )
+      oo_spin_adapt_record(ep->home_stack, &ep->spin_adapt, wait_start_frc, 1);
     goto unlock_release_exit_ret;
   }
 
   /* Blocking.  Shall we spin? */
-  if( KEEP_POLLING(eps.ul_epoll_spin, eps.this_poll_frc, poll_start_frc) ) {
+  if( KEEP_POLLING_FOR(eps.ul_epoll_spin, eps.this_poll_frc, poll_start_frc,
+                       spin_cycles) ) {
 #if CI_LIBC_HAS_epoll_pwait
     if( !pwait_was_spinning && sigmask != NULL) {
       if( ep->avoid_spin_once ) {
@@ -1959,6 +2153,8 @@ no_events:
       }
       rc = citp_ul_pwait_spin_pre(lib_context, sigmask, &sigsaved);
       if( rc != 0 ) {
+        if( eps.shard != NULL )
+          citp_epoll_shard_leave(ep, eps.shard, 0);
         CITP_EPOLL_EP_UNLOCK(ep, 0);
         citp_exit_lib(lib_context, CI_FALSE);
         return rc;
@@ -1968,8 +2164,11 @@ no_events:
 #endif
 
     /* Has another thread queued any epoll_ctl requests or
-     * blocking on the lock?  See citp_epoll_ctl_onload(). */
-    if( CITP_OPTS.ul_epoll_ctl_handoff ) {
+     * blocking on the lock?  See citp_epoll_ctl_onload().  With shards
+     * the lock is always dropped, so that other threads waiting on the set
+     * can take their turn.
+     */
+    if( CITP_OPTS.ul_epoll_ctl_handoff && ! ep->mt ) {
       oo_wqlock_try_drain_work(&ep->lock, (void*)(uintptr_t) 0);
     }
     else {
@@ -2031,7 +2230,18 @@ no_events:
       ( ! CITP_OPTS.ul_epoll_ctl_fast || (rc == 0 && timeout_hr != 0) ) ) {
     citp_ul_epoll_ctl_sync(ep, fdi->fd);
   }
+  if( eps.shard != NULL ) {
+    citp_epoll_shard_leave(ep, eps.shard, rc == 0 && timeout_hr != 0);
+    /* We may have left ready members behind for lack of space, and as the
+     * threads blocked on the set are woken one at a time nothing else
+     * would wake another of them for these.
+     */
+    wake_other = rc == maxevents && ep->n_blocked != 0 &&
+                 ci_dllist_not_empty(&ep->oo_stack_sockets);
+  }
   CITP_EPOLL_EP_UNLOCK(ep, 0);
+  if( wake_other )
+    ci_sys_ioctl(ep->epfd_os, OO_EPOLL1_IOC_WAKE_ONE);
   Log_POLL(ci_log("%s(%d): to kernel", __FUNCTION__, fdi->fd));
 
 #if CI_LIBC_HAS_epoll_pwait
@@ -2099,11 +2309,11 @@ no_events:
   else {
     struct oo_epoll1_block_on_arg op;
 
-    op.flags = 0;
+    op.flags = ep->mt ? OO_EPOLL1_EXCLUSIVE : 0;
     op.epoll_fd = fdi->fd;
 #if CI_LIBC_HAS_epoll_pwait
     if( sigmask != NULL ) {
-      op.flags = OO_EPOLL1_HAS_SIGMASK;
+      op.flags |= OO_EPOLL1_HAS_SIGMASK;
       op.sigmask = *(ci_uint64*)sigmask;
     }
 #endif
@@ -2113,7 +2323,9 @@ no_events:
      * function call blocking for slightly longer than expected when we have
      * already spun for a bit. */
     op.timeout_us = timeout_hr_to_us(timeout_hr);
+    ci_atomic32_inc(&ep->n_blocked);
     rc = ci_sys_ioctl(ep->epfd_os, OO_EPOLL1_IOC_BLOCK_ON, &op);
+    ci_atomic32_dec(&ep->n_blocked);
 
     ep->blocking = 0;
     Log_POLL(ci_log("%s(%d): BLOCK_ON rc=%d op.flags=%d", __FUNCTION__,
@@ -2136,8 +2348,24 @@ no_events:
         CITP_EPOLL_EP_LOCK(ep);
         /* We MUST check that home stack has not disappeared while we were
          * waiting. */
-        if( eps.ep->home_stack )
+        if( eps.ep->home_stack ) {
+          ci_netif* ni = eps.ep->home_stack;
+          struct epoll_event* home_events = eps.events;
+          if( ep->mt ) {
+            ci_uint64 now_frc;
+            ci_frc64(&now_frc);
+            eps.shard = citp_epoll_shard_enter(ep, now_frc);
+          }
           citp_epoll_poll_ul_home_stack(&eps);
+          if( eps.shard != NULL )
+            citp_epoll_shard_leave(ep, eps.shard, eps.events == home_events);
+          CITP_STATS_NETIF_INC(ni, epoll_wakeups);
+          if( eps.events == home_events )
+            CITP_STATS_NETIF_INC(ni, epoll_wakeups_empty);
+          else
+            CITP_STATS_NETIF_ADD(ni, epoll_wakeup_events,
+                                 eps.events - home_events);
+        }
         CITP_EPOLL_EP_UNLOCK(ep, 0);
 
         citp_exit_lib(lib_context, FALSE);
@@ -2166,6 +2394,10 @@ no_events:
     ordering->next_timeout_hr = timeout_hr;
   }
 
+  /* Not under [ep->lock], but losing the odd sample is harmless. */
+  if( rc > 0 && spin_adapt )
+    oo_spin_adapt_record(ep->home_stack, &ep->spin_adapt, wait_start_frc, 0);
+
   Log_POLL(ci_log("%s(%d): to kernel => %d (%d)", __FUNCTION__, fdi->fd,
                   rc, errno));
   return rc;
@@ -2192,6 +2424,15 @@ citp_epoll_hook_start(struct citp_epoll_fd* ep, citp_fdinfo* fd_fdi,
     if( eitem->fd == fd_fdi->fd && eitem->fdi_seq == fd_fdi->seq )
       return eitem;
   }
+  if( ep->shards_held != 0 ) {
+    int i;
+    for( i = 0; i < CITP_EPOLL_SHARDS; ++i )
+      CI_DLLIST_FOR_EACH2(struct citp_epoll_member, eitem,
+                          dllink, &ep->shards[i].ready) {
+        if( eitem->fd == fd_fdi->fd && eitem->fdi_seq == fd_fdi->seq )
+          return eitem;
+      }
+  }
 
   CI_DLLIST_FOR_EACH2(struct citp_epoll_member, eitem,
                       dllink, &ep->oo_sockets) {
@@ -2451,8 +2692,15 @@ citp_ul_epoll_store_event(struct oo_ul_epoll_state*__restrict__ eps,
 #endif
 
   ci_assert(eitem->item_list == &eps->ep->oo_sockets ||
-            eitem->item_list == &eps->ep->oo_stack_sockets);
+            eitem->item_list == &eps->ep->oo_stack_sockets ||
+            citp_epoll_is_shard_list(eps->ep, eitem->item_list));
   ci_dllist_remove_safe(&eitem->dllink);
+  /* With shards, a home member stays with the thread that reported it for
+   * as long as it is ready. */
+  if( eps->shard != NULL && eitem->ready_list_id >= 0 ) {
+    eitem->item_list = &eps->shard->ready;
+    eps->ep->shards_held |= 1ull << (eps->shard - eps->ep->shards);
+  }
   ci_assert_lt(eitem->fd, citp_fdtable.inited_count);
   if( eitem->epoll_data.events & (EPOLLONESHOT | EPOLLET) )
     eps->has_epollet = 1;
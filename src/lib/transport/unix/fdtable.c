@@ -302,6 +302,7 @@ citp_fdtable_probe_restore(int fd, ci_ep_info_t * info, int print_banner)
 
     sock_fdi->sock.s = SP_TO_SOCK_CMN(ni, info->sock_id);
     sock_fdi->sock.netif = ni;
+    memset(&sock_fdi->sock.spin_adapt, 0, sizeof(sock_fdi->sock.spin_adapt));
   }
   else if( info->fd_type == CI_PRIV_TYPE_PASSTHROUGH_EP ) {
     citp_waitable* w = SP_TO_WAITABLE(ni, info->sock_id);
@@ -339,6 +340,7 @@ citp_fdtable_probe_restore(int fd, ci_ep_info_t * info, int print_banner)
     }
     sock_fdi->sock.s = SP_TO_SOCK_CMN(alien_ni, w->moved_to_sock_id);
     sock_fdi->sock.netif = alien_ni;
+    memset(&sock_fdi->sock.spin_adapt, 0, sizeof(sock_fdi->sock.spin_adapt));
     citp_netif_release_ref(ni, 1);
 
     /* Replace the file under this fd if possible */
@@ -20,6 +20,7 @@
 #include <onload/ul/tcp_helper.h>
 #include <onload/oo_pipe.h>
 #include <onload/tcp_poll.h>
+#include <limits.h>
 
 
 #define VERB(x) Log_VTC(x)
@@ -337,6 +338,153 @@ int citp_pipe_splice_read(citp_fdinfo* fdi, int alien_fd, loff_t* alien_off,
     return read_len;
   return rc;
 }
+
+
+/* Splices from a pipe to a TCP socket in the same stack.  Buffers which
+ * arrived in the pipe from a TCP socket are moved onto the send queue;
+ * anything else is copied as for any other descriptor.
+ */
+int citp_splice_pipe_tcp(citp_fdinfo* pipe_fdi, citp_fdinfo* sock_fdi,
+                         int sock_fd, size_t len, int flags,
+                         citp_lib_context_t* lib_context)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(pipe_fdi);
+  ci_sock_cmn* s = fdi_to_socket(sock_fdi)->s;
+  int rc;
+
+  if( ! fdi_is_reader(pipe_fdi) ) {
+    errno = EINVAL;
+    return -1;
+  }
+  if( len == 0 )
+    return 0;
+
+  if( s->b.state != CI_TCP_LISTEN ) {
+    rc = ci_pipe_splice_to_tcp(epi->ni, epi->pipe, SOCK_TO_TCP(s), len,
+                               ((flags & SPLICE_F_NONBLOCK) ?
+                                MSG_DONTWAIT : 0) |
+                               ((flags & SPLICE_F_MORE) ? MSG_MORE : 0));
+    if( rc != 0 )
+      return rc;
+  }
+  CITP_STATS_NETIF_INC(epi->ni, tcp_splice_copies);
+  return citp_pipe_splice_read(pipe_fdi, sock_fd, NULL, len, flags,
+                               lib_context);
+}
+
+
+/* Splices from a TCP socket to a pipe in the same stack.  Whole receive
+ * buffers are moved into the pipe; if there are none to move, the data is
+ * copied as for any other descriptor, and that path does any blocking.
+ */
+int citp_splice_tcp_pipe(citp_fdinfo* sock_fdi, int sock_fd,
+                         citp_fdinfo* pipe_fdi, size_t len, int flags,
+                         citp_lib_context_t* lib_context)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(pipe_fdi);
+  ci_sock_cmn* s = fdi_to_socket(sock_fdi)->s;
+  int rc;
+
+  if( fdi_is_reader(pipe_fdi) ) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if( s->b.state != CI_TCP_LISTEN ) {
+    rc = ci_pipe_splice_from_tcp(epi->ni, epi->pipe, SOCK_TO_TCP(s), len);
+    if( rc > 0 )
+      return rc;
+  }
+  CITP_STATS_NETIF_INC(epi->ni, tcp_splice_copies);
+  return citp_pipe_splice_write(pipe_fdi, sock_fd, NULL, len, flags,
+                                lib_context);
+}
+
+
+struct oo_vmsplice_read_context {
+  const struct iovec* iov;
+  unsigned long iov_num;
+};
+
+
+static int oo_vmsplice_read_cb(void* context, struct iovec* iov,
+                               int iov_num, int flags)
+{
+  struct oo_vmsplice_read_context* ctx = context;
+  const struct iovec* to = ctx->iov;
+  unsigned long to_num = ctx->iov_num;
+  size_t to_off = 0, from_off, n;
+  int i, copied = 0;
+
+  for( i = 0; i < iov_num; ++i )
+    for( from_off = 0; from_off < iov[i].iov_len; ) {
+      if( to_off == to->iov_len ) {
+        if( --to_num == 0 )
+          return copied;
+        ++to;
+        to_off = 0;
+        continue;
+      }
+      n = CI_MIN(iov[i].iov_len - from_off, to->iov_len - to_off);
+      memcpy((char*) to->iov_base + to_off,
+             (char*) iov[i].iov_base + from_off, n);
+      to_off += n;
+      from_off += n;
+      copied += n;
+    }
+  return copied;
+}
+
+
+/* vmsplice() on an Onload pipe.  The pipe's buffers are the stack's packet
+ * buffers, so user pages cannot be mapped into the pipe: the data is
+ * copied, and SPLICE_F_GIFT is ignored.
+ */
+int citp_pipe_vmsplice(citp_fdinfo* fdi, const struct iovec* iov,
+                       unsigned long nr_segs, int flags)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdi);
+  int msg_flags = (flags & SPLICE_F_NONBLOCK) ? MSG_DONTWAIT : 0;
+  struct oo_vmsplice_read_context ctx = {
+    .iov = iov,
+    .iov_num = nr_segs,
+  };
+  size_t len = 0;
+  unsigned long i;
+
+  if( nr_segs > IOV_MAX ) {
+    errno = EINVAL;
+    return -1;
+  }
+  for( i = 0; i < nr_segs; ++i )
+    len += iov[i].iov_len;
+  if( len == 0 )
+    return 0;
+
+  if( ! fdi_is_reader(fdi) )
+    return ci_pipe_write_flags(epi->ni, epi->pipe, iov, nr_segs, msg_flags);
+  return ci_pipe_zc_read(epi->ni, epi->pipe, CI_MIN(len, INT_MAX), msg_flags,
+                         oo_vmsplice_read_cb, &ctx);
+}
+
+
+int citp_pipe_tee(citp_fdinfo* in_fdi, citp_fdinfo* out_fdi, size_t len,
+                  int flags)
+{
+  citp_pipe_fdi* in_epi = fdi_to_pipe_fdi(in_fdi);
+  citp_pipe_fdi* out_epi = fdi_to_pipe_fdi(out_fdi);
+
+  if( ! fdi_is_reader(in_fdi) || fdi_is_reader(out_fdi) ||
+      in_epi->pipe == out_epi->pipe ) {
+    errno = EINVAL;
+    return -1;
+  }
+  if( len == 0 )
+    return 0;
+  return ci_pipe_tee(in_epi->ni, in_epi->pipe, out_epi->pipe,
+                     CI_MIN(len, INT_MAX),
+                     (flags & SPLICE_F_NONBLOCK) ? MSG_DONTWAIT : 0);
+}
 #endif
 
 
@@ -1836,6 +1836,20 @@ OO_INTERCEPT(ci_splice_return_type, splice, (int in_fd, loff_t* in_off,
       rc = CI_SOCKET_ERROR;
     }
   }
+  else if( in_fdi && citp_fdinfo_get_type(in_fdi) == CITP_PIPE_FD &&
+           out_fdi && citp_fdinfo_get_type(out_fdi) == CITP_TCP_SOCKET &&
+           fdi_to_pipe_fdi(in_fdi)->ni == fdi_to_socket(out_fdi)->netif &&
+           in_off == NULL && out_off == NULL ) {
+    rc = citp_splice_pipe_tcp(in_fdi, out_fdi, out_fd, len, flags,
+                              &lib_context);
+  }
+  else if( out_fdi && citp_fdinfo_get_type(out_fdi) == CITP_PIPE_FD &&
+           in_fdi && citp_fdinfo_get_type(in_fdi) == CITP_TCP_SOCKET &&
+           fdi_to_pipe_fdi(out_fdi)->ni == fdi_to_socket(in_fdi)->netif &&
+           in_off == NULL && out_off == NULL ) {
+    rc = citp_splice_tcp_pipe(in_fdi, in_fd, out_fdi, len, flags,
+                              &lib_context);
+  }
   else if( in_fdi && citp_fdinfo_get_type(in_fdi) == CITP_PIPE_FD ) {
     if( in_off == NULL ) {
       rc = citp_pipe_splice_read(in_fdi, out_fd, out_off, len, flags,
@@ -1881,6 +1895,107 @@ OO_INTERCEPT(ci_splice_return_type, splice, (int in_fd, loff_t* in_off,
   return ci_sys_splice(in_fd, in_off, out_fd, out_off, len, flags);
 }
 #endif
+
+
+OO_INTERCEPT(ci_splice_return_type, vmsplice,
+             (int fd, const struct iovec* iov, size_t nr_segs,
+              unsigned int flags))
+#if CI_CFG_USERSPACE_PIPE
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  int rc = 0, via_os = 0;
+
+  if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) ) {
+    citp_do_init(CITP_INIT_SYSCALLS);
+    return ci_sys_vmsplice(fd, iov, nr_segs, flags);
+  }
+  citp_enter_lib(&lib_context);
+  Log_CALL(ci_log("%s(%d, %p, %u, 0x%x)", __FUNCTION__,
+                  fd, iov, (unsigned) nr_segs, flags));
+
+  fdi = citp_fdtable_lookup(fd);
+  if( fdi && citp_fdinfo_get_type(fdi) == CITP_PIPE_FD )
+    rc = citp_pipe_vmsplice(fdi, iov, nr_segs, flags);
+  else
+    via_os = 1;
+
+  if( fdi )
+    citp_fdinfo_release_ref(fdi, 0);
+  citp_exit_lib(&lib_context, rc >= 0);
+
+  if( via_os ) {
+    Log_PT(log("PT: sys_vmsplice(%d, %p, %u, 0x%x)",
+               fd, iov, (unsigned) nr_segs, flags));
+    rc = ci_sys_vmsplice(fd, iov, nr_segs, flags);
+  }
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+#else
+{
+  if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) )
+    citp_do_init(CITP_INIT_SYSCALLS);
+  return ci_sys_vmsplice(fd, iov, nr_segs, flags);
+}
+#endif
+
+
+OO_INTERCEPT(ci_splice_return_type, tee,
+             (int in_fd, int out_fd, size_t len, unsigned int flags))
+#if CI_CFG_USERSPACE_PIPE
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo *out_fdi, *in_fdi;
+  int rc = 0, via_os = 0;
+
+  if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) ) {
+    citp_do_init(CITP_INIT_SYSCALLS);
+    return ci_sys_tee(in_fd, out_fd, len, flags);
+  }
+  citp_enter_lib(&lib_context);
+  Log_CALL(ci_log("%s(%d, %d, %u, 0x%x)", __FUNCTION__,
+                  in_fd, out_fd, (unsigned) len, flags));
+
+  in_fdi  = citp_fdtable_lookup(in_fd);
+  out_fdi = citp_fdtable_lookup(out_fd);
+
+  if( in_fdi && citp_fdinfo_get_type(in_fdi) == CITP_PIPE_FD &&
+      out_fdi && citp_fdinfo_get_type(out_fdi) == CITP_PIPE_FD &&
+      fdi_to_pipe_fdi(in_fdi)->ni == fdi_to_pipe_fdi(out_fdi)->ni ) {
+    rc = citp_pipe_tee(in_fdi, out_fdi, len, flags);
+  }
+  else if( (in_fdi && citp_fdinfo_get_type(in_fdi) == CITP_PIPE_FD) ||
+           (out_fdi && citp_fdinfo_get_type(out_fdi) == CITP_PIPE_FD) ) {
+    /* The kernel cannot see into an Onload pipe. */
+    errno = EINVAL;
+    rc = CI_SOCKET_ERROR;
+  }
+  else {
+    via_os = 1;
+  }
+
+  if( out_fdi )
+    citp_fdinfo_release_ref(out_fdi, 0);
+  if( in_fdi )
+    citp_fdinfo_release_ref(in_fdi, 0);
+  citp_exit_lib(&lib_context, rc >= 0);
+
+  if( via_os ) {
+    Log_PT(log("PT: sys_tee(%d, %d, %u, 0x%x)",
+               in_fd, out_fd, (unsigned) len, flags));
+    rc = ci_sys_tee(in_fd, out_fd, len, flags);
+  }
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+#else
+{
+  if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) )
+    citp_do_init(CITP_INIT_SYSCALLS);
+  return ci_sys_tee(in_fd, out_fd, len, flags);
+}
+#endif
 #endif
 
 
@@ -2806,6 +2921,8 @@ OO_INTERCEPT(long, syscall,
 #endif
 #if CI_LIBC_HAS_splice
     NR(splice)
+    NR(vmsplice)
+    NR(tee)
 #endif
     NR(read)
     NR(write)
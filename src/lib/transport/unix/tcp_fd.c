@@ -258,6 +258,7 @@ ci_fd_t ci_tcp_ep_ctor(citp_socket* ep, ci_netif* netif, int domain, int type)
 #endif
   ep->netif = netif;
   ep->s = &ts->s;
+  memset(&ep->spin_adapt, 0, sizeof(ep->spin_adapt));
 
 #ifndef NDEBUG
   /* We hold the only reference to [ep] and its fd is marked busy, so its
@@ -586,12 +587,27 @@ static int citp_tcp_accept_os(citp_sock_fdi* epi, int fd,
 }
 
 
+/* Count an accept against the calling thread's shard of the listener's
+ * accept counters.  Threads are spread over the shards in the order in
+ * which they first accept.
+ */
+static void citp_tcp_accept_count(ci_tcp_socket_listen* listener)
+{
+  static unsigned next_shard;
+  struct oo_per_thread* pt = oo_per_thread_get();
+  if(CI_UNLIKELY( pt->accept_shard == 0 ))
+    pt->accept_shard = next_shard++ % CI_CFG_TCP_ACCEPT_SHARDS + 1;
+  ci_atomic32_inc(&listener->accept_shard_n[pt->accept_shard - 1]);
+}
+
+
 static int citp_tcp_accept_complete(ci_netif* ni,
                                     struct sockaddr* sa, socklen_t* p_sa_len,
                                     ci_tcp_socket_listen* listener,
                                     ci_tcp_state* ts, int newfd)
 {
   CITP_STATS_NETIF(++ni->state->stats.ul_accepts);
+  citp_tcp_accept_count(listener);
 
   if( sa )
     ci_tcp_get_peer_addr(ts, sa, p_sa_len);
@@ -727,6 +743,7 @@ static int citp_tcp_accept_alien(ci_netif* ni, ci_tcp_socket_listen* listener,
 #endif
   newepi->sock.s = &ts->s;
   newepi->sock.netif = ani;
+  memset(&newepi->sock.spin_adapt, 0, sizeof(newepi->sock.spin_adapt));
 
   /* get new file descriptor into table */
   ci_assert(newepi->sock.s->b.sb_aflags & CI_SB_AFLAG_NOT_READY);
@@ -743,34 +760,46 @@ fail:
 }
 
 
+/* If [w] is NULL, the caller holds the sock lock and the accept queue is
+ * not empty.  Otherwise [w] was claimed from the lock-free accept ring and
+ * the caller does not hold the sock lock.  Returns -EAGAIN (without
+ * setting errno) if other threads emptied the accept queue first.
+ */
 static int citp_tcp_accept_ul(citp_fdinfo* fdinfo, ci_netif* ni,
 			      ci_tcp_socket_listen* listener,
 			      struct sockaddr* sa, socklen_t* p_sa_len,
-                              int flags)
+                              int flags, citp_waitable* w)
 {
   citp_sock_fdi* newepi;
   citp_fdinfo* newfdi;
   ci_tcp_state* ts;
-  citp_waitable* w;
   int newfd;
 #if CI_CFG_FD_CACHING
   int from_cache;
 #endif
-  int unlocked = 0;
+  int from_ring = w != NULL;
+  int unlocked = from_ring;
 
   Log_VSS(ci_log(LPF "accept(%d:%d, sa, %d)", fdinfo->fd,
                  S_FMT(listener), p_sa_len ? *p_sa_len : -1));
 #if CI_CFG_FD_CACHING
 redo:
 #endif
-  /* Pop the socket off the accept queue. */
-  ci_assert(ci_sock_is_locked(ni, &listener->s.b));
-  ci_assert(ci_tcp_acceptq_not_empty(listener));
-  w = ci_tcp_acceptq_get(ni, listener);
+  if( w == NULL ) {
+    /* Pop the socket off the accept queue. */
+    ci_assert(ci_sock_is_locked(ni, &listener->s.b));
+    ci_assert(ci_tcp_acceptq_not_empty(listener));
+    w = ci_tcp_acceptq_get(ni, listener);
+    if( w == NULL ) {
+      ci_sock_unlock(ni, &listener->s.b);
+      return -EAGAIN;
+    }
+  }
 
   if( w->sb_aflags & CI_SB_AFLAG_MOVED_AWAY ) {
     int rc;
-    ci_sock_unlock(ni, &listener->s.b);
+    if( ! unlocked )
+      ci_sock_unlock(ni, &listener->s.b);
     rc = citp_tcp_accept_alien(ni, listener, sa, p_sa_len, flags, w);
     if( rc != CI_ACCEPT_FAKED_UP )
       return rc;
@@ -792,10 +821,14 @@ redo:
   from_cache = ci_tcp_is_cached(ts);
   if( from_cache ) {
     /* We need a listening socket lock to remove from the epcache list.
-     * But faked-up loopback connection can't be cached, so we are safe
-     * here. */
-    ci_assert(! unlocked);
+     * Faked-up loopback connections can't be cached, so if we are unlocked
+     * here then [ts] came from the accept ring. */
+    ci_assert(! unlocked || from_ring);
+    if( unlocked )
+      ci_sock_lock(ni, &listener->s.b);
     ci_ni_dllist_remove_safe(ni, &ts->epcache_fd_link);
+    if( unlocked )
+      ci_sock_unlock(ni, &listener->s.b);
   }
 #endif
   if( ! unlocked )
@@ -812,12 +845,20 @@ redo:
     if( newfd == -ENOANO ) {
       Log_EP(ci_log("%s: [%d:%d]. puttint accepted socket back on acceptq",
              __FUNCTION__, NI_ID(ni), S_SP(ts)));
-      ci_tcp_acceptq_put_back_tail(ni, listener, &ts->s.b);
+      if( from_ring )
+        ci_tcp_acceptq_ring_put_back(ni, listener, &ts->s.b);
+      else
+        ci_tcp_acceptq_put_back_tail(ni, listener, &ts->s.b);
       CITP_STATS_NETIF_INC(ni, accept_attach_fd_retry);
       sched_yield();
+      w = NULL;
+      from_ring = unlocked = 0;
       goto redo;
     } else
 #endif
+    if( from_ring )
+      ci_tcp_acceptq_ring_put_back(ni, listener, &ts->s.b);
+    else
       ci_tcp_acceptq_put_back(ni, listener, &ts->s.b);
     CITP_STATS_TCP_LISTEN(++listener->stats.n_accept_no_fd);
     ci_sock_unlock(ni, &listener->s.b);
@@ -848,6 +889,7 @@ redo:
 #endif
   newepi->sock.s = &ts->s;
   newepi->sock.netif = ni;
+  memset(&newepi->sock.spin_adapt, 0, sizeof(newepi->sock.spin_adapt));
   citp_netif_add_ref(ni);
 
 #if CI_CFG_FD_CACHING
@@ -916,16 +958,28 @@ check_ul_accept_q:
   }
 
   if( ci_tcp_acceptq_n(listener) ) {
+      if( CI_UNLIKELY(p_sa_len == NULL && sa != NULL) ) {
+          CI_SET_ERROR(rc, EFAULT);
+          return rc;
+      }
+      if( ci_tcp_acceptq_ring_not_empty(listener) ) {
+          citp_waitable* w = ci_tcp_acceptq_ring_get(ni, listener);
+          if( w != NULL ) {
+              CITP_STATS_NETIF_INC(ni, tcp_accept_ring);
+              return citp_tcp_accept_ul(fdinfo, ni, listener, sa, p_sa_len,
+                                        flags, w);
+          }
+      }
       ci_sock_lock(ni, &listener->s.b);
       if( ci_tcp_acceptq_not_empty(listener) ) {
-          if( CI_UNLIKELY(p_sa_len == NULL && sa != NULL) ) {
-              ci_sock_unlock(ni, &listener->s.b);
-              CI_SET_ERROR(rc, EFAULT);
+          rc = citp_tcp_accept_ul(fdinfo, ni, listener, sa, p_sa_len,
+                                  flags, NULL);
+          if( rc != -EAGAIN )
               return rc;
-          }
-          return citp_tcp_accept_ul(fdinfo, ni, listener, sa, p_sa_len, flags);
+          rc = 0;
       }
-      ci_sock_unlock(ni, &listener->s.b);
+      else
+          ci_sock_unlock(ni, &listener->s.b);
   }
 
   /* User-level accept queue is empty.  Are we up-to-date? */
@@ -1687,6 +1741,7 @@ static int citp_tcp_recv(citp_fdinfo* fdinfo, struct msghdr* msg, int flags)
     }
     ci_tcp_recvmsg_args_init(&a, epi->sock.netif, SOCK_TO_TCP(epi->sock.s),
                              msg, flags);
+    a.spin_adapt = &epi->sock.spin_adapt;
     rc = ci_tcp_recvmsg(&a);
     Log_V(ci_log(LPF "recv("EF_FMT") = %d", EF_PRI_ARGS(epi, fdinfo->fd), rc));
     return rc;
@@ -1710,14 +1765,44 @@ static int citp_tcp_recvmmsg(citp_fdinfo* fdinfo, struct mmsghdr* msg,
 }
 #endif
 
+static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
+                         int flags);
+
 #if CI_CFG_SENDMMSG
-static int citp_tcp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* msg, 
+/* Each message but the last is sent with MSG_MORE, so that small messages
+ * are coalesced into full segments and the final send pushes them out.
+ */
+static int citp_tcp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* mmsg, 
                              unsigned vlen, int flags)
 {
-  Log_E(ci_log("%s: TCP fd sendmmsg not supported by OpenOnload",
-               __FUNCTION__));
-  errno = ENOSYS;
-  return -1;
+  citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
+  unsigned i;
+  int rc = 0;
+
+  Log_V(log(LPF "sendmmsg(%d, msg, %u, %#x)", fdinfo->fd, vlen,
+            (unsigned) flags));
+
+  for( i = 0; i < vlen; ++i ) {
+    rc = citp_tcp_send(fdinfo, &mmsg[i].msg_hdr,
+                       i + 1 < vlen ? flags | MSG_MORE : flags);
+    if( rc < 0 )
+      break;
+    mmsg[i].msg_len = rc;
+  }
+
+  /* If we stopped early then the data sent so far may be held back by
+   * MSG_MORE, so push it unless the caller asked for that behaviour.
+   */
+  if( i > 0 && i < vlen && ! (flags & MSG_MORE) &&
+      epi->sock.s->b.state != CI_TCP_LISTEN ) {
+    ci_netif* ni = epi->sock.netif;
+    ci_netif_lock(ni);
+    if( ! (epi->sock.s->s_aflags & CI_SOCK_AFLAG_CORK) )
+      ci_tcp_send_corked_packets(ni, SOCK_TO_TCP(epi->sock.s));
+    ci_netif_unlock(ni);
+  }
+
+  return i > 0 ? (int) i : rc;
 }
 #endif
 
@@ -434,7 +434,6 @@ static int citp_udp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* mmsg,
 {
   citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
   ci_udp_iomsg_args a;
-  int i, rc;
 
   Log_V(log(LPF "sendmmsg(%d, msg, %u, %#x)", fdinfo->fd, vlen, 
             (unsigned) flags));
@@ -447,15 +446,7 @@ static int citp_udp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* mmsg,
   a.ni = epi->sock.netif;
   a.us = SOCK_TO_UDP(epi->sock.s);
 
-  i = 0;
-
-  do {
-    rc = ci_udp_sendmsg(&a, &mmsg[i].msg_hdr, flags);
-    if(CI_LIKELY( rc >= 0 ) )
-      mmsg[i].msg_len = rc;
-    ++i;
-  } while( rc >= 0 && i < vlen );
-  return (rc>=0) ? i : rc;
+  return ci_udp_sendmmsg(&a, mmsg, vlen, flags);
 }
 #endif
 
@@ -136,6 +136,27 @@ enum {
 
 #define EPOLL_STACK_EITEM 1
 #define EPOLL_NON_STACK_EITEM 2
+
+/* Ready-list shards for EF_EPOLL_MT.  Each thread that waits on the set
+ * owns one shard.  Home-stack members taken off the stack's ready list are
+ * dealt round-robin to the shards of the threads polling the set, and a
+ * member that is reported stays with the thread that reported it for as
+ * long as it remains ready.  Protected by the set's [lock].
+ */
+#define CITP_EPOLL_SHARDS  64
+
+struct citp_epoll_shard {
+  ci_dllist  ready;     /* home members owned by this shard */
+  ci_uint64  last_frc;  /* when the owner last left epoll_wait() */
+};
+
+/* Members of a shard left alone for this long are given back to the set. */
+#define CITP_EPOLL_SHARD_IDLE_MS  1
+
+#ifndef EPOLLEXCLUSIVE
+# define EPOLLEXCLUSIVE  (1u << 28)
+#endif
+
 /*! Data associated with each epoll epfd.  */
 struct citp_epoll_fd {
   /* epoll_create() parameter */
@@ -194,6 +215,21 @@ struct citp_epoll_fd {
    * value of highest bit matters */
   int phase;
 
+  /* Adaptive spinning state (EF_SPIN_ADAPTIVE). */
+  struct oo_spin_adapt spin_adapt;
+
+  /* EF_EPOLL_MT state: set if the shards are in use, the shards whose
+   * owners are polling the set, the shards that may hold members, the
+   * next shard to deal a ready member to, and the number of threads
+   * blocked in OO_EPOLL1_IOC_BLOCK_ON.
+   */
+  int mt;
+  ci_uint64 shards_polling;
+  ci_uint64 shards_held;
+  unsigned shard_deal;
+  volatile ci_uint32 n_blocked;
+  struct citp_epoll_shard shards[CITP_EPOLL_SHARDS];
+
 #if CI_CFG_TIMESTAMPING
   /* When using WODA with large numbers of sockets performance can be harmed
    * by repeated large alloc/free calls, so we cache memory allocated for this
@@ -260,6 +296,9 @@ struct oo_ul_epoll_state {
 #endif
 
   int phase;
+
+  /* This thread's shard, if the set uses them (EF_EPOLL_MT). */
+  struct citp_epoll_shard* shard;
 };
 
 
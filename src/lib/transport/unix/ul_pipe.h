@@ -30,5 +30,15 @@ extern int citp_pipe_splice_read(citp_fdinfo* fdi, int alien_fd,
                                  loff_t* alien_off,
                                  size_t len, int flags,
                                  citp_lib_context_t* lib_context);
+extern int citp_splice_pipe_tcp(citp_fdinfo* pipe_fdi, citp_fdinfo* sock_fdi,
+                                int sock_fd, size_t len, int flags,
+                                citp_lib_context_t* lib_context);
+extern int citp_splice_tcp_pipe(citp_fdinfo* sock_fdi, int sock_fd,
+                                citp_fdinfo* pipe_fdi, size_t len, int flags,
+                                citp_lib_context_t* lib_context);
+extern int citp_pipe_vmsplice(citp_fdinfo* fdi, const struct iovec* iov,
+                              unsigned long nr_segs, int flags);
+extern int citp_pipe_tee(citp_fdinfo* in_fdi, citp_fdinfo* out_fdi,
+                         size_t len, int flags);
 
 #endif  /* ul_pipe.h */
@@ -21,8 +21,11 @@
 
 #define OO_POLL_MAX_OSP    16
 
+#define KEEP_POLLING_FOR(what, now, start, cycles)                      \
+  (what && (((now) = ci_frc64_get()) - (start) < (cycles)))
+
 #define KEEP_POLLING(what, now, start)                                  \
-  (what && (((now) = ci_frc64_get()) - (start) < citp.spin_cycles))
+  KEEP_POLLING_FOR(what, now, start, citp.spin_cycles)
 
 
 struct oo_ul_poll_state {
@@ -277,6 +277,120 @@ int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 }
 
 
+/* Returns 0 if [fdi] is a TCP socket that can have a receive region, or
+ * the error to return to the caller if not.
+ */
+static int rx_region_check_fdi(citp_fdinfo* fdi)
+{
+  switch( citp_fdinfo_get_type(fdi) ) {
+  case CITP_TCP_SOCKET:
+    return 0;
+  case CITP_UDP_SOCKET:
+    return -EOPNOTSUPP;
+#if CI_CFG_USERSPACE_EPOLL
+  case CITP_EPOLL_FD:
+    return -ENOTSOCK;
+#endif
+#if CI_CFG_USERSPACE_PIPE
+  case CITP_PIPE_FD:
+    return -ENOTSOCK;
+#endif
+  case CITP_PASSTHROUGH_FD:
+    return -ESOCKTNOSUPPORT;
+  default:
+    LOG_U(log("%s: unknown fdinfo type %d", __FUNCTION__,
+              citp_fdinfo_get_type(fdi)));
+    return -EINVAL;
+  }
+}
+
+
+int onload_zc_rx_region_register(int fd, void* base, size_t len)
+{
+  int rc;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  citp_sock_fdi* epi;
+
+  Log_CALL(ci_log("%s(%d, %p, %zu)", __FUNCTION__, fd, base, len));
+
+  citp_enter_lib(&lib_context);
+
+  if( (fdi = citp_fdtable_lookup(fd)) != NULL ) {
+    if( (rc = rx_region_check_fdi(fdi)) == 0 ) {
+      epi = fdi_to_sock_fdi(fdi);
+      rc = ci_tcp_rx_region_register(epi->sock.netif,
+                                     SOCK_TO_TCP(epi->sock.s), base, len);
+    }
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+  else {
+    /* Not onload socket */
+    rc = -ESOCKTNOSUPPORT;
+  }
+
+  citp_exit_lib(&lib_context, TRUE);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_zc_rx_region_get(int fd, size_t* offset)
+{
+  int rc;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  citp_sock_fdi* epi;
+
+  Log_CALL(ci_log("%s(%d, %p)", __FUNCTION__, fd, offset));
+
+  if( (fdi = citp_fdtable_lookup_fast(&lib_context, fd)) ) {
+    if( (rc = rx_region_check_fdi(fdi)) == 0 ) {
+      epi = fdi_to_sock_fdi(fdi);
+      rc = ci_tcp_rx_region_get(epi->sock.netif, SOCK_TO_TCP(epi->sock.s),
+                                offset);
+    }
+    citp_fdinfo_release_ref_fast(fdi);
+    citp_exit_lib(&lib_context, TRUE);
+  }
+  else {
+    citp_exit_lib_if(&lib_context, TRUE);
+    rc = -ESOCKTNOSUPPORT;
+  }
+
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_zc_rx_region_release(int fd, size_t len)
+{
+  int rc;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  citp_sock_fdi* epi;
+
+  Log_CALL(ci_log("%s(%d, %zu)", __FUNCTION__, fd, len));
+
+  if( (fdi = citp_fdtable_lookup_fast(&lib_context, fd)) ) {
+    if( (rc = rx_region_check_fdi(fdi)) == 0 ) {
+      epi = fdi_to_sock_fdi(fdi);
+      rc = ci_tcp_rx_region_release(epi->sock.netif,
+                                    SOCK_TO_TCP(epi->sock.s), len);
+    }
+    citp_fdinfo_release_ref_fast(fdi);
+    citp_exit_lib(&lib_context, TRUE);
+  }
+  else {
+    citp_exit_lib_if(&lib_context, TRUE);
+    rc = -ESOCKTNOSUPPORT;
+  }
+
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 int onload_set_recv_filter(int fd, onload_zc_recv_filter_callback filter,
                            void* cb_arg, int flags)
 {
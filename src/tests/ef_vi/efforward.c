@@ -9,6 +9,8 @@
  * - turn off pause frames with ethtool
  * - increasing the NIC RX/TX descriptor cache sizes may also help
  *   e.g. 'sfboot rx-dc-size=32 tx-dc-size=64 vi-count=1024'
+ * - use '-b' to poll with ef_eventq_poll_batch() and post descriptors with
+ *   ef_vi_receive_post_batch() and ef_vi_transmit_batch()
  *
  * 2011-17 Solarflare Communications Inc.
  * Author: David Riddoch
@@ -93,6 +95,7 @@ static struct pkt_bufs pbs;
 static int cfg_rx_merge = 1;
 static int cfg_unidirectional;
 static int cfg_stats = 1;
+static int cfg_batch;
 
 
 /* Given a id to a packet buffer, look up the data structure.  The ids
@@ -120,6 +123,8 @@ static void vi_refill_rx_ring(int vi_i)
   ef_vi* vi = &vis[vi_i].vi;
 #define REFILL_BATCH_SIZE  64
   struct pkt_buf* pkt_buf;
+  ef_addr addrs[REFILL_BATCH_SIZE];
+  ef_request_id ids[REFILL_BATCH_SIZE];
   int i;
 
   if( ef_vi_receive_space(vi) < REFILL_BATCH_SIZE ||
@@ -130,9 +135,19 @@ static void vi_refill_rx_ring(int vi_i)
     pkt_buf = pbs.free_pool;
     pbs.free_pool = pbs.free_pool->next;
     --pbs.free_pool_n;
-    ef_vi_receive_init(vi, pkt_buf->rx_ef_addr[vi_i], pkt_buf->id);
+    if( cfg_batch ) {
+      addrs[i] = pkt_buf->rx_ef_addr[vi_i];
+      ids[i] = pkt_buf->id;
+    }
+    else {
+      ef_vi_receive_init(vi, pkt_buf->rx_ef_addr[vi_i], pkt_buf->id);
+    }
   }
-  ef_vi_receive_push(vi);
+  if( cfg_batch )
+    TEST(ef_vi_receive_post_batch(vi, addrs, ids, REFILL_BATCH_SIZE) ==
+         REFILL_BATCH_SIZE);
+  else
+    ef_vi_receive_push(vi);
 }
 
 
@@ -195,71 +210,139 @@ static void complete_tx(int vi_i, int pkt_buf_i)
 }
 
 
-/* The main loop.  Poll each VI handling various types of events and
- * then try to refill them. */
+/* Poll a VI with ef_eventq_poll(), handling various types of events. */
+static void poll_vi(int i)
+{
+  ef_vi* vi = &vis[i].vi;
+  int j, k;
+
+  if( vis[i].tx_outstanding ) {
+    ef_vi_transmit_push(vi);
+    vis[i].tx_outstanding = 0;
+  }
+
+  ef_event evs[EF_VI_EVENT_POLL_MIN_EVS];
+  int n_ev = ef_eventq_poll(vi, evs, sizeof(evs) / sizeof(evs[0]));
+
+  for( j = 0; j < n_ev; ++j ) {
+    switch( EF_EVENT_TYPE(evs[j]) ) {
+    case EF_EVENT_TYPE_RX:
+      /* This code does not handle jumbos. */
+      assert(EF_EVENT_RX_SOP(evs[j]) != 0);
+      assert(EF_EVENT_RX_CONT(evs[j]) == 0);
+      handle_rx(i, EF_EVENT_RX_RQ_ID(evs[j]),
+                EF_EVENT_RX_BYTES(evs[j]) -
+                ef_vi_receive_prefix_len(vi));
+      break;
+    case EF_EVENT_TYPE_RX_MULTI: {
+      ef_request_id ids[EF_VI_RECEIVE_BATCH];
+      TEST( EF_EVENT_RX_MULTI_SOP(evs[j])
+            && ! EF_EVENT_RX_MULTI_CONT(evs[j]) );
+      assert( cfg_rx_merge );
+      int n_rx = ef_vi_receive_unbundle(vi, &evs[j], ids);
+      for( k = 0; k < n_rx; ++k )
+        handle_batched_rx(i, ids[k]);
+      break;
+    }
+    case EF_EVENT_TYPE_TX: {
+      ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+      int ntx = ef_vi_transmit_unbundle(vi, &evs[j], ids);
+      for( k = 0; k < ntx; ++k )
+        complete_tx(i, ids[k]);
+      break;
+    }
+    case EF_EVENT_TYPE_RX_DISCARD:
+      handle_rx_discard(EF_EVENT_RX_DISCARD_RQ_ID(evs[j]),
+                        EF_EVENT_RX_DISCARD_TYPE(evs[j]));
+      break;
+    case EF_EVENT_TYPE_RX_MULTI_DISCARD: {
+      ef_request_id ids[EF_VI_RECEIVE_BATCH];
+      TEST( EF_EVENT_RX_MULTI_SOP(evs[j])
+            && ! EF_EVENT_RX_MULTI_CONT(evs[j]) );
+      assert( cfg_rx_merge );
+      int n_rx = ef_vi_receive_unbundle(vi, &evs[j], ids);
+      for( k = 0; k < n_rx; ++k )
+        handle_rx_discard(ids[k],EF_EVENT_RX_MULTI_DISCARD_TYPE(evs[j]));
+      break;
+    }
+    default:
+      LOGE("ERROR: unexpected event %d\n", (int) EF_EVENT_TYPE(evs[j]));
+      break;
+    }
+  }
+}
+
+
+/* Poll a VI with ef_eventq_poll_batch(), and forward everything received
+ * with a single call to ef_vi_transmit_batch().  Events that the batched
+ * poll does not handle are left for poll_vi(). */
+static void poll_vi_batch(int rx_vi_i)
+{
+  int tx_vi_i = 2 - 1 - rx_vi_i;
+  struct vi* rx_vi = &vis[rx_vi_i];
+  struct vi* tx_vi = &vis[tx_vi_i];
+  ef_addr addrs[EF_VI_EVENT_BATCH_RX];
+  int lens[EF_VI_EVENT_BATCH_RX];
+  ef_request_id ids[EF_VI_EVENT_BATCH_RX];
+  ef_event_batch batch;
+  int i, n_tx = 0, n_sent;
+
+  ef_eventq_poll_batch(&rx_vi->vi, &batch);
+
+  for( i = 0; i < batch.n_rx; ++i ) {
+    int pkt_buf_i = batch.rx_rq_id[i];
+    struct pkt_buf* pkt_buf = pkt_buf_from_id(pkt_buf_i);
+    if( batch.rx_flags[i] & EF_EVENT_BATCH_FLAG_DISCARD ) {
+      handle_rx_discard(pkt_buf_i, batch.rx_discard[i]);
+      continue;
+    }
+    if( batch.rx_len[i] ) {
+      lens[n_tx] = batch.rx_len[i] - ef_vi_receive_prefix_len(&rx_vi->vi);
+    }
+    else {
+      /* RX merge mode: the length is only in the packet prefix. */
+      uint16_t len;
+      TRY( ef_vi_receive_get_bytes(&rx_vi->vi, (char*) pkt_buf + RX_DMA_OFF
+                                   + addr_offset_from_id(pkt_buf_i), &len) );
+      lens[n_tx] = len;
+    }
+    addrs[n_tx] = pkt_buf->tx_ef_addr[tx_vi_i];
+    ids[n_tx] = pkt_buf_i;
+    ++n_tx;
+  }
+  rx_vi->n_pkts += n_tx;
+
+  if( n_tx ) {
+    n_sent = ef_vi_transmit_batch(&tx_vi->vi, addrs, lens, ids, n_tx);
+    /* TXQ is full.  We simply choose not to send the rest. */
+    for( i = n_sent; i < n_tx; ++i )
+      pkt_buf_free(pkt_buf_from_id(ids[i]));
+  }
+
+  for( i = 0; i < batch.n_tx; ++i )
+    complete_tx(rx_vi_i, batch.tx_rq_id[i]);
+
+  if( batch.flags & EF_EVENT_BATCH_NEED_POLL ) {
+    poll_vi(rx_vi_i);
+    if( tx_vi->tx_outstanding ) {
+      ef_vi_transmit_push(&tx_vi->vi);
+      tx_vi->tx_outstanding = 0;
+    }
+  }
+}
+
+
+/* The main loop.  Poll each VI and then try to refill them. */
 static void main_loop(void)
 {
-  int i, j, k;
+  int i;
 
   while( 1 ) {
     for( i = 0; i < 2; ++i ) {
-      ef_vi* vi = &vis[i].vi;
-
-      if( vis[i].tx_outstanding ) {
-        ef_vi_transmit_push(vi);
-        vis[i].tx_outstanding = 0;
-      }
-
-      ef_event evs[EF_VI_EVENT_POLL_MIN_EVS];
-      int n_ev = ef_eventq_poll(vi, evs, sizeof(evs) / sizeof(evs[0]));
-
-      for( j = 0; j < n_ev; ++j ) {
-        switch( EF_EVENT_TYPE(evs[j]) ) {
-        case EF_EVENT_TYPE_RX:
-          /* This code does not handle jumbos. */
-          assert(EF_EVENT_RX_SOP(evs[j]) != 0);
-          assert(EF_EVENT_RX_CONT(evs[j]) == 0);
-          handle_rx(i, EF_EVENT_RX_RQ_ID(evs[j]),
-                    EF_EVENT_RX_BYTES(evs[j]) -
-                    ef_vi_receive_prefix_len(vi));
-          break;
-        case EF_EVENT_TYPE_RX_MULTI: {
-          ef_request_id ids[EF_VI_RECEIVE_BATCH];
-          TEST( EF_EVENT_RX_MULTI_SOP(evs[j])
-                && ! EF_EVENT_RX_MULTI_CONT(evs[j]) );
-          assert( cfg_rx_merge );
-          int n_rx = ef_vi_receive_unbundle(vi, &evs[j], ids);
-          for( k = 0; k < n_rx; ++k )
-            handle_batched_rx(i, ids[k]);
-          break;
-        }
-        case EF_EVENT_TYPE_TX: {
-          ef_request_id ids[EF_VI_TRANSMIT_BATCH];
-          int ntx = ef_vi_transmit_unbundle(vi, &evs[j], ids);
-          for( k = 0; k < ntx; ++k )
-            complete_tx(i, ids[k]);
-          break;
-        }
-        case EF_EVENT_TYPE_RX_DISCARD:
-          handle_rx_discard(EF_EVENT_RX_DISCARD_RQ_ID(evs[j]),
-                            EF_EVENT_RX_DISCARD_TYPE(evs[j]));
-          break;
-        case EF_EVENT_TYPE_RX_MULTI_DISCARD: {
-          ef_request_id ids[EF_VI_RECEIVE_BATCH];
-          TEST( EF_EVENT_RX_MULTI_SOP(evs[j])
-                && ! EF_EVENT_RX_MULTI_CONT(evs[j]) );
-          assert( cfg_rx_merge );
-          int n_rx = ef_vi_receive_unbundle(vi, &evs[j], ids);
-          for( k = 0; k < n_rx; ++k )
-            handle_rx_discard(ids[k],EF_EVENT_RX_MULTI_DISCARD_TYPE(evs[j]));
-          break;
-        }
-        default:
-          LOGE("ERROR: unexpected event %d\n", (int) EF_EVENT_TYPE(evs[j]));
-          break;
-        }
-      }
-
+      if( cfg_batch )
+        poll_vi_batch(i);
+      else
+        poll_vi(i);
       vi_refill_rx_ring(i);
     }
   }
@@ -278,7 +361,9 @@ static void* monitor_fn(void* dummy)
     prev_pkts[i] = vis[i].n_pkts;
   gettimeofday(&start, NULL);
 
-  printf("  vi0-rx\t  vi1-rx\n");
+  /* All forwarding is done by the main thread, so the total rate is also
+   * the rate per core. */
+  printf("  vi0-rx\t  vi1-rx\tMpps/core\n");
   while( 1 ) {
     sleep(1);
     for( i = 0; i < 2; ++i )
@@ -289,7 +374,8 @@ static void* monitor_fn(void* dummy)
 
     for( i = 0; i < 2; ++i )
       pkt_rates[i] = (int64_t)(now_pkts[i] - prev_pkts[i]) * 1000 / ms;
-    printf("%8d\t%8d\n", pkt_rates[0], pkt_rates[1]);
+    printf("%8d\t%8d\t%9.3f\n", pkt_rates[0], pkt_rates[1],
+           (pkt_rates[0] + pkt_rates[1]) / 1e6);
     fflush(stdout);
     for( i = 0; i < 2; ++i )
       prev_pkts[i] = now_pkts[i];
@@ -409,6 +495,8 @@ static __attribute__ ((__noreturn__)) void usage(void)
   fprintf(stderr, "  -u       unidirectional - only forward from <intf0> to"
           " <intf1>\n");
   fprintf(stderr, "  -n       don't output per-second stats\n");
+  fprintf(stderr, "  -b       use the batched event poll and descriptor post"
+          " APIs\n");
 
   exit(1);
 }
@@ -419,7 +507,7 @@ int main(int argc, char* argv[])
   pthread_t thread_id;
   int c;
 
-  while( (c = getopt(argc, argv, "cnu")) != -1 )
+  while( (c = getopt(argc, argv, "bcnu")) != -1 )
     switch( c ) {
     case 'c':
       cfg_rx_merge = 0;
@@ -430,6 +518,9 @@ int main(int argc, char* argv[])
     case 'n':
       cfg_stats = 0;
       break;
+    case 'b':
+      cfg_batch = 1;
+      break;
     case '?':
       usage();
     default:
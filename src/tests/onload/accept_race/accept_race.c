@@ -0,0 +1,184 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Concurrent accept() stress test.
+ *
+ * Several threads block in accept() on one listening socket while a client
+ * thread opens connections to it as fast as it can.  Each connection
+ * carries its index, and every index must be accepted exactly once.
+ *
+ * Run it under Onload with the lock-free accept ring enabled and a debug
+ * build, so that the stack's accept-queue checks (which require the queue
+ * length never to go negative) run on every poll:
+ *
+ *   EF_TCP_ACCEPT_RING=1 EF_TCP_SERVER_LOOPBACK=2 EF_TCP_CLIENT_LOOPBACK=4 \
+ *     onload ./accept_race -t 8 -n 100000
+ *
+ * Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+
+#define TRY(x)                                                  \
+  do {                                                          \
+    int __rc = (x);                                             \
+    if( __rc < 0 ) {                                            \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d (errno=%d)\n", \
+              #x, __FILE__, __LINE__, errno);                   \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define STOP_ID  0xffffffffu
+
+
+static int cfg_threads = 4;
+static int cfg_conns = 10000;
+static int cfg_backlog = 1024;
+
+static int listen_fd;
+static struct sockaddr_in listen_addr;
+static uint8_t* seen;
+static volatile int n_accepted;
+static volatile int n_dup;
+
+
+static void read_all(int fd, void* buf, size_t len)
+{
+  char* p = buf;
+  ssize_t rc;
+  while( len ) {
+    rc = recv(fd, p, len, 0);
+    if( rc <= 0 ) {
+      fprintf(stderr, "ERROR: recv returned %d (errno=%d)\n", (int) rc, errno);
+      exit(1);
+    }
+    p += rc;
+    len -= rc;
+  }
+}
+
+
+static void* acceptor(void* arg)
+{
+  uint32_t id;
+  int fd;
+
+  while( 1 ) {
+    fd = accept(listen_fd, NULL, NULL);
+    if( fd < 0 ) {
+      if( errno == EINTR || errno == ECONNABORTED )
+        continue;
+      TRY(fd);
+    }
+    read_all(fd, &id, sizeof(id));
+    close(fd);
+    if( id == STOP_ID )
+      break;
+    if( id >= (uint32_t) cfg_conns ) {
+      fprintf(stderr, "ERROR: bad connection id %u\n", id);
+      exit(1);
+    }
+    if( __sync_lock_test_and_set(&seen[id], 1) )
+      __sync_fetch_and_add(&n_dup, 1);
+    __sync_fetch_and_add(&n_accepted, 1);
+  }
+  return NULL;
+}
+
+
+static void connect_one(uint32_t id)
+{
+  int fd;
+  TRY(fd = socket(AF_INET, SOCK_STREAM, 0));
+  while( connect(fd, (struct sockaddr*) &listen_addr,
+                 sizeof(listen_addr)) < 0 ) {
+    /* The backlog can overflow briefly; retry on a fresh socket. */
+    if( errno != ECONNREFUSED && errno != EAGAIN && errno != ETIMEDOUT )
+      TRY(-1);
+    close(fd);
+    usleep(100);
+    TRY(fd = socket(AF_INET, SOCK_STREAM, 0));
+  }
+  TRY(send(fd, &id, sizeof(id), 0));
+  close(fd);
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: accept_race [-t threads] [-n connections] "
+          "[-b backlog]\n");
+  exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+  socklen_t alen = sizeof(listen_addr);
+  pthread_t* threads;
+  int c, i, missing = 0;
+
+  while( (c = getopt(argc, argv, "t:n:b:")) != -1 )
+    switch( c ) {
+    case 't':
+      cfg_threads = atoi(optarg);
+      break;
+    case 'n':
+      cfg_conns = atoi(optarg);
+      break;
+    case 'b':
+      cfg_backlog = atoi(optarg);
+      break;
+    default:
+      usage();
+    }
+  if( optind != argc || cfg_threads < 1 || cfg_conns < 1 )
+    usage();
+
+  seen = calloc(cfg_conns, 1);
+  threads = calloc(cfg_threads, sizeof(*threads));
+  if( seen == NULL || threads == NULL ) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    return 1;
+  }
+
+  memset(&listen_addr, 0, sizeof(listen_addr));
+  listen_addr.sin_family = AF_INET;
+  listen_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TRY(listen_fd = socket(AF_INET, SOCK_STREAM, 0));
+  TRY(bind(listen_fd, (struct sockaddr*) &listen_addr, sizeof(listen_addr)));
+  TRY(getsockname(listen_fd, (struct sockaddr*) &listen_addr, &alen));
+  TRY(listen(listen_fd, cfg_backlog));
+
+  for( i = 0; i < cfg_threads; ++i )
+    TRY(-pthread_create(&threads[i], NULL, acceptor, NULL));
+
+  for( i = 0; i < cfg_conns; ++i )
+    connect_one(i);
+  for( i = 0; i < cfg_threads; ++i )
+    connect_one(STOP_ID);
+
+  for( i = 0; i < cfg_threads; ++i )
+    pthread_join(threads[i], NULL);
+  close(listen_fd);
+
+  for( i = 0; i < cfg_conns; ++i )
+    if( ! seen[i] )
+      ++missing;
+  printf("threads=%d connections=%d accepted=%d duplicates=%d missing=%d\n",
+         cfg_threads, cfg_conns, n_accepted, n_dup, missing);
+  return (n_dup || missing || n_accepted != cfg_conns) ? 1 : 0;
+}
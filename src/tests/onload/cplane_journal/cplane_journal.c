@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test of the fwd-table change journal.
+ *
+ * A fwd table is built in ordinary memory and changed through the
+ * server's writers, cp_fwd_row_update() and cp_fwd_row_version_bump().
+ * A set of simulated sockets, each caching the version of one fwd row,
+ * is then refreshed in the way cicp_ipcache_journal_refresh() does it:
+ * the changed rows are collected from the journal with
+ * cp_fwd_journal_read(), sockets whose rows are not in the filter are
+ * skipped without reading the fwd table, and the rest are revalidated.
+ *
+ * The test checks that
+ *  - no stale socket is ever skipped;
+ *  - both data snapshots of an updated row hold the new data;
+ *  - a reader that falls a whole journal behind is told so.
+ *
+ * It reports how many sockets were refreshed ahead of their next send
+ * (the stack's ipcache_journal_refresh stat) and how many were skipped
+ * without a fwd-table read.  Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ci/tools.h>
+#define CI_CFG_IPV6 1
+#include <cplane/mib.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+/* Same as the stack's filter. */
+#define FILTER_BITS 1024
+
+
+static int cfg_fwd_ln2 = 14;
+static int cfg_rows = 4096;
+static int cfg_socks = 50000;
+static int cfg_rounds = 1000;
+static int cfg_changes = 8;
+static unsigned cfg_seed = 1;
+
+
+struct sock {
+  cicp_verinfo_t ver;
+};
+
+
+static void fwd_table_init(struct cp_fwd_table* fwd_table,
+                           struct cp_tables_dim* dim)
+{
+  void* blob;
+  int i;
+
+  memset(dim, 0, sizeof(*dim));
+  dim->fwd_ln2 = cfg_fwd_ln2;
+  dim->fwd_mask = (1u << cfg_fwd_ln2) - 1;
+  TEST((blob = calloc(1, cp_calc_fwd_blob_size(dim))) != NULL);
+
+  fwd_table->mask = dim->fwd_mask;
+  fwd_table->rows = cp_fwd_table_within_blob(blob);
+  fwd_table->prefix = cp_fwd_prefix_within_blob(blob, dim);
+  fwd_table->journal = cp_fwd_journal_within_blob(blob, dim);
+  fwd_table->rw_rows = NULL;
+
+  for( i = 0; i < cfg_rows; ++i ) {
+    struct cp_fwd_row* fwd = cp_get_fwd_by_id(fwd_table, i);
+    fwd->flags = CICP_FWD_FLAG_OCCUPIED | CICP_FWD_FLAG_DATA_VALID;
+    fwd->data[0].base.mtu = fwd->data[1].base.mtu = 1500;
+  }
+}
+
+
+/* The server's side: change a few rows. */
+static void server_change(struct cp_fwd_table* fwd_table, int n)
+{
+  struct cp_fwd_data data;
+  cicp_mac_rowid_t id;
+  int i;
+
+  for( i = 0; i < n; ++i ) {
+    id = rand() % cfg_rows;
+    if( rand() & 1 ) {
+      data = *cp_get_fwd_data_current(cp_get_fwd_by_id(fwd_table, id));
+      data.base.mtu = 1000 + rand() % 8000;
+      data.flags ^= CICP_FWD_DATA_FLAG_ARP_VALID;
+      cp_fwd_row_update(fwd_table, id, &data);
+      TEST(memcmp(&fwd_table->rows[id].data[0], &data, sizeof(data)) == 0);
+      TEST(memcmp(&fwd_table->rows[id].data[1], &data, sizeof(data)) == 0);
+    }
+    else {
+      cp_fwd_row_version_bump(fwd_table, id);
+    }
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  struct cp_tables_dim dim;
+  struct cp_fwd_table fwd_table;
+  ci_uint64 filter[FILTER_BITS / 64];
+  unsigned long long refreshed = 0, skipped = 0, checked = 0, stale = 0;
+  struct sock* socks;
+  ci_uint32 pos;
+  int c, i, r;
+
+  while( (c = getopt(argc, argv, "r:s:n:c:S:")) != -1 )
+    switch( c ) {
+    case 'r':
+      cfg_rows = atoi(optarg);
+      break;
+    case 's':
+      cfg_socks = atoi(optarg);
+      break;
+    case 'n':
+      cfg_rounds = atoi(optarg);
+      break;
+    case 'c':
+      cfg_changes = atoi(optarg);
+      break;
+    case 'S':
+      cfg_seed = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: cplane_journal [-r rows] [-s sockets] "
+              "[-n rounds] [-c changes-per-round] [-S seed]\n");
+      return 1;
+    }
+  TEST(cfg_rows > 0 && cfg_rows <= (1 << cfg_fwd_ln2));
+  TEST(cfg_changes < CP_FWD_JOURNAL_SIZE);
+  srand(cfg_seed);
+
+  fwd_table_init(&fwd_table, &dim);
+  TEST((socks = calloc(cfg_socks, sizeof(*socks))) != NULL);
+  for( i = 0; i < cfg_socks; ++i ) {
+    socks[i].ver.id = rand() % cfg_rows;
+    socks[i].ver.version = fwd_table.rows[socks[i].ver.id].version;
+  }
+  pos = fwd_table.journal->head;
+
+  for( r = 0; r < cfg_rounds; ++r ) {
+    server_change(&fwd_table, cfg_changes);
+
+    memset(filter, 0, sizeof(filter));
+    TEST(cp_fwd_journal_read(fwd_table.journal, &pos, filter, FILTER_BITS));
+    TEST(pos == fwd_table.journal->head);
+
+    for( i = 0; i < cfg_socks; ++i ) {
+      cicp_verinfo_t* ver = &socks[i].ver;
+      int is_stale = ! cp_fwd_version_matches(&fwd_table, ver);
+      stale += is_stale;
+      if( ! cp_fwd_journal_filter_test(filter, FILTER_BITS, ver->id) ) {
+        /* Skipping a stale socket would leave it to the send path. */
+        TEST(! is_stale);
+        ++skipped;
+        continue;
+      }
+      ++checked;
+      if( is_stale ) {
+        ver->version = fwd_table.rows[ver->id].version;
+        ++refreshed;
+      }
+    }
+  }
+
+  /* A reader that has been lapped must find out. */
+  server_change(&fwd_table, CP_FWD_JOURNAL_SIZE);
+  memset(filter, 0, sizeof(filter));
+  TEST(! cp_fwd_journal_read(fwd_table.journal, &pos, filter, FILTER_BITS));
+  TEST(pos == fwd_table.journal->head);
+  memset(filter, 0, sizeof(filter));
+  TEST(cp_fwd_journal_read(fwd_table.journal, &pos, filter, FILTER_BITS));
+
+  TEST(refreshed == stale);
+  printf("rounds=%d changes/round=%d sockets=%d\n",
+         cfg_rounds, cfg_changes, cfg_socks);
+  printf("refreshed ahead of send (ipcache_journal_refresh): %llu\n",
+         refreshed);
+  printf("skipped without a fwd-table read: %llu of %llu (%.1f%%)\n",
+         skipped, skipped + checked,
+         100.0 * skipped / (skipped + checked));
+  return 0;
+}
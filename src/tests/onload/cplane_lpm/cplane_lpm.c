@@ -0,0 +1,694 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test and benchmark of the control plane's longest-prefix-match tables.
+ *
+ * The MIB is laid out in ordinary memory with the LPM tables published,
+ * and filled through the server's writers:
+ *
+ *  - synthetic netlink route and neighbour messages are passed through
+ *    cp_lpm_nl_route() and cp_lpm_nl_neigh(), and the results checked;
+ *  - the host's own route and neighbour dumps are passed through the
+ *    same functions (skipped with -H, or if netlink is not available);
+ *  - a BGP-like table of 500k IPv4 and 100k IPv6 routes is added with
+ *    cp_lpm_route_add(), and cp_lpm_route_lookup() is checked against a
+ *    per-prefix-length hash of the same routes and timed.
+ *
+ * Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+
+#include <ci/tools.h>
+#define CI_CFG_IPV6 1
+#include <cplane/mib.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define TRY(x)                                                  \
+  do {                                                          \
+    if( (x) < 0 ) {                                             \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d: %s\n",      \
+              #x, __FILE__, __LINE__, strerror(errno));         \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define N_GATEWAYS  16
+
+
+static int cfg_routes4 = 500000;
+static int cfg_routes6 = 100000;
+static int cfg_lookups = 20000000;
+static int cfg_verify = 1000000;
+static int cfg_host = 1;
+static unsigned cfg_seed = 1;
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static ci_uint64 rand64(void)
+{
+  return ((ci_uint64) rand() << 42) ^ ((ci_uint64) rand() << 21) ^ rand();
+}
+
+
+static void mibs_init(struct cp_mibs* mibs, struct cp_tables_dim* dim)
+{
+  void* mem;
+  size_t size;
+
+  memset(dim, 0, sizeof(*dim));
+  dim->lpm_nh_max = 256;
+  dim->lpm_tbl24_size = CP_LPM_TBL24_SIZE;
+  dim->lpm_tbl8_max = 1 << 16;
+  dim->lpm6_node_max = 2 * cfg_routes6 + 1024;
+  dim->lpm_neigh_max = 1 << 12;
+
+  memset(mibs, 0, sizeof(*mibs) * 2);
+  mibs[0].dim = mibs[1].dim = dim;
+  size = cp_calc_mib_size(dim);
+  TEST(posix_memalign(&mem, CI_PAGE_SIZE, size) == 0);
+  memset(mem, 0, size);
+  cp_init_mibs(mem, mibs);
+  TEST(cp_lpm_published(&mibs[0]));
+}
+
+
+/*************************************************************************
+ * Netlink messages
+ */
+
+struct nl_buf {
+  struct nlmsghdr nlh;
+  char data[1024];
+};
+
+
+static struct nlmsghdr*
+nl_msg(struct nl_buf* buf, int type, const void* hdr, int hdr_len)
+{
+  memset(buf, 0, sizeof(*buf));
+  buf->nlh.nlmsg_type = type;
+  buf->nlh.nlmsg_len = NLMSG_LENGTH(hdr_len);
+  memcpy(NLMSG_DATA(&buf->nlh), hdr, hdr_len);
+  return &buf->nlh;
+}
+
+
+static struct rtattr*
+nl_attr(struct nlmsghdr* nlh, int type, const void* data, int len)
+{
+  struct rtattr* rta = (void*) ((char*) nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+  rta->rta_type = type;
+  rta->rta_len = RTA_LENGTH(len);
+  memcpy(RTA_DATA(rta), data, len);
+  nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+  return rta;
+}
+
+
+static struct nlmsghdr*
+nl_route4(struct nl_buf* buf, ci_uint8 table, ci_uint8 type,
+          const char* dst, int pfx, const char* gw, int oif)
+{
+  struct rtmsg rtm = {
+    .rtm_family = AF_INET,
+    .rtm_dst_len = pfx,
+    .rtm_table = table,
+    .rtm_type = type,
+  };
+  struct nlmsghdr* nlh = nl_msg(buf, RTM_NEWROUTE, &rtm, sizeof(rtm));
+  ci_uint32 addr;
+
+  addr = inet_addr(dst);
+  nl_attr(nlh, RTA_DST, &addr, 4);
+  if( gw != NULL ) {
+    addr = inet_addr(gw);
+    nl_attr(nlh, RTA_GATEWAY, &addr, 4);
+  }
+  if( oif != 0 )
+    nl_attr(nlh, RTA_OIF, &oif, 4);
+  return nlh;
+}
+
+
+static struct nlmsghdr*
+nl_neigh4(struct nl_buf* buf, int type, int ifindex, const char* dst,
+          ci_uint16 state, const ci_mac_addr_t mac)
+{
+  struct ndmsg ndm = {
+    .ndm_family = AF_INET,
+    .ndm_ifindex = ifindex,
+    .ndm_state = state,
+  };
+  struct nlmsghdr* nlh = nl_msg(buf, type, &ndm, sizeof(ndm));
+  ci_uint32 addr = inet_addr(dst);
+
+  nl_attr(nlh, NDA_DST, &addr, 4);
+  if( mac != NULL )
+    nl_attr(nlh, NDA_LLADDR, mac, sizeof(ci_mac_addr_t));
+  return nlh;
+}
+
+
+static const struct cp_lpm_nh* lookup4(struct cp_mibs* mib, const char* ip)
+{
+  ci_addr_sh_t dst = CI_ADDR_SH_FROM_IP4(inet_addr(ip));
+  ci_uint32 nh = cp_lpm_route_lookup(mib, &dst);
+  return nh == CP_LPM_NH_NONE ? NULL : &mib->lpm_nh[nh];
+}
+
+
+static struct cp_lpm_neigh*
+neigh4(struct cp_mibs* mib, int ifindex, const char* ip)
+{
+  ci_addr_sh_t addr = CI_ADDR_SH_FROM_IP4(inet_addr(ip));
+  return cp_lpm_neigh_lookup(mib, ifindex, &addr);
+}
+
+
+/* Feeds each message to cp_lpm_nl_route() twice, in the order the server
+ * does: for the main table, then for the local one. */
+static void
+nl_routes(struct cp_mibs* mib, struct nlmsghdr** msgs, int n)
+{
+  int i;
+  for( i = 0; i < n; ++i )
+    TEST(cp_lpm_nl_route(mib, msgs[i], RT_TABLE_MAIN) == 0);
+  for( i = 0; i < n; ++i )
+    TEST(cp_lpm_nl_route(mib, msgs[i], RT_TABLE_LOCAL) == 0);
+}
+
+
+static void test_netlink(struct cp_mibs* mib)
+{
+  static const ci_mac_addr_t mac = { 0x00, 0x0f, 0x53, 0x01, 0x02, 0x03 };
+  struct nl_buf buf[8];
+  struct nlmsghdr* msgs[8];
+  const struct cp_lpm_nh* nh;
+  struct cp_lpm_neigh* neigh;
+  struct rtattr* rta;
+  ci_uint32 val;
+  int n = 0;
+
+  msgs[n] = nl_route4(&buf[n], RT_TABLE_MAIN, RTN_UNICAST,
+                      "0.0.0.0", 0, "10.0.0.1", 2);
+  n++;
+  /* On-link, with a preferred source and a route MTU. */
+  msgs[n] = nl_route4(&buf[n], RT_TABLE_MAIN, RTN_UNICAST,
+                      "192.168.1.0", 24, NULL, 3);
+  val = inet_addr("192.168.1.5");
+  nl_attr(msgs[n], RTA_PREFSRC, &val, 4);
+  val = 1400;
+  rta = nl_attr(msgs[n], RTA_METRICS, NULL, 0);
+  {
+    struct rtattr* m = RTA_DATA(rta);
+    m->rta_type = RTAX_MTU;
+    m->rta_len = RTA_LENGTH(4);
+    memcpy(RTA_DATA(m), &val, 4);
+    rta->rta_len += RTA_ALIGN(m->rta_len);
+    msgs[n]->nlmsg_len += RTA_ALIGN(m->rta_len);
+  }
+  n++;
+  msgs[n] = nl_route4(&buf[n], RT_TABLE_MAIN, RTN_BLACKHOLE,
+                      "192.168.2.0", 24, NULL, 0);
+  n++;
+  msgs[n] = nl_route4(&buf[n], RT_TABLE_MAIN, RTN_UNICAST,
+                      "192.168.3.0", 24, NULL, 0);
+  nl_attr(msgs[n], RTA_MULTIPATH, NULL, 0);
+  n++;
+  /* Not in a table we publish. */
+  msgs[n] = nl_route4(&buf[n], 100, RTN_UNICAST,
+                      "192.168.4.0", 24, NULL, 4);
+  n++;
+  /* The local address must win over the main-table route for the same
+   * prefix whatever the order of the dump. */
+  msgs[n] = nl_route4(&buf[n], RT_TABLE_LOCAL, RTN_LOCAL,
+                      "192.168.1.5", 32, NULL, 3);
+  n++;
+  msgs[n] = nl_route4(&buf[n], RT_TABLE_MAIN, RTN_UNICAST,
+                      "192.168.1.5", 32, NULL, 3);
+  n++;
+
+  cp_lpm_route_begin(mib);
+  nl_routes(mib, msgs, n);
+  cp_lpm_route_commit(mib);
+
+  TEST((nh = lookup4(mib, "8.8.8.8")) != NULL);
+  TEST(nh->ifindex == 2 && nh->flags == CP_LPM_NH_FLAG_GATEWAY);
+  TEST(nh->gateway.ip4 == inet_addr("10.0.0.1"));
+  TEST((nh = lookup4(mib, "192.168.1.7")) != NULL);
+  TEST(nh->ifindex == 3 && nh->flags == 0 && nh->mtu == 1400);
+  TEST(nh->src.ip4 == inet_addr("192.168.1.5"));
+  TEST((nh = lookup4(mib, "192.168.2.7")) != NULL);
+  TEST(nh->flags & CP_LPM_NH_FLAG_SLOW);
+  TEST((nh = lookup4(mib, "192.168.3.7")) != NULL);
+  TEST(nh->flags & CP_LPM_NH_FLAG_SLOW);
+  TEST((nh = lookup4(mib, "192.168.4.7")) != NULL);
+  TEST(nh->ifindex == 2);
+  TEST((nh = lookup4(mib, "192.168.1.5")) != NULL);
+  TEST(nh->flags & CP_LPM_NH_FLAG_SLOW);
+
+  n = 0;
+  msgs[n] = nl_neigh4(&buf[n], RTM_NEWNEIGH, 2, "10.0.0.1",
+                      NUD_REACHABLE, mac);
+  TEST(cp_lpm_nl_neigh(mib, msgs[n++]) == 0);
+  msgs[n] = nl_neigh4(&buf[n], RTM_NEWNEIGH, 3, "192.168.1.7",
+                      NUD_STALE, mac);
+  TEST(cp_lpm_nl_neigh(mib, msgs[n++]) == 0);
+  msgs[n] = nl_neigh4(&buf[n], RTM_NEWNEIGH, 3, "192.168.1.8",
+                      NUD_INCOMPLETE, NULL);
+  TEST(cp_lpm_nl_neigh(mib, msgs[n++]) == 0);
+
+  TEST((neigh = neigh4(mib, 2, "10.0.0.1")) != NULL);
+  TEST(neigh->state == CP_LPM_NEIGH_VALID);
+  TEST(memcmp(neigh->mac, mac, sizeof(mac)) == 0);
+  TEST(neigh4(mib, 3, "10.0.0.1") == NULL);
+  TEST((neigh = neigh4(mib, 3, "192.168.1.7")) != NULL);
+  TEST(neigh->state == CP_LPM_NEIGH_INVALID);
+  TEST((neigh = neigh4(mib, 3, "192.168.1.8")) != NULL);
+  TEST(neigh->state == CP_LPM_NEIGH_INVALID);
+
+  msgs[n] = nl_neigh4(&buf[n], RTM_DELNEIGH, 2, "10.0.0.1", 0, NULL);
+  TEST(cp_lpm_nl_neigh(mib, msgs[n++]) == 0);
+  TEST(neigh4(mib, 2, "10.0.0.1") == NULL);
+
+  printf("netlink: ok\n");
+}
+
+
+/* Dumps [type] from the kernel into a malloced buffer. */
+static int nl_dump(int type, char** buf_out)
+{
+  struct {
+    struct nlmsghdr nlh;
+    struct rtgenmsg g;
+  } req = {
+    .nlh.nlmsg_len = sizeof(req),
+    .nlh.nlmsg_type = type,
+    .nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+    .g.rtgen_family = AF_UNSPEC,
+  };
+  size_t size = 1 << 16, len = 0;
+  char* buf = malloc(size);
+  int fd, done = 0;
+
+  TEST(buf != NULL);
+  if( (fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) < 0 ||
+      send(fd, &req, sizeof(req), 0) < 0 ) {
+    free(buf);
+    return -1;
+  }
+  while( ! done ) {
+    struct nlmsghdr* nlh;
+    int rc, l;
+
+    if( size - len < 1 << 15 )
+      TEST((buf = realloc(buf, size *= 2)) != NULL);
+    TRY(rc = recv(fd, buf + len, size - len, 0));
+    for( nlh = (void*) (buf + len), l = rc; NLMSG_OK(nlh, l);
+         nlh = NLMSG_NEXT(nlh, l) )
+      if( nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR )
+        done = 1;
+    len += rc;
+  }
+  close(fd);
+  *buf_out = buf;
+  return len;
+}
+
+
+static void test_host(struct cp_mibs* mib)
+{
+  struct nlmsghdr* nlh;
+  char* buf;
+  int len, l, n_routes = 0, n_neigh = 0;
+
+  if( (len = nl_dump(RTM_GETROUTE, &buf)) < 0 ) {
+    printf("host: netlink not available, skipped\n");
+    return;
+  }
+  cp_lpm_route_begin(mib);
+  for( nlh = (void*) buf, l = len; NLMSG_OK(nlh, l); nlh = NLMSG_NEXT(nlh, l) )
+    if( nlh->nlmsg_type == RTM_NEWROUTE )
+      TEST(cp_lpm_nl_route(mib, nlh, RT_TABLE_MAIN) == 0);
+  for( nlh = (void*) buf, l = len; NLMSG_OK(nlh, l); nlh = NLMSG_NEXT(nlh, l) )
+    if( nlh->nlmsg_type == RTM_NEWROUTE )
+      TEST(cp_lpm_nl_route(mib, nlh, RT_TABLE_LOCAL) == 0);
+  cp_lpm_route_commit(mib);
+
+  /* Every route in the published tables covers its own destination, so
+   * a lookup of it must find something. */
+  for( nlh = (void*) buf, l = len; NLMSG_OK(nlh, l);
+       nlh = NLMSG_NEXT(nlh, l) ) {
+    const struct rtmsg* rtm = NLMSG_DATA(nlh);
+    int alen = RTM_PAYLOAD(nlh);
+    const struct rtattr* rta;
+    ci_addr_sh_t dst = rtm->rtm_family == AF_INET ? ip4_addr_sh_any :
+                                                    addr_sh_any;
+
+    if( nlh->nlmsg_type != RTM_NEWROUTE ||
+        (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6) ||
+        (rtm->rtm_table != RT_TABLE_MAIN &&
+         rtm->rtm_table != RT_TABLE_LOCAL) ||
+        rtm->rtm_flags & RTM_F_CLONED )
+      continue;
+    for( rta = RTM_RTA(rtm); RTA_OK(rta, alen); rta = RTA_NEXT(rta, alen) )
+      if( rta->rta_type == RTA_DST )
+        memcpy(CI_IPX_ADDR_SH_PTR(rtm->rtm_family, dst), RTA_DATA(rta),
+               RTA_PAYLOAD(rta));
+    TEST(cp_lpm_route_lookup(mib, &dst) != CP_LPM_NH_NONE);
+    ++n_routes;
+  }
+  free(buf);
+
+  if( (len = nl_dump(RTM_GETNEIGH, &buf)) < 0 )
+    return;
+  for( nlh = (void*) buf, l = len; NLMSG_OK(nlh, l);
+       nlh = NLMSG_NEXT(nlh, l) ) {
+    const struct ndmsg* ndm = NLMSG_DATA(nlh);
+    if( nlh->nlmsg_type != RTM_NEWNEIGH ||
+        (ndm->ndm_family != AF_INET && ndm->ndm_family != AF_INET6) )
+      continue;
+    TEST(cp_lpm_nl_neigh(mib, nlh) == 0);
+    ++n_neigh;
+  }
+  free(buf);
+
+  printf("host: %d routes, %d neighbours: ok\n", n_routes, n_neigh);
+}
+
+
+/*************************************************************************
+ * Big tables
+ */
+
+struct route {
+  ci_addr_sh_t dst;
+  cicp_prefixlen_t pfx;
+  int gw;
+};
+
+/* The reference: a hash of (prefix, length) -> gateway per route, where
+ * the last route added for a prefix wins, as in cp_lpm_route_add(). */
+struct ref_ent {
+  ci_addr_sh_t dst;
+  int len;  /* -1 if free */
+  int gw;
+};
+
+static struct ref_ent* ref;
+static ci_uint32 ref_mask;
+static int ref_used_len[129];
+
+
+static ci_uint32 ref_hash(const ci_addr_sh_t* dst, int len)
+{
+  ci_uint64 h = dst->u64[0] * 0x9e3779b97f4a7c15ull;
+  h ^= (dst->u64[1] + len) * 0xc2b2ae3d27d4eb4full;
+  return (h ^ (h >> 29)) & ref_mask;
+}
+
+
+static struct ref_ent* ref_find(const ci_addr_sh_t* dst, int len)
+{
+  ci_uint32 h = ref_hash(dst, len);
+  while( ref[h].len >= 0 ) {
+    if( ref[h].len == len && memcmp(&ref[h].dst, dst, sizeof(*dst)) == 0 )
+      return &ref[h];
+    h = (h + 1) & ref_mask;
+  }
+  return &ref[h];
+}
+
+
+static void ref_add(const struct route* r)
+{
+  struct ref_ent* e = ref_find(&r->dst, r->pfx);
+  e->dst = r->dst;
+  e->len = r->pfx;
+  e->gw = r->gw;
+  ref_used_len[r->pfx] = 1;
+}
+
+
+/* Returns the gateway of the longest prefix covering [addr], or -1. */
+static int ref_lookup(const ci_addr_sh_t* addr)
+{
+  int ip6 = CI_IS_ADDR_SH_IP6(*addr);
+  int len;
+
+  for( len = ip6 ? 128 : 32; len >= 0; --len ) {
+    ci_addr_sh_t dst = *addr;
+    struct ref_ent* e;
+
+    if( ! ref_used_len[len] )
+      continue;
+    cp_addr_apply_pfx(&dst, ip6 ? len : len + 96);
+    e = ref_find(&dst, len);
+    if( e->len >= 0 )
+      return e->gw;
+  }
+  return -1;
+}
+
+
+/* Prefix lengths roughly as seen in a full Internet table. */
+static int pfx_len4(void)
+{
+  int r = rand() % 1000;
+  if( r < 600 ) return 24;
+  if( r < 700 ) return 23;
+  if( r < 800 ) return 22;
+  if( r < 850 ) return 21;
+  if( r < 900 ) return 20;
+  if( r < 960 ) return 16 + rand() % 4;
+  if( r < 980 ) return 8 + rand() % 8;
+  return 25 + rand() % 8;
+}
+
+
+static int pfx_len6(void)
+{
+  int r = rand() % 1000;
+  if( r < 500 ) return 48;
+  if( r < 650 ) return 32;
+  if( r < 750 ) return 44;
+  if( r < 850 ) return 40;
+  if( r < 950 ) return 33 + rand() % 15;
+  return 49 + rand() % 16;
+}
+
+
+static void route_gen(struct route* r, int ip6)
+{
+  if( ip6 ) {
+    r->pfx = pfx_len6();
+    r->dst.u64[0] = rand64();
+    r->dst.u64[1] = rand64();
+    r->dst.ip6[0] = 0x20 | (r->dst.ip6[0] & 0x1f);  /* 2000::/3 */
+    cp_addr_apply_pfx(&r->dst, r->pfx);
+  }
+  else {
+    r->pfx = pfx_len4();
+    r->dst = CI_ADDR_SH_FROM_IP4(CI_BSWAP_BE32((ci_uint32) rand64() &
+                                              (~0u << (32 - r->pfx))));
+  }
+  r->gw = 1 + rand() % (N_GATEWAYS - 1);
+}
+
+
+/* Half of the addresses are in a route, the other half anywhere. */
+static void addr_gen(ci_addr_sh_t* a, const struct route* routes, int n,
+                     int ip6)
+{
+  const struct route* r = &routes[rand() % n];
+  int host_bits = (ip6 ? 128 : 32) - r->pfx;
+
+  if( rand() & 1 ) {
+    ci_uint64 x = rand64();
+    if( ip6 ) {
+      if( host_bits > 64 ) {
+        *a = r->dst;
+        a->u64[1] = rand64();
+      }
+      else {
+        *a = r->dst;
+        a->u64[1] |= CI_BSWAP_BE64(host_bits == 0 ? 0 :
+                                   x & (~0ull >> (64 - host_bits)));
+      }
+    }
+    else {
+      ci_uint32 ip = CI_BSWAP_BE32(r->dst.ip4);
+      if( host_bits )
+        ip |= (ci_uint32) x & (~0u >> (32 - host_bits));
+      *a = CI_ADDR_SH_FROM_IP4(CI_BSWAP_BE32(ip));
+    }
+  }
+  else if( ip6 ) {
+    a->u64[0] = rand64();
+    a->u64[1] = rand64();
+    a->ip6[0] = 0x20 | (a->ip6[0] & 0x1f);
+  }
+  else {
+    *a = CI_ADDR_SH_FROM_IP4((ci_uint32) rand64());
+  }
+}
+
+
+static void test_big(struct cp_mibs* mib)
+{
+  int n = cfg_routes4 + cfg_routes6;
+  int n_addrs = 1 << 22;  /* well beyond the caches */
+  struct cp_lpm_nh nhs[N_GATEWAYS];
+  struct route* routes;
+  ci_addr_sh_t* addrs;
+  ci_uint32 sum = 0;
+  double t;
+  int i, g;
+
+  TEST((routes = malloc(sizeof(*routes) * (n + 2))) != NULL);
+  TEST((addrs = malloc(sizeof(*addrs) * n_addrs)) != NULL);
+  for( ref_mask = 1; ref_mask < 2 * n; ref_mask <<= 1 )
+    ;
+  TEST((ref = malloc(sizeof(*ref) * ref_mask)) != NULL);
+  ref_mask--;
+  for( i = 0; i <= ref_mask; ++i )
+    ref[i].len = -1;
+
+  /* Gateway 0 is the default route. */
+  for( g = 0; g < N_GATEWAYS; ++g ) {
+    memset(&nhs[g], 0, sizeof(nhs[g]));
+    nhs[g].gateway = CI_ADDR_SH_FROM_IP4(htonl(0x0a000001 + g));
+    nhs[g].ifindex = 2 + g % 4;
+    nhs[g].flags = CP_LPM_NH_FLAG_GATEWAY;
+  }
+  routes[0].dst = ip4_addr_sh_any;
+  routes[0].pfx = 0;
+  routes[0].gw = 0;
+  routes[1].dst = addr_sh_any;
+  routes[1].pfx = 0;
+  routes[1].gw = 0;
+  for( i = 2; i < n + 2; ++i )
+    route_gen(&routes[i], i >= cfg_routes4 + 2);
+  for( i = 0; i < n + 2; ++i )
+    ref_add(&routes[i]);
+
+  t = now();
+  cp_lpm_route_begin(mib);
+  for( i = 0; i < n + 2; ++i )
+    TEST(cp_lpm_route_add(mib, &routes[i].dst, routes[i].pfx,
+                          &nhs[routes[i].gw]) == 0);
+  cp_lpm_route_commit(mib);
+  t = now() - t;
+  printf("routes: %d IPv4, %d IPv6; %u tbl8 groups, %u IPv6 nodes\n",
+         cfg_routes4, cfg_routes6, mib->lpm->tbl8_used, mib->lpm->lpm6_used);
+  printf("build: %.3f s\n", t);
+
+  for( i = 0; i < cfg_verify; ++i ) {
+    ci_addr_sh_t a;
+    ci_uint32 nh;
+    int ip6 = cfg_routes6 > 0 && (i & 3) == 3;
+
+    if( ip6 )
+      addr_gen(&a, routes + 2 + cfg_routes4, cfg_routes6, 1);
+    else
+      addr_gen(&a, routes + 2, cfg_routes4, 0);
+    g = ref_lookup(&a);
+    nh = cp_lpm_route_lookup(mib, &a);
+    TEST(g >= 0 && nh != CP_LPM_NH_NONE);
+    TEST(memcmp(&mib->lpm_nh[nh], &nhs[g], sizeof(nhs[g])) == 0);
+  }
+  printf("verify: %d lookups ok\n", cfg_verify);
+
+  for( i = 0; i < n_addrs; ++i )
+    addr_gen(&addrs[i], routes + 2, cfg_routes4, 0);
+  t = now();
+  for( i = 0; i < cfg_lookups; ++i )
+    sum += cp_lpm_route_lookup(mib, &addrs[i & (n_addrs - 1)]);
+  t = now() - t;
+  printf("IPv4 lookup: %.1f M/s (%.1f ns)\n",
+         cfg_lookups / t * 1e-6, t * 1e9 / cfg_lookups);
+
+  if( cfg_routes6 > 0 ) {
+    for( i = 0; i < n_addrs; ++i )
+      addr_gen(&addrs[i], routes + 2 + cfg_routes4, cfg_routes6, 1);
+    t = now();
+    for( i = 0; i < cfg_lookups; ++i )
+      sum += cp_lpm_route_lookup(mib, &addrs[i & (n_addrs - 1)]);
+    t = now() - t;
+    printf("IPv6 lookup: %.1f M/s (%.1f ns)\n",
+           cfg_lookups / t * 1e-6, t * 1e9 / cfg_lookups);
+  }
+  TEST(sum != 1);  /* keep the lookups */
+
+  free(ref);
+  free(addrs);
+  free(routes);
+}
+
+
+int main(int argc, char** argv)
+{
+  struct cp_tables_dim dim;
+  struct cp_mibs mibs[2];
+  int c;
+
+  while( (c = getopt(argc, argv, "n:6:l:v:HS:")) != -1 )
+    switch( c ) {
+    case 'n':
+      cfg_routes4 = atoi(optarg);
+      break;
+    case '6':
+      cfg_routes6 = atoi(optarg);
+      break;
+    case 'l':
+      cfg_lookups = atoi(optarg);
+      break;
+    case 'v':
+      cfg_verify = atoi(optarg);
+      break;
+    case 'H':
+      cfg_host = 0;
+      break;
+    case 'S':
+      cfg_seed = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: cplane_lpm [-n ipv4-routes] [-6 ipv6-routes] "
+              "[-l lookups] [-v verify-lookups] [-H] [-S seed]\n");
+      return 1;
+    }
+  TEST(cfg_routes4 > 0 && cfg_routes6 >= 0 && cfg_lookups > 0);
+  srand(cfg_seed);
+
+  mibs_init(mibs, &dim);
+  test_netlink(&mibs[0]);
+  if( cfg_host )
+    test_host(&mibs[0]);
+  test_big(&mibs[0]);
+  return 0;
+}
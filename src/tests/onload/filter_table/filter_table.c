@@ -0,0 +1,308 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test and benchmark of the IPv4 software filter table.
+ *
+ * The filter table in lib/transport/ip/netif_table.c is exercised through
+ * ci_netif_filter_insert(), ci_netif_filter_remove() and
+ * ci_netif_filter_lookup(), on a stack that exists only in this process:
+ * the shared state, socket buffers and filter table are ordinary memory,
+ * and the sockets carry just the fields that the table looks at.
+ *
+ * Tuples are drawn from one of these distributions (-d):
+ *   server   one local address and port, many remote addresses and ports
+ *   client   many local ports to a handful of remote servers
+ *   random   every field random
+ *
+ * The table is filled to the requested load, then churned by removing and
+ * re-inserting random entries, which is what leaves tombstones behind.
+ * After each phase every entry must be found and a set of absent tuples
+ * must not be, and the time per lookup of each is reported together with
+ * the table statistics.  Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <ci/internal/ip.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+
+static int cfg_table_lg2 = 16;
+static int cfg_load = 75;
+static int cfg_churn = 8;
+static int cfg_lookups = 4000000;
+static const char* cfg_dist = "server";
+static unsigned cfg_seed = 1;
+
+
+struct tuple {
+  ci_uint32 laddr, raddr;
+  ci_uint16 lport, rport;
+  ci_uint8 protocol;
+};
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static ci_uint32 rand32(void)
+{
+  return ((ci_uint32) rand() << 16) ^ rand();
+}
+
+
+static void tuple_gen(struct tuple* t)
+{
+  memset(t, 0, sizeof(*t));
+  t->protocol = IPPROTO_TCP;
+  if( ! strcmp(cfg_dist, "server") ) {
+    t->laddr = htonl(0xc0a80001);
+    t->lport = htons(80);
+    t->raddr = htonl(0x0a000000 | (rand32() & 0xffffff));
+    t->rport = htons(1024 + rand() % 64512);
+  }
+  else if( ! strcmp(cfg_dist, "client") ) {
+    t->laddr = htonl(0xc0a80001);
+    t->lport = htons(1024 + rand() % 64512);
+    t->raddr = htonl(0x0a000001 + rand() % 4);
+    t->rport = htons(443);
+  }
+  else {
+    t->laddr = rand32();
+    t->lport = rand();
+    t->raddr = rand32();
+    t->rport = rand();
+    t->protocol = rand() & 1 ? IPPROTO_TCP : IPPROTO_UDP;
+  }
+}
+
+
+/* The stack is just enough of a ci_netif for the filter table: the shared
+ * state, with the socket buffers after it, and the table itself. */
+static void netif_init(ci_netif* ni, int n_socks)
+{
+  unsigned size = 1u << cfg_table_lg2;
+  unsigned ep_ofs = CI_ALIGN_FWD(sizeof(ci_netif_state), EP_BUF_SIZE);
+  unsigned i;
+  void* p;
+
+  memset(ni, 0, sizeof(*ni));
+  TEST(posix_memalign(&p, CI_PAGE_SIZE,
+                      ep_ofs + (size_t) n_socks * EP_BUF_SIZE) == 0);
+  memset(p, 0, ep_ofs + (size_t) n_socks * EP_BUF_SIZE);
+  ni->state = p;
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+#if CI_CFG_NETIF_HARDEN
+  ni->ep_ofs = ep_ofs;
+#endif
+
+  TEST(posix_memalign(&p, CI_PAGE_SIZE, sizeof(ci_netif_filter_table) +
+                      size * sizeof(ci_netif_filter_table_entry_fast)) == 0);
+  ni->filter_table = p;
+  TEST((ni->filter_table_ext = calloc(size,
+                            sizeof(ci_netif_filter_table_entry_ext))) != NULL);
+
+  /* As ci_netif_filter_init() does in the driver.  The state of an entry
+   * is in the top two bits of __id_and_state, and 2 is EMPTY. */
+  *(unsigned*) &ni->filter_table->table_size_mask = size - 1;
+  ni->filter_table->compact_cursor = 0;
+  for( i = 0; i < size; ++i ) {
+    ni->filter_table->table[i].__id_and_state = 2u << 30;
+    ni->filter_table->table[i].laddr = 0;
+  }
+}
+
+
+static void sock_init(ci_netif* ni, int id, const struct tuple* t)
+{
+  ci_sock_cmn* s = SP_TO_SOCK_CMN(ni, OO_SP_FROM_INT(ni, id));
+
+  s->pkt.ether_type = CI_ETHERTYPE_IP;
+  s->pkt.ipx.ip4.ip_daddr_be32 = t->raddr;
+  s->pkt.ipx.ip4.ip_protocol = t->protocol;
+  sock_rport_be16(s) = t->rport;
+  s->s_flags = 0;
+}
+
+
+static int tuple_insert(ci_netif* ni, int id, const struct tuple* t)
+{
+  ci_addr_t laddr = CI_ADDR_FROM_IP4(t->laddr);
+  ci_addr_t raddr = CI_ADDR_FROM_IP4(t->raddr);
+
+  sock_init(ni, id, t);
+  return ci_netif_filter_insert(ni, OO_SP_FROM_INT(ni, id),
+                                AF_SPACE_FLAG_IP4, laddr, t->lport,
+                                raddr, t->rport, t->protocol);
+}
+
+
+static void tuple_remove(ci_netif* ni, int id, const struct tuple* t)
+{
+  ci_netif_filter_remove(ni, OO_SP_FROM_INT(ni, id), AF_SPACE_FLAG_IP4,
+                         CI_ADDR_FROM_IP4(t->laddr), t->lport,
+                         CI_ADDR_FROM_IP4(t->raddr), t->rport, t->protocol);
+}
+
+
+static oo_sp tuple_lookup(ci_netif* ni, const struct tuple* t)
+{
+  return ci_netif_filter_lookup(ni, AF_SPACE_FLAG_IP4,
+                                CI_ADDR_FROM_IP4(t->laddr), t->lport,
+                                CI_ADDR_FROM_IP4(t->raddr), t->rport,
+                                t->protocol);
+}
+
+
+/* Checks every entry and [n_absent] absent tuples, then times lookups of
+ * both kinds. */
+static void check_and_time(ci_netif* ni, const char* phase,
+                           const struct tuple* tuples, int n,
+                           const struct tuple* absent, int n_absent)
+{
+  ci_netif_stats* st = &ni->state->stats;
+  double t, t_hit, t_miss;
+  int i, *order;
+  ci_uint32 sum = 0;
+
+  for( i = 0; i < n; ++i )
+    TEST(OO_SP_TO_INT(tuple_lookup(ni, &tuples[i])) == i);
+  for( i = 0; i < n_absent; ++i )
+    TEST(OO_SP_IS_NULL(tuple_lookup(ni, &absent[i])));
+
+  /* A random order, so that the lookups miss the cache as they would for
+   * packets from many connections. */
+  TEST((order = malloc(sizeof(*order) * n)) != NULL);
+  for( i = 0; i < n; ++i )
+    order[i] = rand() % n;
+
+  t = now();
+  for( i = 0; i < cfg_lookups; ++i )
+    sum += OO_SP_TO_INT(tuple_lookup(ni, &tuples[order[i % n]]));
+  t_hit = (now() - t) * 1e9 / cfg_lookups;
+
+  t = now();
+  for( i = 0; i < cfg_lookups; ++i )
+    sum += OO_SP_TO_INT(tuple_lookup(ni, &absent[order[i % n] % n_absent]));
+  t_miss = (now() - t) * 1e9 / cfg_lookups;
+  TEST(sum != 1);  /* keep the lookups */
+  free(order);
+
+  printf("%-6s entries=%u slots=%u tombstones=%u max_hops=%u "
+         "compact_moves=%u hit=%.1fns miss=%.1fns\n", phase,
+         st->table_n_entries, st->table_n_slots,
+         st->table_n_slots - st->table_n_entries, st->table_max_hops,
+         st->table_compact_moves, t_hit, t_miss);
+}
+
+
+int main(int argc, char** argv)
+{
+  ci_netif ni;
+  struct tuple* tuples;
+  struct tuple* absent;
+  int n, n_absent, c, i, r;
+
+  while( (c = getopt(argc, argv, "t:l:c:n:d:S:")) != -1 )
+    switch( c ) {
+    case 't':
+      cfg_table_lg2 = atoi(optarg);
+      break;
+    case 'l':
+      cfg_load = atoi(optarg);
+      break;
+    case 'c':
+      cfg_churn = atoi(optarg);
+      break;
+    case 'n':
+      cfg_lookups = atoi(optarg);
+      break;
+    case 'd':
+      cfg_dist = optarg;
+      break;
+    case 'S':
+      cfg_seed = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: filter_table [-t table-size-lg2] [-l load%%] "
+              "[-c churn-rounds] [-n lookups] [-d server|client|random] "
+              "[-S seed]\n");
+      return 1;
+    }
+  TEST(cfg_table_lg2 >= 16 && cfg_table_lg2 <= 22);
+  TEST(cfg_load > 0 && cfg_load < 100);
+  TEST(! strcmp(cfg_dist, "server") || ! strcmp(cfg_dist, "client") ||
+       ! strcmp(cfg_dist, "random"));
+  srand(cfg_seed);
+
+  n = (1 << cfg_table_lg2) / 100 * cfg_load;
+  n_absent = n;
+  netif_init(&ni, n);
+  TEST((tuples = malloc(sizeof(*tuples) * n)) != NULL);
+  TEST((absent = malloc(sizeof(*absent) * n_absent)) != NULL);
+
+  /* The table holds one entry per tuple, so duplicates are redrawn. */
+  for( i = 0; i < n; ++i ) {
+    do
+      tuple_gen(&tuples[i]);
+    while( ! OO_SP_IS_NULL(tuple_lookup(&ni, &tuples[i])) );
+    TEST(tuple_insert(&ni, i, &tuples[i]) == 0);
+  }
+  for( i = 0; i < n_absent; ++i )
+    do
+      tuple_gen(&absent[i]);
+    while( ! OO_SP_IS_NULL(tuple_lookup(&ni, &absent[i])) );
+
+  printf("dist=%s table=2^%d load=%d%%\n", cfg_dist, cfg_table_lg2,
+         cfg_load);
+  check_and_time(&ni, "fill", tuples, n, absent, n_absent);
+
+  /* Each round replaces a quarter of the entries with fresh tuples. */
+  for( r = 0; r < cfg_churn; ++r ) {
+    for( i = 0; i < n; ++i ) {
+      if( rand() % 4 )
+        continue;
+      tuple_remove(&ni, i, &tuples[i]);
+      TEST(OO_SP_IS_NULL(tuple_lookup(&ni, &tuples[i])));
+      do
+        tuple_gen(&tuples[i]);
+      while( ! OO_SP_IS_NULL(tuple_lookup(&ni, &tuples[i])) );
+      TEST(tuple_insert(&ni, i, &tuples[i]) == 0);
+    }
+  }
+  if( cfg_churn > 0 ) {
+    /* Some absent tuples may have been inserted by now. */
+    for( i = 0; i < n_absent; ++i )
+      while( ! OO_SP_IS_NULL(tuple_lookup(&ni, &absent[i])) )
+        tuple_gen(&absent[i]);
+    check_and_time(&ni, "churn", tuples, n, absent, n_absent);
+  }
+
+  /* Everything out: no entries, and no tombstones left behind. */
+  for( i = 0; i < n; ++i )
+    tuple_remove(&ni, i, &tuples[i]);
+  TEST(ni.state->stats.table_n_entries == 0);
+  TEST(ni.state->stats.table_n_slots == 0);
+  for( i = 0; i <= ni.filter_table->table_size_mask; ++i )
+    TEST(ni.filter_table_ext[i].route_count == 0);
+
+  return 0;
+}
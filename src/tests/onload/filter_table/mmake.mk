@@ -0,0 +1,17 @@
+# SPDX-License-Identifier: BSD-2-Clause
+# X-SPDX-Copyright-Text: (c) Solarflare Communications Inc
+TARGETS	:= filter_table
+
+MMAKE_LIBS	:= $(LINK_CIIP_LIB) $(LINK_CIAPP_LIB) $(LINK_CITOOLS_LIB) \
+		   $(LINK_CIUL_LIB) $(LINK_CPLANE_LIB)
+MMAKE_LIB_DEPS	:= $(CIIP_LIB_DEPEND) $(CIAPP_LIB_DEPEND) \
+		   $(CITOOLS_LIB_DEPEND) $(CIUL_LIB_DEPEND) \
+		   $(CPLANE_LIB_DEPEND)
+
+all: $(TARGETS)
+
+targets:
+	@echo $(TARGETS)
+
+clean:
+	@$(MakeClean)
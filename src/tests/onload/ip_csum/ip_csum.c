@@ -0,0 +1,381 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test and benchmark of the checksum and checksum-copy code in citools.
+ *
+ * Each implementation in ci_ip_csum_ops_all[] that this CPU can run is
+ * made the current one in turn, and ci_ip_csum_partial(),
+ * ci_ip_csum_copy2(), ci_ip_csum_copy_iovec() and ci_ip_csum_copy_to_iovec()
+ * are called on random data with random lengths, offsets, segmentation and
+ * initial sums.  Every result must match the scalar implementation's, the
+ * copies must be exact and must not write outside their destination, and
+ * the partial sum must match a byte-at-a-time reference.
+ *
+ * Then the throughput of ci_ip_csum_partial() and ci_ip_csum_copy2() is
+ * reported for each implementation over a range of buffer sizes.  Exits
+ * with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <ci/tools.h>
+#include <ci/tools/ipcsum.h>
+#include <ci/tools/cpu_features.h>
+
+
+#if CI_HAVE_IP_CSUM_SIMD
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define BUF_MAX    (16 * 1024)
+#define SLACK      64
+#define IOV_MAX_N  8
+#define GUARD      0xa5
+
+
+static int cfg_iters = 20000;
+static int cfg_bench_bytes = 1 << 30;
+static unsigned cfg_seed = 1;
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* Fold to 16 bits with end-around carry.  Two partial sums of the same
+ * data fold to the same value, whatever width they were carried at. */
+static unsigned fold(unsigned sum)
+{
+  while( sum >> 16 )
+    sum = (sum & 0xffff) + (sum >> 16);
+  return sum;
+}
+
+
+/* The checksum of [len] bytes taken in pairs as they lie in memory, as
+ * the 16-bit loads of the scalar code see them. */
+static unsigned ref_csum(unsigned sum, const ci_uint8* p, int len)
+{
+  ci_uint16 w;
+  int i;
+
+  sum = fold(sum);
+  for( i = 0; i + 1 < len; i += 2 ) {
+    memcpy(&w, p + i, 2);
+    sum = fold(sum + w);
+  }
+  if( len & 1 ) {
+    w = 0;
+    memcpy(&w, p + i, 1);
+    sum = fold(sum + w);
+  }
+  return sum;
+}
+
+
+static int rand_len(void)
+{
+  /* Mostly the lengths of packets, sometimes anything. */
+  switch( rand() % 4 ) {
+  case 0:
+    return rand() % 64;
+  case 1:
+    return rand() % 256;
+  case 2:
+    return rand() % 1500;
+  default:
+    return rand() % BUF_MAX;
+  }
+}
+
+
+static void rand_fill(ci_uint8* p, int len)
+{
+  int i;
+  for( i = 0; i < len; ++i )
+    p[i] = rand();
+  /* Runs of 0xff and 0 exercise the carries. */
+  if( len > 0 && rand() % 8 == 0 )
+    memset(p + rand() % len, rand() & 1 ? 0xff : 0, rand() % len / 2);
+}
+
+
+static void check_guard(const ci_uint8* p, int len)
+{
+  int i;
+  for( i = 0; i < len; ++i )
+    TEST(p[i] == GUARD);
+}
+
+
+/**********************************************************************
+ * Equivalence
+ */
+
+struct ctx {
+  const struct ci_ip_csum_ops* ops;
+  const struct ci_ip_csum_ops* scalar;
+  ci_uint8* src;
+  ci_uint8* dst;
+  ci_uint8* dst_c;
+};
+
+
+static void with_ops(const struct ci_ip_csum_ops* ops)
+{
+  ci_ip_csum_ops = ops;
+}
+
+
+static void check_partial(struct ctx* c)
+{
+  int off = rand() % SLACK, len = rand_len();
+  unsigned sum = rand() & 0xffffff, s, s_c;
+
+  rand_fill(c->src + off, len);
+  with_ops(c->ops);
+  s = ci_ip_csum_partial(sum, c->src + off, len);
+  with_ops(c->scalar);
+  s_c = ci_ip_csum_partial(sum, c->src + off, len);
+  TEST(fold(s) == fold(s_c));
+  TEST(fold(s) == ref_csum(sum, c->src + off, len));
+}
+
+
+static void check_copy2(struct ctx* c)
+{
+  int soff = rand() % SLACK, doff = rand() % SLACK;
+  int len = rand_len() & ~1;
+  unsigned sum = rand() & 0xffffff, s, s_c;
+
+  rand_fill(c->src + soff, len);
+  memset(c->dst, GUARD, BUF_MAX + 2 * SLACK);
+  with_ops(c->ops);
+  s = ci_ip_csum_copy2(c->dst + doff, c->src + soff, len, sum);
+  s_c = ci_ip_csum_partial_c(sum, c->src + soff, len);
+  TEST(fold(s) == fold(s_c));
+  TEST(memcmp(c->dst + doff, c->src + soff, len) == 0);
+  check_guard(c->dst, doff);
+  check_guard(c->dst + doff + len, BUF_MAX + 2 * SLACK - doff - len);
+}
+
+
+/* Splits [len] bytes at [p] into up to IOV_MAX_N segments of random
+ * length, some of them odd and some empty. */
+static int rand_iov(ci_iovec* iov, ci_uint8* p, int len)
+{
+  int n = 0, seg;
+
+  while( len > 0 && n < IOV_MAX_N - 1 ) {
+    seg = rand() % 3 == 0 ? rand() % 8 : rand() % (len + 1);
+    CI_IOVEC_BASE(&iov[n]) = (char*) p;
+    CI_IOVEC_LEN(&iov[n]) = seg;
+    p += seg;
+    len -= seg;
+    ++n;
+  }
+  CI_IOVEC_BASE(&iov[n]) = (char*) p;
+  CI_IOVEC_LEN(&iov[n]) = len;
+  return n + 1;
+}
+
+
+static void check_copy_iovec(struct ctx* c)
+{
+  int soff = rand() % SLACK, doff = rand() % SLACK;
+  int len = rand_len(), dest_len, unalign = rand() % 4 == 0;
+  unsigned sum = rand() & 0xffffff, s = sum, s_c = sum;
+  ci_iovec iov[IOV_MAX_N];
+  ci_iovec_ptr p, p_c;
+  int n_iov, n, n_c;
+
+  rand_fill(c->src + soff, len);
+  n_iov = rand_iov(iov, c->src + soff, len);
+  dest_len = rand() % 4 == 0 ? rand() % (len + 1) : len;
+  memset(c->dst, GUARD, BUF_MAX + 2 * SLACK);
+  memset(c->dst_c, GUARD, BUF_MAX + 2 * SLACK);
+
+  with_ops(c->ops);
+  ci_iovec_ptr_init(&p, iov, n_iov);
+  n = ci_ip_csum_copy_iovec(c->dst + doff, dest_len, unalign, &p, &s);
+  with_ops(c->scalar);
+  ci_iovec_ptr_init(&p_c, iov, n_iov);
+  n_c = ci_ip_csum_copy_iovec(c->dst_c + doff, dest_len, unalign, &p_c,
+                              &s_c);
+
+  TEST(n == n_c);
+  TEST(n == dest_len);
+  TEST(fold(s) == fold(s_c));
+  TEST(p.iovlen == p_c.iovlen);
+  TEST(CI_IOVEC_LEN(&p.io) == CI_IOVEC_LEN(&p_c.io));
+  TEST(CI_IOVEC_LEN(&p.io) == 0 ||
+       CI_IOVEC_BASE(&p.io) == CI_IOVEC_BASE(&p_c.io));
+  TEST(memcmp(c->dst + doff, c->src + soff, n) == 0);
+  TEST(memcmp(c->dst, c->dst_c, BUF_MAX + 2 * SLACK) == 0);
+  if( ! unalign )
+    TEST(fold(s) == ref_csum(sum, c->dst + doff, n));
+}
+
+
+static void check_copy_to_iovec(struct ctx* c)
+{
+  int soff = rand() % SLACK, doff = rand() % SLACK;
+  int len = rand_len(), src_len = rand() % 4 == 0 ? rand() % (len + 1) : len;
+  unsigned sum = rand() & 0xffffff, s = sum, s_c = sum;
+  ci_iovec iov[IOV_MAX_N], iov_c[IOV_MAX_N];
+  ci_iovec_ptr p, p_c;
+  int i, n_iov, n, n_c;
+
+  rand_fill(c->src + soff, src_len);
+  n_iov = rand_iov(iov, c->dst + doff, len);
+  for( i = 0; i < n_iov; ++i ) {
+    CI_IOVEC_BASE(&iov_c[i]) = (char*) c->dst_c +
+      ((ci_uint8*) CI_IOVEC_BASE(&iov[i]) - c->dst);
+    CI_IOVEC_LEN(&iov_c[i]) = CI_IOVEC_LEN(&iov[i]);
+  }
+  memset(c->dst, GUARD, BUF_MAX + 2 * SLACK);
+  memset(c->dst_c, GUARD, BUF_MAX + 2 * SLACK);
+
+  with_ops(c->ops);
+  ci_iovec_ptr_init(&p, iov, n_iov);
+  n = ci_ip_csum_copy_to_iovec(&p, c->src + soff, src_len, &s);
+  with_ops(c->scalar);
+  ci_iovec_ptr_init(&p_c, iov_c, n_iov);
+  n_c = ci_ip_csum_copy_to_iovec(&p_c, c->src + soff, src_len, &s_c);
+
+  TEST(n == n_c);
+  TEST(n == src_len);
+  TEST(fold(s) == fold(s_c));
+  TEST(p.iovlen == p_c.iovlen);
+  TEST(CI_IOVEC_LEN(&p.io) == CI_IOVEC_LEN(&p_c.io));
+  TEST(memcmp(c->dst + doff, c->src + soff, n) == 0);
+  TEST(memcmp(c->dst, c->dst_c, BUF_MAX + 2 * SLACK) == 0);
+  TEST(fold(s) == ref_csum(sum, c->src + soff, n));
+}
+
+
+static void check_ops(struct ctx* c)
+{
+  int i;
+
+  for( i = 0; i < cfg_iters; ++i )
+    switch( i % 4 ) {
+    case 0:
+      check_partial(c);
+      break;
+    case 1:
+      check_copy2(c);
+      break;
+    case 2:
+      check_copy_iovec(c);
+      break;
+    default:
+      check_copy_to_iovec(c);
+      break;
+    }
+}
+
+
+/**********************************************************************
+ * Throughput
+ */
+
+static void bench_ops(struct ctx* c)
+{
+  static const int sizes[] = { 64, 128, 256, 576, 1460, 4096, 9000 };
+  unsigned sum = 0;
+  double t, t_partial, t_copy;
+  int i, j, n;
+
+  with_ops(c->ops);
+  for( i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i ) {
+    n = cfg_bench_bytes / sizes[i];
+
+    t = now();
+    for( j = 0; j < n; ++j )
+      sum += ci_ip_csum_partial(sum, c->src, sizes[i]);
+    t_partial = now() - t;
+
+    t = now();
+    for( j = 0; j < n; ++j )
+      sum += ci_ip_csum_copy2(c->dst, c->src, sizes[i], sum);
+    t_copy = now() - t;
+
+    printf("  %-8s %5d bytes: partial %6.2f GB/s, copy %6.2f GB/s\n",
+           c->ops->name, sizes[i],
+           (double) n * sizes[i] / t_partial * 1e-9,
+           (double) n * sizes[i] / t_copy * 1e-9);
+  }
+  TEST(sum != 1);  /* keep the sums */
+}
+
+
+int main(int argc, char** argv)
+{
+  const struct ci_ip_csum_ops* const* ops;
+  struct ctx c;
+  int opt;
+
+  while( (opt = getopt(argc, argv, "i:b:S:")) != -1 )
+    switch( opt ) {
+    case 'i':
+      cfg_iters = atoi(optarg);
+      break;
+    case 'b':
+      cfg_bench_bytes = atoi(optarg);
+      break;
+    case 'S':
+      cfg_seed = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: ip_csum [-i iterations] [-b bench-bytes] "
+              "[-S seed]\n");
+      return 1;
+    }
+  srand(cfg_seed);
+
+  TEST((c.src = malloc(BUF_MAX + 2 * SLACK)) != NULL);
+  TEST((c.dst = malloc(BUF_MAX + 2 * SLACK)) != NULL);
+  TEST((c.dst_c = malloc(BUF_MAX + 2 * SLACK)) != NULL);
+  for( ops = ci_ip_csum_ops_all; ops[1] != NULL; ++ops )
+    ;
+  c.scalar = *ops;
+  TEST(c.scalar->feature == NULL);
+
+  for( ops = ci_ip_csum_ops_all; *ops != NULL; ++ops ) {
+    c.ops = *ops;
+    if( c.ops->feature != NULL && ! ci_cpu_has_feature(c.ops->feature) ) {
+      printf("%s: not supported by this CPU\n", c.ops->name);
+      continue;
+    }
+    check_ops(&c);
+    printf("%s: %d checks passed\n", c.ops->name, cfg_iters);
+    rand_fill(c.src, BUF_MAX);
+    bench_ops(&c);
+  }
+  return 0;
+}
+
+#else
+
+int main(int argc, char** argv)
+{
+  printf("ip_csum: no vector implementations in this build\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,310 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test of the IP timer wheel and of per-socket TCP timer coalescing
+ * (EF_TCP_TIMER_COALESCE).
+ *
+ * Each case is run twice: once with the TCP timers on the wheel, and once
+ * with them flagged CI_IP_TIMER_FLAG_COALESCED, as ci_tcp_state_init()
+ * sets them up for each setting of the option.  Time is moved on one tick
+ * at a time, with ci_ip_timer_poll() called at each tick, and a timer must
+ * fire at exactly its deadline in both modes:
+ *
+ *  - deadline: a socket's earliest timer decides when its coalesced timer
+ *    is due, and cancelling that timer leaves the others to fire on time;
+ *  - rearm: a timer that is cancelled and set again, later or earlier,
+ *    fires at the new deadline and not at the old one;
+ *  - turn: timers whose deadlines are on the far side of a turn of wheels
+ *    1, 2 and 3 are cascaded, or pre-cascaded, into place in time.
+ *
+ * The zero-window probe timer is used as the one that fires: with the
+ * send window open, ci_tcp_timeout_zwin() just clears [zwin_probes].  The
+ * other timers are always cancelled before their deadlines.
+ *
+ * The stack exists only in this process: the shared state and the socket
+ * buffers are ordinary memory, laid out as the stack lays them out so that
+ * the wheel's lists and socket ids resolve.  Exits with status 0 on
+ * success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ci/internal/ip.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define N_SOCKS     4
+
+/* Wheel 3 turns every 2^24 ticks. */
+#define WHEEL3_TURN (1u << (CI_IPTIME_BUCKETBITS * 3))
+
+
+static void netif_init(ci_netif* ni, ci_iptime_t start)
+{
+  ci_ip_timer_state* its;
+  unsigned ep_ofs;
+  int i;
+
+  ep_ofs = CI_ROUND_UP(sizeof(ci_netif_state), EP_BUF_SIZE);
+  memset(ni, 0, sizeof(*ni));
+  TEST((ni->state = calloc(1, ep_ofs + N_SOCKS * EP_BUF_SIZE)) != NULL);
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  /* Set up by the driver, so const here. */
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  *(ci_uint32*) &ni->state->n_ep_bufs = N_SOCKS;
+
+  /* As ci_ip_timer_state_init(), but starting at [start]. */
+  its = IPTIMER_STATE(ni);
+  its->ci_ip_time_real_ticks = start;
+  its->sched_ticks = start;
+  its->closest_timer = start + 2 * CI_IPTIME_BUCKETS;
+  ci_ni_dllist_init(ni, &its->fire_list,
+                    oo_ptr_to_statep(ni, &its->fire_list), "fire");
+  for( i = 0; i < CI_IPTIME_WHEELSIZE; ++i )
+    ci_ni_dllist_init(ni, &its->warray[i],
+                      oo_ptr_to_statep(ni, &its->warray[i]), "timw");
+}
+
+
+static void netif_fini(ci_netif* ni)
+{
+  free(ni->state);
+}
+
+
+static ci_iptime_t now(ci_netif* ni)
+{
+  return ci_ip_time_now(ni);
+}
+
+
+/* Moves time on to [t], polling the wheel at each tick. */
+static void run_to(ci_netif* ni, ci_iptime_t t)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+
+  while( TIME_LT(its->ci_ip_time_real_ticks, t) ) {
+    ++its->ci_ip_time_real_ticks;
+    ci_ip_timer_poll(ni);
+  }
+  CI_DEBUG(ci_ip_timer_state_assert_valid(ni, __FILE__, __LINE__));
+}
+
+
+static void timer_init(ci_netif* ni, ci_tcp_state* ts, ci_ip_timer* t,
+                       int fn, int coalesce)
+{
+  oo_p sp = TS_OFF(ni, ts);
+
+  OO_P_ADD(sp, (char*) t - (char*) ts);
+  t->param1 = S_SP(ts);
+  t->fn = fn;
+  ci_ip_timer_init(ni, t, sp, "test");
+  if( coalesce && fn != CI_IP_TIMER_TCP_COALESCED )
+    t->flags = CI_IP_TIMER_FLAG_COALESCED;
+}
+
+
+/* An established connection with its send window open, and with its
+ * timers set up as ci_tcp_state_setup_timers() does. */
+static ci_tcp_state* ts_init(ci_netif* ni, int id, int coalesce)
+{
+  oo_sp sockp = OO_SP_FROM_INT(ni, id);
+  ci_tcp_state* ts = SP_TO_TCP(ni, sockp);
+
+  memset(ts, 0, sizeof(*ts));
+  ts->s.b.bufid = sockp;
+  ts->s.b.state = CI_TCP_ESTABLISHED;
+  ts->snd_una = 1000;
+  ts->snd_max = 2000;
+  timer_init(ni, ts, &ts->rto_tid, CI_IP_TIMER_TCP_RTO, coalesce);
+  timer_init(ni, ts, &ts->delack_tid, CI_IP_TIMER_TCP_DELACK, coalesce);
+  timer_init(ni, ts, &ts->zwin_tid, CI_IP_TIMER_TCP_ZWIN, coalesce);
+  timer_init(ni, ts, &ts->kalive_tid, CI_IP_TIMER_TCP_KALIVE, coalesce);
+  timer_init(ni, ts, &ts->cork_tid, CI_IP_TIMER_TCP_CORK, coalesce);
+  timer_init(ni, ts, &ts->timers_tid, CI_IP_TIMER_TCP_COALESCED, coalesce);
+  return ts;
+}
+
+
+static void zwin_set(ci_netif* ni, ci_tcp_state* ts, ci_iptime_t t)
+{
+  ts->zwin_probes = 1;
+  ci_ip_timer_set(ni, &ts->zwin_tid, t);
+}
+
+
+static int zwin_fired(ci_tcp_state* ts)
+{
+  return ts->zwin_probes == 0;
+}
+
+
+/* Moves time on to [t], checking that the zero-window timer of [ts] fires
+ * at [t] and not before. */
+static void run_to_zwin(ci_netif* ni, ci_tcp_state* ts, ci_iptime_t t)
+{
+  run_to(ni, t - 1);
+  TEST(! zwin_fired(ts));
+  TEST(ci_ip_timer_pending(ni, &ts->zwin_tid));
+  run_to(ni, t);
+  TEST(zwin_fired(ts));
+  TEST(! ci_ip_timer_pending(ni, &ts->zwin_tid));
+}
+
+
+static void test_deadline(int coalesce)
+{
+  ci_netif ni;
+  ci_tcp_state* ts;
+  ci_iptime_t t0;
+
+  netif_init(&ni, 1000);
+  ts = ts_init(&ni, 0, coalesce);
+  t0 = now(&ni);
+
+  ci_ip_timer_set(&ni, &ts->rto_tid, t0 + 50);
+  ci_ip_timer_set(&ni, &ts->delack_tid, t0 + 10);
+  zwin_set(&ni, ts, t0 + 30);
+  TEST(ci_ip_timer_pending(&ni, &ts->rto_tid));
+  TEST(ci_ip_timer_pending(&ni, &ts->delack_tid));
+  if( coalesce ) {
+    /* One timer on the wheel, for the earliest deadline. */
+    TEST(ci_ip_timer_pending(&ni, &ts->timers_tid));
+    TEST(ts->timers_tid.time == t0 + 10);
+  }
+  else {
+    TEST(! ci_ip_timer_pending(&ni, &ts->timers_tid));
+  }
+
+  /* Cancelling the earliest leaves the coalesced timer due, to find
+   * nothing to do and re-arm itself. */
+  ci_ip_timer_clear(&ni, &ts->delack_tid);
+  TEST(! ci_ip_timer_pending(&ni, &ts->delack_tid));
+  run_to(&ni, t0 + 10);
+  if( coalesce ) {
+    TEST(ni.state->stats.timer_coalesced_idle == 1);
+    TEST(ts->timers_tid.time == t0 + 30);
+  }
+
+  run_to_zwin(&ni, ts, t0 + 30);
+  TEST(ci_ip_timer_pending(&ni, &ts->rto_tid));
+  if( coalesce )
+    TEST(ts->timers_tid.time == t0 + 50);
+
+  /* Cancelling the last pending timer takes the socket off the wheel. */
+  ci_ip_timer_clear(&ni, &ts->rto_tid);
+  TEST(! ci_ip_timer_pending(&ni, &ts->rto_tid));
+  TEST(! ci_ip_timer_pending(&ni, &ts->timers_tid));
+  run_to(&ni, t0 + 1000);
+  netif_fini(&ni);
+}
+
+
+static void test_rearm(int coalesce)
+{
+  ci_netif ni;
+  ci_tcp_state* ts;
+  ci_iptime_t t0;
+
+  netif_init(&ni, 1000);
+  ts = ts_init(&ni, 0, coalesce);
+  t0 = now(&ni);
+
+  /* Re-armed later: must not fire at the old deadline. */
+  zwin_set(&ni, ts, t0 + 20);
+  ci_ip_timer_clear(&ni, &ts->zwin_tid);
+  TEST(! ci_ip_timer_pending(&ni, &ts->zwin_tid));
+  TEST(! ci_ip_timer_pending(&ni, &ts->timers_tid));
+  zwin_set(&ni, ts, t0 + 40);
+  run_to_zwin(&ni, ts, t0 + 40);
+
+  /* Modified later while another timer keeps the socket on the wheel. */
+  t0 = now(&ni);
+  ci_ip_timer_set(&ni, &ts->kalive_tid, t0 + 100);
+  zwin_set(&ni, ts, t0 + 20);
+  ci_ip_timer_modify(&ni, &ts->zwin_tid, t0 + 60);
+  run_to_zwin(&ni, ts, t0 + 60);
+
+  /* Modified earlier. */
+  t0 = now(&ni);
+  zwin_set(&ni, ts, t0 + 30);
+  ci_ip_timer_modify(&ni, &ts->zwin_tid, t0 + 5);
+  run_to_zwin(&ni, ts, t0 + 5);
+  run_to(&ni, t0 + 30);
+  TEST(ci_ip_timer_pending(&ni, &ts->kalive_tid));
+  if( coalesce )
+    TEST(ts->timers_tid.time == ts->kalive_tid.time);
+
+  ci_ip_timer_clear(&ni, &ts->kalive_tid);
+  TEST(! ci_ip_timer_pending(&ni, &ts->timers_tid));
+  netif_fini(&ni);
+}
+
+
+static void test_turn(int coalesce)
+{
+  /* Deadlines relative to a start just before a turn of wheel 3, so that
+   * all but the first cross turns of wheels 1, 2 and 3; the last is due
+   * in the second turn of wheel 2 after that. */
+  static const unsigned deadlines[N_SOCKS] = { 5, 200, 300, 70000 };
+  ci_tcp_state* ts[N_SOCKS];
+  ci_netif ni;
+  ci_iptime_t t0;
+  int i, fired;
+
+  netif_init(&ni, 3 * WHEEL3_TURN - 100);
+  t0 = now(&ni);
+  for( i = 0; i < N_SOCKS; ++i ) {
+    ts[i] = ts_init(&ni, i, coalesce);
+    zwin_set(&ni, ts[i], t0 + deadlines[i]);
+    /* Keeps the coalesced timer going after each has fired. */
+    ci_ip_timer_set(&ni, &ts[i]->rto_tid, t0 + 2 * WHEEL3_TURN);
+  }
+
+  for( fired = 0; fired < N_SOCKS; ) {
+    run_to(&ni, now(&ni) + 1);
+    for( i = 0, fired = 0; i < N_SOCKS; ++i ) {
+      TEST(zwin_fired(ts[i]) ==
+           TIME_GE(now(&ni), t0 + deadlines[i]));
+      fired += zwin_fired(ts[i]);
+    }
+  }
+  TEST(now(&ni) == t0 + deadlines[N_SOCKS - 1]);
+  printf("%s: %u ticks, %u timers cascaded, %u pre-cascaded\n",
+         coalesce ? "coalesced" : "separate",
+         now(&ni) - t0, ni.state->stats.timer_cascade_moves,
+         ni.state->stats.timer_precascade_moves);
+
+  for( i = 0; i < N_SOCKS; ++i ) {
+    TEST(ci_ip_timer_pending(&ni, &ts[i]->rto_tid));
+    if( coalesce )
+      TEST(ts[i]->timers_tid.time == ts[i]->rto_tid.time);
+    ci_ip_timer_clear(&ni, &ts[i]->rto_tid);
+    TEST(! ci_ip_timer_pending(&ni, &ts[i]->timers_tid));
+  }
+  CI_DEBUG(ci_ip_timer_state_assert_valid(&ni, __FILE__, __LINE__));
+  netif_fini(&ni);
+}
+
+
+int main(int argc, char** argv)
+{
+  int coalesce;
+
+  for( coalesce = 0; coalesce <= 1; ++coalesce ) {
+    test_deadline(coalesce);
+    test_rearm(coalesce);
+    test_turn(coalesce);
+  }
+  return 0;
+}
@@ -1,7 +1,11 @@
 # SPDX-License-Identifier: BSD-2-Clause
 # X-SPDX-Copyright-Text: (c) Solarflare Communications Inc
 SUBDIRS	:= wire_order tproxy_preload woda_preload hwtimestamping \
-           sync_preload l3xudp_preload
+           sync_preload l3xudp_preload accept_race tcp_pacing \
+           cplane_journal cplane_lpm filter_table \
+           poll_prefetch ip_csum sw_vi \
+           tcp_cong iptimer tcp_rack tcp_splice tcpdump_filter \
+           pkt_numa
 
 ifneq ($(ONLOAD_ONLY),1)
 # These tests have dependency on kernel_compat lib,
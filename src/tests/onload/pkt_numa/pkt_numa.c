@@ -0,0 +1,330 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test of the choice of packet set with EF_PKT_NUMA_LOCAL, that is of
+ * ci_netif_pktset_best_local(), which both receive ring refills and
+ * transmit allocations use.
+ *
+ *  - local: a set on the wanted node with enough free buffers is used,
+ *    even when a set elsewhere has more;
+ *  - brief: when the local sets are short but a set on another node has
+ *    buffers to spare, that set is used and the stack does not grow, until
+ *    the shortage has lasted CI_CFG_PKT_NUMA_GROW_SHORT times in a row;
+ *  - interrupted: a shortage that ends starts the count again;
+ *  - empty: with no buffers to spare anywhere the stack grows at once;
+ *  - elsewhere: a new set that lands on another node stops the stack
+ *    growing for that node, but not for the others;
+ *  - full: at EF_MAX_PACKETS the sets on other nodes are used;
+ *  - any: with no node wanted the set with most free buffers is used.
+ *
+ * The stack exists only in this process: the shared state, the packet set
+ * table and the packet buffers are ordinary memory.  New sets come from a
+ * stand-in for the TCP_MORE_BUFS ioctl, which puts them on the node asked
+ * for unless the test says otherwise.  Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include <ci/internal/ip.h>
+#include <onload/unix_intf.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define MAX_SETS    6
+/* As ci_netif_rx_post() and ci_netif_pkt_alloc_slow() ask. */
+#define RX_MIN      CI_CFG_RX_DESC_BATCH
+#define TX_MIN      1
+
+
+static ci_netif ni;
+
+/* What the stand-in for the ioctl has been asked for. */
+static int n_grows;
+static int grow_node;
+/* Node that new sets land on, or -1 for the one asked for. */
+static int land_node = -1;
+
+
+/* Adds a set on [node] with [n_free] of its buffers free. */
+static int set_add(int node, int n_free)
+{
+  oo_pktbuf_manager* pm = ni.packets;
+  int id = pm->sets_n;
+  ci_ip_pkt_fmt* pkt;
+  oo_pkt_p pp;
+  int i;
+
+  TEST(id < MAX_SETS);
+  if( ni.pkt_bufs[id] == NULL )
+    TEST((ni.pkt_bufs[id] =
+          calloc(PKTS_PER_SET, CI_CFG_PKT_BUF_SIZE)) != NULL);
+  pm->set[id].free = OO_PP_NULL;
+  for( i = 0; i < n_free; ++i ) {
+    OO_PP_INIT(&ni, pp, id * PKTS_PER_SET + i);
+    pkt = PKT(&ni, pp);
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->pp = pp;
+    pkt->n_buffers = 1;
+    pkt->frag_next = OO_PP_NULL;
+    pkt->next = pm->set[id].free;
+    pm->set[id].free = pp;
+  }
+  pm->set[id].n_free = n_free;
+  *(ci_int32*) &pm->set[id].numa_node = node;
+  *(ci_uint32*) &pm->sets_n = id + 1;
+  *(ci_int32*) &pm->n_pkts_allocated += PKTS_PER_SET;
+  pm->n_free += n_free;
+  return id;
+}
+
+
+/* Takes all but [left] of the free buffers of set [id]. */
+static void set_drain(int id, int left)
+{
+  while( ni.packets->set[id].n_free > left )
+    ci_netif_pkt_get(&ni, id);
+}
+
+
+static int fake_ioctl(int fd, unsigned long cmd, ...)
+{
+  ci_int32* node;
+  va_list va;
+
+  TEST(cmd == OO_IOC_TCP_MORE_BUFS);
+  va_start(va, cmd);
+  node = va_arg(va, ci_int32*);
+  va_end(va);
+  ++n_grows;
+  grow_node = *node;
+  set_add(land_node >= 0 ? land_node : *node, PKTS_PER_SET);
+  return 0;
+}
+
+
+static void netif_init(void)
+{
+  int i;
+
+  for( i = 0; i < MAX_SETS; ++i )
+    free(ni.pkt_bufs == NULL ? NULL : ni.pkt_bufs[i]);
+  free(ni.pkt_bufs);
+  free(ni.packets);
+  free(ni.state);
+  memset(&ni, 0, sizeof(ni));
+  TEST((ni.state = calloc(1, sizeof(ci_netif_state))) != NULL);
+  TEST((ni.packets = calloc(1, sizeof(oo_pktbuf_manager) +
+                            MAX_SETS * sizeof(oo_pktbuf_set))) != NULL);
+  TEST((ni.pkt_bufs = calloc(MAX_SETS, sizeof(ni.pkt_bufs[0]))) != NULL);
+  *(ci_uint32*) &ni.packets->sets_max = MAX_SETS;
+  n_grows = 0;
+  land_node = -1;
+}
+
+
+static unsigned n_remote(void)
+{
+  return ni.state->stats.pkt_set_numa_remote;
+}
+
+
+/* Calls ci_netif_pktset_best_local() [n] times with a shortage on [node]
+ * that a set elsewhere can cover, checking that that set is used. */
+static void short_n(int node, int min_free, int n)
+{
+  unsigned remote = n_remote();
+  int i, id;
+
+  for( i = 0; i < n; ++i ) {
+    id = ci_netif_pktset_best_local(&ni, node, min_free);
+    TEST(id >= 0);
+    TEST(ni.packets->set[id].numa_node != node);
+    TEST(ni.packets->set[id].n_free >= min_free);
+  }
+  TEST(n_remote() == remote + n);
+}
+
+
+static void test_local(void)
+{
+  int local, remote;
+
+  netif_init();
+  remote = set_add(1, PKTS_PER_SET);
+  local = set_add(0, RX_MIN);
+  TEST(ci_netif_pktset_best_local(&ni, 0, RX_MIN) == local);
+  TEST(ci_netif_pktset_best_local(&ni, 1, RX_MIN) == remote);
+  TEST(ci_netif_pktset_best_local(&ni, 0, TX_MIN) == local);
+  TEST(n_grows == 0);
+  TEST(n_remote() == 0);
+}
+
+
+static void test_brief(int min_free)
+{
+  int local, id;
+
+  netif_init();
+  local = set_add(0, PKTS_PER_SET);
+  set_add(1, PKTS_PER_SET);
+  set_drain(local, min_free - 1);
+
+  short_n(0, min_free, CI_CFG_PKT_NUMA_GROW_SHORT - 1);
+  TEST(n_grows == 0);
+  TEST(ni.packets->sets_n == 2);
+
+  /* The shortage has persisted: grow on this node. */
+  id = ci_netif_pktset_best_local(&ni, 0, min_free);
+  TEST(n_grows == 1);
+  TEST(grow_node == 0);
+  TEST(id == 2);
+  TEST(ni.packets->set[id].numa_node == 0);
+  TEST(ni.state->pkt_numa_short[0] == 0);
+  TEST(ni.state->pkt_numa_no_grow == 0);
+}
+
+
+static void test_interrupted(void)
+{
+  ci_ip_pkt_fmt* pkt;
+  oo_pkt_p pp;
+  int local, id;
+
+  netif_init();
+  local = set_add(0, PKTS_PER_SET);
+  set_add(1, PKTS_PER_SET);
+  set_add(2, 0);
+  set_drain(local, 0);
+
+  short_n(0, TX_MIN, CI_CFG_PKT_NUMA_GROW_SHORT - 1);
+  /* A buffer is freed back to the local set. */
+  OO_PP_INIT(&ni, pp, local * PKTS_PER_SET);
+  pkt = PKT(&ni, pp);
+  pkt->refcount = 0;
+  ci_netif_pkt_put(&ni, pkt);
+  TEST(ci_netif_pktset_best_local(&ni, 0, TX_MIN) == local);
+  TEST(ni.state->pkt_numa_short[0] == 0);
+  set_drain(local, 0);
+  short_n(0, TX_MIN, CI_CFG_PKT_NUMA_GROW_SHORT - 1);
+  TEST(n_grows == 0);
+
+  /* A shortage on another node is counted apart. */
+  short_n(2, TX_MIN, CI_CFG_PKT_NUMA_GROW_SHORT - 1);
+  TEST(n_grows == 0);
+  id = ci_netif_pktset_best_local(&ni, 0, TX_MIN);
+  TEST(n_grows == 1);
+  TEST(grow_node == 0);
+  TEST(ni.packets->set[id].numa_node == 0);
+  TEST(ni.state->pkt_numa_short[2] == CI_CFG_PKT_NUMA_GROW_SHORT - 1);
+}
+
+
+static void test_empty(void)
+{
+  int local, remote, id;
+
+  netif_init();
+  local = set_add(0, PKTS_PER_SET);
+  remote = set_add(1, PKTS_PER_SET);
+  set_drain(local, RX_MIN - 1);
+  set_drain(remote, RX_MIN - 1);
+
+  id = ci_netif_pktset_best_local(&ni, 0, RX_MIN);
+  TEST(n_grows == 1);
+  TEST(grow_node == 0);
+  TEST(id == 2);
+  TEST(ni.packets->set[id].numa_node == 0);
+  TEST(n_remote() == 0);
+}
+
+
+static void test_elsewhere(void)
+{
+  int id, i;
+
+  netif_init();
+  set_add(0, 0);
+  set_add(1, 0);
+  land_node = 1;
+
+  /* The new set is not local, but is better than nothing. */
+  id = ci_netif_pktset_best_local(&ni, 0, TX_MIN);
+  TEST(n_grows == 1);
+  TEST(id == 2);
+  TEST(ni.packets->set[id].numa_node == 1);
+  TEST(ni.state->pkt_numa_no_grow == 1u << 0);
+  TEST(n_remote() == 1);
+
+  /* However long the shortage lasts, node 0 does not grow again. */
+  for( i = 0; i < 4 * CI_CFG_PKT_NUMA_GROW_SHORT; ++i )
+    TEST(ci_netif_pktset_best_local(&ni, 0, TX_MIN) == id);
+  TEST(n_grows == 1);
+  TEST(n_remote() == 1 + 4 * CI_CFG_PKT_NUMA_GROW_SHORT);
+
+  /* Node 1 still may. */
+  land_node = -1;
+  set_drain(id, 0);
+  TEST(ci_netif_pktset_best_local(&ni, 1, TX_MIN) == 3);
+  TEST(n_grows == 2);
+  TEST(grow_node == 1);
+}
+
+
+static void test_full(void)
+{
+  int local, i;
+
+  netif_init();
+  local = set_add(0, PKTS_PER_SET);
+  for( i = 1; i < MAX_SETS; ++i )
+    set_add(i, PKTS_PER_SET);
+  set_drain(local, 0);
+
+  for( i = 0; i < 4 * CI_CFG_PKT_NUMA_GROW_SHORT; ++i )
+    TEST(ci_netif_pktset_best_local(&ni, 0, RX_MIN) > local);
+  TEST(n_grows == 0);
+  TEST(n_remote() == 4 * CI_CFG_PKT_NUMA_GROW_SHORT);
+}
+
+
+static void test_any(void)
+{
+  int local, remote;
+
+  netif_init();
+  local = set_add(0, RX_MIN);
+  remote = set_add(1, 2 * RX_MIN);
+  TEST(ci_netif_pktset_best_local(&ni, -1, RX_MIN) == remote);
+  set_drain(remote, 0);
+  TEST(ci_netif_pktset_best_local(&ni, -1, RX_MIN) == local);
+  set_drain(local, 0);
+  TEST(ci_netif_pktset_best_local(&ni, -1, RX_MIN) == -1);
+  TEST(n_grows == 0);
+  TEST(n_remote() == 0);
+}
+
+
+int main(int argc, char** argv)
+{
+  ci_sys_ioctl = fake_ioctl;
+
+  test_local();
+  test_brief(RX_MIN);
+  test_brief(TX_MIN);
+  test_interrupted();
+  test_empty();
+  test_elsewhere();
+  test_full();
+  test_any();
+  return 0;
+}
@@ -0,0 +1,414 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Microbenchmark of the poll loop's prefetch pass.
+ *
+ * A stream of RX events is replayed against a stack that exists only in
+ * this process: the shared state, socket buffers, packet buffers and filter
+ * table are ordinary memory, and the events are made up in the way that
+ * ef_eventq_poll() would deliver them.  The packets come from a pcap file
+ * recorded on an Ethernet interface (-r), or else from a set of synthetic
+ * UDP and TCP flows.  There is a socket for each flow in the filter table.
+ *
+ * Each batch of events is handled as ci_netif_poll_evq() begins to handle
+ * it: find the packet, set up its length and buffer, parse its headers,
+ * look it up in the filter table and touch the socket.  This is timed with
+ * and without calling ci_netif_poll_evq_prefetch() ahead of each chunk of
+ * CI_NETIF_POLL_PREFETCH_BATCH events, as the poll loop does when
+ * EF_POLL_PREFETCH is set.  No NIC or driver is needed.
+ *
+ * The packet pool is much larger than the caches, so each event finds its
+ * packet cold, as it would when the NIC has just written it.  Buffers are
+ * posted to the RX ring in a random order, as they come from the free pool
+ * of a stack that has been running for a while; with -s they are posted in
+ * order, which the CPU's own stride prefetcher can follow.  Exits with
+ * status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <ci/internal/ip.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+/* Enough of each frame for the headers. */
+#define FRAME_MAX  256
+
+
+static int cfg_pkts = 1 << 16;
+static int cfg_flows = 1 << 14;
+static int cfg_batch = 64;
+static int cfg_rounds = 20;
+static int cfg_sequential = 0;
+static const char* cfg_pcap = NULL;
+static unsigned cfg_seed = 1;
+
+
+struct frame {
+  int len;
+  ci_uint8 data[FRAME_MAX];
+};
+
+static struct frame* frames;
+static int n_frames;
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*************************************************************************
+ * Traffic
+ */
+
+/* Returns the headers of an IPv4 TCP or UDP frame, or NULL. */
+static ci_ip4_hdr* frame_ip4(const ci_uint8* data, int len)
+{
+  const ci_uint16* p_ether_type = (const void*) (data + 12);
+  ci_ip4_hdr* ip;
+
+  if( len < ETH_HLEN + ETH_VLAN_HLEN + sizeof(ci_ip4_hdr) + 4 )
+    return NULL;
+  if( *p_ether_type == CI_ETHERTYPE_8021Q )
+    p_ether_type += ETH_VLAN_HLEN / sizeof(*p_ether_type);
+  if( *p_ether_type != CI_ETHERTYPE_IP )
+    return NULL;
+  ip = (ci_ip4_hdr*) (p_ether_type + 1);
+  if( CI_IP4_IHL(ip) != sizeof(*ip) ||
+      (ip->ip_protocol != IPPROTO_TCP && ip->ip_protocol != IPPROTO_UDP) )
+    return NULL;
+  return ip;
+}
+
+
+static void frame_add(const ci_uint8* data, int len)
+{
+  struct frame* f;
+
+  if( frame_ip4(data, len) == NULL )
+    return;
+  if( (n_frames & (n_frames - 1)) == 0 )
+    TEST((frames = realloc(frames, sizeof(*frames) *
+                           (n_frames ? n_frames * 2 : 1))) != NULL);
+  f = &frames[n_frames++];
+  f->len = CI_MIN(len, FRAME_MAX);
+  memcpy(f->data, data, f->len);
+}
+
+
+/* Reads the IPv4 TCP and UDP frames from a classic pcap file. */
+static void pcap_read(const char* path)
+{
+  struct {
+    ci_uint32 magic;
+    ci_uint16 major, minor;
+    ci_int32 zone;
+    ci_uint32 sigfigs, snaplen, linktype;
+  } fh;
+  struct {
+    ci_uint32 sec, usec, caplen, len;
+  } rh;
+  ci_uint8 data[65536];
+  FILE* f;
+
+  TEST((f = fopen(path, "r")) != NULL);
+  TEST(fread(&fh, sizeof(fh), 1, f) == 1);
+  TEST(fh.magic == 0xa1b2c3d4 || fh.magic == 0xa1b23c4d);
+  TEST(fh.linktype == 1 /* Ethernet */);
+  while( fread(&rh, sizeof(rh), 1, f) == 1 ) {
+    TEST(rh.caplen <= sizeof(data));
+    TEST(fread(data, rh.caplen, 1, f) == 1);
+    frame_add(data, rh.caplen);
+  }
+  fclose(f);
+  TEST(n_frames > 0);
+}
+
+
+/* Makes a frame for each of [cfg_flows] flows, half UDP and half TCP. */
+static void synth_frames(void)
+{
+  ci_uint8 data[ETH_HLEN + sizeof(ci_ip4_hdr) + sizeof(ci_tcp_hdr) + 64];
+  ci_ip4_hdr* ip = (void*) (data + ETH_HLEN);
+  ci_uint16* ports = (void*) (ip + 1);
+  int i;
+
+  memset(data, 0, sizeof(data));
+  *(ci_uint16*) (data + 12) = CI_ETHERTYPE_IP;
+  for( i = 0; i < cfg_flows; ++i ) {
+    ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+    ip->ip_protocol = i & 1 ? IPPROTO_TCP : IPPROTO_UDP;
+    ip->ip_saddr_be32 = htonl(0x0a000000 | (rand() & 0xffffff));
+    ip->ip_daddr_be32 = htonl(0xc0a80001);
+    ports[0] = htons(1024 + rand() % 64512);
+    ports[1] = htons(i & 1 ? 80 : 5000 + i % 64);
+    frame_add(data, sizeof(data));
+  }
+}
+
+
+/*************************************************************************
+ * The stack
+ */
+
+static void netif_init(ci_netif* ni)
+{
+  unsigned ep_ofs = CI_ALIGN_FWD(sizeof(ci_netif_state), EP_BUF_SIZE);
+  unsigned size_lg2 = 16, size, n_sets, i;
+  size_t len;
+  void* p;
+
+  memset(ni, 0, sizeof(*ni));
+  len = ep_ofs + (size_t) n_frames * EP_BUF_SIZE;
+  TEST(posix_memalign(&p, CI_PAGE_SIZE, len) == 0);
+  memset(p, 0, len);
+  ni->state = p;
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+#if CI_CFG_NETIF_HARDEN
+  ni->ep_ofs = ep_ofs;
+#endif
+
+  while( (1u << size_lg2) < 2 * n_frames )
+    ++size_lg2;
+  size = 1u << size_lg2;
+  TEST(posix_memalign(&p, CI_PAGE_SIZE, sizeof(ci_netif_filter_table) +
+                      size * sizeof(ci_netif_filter_table_entry_fast)) == 0);
+  ni->filter_table = p;
+  TEST((ni->filter_table_ext = calloc(size,
+                            sizeof(ci_netif_filter_table_entry_ext))) != NULL);
+  /* As ci_netif_filter_init() does in the driver.  The state of an entry
+   * is in the top two bits of __id_and_state, and 2 is EMPTY. */
+  *(unsigned*) &ni->filter_table->table_size_mask = size - 1;
+  for( i = 0; i < size; ++i )
+    ni->filter_table->table[i].__id_and_state = 2u << 30;
+
+  /* At user level a packet is found through pkt_bufs alone. */
+  n_sets = (cfg_pkts + PKTS_PER_SET - 1) / PKTS_PER_SET;
+  TEST((ni->pkt_bufs = calloc(n_sets, sizeof(ni->pkt_bufs[0]))) != NULL);
+  for( i = 0; i < n_sets; ++i ) {
+    len = (size_t) PKTS_PER_SET * CI_CFG_PKT_BUF_SIZE;
+    TEST(posix_memalign(&p, CI_PAGE_SIZE, len) == 0);
+    memset(p, 0, len);
+    ni->pkt_bufs[i] = p;
+  }
+}
+
+
+/* Adds a socket for each distinct flow among the frames. */
+static int sockets_init(ci_netif* ni)
+{
+  int i, n = 0;
+
+  for( i = 0; i < n_frames; ++i ) {
+    ci_ip4_hdr* ip = frame_ip4(frames[i].data, frames[i].len);
+    ci_uint16* ports = (ci_uint16*) (ip + 1);
+    ci_addr_t laddr = CI_ADDR_FROM_IP4(ip->ip_daddr_be32);
+    ci_addr_t raddr = CI_ADDR_FROM_IP4(ip->ip_saddr_be32);
+    ci_sock_cmn* s;
+
+    if( ! OO_SP_IS_NULL(ci_netif_filter_lookup(ni, AF_SPACE_FLAG_IP4,
+                                               laddr, ports[1], raddr,
+                                               ports[0], ip->ip_protocol)) )
+      continue;
+    s = SP_TO_SOCK_CMN(ni, OO_SP_FROM_INT(ni, n));
+    s->pkt.ether_type = CI_ETHERTYPE_IP;
+    s->pkt.ipx.ip4.ip_daddr_be32 = ip->ip_saddr_be32;
+    s->pkt.ipx.ip4.ip_protocol = ip->ip_protocol;
+    sock_rport_be16(s) = ports[0];
+    TEST(ci_netif_filter_insert(ni, OO_SP_FROM_INT(ni, n), AF_SPACE_FLAG_IP4,
+                                laddr, ports[1], raddr, ports[0],
+                                ip->ip_protocol) == 0);
+    ++n;
+  }
+  return n;
+}
+
+
+/* Fills the packet pool with the frames, in order, and makes an RX event
+ * for each packet. */
+static ef_event* events_init(ci_netif* ni)
+{
+  ef_event* ev;
+  int* ids;
+  int i, j, t;
+
+  TEST((ev = calloc(cfg_pkts, sizeof(*ev))) != NULL);
+  TEST((ids = malloc(sizeof(*ids) * cfg_pkts)) != NULL);
+  for( i = 0; i < cfg_pkts; ++i )
+    ids[i] = i;
+  if( ! cfg_sequential )
+    for( i = cfg_pkts - 1; i > 0; --i ) {
+      j = rand() % (i + 1);
+      t = ids[i];
+      ids[i] = ids[j];
+      ids[j] = t;
+    }
+
+  for( i = 0; i < cfg_pkts; ++i ) {
+    const struct frame* f = &frames[i % n_frames];
+    ci_ip_pkt_fmt* pkt;
+    oo_pkt_p pp;
+
+    OO_PP_INIT(ni, pp, ids[i]);
+    pkt = PKT(ni, pp);
+    pkt->pp = pp;
+    pkt->pkt_start_off = 0;
+    memcpy(pkt->dma_start, f->data, f->len);
+    ev[i].rx.type = EF_EVENT_TYPE_RX;
+    ev[i].rx.rq_id = ids[i];
+    ev[i].rx.len = f->len;
+    ev[i].rx.flags = EF_EVENT_FLAG_SOP;
+  }
+  free(ids);
+  return ev;
+}
+
+
+/*************************************************************************
+ * The poll loop
+ */
+
+/* What the poll loop does with an event before the packet is passed up to
+ * the protocol: the packet's metadata and headers and the filter lookup,
+ * then the socket. */
+static unsigned handle_event(ci_netif* ni, const ef_event* ev)
+{
+  oo_pkt_p pp;
+  ci_ip_pkt_fmt* pkt;
+  ci_ip4_hdr* ip;
+  ci_uint16* ports;
+  oo_sp sock;
+  ci_sock_cmn* s;
+
+  OO_PP_INIT(ni, pp, EF_EVENT_RX_RQ_ID(*ev));
+  pkt = PKT(ni, pp);
+  pkt->pay_len = EF_EVENT_RX_BYTES(*ev);
+  oo_offbuf_init(&pkt->buf, PKT_START(pkt), pkt->pay_len);
+
+  ip = frame_ip4((ci_uint8*) oo_ether_hdr(pkt), pkt->pay_len);
+  ports = (ci_uint16*) (ip + 1);
+  sock = ci_netif_filter_lookup(ni, AF_SPACE_FLAG_IP4,
+                                CI_ADDR_FROM_IP4(ip->ip_daddr_be32), ports[1],
+                                CI_ADDR_FROM_IP4(ip->ip_saddr_be32), ports[0],
+                                ip->ip_protocol);
+  s = SP_TO_SOCK_CMN(ni, sock);
+  s->b.sleep_seq.all++;
+  return OO_SP_TO_INT(sock);
+}
+
+
+static void poll_batch(ci_netif* ni, const ef_event* ev, int n_evs,
+                       int prefetch, unsigned* sum)
+{
+  int i;
+
+  for( i = 0; i < n_evs; ++i ) {
+    if( prefetch && (i % CI_NETIF_POLL_PREFETCH_BATCH) == 0 && n_evs > 1 )
+      ci_netif_poll_evq_prefetch(ni, &ev[i],
+                                 CI_MIN(n_evs - i,
+                                        CI_NETIF_POLL_PREFETCH_BATCH));
+    *sum += handle_event(ni, &ev[i]);
+  }
+}
+
+
+/* Replays the events in batches, and returns the time per event. */
+static double replay(ci_netif* ni, const ef_event* ev, int prefetch,
+                     unsigned* sum)
+{
+  double t = now();
+  int i;
+
+  for( i = 0; i + cfg_batch <= cfg_pkts; i += cfg_batch )
+    poll_batch(ni, &ev[i], cfg_batch, prefetch, sum);
+  return (now() - t) * 1e9 / i;
+}
+
+
+int main(int argc, char** argv)
+{
+  double t_serial = 0, t_prefetch = 0, t;
+  unsigned sum = 0;
+  ci_netif ni;
+  ef_event* ev;
+  int c, r, n_socks;
+
+  while( (c = getopt(argc, argv, "p:f:b:n:r:sS:")) != -1 )
+    switch( c ) {
+    case 'p':
+      cfg_pkts = atoi(optarg);
+      break;
+    case 'f':
+      cfg_flows = atoi(optarg);
+      break;
+    case 'b':
+      cfg_batch = atoi(optarg);
+      break;
+    case 'n':
+      cfg_rounds = atoi(optarg);
+      break;
+    case 'r':
+      cfg_pcap = optarg;
+      break;
+    case 's':
+      cfg_sequential = 1;
+      break;
+    case 'S':
+      cfg_seed = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: poll_prefetch [-p packets] [-f flows] "
+              "[-b events-per-poll] [-n rounds] [-r file.pcap] [-s] "
+              "[-S seed]\n");
+      return 1;
+    }
+  TEST(cfg_pkts > 0 && cfg_flows > 0 && cfg_rounds > 0);
+  TEST(cfg_batch > 0 && cfg_batch <= cfg_pkts);
+  srand(cfg_seed);
+
+  if( cfg_pcap != NULL )
+    pcap_read(cfg_pcap);
+  else
+    synth_frames();
+  netif_init(&ni);
+  n_socks = sockets_init(&ni);
+  ev = events_init(&ni);
+
+  /* Check every event finds its socket before timing anything. */
+  for( r = 0; r < cfg_pkts; ++r )
+    TEST(handle_event(&ni, &ev[r]) < n_socks);
+
+  /* Alternate, so that both see the same conditions. */
+  for( r = 0; r < cfg_rounds; ++r ) {
+    t_serial += replay(&ni, ev, 0, &sum);
+    t_prefetch += replay(&ni, ev, 1, &sum);
+  }
+  t_serial /= cfg_rounds;
+  t_prefetch /= cfg_rounds;
+  TEST(sum != 1);  /* keep the lookups */
+
+  t = t_serial - t_prefetch;
+  printf("%s: %d frames, %d flows, %d packets, %d events per poll, "
+         "buffers %s\n", cfg_pcap ? cfg_pcap : "synthetic", n_frames, n_socks,
+         cfg_pkts, cfg_batch, cfg_sequential ? "in order" : "shuffled");
+  printf("serial:   %.1f ns/event\n", t_serial);
+  printf("prefetch: %.1f ns/event (%.0f%% %s)\n", t_prefetch,
+         100.0 * (t < 0 ? -t : t) / t_serial, t < 0 ? "slower" : "faster");
+  return 0;
+}
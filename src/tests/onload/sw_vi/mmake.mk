@@ -0,0 +1,15 @@
+# SPDX-License-Identifier: BSD-2-Clause
+# X-SPDX-Copyright-Text: (c) Solarflare Communications Inc
+TARGETS	:= sw_vi
+
+MMAKE_LIBS	:= $(LINK_CIUL_LIB)
+MMAKE_LIB_DEPS	:= $(CIUL_LIB_DEPEND)
+
+
+all: $(TARGETS)
+
+targets:
+	@echo $(TARGETS)
+
+clean:
+	@$(MakeClean)
@@ -0,0 +1,328 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test and benchmark of the software ef_vi backend (EF_VI_SW).
+ *
+ * Needs neither a Solarflare adapter nor the driver.  EF_VI_SW is read once
+ * per process, so the VIs are connected in pairs over the two ports of a
+ * single shared memory wire private to this process, and:
+ *
+ *   - frames of every length from the minimum to the MTU are sent one way
+ *     and checked on arrival, and the sender's TX completions are checked;
+ *
+ *   - the round trip time between two VIs is measured, which is the cost
+ *     of the ef_vi transmit and event paths with the adapter taken away;
+ *
+ *   - two VIs sharing one event queue each send the other a full RX ring's
+ *     worth of frames, which must all arrive, and be completed, without
+ *     the event queue overflowing.
+ *
+ * Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include <etherfabric/vi.h>
+#include <etherfabric/pd.h>
+#include <etherfabric/memreg.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define TRY(x)                                                  \
+  do {                                                          \
+    int __rc = (x);                                             \
+    if( __rc < 0 ) {                                            \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d rc=%d\n",    \
+              #x, __FILE__, __LINE__, __rc);                    \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define BUF_SIZE     2048
+#define RXQ_SIZE     512
+#define FRAME_MIN    60
+#define FRAME_MAX    1514
+#define EVS_MAX      64
+
+
+static int cfg_iters = 100000;
+
+
+struct end {
+  ef_vi     vi;
+  ef_memreg mr;
+  char*     mem;
+  int       n_rx;
+  int       n_tx;
+};
+
+
+static ef_driver_handle dh;
+static ef_pd pd;
+static char wire_name[32];
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static char* rx_buf(struct end* e, int id)
+{
+  return e->mem + (size_t) id * BUF_SIZE;
+}
+
+
+static char* tx_buf(struct end* e, int id)
+{
+  return e->mem + (size_t) (e->n_rx + id) * BUF_SIZE;
+}
+
+
+static void rx_post(struct end* e, int id)
+{
+  TRY(ef_vi_receive_init(&e->vi,
+                         ef_memreg_dma_addr(&e->mr, (size_t) id * BUF_SIZE),
+                         id));
+}
+
+
+/* Allocates a VI on the first free port of the wire, with its own event
+ * queue unless [evq] is given, and fills its RX ring. */
+static void end_init(struct end* e, ef_vi* evq, int rxq_size, int txq_size)
+{
+  size_t bytes;
+  int i;
+
+  TRY(ef_vi_alloc_from_pd(&e->vi, dh, &pd, dh, -1, rxq_size, txq_size, evq,
+                          dh, EF_VI_FLAGS_DEFAULT));
+  e->n_rx = rxq_size ? ef_vi_receive_capacity(&e->vi) : 0;
+  e->n_tx = txq_size ? ef_vi_transmit_capacity(&e->vi) : 0;
+  bytes = (size_t) (e->n_rx + e->n_tx) * BUF_SIZE;
+  TEST(posix_memalign((void**) &e->mem, 4096, bytes) == 0);
+  memset(e->mem, 0, bytes);
+  TRY(ef_memreg_alloc(&e->mr, dh, &pd, dh, e->mem, bytes));
+  for( i = 0; i < e->n_rx; ++i )
+    rx_post(e, i);
+  if( e->n_rx )
+    ef_vi_receive_push(&e->vi);
+}
+
+
+/* Frees [e]'s VI, and with it its port of the wire. */
+static void end_fini(struct end* e)
+{
+  TRY(ef_vi_free(&e->vi, dh));
+  TRY(ef_memreg_free(&e->mr, dh));
+  free(e->mem);
+}
+
+
+static void frame_fill(char* p, int len, unsigned seq)
+{
+  int i;
+  for( i = 0; i < len; ++i )
+    p[i] = (char) (seq * 7 + i);
+}
+
+
+static void send_frame(struct end* e, int id, int len)
+{
+  TRY(ef_vi_transmit(&e->vi,
+                     ef_memreg_dma_addr(&e->mr,
+                                        (size_t) (e->n_rx + id) * BUF_SIZE),
+                     len, id));
+}
+
+
+/* Polls [e]'s event queue for TX completions until [n] have arrived. */
+static void tx_reap(struct end* e, int n)
+{
+  ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+  ef_event evs[EVS_MAX];
+  int i, n_ev;
+
+  while( n > 0 ) {
+    n_ev = ef_eventq_poll(&e->vi, evs, EVS_MAX);
+    for( i = 0; i < n_ev; ++i ) {
+      TEST(EF_EVENT_TYPE(evs[i]) == EF_EVENT_TYPE_TX);
+      n -= ef_vi_transmit_unbundle(&e->vi, &evs[i], ids);
+    }
+  }
+  TEST(n == 0);
+}
+
+
+/**********************************************************************
+ * Tests
+ */
+
+static void test_frames(struct end* a, struct end* b)
+{
+  int prefix = ef_vi_receive_prefix_len(&b->vi);
+  ef_event evs[EVS_MAX];
+  int len, n_ev, id;
+
+  for( len = FRAME_MIN; len <= FRAME_MAX; ++len ) {
+    frame_fill(tx_buf(a, 0), len, len);
+    send_frame(a, 0, len);
+    tx_reap(a, 1);
+
+    while( (n_ev = ef_eventq_poll(&b->vi, evs, EVS_MAX)) == 0 )
+      ;
+    TEST(n_ev == 1);
+    TEST(EF_EVENT_TYPE(evs[0]) == EF_EVENT_TYPE_RX);
+    TEST(EF_EVENT_RX_SOP(evs[0]) && ! EF_EVENT_RX_CONT(evs[0]));
+    TEST(EF_EVENT_RX_BYTES(evs[0]) - prefix == len);
+    id = EF_EVENT_RX_RQ_ID(evs[0]);
+    TEST(memcmp(rx_buf(b, id) + prefix, tx_buf(a, 0), len) == 0);
+    rx_post(b, id);
+    ef_vi_receive_push(&b->vi);
+  }
+  printf("frames: %d to %d bytes ok\n", FRAME_MIN, FRAME_MAX);
+}
+
+
+/* [q0] owns the event queue that [q1] shares, and they are at the two
+ * ends of the wire.  Each sends the other a full RX ring of frames before
+ * the event queue is polled. */
+static void test_shared_evq(struct end* q0, struct end* q1)
+{
+  ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+  struct end* q[2] = { q0, q1 };
+  ef_event evs[EVS_MAX];
+  int n_rx[2] = { 0, 0 };
+  int n_tx[2] = { 0, 0 };
+  int i, n_ev, id;
+
+  TEST(q0->n_tx >= q1->n_rx && q1->n_tx >= q0->n_rx);
+  for( i = 0; i < q1->n_rx; ++i )
+    send_frame(q0, i, FRAME_MIN);
+  for( i = 0; i < q0->n_rx; ++i )
+    send_frame(q1, i, FRAME_MIN);
+
+  while( n_rx[0] + n_rx[1] < q0->n_rx + q1->n_rx ||
+         n_tx[0] + n_tx[1] < q0->n_rx + q1->n_rx ) {
+    n_ev = ef_eventq_poll(&q0->vi, evs, EVS_MAX);
+    for( i = 0; i < n_ev; ++i )
+      if( EF_EVENT_TYPE(evs[i]) == EF_EVENT_TYPE_RX ) {
+        id = EF_EVENT_RX_Q_ID(evs[i]);
+        TEST(id == 0 || id == 1);
+        ++n_rx[id];
+      }
+      else {
+        TEST(EF_EVENT_TYPE(evs[i]) == EF_EVENT_TYPE_TX);
+        id = EF_EVENT_TX_Q_ID(evs[i]);
+        TEST(id == 0 || id == 1);
+        n_tx[id] += ef_vi_transmit_unbundle(&q[id]->vi, &evs[i], ids);
+      }
+  }
+  TEST(n_rx[0] == q0->n_rx && n_tx[1] == q0->n_rx);
+  TEST(n_rx[1] == q1->n_rx && n_tx[0] == q1->n_rx);
+  printf("shared evq: %d + %d frames ok, capacity %d\n", n_rx[0], n_rx[1],
+         ef_eventq_capacity(&q0->vi));
+}
+
+
+static void rx_wait(struct end* e)
+{
+  ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+  ef_event evs[EVS_MAX];
+  int i, n_ev, got = 0;
+
+  do {
+    n_ev = ef_eventq_poll(&e->vi, evs, EVS_MAX);
+    for( i = 0; i < n_ev; ++i )
+      if( EF_EVENT_TYPE(evs[i]) == EF_EVENT_TYPE_RX ) {
+        rx_post(e, EF_EVENT_RX_RQ_ID(evs[i]));
+        ef_vi_receive_push(&e->vi);
+        got = 1;
+      }
+      else {
+        TEST(EF_EVENT_TYPE(evs[i]) == EF_EVENT_TYPE_TX);
+        ef_vi_transmit_unbundle(&e->vi, &evs[i], ids);
+      }
+  } while( ! got );
+}
+
+
+static void bench_pingpong(struct end* a, struct end* b)
+{
+  double t;
+  int i;
+
+  frame_fill(tx_buf(a, 0), FRAME_MIN, 0);
+  frame_fill(tx_buf(b, 0), FRAME_MIN, 0);
+  t = now();
+  for( i = 0; i < cfg_iters; ++i ) {
+    send_frame(a, 0, FRAME_MIN);
+    rx_wait(b);
+    send_frame(b, 0, FRAME_MIN);
+    rx_wait(a);
+  }
+  t = now() - t;
+  printf("pingpong: %d round trips, %.0f ns half round trip\n", cfg_iters,
+         t * 1e9 / cfg_iters / 2);
+}
+
+
+static void cleanup(void)
+{
+  char name[64];
+
+  snprintf(name, sizeof(name), "/ef_vi_sw.%s", wire_name);
+  shm_unlink(name);
+}
+
+
+int main(int argc, char** argv)
+{
+  struct end a, b, q0, q1;
+  int c;
+
+  while( (c = getopt(argc, argv, "n:")) != -1 )
+    switch( c ) {
+    case 'n':
+      cfg_iters = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: sw_vi [-n round-trips]\n");
+      return 1;
+    }
+
+  snprintf(wire_name, sizeof(wire_name), "sw_vi_test.%d", (int) getpid());
+  atexit(cleanup);
+
+  TEST(setenv("EF_VI_SW", wire_name, 1) == 0);
+  TRY(ef_driver_open(&dh));
+  TRY(ef_pd_alloc_by_name(&pd, dh, "sw", EF_PD_DEFAULT));
+
+  end_init(&a, NULL, RXQ_SIZE, RXQ_SIZE);
+  end_init(&b, NULL, RXQ_SIZE, RXQ_SIZE);
+  test_frames(&a, &b);
+  bench_pingpong(&a, &b);
+  end_fini(&a);
+  end_fini(&b);
+
+  /* q0's event queue is sized for its own small RX ring, and must grow
+   * when q1 joins it. */
+  end_init(&q0, NULL, 64, RXQ_SIZE);
+  end_init(&q1, &q0.vi, RXQ_SIZE, 64);
+  test_shared_evq(&q0, &q1);
+  return 0;
+}
@@ -0,0 +1,196 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test of congestion window recovery after a retransmit timeout.
+ *
+ * For each congestion control algorithm a connection with a full window
+ * in flight takes an RTO through ci_tcp_cong_rto(), as
+ * ci_tcp_timeout_rto() does, and then ACKs for the retransmitted data
+ * arrive through ci_tcp_cong_avoid(), as ci_tcp_rx_handle_ack() does.
+ * cwnd must fall to one segment and then slow-start again, rather than
+ * stay at one segment until recovery ends.  cubic and bbr must not grow
+ * cwnd during fast recovery or while COOLING, where
+ * ci_tcp_try_cwndrecover() owns it; Reno must grow it there just as it
+ * does when the connection is open.
+ *
+ * The stack exists only in this process: the shared state and the socket
+ * are ordinary memory, with just the fields that congestion control
+ * looks at.  Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ci/internal/ip.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define MSS         1448
+#define WINDOW      64    /* segments in flight when the RTO fires */
+#define N_ACKS      16
+
+
+static void netif_init(ci_netif* ni)
+{
+  ci_ip_timer_state* its;
+
+  memset(ni, 0, sizeof(*ni));
+  TEST((ni->state = calloc(1, sizeof(*ni->state))) != NULL);
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+
+  /* A 2GHz clock, with ticks of about a millisecond. */
+  its = IPTIMER_STATE(ni);
+  its->khz = 2000000;
+  its->ci_ip_time_frc2us = 11;
+  its->ci_ip_time_frc2tick = 21;
+  its->ci_ip_time_ms2tick_fxp = ((ci_uint64) its->khz << 32) >>
+                                its->ci_ip_time_frc2tick;
+  its->frc = 1ull << 32;
+  its->ci_ip_time_real_ticks = its->frc >> its->ci_ip_time_frc2tick;
+}
+
+
+/* Moves time on by [us] microseconds. */
+static void netif_advance(ci_netif* ni, unsigned us)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  its->frc += (ci_uint64) us << its->ci_ip_time_frc2us;
+  its->ci_ip_time_real_ticks = its->frc >> its->ci_ip_time_frc2tick;
+}
+
+
+/* An established connection in congestion avoidance, with a full window
+ * in flight. */
+static void ts_init(ci_netif* ni, ci_tcp_state* ts, unsigned alg)
+{
+  memset(ts, 0, sizeof(*ts));
+  ts->s.b.state = CI_TCP_ESTABLISHED;
+  ts->outgoing_hdrs_len = sizeof(ci_ip4_hdr) + sizeof(ci_tcp_hdr) + 12;
+  ts->eff_mss = MSS;
+  ts->c.cong_alg = alg;
+  ts->snd_una = 1000;
+  ts->snd_nxt = ts->snd_una + WINDOW * MSS;
+  ts->cwnd = WINDOW * MSS;
+  ts->ssthresh = WINDOW * MSS / 2;
+  ts->congstate = CI_TCP_CONG_OPEN;
+  ci_ip_queue_init(&ts->send);
+  ci_tcp_cong_init(ni, ts);
+}
+
+
+/* ACKs one segment, as ci_tcp_rx_handle_ack() does: the hook is called
+ * before snd_una moves. */
+static void ack_one(ci_netif* ni, ci_tcp_state* ts)
+{
+  netif_advance(ni, 100);
+  ci_tcp_cong_avoid(ni, ts, MSS, 1);
+  ts->snd_una += MSS;
+}
+
+
+static void test_rto(ci_netif* ni, unsigned alg)
+{
+  ci_tcp_state ts;
+  ci_uint32 cwnd;
+  int i;
+
+  ts_init(ni, &ts, alg);
+  ts.congrecover = ts.snd_nxt;
+  ci_tcp_cong_rto(ni, &ts);
+  TEST(ts.congstate == CI_TCP_CONG_RTO);
+  TEST(ts.cwnd == MSS);
+  TEST(ts.ssthresh >= 2 * MSS);
+  TEST(ts.stats.rtos == 1);
+
+  /* The first ACK after the RTO takes the connection from RTO to
+   * RTO_RECOV in ci_tcp_try_cwndrecover(). */
+  for( i = 0; i < N_ACKS; ++i ) {
+    cwnd = ts.cwnd;
+    ack_one(ni, &ts);
+    TEST(ts.cwnd > cwnd);
+    ts.congstate = CI_TCP_CONG_RTO_RECOV;
+  }
+  printf("%s: after %d ACKs following an RTO cwnd=%u (%u segments)\n",
+         ci_tcp_cong_alg_name(alg), N_ACKS, ts.cwnd, ts.cwnd / MSS);
+  TEST(ts.cwnd >= (N_ACKS + 1) * MSS);
+}
+
+
+/* The retransmission also times out, so ssthresh drops to two segments
+ * before anything is ACKed. */
+static void test_rto_twice(ci_netif* ni, unsigned alg)
+{
+  ci_tcp_state ts;
+  int i;
+
+  ts_init(ni, &ts, alg);
+  ts.congrecover = ts.snd_nxt;
+  ci_tcp_cong_rto(ni, &ts);
+  ci_tcp_cong_rto(ni, &ts);
+  TEST(ts.congstate == CI_TCP_CONG_RTO);
+  TEST(ts.cwnd == MSS);
+  TEST(ts.ssthresh == 2 * MSS);
+  TEST(ts.stats.rtos == 1);
+
+  for( i = 0; i < N_ACKS; ++i ) {
+    ack_one(ni, &ts);
+    ts.congstate = CI_TCP_CONG_RTO_RECOV;
+  }
+  TEST(ts.cwnd >= 2 * MSS);
+}
+
+
+/* cubic and bbr hold cwnd during fast recovery and COOLING.  Reno opens
+ * it on every ACK of new data there just as it does in the open state. */
+static void test_hold(ci_netif* ni, unsigned alg, unsigned congstate)
+{
+  ci_tcp_state ts, open_ts;
+  ci_uint32 cwnd;
+  int i;
+
+  ts_init(ni, &ts, alg);
+  ts_init(ni, &open_ts, alg);
+  ts.congstate = congstate;
+  ts.congrecover = ts.snd_nxt;
+  /* Start in slow start, so that any growth shows at once. */
+  ts.cwnd = open_ts.cwnd = 4 * MSS;
+  cwnd = ts.cwnd;
+  for( i = 0; i < N_ACKS; ++i ) {
+    ack_one(ni, &ts);
+    ack_one(ni, &open_ts);
+  }
+  if( alg == EF_TCP_CONG_ALGO_RENO ) {
+    TEST(ts.cwnd == open_ts.cwnd);
+    TEST(ts.bytes_acked == open_ts.bytes_acked);
+    TEST(ts.cwnd > cwnd);
+  }
+  else {
+    TEST(ts.cwnd == cwnd);
+    TEST(ts.bytes_acked == 0);
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  ci_netif ni;
+  unsigned alg;
+
+  netif_init(&ni);
+  for( alg = 0; alg < EF_TCP_CONG_ALGO_NUM; ++alg ) {
+    test_rto(&ni, alg);
+    test_rto_twice(&ni, alg);
+    test_hold(&ni, alg, CI_TCP_CONG_FAST_RECOV);
+    test_hold(&ni, alg, CI_TCP_CONG_COOLING);
+    test_hold(&ni, alg, CI_TCP_CONG_COOLING | CI_TCP_CONG_RTO);
+  }
+  return 0;
+}
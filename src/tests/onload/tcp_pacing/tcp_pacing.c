@@ -0,0 +1,247 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* TCP pacing rate test.
+ *
+ * The client sets SO_MAX_PACING_RATE on a connection, checks that
+ * getsockopt() reads the rate back, and sends a fixed amount of data as
+ * fast as it can.  The server times the transfer from the first byte to
+ * the last and replies with the elapsed time, from which the client works
+ * out the rate actually achieved.  The test fails if that rate exceeds the
+ * limit by more than the tolerance, or falls short of the given fraction
+ * of it.
+ *
+ * Connections over loopback are not paced, so run the two ends on
+ * different hosts, with the client under Onload:
+ *
+ *   server$ ./tcp_pacing -l
+ *   client$ onload ./tcp_pacing -r 10000000 server
+ *
+ * Setting EF_TCP_PACING=1 on the client as well checks that congestion
+ * control pacing still respects SO_MAX_PACING_RATE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <netdb.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#ifndef SO_MAX_PACING_RATE
+# define SO_MAX_PACING_RATE 47
+#endif
+
+
+#define TRY(x)                                                  \
+  do {                                                          \
+    int __rc = (x);                                             \
+    if( __rc < 0 ) {                                            \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d (errno=%d)\n", \
+              #x, __FILE__, __LINE__, errno);                   \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+
+static const char* cfg_port = "8123";
+static uint64_t cfg_rate = 10000000;     /* bytes per second */
+static uint64_t cfg_bytes = 0;           /* default: two seconds' worth */
+static int cfg_msg_size = 16384;
+static double cfg_tolerance = 0.05;
+static double cfg_min_frac = 0.5;
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+static int run_server(void)
+{
+  struct addrinfo hints, *ai;
+  int lfd, fd, one = 1;
+  char* buf = malloc(cfg_msg_size);
+  uint64_t start, elapsed;
+  ssize_t rc;
+
+  TEST(buf != NULL);
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  TEST(getaddrinfo(NULL, cfg_port, &hints, &ai) == 0);
+  TRY(lfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+  TRY(setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)));
+  TRY(bind(lfd, ai->ai_addr, ai->ai_addrlen));
+  TRY(listen(lfd, 1));
+  freeaddrinfo(ai);
+
+  while( 1 ) {
+    TRY(fd = accept(lfd, NULL, NULL));
+    /* The client sends one byte and waits for it to come back, so that
+     * connection set-up is not timed.
+     */
+    TEST(recv(fd, buf, 1, MSG_WAITALL) == 1);
+    TEST(send(fd, buf, 1, 0) == 1);
+    start = 0;
+    while( (rc = recv(fd, buf, cfg_msg_size, 0)) > 0 )
+      if( start == 0 )
+        start = now_ns();
+    TRY(rc);
+    elapsed = start ? now_ns() - start : 0;
+    TEST(send(fd, &elapsed, sizeof(elapsed), 0) == sizeof(elapsed));
+    close(fd);
+  }
+  return 0;
+}
+
+
+static int run_client(const char* host)
+{
+  struct addrinfo hints, *ai;
+  uint64_t rate, sent = 0, elapsed;
+  socklen_t optlen;
+  char* buf = calloc(cfg_msg_size, 1);
+  double achieved;
+  ssize_t rc;
+  int fd;
+
+  TEST(buf != NULL);
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  TEST(getaddrinfo(host, cfg_port, &hints, &ai) == 0);
+  TRY(fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+  TRY(connect(fd, ai->ai_addr, ai->ai_addrlen));
+  freeaddrinfo(ai);
+
+  /* Both the 64-bit and 32-bit forms of the option must round-trip. */
+  rate = cfg_rate;
+  TRY(setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)));
+  rate = 0;
+  optlen = sizeof(rate);
+  TRY(getsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, &optlen));
+  TEST(optlen == sizeof(rate));
+  TEST(rate == cfg_rate);
+  if( cfg_rate < 0xffffffffu ) {
+    uint32_t rate32 = 0;
+    optlen = sizeof(rate32);
+    TRY(getsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, &optlen));
+    TEST(optlen == sizeof(rate32));
+    TEST(rate32 == cfg_rate);
+  }
+
+  TEST(send(fd, buf, 1, 0) == 1);
+  TEST(recv(fd, buf, 1, MSG_WAITALL) == 1);
+
+  while( sent < cfg_bytes ) {
+    size_t len = cfg_msg_size;
+    if( cfg_bytes - sent < len )
+      len = cfg_bytes - sent;
+    TRY(rc = send(fd, buf, len, 0));
+    sent += rc;
+  }
+  TRY(shutdown(fd, SHUT_WR));
+  TEST(recv(fd, &elapsed, sizeof(elapsed), MSG_WAITALL) == sizeof(elapsed));
+  close(fd);
+
+  TEST(elapsed != 0);
+  achieved = (double) sent * 1e9 / elapsed;
+  printf("limit=%llu bytes/s achieved=%.0f bytes/s (%.1f%%) bytes=%llu "
+         "elapsed=%.3fs\n", (unsigned long long) cfg_rate, achieved,
+         achieved * 100.0 / cfg_rate, (unsigned long long) sent,
+         elapsed / 1e9);
+  if( achieved > cfg_rate * (1.0 + cfg_tolerance) ) {
+    fprintf(stderr, "ERROR: exceeded SO_MAX_PACING_RATE\n");
+    return 1;
+  }
+  if( achieved < cfg_rate * cfg_min_frac ) {
+    fprintf(stderr, "ERROR: fell short of SO_MAX_PACING_RATE\n");
+    return 1;
+  }
+  return 0;
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "usage:\n");
+  fprintf(stderr, "  tcp_pacing -l [-p port]\n");
+  fprintf(stderr, "  tcp_pacing [options] <server-host>\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -p <port>      server port (default 8123)\n");
+  fprintf(stderr, "  -r <rate>      SO_MAX_PACING_RATE in bytes/s\n");
+  fprintf(stderr, "  -n <bytes>     bytes to send (default 2s at rate)\n");
+  fprintf(stderr, "  -s <size>      send() size\n");
+  fprintf(stderr, "  -t <fraction>  tolerance above the rate (default 0.05)\n");
+  fprintf(stderr, "  -m <fraction>  minimum fraction of the rate "
+          "(default 0.5)\n");
+  exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+  int c, server = 0;
+
+  while( (c = getopt(argc, argv, "lp:r:n:s:t:m:")) != -1 )
+    switch( c ) {
+    case 'l':
+      server = 1;
+      break;
+    case 'p':
+      cfg_port = optarg;
+      break;
+    case 'r':
+      cfg_rate = strtoull(optarg, NULL, 0);
+      break;
+    case 'n':
+      cfg_bytes = strtoull(optarg, NULL, 0);
+      break;
+    case 's':
+      cfg_msg_size = atoi(optarg);
+      break;
+    case 't':
+      cfg_tolerance = atof(optarg);
+      break;
+    case 'm':
+      cfg_min_frac = atof(optarg);
+      break;
+    default:
+      usage();
+    }
+  if( cfg_msg_size < 1 || cfg_rate == 0 )
+    usage();
+
+  if( server ) {
+    if( optind != argc )
+      usage();
+    return run_server();
+  }
+  if( optind != argc - 1 )
+    usage();
+  if( cfg_bytes == 0 )
+    cfg_bytes = cfg_rate * 2;
+  return run_client(argv[optind]);
+}
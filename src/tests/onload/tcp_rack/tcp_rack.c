@@ -0,0 +1,313 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test of RACK loss detection (EF_TCP_RACK) when the network reorders.
+ *
+ * A flight of segments is sent in one tick, the first of them is held up
+ * in the network, and the receiver SACKs the ones behind it.  Each SACK is
+ * replayed as the receive path handles it: ci_tcp_rx_sack_process(), then
+ * a dupack and ci_tcp_maybe_enter_fast_recovery().  The first segment must
+ * not be deemed lost, so there is no fast recovery and no retransmit:
+ *
+ *  - lan: srtt is zero, as it is under a tick, and the SACKs arrive in the
+ *    tick after the flight was sent;
+ *  - short_rtt: srtt is a few ticks, too short for srtt/4 to be a tick,
+ *    and the SACKs arrive one srtt after the flight;
+ *  - reordering: reordering has been seen before, so the window stays open
+ *    beyond the dupack threshold and recovery is deferred.
+ *
+ * In each case the reordering timer must be armed, and the first segment
+ * must be deemed lost once the window has passed, if it is never delivered.
+ * Also, until reordering has been seen, the window closes at the dupack
+ * threshold just as the classic algorithm would.
+ *
+ * Before each call that could enter fast recovery the test checks that
+ * RACK would not deem the segment lost, so that a failure is reported
+ * rather than running the retransmit path in a stack without a NIC.
+ *
+ * The stack exists only in this process: the shared state, the socket
+ * buffer and the packet buffers are ordinary memory, laid out as the stack
+ * lays them out.  Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ci/internal/ip.h>
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define N_SEGS      8
+#define MSS         1000
+#define ISS         0xfffff000u  /* so that the sequence space wraps */
+#define START       1000
+
+
+static void netif_init(ci_netif* ni)
+{
+  ci_ip_timer_state* its;
+  unsigned ep_ofs;
+  void* p;
+  int i;
+
+  ep_ofs = CI_ROUND_UP(sizeof(ci_netif_state), EP_BUF_SIZE);
+  memset(ni, 0, sizeof(*ni));
+  TEST((ni->state = calloc(1, ep_ofs + EP_BUF_SIZE)) != NULL);
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  /* Set up by the driver, so const here. */
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  *(ci_uint32*) &ni->state->n_ep_bufs = 1;
+  NI_OPTS(ni).tcp_rack = 1;
+
+  /* As ci_ip_timer_state_init(), but starting at START. */
+  its = IPTIMER_STATE(ni);
+  its->ci_ip_time_real_ticks = START;
+  its->sched_ticks = START;
+  its->closest_timer = START + 2 * CI_IPTIME_BUCKETS;
+  ci_ni_dllist_init(ni, &its->fire_list,
+                    oo_ptr_to_statep(ni, &its->fire_list), "fire");
+  for( i = 0; i < CI_IPTIME_WHEELSIZE; ++i )
+    ci_ni_dllist_init(ni, &its->warray[i],
+                      oo_ptr_to_statep(ni, &its->warray[i]), "timw");
+
+  /* At user level a packet is found through pkt_bufs alone. */
+  TEST((ni->pkt_bufs = calloc(1, sizeof(ni->pkt_bufs[0]))) != NULL);
+  TEST(posix_memalign(&p, CI_PAGE_SIZE,
+                      (size_t) PKTS_PER_SET * CI_CFG_PKT_BUF_SIZE) == 0);
+  memset(p, 0, (size_t) PKTS_PER_SET * CI_CFG_PKT_BUF_SIZE);
+  ni->pkt_bufs[0] = p;
+}
+
+
+static void netif_fini(ci_netif* ni)
+{
+  free(ni->pkt_bufs[0]);
+  free(ni->pkt_bufs);
+  free(ni->state);
+}
+
+
+/* Moves time on without polling the wheel: the reordering timer would run
+ * the TLP path when it fired, and the test only looks at its deadline. */
+static void tick(ci_netif* ni, int n)
+{
+  IPTIMER_STATE(ni)->ci_ip_time_real_ticks += n;
+}
+
+
+/* An established connection that negotiated SACK, with N_SEGS segments
+ * sent at the current tick and none of them acked yet. */
+static ci_tcp_state* ts_init(ci_netif* ni, ci_iptime_t srtt)
+{
+  oo_sp sockp = OO_SP_FROM_INT(ni, 0);
+  ci_tcp_state* ts = SP_TO_TCP(ni, sockp);
+  oo_p sp;
+  int i;
+
+  memset(ts, 0, sizeof(*ts));
+  ts->s.b.bufid = sockp;
+  ts->s.b.state = CI_TCP_ESTABLISHED;
+  ts->tcpflags = CI_TCPT_FLAG_SACK;
+  ts->congstate = CI_TCP_CONG_OPEN;
+  ts->sa = srtt << 3;
+  ts->rack_reo_mult = 1;
+  ts->rack_xmit_ts = ci_tcp_time_now(ni) - 1;
+  ts->snd_una = ISS;
+  ts->snd_nxt = ts->snd_max = ISS + N_SEGS * MSS;
+
+  sp = TS_OFF(ni, ts);
+  OO_P_ADD(sp, (char*) &ts->rto_tid - (char*) ts);
+  ts->rto_tid.param1 = S_SP(ts);
+  ts->rto_tid.fn = CI_IP_TIMER_TCP_RTO;
+  ci_ip_timer_init(ni, &ts->rto_tid, sp, "rto");
+
+  ci_ip_queue_init(&ts->retrans);
+  for( i = 0; i < N_SEGS; ++i ) {
+    ci_ip_pkt_fmt* pkt;
+    oo_pkt_p pp;
+
+    OO_PP_INIT(ni, pp, i);
+    pkt = PKT(ni, pp);
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->pp = pp;
+    pkt->pf.tcp_tx.start_seq = ISS + i * MSS;
+    pkt->pf.tcp_tx.end_seq = ISS + (i + 1) * MSS;
+    pkt->pf.tcp_tx.block_end = OO_PP_NULL;
+    pkt->pf.tcp_tx.tx_time = ci_tcp_time_now(ni);
+    ci_ip_queue_enqueue(ni, &ts->retrans, pkt);
+  }
+  return ts;
+}
+
+
+static ci_ip_pkt_fmt* head(ci_netif* ni, ci_tcp_state* ts)
+{
+  return PKT(ni, ts->retrans.head);
+}
+
+
+/* Remaining ticks before RACK deems the first segment lost. */
+static ci_int32 rack_wait(ci_netif* ni, ci_tcp_state* ts)
+{
+  return ci_tcp_rack_wait(ni, ts, head(ni, ts), ci_tcp_rack_reo_wnd(ts));
+}
+
+
+/* Applies a dupack that SACKs segments 1 to [n], as ci_tcp_rx_sack_process()
+ * and the dupack path of ci_tcp_rx_handle_ack() do. */
+static void sack_1_to(ci_netif* ni, ci_tcp_state* ts, int n)
+{
+  ciip_tcp_rx_pkt rxp;
+  ci_tcp_hdr tcp;
+
+  memset(&rxp, 0, sizeof(rxp));
+  memset(&tcp, 0, sizeof(tcp));
+  tcp.tcp_flags = CI_TCP_FLAG_ACK;
+  rxp.ni = ni;
+  rxp.tcp = &tcp;
+  rxp.flags = CI_TCPT_FLAG_SACK;
+  rxp.ack = ts->snd_una;
+  rxp.sack[0] = ISS + MSS;
+  rxp.sack[1] = ISS + (n + 1) * MSS;
+  rxp.sack_blocks = 1;
+  ci_tcp_rx_sack_process(ni, ts, &rxp);
+  TEST(rxp.flags & CI_TCP_SACKED);
+  ++ts->dup_acks;
+}
+
+
+/* Replays SACKs for segments 1 to [n_sacks] in turn at the current tick,
+ * and checks that none of them leads to fast recovery.  Returns the tick
+ * at which the reordering timer is due. */
+static ci_iptime_t replay(ci_netif* ni, ci_tcp_state* ts, int n_sacks)
+{
+  ci_ip_pkt_fmt* pkt;
+  int i;
+
+  for( i = 1; i <= n_sacks; ++i ) {
+    sack_1_to(ni, ts, i);
+    pkt = head(ni, ts);
+    TEST(! (pkt->flags & CI_PKT_FLAG_RTQ_SACKED));
+    TEST(OO_PP_EQ(pkt->pf.tcp_tx.block_end, pkt->pp));
+    TEST(ts->rack_xmit_ts == pkt->pf.tcp_tx.tx_time);
+    TEST(rack_wait(ni, ts) > 0);
+    TEST(ci_tcp_maybe_enter_fast_recovery(ni, ts) == 0);
+  }
+  TEST(ts->congstate == CI_TCP_CONG_OPEN);
+  TEST(ts->stats.fast_recovers == 0);
+  TEST(ni->state->stats.tcp_rack_early_recovery == 0);
+  TEST(ts->retrans.num == N_SEGS);
+
+  /* The reordering timer is armed for when the first segment would be
+   * deemed lost. */
+  TEST(ci_ip_timer_pending(ni, &ts->rto_tid));
+  TEST(ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_TIMING);
+  TEST(ts->rto_tid.time == ci_tcp_time_now(ni) + rack_wait(ni, ts));
+  return ts->rto_tid.time;
+}
+
+
+/* If the first segment never arrives, it is lost when the timer fires. */
+static void check_lost_at(ci_netif* ni, ci_tcp_state* ts, ci_iptime_t due)
+{
+  tick(ni, due - 1 - ci_tcp_time_now(ni));
+  TEST(rack_wait(ni, ts) == 1);
+  tick(ni, 1);
+  TEST(rack_wait(ni, ts) == 0);
+}
+
+
+static void test_lan(void)
+{
+  ci_netif ni;
+  ci_tcp_state* ts;
+  ci_iptime_t t0, due;
+
+  netif_init(&ni);
+  ts = ts_init(&ni, 0);
+  t0 = ci_tcp_time_now(&ni);
+  tick(&ni, 1);
+  due = replay(&ni, ts, ci_tcp_base_dupack_thresh(ts) - 1);
+  TEST(due == t0 + CI_TCP_RACK_REO_WND_MIN);
+  check_lost_at(&ni, ts, due);
+  printf("lan: lost after %u ticks\n", due - t0);
+  netif_fini(&ni);
+}
+
+
+static void test_short_rtt(void)
+{
+  ci_netif ni;
+  ci_tcp_state* ts;
+  ci_iptime_t t0, due, srtt;
+
+  for( srtt = 1; srtt < 4; ++srtt ) {
+    netif_init(&ni);
+    ts = ts_init(&ni, srtt);
+    t0 = ci_tcp_time_now(&ni);
+    tick(&ni, srtt);
+    due = replay(&ni, ts, ci_tcp_base_dupack_thresh(ts) - 1);
+    TEST(due == t0 + srtt + CI_TCP_RACK_REO_WND_MIN);
+    check_lost_at(&ni, ts, due);
+    printf("short_rtt: srtt %u, lost after %u ticks\n", srtt, due - t0);
+    netif_fini(&ni);
+  }
+}
+
+
+static void test_reordering(void)
+{
+  ci_netif ni;
+  ci_tcp_state* ts;
+  ci_iptime_t t0, due;
+
+  netif_init(&ni);
+  ts = ts_init(&ni, 0);
+  ts->tcpflags |= CI_TCPT_FLAG_RACK_REORDER;
+  t0 = ci_tcp_time_now(&ni);
+  tick(&ni, 1);
+  due = replay(&ni, ts, N_SEGS - 1);
+  TEST(ts->dup_acks >= ci_tcp_base_dupack_thresh(ts));
+  TEST(ts->tcpflags & CI_TCPT_FLAG_RACK_DEFERRED);
+  TEST(ni.state->stats.tcp_rack_deferred == 1);
+  check_lost_at(&ni, ts, due);
+  printf("reordering: %d dupacks, lost after %u ticks\n",
+         ts->dup_acks, due - t0);
+  netif_fini(&ni);
+}
+
+
+/* Until reordering has been seen, the dupack threshold closes the window:
+ * RACK is never slower than three dupacks. */
+static void test_dupack_thresh(void)
+{
+  ci_netif ni;
+  ci_tcp_state* ts;
+
+  netif_init(&ni);
+  ts = ts_init(&ni, 0);
+  tick(&ni, 1);
+  replay(&ni, ts, ci_tcp_base_dupack_thresh(ts) - 1);
+  sack_1_to(&ni, ts, ci_tcp_base_dupack_thresh(ts));
+  TEST(ci_tcp_rack_reo_wnd(ts) == 0);
+  TEST(rack_wait(&ni, ts) == 0);
+  netif_fini(&ni);
+}
+
+
+int main(int argc, char** argv)
+{
+  test_lan();
+  test_short_rtt();
+  test_reordering();
+  test_dupack_thresh();
+  return 0;
+}
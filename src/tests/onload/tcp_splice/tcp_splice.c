@@ -0,0 +1,475 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test of splice(), tee() and vmsplice() between Onload pipes and TCP
+ * sockets.
+ *
+ * A relay accepts two connections from a peer, a source and a sink, and
+ * relays what arrives on the source to the sink through a pipe.  The peer
+ * sends a known byte stream on the source in chunks of random size, and
+ * checks that the sink returns it byte for byte.  The relay works in three
+ * phases, each of which relays [-n] bytes:
+ *
+ *  - splice: socket -> pipe -> socket with splice();
+ *  - tee: as splice, but each lot of data is also tee()d to a second pipe
+ *    before it is spliced out, and the copy is read back and checked;
+ *  - vmsplice: socket -> pipe with splice(), then vmsplice() on the read
+ *    end copies the data out, where it is checked, and vmsplice() on the
+ *    write end of a second pipe copies it back in to be spliced out.
+ *
+ * The relay has to run in Onload with pipes accelerated, and the peer on
+ * another host: connections that are looped back in one stack are not
+ * spliced without copying.  When the relay is accelerated it checks the
+ * tcp_splice_* counters of its stack after each phase, with
+ * onload_stackdump.  Buffers must be moved between the sockets and the
+ * pipe in the splice and tee phases, and the data written with vmsplice()
+ * must be copied.
+ *
+ * When the sink's headers are shorter than the source's, the payload of
+ * each buffer is moved down inside it before it is sent.  The peer makes
+ * this happen by connecting the source to an address of the relay on a
+ * VLAN interface, or over IPv6 (the relay then needs -6), and the sink to
+ * an untagged IPv4 address.  Pass -m to the relay to require it, and it is
+ * required not to happen otherwise:
+ *
+ *   relay$ EF_PIPE=1 onload ./tcp_splice -m
+ *   peer$  ./tcp_splice -a <relay VLAN address> -A <relay address>
+ *
+ * Exits with status 0 on success.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include <onload/extensions.h>
+
+
+#define TRY(x)                                                  \
+  do {                                                          \
+    int __rc = (x);                                             \
+    if( __rc < 0 ) {                                            \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d (errno=%d)\n", \
+              #x, __FILE__, __LINE__, errno);                   \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define CHUNK_MAX   32768
+#define N_PHASES    3
+
+
+static int cfg_bytes = 8 << 20;
+static const char* cfg_port = "8123";
+static const char* cfg_source;
+static const char* cfg_sink;
+static int cfg_moves;
+static int cfg_ipv6;
+
+
+/* The byte at offset [off] in the stream. */
+static uint8_t pattern(uint64_t off)
+{
+  return (uint8_t) (off * 131 + (off >> 11));
+}
+
+
+static void pattern_fill(uint8_t* buf, size_t len, uint64_t off)
+{
+  size_t i;
+  for( i = 0; i < len; ++i )
+    buf[i] = pattern(off + i);
+}
+
+
+static void pattern_check(const uint8_t* buf, size_t len, uint64_t off)
+{
+  size_t i;
+  for( i = 0; i < len; ++i )
+    if( buf[i] != pattern(off + i) ) {
+      fprintf(stderr, "ERROR: byte %llu is 0x%02x, expected 0x%02x\n",
+              (unsigned long long) (off + i), buf[i], pattern(off + i));
+      exit(1);
+    }
+}
+
+
+static void read_all(int fd, void* buf, size_t len)
+{
+  char* p = buf;
+  ssize_t rc;
+  while( len ) {
+    rc = read(fd, p, len);
+    if( rc <= 0 ) {
+      fprintf(stderr, "ERROR: read returned %d (errno=%d)\n", (int) rc, errno);
+      exit(1);
+    }
+    p += rc;
+    len -= rc;
+  }
+}
+
+
+static void write_all(int fd, const void* buf, size_t len)
+{
+  const char* p = buf;
+  ssize_t rc;
+  while( len ) {
+    TRY(rc = write(fd, p, len));
+    p += rc;
+    len -= rc;
+  }
+}
+
+
+/*************************************************************************
+ * Stack counters
+ */
+
+struct splice_stats {
+  unsigned rx_pkts;
+  unsigned tx_pkts;
+  unsigned moves;
+  unsigned copies;
+};
+
+static int stack_id = -1;
+
+
+/* Reads the tcp_splice_* counters of our stack.  onload_stackdump is run
+ * without Onload, since LD_PRELOAD was cleared at start of day. */
+static void stats_get(struct splice_stats* s)
+{
+  char cmd[64], line[256];
+  unsigned v;
+  FILE* f;
+
+  memset(s, 0, sizeof(*s));
+  if( stack_id < 0 )
+    return;
+  snprintf(cmd, sizeof(cmd), "onload_stackdump %d stats", stack_id);
+  TEST((f = popen(cmd, "r")) != NULL);
+  while( fgets(line, sizeof(line), f) != NULL ) {
+    if( sscanf(line, "tcp_splice_rx_pkts: %u", &v) == 1 )
+      s->rx_pkts = v;
+    else if( sscanf(line, "tcp_splice_tx_pkts: %u", &v) == 1 )
+      s->tx_pkts = v;
+    else if( sscanf(line, "tcp_splice_moves: %u", &v) == 1 )
+      s->moves = v;
+    else if( sscanf(line, "tcp_splice_copies: %u", &v) == 1 )
+      s->copies = v;
+  }
+  TEST(pclose(f) == 0);
+}
+
+
+/*************************************************************************
+ * The relay
+ */
+
+struct relay {
+  int source;
+  int sink;
+  int pipe[2];    /* source -> sink */
+  int copy[2];    /* tee() and vmsplice() */
+  uint64_t off;   /* offset in the stream of the next byte from source */
+};
+
+
+static int relay_accept(int* listen_fd)
+{
+  struct sockaddr_in6 sa6;
+  struct sockaddr_in sa;
+  int one = 1, zero = 0, fd;
+
+  if( *listen_fd < 0 ) {
+    if( cfg_ipv6 ) {
+      memset(&sa6, 0, sizeof(sa6));
+      sa6.sin6_family = AF_INET6;
+      sa6.sin6_port = htons(atoi(cfg_port));
+      TRY(*listen_fd = socket(AF_INET6, SOCK_STREAM, 0));
+      TRY(setsockopt(*listen_fd, IPPROTO_IPV6, IPV6_V6ONLY,
+                     &zero, sizeof(zero)));
+      TRY(setsockopt(*listen_fd, SOL_SOCKET, SO_REUSEADDR,
+                     &one, sizeof(one)));
+      TRY(bind(*listen_fd, (struct sockaddr*) &sa6, sizeof(sa6)));
+    }
+    else {
+      memset(&sa, 0, sizeof(sa));
+      sa.sin_family = AF_INET;
+      sa.sin_port = htons(atoi(cfg_port));
+      TRY(*listen_fd = socket(AF_INET, SOCK_STREAM, 0));
+      TRY(setsockopt(*listen_fd, SOL_SOCKET, SO_REUSEADDR,
+                     &one, sizeof(one)));
+      TRY(bind(*listen_fd, (struct sockaddr*) &sa, sizeof(sa)));
+    }
+    TRY(listen(*listen_fd, 2));
+  }
+  TRY(fd = accept(*listen_fd, NULL, NULL));
+  return fd;
+}
+
+
+/* Moves up to [len] bytes from the source into the pipe. */
+static int relay_in(struct relay* r, int len)
+{
+  int rc;
+  TRY(rc = splice(r->source, NULL, r->pipe[1], NULL, len, SPLICE_F_MOVE));
+  TEST(rc > 0);
+  return rc;
+}
+
+
+/* Moves [len] bytes from the read end of [pipe_rd] to the sink. */
+static void relay_out(struct relay* r, int pipe_rd, int len)
+{
+  int rc;
+  while( len > 0 ) {
+    TRY(rc = splice(pipe_rd, NULL, r->sink, NULL, len, SPLICE_F_MOVE));
+    TEST(rc > 0);
+    len -= rc;
+  }
+}
+
+
+static void phase_splice(struct relay* r, int len)
+{
+  int n;
+  while( len > 0 ) {
+    n = relay_in(r, len);
+    relay_out(r, r->pipe[0], n);
+    r->off += n;
+    len -= n;
+  }
+}
+
+
+static void phase_tee(struct relay* r, int len)
+{
+  static uint8_t buf[CHUNK_MAX];
+  int n, rc;
+
+  while( len > 0 ) {
+    n = relay_in(r, (len < CHUNK_MAX ? len : CHUNK_MAX));
+    /* The pipe holds just what relay_in() put there, so tee() sees it all,
+     * and leaves it to be spliced out. */
+    TRY(rc = tee(r->pipe[0], r->copy[1], n, 0));
+    TEST(rc == n);
+    read_all(r->copy[0], buf, n);
+    pattern_check(buf, n, r->off);
+    relay_out(r, r->pipe[0], n);
+    r->off += n;
+    len -= n;
+  }
+}
+
+
+static void phase_vmsplice(struct relay* r, int len)
+{
+  static uint8_t buf[CHUNK_MAX];
+  struct iovec iov;
+  int n, done, rc;
+
+  while( len > 0 ) {
+    n = relay_in(r, (len < CHUNK_MAX ? len : CHUNK_MAX));
+    for( done = 0; done < n; done += rc ) {
+      iov.iov_base = buf + done;
+      iov.iov_len = n - done;
+      TRY(rc = vmsplice(r->pipe[0], &iov, 1, 0));
+      TEST(rc > 0);
+    }
+    pattern_check(buf, n, r->off);
+    for( done = 0; done < n; done += rc ) {
+      iov.iov_base = buf + done;
+      iov.iov_len = n - done;
+      TRY(rc = vmsplice(r->copy[1], &iov, 1, 0));
+      TEST(rc > 0);
+    }
+    relay_out(r, r->copy[0], n);
+    r->off += n;
+    len -= n;
+  }
+}
+
+
+static void relay(void)
+{
+  static void (* const phases[N_PHASES])(struct relay*, int) = {
+    phase_splice, phase_tee, phase_vmsplice,
+  };
+  static const char* const names[N_PHASES] = {
+    "splice", "tee", "vmsplice",
+  };
+  struct splice_stats before, after;
+  struct onload_stat stat;
+  struct relay r;
+  int listen_fd = -1, i;
+
+  memset(&r, 0, sizeof(r));
+  r.source = relay_accept(&listen_fd);
+  r.sink = relay_accept(&listen_fd);
+  close(listen_fd);
+  /* Pipes are accelerated once the stack exists, so make them now. */
+  TRY(pipe(r.pipe));
+  TRY(pipe(r.copy));
+
+  if( onload_fd_stat(r.source, &stat) == 1 ) {
+    stack_id = stat.stack_id;
+    free(stat.stack_name);
+  }
+  else {
+    printf("relay not accelerated: not checking counters\n");
+  }
+  unsetenv("LD_PRELOAD");
+
+  for( i = 0; i < N_PHASES; ++i ) {
+    stats_get(&before);
+    phases[i](&r, cfg_bytes);
+    stats_get(&after);
+    printf("%s: %d bytes relayed\n", names[i], cfg_bytes);
+    if( stack_id < 0 )
+      continue;
+    printf("  rx_pkts=%u tx_pkts=%u moves=%u copies=%u\n",
+           after.rx_pkts - before.rx_pkts, after.tx_pkts - before.tx_pkts,
+           after.moves - before.moves, after.copies - before.copies);
+    TEST(after.rx_pkts > before.rx_pkts);
+    if( phases[i] == phase_vmsplice ) {
+      TEST(after.tx_pkts == before.tx_pkts);
+      TEST(after.copies > before.copies);
+    }
+    else {
+      TEST(after.tx_pkts > before.tx_pkts);
+      TEST((after.moves > before.moves) == !! cfg_moves);
+    }
+  }
+
+  close(r.source);
+  close(r.sink);
+  close(r.pipe[0]);
+  close(r.pipe[1]);
+  close(r.copy[0]);
+  close(r.copy[1]);
+}
+
+
+/*************************************************************************
+ * The peer
+ */
+
+static int peer_connect(const char* host)
+{
+  struct addrinfo hints, *ai;
+  int fd, rc;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  rc = getaddrinfo(host, cfg_port, &hints, &ai);
+  if( rc != 0 ) {
+    fprintf(stderr, "ERROR: %s: %s\n", host, gai_strerror(rc));
+    exit(1);
+  }
+  TRY(fd = socket(ai->ai_family, SOCK_STREAM, 0));
+  TRY(connect(fd, ai->ai_addr, ai->ai_addrlen));
+  freeaddrinfo(ai);
+  return fd;
+}
+
+
+static void peer(void)
+{
+  static uint8_t buf[CHUNK_MAX];
+  uint64_t off, total = (uint64_t) cfg_bytes * N_PHASES;
+  int source, sink, n;
+
+  /* The relay takes the first connection as the source. */
+  source = peer_connect(cfg_source);
+  sink = peer_connect(cfg_sink);
+  srand(1);
+
+  for( off = 0; off < total; off += n ) {
+    n = 1 + rand() % CHUNK_MAX;
+    if( n > total - off )
+      n = total - off;
+    pattern_fill(buf, n, off);
+    write_all(source, buf, n);
+    memset(buf, 0, n);
+    read_all(sink, buf, n);
+    pattern_check(buf, n, off);
+  }
+  printf("%llu bytes relayed intact\n", (unsigned long long) total);
+  close(source);
+  close(sink);
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "usage:\n"
+          "  relay: tcp_splice [-n bytes] [-p port] [-6] [-m]\n"
+          "  peer:  tcp_splice -a source_addr [-A sink_addr] [-n bytes] "
+          "[-p port]\n");
+  exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+  int c;
+
+  while( (c = getopt(argc, argv, "n:p:a:A:6m")) != -1 )
+    switch( c ) {
+    case 'n':
+      cfg_bytes = atoi(optarg);
+      break;
+    case 'p':
+      cfg_port = optarg;
+      break;
+    case 'a':
+      cfg_source = optarg;
+      break;
+    case 'A':
+      cfg_sink = optarg;
+      break;
+    case '6':
+      cfg_ipv6 = 1;
+      break;
+    case 'm':
+      cfg_moves = 1;
+      break;
+    default:
+      usage();
+    }
+  if( optind != argc || cfg_bytes < 1 || (cfg_sink && ! cfg_source) )
+    usage();
+
+  if( cfg_source ) {
+    if( cfg_sink == NULL )
+      cfg_sink = cfg_source;
+    peer();
+  }
+  else {
+    relay();
+  }
+  return 0;
+}
@@ -0,0 +1,711 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Solarflare Communications Inc */
+/* Test of the classic BPF interpreter that runs onload_tcpdump's filter in
+ * the stack (oo_tcpdump_filter()).
+ *
+ * Filters for host, port, VLAN and TCP flag expressions are run against
+ * crafted frames, with the frames' VLAN tags seen or stripped as they are
+ * for a capture on the parent or on the VLAN interface.  The programs are
+ * written out as "tcpdump -d" prints the output of pcap_compile() for an
+ * Ethernet capture; if libpcap is available the expressions are compiled
+ * with it too, and the results must agree.
+ *
+ * Malformed programs must reject the frame: jumps past the end, scratch
+ * memory slots out of range, division by zero, loads beyond the frame,
+ * unknown instructions, falling off the end, and a length beyond the
+ * space for the program.  A frame is also split across two buffers, the
+ * second of which ends at an inaccessible page, and loads of every size at
+ * every offset up to and beyond its end must see the right bytes or reject
+ * it without faulting.
+ *
+ * The stack exists only in this process: the shared state and the packet
+ * buffers are ordinary memory.  Exits with status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#include <ci/internal/ip.h>
+#include "libc_compat.h"
+#if CI_HAVE_PCAP
+#include <pcap.h>
+#else
+#include <linux/filter.h>
+#endif
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: '%s' failed at %s:%d\n",          \
+              #x, __FILE__, __LINE__);                          \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+#define FRAME_MAX   128
+
+
+/*************************************************************************
+ * The stack
+ */
+
+static ci_netif ni;
+static size_t set_len;
+
+
+/* One packet set, followed by a page that faults if touched. */
+static void netif_init(void)
+{
+  void* p;
+
+  TEST((ni.state = calloc(1, sizeof(ci_netif_state))) != NULL);
+  TEST((ni.pkt_bufs = calloc(1, sizeof(ni.pkt_bufs[0]))) != NULL);
+  set_len = (size_t) PKTS_PER_SET * CI_CFG_PKT_BUF_SIZE;
+  p = mmap(NULL, set_len + CI_PAGE_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  TEST(p != MAP_FAILED);
+  TEST(mprotect((char*) p + set_len, CI_PAGE_SIZE, PROT_NONE) == 0);
+  ni.pkt_bufs[0] = p;
+}
+
+
+static ci_ip_pkt_fmt* pkt_get(int id)
+{
+  ci_ip_pkt_fmt* pkt;
+  oo_pkt_p pp;
+
+  OO_PP_INIT(&ni, pp, id);
+  pkt = PKT(&ni, pp);
+  memset(pkt, 0, offsetof(ci_ip_pkt_fmt, dma_start));
+  pkt->pp = pp;
+  pkt->n_buffers = 1;
+  pkt->frag_next = OO_PP_NULL;
+  return pkt;
+}
+
+
+/* A packet holding [len] bytes of [frame] in one buffer. */
+static ci_ip_pkt_fmt* pkt_from(const ci_uint8* frame, int len)
+{
+  ci_ip_pkt_fmt* pkt = pkt_get(0);
+
+  memcpy(pkt->dma_start, frame, len);
+  /* Anything the filter reads beyond the frame would make it match. */
+  memset(pkt->dma_start + len, 0xff, FRAME_MAX);
+  pkt->pay_len = len;
+  pkt->buf_len = len;
+  return pkt;
+}
+
+
+/*************************************************************************
+ * Programs
+ */
+
+/* An instruction as "tcpdump -d" prints it, with absolute jump targets. */
+struct insn {
+  ci_uint16 code;
+  ci_uint8  jt;
+  ci_uint8  jf;
+  ci_uint32 k;
+};
+
+#define I(code, k)              { (code), 0, 0, (k) }
+#define J(code, k, jt, jf)      { (code), (jt), (jf), (k) }
+#define PROG(p)                 (p), sizeof(p) / sizeof((p)[0])
+
+#define LDH     (BPF_LD | BPF_H | BPF_ABS)
+#define LDB     (BPF_LD | BPF_B | BPF_ABS)
+#define LD      (BPF_LD | BPF_W | BPF_ABS)
+#define LDHX    (BPF_LD | BPF_H | BPF_IND)
+#define LDBX    (BPF_LD | BPF_B | BPF_IND)
+#define LDXMSH  (BPF_LDX | BPF_B | BPF_MSH)
+#define JEQ     (BPF_JMP | BPF_JEQ | BPF_K)
+#define JSET    (BPF_JMP | BPF_JSET | BPF_K)
+#define AND     (BPF_ALU | BPF_AND | BPF_K)
+#define RET     (BPF_RET | BPF_K)
+#define SNAP    262144
+
+/* host 10.0.0.1 */
+static const struct insn prog_host[] = {
+  /* 0 */  I(LDH, 12),
+  /* 1 */  J(JEQ, 0x800, 2, 6),
+  /* 2 */  I(LD, 26),
+  /* 3 */  J(JEQ, 0x0a000001, 12, 4),
+  /* 4 */  I(LD, 30),
+  /* 5 */  J(JEQ, 0x0a000001, 12, 13),
+  /* 6 */  J(JEQ, 0x806, 8, 7),
+  /* 7 */  J(JEQ, 0x8035, 8, 13),
+  /* 8 */  I(LD, 28),
+  /* 9 */  J(JEQ, 0x0a000001, 12, 10),
+  /* 10 */ I(LD, 38),
+  /* 11 */ J(JEQ, 0x0a000001, 12, 13),
+  /* 12 */ I(RET, SNAP),
+  /* 13 */ I(RET, 0),
+};
+
+/* tcp port 80 */
+static const struct insn prog_port[] = {
+  /* 0 */  I(LDH, 12),
+  /* 1 */  J(JEQ, 0x86dd, 2, 8),
+  /* 2 */  I(LDB, 20),
+  /* 3 */  J(JEQ, 6, 4, 19),
+  /* 4 */  I(LDH, 54),
+  /* 5 */  J(JEQ, 80, 18, 6),
+  /* 6 */  I(LDH, 56),
+  /* 7 */  J(JEQ, 80, 18, 19),
+  /* 8 */  J(JEQ, 0x800, 9, 19),
+  /* 9 */  I(LDB, 23),
+  /* 10 */ J(JEQ, 6, 11, 19),
+  /* 11 */ I(LDH, 20),
+  /* 12 */ J(JSET, 0x1fff, 19, 13),
+  /* 13 */ I(LDXMSH, 14),
+  /* 14 */ I(LDHX, 14),
+  /* 15 */ J(JEQ, 80, 18, 16),
+  /* 16 */ I(LDHX, 16),
+  /* 17 */ J(JEQ, 80, 18, 19),
+  /* 18 */ I(RET, SNAP),
+  /* 19 */ I(RET, 0),
+};
+
+/* vlan 100 and udp */
+static const struct insn prog_vlan[] = {
+  /* 0 */  I(LDH, 12),
+  /* 1 */  J(JEQ, 0x8100, 2, 13),
+  /* 2 */  I(LDH, 14),
+  /* 3 */  I(AND, 0xfff),
+  /* 4 */  J(JEQ, 100, 5, 13),
+  /* 5 */  I(LDH, 16),
+  /* 6 */  J(JEQ, 0x86dd, 7, 9),
+  /* 7 */  I(LDB, 24),
+  /* 8 */  J(JEQ, 17, 12, 13),
+  /* 9 */  J(JEQ, 0x800, 10, 13),
+  /* 10 */ I(LDB, 27),
+  /* 11 */ J(JEQ, 17, 12, 13),
+  /* 12 */ I(RET, SNAP),
+  /* 13 */ I(RET, 0),
+};
+
+/* tcp[tcpflags] & (tcp-syn|tcp-ack) == tcp-syn */
+static const struct insn prog_syn[] = {
+  /* 0 */  I(LDH, 12),
+  /* 1 */  J(JEQ, 0x800, 2, 10),
+  /* 2 */  I(LDB, 23),
+  /* 3 */  J(JEQ, 6, 4, 10),
+  /* 4 */  I(LDH, 20),
+  /* 5 */  J(JSET, 0x1fff, 10, 6),
+  /* 6 */  I(LDXMSH, 14),
+  /* 7 */  I(LDBX, 27),
+  /* 8 */  I(AND, 0x12),
+  /* 9 */  J(JEQ, 2, 11, 10),
+  /* 10 */ I(RET, 0),
+  /* 11 */ I(RET, SNAP),
+};
+
+
+/* Installs a program in the form the stack gets it from libpcap, with jump
+ * offsets relative to the next instruction. */
+static void prog_set(const struct insn* prog, int n, int flags)
+{
+  ci_netif_state* ns = ni.state;
+  int i;
+
+  TEST(n <= CI_CFG_DUMP_FILTER_LEN);
+  for( i = 0; i < n; ++i ) {
+    ns->dump_filter[i].code = prog[i].code;
+    ns->dump_filter[i].k = prog[i].k;
+    ns->dump_filter[i].jt = 0;
+    ns->dump_filter[i].jf = 0;
+    if( BPF_CLASS(prog[i].code) == BPF_JMP && BPF_OP(prog[i].code) != BPF_JA ) {
+      TEST(prog[i].jt > i && prog[i].jf > i);
+      ns->dump_filter[i].jt = prog[i].jt - i - 1;
+      ns->dump_filter[i].jf = prog[i].jf - i - 1;
+    }
+  }
+  ns->dump_filter_len = n;
+  ns->dump_filter_flags = flags;
+}
+
+
+/* Installs a program as it is, for the malformed ones. */
+static void prog_set_raw(const struct insn* prog, int n)
+{
+  int i;
+
+  for( i = 0; i < n; ++i )
+    memcpy(&ni.state->dump_filter[i], &prog[i], sizeof(prog[i]));
+  ni.state->dump_filter_len = n;
+  ni.state->dump_filter_flags = 0;
+}
+
+
+/*************************************************************************
+ * Frames
+ */
+
+struct frame {
+  const char* name;
+  ci_uint8 data[FRAME_MAX];
+  int len;
+};
+
+enum {
+  F_TCP_SYN,         /* 10.0.0.1:1234 > 10.0.0.2:80 SYN */
+  F_TCP_SYNACK,      /* 10.0.0.2:80 > 10.0.0.1:1234 SYN|ACK */
+  F_TCP_OTHER,       /* 10.0.0.3:5000 > 10.0.0.4:8080 ACK */
+  F_UDP,             /* 10.0.0.3:53 > 10.0.0.4:5353 */
+  F_VLAN100_UDP,     /* as F_UDP, in VLAN 100 */
+  F_VLAN200_UDP,     /* as F_UDP, in VLAN 200 */
+  F_ARP,             /* who-has 10.0.0.9 tell 10.0.0.1 */
+  F_IP6_TCP,         /* [::1]:1234 > [::2]:80 SYN */
+  F_FRAG,            /* later fragment of a TCP datagram, as if to port 80 */
+  F_VLAN100_SYN,     /* as F_TCP_SYN, in VLAN 100 */
+  N_FRAMES
+};
+
+static struct frame frames[N_FRAMES];
+
+
+static ci_uint8* put16(ci_uint8* p, unsigned v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+  return p + 2;
+}
+
+
+static ci_uint8* put32(ci_uint8* p, ci_uint32 v)
+{
+  return put16(put16(p, v >> 16), v & 0xffff);
+}
+
+
+static ci_uint8* eth(ci_uint8* p, int vlan, unsigned type)
+{
+  static const ci_uint8 macs[12] = {
+    0x00, 0x0f, 0x53, 0x00, 0x00, 0x02, 0x00, 0x0f, 0x53, 0x00, 0x00, 0x01,
+  };
+  memcpy(p, macs, sizeof(macs));
+  p += sizeof(macs);
+  if( vlan >= 0 ) {
+    p = put16(p, 0x8100);
+    p = put16(p, vlan);
+  }
+  return put16(p, type);
+}
+
+
+static ci_uint8* ip4(ci_uint8* p, int proto, ci_uint32 src, ci_uint32 dst,
+                     unsigned frag_off)
+{
+  *p++ = 0x45;
+  *p++ = 0;
+  p = put16(p, 40);
+  p = put16(p, 1);
+  p = put16(p, frag_off);
+  *p++ = 64;
+  *p++ = proto;
+  p = put16(p, 0);
+  p = put32(p, src);
+  return put32(p, dst);
+}
+
+
+static ci_uint8* tcp(ci_uint8* p, unsigned sport, unsigned dport,
+                     unsigned flags)
+{
+  p = put16(p, sport);
+  p = put16(p, dport);
+  p = put32(p, 1000);
+  p = put32(p, 0);
+  *p++ = 5 << 4;
+  *p++ = flags;
+  p = put16(p, 65535);
+  p = put16(p, 0);
+  return put16(p, 0);
+}
+
+
+static ci_uint8* udp(ci_uint8* p, unsigned sport, unsigned dport)
+{
+  p = put16(p, sport);
+  p = put16(p, dport);
+  p = put16(p, 8);
+  return put16(p, 0);
+}
+
+
+#define A(n)  (0x0a000000 | (n))
+
+static void frame_set(int i, const char* name, ci_uint8* end)
+{
+  frames[i].name = name;
+  frames[i].len = end - frames[i].data;
+  TEST(frames[i].len <= FRAME_MAX);
+}
+
+
+static void frames_init(void)
+{
+  ci_uint8* p;
+  int j;
+
+  p = eth(frames[F_TCP_SYN].data, -1, 0x800);
+  p = ip4(p, IPPROTO_TCP, A(1), A(2), 0);
+  frame_set(F_TCP_SYN, "tcp syn", tcp(p, 1234, 80, CI_TCP_FLAG_SYN));
+
+  p = eth(frames[F_TCP_SYNACK].data, -1, 0x800);
+  p = ip4(p, IPPROTO_TCP, A(2), A(1), 0);
+  frame_set(F_TCP_SYNACK, "tcp syn-ack",
+            tcp(p, 80, 1234, CI_TCP_FLAG_SYN | CI_TCP_FLAG_ACK));
+
+  p = eth(frames[F_TCP_OTHER].data, -1, 0x800);
+  p = ip4(p, IPPROTO_TCP, A(3), A(4), 0);
+  frame_set(F_TCP_OTHER, "tcp other",
+            tcp(p, 5000, 8080, CI_TCP_FLAG_ACK));
+
+  p = eth(frames[F_UDP].data, -1, 0x800);
+  p = ip4(p, IPPROTO_UDP, A(3), A(4), 0);
+  frame_set(F_UDP, "udp", udp(p, 53, 5353));
+
+  p = eth(frames[F_VLAN100_UDP].data, 100, 0x800);
+  p = ip4(p, IPPROTO_UDP, A(3), A(4), 0);
+  frame_set(F_VLAN100_UDP, "vlan 100 udp", udp(p, 53, 5353));
+
+  p = eth(frames[F_VLAN200_UDP].data, 200, 0x800);
+  p = ip4(p, IPPROTO_UDP, A(3), A(4), 0);
+  frame_set(F_VLAN200_UDP, "vlan 200 udp", udp(p, 53, 5353));
+
+  p = eth(frames[F_ARP].data, -1, 0x806);
+  p = put16(p, 1);
+  p = put16(p, 0x800);
+  *p++ = 6;
+  *p++ = 4;
+  p = put16(p, 1);
+  memcpy(p, frames[F_ARP].data + 6, 6);
+  p = put32(p + 6, A(1));
+  memset(p, 0, 6);
+  frame_set(F_ARP, "arp", put32(p + 6, A(9)));
+
+  p = eth(frames[F_IP6_TCP].data, -1, 0x86dd);
+  p = put32(p, 0x60000000);
+  p = put16(p, 20);
+  *p++ = IPPROTO_TCP;
+  *p++ = 64;
+  for( j = 0; j < 2; ++j ) {
+    memset(p, 0, 15);
+    p[15] = j + 1;
+    p += 16;
+  }
+  frame_set(F_IP6_TCP, "ip6 tcp", tcp(p, 1234, 80, CI_TCP_FLAG_SYN));
+
+  p = eth(frames[F_FRAG].data, -1, 0x800);
+  p = ip4(p, IPPROTO_TCP, A(3), A(4), 100);
+  frame_set(F_FRAG, "fragment", tcp(p, 80, 80, CI_TCP_FLAG_SYN));
+
+  p = eth(frames[F_VLAN100_SYN].data, 100, 0x800);
+  p = ip4(p, IPPROTO_TCP, A(1), A(2), 0);
+  frame_set(F_VLAN100_SYN, "vlan 100 tcp syn",
+            tcp(p, 1234, 80, CI_TCP_FLAG_SYN));
+}
+
+
+/*************************************************************************
+ * Expressions
+ */
+
+#define M(f)  (1u << (f))
+
+struct expr {
+  const char* text;
+  const struct insn* prog;
+  int prog_len;
+  unsigned match;           /* frames that match, tags seen */
+  unsigned match_stripped;  /* frames that match, tags stripped */
+};
+
+static const struct expr exprs[] = {
+  { "host 10.0.0.1", PROG(prog_host),
+    M(F_TCP_SYN) | M(F_TCP_SYNACK) | M(F_ARP),
+    M(F_TCP_SYN) | M(F_TCP_SYNACK) | M(F_ARP) | M(F_VLAN100_SYN) },
+  { "tcp port 80", PROG(prog_port),
+    M(F_TCP_SYN) | M(F_TCP_SYNACK) | M(F_IP6_TCP),
+    M(F_TCP_SYN) | M(F_TCP_SYNACK) | M(F_IP6_TCP) | M(F_VLAN100_SYN) },
+  { "vlan 100 and udp", PROG(prog_vlan),
+    M(F_VLAN100_UDP),
+    0 },
+  { "tcp[tcpflags] & (tcp-syn|tcp-ack) == tcp-syn", PROG(prog_syn),
+    M(F_TCP_SYN),
+    M(F_TCP_SYN) | M(F_VLAN100_SYN) },
+};
+#define N_EXPRS  (sizeof(exprs) / sizeof(exprs[0]))
+
+
+static void check_expr(const struct expr* e, const char* how)
+{
+  int f, strip, rc;
+  unsigned match;
+
+  for( strip = 0; strip <= 1; ++strip ) {
+    ni.state->dump_filter_flags = strip ? OO_DUMP_FILTER_F_STRIP_VLAN : 0;
+    match = strip ? e->match_stripped : e->match;
+    for( f = 0; f < N_FRAMES; ++f ) {
+      rc = oo_tcpdump_filter(&ni, pkt_from(frames[f].data, frames[f].len));
+      if( rc != !! (match & M(f)) ) {
+        fprintf(stderr, "ERROR: %s '%s'%s %s '%s'\n", how, e->text,
+                strip ? " (tags stripped)" : "",
+                rc ? "matched" : "did not match", frames[f].name);
+        exit(1);
+      }
+    }
+  }
+}
+
+
+static void test_exprs(void)
+{
+  int i;
+
+  for( i = 0; i < N_EXPRS; ++i ) {
+    prog_set(exprs[i].prog, exprs[i].prog_len, 0);
+    check_expr(&exprs[i], "listing");
+  }
+  printf("expressions: %d listings\n", (int) N_EXPRS);
+}
+
+
+#if CI_HAVE_PCAP
+static void test_pcap(void)
+{
+  struct bpf_program bp;
+  pcap_t* pcap;
+  int i;
+
+  CI_BUILD_ASSERT(sizeof(ni.state->dump_filter[0]) == sizeof(bp.bf_insns[0]));
+  TEST((pcap = pcap_open_dead(DLT_EN10MB, SNAP)) != NULL);
+  for( i = 0; i < N_EXPRS; ++i ) {
+    TEST(pcap_compile(pcap, &bp, exprs[i].text, 1,
+                      PCAP_NETMASK_UNKNOWN) == 0);
+    TEST(bp.bf_len <= CI_CFG_DUMP_FILTER_LEN);
+    memcpy(ni.state->dump_filter, bp.bf_insns,
+           bp.bf_len * sizeof(bp.bf_insns[0]));
+    ni.state->dump_filter_len = bp.bf_len;
+    check_expr(&exprs[i], "pcap_compile()d");
+    pcap_freecode(&bp);
+  }
+  pcap_close(pcap);
+  printf("expressions: %d compiled by libpcap\n", (int) N_EXPRS);
+}
+#endif
+
+
+/*************************************************************************
+ * Malformed programs
+ */
+
+#define LDI     (BPF_LD | BPF_IMM)
+#define LDXI    (BPF_LDX | BPF_IMM)
+#define RETA    (BPF_RET | BPF_A)
+#define RET1    I(RET, 1)
+/* A jump with offsets as the stack sees them. */
+#define JR(code, k, jt, jf)  { (code), (jt), (jf), (k) }
+
+struct bad_prog {
+  const char* what;
+  struct insn insns[4];
+  int len;
+};
+
+static const struct bad_prog bad_progs[] = {
+  { "ja past the end", { I(BPF_JMP | BPF_JA, 100), RET1 }, 2 },
+  { "ja to the end", { I(BPF_JMP | BPF_JA, 1), RET1 }, 2 },
+  { "ja backwards", { I(BPF_JMP | BPF_JA, 0xffffffff), RET1 }, 2 },
+  { "jeq past the end", { I(LDI, 0), JR(JEQ, 0, 200, 200), RET1 }, 3 },
+  { "jeq false past the end", { I(LDI, 1), JR(JEQ, 0, 0, 255), RET1 }, 3 },
+  { "ld M[16]", { I(BPF_LD | BPF_MEM, BPF_MEMWORDS), RET1 }, 2 },
+  { "ldx M[-1]", { I(BPF_LDX | BPF_MEM, 0xffffffff), RET1 }, 2 },
+  { "st M[16]", { I(BPF_ST, BPF_MEMWORDS), RET1 }, 2 },
+  { "stx M[65536]", { I(BPF_STX, 0x10000), RET1 }, 2 },
+  { "div #0", { I(LDI, 1), I(BPF_ALU | BPF_DIV | BPF_K, 0), RET1 }, 3 },
+  { "div x=0",
+    { I(LDI, 1), I(LDXI, 0), I(BPF_ALU | BPF_DIV | BPF_X, 0), RET1 }, 4 },
+  { "mod #0", { I(LDI, 1), I(BPF_ALU | BPF_MOD | BPF_K, 0), RET1 }, 3 },
+  { "mod x=0",
+    { I(LDI, 1), I(LDXI, 0), I(BPF_ALU | BPF_MOD | BPF_X, 0), RET1 }, 4 },
+  { "ld word over the end", { I(LD, 52), RET1 }, 2 },
+  { "ldh at -1", { I(LDH, 0xffffffff), RET1 }, 2 },
+  { "ldb at the end", { I(LDB, 54), RET1 }, 2 },
+  { "ld [x + k] wrapping", { I(LDXI, 0xfffffffe), I(LDHX, 1), RET1 }, 3 },
+  { "ldxb 4*([k]&0xf) at the end", { I(LDXMSH, 54), RET1 }, 2 },
+  { "ancillary load", { I(LD, 0xfffff000), RET1 }, 2 },
+  { "unknown opcode", { I(0xffff, 0), RET1 }, 2 },
+  { "eBPF opcode", { I(0xb7, 1), RET1 }, 2 },
+  { "no return", { I(LDI, 1) }, 1 },
+};
+#define N_BAD_PROGS  (sizeof(bad_progs) / sizeof(bad_progs[0]))
+
+/* Each of these differs from one of the above only in being well formed. */
+static const struct bad_prog good_progs[] = {
+  { "ja to the last", { I(BPF_JMP | BPF_JA, 1), I(RET, 0), RET1 }, 3 },
+  { "jeq to the last", { I(LDI, 0), JR(JEQ, 0, 1, 0), I(RET, 0), RET1 }, 4 },
+  { "st/ld M[15]",
+    { I(LDI, 7), I(BPF_ST, BPF_MEMWORDS - 1),
+      I(BPF_LD | BPF_MEM, BPF_MEMWORDS - 1), I(RETA, 0) }, 4 },
+  { "div #1", { I(LDI, 1), I(BPF_ALU | BPF_DIV | BPF_K, 1), RET1 }, 3 },
+  { "ld last word", { I(LD, 50), RET1 }, 2 },
+  { "ldb last byte", { I(LDB, 53), RET1 }, 2 },
+  { "ldxb 4*([k]&0xf) last byte", { I(LDXMSH, 53), RET1 }, 2 },
+};
+#define N_GOOD_PROGS  (sizeof(good_progs) / sizeof(good_progs[0]))
+
+
+static void test_malformed(void)
+{
+  const struct frame* f = &frames[F_TCP_SYN];
+  static const struct insn ret1[] = { RET1 };
+  int i;
+
+  /* The loads above are placed for this frame. */
+  TEST(f->len == 54);
+
+  for( i = 0; i < N_BAD_PROGS; ++i ) {
+    prog_set_raw(bad_progs[i].insns, bad_progs[i].len);
+    if( oo_tcpdump_filter(&ni, pkt_from(f->data, f->len)) ) {
+      fprintf(stderr, "ERROR: '%s' accepted\n", bad_progs[i].what);
+      exit(1);
+    }
+  }
+  for( i = 0; i < N_GOOD_PROGS; ++i ) {
+    prog_set_raw(good_progs[i].insns, good_progs[i].len);
+    if( ! oo_tcpdump_filter(&ni, pkt_from(f->data, f->len)) ) {
+      fprintf(stderr, "ERROR: '%s' rejected\n", good_progs[i].what);
+      exit(1);
+    }
+  }
+
+  /* The length is in shared memory too. */
+  memset(ni.state->dump_filter, 0, sizeof(ni.state->dump_filter));
+  for( i = 0; i < CI_CFG_DUMP_FILTER_LEN; ++i )
+    ni.state->dump_filter[i].code = BPF_LD | BPF_IMM;
+  ni.state->dump_filter_len = CI_CFG_DUMP_FILTER_LEN + 1;
+  TEST(oo_tcpdump_filter(&ni, pkt_from(f->data, f->len)) == 0);
+  ni.state->dump_filter_len = 0xffff;
+  TEST(oo_tcpdump_filter(&ni, pkt_from(f->data, f->len)) == 0);
+  prog_set_raw(ret1, 1);
+  TEST(oo_tcpdump_filter(&ni, pkt_from(f->data, f->len)) == 1);
+
+  printf("malformed: %d rejected, %d well formed accepted\n",
+         (int) N_BAD_PROGS, (int) N_GOOD_PROGS);
+}
+
+
+/*************************************************************************
+ * Loads at the edge of a frame split across two buffers
+ */
+
+static const struct frame* split_head;
+static const ci_uint8* split_tail;
+
+
+static ci_uint8 split_byte(ci_uint32 off)
+{
+  if( off < split_head->len )
+    return split_head->data[off];
+  return split_tail[off - split_head->len];
+}
+
+
+static void test_bounds(void)
+{
+  static const int sizes[] = { BPF_B, BPF_H, BPF_W };
+  static const int bytes[] = { 1, 2, 4 };
+  const struct frame* f = &frames[F_TCP_SYN];
+  ci_ip_pkt_fmt *pkt, *frag;
+  ci_uint32 len, k, k_end, want;
+  ci_uint8* tail;
+  int s, ind, b, tail_len, range, n_loads = 0;
+  struct insn prog[4];
+
+  /* The headers are in the first buffer, and the rest of the frame fills
+   * the last buffer of the set, up to the inaccessible page. */
+  frag = pkt_get(PKTS_PER_SET - 1);
+  tail = frag->dma_start;
+  tail_len = CI_CFG_PKT_BUF_SIZE - offsetof(ci_ip_pkt_fmt, dma_start);
+  TEST(tail + tail_len == (ci_uint8*) ni.pkt_bufs[0] + set_len);
+  for( b = 0; b < tail_len; ++b )
+    tail[b] = b * 7 + 1;
+  frag->buf_len = tail_len;
+
+  pkt = pkt_get(0);
+  memcpy(pkt->dma_start, f->data, f->len);
+  pkt->buf_len = f->len;
+  pkt->pay_len = len = f->len + tail_len;
+  pkt->n_buffers = 2;
+  pkt->frag_next = OO_PKT_P(frag);
+  split_head = f;
+  split_tail = tail;
+
+  /* Loads across the join between the buffers, and at the end. */
+  for( range = 0; range < 2; ++range )
+  for( s = 0; s < 3; ++s )
+    for( ind = 0; ind <= 1; ++ind )
+      for( k = range ? len - 64 : f->len - 8,
+           k_end = range ? len + 4 : f->len + 8; k <= k_end; ++k ) {
+        /* Load, and return whether A is what it should be. */
+        if( ind ) {
+          prog[0] = (struct insn) I(LDXI, k - 16);
+          prog[1] = (struct insn) I(BPF_LD | sizes[s] | BPF_IND, 16);
+        }
+        else {
+          prog[0] = (struct insn) I(LDXI, 0);
+          prog[1] = (struct insn) I(BPF_LD | sizes[s] | BPF_ABS, k);
+        }
+        for( b = 0, want = 0; b < bytes[s] && k + b < len; ++b )
+          want = (want << 8) | split_byte(k + b);
+        prog[2] = (struct insn) J(JEQ, want, 3, 4);
+        prog[3] = (struct insn) I(RET, 1);
+        prog_set(prog, 4, 0);
+        ni.state->dump_filter_len = 5;
+        ni.state->dump_filter[4].code = RET;
+        ni.state->dump_filter[4].k = 0;
+        TEST(oo_tcpdump_filter(&ni, pkt) == (k + bytes[s] <= len));
+        ++n_loads;
+      }
+
+  /* The length as seen by the filter is the whole frame. */
+  prog[0] = (struct insn) I(BPF_LD | BPF_W | BPF_LEN, 0);
+  prog[1] = (struct insn) J(JEQ, len, 2, 3);
+  prog[2] = (struct insn) I(RET, 1);
+  prog[3] = (struct insn) I(RET, 0);
+  prog_set(prog, 4, 0);
+  TEST(oo_tcpdump_filter(&ni, pkt) == 1);
+
+  /* A chain shorter than pay_len says reads as zero, and never past the
+   * last buffer. */
+  pkt->pay_len = len + 100;
+  prog[0] = (struct insn) I(LDB, len + 50);
+  prog[1] = (struct insn) J(JEQ, 0, 2, 3);
+  prog_set(prog, 4, 0);
+  TEST(oo_tcpdump_filter(&ni, pkt) == 1);
+
+  printf("bounds: %d loads around the end of a %u byte frame\n",
+         n_loads, len);
+}
+
+
+int main(int argc, char** argv)
+{
+  netif_init();
+  frames_init();
+  test_exprs();
+#if CI_HAVE_PCAP
+  test_pcap();
+#endif
+  test_malformed();
+  test_bounds();
+  return 0;
+}
@@ -2253,6 +2253,95 @@ static void stack_proc_delay_reset(ci_netif* ni)
 }
 #endif
 
+
+static void lat_hist_summary(ci_netif* ni, const char* pfx,
+                             const char* name, const ci_lat_hist* h)
+{
+  static const unsigned pm[] = { 500, 900, 990, 999 };
+  unsigned long long p[4];
+  int i;
+
+  if( h->n == 0 ) {
+    ci_log("%s%-9s n=0", pfx, name);
+    return;
+  }
+  for( i = 0; i < 4; ++i )
+    p[i] = ci_netif_lat_cycles_to_ns(ni, ci_lat_hist_percentile(h, pm[i]));
+  ci_log("%s%-9s n=%llu mean=%lluns p50=%lluns p90=%lluns p99=%lluns "
+         "p99.9=%lluns max=%lluns", pfx, name, (unsigned long long) h->n,
+         (unsigned long long) ci_netif_lat_cycles_to_ns(ni, h->sum / h->n),
+         p[0], p[1], p[2], p[3],
+         (unsigned long long) ci_netif_lat_cycles_to_ns(ni, h->max));
+}
+
+
+static int lat_hist_enabled(ci_netif* ni)
+{
+  if( ni->lat_hists == NULL )
+    ci_log("lat_hist: stack=%d: not enabled (set EF_LATENCY_HIST=1)",
+           NI_ID(ni));
+  return ni->lat_hists != NULL;
+}
+
+
+static void stack_lat_hist(ci_netif* ni)
+{
+  ci_netif_lat_hists* lh = ni->lat_hists;
+  unsigned i;
+
+  if( ! lat_hist_enabled(ni) )
+    return;
+  ci_log("lat_hist: stack=%d,%s", NI_ID(ni), ni->state->name);
+  lat_hist_summary(ni, "  ", "rx_recv", &lh->rx_recv);
+  lat_hist_summary(ni, "  ", "tx_wire", &lh->tx_wire);
+  lat_hist_summary(ni, "  ", "lock_hold", &lh->lock_hold);
+  for( i = 0; i < NI_OPTS(ni).lat_hist_socks &&
+              i < ni->state->n_ep_bufs; ++i ) {
+    ci_sock_lat_hists* sh = &lh->sock[i];
+    if( sh->rx_recv.n == 0 && sh->tx_wire.n == 0 )
+      continue;
+    ci_log("  socket %d:%d", NI_ID(ni), i);
+    lat_hist_summary(ni, "    ", "rx_recv", &sh->rx_recv);
+    lat_hist_summary(ni, "    ", "tx_wire", &sh->tx_wire);
+  }
+}
+
+
+static void lat_hist_buckets(ci_netif* ni, const char* name,
+                             const ci_lat_hist* h)
+{
+  unsigned i;
+  for( i = 0; i < CI_LAT_HIST_N_BUCKETS; ++i )
+    if( h->bucket[i] != 0 )
+      ci_log("%-8d  %-9s  %-12llu  %u", NI_ID(ni), name,
+             (unsigned long long)
+               ci_netif_lat_cycles_to_ns(ni, ci_lat_hist_bucket_lo(i)),
+             h->bucket[i]);
+}
+
+
+static void stack_lat_hist_buckets(ci_netif* ni)
+{
+  if( ! lat_hist_enabled(ni) )
+    return;
+  ci_log("#stackid  hist       min_ns        count");
+  lat_hist_buckets(ni, "rx_recv", &ni->lat_hists->rx_recv);
+  lat_hist_buckets(ni, "tx_wire", &ni->lat_hists->tx_wire);
+  lat_hist_buckets(ni, "lock_hold", &ni->lat_hists->lock_hold);
+}
+
+
+static void stack_lat_hist_reset(ci_netif* ni)
+{
+  if( ! lat_hist_enabled(ni) )
+    return;
+  if( ! cfg_lock )
+    libstack_netif_lock(ni);
+  ci_netif_lat_hists_reset(ni);
+  if( ! cfg_lock )
+    libstack_netif_unlock(ni);
+}
+
 /**********************************************************************
 ***********************************************************************
 **********************************************************************/
@@ -2365,6 +2454,9 @@ static const stack_op_t stack_ops[] = {
   STACK_OP(proc_delay_hist,    "dump processing delay histogram"),
   STACK_OP(proc_delay_reset,   "reset processing delay stats"),
 #endif
+  STACK_OP(lat_hist,           "dump latency histogram summaries"),
+  STACK_OP(lat_hist_buckets,   "dump stack latency histogram buckets"),
+  STACK_OP(lat_hist_reset,     "reset latency histograms"),
 };
 #define N_STACK_OPS	(sizeof(stack_ops) / sizeof(stack_ops[0]))
 
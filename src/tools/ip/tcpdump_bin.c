@@ -44,6 +44,11 @@ static int cfg_snaplen = MAXIMUM_SNAPLEN;
 static int cfg_dump_os = 1;
 static int cfg_if_is_loop = 0;
 static int cfg_dump_no_match_only = 0;
+static const char *cfg_pcap_filter = NULL;
+static int cfg_pcapng = 0;
+
+/* Filter compiled from cfg_pcap_filter, installed in each stack */
+static struct bpf_program filter_prog;
 
 /* capture precision */
 static const char *cfg_precision = "micro";
@@ -82,6 +87,11 @@ static ci_cfg_desc cfg_opts[] = {
                            "dump only packets not matching onload sockets"},
   {  2, "time-stamp-precision", CI_CFG_STR, &cfg_precision,
                  "set the timestamp precision, default to \"micro\", man tcpdump"},
+  {  3, "filter",    CI_CFG_STR,  &cfg_pcap_filter,
+          "pcap filter expression, applied by the stack before dumping"},
+  {  4, "pcapng",    CI_CFG_FLAG, &cfg_pcapng,
+                           "write pcapng with nanosecond and hardware "
+                           "timestamps instead of pcap"},
 };
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
@@ -145,15 +155,15 @@ static void frc_resync(struct frc_sync* fs)
 }
 
 
-static void pkt_tstamp(const ci_ip_pkt_fmt* pkt, struct timespec* ts_out)
+static void pkt_tstamp(ci_uint64 tstamp_frc, struct timespec* ts_out)
 {
   static struct frc_sync fs;
-  int64_t ns, frc_diff = pkt->tstamp_frc - fs.sync_frc;
+  int64_t ns, frc_diff = tstamp_frc - fs.sync_frc;
 
   /* This if() triggers on the first call. */
   if( frc_diff > fs.max_frc_diff ) {
     frc_resync(&fs);
-    frc_diff = pkt->tstamp_frc - fs.sync_frc;
+    frc_diff = tstamp_frc - fs.sync_frc;
   }
 
   *ts_out = fs.sync_ts;
@@ -238,6 +248,43 @@ suicide:
   exit(1);
 }
 
+/* Install the filter and start the capture ring if the stack has one.
+ * The stack must be locked. */
+static void stack_capture_on(ci_netif *ni)
+{
+  ci_netif_state* ns = ni->state;
+
+  CI_BUILD_ASSERT(sizeof(ns->dump_filter[0]) == sizeof(struct bpf_insn));
+  ci_assert_le(filter_prog.bf_len, CI_CFG_DUMP_FILTER_LEN);
+
+  ns->dump_filter_len = 0;
+  if( filter_prog.bf_len != 0 ) {
+    memcpy(ns->dump_filter, filter_prog.bf_insns,
+           filter_prog.bf_len * sizeof(ns->dump_filter[0]));
+    ns->dump_filter_flags = (cfg_encap.type & CICP_LLAP_TYPE_VLAN) ?
+                            OO_DUMP_FILTER_F_STRIP_VLAN : 0;
+    ci_wmb();
+    ns->dump_filter_len = filter_prog.bf_len;
+  }
+
+  if( ni->dump_ring != NULL ) {
+    ni->dump_ring->snaplen = cfg_snaplen;
+    ni->dump_ring->read_off = ni->dump_ring->write_off;
+    ci_wmb();
+    ni->dump_ring->active = 1;
+    ci_log("Onload stack [%d,%s]: capturing through %u byte ring",
+           ns->stack_id, ns->name, ni->dump_ring_size);
+  }
+}
+
+/* Remove the filter and stop the capture ring. */
+static void stack_capture_off(ci_netif *ni)
+{
+  ni->state->dump_filter_len = 0;
+  if( ni->dump_ring != NULL )
+    ni->dump_ring->active = 0;
+}
+
 /* Turn dumping on */
 static void stack_dump_on(ci_netif *ni)
 {
@@ -280,6 +327,7 @@ static void stack_dump_on(ci_netif *ni)
   /* Set up dumping */
   ci_log("Onload stack [%d,%s]: start packet dump",
          ni->state->stack_id, ni->state->name);
+  stack_capture_on(ni);
   {
     ci_hwport_id_t hwport_i;
     int intf_i;
@@ -302,6 +350,7 @@ static void stack_dump_off(ci_netif *ni)
 {
   memset(ni->state->dump_intf, 0, sizeof(ni->state->dump_intf));
   libstack_netif_lock(ni);
+  stack_capture_off(ni);
   oo_tcpdump_free_pkts(ni, ni->state->dump_read_i);
   ni->state->dump_read_i = ni->state->dump_write_i;
   ci_log("Onload stack [%d,%s]: stop packet dump",
@@ -324,20 +373,144 @@ static void dump_flush(void)
   }
 }
 
-/* Do dump */
-static void stack_dump(ci_netif *ni)
+/* pcapng blocks, see draft-ietf-opsawg-pcapng.  We write a single
+ * Ethernet interface with nanosecond timestamps, and Enhanced Packet
+ * Blocks carrying the direction of each packet.
+ */
+#define PCAPNG_BT_SHB               0x0a0d0d0a
+#define PCAPNG_BT_IDB               0x00000001
+#define PCAPNG_BT_EPB               0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC     0x1a2b3c4d
+#define PCAPNG_OPT_ENDOFOPT         0
+#define PCAPNG_OPT_IF_NAME          2
+#define PCAPNG_OPT_IF_TSRESOL       9
+#define PCAPNG_OPT_EPB_FLAGS        2
+#define PCAPNG_EPB_FLAG_INBOUND     1
+#define PCAPNG_EPB_FLAG_OUTBOUND    2
+
+struct pcapng_epb {
+  ci_uint32 block_type;
+  ci_uint32 block_len;
+  ci_uint32 if_id;
+  ci_uint32 ts_high;
+  ci_uint32 ts_low;
+  ci_uint32 caplen;
+  ci_uint32 len;
+};
+
+struct pcapng_epb_tail {
+  ci_uint16 flags_code;
+  ci_uint16 flags_len;
+  ci_uint32 flags;
+  ci_uint16 end_code;
+  ci_uint16 end_len;
+  ci_uint32 block_len;
+};
+
+static ci_uint32 pcapng_epb_len(ci_uint32 caplen)
 {
-  int strip_vlan = cfg_encap.type & CICP_LLAP_TYPE_VLAN;
-  int do_strip_vlan = strip_vlan;
-  ci_uint16 read_i = ni->state->dump_read_i;
-  ci_uint16 i, fill_level = ni->state->dump_write_i - read_i;
-  sigset_t sigset;
+  return sizeof(struct pcapng_epb) + CI_ROUND_UP(caplen, 4) +
+         sizeof(struct pcapng_epb_tail);
+}
 
-  if( fill_level == 0 )
+/* Timestamp of a packet.  pcapng output gets the NIC's timestamp when
+ * there is one; otherwise we use the time the stack handled the packet.
+ */
+static void dump_tstamp(ci_uint64 tstamp_frc,
+                        const struct oo_timespec* hw_stamp,
+                        struct timespec* ts)
+{
+  if( cfg_pcapng && hw_stamp->tv_sec != 0 ) {
+    ts->tv_sec = hw_stamp->tv_sec;
+    ts->tv_nsec = hw_stamp->tv_nsec & ~CI_IP_PKT_HW_STAMP_FLAG_IN_SYNC;
+  }
+  else {
+    pkt_tstamp(tstamp_frc, ts);
+  }
+}
+
+/* Write the header of a packet record.  [caplen] bytes of packet data
+ * must follow, then dump_pkt_end(). */
+static void dump_pkt_begin(const struct timespec* ts,
+                           ci_uint32 caplen, ci_uint32 len)
+{
+  if( cfg_pcapng ) {
+    struct pcapng_epb epb;
+    ci_uint64 ns = (ci_uint64) ts->tv_sec * 1000000000 + ts->tv_nsec;
+
+    epb.block_type = PCAPNG_BT_EPB;
+    epb.block_len = pcapng_epb_len(caplen);
+    epb.if_id = 0;
+    epb.ts_high = ns >> 32;
+    epb.ts_low = (ci_uint32) ns;
+    epb.caplen = caplen;
+    epb.len = len;
+    dump_data(&epb, sizeof(epb));
+  }
+  else {
+    struct oo_pcap_pkthdr hdr;
+
+    hdr.caplen = caplen;
+    hdr.len = len;
+    hdr.t.ts.tv_sec = ts->tv_sec;
+    if( do_nano )
+      hdr.t.ts.tv_nsec = ts->tv_nsec;
+    else
+      hdr.t.tv.tv_usec = ts->tv_nsec / 1000;
+    dump_data(&hdr, sizeof(hdr));
+  }
+}
+
+static void dump_pkt_end(ci_uint32 caplen, int is_tx)
+{
+  static const char zeros[4];
+  struct pcapng_epb_tail tail;
+
+  if( ! cfg_pcapng )
     return;
 
-  sigemptyset(&sigset);
-  sigaddset(&sigset, SIGINT);
+  if( caplen & 3 )
+    dump_data(zeros, 4 - (caplen & 3));
+  tail.flags_code = PCAPNG_OPT_EPB_FLAGS;
+  tail.flags_len = sizeof(tail.flags);
+  tail.flags = is_tx ? PCAPNG_EPB_FLAG_OUTBOUND : PCAPNG_EPB_FLAG_INBOUND;
+  tail.end_code = PCAPNG_OPT_ENDOFOPT;
+  tail.end_len = 0;
+  tail.block_len = pcapng_epb_len(caplen);
+  dump_data(&tail, sizeof(tail));
+}
+
+/* If we are listening on a VLAN, decide what to do with the additional
+ * header.  Returns -1 if the packet is not on our VLAN, 1 if the tag
+ * should be stripped and 0 otherwise.
+ */
+static int dump_strip_vlan(int intf_i, ci_uint16 vlan, const void* frame)
+{
+  if( ! (cfg_encap.type & CICP_LLAP_TYPE_VLAN) )
+    return 0;
+
+  if( vlan != cfg_encap.vlan_id ) {
+    /* Need to do more detailed check if vlan == 0 as we can't then
+     * rely on it being accurate: Onload doesn't set it on the TX path
+     */
+    const uint16_t* p_ether_type;
+    if( vlan != 0 )
+      return -1;
+    p_ether_type = (const uint16_t*) ((const char*) frame + 2 * ETH_ALEN);
+    if( p_ether_type[0] != CI_ETHERTYPE_8021Q ||
+        (CI_BSWAP_BE16(p_ether_type[1]) & 0xfff) != cfg_encap.vlan_id )
+      return -1;
+  }
+
+  return intf_i != OO_INTF_I_SEND_VIA_OS;
+}
+
+/* Dump packets from the dump queue: the stack has passed us references to
+ * its packet buffers. */
+static void stack_dump_queue(ci_netif *ni)
+{
+  ci_uint16 read_i = ni->state->dump_read_i;
+  ci_uint16 i, fill_level = ni->state->dump_write_i - read_i;
 
   /* Dump a batch of packets, then update dump_read_i.  Avoid writing
    * dump_read_i frequently since dirtying the cache line adds overhead to
@@ -349,14 +522,11 @@ static void stack_dump(ci_netif *ni)
   /* Barrier to ensure entries in dump ring are written. */
   ci_rmb();
 
-  /* Prevent ^C from creating truncated dump file */
-  CI_TEST( pthread_sigmask(SIG_BLOCK, &sigset, NULL) == 0 );
-
   for( i = 0; i < fill_level; ++i, ++read_i ) {
-    struct oo_pcap_pkthdr hdr;
     struct timespec ts;
-    int paylen;
+    int paylen, caplen;
     int fraglen;
+    int do_strip_vlan;
     oo_pkt_p id;
     ci_ip_pkt_fmt *pkt;
 
@@ -369,29 +539,10 @@ static void stack_dump(ci_netif *ni)
 
     paylen = pkt->pay_len;
 
-    /* If we are listening on a VLAN, take care of the additional header.
-     */
-    if( strip_vlan ) {
-      if( pkt->vlan != cfg_encap.vlan_id ) {
-        /* Need to do more detailed check if pkt->vlan == 0 as we can't then 
-         * rely on it being accurate: Onload doesn't set it on the TX path
-         */
-        if( pkt->vlan == 0 ) {
-          uint16_t* p_ether_type;
-          p_ether_type = &(oo_ether_hdr(pkt)->ether_type);
-          if( p_ether_type[0] != CI_ETHERTYPE_8021Q ||
-              (CI_BSWAP_BE16(p_ether_type[1]) & 0xfff) != cfg_encap.vlan_id )
-            continue;
-        }
-        else
-          continue;
-      }
-
-      if( pkt->intf_i == OO_INTF_I_SEND_VIA_OS )
-        do_strip_vlan = 0;
-      else
-        do_strip_vlan = 1;
-    }
+    do_strip_vlan = dump_strip_vlan(pkt->intf_i, pkt->vlan,
+                                    oo_ether_hdr(pkt));
+    if( do_strip_vlan < 0 )
+      continue;
 
     /* For loopback, ensure that ethernet header is correct */
     if( pkt->intf_i == OO_INTF_I_LOOPBACK )
@@ -399,20 +550,14 @@ static void stack_dump(ci_netif *ni)
 
     if( do_strip_vlan )
       paylen -= ETH_VLAN_HLEN;
-    hdr.caplen = CI_MIN(cfg_snaplen, paylen);
-    hdr.len = paylen;
-    pkt_tstamp(pkt, &ts);
-    hdr.t.ts.tv_sec = ts.tv_sec;
-    if( do_nano )
-      hdr.t.ts.tv_nsec = ts.tv_nsec;
-    else
-      hdr.t.tv.tv_usec = ts.tv_nsec / 1000;
+    caplen = CI_MIN(cfg_snaplen, paylen);
+    dump_tstamp(pkt->tstamp_frc, &pkt->hw_stamp, &ts);
     LOG_DUMP(ci_log("%u: got ni %d pkt %d len %d ref %d",
                     read_i, ni->state->stack_id,
                     OO_PKT_FMT(pkt), paylen, pkt->refcount));
 
-    dump_data(&hdr, sizeof(hdr));
-    fraglen = hdr.caplen;
+    dump_pkt_begin(&ts, caplen, paylen);
+    fraglen = caplen;
     if( do_strip_vlan ) {
       if( pkt->n_buffers > 1 )
         fraglen = CI_MIN(fraglen, pkt->buf_len - ETH_VLAN_HLEN);
@@ -428,10 +573,11 @@ static void stack_dump(ci_netif *ni)
 
     /* Dump all scatter-gather chain */
     if( pkt->n_buffers  > 1 ) {
+      int left = caplen;
       ci_ip_pkt_fmt *frag = PKT_CHK_NNL(ni, pkt->frag_next);
       do {
-        hdr.caplen -= fraglen;
-        fraglen = CI_MIN(hdr.caplen, frag->buf_len);
+        left -= fraglen;
+        fraglen = CI_MIN(left, frag->buf_len);
         if( fraglen > 0 )
           dump_data(frag->dma_start, fraglen);
         if( OO_PP_IS_NULL(frag->frag_next) )
@@ -439,11 +585,102 @@ static void stack_dump(ci_netif *ni)
         frag = PKT_CHK_NNL(ni, frag->frag_next);
       } while( frag != NULL );
     }
+    dump_pkt_end(caplen, ! (pkt->flags & CI_PKT_FLAG_RX));
   }
 
   /* Ensure we've finished reading before we release. */
   ci_mb();
   ni->state->dump_read_i = read_i;
+}
+
+/* Dump packets from the capture ring: the stack has copied them for us. */
+static void stack_dump_ring(ci_netif *ni)
+{
+  oo_dump_ring* ring = ni->dump_ring;
+  ci_uint32 mask = ni->dump_ring_size - 1;
+  ci_uint64 read_off = ring->read_off;
+  ci_uint64 write_off = ring->write_off;
+
+  /* Barrier to ensure records up to write_off are written. */
+  ci_rmb();
+
+  while( read_off != write_off ) {
+    oo_dump_rec* rec = (oo_dump_rec*) (ring->data + (read_off & mask));
+    char* frame = (char*) (rec + 1);
+    struct timespec ts;
+    ci_uint32 caplen, len;
+    int do_strip_vlan;
+
+    if( rec->rec_len == 0 || (rec->rec_len & 7) ||
+        rec->rec_len > write_off - read_off ) {
+      ci_log("Onload stack [%d,%s]: bad capture ring record at %llu, "
+             "skipping to %llu", ni->state->stack_id, ni->state->name,
+             (unsigned long long) read_off,
+             (unsigned long long) write_off);
+      read_off = write_off;
+      break;
+    }
+    read_off += rec->rec_len;
+    if( rec->flags & OO_DUMP_REC_F_PAD )
+      continue;
+
+    caplen = rec->caplen;
+    len = rec->len;
+    /* With a short snaplen there may be too little of the frame to hold a
+     * tag, and it is dumped as it was captured. */
+    if( caplen >= 2 * ETH_ALEN + ETH_VLAN_HLEN )
+      do_strip_vlan = dump_strip_vlan(rec->intf_i, rec->vlan, frame);
+    else
+      do_strip_vlan = 0;
+    if( do_strip_vlan < 0 )
+      continue;
+    if( rec->intf_i == OO_INTF_I_LOOPBACK )
+      memset(frame, 0, CI_MIN(caplen, 2 * ETH_ALEN));
+    if( do_strip_vlan ) {
+      caplen -= ETH_VLAN_HLEN;
+      len -= ETH_VLAN_HLEN;
+    }
+    dump_tstamp(rec->tstamp_frc, &rec->hw_stamp, &ts);
+
+    dump_pkt_begin(&ts, caplen, len);
+    if( do_strip_vlan ) {
+      dump_data(frame, 2 * ETH_ALEN);
+      dump_data(frame + 2 * ETH_ALEN + ETH_VLAN_HLEN, caplen - 2 * ETH_ALEN);
+    }
+    else {
+      dump_data(frame, caplen);
+    }
+    dump_pkt_end(caplen, rec->flags & OO_DUMP_REC_F_TX);
+  }
+
+  /* Ensure we've finished reading before the stack reuses the space. */
+  ci_mb();
+  ring->read_off = read_off;
+}
+
+/* Do dump */
+static void stack_dump(ci_netif *ni)
+{
+  sigset_t sigset;
+
+  if( oo_tcpdump_ring_active(ni) ) {
+    if( ni->dump_ring->read_off == ni->dump_ring->write_off )
+      return;
+  }
+  else if( ni->state->dump_write_i == ni->state->dump_read_i ) {
+    return;
+  }
+
+  sigemptyset(&sigset);
+  sigaddset(&sigset, SIGINT);
+
+  /* Prevent ^C from creating truncated dump file */
+  CI_TEST( pthread_sigmask(SIG_BLOCK, &sigset, NULL) == 0 );
+
+  if( oo_tcpdump_ring_active(ni) )
+    stack_dump_ring(ni);
+  else
+    stack_dump_queue(ni);
 
   dump_flush();
   CI_TEST( pthread_sigmask(SIG_UNBLOCK, &sigset, NULL) == 0 );
@@ -456,6 +693,7 @@ static void stack_pre_detach(ci_netif *ni)
   memset(ni->state->dump_intf, 0, sizeof(ni->state->dump_intf));
   ci_wmb();
   stack_dump(ni);
+  stack_capture_off(ni);
 
   /* The stack is dying, but we should free the last packets to check that
    * there is no packet leak */
@@ -548,6 +786,70 @@ static void sighandler_fn(int sig, siginfo_t *info, void *context)
 sa_sigaction_t sighandlers[OO_SIGHANGLER_DFL_MAX+1] =
                                 {sighandler_fn, NULL,NULL};
 
+static void write_pcapng_header(void)
+{
+  struct {
+    ci_uint32 block_type;
+    ci_uint32 block_len;
+    ci_uint32 magic;
+    ci_uint16 version_major;
+    ci_uint16 version_minor;
+    ci_int64  section_len;
+    ci_uint32 block_len2;
+  } __attribute__((packed)) shb;
+  struct {
+    ci_uint32 block_type;
+    ci_uint32 block_len;
+    ci_uint16 linktype;
+    ci_uint16 reserved;
+    ci_uint32 snaplen;
+  } idb;
+  struct {
+    ci_uint16 code;
+    ci_uint16 len;
+  } opt;
+  ci_uint32 name_len = strlen(cfg_interface);
+  ci_uint8 tsresol[4] = { 9 };  /* nanoseconds */
+  static const char zeros[4];
+
+  shb.block_type = PCAPNG_BT_SHB;
+  shb.block_len = shb.block_len2 = sizeof(shb);
+  shb.magic = PCAPNG_BYTE_ORDER_MAGIC;
+  shb.version_major = 1;
+  shb.version_minor = 0;
+  shb.section_len = -1;
+  dump_data(&shb, sizeof(shb));
+
+  idb.block_type = PCAPNG_BT_IDB;
+  idb.block_len = sizeof(idb) +
+                  sizeof(opt) + CI_ROUND_UP(name_len, 4) +
+                  sizeof(opt) + sizeof(tsresol) +
+                  sizeof(opt) + sizeof(ci_uint32);
+  idb.linktype = DLT_EN10MB;
+  idb.reserved = 0;
+  idb.snaplen = cfg_snaplen;
+  dump_data(&idb, sizeof(idb));
+
+  opt.code = PCAPNG_OPT_IF_NAME;
+  opt.len = name_len;
+  dump_data(&opt, sizeof(opt));
+  dump_data(cfg_interface, name_len);
+  if( name_len & 3 )
+    dump_data(zeros, 4 - (name_len & 3));
+
+  opt.code = PCAPNG_OPT_IF_TSRESOL;
+  opt.len = 1;
+  dump_data(&opt, sizeof(opt));
+  dump_data(tsresol, sizeof(tsresol));
+
+  opt.code = PCAPNG_OPT_ENDOFOPT;
+  opt.len = 0;
+  dump_data(&opt, sizeof(opt));
+  dump_data(&idb.block_len, sizeof(idb.block_len));
+
+  dump_flush();
+}
+
 static void write_pcap_header(void)
 {
   struct pcap_file_header hdr;
@@ -695,8 +997,29 @@ int main(int argc, char* argv[])
   /* Parse interfaces */
   parse_interface();
 
+  /* Compile the filter to be run by the stacks */
+  if( cfg_pcap_filter != NULL && cfg_pcap_filter[0] != '\0' ) {
+    pcap_t* pcap = pcap_open_dead(DLT_EN10MB, cfg_snaplen);
+    if( pcap == NULL ||
+        pcap_compile(pcap, &filter_prog, cfg_pcap_filter, 1,
+                     PCAP_NETMASK_UNKNOWN) != 0 ) {
+      ci_log("Failed to compile filter '%s': %s", cfg_pcap_filter,
+             pcap == NULL ? "pcap_open_dead failed" : pcap_geterr(pcap));
+      exit(1);
+    }
+    if( filter_prog.bf_len > CI_CFG_DUMP_FILTER_LEN ) {
+      ci_log("Filter '%s' is too long: %u instructions, maximum is %d",
+             cfg_pcap_filter, filter_prog.bf_len, CI_CFG_DUMP_FILTER_LEN);
+      exit(1);
+    }
+    pcap_close(pcap);
+  }
+
   /* Pcap file header */
-  write_pcap_header();
+  if( cfg_pcapng )
+    write_pcapng_header();
+  else
+    write_pcap_header();
 
   /* Get the initial seq no of stack list */
   CI_TRY(oo_fd_open(&onload_fd));
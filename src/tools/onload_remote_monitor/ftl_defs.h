@@ -287,6 +287,7 @@
   FTL_TFIELD_CONSTINT(ctx, ci_uint8, vi_revision, ORM_OUTPUT_STACK) \
   FTL_TFIELD_CONSTINT(ctx, ci_uint8, vi_channel, ORM_OUTPUT_STACK) \
   FTL_TFIELD_SSTR(ctx, pci_dev, ORM_OUTPUT_STACK) \
+  FTL_TFIELD_INT(ctx, ci_int32, numa_node, ORM_OUTPUT_STACK) \
   FTL_TFIELD_STRUCT(ctx, oo_pktq, dmaq, ORM_OUTPUT_STACK)           \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_bytes_added, ORM_OUTPUT_STACK)  \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_bytes_removed, ORM_OUTPUT_STACK) \
@@ -389,6 +390,7 @@
     FTL_TFIELD_INT(ctx, ci_iptime_t, time, ORM_OUTPUT_STACK)                       \
     FTL_TFIELD_INT(ctx, oo_sp, param1, ORM_OUTPUT_EXTRA)                     \
     FTL_TFIELD_INT(ctx, ci_iptime_callback_fn_t, fn, ORM_OUTPUT_EXTRA)             \
+    FTL_TFIELD_INT(ctx, ci_uint16, flags, ORM_OUTPUT_EXTRA)                        \
     FTL_TSTRUCT_END(ctx)                                                 
 
 #define STRUCT_EF_VI_TXQ_STATE(ctx)                             \
@@ -553,6 +555,9 @@
   FTL_TFIELD_ARRAYOFSTRUCT(ctx, ci_ni_dllist_t, timeout_q, \
                            OO_TIMEOUT_Q_MAX, ORM_OUTPUT_STACK, 1)         \
   FTL_TFIELD_STRUCT(ctx, ci_ni_dllist_t, reap_list, ORM_OUTPUT_EXTRA)     \
+  FTL_TFIELD_INT(ctx, ci_uint32, pacing_cursor, ORM_OUTPUT_STACK)         \
+  FTL_TFIELD_INT(ctx, ci_uint32, pacing_n, ORM_OUTPUT_STACK)              \
+  FTL_TFIELD_STRUCT(ctx, ci_ip_timer, pacing_tid, ORM_OUTPUT_STACK)       \
   FTL_TFIELD_INT(ctx, ci_uint32, challenge_ack_num, ORM_OUTPUT_STACK)     \
   FTL_TFIELD_INT(ctx, ci_iptime_t, challenge_ack_time, ORM_OUTPUT_STACK)  \
   ON_CI_CFG_SUPPORT_STATS_COLLECTION(                                   \
@@ -628,6 +633,9 @@
   FTL_TFIELD_INT(ctx, ci_int32, creation_numa_node, ORM_OUTPUT_STACK)     \
   FTL_TFIELD_INT(ctx, ci_int32, load_numa_node, ORM_OUTPUT_STACK)         \
   FTL_TFIELD_INT(ctx, ci_uint32, packet_alloc_numa_nodes, ORM_OUTPUT_STACK)\
+  FTL_TFIELD_INT(ctx, ci_uint32, pkt_numa_no_grow, ORM_OUTPUT_STACK)      \
+  FTL_TFIELD_ARRAYOFINT(ctx, ci_uint8, pkt_numa_short, 32,                \
+                        ORM_OUTPUT_STACK)                                 \
   FTL_TFIELD_INT(ctx, ci_uint32, sock_alloc_numa_nodes, ORM_OUTPUT_STACK) \
   FTL_TFIELD_INT(ctx, ci_uint32, interrupt_numa_nodes, ORM_OUTPUT_STACK)  \
   ON_CI_CFG_FD_CACHING(                                                 \
@@ -920,6 +928,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   ON_CI_CFG_BURST_CONTROL(                                              \
      FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_burst, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
                                                                         ) \
+  FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_pacing, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))   \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_nomac_defer, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))   \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_defer, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_msg_warm_abort, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
@@ -965,7 +974,6 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_STRUCT(ctx, oo_timespec, stamp_cache, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
   FTL_TFIELD_INT(ctx, ci_uint64, stamp, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                   \
   FTL_TFIELD_INT(ctx, ci_uint64, stamp_pre_sots, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
-  FTL_TFIELD_INT(ctx, ci_int32, tx_async_q, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
   FTL_TFIELD_INT(ctx, oo_atomic_t, tx_async_q_level, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_count, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
   FTL_TFIELD_STRUCT(ctx, ci_udp_socket_stats, stats, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
@@ -1041,6 +1049,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_ka_intvl_in_secs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_uint16, user_mss, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
     FTL_TFIELD_INT(ctx, ci_uint8, tcp_defer_accept, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))	      \
+    FTL_TFIELD_INT(ctx, ci_uint8, cong_alg, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
     FTL_TSTRUCT_END(ctx)
 
 #define STRUCT_TCP(ctx) \
@@ -1051,6 +1060,8 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_int32, tmpl_head, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, ci_uint32, tcpflags, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, oo_p, pmtus, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
+    FTL_TFIELD_INT(ctx, oo_p, rx_region, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+    FTL_TFIELD_INT(ctx, oo_p, pacing, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))             \
     FTL_TFIELD_INT(ctx, ci_int32, so_sndbuf_pkts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
     FTL_TFIELD_INT(ctx, ci_uint32, rcv_window_max, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
     FTL_TFIELD_INT(ctx, ci_uint32, send_in, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
@@ -1105,9 +1116,12 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_uint32, ssthresh, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, ci_uint32, bytes_acked, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                 \
     FTL_TFIELD_INT(ctx, ci_uint8, dup_acks, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
+    FTL_TFIELD_INT(ctx, ci_uint8, rack_reo_mult, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
+    FTL_TFIELD_INT(ctx, ci_uint8, rack_reo_persist, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
     ON_CI_CFG_TCP_FASTSTART(                                                  \
       FTL_TFIELD_INT(ctx, ci_uint32, faststart_acks, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
     )                                                                         \
+    FTL_TFIELD_INT(ctx, ci_iptime_t, rack_xmit_ts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
     ON_CI_CFG_TAIL_DROP_PROBE(                                                \
       FTL_TFIELD_INT(ctx, ci_uint32, taildrop_mark, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))             \
     )                                                                         \
@@ -1126,9 +1140,6 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_iptime_t, timed_ts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
     FTL_TFIELD_INT(ctx, ci_uint32, tsrecent, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, ci_uint32, tslastack, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                   \
-    ON_DEBUG(                                                                 \
-      FTL_TFIELD_INT(ctx, ci_uint32, tslastseq, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                 \
-    )                                                                         \
     FTL_TFIELD_INT(ctx, ci_iptime_t, tspaws, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, ci_uint16, acks_pending, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
     FTL_TFIELD_INT(ctx, ci_uint16, urg_data, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
@@ -1144,6 +1155,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
       FTL_TFIELD_STRUCT(ctx, ci_ip_timer, stats_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
     )                                                                         \
     FTL_TFIELD_STRUCT(ctx, ci_ip_timer, cork_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
+    FTL_TFIELD_STRUCT(ctx, ci_ip_timer, timers_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))             \
     ON_CI_CFG_TCP_SOCK_STATS(                                                 \
       FTL_TFIELD_STRUCT(ctx, ci_ip_sock_stats, stats_snapshot, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
       FTL_TFIELD_STRUCT(ctx, ci_ip_sock_stats, stats_cumulative, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))\
@@ -1214,6 +1226,10 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_uint32, acceptq_n_in, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
     FTL_TFIELD_INT(ctx, ci_int32, acceptq_get, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
     FTL_TFIELD_INT(ctx, ci_uint32, acceptq_n_out, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))       \
+    FTL_TFIELD_INT(ctx, ci_uint32, acceptq_ring_enq, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
+    FTL_TFIELD_INT(ctx, ci_uint32, acceptq_ring_deq, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
+    FTL_TFIELD_ARRAYOFINT(ctx, ci_uint32, accept_shard_n,                     \
+                          CI_CFG_TCP_ACCEPT_SHARDS, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
     FTL_TFIELD_INT(ctx, ci_int32, n_listenq, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
     FTL_TFIELD_INT(ctx, ci_int32, n_listenq_new, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
     FTL_TFIELD_ARRAYOFSTRUCT(ctx, ci_ni_dllist_t,       \
@@ -1257,6 +1273,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
 #define STRUCT_FILTER_TABLE(ctx)                                              \
     FTL_TSTRUCT_BEGIN(ctx, ci_netif_filter_table, )                           \
     FTL_TFIELD_INT(ctx, unsigned, table_size_mask, ORM_OUTPUT_STACK)    \
+    FTL_TFIELD_INT(ctx, ci_uint32, compact_cursor, ORM_OUTPUT_STACK)    \
     FTL_TFIELD_ARRAYOFSTRUCT(ctx, \
 			     ci_netif_filter_table_entry_fast, table, 1, ORM_OUTPUT_STACK, 1) \
     FTL_TSTRUCT_END(ctx)
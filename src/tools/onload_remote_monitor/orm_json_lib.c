@@ -894,6 +894,74 @@ static int orm_vis_dump(ci_netif* ni, int output_flags)
 }
 
 
+/**********************************************************/
+/* Dump latency histograms */
+/**********************************************************/
+
+static void orm_lat_hist_dump(ci_netif* ni, const char* name,
+                              const ci_lat_hist* h)
+{
+  static const unsigned pm[] = { 500, 900, 990, 999 };
+  static const char* const pm_name[] = { "p50", "p90", "p99", "p999" };
+  unsigned i;
+
+  dump_buf_cat("\"%s\":{", name);
+  dump_buf_cat_comma("\"n\":%llu", (unsigned long long) h->n);
+  dump_buf_cat_comma("\"mean_ns\":%llu", (unsigned long long)
+                     (h->n ? ci_netif_lat_cycles_to_ns(ni, h->sum / h->n) : 0));
+  for( i = 0; i < sizeof(pm) / sizeof(pm[0]); ++i )
+    dump_buf_cat_comma("\"%s_ns\":%llu", pm_name[i], (unsigned long long)
+                       ci_netif_lat_cycles_to_ns(ni,
+                                                 ci_lat_hist_percentile(h, pm[i])));
+  dump_buf_cat_comma("\"max_ns\":%llu", (unsigned long long)
+                     ci_netif_lat_cycles_to_ns(ni, h->max));
+  /* Non-empty buckets as [lowest value in ns, count] pairs. */
+  dump_buf_literal("\"buckets\":[");
+  for( i = 0; i < CI_LAT_HIST_N_BUCKETS; ++i )
+    if( h->bucket[i] != 0 )
+      dump_buf_cat_comma("[%llu,%u]", (unsigned long long)
+                         ci_netif_lat_cycles_to_ns(ni, ci_lat_hist_bucket_lo(i)),
+                         h->bucket[i]);
+  dump_buf_cleanup();
+  dump_buf_literal_comma("]");
+  dump_buf_cleanup();
+  dump_buf_literal_comma("}");
+}
+
+
+static int orm_lat_hists_dump(ci_netif* ni)
+{
+  ci_netif_lat_hists* lh = ni->lat_hists;
+  unsigned i;
+
+  if( lh == NULL )
+    return 0;
+
+  dump_buf_literal("\"latency\":{");
+  orm_lat_hist_dump(ni, "rx_recv", &lh->rx_recv);
+  orm_lat_hist_dump(ni, "tx_wire", &lh->tx_wire);
+  orm_lat_hist_dump(ni, "lock_hold", &lh->lock_hold);
+  dump_buf_literal("\"sockets\":{");
+  for( i = 0; i < NI_OPTS(ni).lat_hist_socks &&
+              i < ni->state->n_ep_bufs; ++i ) {
+    ci_sock_lat_hists* sh = &lh->sock[i];
+    if( sh->rx_recv.n == 0 && sh->tx_wire.n == 0 )
+      continue;
+    dump_buf_cat("\"%u\":{", i);
+    orm_lat_hist_dump(ni, "rx_recv", &sh->rx_recv);
+    orm_lat_hist_dump(ni, "tx_wire", &sh->tx_wire);
+    dump_buf_cleanup();
+    dump_buf_literal_comma("}");
+  }
+  dump_buf_cleanup();
+  dump_buf_literal_comma("}");
+  dump_buf_cleanup();
+  dump_buf_literal_comma("}");
+
+  return 0;
+}
+
+
 /**********************************************************/
 /* Main */
 /**********************************************************/
@@ -980,6 +1048,12 @@ static int orm_netif_dump(ci_netif* ni, int id, int output_flags, bool cfg_flat,
       return rc;
     }
   }
+  if (output_flags & ORM_OUTPUT_LAT_HIST) {
+    if( (rc = orm_lat_hists_dump(ni)) != 0 ) {
+      LOG("latency histograms error code %d\n",rc);
+      return rc;
+    }
+  }
   dump_buf_cleanup();
   if( ! cfg_flat )
     dump_buf_literal("}}");
@@ -1030,6 +1104,8 @@ int orm_parse_output_flags(int argc, const char* const* argv)
       output_flags |= ORM_OUTPUT_VIS;
     else if ( !strcmp(argv[i], "opts") )
       output_flags |= ORM_OUTPUT_OPTS;
+    else if ( !strcmp(argv[i], "lat_hist") )
+      output_flags |= ORM_OUTPUT_LAT_HIST;
     else if ( !strcmp(argv[i], "lots") )
       output_flags |= ORM_OUTPUT_LOTS;
     else if ( !strcmp(argv[i], "extra") )
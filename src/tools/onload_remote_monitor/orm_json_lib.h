@@ -10,6 +10,7 @@
 #define ORM_OUTPUT_STACK 0x10
 #define ORM_OUTPUT_SOCKETS 0x20
 #define ORM_OUTPUT_VIS 0x40
+#define ORM_OUTPUT_LAT_HIST 0x80
 #define ORM_OUTPUT_OPTS 0x100
 #define ORM_OUTPUT_EXTRA 0x100000
 #define ORM_OUTPUT_LOTS 0xFFFFF